@@ -1,3 +1,4 @@
 @echo off
+set SOURCES=editor.c text_metrics.c journal.c crc32.c sys_thread.c text_writer.c eol.c task_queue.c instance_ipc.c batch.c doc_store.c doc_snapshot.c doc_rope.c doc_pager.c lz_block.c mem_account.c line_segments.c marker_tree.c struct_index.c word_index.c multi_edit.c hex_doc.c async_io.c inflate.c gzip.c doc_stats.c line_ops.c json_format.c csv_index.c
 windres resource.rc -O coff -o resource.o
-gcc -O2 -Wall -Wextra -std=c11 -mwindows editor.c resource.o -o editor.exe -lcomdlg32 -ld2d1 -luuid -lole32
+gcc -O2 -Wall -Wextra -std=c11 -mwindows %SOURCES% resource.o -o editor.exe -lcomdlg32 -ld2d1 -luuid -lole32
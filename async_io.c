@@ -0,0 +1,637 @@
+// File I/O with several requests in flight
+
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "async_io.h"
+#include "sys_thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && !defined(_WIN32)
+#define AIO_HAVE_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+enum { SLOT_IDLE = 0, SLOT_QUEUED, SLOT_RUNNING, SLOT_DONE };
+
+typedef struct {
+    unsigned char *buf;      // owned chunk buffer for streams and writers
+    unsigned char *target;   // memory this request reads into or writes from
+    uint64_t offset;
+    size_t len;
+    int state;
+    long long result;        // bytes transferred, or -1 on error
+#ifdef _WIN32
+    OVERLAPPED ov;
+#endif
+} AioSlot;
+
+#ifdef AIO_HAVE_URING
+typedef struct {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_map;
+    size_t sq_map_len;
+    void *cq_map;
+    size_t cq_map_len;
+    size_t sqes_len;
+} Uring;
+#endif
+
+struct AioFile {
+    AioBackend backend;
+    int writing;
+    int failed;
+    uint64_t size;
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    int fd;
+#endif
+    AioSlot slots[AIO_DEPTH];
+    unsigned head;           // oldest request in flight
+    unsigned inflight;
+    uint64_t next_offset;    // where the next stream read or write goes
+    int consumer_holds;      // aio_next handed out the head slot
+    size_t fill;             // bytes buffered in the writer's current slot
+#ifdef AIO_HAVE_URING
+    Uring ring;
+#endif
+    SysMutex lock;
+    SysCond cond;
+    SysThread workers[AIO_THREADS];
+    unsigned worker_count;
+    unsigned queue[AIO_DEPTH];
+    unsigned queue_head;
+    unsigned queue_count;
+    int stopping;
+};
+
+const char *aio_backend_name(AioBackend backend) {
+    switch (backend) {
+        case AIO_BACKEND_URING: return "io_uring";
+        case AIO_BACKEND_OVERLAPPED: return "overlapped";
+        case AIO_BACKEND_THREADS: return "threads";
+        case AIO_BACKEND_SYNC: return "sync";
+        default: return "auto";
+    }
+}
+
+// Blocking positional I/O; loops over short transfers.
+static long long sync_io(AioFile *f, unsigned char *ptr, uint64_t offset, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+#ifdef _WIN32
+        OVERLAPPED ov;
+        DWORD n = 0;
+        DWORD want = (DWORD)((len - done) > 0x40000000u ? 0x40000000u : (len - done));
+        BOOL ok;
+        memset(&ov, 0, sizeof(ov));
+        ov.Offset = (DWORD)(offset + done);
+        ov.OffsetHigh = (DWORD)((offset + done) >> 32);
+        if (f->backend == AIO_BACKEND_OVERLAPPED) {
+            ov.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+            if (!ov.hEvent) return -1;
+        }
+        ok = f->writing ? WriteFile(f->handle, ptr + done, want, &n, &ov)
+                        : ReadFile(f->handle, ptr + done, want, &n, &ov);
+        if (!ok && GetLastError() == ERROR_IO_PENDING) {
+            ok = GetOverlappedResult(f->handle, &ov, &n, TRUE);
+        }
+        if (ov.hEvent) CloseHandle(ov.hEvent);
+        if (!ok) return GetLastError() == ERROR_HANDLE_EOF ? (long long)done : -1;
+#else
+        ssize_t n = f->writing ? pwrite(f->fd, ptr + done, len - done, (off_t)(offset + done))
+                               : pread(f->fd, ptr + done, len - done, (off_t)(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+#endif
+        if (n == 0) break;
+        done += (size_t)n;
+    }
+    return (long long)done;
+}
+
+#ifdef AIO_HAVE_URING
+static int uring_init(Uring *r) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+    r->fd = (int)syscall(__NR_io_uring_setup, AIO_DEPTH, &p);
+    if (r->fd < 0) return 0;
+
+    r->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if ((p.features & IORING_FEAT_SINGLE_MMAP) && r->cq_map_len > r->sq_map_len) {
+        r->sq_map_len = r->cq_map_len;
+    }
+    r->sq_map = mmap(NULL, r->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_map == MAP_FAILED) {
+        close(r->fd);
+        return 0;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_map = r->sq_map;
+    } else {
+        r->cq_map = mmap(NULL, r->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_map == MAP_FAILED) {
+            munmap(r->sq_map, r->sq_map_len);
+            close(r->fd);
+            return 0;
+        }
+    }
+    r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = (struct io_uring_sqe *)mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        if (r->cq_map != r->sq_map) munmap(r->cq_map, r->cq_map_len);
+        munmap(r->sq_map, r->sq_map_len);
+        close(r->fd);
+        return 0;
+    }
+
+    r->sq_head = (unsigned *)((char *)r->sq_map + p.sq_off.head);
+    r->sq_tail = (unsigned *)((char *)r->sq_map + p.sq_off.tail);
+    r->sq_mask = (unsigned *)((char *)r->sq_map + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)((char *)r->sq_map + p.sq_off.array);
+    r->cq_head = (unsigned *)((char *)r->cq_map + p.cq_off.head);
+    r->cq_tail = (unsigned *)((char *)r->cq_map + p.cq_off.tail);
+    r->cq_mask = (unsigned *)((char *)r->cq_map + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)((char *)r->cq_map + p.cq_off.cqes);
+    return 1;
+}
+
+static void uring_free(Uring *r) {
+    munmap(r->sqes, r->sqes_len);
+    if (r->cq_map != r->sq_map) munmap(r->cq_map, r->cq_map_len);
+    munmap(r->sq_map, r->sq_map_len);
+    close(r->fd);
+}
+
+static int uring_submit(AioFile *f, unsigned index) {
+    Uring *r = &f->ring;
+    AioSlot *slot = &f->slots[index];
+    unsigned tail = *r->sq_tail;
+    unsigned at = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[at];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = f->writing ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = f->fd;
+    sqe->off = slot->offset;
+    sqe->addr = (uint64_t)(uintptr_t)slot->target;
+    sqe->len = (unsigned)slot->len;
+    sqe->user_data = index;
+    r->sq_array[at] = at;
+    __atomic_store_n(r->sq_tail, tail + 1u, __ATOMIC_RELEASE);
+
+    while (syscall(__NR_io_uring_enter, r->fd, 1, 0, 0, NULL, 0) < 0) {
+        if (errno != EINTR && errno != EAGAIN) return 0;
+    }
+    return 1;
+}
+
+static void uring_reap(AioFile *f) {
+    Uring *r = &f->ring;
+    unsigned head = *r->cq_head;
+    while (head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        AioSlot *slot = &f->slots[cqe->user_data];
+        slot->result = cqe->res < 0 ? -1 : (long long)cqe->res;
+        slot->state = SLOT_DONE;
+        head++;
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+}
+#endif
+
+static int pool_worker(void *arg) {
+    AioFile *f = (AioFile *)arg;
+    sys_mutex_lock(&f->lock);
+    for (;;) {
+        unsigned index;
+        AioSlot *slot;
+        while (f->queue_count == 0 && !f->stopping) {
+            sys_cond_wait(&f->cond, &f->lock);
+        }
+        if (f->queue_count == 0) break;
+        index = f->queue[f->queue_head];
+        f->queue_head = (f->queue_head + 1u) % AIO_DEPTH;
+        f->queue_count--;
+        slot = &f->slots[index];
+        slot->state = SLOT_RUNNING;
+        sys_mutex_unlock(&f->lock);
+
+        long long result = sync_io(f, slot->target, slot->offset, slot->len);
+
+        sys_mutex_lock(&f->lock);
+        slot->result = result;
+        slot->state = SLOT_DONE;
+        sys_cond_broadcast(&f->cond);
+    }
+    sys_mutex_unlock(&f->lock);
+    return 0;
+}
+
+static int pool_start(AioFile *f) {
+    if (!sys_mutex_init(&f->lock)) return 0;
+    if (!sys_cond_init(&f->cond)) {
+        sys_mutex_destroy(&f->lock);
+        return 0;
+    }
+    for (unsigned i = 0; i < AIO_THREADS; i++) {
+        if (!sys_thread_start(&f->workers[i], pool_worker, f)) break;
+        f->worker_count++;
+    }
+    return f->worker_count > 0;
+}
+
+static void pool_stop(AioFile *f) {
+    sys_mutex_lock(&f->lock);
+    f->stopping = 1;
+    sys_cond_broadcast(&f->cond);
+    sys_mutex_unlock(&f->lock);
+    for (unsigned i = 0; i < f->worker_count; i++) {
+        sys_thread_join(&f->workers[i]);
+    }
+    sys_cond_destroy(&f->cond);
+    sys_mutex_destroy(&f->lock);
+}
+
+static void submit(AioFile *f, unsigned index, unsigned char *target, uint64_t offset, size_t len) {
+    AioSlot *slot = &f->slots[index];
+    slot->target = target;
+    slot->offset = offset;
+    slot->len = len;
+    slot->result = 0;
+
+    switch (f->backend) {
+#ifdef AIO_HAVE_URING
+        case AIO_BACKEND_URING:
+            slot->state = SLOT_RUNNING;
+            if (!uring_submit(f, index)) {
+                slot->result = -1;
+                slot->state = SLOT_DONE;
+            }
+            return;
+#endif
+#ifdef _WIN32
+        case AIO_BACKEND_OVERLAPPED: {
+            HANDLE event = slot->ov.hEvent;
+            BOOL ok;
+            memset(&slot->ov, 0, sizeof(slot->ov));
+            slot->ov.hEvent = event;
+            slot->ov.Offset = (DWORD)offset;
+            slot->ov.OffsetHigh = (DWORD)(offset >> 32);
+            ResetEvent(event);
+            slot->state = SLOT_RUNNING;
+            ok = f->writing ? WriteFile(f->handle, target, (DWORD)len, NULL, &slot->ov)
+                            : ReadFile(f->handle, target, (DWORD)len, NULL, &slot->ov);
+            if (!ok && GetLastError() != ERROR_IO_PENDING) {
+                slot->result = GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+                slot->state = SLOT_DONE;
+            }
+            return;
+        }
+#endif
+        case AIO_BACKEND_THREADS:
+            sys_mutex_lock(&f->lock);
+            slot->state = SLOT_QUEUED;
+            f->queue[(f->queue_head + f->queue_count) % AIO_DEPTH] = index;
+            f->queue_count++;
+            sys_cond_signal(&f->cond);
+            sys_mutex_unlock(&f->lock);
+            return;
+        default:
+            slot->result = sync_io(f, target, offset, len);
+            slot->state = SLOT_DONE;
+            return;
+    }
+}
+
+// Blocks until the request in `index` finished; returns its byte count or -1.
+static long long wait_slot(AioFile *f, unsigned index) {
+    AioSlot *slot = &f->slots[index];
+
+    switch (f->backend) {
+#ifdef AIO_HAVE_URING
+        case AIO_BACKEND_URING:
+            uring_reap(f);
+            while (slot->state != SLOT_DONE) {
+                if (syscall(__NR_io_uring_enter, f->ring.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+                    errno != EINTR) {
+                    slot->result = -1;
+                    slot->state = SLOT_DONE;
+                    break;
+                }
+                uring_reap(f);
+            }
+            break;
+#endif
+#ifdef _WIN32
+        case AIO_BACKEND_OVERLAPPED:
+            if (slot->state != SLOT_DONE) {
+                DWORD n = 0;
+                if (GetOverlappedResult(f->handle, &slot->ov, &n, TRUE)) {
+                    slot->result = (long long)n;
+                } else {
+                    slot->result = GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+                }
+                slot->state = SLOT_DONE;
+            }
+            break;
+#endif
+        case AIO_BACKEND_THREADS:
+            sys_mutex_lock(&f->lock);
+            while (slot->state != SLOT_DONE) {
+                sys_cond_wait(&f->cond, &f->lock);
+            }
+            sys_mutex_unlock(&f->lock);
+            break;
+        default:
+            break;
+    }
+
+    // Finish short transfers that stopped before the end of the file.
+    if (slot->result >= 0 && (size_t)slot->result < slot->len &&
+        (f->writing || slot->offset + (uint64_t)slot->result < f->size)) {
+        size_t got = (size_t)slot->result;
+        long long rest = sync_io(f, slot->target + got, slot->offset + got, slot->len - got);
+        slot->result = rest < 0 ? -1 : (long long)got + rest;
+    }
+    slot->state = SLOT_IDLE;
+    if (slot->result < 0 || (f->writing && (size_t)slot->result != slot->len)) f->failed = 1;
+    return slot->result;
+}
+
+static int open_handle(AioFile *f, const char *path) {
+#ifdef _WIN32
+    DWORD flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+    if (f->backend == AIO_BACKEND_OVERLAPPED) flags |= FILE_FLAG_OVERLAPPED;
+    f->handle = CreateFileA(
+        path,
+        f->writing ? GENERIC_WRITE : GENERIC_READ,
+        f->writing ? 0 : (FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE),
+        NULL,
+        f->writing ? CREATE_ALWAYS : OPEN_EXISTING,
+        flags,
+        NULL
+    );
+    if (f->handle == INVALID_HANDLE_VALUE) return 0;
+    if (!f->writing) {
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(f->handle, &size)) {
+            CloseHandle(f->handle);
+            return 0;
+        }
+        f->size = (uint64_t)size.QuadPart;
+    }
+#else
+    struct stat st;
+    f->fd = f->writing ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666) : open(path, O_RDONLY);
+    if (f->fd < 0) return 0;
+    if (!f->writing) {
+        if (fstat(f->fd, &st) != 0) {
+            close(f->fd);
+            return 0;
+        }
+        f->size = (uint64_t)st.st_size;
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(f->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+#endif
+    return 1;
+}
+
+static AioBackend pick_backend(AioBackend wanted) {
+    if (wanted != AIO_BACKEND_AUTO) return wanted;
+#if defined(AIO_HAVE_URING)
+    return AIO_BACKEND_URING;
+#elif defined(_WIN32)
+    return AIO_BACKEND_OVERLAPPED;
+#else
+    return AIO_BACKEND_THREADS;
+#endif
+}
+
+AioFile *aio_open(const char *path, int for_write, AioBackend backend) {
+    AioFile *f = (AioFile *)calloc(1, sizeof(AioFile));
+    if (!f || !path) {
+        free(f);
+        return NULL;
+    }
+    f->writing = for_write ? 1 : 0;
+    f->backend = pick_backend(backend);
+#ifndef AIO_HAVE_URING
+    if (f->backend == AIO_BACKEND_URING) f->backend = AIO_BACKEND_THREADS;
+#endif
+#ifndef _WIN32
+    if (f->backend == AIO_BACKEND_OVERLAPPED) f->backend = AIO_BACKEND_THREADS;
+#endif
+
+    if (!open_handle(f, path)) {
+        free(f);
+        return NULL;
+    }
+#ifdef AIO_HAVE_URING
+    // Seccomp filters and old kernels refuse io_uring; the pool still works.
+    if (f->backend == AIO_BACKEND_URING && !uring_init(&f->ring)) f->backend = AIO_BACKEND_THREADS;
+#endif
+#ifdef _WIN32
+    if (f->backend == AIO_BACKEND_OVERLAPPED) {
+        for (unsigned i = 0; i < AIO_DEPTH; i++) {
+            f->slots[i].ov.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+            if (!f->slots[i].ov.hEvent) f->failed = 1;
+        }
+    }
+#endif
+    if (f->backend == AIO_BACKEND_THREADS && !pool_start(f)) f->backend = AIO_BACKEND_SYNC;
+    return f;
+}
+
+static int ensure_buffers(AioFile *f) {
+    for (unsigned i = 0; i < AIO_DEPTH; i++) {
+        if (f->slots[i].buf) continue;
+        f->slots[i].buf = (unsigned char *)malloc(AIO_CHUNK);
+        if (!f->slots[i].buf) {
+            f->failed = 1;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void drain(AioFile *f) {
+    if (f->consumer_holds) {
+        f->head = (f->head + 1u) % AIO_DEPTH;
+        f->inflight--;
+        f->consumer_holds = 0;
+    }
+    while (f->inflight > 0) {
+        wait_slot(f, f->head);
+        f->head = (f->head + 1u) % AIO_DEPTH;
+        f->inflight--;
+    }
+}
+
+int aio_close(AioFile *f) {
+    int ok;
+    if (!f) return 0;
+    if (f->writing && f->fill > 0 && !f->failed) {
+        unsigned index = (f->head + f->inflight) % AIO_DEPTH;
+        submit(f, index, f->slots[index].buf, f->next_offset, f->fill);
+        f->inflight++;
+        f->next_offset += f->fill;
+        f->fill = 0;
+    }
+    drain(f);
+
+    if (f->backend == AIO_BACKEND_THREADS) pool_stop(f);
+#ifdef AIO_HAVE_URING
+    if (f->backend == AIO_BACKEND_URING) uring_free(&f->ring);
+#endif
+#ifdef _WIN32
+    for (unsigned i = 0; i < AIO_DEPTH; i++) {
+        if (f->slots[i].ov.hEvent) CloseHandle(f->slots[i].ov.hEvent);
+    }
+    if (!CloseHandle(f->handle)) f->failed = 1;
+#else
+    if (close(f->fd) != 0) f->failed = 1;
+#endif
+    for (unsigned i = 0; i < AIO_DEPTH; i++) {
+        free(f->slots[i].buf);
+    }
+    ok = !f->failed;
+    free(f);
+    return ok;
+}
+
+uint64_t aio_size(const AioFile *f) {
+    return f ? f->size : 0;
+}
+
+AioBackend aio_backend(const AioFile *f) {
+    return f ? f->backend : AIO_BACKEND_AUTO;
+}
+
+int aio_failed(const AioFile *f) {
+    return f ? f->failed : 1;
+}
+
+uint64_t aio_read_all(AioFile *f, void *dst, uint64_t len) {
+    unsigned char *out = (unsigned char *)dst;
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+
+    if (!f || f->writing || f->inflight > 0) return 0;
+    if (len > f->size) len = f->size;
+    while (completed < len) {
+        while (f->inflight < AIO_DEPTH && submitted < len && !f->failed) {
+            size_t n = len - submitted < AIO_CHUNK ? (size_t)(len - submitted) : AIO_CHUNK;
+            submit(f, (f->head + f->inflight) % AIO_DEPTH, out + submitted, submitted, n);
+            f->inflight++;
+            submitted += n;
+        }
+        if (f->inflight == 0) break;
+
+        AioSlot *slot = &f->slots[f->head];
+        size_t want = slot->len;
+        long long got = wait_slot(f, f->head);
+        f->head = (f->head + 1u) % AIO_DEPTH;
+        f->inflight--;
+        if (got < 0 || (size_t)got != want) {
+            f->failed = 1;
+            drain(f);
+            break;
+        }
+        completed += (uint64_t)got;
+    }
+    return completed;
+}
+
+const void *aio_next(AioFile *f, size_t *len) {
+    long long got;
+    if (len) *len = 0;
+    if (!f || f->writing || f->failed) return NULL;
+    if (!ensure_buffers(f)) return NULL;
+
+    // The slot handed out last time can be reused now.
+    if (f->consumer_holds) {
+        f->head = (f->head + 1u) % AIO_DEPTH;
+        f->inflight--;
+        f->consumer_holds = 0;
+    }
+    while (f->inflight < AIO_DEPTH && f->next_offset < f->size) {
+        unsigned index = (f->head + f->inflight) % AIO_DEPTH;
+        uint64_t left = f->size - f->next_offset;
+        size_t n = left < AIO_CHUNK ? (size_t)left : AIO_CHUNK;
+        submit(f, index, f->slots[index].buf, f->next_offset, n);
+        f->inflight++;
+        f->next_offset += n;
+    }
+    if (f->inflight == 0) return NULL;
+
+    got = wait_slot(f, f->head);
+    f->consumer_holds = 1;
+    if (got <= 0) {
+        if (got < 0) f->failed = 1;
+        return NULL;
+    }
+    if (len) *len = (size_t)got;
+    return f->slots[f->head].buf;
+}
+
+int aio_write(AioFile *f, const void *data, size_t len) {
+    const unsigned char *src = (const unsigned char *)data;
+    if (!f || !f->writing || f->failed) return 0;
+    if (!ensure_buffers(f)) return 0;
+
+    while (len > 0) {
+        unsigned index;
+        size_t n;
+        if (f->inflight == AIO_DEPTH) {
+            wait_slot(f, f->head);
+            f->head = (f->head + 1u) % AIO_DEPTH;
+            f->inflight--;
+            if (f->failed) return 0;
+        }
+        index = (f->head + f->inflight) % AIO_DEPTH;
+        n = AIO_CHUNK - f->fill;
+        if (n > len) n = len;
+        memcpy(f->slots[index].buf + f->fill, src, n);
+        f->fill += n;
+        src += n;
+        len -= n;
+        if (f->fill == AIO_CHUNK) {
+            submit(f, index, f->slots[index].buf, f->next_offset, AIO_CHUNK);
+            f->inflight++;
+            f->next_offset += AIO_CHUNK;
+            f->fill = 0;
+        }
+    }
+    return !f->failed;
+}
@@ -0,0 +1,55 @@
+// File I/O with several requests in flight
+// Backends: io_uring on Linux (raw syscalls, no liburing), overlapped I/O on
+// Windows, a small thread pool doing positional I/O elsewhere or when the
+// preferred backend is unavailable, and plain blocking calls as a baseline.
+// A file is used in one of three ways: one aio_read_all into a caller buffer,
+// a sequential stream of chunks (aio_next), or a sequential writer (aio_write).
+
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AIO_CHUNK (1024u * 1024u)
+#define AIO_DEPTH 8u
+#define AIO_THREADS 4u
+
+typedef enum {
+    AIO_BACKEND_AUTO = 0,
+    AIO_BACKEND_URING,
+    AIO_BACKEND_OVERLAPPED,
+    AIO_BACKEND_THREADS,
+    AIO_BACKEND_SYNC
+} AioBackend;
+
+typedef struct AioFile AioFile;
+
+// Opens for reading, or creates/truncates for writing. An unavailable
+// backend falls back to the thread pool. Returns NULL when the file cannot
+// be opened.
+AioFile *aio_open(const char *path, int for_write, AioBackend backend);
+
+// Waits for requests still in flight. Returns 1 when every request of the
+// file succeeded (for writers: the data is all written).
+int aio_close(AioFile *f);
+
+uint64_t aio_size(const AioFile *f);
+AioBackend aio_backend(const AioFile *f);
+const char *aio_backend_name(AioBackend backend);
+
+// Reads [0, len) into `dst`. Returns the number of bytes read; less than
+// `len` means a read failed or the file was shorter.
+uint64_t aio_read_all(AioFile *f, void *dst, uint64_t len);
+
+// Next chunk of a sequential read, with later chunks already in flight.
+// The pointer stays valid until the next call. NULL at end of file or on
+// error (see aio_failed).
+const void *aio_next(AioFile *f, size_t *len);
+
+// Appends `len` bytes; returns 0 once a write has failed.
+int aio_write(AioFile *f, const void *data, size_t len);
+
+int aio_failed(const AioFile *f);
+
+#endif
@@ -0,0 +1,513 @@
+// Headless batch processing: stats, re-encoding, EOL normalization and search
+// Each file is read in BATCH_CHUNK pieces and pushed through decode -> stats
+// -> search -> (EOL rewrite) -> TextWriter, so buffers are allocated once per
+// file and never grow with its size.
+
+#include "batch.h"
+#include "async_io.h"
+#include "crc32.h"
+#include "eol.h"
+#include "text_writer.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#define BATCH_CHUNK AIO_CHUNK   // input arrives in async_io chunks
+#define BATCH_OUT_BUFFER (64u * 1024u)
+// Worst case for UTF-16 input: an unpaired high surrogate (3 bytes of
+// U+FFFD) followed by a BMP unit (3 bytes) for every 2 input bytes.
+#define BATCH_DECODED_CAP (BATCH_CHUNK * 3u + 16u)
+
+typedef struct {
+    int stats;
+    int convert;
+    TextEncoding target_encoding;
+    int normalize;
+    int eol_auto;
+    TextEol target_eol;
+    const char *find;
+    size_t find_len;
+    const char *output;
+} BatchOptions;
+
+typedef struct {
+    TextEncoding encoding;
+    int has_carry;
+    unsigned char carry;
+    unsigned high;
+} Decoder;
+
+typedef struct {
+    const char *pattern;
+    size_t pattern_len;
+    char *buf;
+    size_t tail_len;
+    uint64_t buf_abs;
+    uint64_t counted;
+    EolScan lines;
+    uint64_t line_start;
+    uint64_t next_allowed;
+    uint64_t matches;
+} Finder;
+
+typedef struct {
+    EolScan eol;
+    uint64_t raw_bytes;
+    uint64_t text_bytes;
+    uint64_t longest;
+    uint64_t current;
+    uint32_t crc;
+    int ends_with_break;
+} Stats;
+
+static const char *const BATCH_ACTIONS[] = {"--stats", "--convert-to=", "--normalize-eol", "--find="};
+
+static int has_prefix(const char *s, const char *prefix) {
+    return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+int batch_is_command(int argc, char **argv) {
+    for (int i = 0; i < argc; i++) {
+        for (size_t k = 0; k < sizeof(BATCH_ACTIONS) / sizeof(BATCH_ACTIONS[0]); k++) {
+            if (argv[i] && has_prefix(argv[i], BATCH_ACTIONS[k])) return 1;
+        }
+    }
+    return 0;
+}
+
+static size_t put_utf8(unsigned cp, char *out) {
+    if (cp < 0x80u) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800u) {
+        out[0] = (char)(0xC0u | (cp >> 6));
+        out[1] = (char)(0x80u | (cp & 0x3Fu));
+        return 2;
+    }
+    if (cp < 0x10000u) {
+        out[0] = (char)(0xE0u | (cp >> 12));
+        out[1] = (char)(0x80u | ((cp >> 6) & 0x3Fu));
+        out[2] = (char)(0x80u | (cp & 0x3Fu));
+        return 3;
+    }
+    out[0] = (char)(0xF0u | (cp >> 18));
+    out[1] = (char)(0x80u | ((cp >> 12) & 0x3Fu));
+    out[2] = (char)(0x80u | ((cp >> 6) & 0x3Fu));
+    out[3] = (char)(0x80u | (cp & 0x3Fu));
+    return 4;
+}
+
+static size_t push_unit(Decoder *d, unsigned unit, char *out) {
+    size_t o = 0;
+    if (d->high) {
+        if (unit >= 0xDC00u && unit <= 0xDFFFu) {
+            unsigned cp = 0x10000u + ((d->high - 0xD800u) << 10) + (unit - 0xDC00u);
+            d->high = 0;
+            return put_utf8(cp, out);
+        }
+        d->high = 0;
+        o += put_utf8(0xFFFDu, out);
+    }
+    if (unit >= 0xD800u && unit <= 0xDBFFu) {
+        d->high = unit;
+    } else if (unit >= 0xDC00u && unit <= 0xDFFFu) {
+        o += put_utf8(0xFFFDu, out + o);
+    } else {
+        o += put_utf8(unit, out + o);
+    }
+    return o;
+}
+
+// Returns the UTF-8 text for `in`; raw and UTF-8 input is passed through.
+static const char *decode_chunk(Decoder *d, const unsigned char *in, size_t len, char *out, size_t *out_len) {
+    int big_endian = (d->encoding == TEXT_ENC_UTF16BE);
+    size_t o = 0;
+
+    if (d->encoding != TEXT_ENC_UTF16LE && !big_endian) {
+        *out_len = len;
+        return (const char *)in;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned unit;
+        if (!d->has_carry) {
+            d->carry = in[i];
+            d->has_carry = 1;
+            continue;
+        }
+        d->has_carry = 0;
+        unit = big_endian ? ((unsigned)d->carry << 8) | in[i] : ((unsigned)in[i] << 8) | d->carry;
+        o += push_unit(d, unit, out + o);
+    }
+    *out_len = o;
+    return out;
+}
+
+static size_t decode_finish(Decoder *d, char *out) {
+    size_t o = 0;
+    if (d->high) {
+        d->high = 0;
+        o += put_utf8(0xFFFDu, out);
+    }
+    if (d->has_carry) {
+        d->has_carry = 0;
+        o += put_utf8(0xFFFDu, out + o);
+    }
+    return o;
+}
+
+static void stats_update(Stats *s, const char *text, size_t len) {
+    uint64_t longest = s->longest;
+    uint64_t current = s->current;
+
+    eol_scan_update(&s->eol, text, len);
+    for (size_t i = 0; i < len; i++) {
+        char c = text[i];
+        if (c == '\n' || c == '\r') {
+            current = 0;
+        } else if (++current > longest) {
+            longest = current;
+        }
+    }
+    if (len > 0) s->ends_with_break = (text[len - 1] == '\n' || text[len - 1] == '\r');
+    s->longest = longest;
+    s->current = current;
+    s->text_bytes += len;
+}
+
+static void print_stats(FILE *out, const char *path, TextEncoding encoding, const Stats *s) {
+    uint64_t breaks = eol_scan_crlf(&s->eol) + eol_scan_lone_lf(&s->eol) + eol_scan_lone_cr(&s->eol);
+    uint64_t lines = breaks + ((s->text_bytes > 0 && !s->ends_with_break) ? 1u : 0u);
+
+    fprintf(out, "%s\n", path);
+    fprintf(out, "  encoding:     %s\n", text_encoding_name(encoding));
+    fprintf(out, "  bytes:        %llu\n", (unsigned long long)s->raw_bytes);
+    fprintf(out, "  text bytes:   %llu\n", (unsigned long long)s->text_bytes);
+    fprintf(out, "  lines:        %llu\n", (unsigned long long)lines);
+    fprintf(out, "  longest line: %llu\n", (unsigned long long)s->longest);
+    fprintf(
+        out, "  line endings: CRLF=%llu LF=%llu CR=%llu (%s%s)\n",
+        (unsigned long long)eol_scan_crlf(&s->eol),
+        (unsigned long long)eol_scan_lone_lf(&s->eol),
+        (unsigned long long)eol_scan_lone_cr(&s->eol),
+        text_eol_name(eol_scan_dominant(&s->eol)),
+        eol_scan_is_mixed(&s->eol) ? ", mixed" : ""
+    );
+    fprintf(out, "  crc32:        %08lx\n", (unsigned long)s->crc);
+}
+
+// Line numbers count '\n', '\r\n' and lone '\r' as one break each.
+static void finder_count_lines(Finder *f, uint64_t upto) {
+    const char *start = f->buf + (size_t)(f->counted - f->buf_abs);
+    const char *p = f->buf + (size_t)(upto - f->buf_abs);
+
+    eol_scan_update(&f->lines, start, (size_t)(p - start));
+    while (p > start) {
+        p--;
+        if (*p == '\n' || *p == '\r') {
+            f->line_start = f->buf_abs + (uint64_t)(p - f->buf) + 1u;
+            break;
+        }
+    }
+    f->counted = upto;
+}
+
+static uint64_t finder_line(const Finder *f) {
+    return 1u + f->lines.cr + f->lines.lf - f->lines.crlf;
+}
+
+static void finder_feed(Finder *f, const char *text, size_t len, FILE *out, const char *path) {
+    size_t total;
+    size_t keep;
+    size_t i = 0;
+    char first = f->pattern[0];
+
+    memcpy(f->buf + f->tail_len, text, len);
+    total = f->tail_len + len;
+
+    while (total >= f->pattern_len && i <= total - f->pattern_len) {
+        const char *hit = (const char *)memchr(f->buf + i, first, total - f->pattern_len + 1u - i);
+        uint64_t abs;
+        if (!hit) break;
+        i = (size_t)(hit - f->buf);
+        abs = f->buf_abs + i;
+        if (abs >= f->next_allowed && memcmp(hit, f->pattern, f->pattern_len) == 0) {
+            finder_count_lines(f, abs);
+            fprintf(
+                out, "%s:%llu:%llu\n", path,
+                (unsigned long long)finder_line(f), (unsigned long long)(abs - f->line_start + 1u)
+            );
+            f->matches++;
+            f->next_allowed = abs + f->pattern_len;
+        }
+        i++;
+    }
+
+    // The last pattern_len - 1 bytes may start a match that ends in the next chunk.
+    keep = f->pattern_len - 1u;
+    if (keep > total) keep = total;
+    if (f->counted < f->buf_abs + (total - keep)) finder_count_lines(f, f->buf_abs + (total - keep));
+    memmove(f->buf, f->buf + (total - keep), keep);
+    f->buf_abs += total - keep;
+    f->tail_len = keep;
+}
+
+static int file_sink(void *ctx, const void *data, size_t len) {
+    return aio_write((AioFile *)ctx, data, len);
+}
+
+static int replace_file(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+typedef struct {
+    char *decoded;
+    char *crlf;
+    char *find_buf;
+    unsigned char *out_buf;
+} BatchBuffers;
+
+// Reads the whole file once just to learn its dominant line-ending style.
+static int scan_dominant_eol(const char *path, BatchBuffers *b, TextEol *out_eol) {
+    AioFile *in = aio_open(path, 0, AIO_BACKEND_AUTO);
+    Decoder dec = {TEXT_ENC_RAW, 0, 0, 0};
+    EolScan scan;
+    const unsigned char *raw;
+    int first = 1;
+    size_t n;
+
+    if (!in) return 0;
+    eol_scan_init(&scan);
+    while ((raw = (const unsigned char *)aio_next(in, &n)) != NULL) {
+        size_t skip = 0;
+        size_t text_len;
+        const char *text;
+        if (first) {
+            skip = text_detect_bom(raw, n, &dec.encoding);
+            first = 0;
+        }
+        text = decode_chunk(&dec, raw + skip, n - skip, b->decoded, &text_len);
+        eol_scan_update(&scan, text, text_len);
+    }
+    if (!aio_close(in)) return 0;
+    *out_eol = eol_scan_dominant(&scan);
+    return 1;
+}
+
+static int emit_text(TextWriter *writer, const BatchOptions *opts, BatchBuffers *b, const char *text, size_t len, int *after_cr) {
+    if (opts->normalize) {
+        size_t crlf_len = eol_to_crlf(text, len, b->crlf, after_cr);
+        return text_writer_write(writer, b->crlf, crlf_len);
+    }
+    return text_writer_write(writer, text, len);
+}
+
+static int process_file(const char *path, const BatchOptions *opts, BatchBuffers *b, FILE *out, FILE *err, uint64_t *matches) {
+    AioFile *in;
+    AioFile *dst = NULL;
+    const unsigned char *raw;
+    Decoder dec = {TEXT_ENC_RAW, 0, 0, 0};
+    Stats stats;
+    Finder finder;
+    TextWriter writer;
+    TextFormat format;
+    char tmp_path[4096];
+    const char *dst_path = NULL;
+    int writing = opts->convert || opts->normalize;
+    int in_place = writing && (!opts->output || strcmp(opts->output, path) == 0);
+    int after_cr = 0;
+    int ok = 1;
+    size_t skip;
+    size_t n;
+
+    memset(&stats, 0, sizeof(stats));
+    eol_scan_init(&stats.eol);
+    memset(&finder, 0, sizeof(finder));
+    finder.pattern = opts->find;
+    finder.pattern_len = opts->find_len;
+    finder.buf = b->find_buf;
+    eol_scan_init(&finder.lines);
+    memset(&writer, 0, sizeof(writer));
+
+    format.eol = TEXT_EOL_CRLF;
+    if (opts->normalize) {
+        format.eol = opts->target_eol;
+        if (opts->eol_auto && !scan_dominant_eol(path, b, &format.eol)) {
+            fprintf(err, "%s: cannot open\n", path);
+            return 0;
+        }
+    }
+
+    in = aio_open(path, 0, AIO_BACKEND_AUTO);
+    if (!in) {
+        fprintf(err, "%s: cannot open\n", path);
+        return 0;
+    }
+
+    raw = (const unsigned char *)aio_next(in, &n);
+    skip = text_detect_bom(raw, n, &dec.encoding);
+    if (writing) {
+        format.encoding = opts->convert ? opts->target_encoding : dec.encoding;
+        dst_path = opts->output;
+        if (in_place) {
+            int len = snprintf(tmp_path, sizeof(tmp_path), "%s.batch~", path);
+            dst_path = (len > 0 && (size_t)len < sizeof(tmp_path)) ? tmp_path : NULL;
+        }
+        dst = dst_path ? aio_open(dst_path, 1, AIO_BACKEND_AUTO) : NULL;
+        if (!dst) {
+            fprintf(err, "%s: cannot create output\n", path);
+            aio_close(in);
+            return 0;
+        }
+        text_writer_init(&writer, format, b->out_buf, BATCH_OUT_BUFFER, file_sink, dst);
+    }
+
+    while (raw) {
+        size_t text_len;
+        const char *text;
+
+        stats.raw_bytes += n;
+        stats.crc = crc32_update(stats.crc, raw, n);
+        text = decode_chunk(&dec, raw + skip, n - skip, b->decoded, &text_len);
+        if (opts->stats) stats_update(&stats, text, text_len);
+        if (opts->find) finder_feed(&finder, text, text_len, out, path);
+        if (dst && !emit_text(&writer, opts, b, text, text_len, &after_cr)) {
+            ok = 0;
+            break;
+        }
+        skip = 0;
+        raw = (const unsigned char *)aio_next(in, &n);
+    }
+    if (!aio_close(in)) {
+        fprintf(err, "%s: read failed\n", path);
+        ok = 0;
+    }
+
+    if (ok) {
+        size_t tail_len = decode_finish(&dec, b->decoded);
+        if (opts->stats) stats_update(&stats, b->decoded, tail_len);
+        if (opts->find) finder_feed(&finder, b->decoded, tail_len, out, path);
+        if (dst && tail_len > 0) ok = emit_text(&writer, opts, b, b->decoded, tail_len, &after_cr);
+    }
+    if (dst) {
+        if (ok) ok = text_writer_finish(&writer);
+        if (!aio_close(dst)) ok = 0;
+        if (!ok) {
+            fprintf(err, "%s: write failed\n", dst_path);
+        } else if (in_place && !replace_file(dst_path, path)) {
+            fprintf(err, "%s: cannot replace original\n", path);
+            ok = 0;
+        }
+        if (!ok) remove(dst_path);
+    }
+
+    if (ok && opts->stats) print_stats(out, path, dec.encoding, &stats);
+    if (ok && writing) {
+        // Without --normalize-eol the line endings go through unchanged.
+        fprintf(
+            out, "%s: wrote %s, %s, %llu bytes\n",
+            path, text_encoding_name(format.encoding), opts->normalize ? text_eol_name(format.eol) : "line endings kept",
+            (unsigned long long)writer.bytes_out
+        );
+    }
+    *matches += finder.matches;
+    return ok;
+}
+
+static int parse_options(int argc, char **argv, BatchOptions *opts, FILE *err) {
+    memset(opts, 0, sizeof(*opts));
+    for (int i = 0; i < argc; i++) {
+        const char *a = argv[i];
+        if (strcmp(a, "--stats") == 0) {
+            opts->stats = 1;
+        } else if (has_prefix(a, "--convert-to=")) {
+            const char *enc = a + strlen("--convert-to=");
+            opts->convert = 1;
+            if (strcmp(enc, "utf8") == 0 || strcmp(enc, "utf-8") == 0) opts->target_encoding = TEXT_ENC_RAW;
+            else if (strcmp(enc, "utf8-bom") == 0) opts->target_encoding = TEXT_ENC_UTF8_BOM;
+            else if (strcmp(enc, "utf16le") == 0) opts->target_encoding = TEXT_ENC_UTF16LE;
+            else if (strcmp(enc, "utf16be") == 0) opts->target_encoding = TEXT_ENC_UTF16BE;
+            else {
+                fprintf(err, "unknown encoding '%s' (utf8, utf8-bom, utf16le, utf16be)\n", enc);
+                return 0;
+            }
+        } else if (strcmp(a, "--normalize-eol") == 0) {
+            opts->normalize = 1;
+            opts->eol_auto = 1;
+        } else if (has_prefix(a, "--normalize-eol=")) {
+            const char *style = a + strlen("--normalize-eol=");
+            opts->normalize = 1;
+            if (strcmp(style, "crlf") == 0) opts->target_eol = TEXT_EOL_CRLF;
+            else if (strcmp(style, "lf") == 0) opts->target_eol = TEXT_EOL_LF;
+            else if (strcmp(style, "cr") == 0) opts->target_eol = TEXT_EOL_CR;
+            else {
+                fprintf(err, "unknown line ending '%s' (crlf, lf, cr)\n", style);
+                return 0;
+            }
+        } else if (has_prefix(a, "--find=")) {
+            opts->find = a + strlen("--find=");
+            opts->find_len = strlen(opts->find);
+            if (opts->find_len == 0 || opts->find_len > BATCH_CHUNK) {
+                fprintf(err, "--find needs a pattern of 1 to %u bytes\n", BATCH_CHUNK);
+                return 0;
+            }
+        } else if (has_prefix(a, "--output=")) {
+            opts->output = a + strlen("--output=");
+        }
+    }
+    return 1;
+}
+
+int batch_main(int argc, char **argv, FILE *out, FILE *err) {
+    BatchOptions opts;
+    BatchBuffers b;
+    uint64_t matches = 0;
+    int files = 0;
+    int failed = 0;
+
+    if (!parse_options(argc, argv, &opts, err)) return 2;
+    for (int i = 0; i < argc; i++) {
+        if (argv[i][0] != '-') files++;
+    }
+    if (files == 0) {
+        fprintf(err, "no input files\n");
+        return 2;
+    }
+    if (opts.output && files > 1) {
+        fprintf(err, "--output needs exactly one input file\n");
+        return 2;
+    }
+
+    memset(&b, 0, sizeof(b));
+    b.decoded = (char *)malloc(BATCH_DECODED_CAP);
+    b.crlf = opts.normalize ? (char *)malloc(BATCH_DECODED_CAP * 2u) : NULL;
+    b.find_buf = opts.find ? (char *)malloc(BATCH_DECODED_CAP + opts.find_len) : NULL;
+    b.out_buf = (unsigned char *)malloc(BATCH_OUT_BUFFER);
+    if (!b.decoded || !b.out_buf || (opts.normalize && !b.crlf) || (opts.find && !b.find_buf)) {
+        fprintf(err, "out of memory\n");
+        failed = 1;
+    } else {
+        for (int i = 0; i < argc; i++) {
+            if (argv[i][0] == '-') continue;
+            if (!process_file(argv[i], &opts, &b, out, err, &matches)) failed = 1;
+        }
+    }
+
+    free(b.decoded);
+    free(b.crlf);
+    free(b.find_buf);
+    free(b.out_buf);
+
+    if (failed) return 2;
+    if (opts.find && matches == 0) return 1;
+    return 0;
+}
@@ -0,0 +1,24 @@
+// Headless batch processing: stats, re-encoding, EOL normalization and search
+// Files are streamed in fixed-size chunks, so memory use does not grow with
+// file size.
+//
+//   --stats                     print size, encoding, line and EOL counts, CRC-32
+//   --convert-to=ENC            rewrite as utf8, utf8-bom, utf16le or utf16be
+//   --normalize-eol[=STYLE]     rewrite line breaks as crlf, lf or cr (default: dominant style)
+//   --find=PATTERN              print path:line:column for each match
+//   --output=PATH               write the converted file here instead of in place
+//
+// Anything else starting with '-' is ignored so GUI flags can share a command line.
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+// Non-zero when argv contains at least one batch action.
+int batch_is_command(int argc, char **argv);
+
+// Returns 0 on success, 1 when --find matched nothing, 2 on errors.
+int batch_main(int argc, char **argv, FILE *out, FILE *err);
+
+#endif
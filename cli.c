@@ -0,0 +1,19 @@
+// Command-line entry point for the headless batch engine (no window)
+// Build: cc -O2 -Wall -Wextra -std=c11 cli.c batch.c text_writer.c eol.c crc32.c sys_thread.c async_io.c -o editor-cli
+
+#include "batch.h"
+
+#include <stdio.h>
+
+int main(int argc, char **argv) {
+    if (argc < 2 || !batch_is_command(argc - 1, argv + 1)) {
+        fprintf(
+            stderr,
+            "usage: %s [--stats] [--convert-to=utf8|utf8-bom|utf16le|utf16be]\n"
+            "          [--normalize-eol[=crlf|lf|cr]] [--find=PATTERN] [--output=PATH] FILE...\n",
+            argv[0]
+        );
+        return 2;
+    }
+    return batch_main(argc - 1, argv + 1, stdout, stderr);
+}
@@ -0,0 +1,12 @@
+// CRC-32 (IEEE 802.3, reflected, as used by gzip and the edit journal)
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Start with crc = 0; feed the previous result to continue a running checksum.
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+#endif
@@ -0,0 +1,367 @@
+// CSV/TSV row index with on-demand field splitting
+
+#include "csv_index.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSV_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#define CSV_BLOCK 16u
+#define CSV_READ_CHUNK (16u * 1024u)
+#define CSV_HEAD_ROWS 64u
+#define CSV_DETECT_BYTES (64u * 1024u)
+
+void csv_index_init(CsvIndex *idx, char sep) {
+    memset(idx, 0, sizeof(*idx));
+    idx->sep = sep;
+}
+
+void csv_index_free(CsvIndex *idx) {
+    free(idx->points);
+    memset(idx, 0, sizeof(*idx));
+}
+
+static unsigned count_bits(unsigned m) {
+    m = m - ((m >> 1) & 0x55555555u);
+    m = (m & 0x33333333u) + ((m >> 2) & 0x33333333u);
+    m = (m + (m >> 4)) & 0x0F0F0F0Fu;
+    return (m * 0x01010101u) >> 24;
+}
+
+static unsigned lowest_bit(unsigned m) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctz(m);
+#else
+    unsigned n = 0;
+    while (!(m & 1u)) {
+        m >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// Bit i set when p[i] is a quote, a line feed and the separator respectively.
+static void block_masks(const unsigned char *p, char sep, unsigned *quote, unsigned *nl, unsigned *sp) {
+#ifdef CSV_SSE2
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    *quote = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    *nl = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+    *sp = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(sep)));
+#else
+    unsigned mq = 0;
+    unsigned mn = 0;
+    unsigned ms = 0;
+    for (unsigned i = 0; i < CSV_BLOCK; i++) {
+        if (p[i] == '"') mq |= 1u << i;
+        if (p[i] == '\n') mn |= 1u << i;
+        if (p[i] == (unsigned char)sep) ms |= 1u << i;
+    }
+    *quote = mq;
+    *nl = mn;
+    *sp = ms;
+#endif
+}
+
+// Bit i of the result is the parity of quotes at or before i, i.e. whether
+// byte i sits inside a quoted field. A doubled quote toggles twice, so RFC
+// 4180 escapes need no special case.
+static unsigned prefix_xor(unsigned m) {
+    m ^= m << 1;
+    m ^= m << 2;
+    m ^= m << 4;
+    m ^= m << 8;
+    return m & 0xFFFFu;
+}
+
+static int end_row(CsvIndex *idx, uint64_t next_start) {
+    unsigned fields = idx->fields + 1u;
+    if (fields > idx->max_fields) idx->max_fields = fields;
+    idx->fields = 0;
+    idx->open_row = next_start;
+    idx->rows++;
+    if (idx->rows % CSV_ROW_STRIDE != 0) return 1;
+
+    if (idx->count == idx->cap) {
+        size_t cap = idx->cap ? idx->cap * 2u : 256u;
+        uint64_t *points = (uint64_t *)realloc(idx->points, cap * sizeof(uint64_t));
+        if (!points) return 0;
+        idx->points = points;
+        idx->cap = cap;
+    }
+    idx->points[idx->count++] = next_start;
+    return 1;
+}
+
+int csv_index_feed(CsvIndex *idx, const char *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    unsigned inside = idx->in_quotes ? 0xFFFFu : 0u;
+    size_t i = 0;
+
+    if (idx->count == 0) {
+        // Row 0 always starts at 0; keeping it in the table makes every
+        // lookup the same.
+        idx->points = (uint64_t *)malloc(256u * sizeof(uint64_t));
+        if (!idx->points) return 0;
+        idx->cap = 256u;
+        idx->points[0] = 0;
+        idx->count = 1;
+    }
+
+    for (; i + CSV_BLOCK <= len; i += CSV_BLOCK) {
+        unsigned quote;
+        unsigned nl;
+        unsigned sp;
+        unsigned ends;
+        block_masks(p + i, idx->sep, &quote, &nl, &sp);
+        if (!(quote | nl | sp) && !inside) continue;
+
+        inside = prefix_xor(quote) ^ (inside ? 0xFFFFu : 0u);
+        ends = nl & ~inside;
+        sp &= ~inside;
+        while (ends) {
+            unsigned bit = lowest_bit(ends);
+            unsigned below = (1u << bit) - 1u;
+            idx->fields += count_bits(sp & below);
+            sp &= ~(below | (1u << bit));
+            if (!end_row(idx, idx->scanned + i + bit + 1u)) return 0;
+            ends &= ends - 1u;
+        }
+        idx->fields += count_bits(sp);
+        inside = (inside >> 15) & 1u;
+    }
+    for (; i < len; i++) {
+        unsigned c = p[i];
+        if (c == '"') {
+            inside = !inside;
+        } else if (!inside && c == '\n') {
+            if (!end_row(idx, idx->scanned + i + 1u)) return 0;
+        } else if (!inside && c == (unsigned char)idx->sep) {
+            idx->fields++;
+        }
+    }
+
+    idx->in_quotes = inside != 0;
+    idx->scanned += len;
+    return 1;
+}
+
+int csv_index_finish(CsvIndex *idx) {
+    if (idx->finished) return 1;
+    idx->finished = 1;
+    if (idx->open_row == idx->scanned) return 1;
+    return end_row(idx, idx->scanned);
+}
+
+uint64_t csv_index_rows(const CsvIndex *idx) {
+    return idx->rows;
+}
+
+unsigned csv_index_columns(const CsvIndex *idx) {
+    return idx->max_fields;
+}
+
+// Scans forward from the checkpoint at or before `first`; at most
+// CSV_ROW_STRIDE - 1 rows are skipped before the wanted ones start.
+size_t csv_index_locate(const CsvIndex *idx, uint64_t first, size_t count, CsvReadFn read, void *ctx, uint64_t *offsets) {
+    char buf[CSV_READ_CHUNK];
+    uint64_t row;
+    uint64_t at;
+    size_t got = 0;
+    int inside = 0;
+
+    if (first >= idx->rows || count == 0) return 0;
+    if (count > idx->rows - first) count = (size_t)(idx->rows - first);
+
+    row = first - first % CSV_ROW_STRIDE;
+    at = idx->points[first / CSV_ROW_STRIDE];
+    if (row == first) offsets[got++] = at;
+    while (got <= count) {
+        size_t n = read(ctx, at, buf, sizeof(buf));
+        if (n == 0) break;
+        for (size_t i = 0; i < n; i++) {
+            char c = buf[i];
+            if (c == '"') {
+                inside = !inside;
+            } else if (c == '\n' && !inside) {
+                row++;
+                if (row < first) continue;
+                offsets[row - first] = at + i + 1u;
+                got = (size_t)(row - first) + 1u;
+                if (got > count) break;
+            }
+        }
+        at += n;
+    }
+
+    // Only the document's last row can run out without a line break.
+    if (got == count) offsets[got++] = idx->scanned;
+    return got ? got - 1u : 0;
+}
+
+size_t csv_split_row(const char *row, size_t len, char sep, CsvField *fields, size_t max) {
+    size_t n = 0;
+    size_t start = 0;
+    int inside = 0;
+
+    if (len && row[len - 1u] == '\n') len--;
+    if (len && row[len - 1u] == '\r') len--;
+    for (size_t i = 0; i <= len; i++) {
+        if (i < len) {
+            if (row[i] == '"') {
+                inside = !inside;
+                continue;
+            }
+            if (inside || row[i] != sep) continue;
+        }
+        if (n < max) {
+            fields[n].start = start;
+            fields[n].len = i - start;
+            fields[n].quoted = i > start && row[start] == '"';
+        }
+        n++;
+        start = i + 1u;
+    }
+    return n;
+}
+
+size_t csv_field_text(const char *row, const CsvField *field, char *dst, size_t cap) {
+    const char *p = row + field->start;
+    size_t len = field->len;
+    size_t n = 0;
+
+    if (!field->quoted) {
+        n = len < cap ? len : cap;
+        memcpy(dst, p, n);
+        return n;
+    }
+    // Text after the closing quote is kept as it stands, like spreadsheet
+    // programs do with slightly malformed fields.
+    for (size_t i = 1; i < len && n < cap; i++) {
+        if (p[i] == '"') {
+            if (i + 1u < len && p[i + 1u] == '"') {
+                dst[n++] = '"';
+                i++;
+            }
+            continue;
+        }
+        dst[n++] = p[i];
+    }
+    return n;
+}
+
+char csv_detect_separator(const char *text, size_t len) {
+    static const char CANDIDATES[] = {',', '\t', ';', '|'};
+    unsigned first[4] = {0};
+    unsigned total[4] = {0};
+    unsigned counts[4] = {0};
+    int steady[4] = {1, 1, 1, 1};
+    unsigned lines = 0;
+    int inside = 0;
+    int best = -1;
+
+    if (len > CSV_DETECT_BYTES) len = CSV_DETECT_BYTES;
+    for (size_t i = 0; i < len && lines < 16u; i++) {
+        char c = text[i];
+        if (c == '"') {
+            inside = !inside;
+            continue;
+        }
+        if (inside) continue;
+        if (c == '\n') {
+            for (unsigned k = 0; k < 4u; k++) {
+                if (lines == 0) first[k] = counts[k];
+                else if (counts[k] != first[k]) steady[k] = 0;
+                total[k] += counts[k];
+                counts[k] = 0;
+            }
+            lines++;
+            continue;
+        }
+        for (unsigned k = 0; k < 4u; k++) {
+            counts[k] += c == CANDIDATES[k];
+        }
+    }
+    if (lines == 0) {
+        for (unsigned k = 0; k < 4u; k++) {
+            total[k] = counts[k];
+            first[k] = counts[k];
+        }
+    }
+
+    // A separator that splits every line into the same number of fields
+    // wins; otherwise the most frequent one does.
+    for (unsigned k = 0; k < 4u; k++) {
+        if (steady[k] && first[k] > 0 && (best < 0 || first[k] > first[best])) best = (int)k;
+    }
+    if (best < 0) {
+        for (unsigned k = 0; k < 4u; k++) {
+            if (total[k] > 0 && (best < 0 || total[k] > total[best])) best = (int)k;
+        }
+    }
+    return best < 0 ? ',' : CANDIDATES[best];
+}
+
+static unsigned text_width(const char *text, size_t len, int utf8) {
+    unsigned width = 0;
+    if (!utf8) return (unsigned)len;
+    for (size_t i = 0; i < len; i++) {
+        width += ((unsigned char)text[i] & 0xC0u) != 0x80u;
+    }
+    return width;
+}
+
+static void widen_from_row(const CsvIndex *idx, CsvReadFn read, void *ctx, uint64_t row, unsigned *widths, size_t columns, int utf8, char *buf, CsvField *fields) {
+    char text[CSV_MAX_WIDTH * 4u];
+    uint64_t span[2];
+    size_t len;
+    size_t count;
+
+    if (csv_index_locate(idx, row, 1, read, ctx, span) != 1) return;
+    len = span[1] - span[0] < CSV_SAMPLE_ROW ? (size_t)(span[1] - span[0]) : CSV_SAMPLE_ROW;
+    len = read(ctx, span[0], buf, len);
+    count = csv_split_row(buf, len, idx->sep, fields, columns);
+    if (count > columns) count = columns;
+    for (size_t c = 0; c < count; c++) {
+        size_t n = csv_field_text(buf, &fields[c], text, sizeof(text));
+        unsigned width = text_width(text, n, utf8);
+        if (width > CSV_MAX_WIDTH) width = CSV_MAX_WIDTH;
+        if (width > widths[c]) widths[c] = width;
+    }
+}
+
+// Widths come from a fixed number of rows whatever the file size, so a
+// multi-gigabyte file costs the same as a small one; the rare wider cell is
+// clipped when drawn.
+void csv_sample_widths(const CsvIndex *idx, CsvReadFn read, void *ctx, unsigned *widths, size_t columns, unsigned samples, int utf8) {
+    char *buf;
+    CsvField *fields;
+    uint64_t rows = idx->rows;
+    uint64_t head = rows < CSV_HEAD_ROWS ? rows : CSV_HEAD_ROWS;
+
+    if (columns == 0 || rows == 0) return;
+    buf = (char *)malloc(CSV_SAMPLE_ROW);
+    fields = (CsvField *)malloc(columns * sizeof(CsvField));
+    if (!buf || !fields) {
+        free(buf);
+        free(fields);
+        return;
+    }
+
+    for (uint64_t r = 0; r < head; r++) {
+        widen_from_row(idx, read, ctx, r, widths, columns, utf8, buf, fields);
+    }
+    if (rows > head) {
+        uint64_t rest = rows - head;
+        if (samples > rest) samples = (unsigned)rest;
+        for (unsigned k = 0; k < samples; k++) {
+            widen_from_row(idx, read, ctx, head + rest * k / samples, widths, columns, utf8, buf, fields);
+        }
+    }
+    free(buf);
+    free(fields);
+}
@@ -0,0 +1,75 @@
+// CSV/TSV row index with on-demand field splitting
+// The index is built in one streaming pass that finds row ends outside
+// quoted fields 16 bytes at a time, and keeps only the start offset of every
+// CSV_ROW_STRIDE-th row. Any row is found by scanning forward from the
+// checkpoint before it, so the index costs about 8 bytes per 64 rows and the
+// fields of the rows on screen are split only when they are drawn.
+
+#ifndef CSV_INDEX_H
+#define CSV_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CSV_ROW_STRIDE 64u
+#define CSV_MAX_WIDTH 48u          // cap for sampled column widths, in characters
+#define CSV_SAMPLE_ROW 4096u       // bytes of a sampled row looked at
+
+// Reads up to `len` document bytes at `offset`; returns the number read.
+typedef size_t (*CsvReadFn)(void *ctx, uint64_t offset, char *dst, size_t len);
+
+typedef struct {
+    char sep;
+    int in_quotes;
+    uint64_t scanned;           // bytes fed so far
+    uint64_t rows;              // rows ended by a line break (plus the last one once finished)
+    uint64_t open_row;          // start of the row being scanned
+    uint64_t *points;           // start of rows 0, CSV_ROW_STRIDE, 2 * CSV_ROW_STRIDE, ...
+    size_t count;
+    size_t cap;
+    unsigned fields;            // separators seen in the open row
+    unsigned max_fields;
+    int finished;
+} CsvIndex;
+
+typedef struct {
+    size_t start;               // inside the row, quotes included
+    size_t len;
+    int quoted;
+} CsvField;
+
+void csv_index_init(CsvIndex *idx, char sep);
+void csv_index_free(CsvIndex *idx);
+
+// Feeds the next bytes of the document. Returns 0 when out of memory.
+int csv_index_feed(CsvIndex *idx, const char *data, size_t len);
+
+// Counts a final row that has no line break after it.
+int csv_index_finish(CsvIndex *idx);
+
+uint64_t csv_index_rows(const CsvIndex *idx);
+unsigned csv_index_columns(const CsvIndex *idx);
+
+// Fills `offsets` with the start of rows [first, first + count) followed by
+// the end of the last one (count + 1 values; a row ends after its line
+// break). Returns the number of rows located, clamped to the indexed rows.
+size_t csv_index_locate(const CsvIndex *idx, uint64_t first, size_t count, CsvReadFn read, void *ctx, uint64_t *offsets);
+
+// Splits one row (its line break may be included) into at most `max`
+// fields. Returns the row's full field count, which may exceed `max`.
+size_t csv_split_row(const char *row, size_t len, char sep, CsvField *fields, size_t max);
+
+// Copies a field's text with the surrounding quotes removed and doubled
+// quotes collapsed; returns the bytes written (at most `cap`).
+size_t csv_field_text(const char *row, const CsvField *field, char *dst, size_t cap);
+
+// Picks ',', ';', '\t' or '|' by counting them outside quotes in the first
+// rows; falls back to ','.
+char csv_detect_separator(const char *text, size_t len);
+
+// Widens `widths[0..columns)` (in characters, capped at CSV_MAX_WIDTH) from
+// the first rows plus `samples` rows spread evenly over the index. With
+// `utf8` set, continuation bytes do not count as characters.
+void csv_sample_widths(const CsvIndex *idx, CsvReadFn read, void *ctx, unsigned *widths, size_t columns, unsigned samples, int utf8);
+
+#endif
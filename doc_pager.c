@@ -0,0 +1,433 @@
+// Memory budget for document pages, with cold pages compressed or spilled
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "doc_pager.h"
+#include "lz_block.h"
+#include "mem_account.h"
+#include "sys_thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    DocPage *oldest;
+    DocPage *newest;
+    size_t count;
+} PageList;
+
+typedef struct {
+    SysMutex lock;              // guards everything below and every page's fields
+    uint64_t budget;
+    uint64_t resident;
+    uint64_t peak;
+    uint64_t spilled_pages;
+    uint64_t packed_bytes;
+    uint64_t packed_from;
+    uint64_t page_ins;
+    uint64_t page_outs;
+    uint64_t unpacks;
+    uint64_t spill_failures;
+    int no_compression;
+    PageList hot;               // raw, most recently unpinned
+    PageList cold;              // compressed, or raw when packing did not pay
+    char scratch[DOC_PAGE_SIZE];    // packing output and packed swap reads
+#ifdef _WIN32
+    HANDLE swap;
+#else
+    int swap;
+#endif
+    int swap_open;
+    int64_t next_slot;          // the swap file is this many pages long
+    int64_t *free_slots;
+    size_t free_count;
+    size_t free_cap;
+    size_t slots_in_use;
+} DocPager;
+
+static DocPager g_pager;
+static SysOnce g_pager_once = SYS_ONCE_INIT;
+
+static void pager_init(void) {
+    sys_mutex_init(&g_pager.lock);
+}
+
+static void pager_lock(void) {
+    sys_once(&g_pager_once, pager_init);
+    sys_mutex_lock(&g_pager.lock);
+}
+
+static void pager_unlock(void) {
+    sys_mutex_unlock(&g_pager.lock);
+}
+
+// The swap file is created on the first spill and deleted by the system
+// when it is closed, which happens as soon as no page holds a slot.
+static int open_swap(void) {
+#ifdef _WIN32
+    char dir[MAX_PATH];
+    char path[MAX_PATH];
+    DWORD n = GetTempPathA(MAX_PATH, dir);
+    if (n == 0 || n >= MAX_PATH || !GetTempFileNameA(dir, "eds", 0, path)) return 0;
+    g_pager.swap = CreateFileA(
+        path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL
+    );
+    if (g_pager.swap == INVALID_HANDLE_VALUE) {
+        DeleteFileA(path);
+        return 0;
+    }
+#else
+    char path[4096];
+    const char *dir = getenv("TMPDIR");
+    if (!dir || !dir[0]) dir = "/tmp";
+    snprintf(path, sizeof(path), "%s/editor-swap-XXXXXX", dir);
+    g_pager.swap = mkstemp(path);
+    if (g_pager.swap < 0) return 0;
+    unlink(path);
+#endif
+    g_pager.swap_open = 1;
+    return 1;
+}
+
+static void close_swap(void) {
+    if (!g_pager.swap_open) return;
+#ifdef _WIN32
+    CloseHandle(g_pager.swap);
+#else
+    close(g_pager.swap);
+#endif
+    g_pager.swap_open = 0;
+    g_pager.next_slot = 0;
+    g_pager.free_count = 0;
+}
+
+static int write_slot(int64_t slot, const char *data, size_t len) {
+    uint64_t offset = (uint64_t)slot * DOC_PAGE_SIZE;
+#ifdef _WIN32
+    OVERLAPPED ov;
+    DWORD written = 0;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD)offset;
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+    return WriteFile(g_pager.swap, data, (DWORD)len, &written, &ov) && written == (DWORD)len;
+#else
+    while (len > 0) {
+        ssize_t n = pwrite(g_pager.swap, data, len, (off_t)offset);
+        if (n <= 0) return 0;
+        data += n;
+        offset += (uint64_t)n;
+        len -= (size_t)n;
+    }
+    return 1;
+#endif
+}
+
+static int read_slot(int64_t slot, char *data, size_t len) {
+    uint64_t offset = (uint64_t)slot * DOC_PAGE_SIZE;
+#ifdef _WIN32
+    OVERLAPPED ov;
+    DWORD got = 0;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD)offset;
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+    return ReadFile(g_pager.swap, data, (DWORD)len, &got, &ov) && got == (DWORD)len;
+#else
+    while (len > 0) {
+        ssize_t n = pread(g_pager.swap, data, len, (off_t)offset);
+        if (n <= 0) return 0;
+        data += n;
+        offset += (uint64_t)n;
+        len -= (size_t)n;
+    }
+    return 1;
+#endif
+}
+
+static int64_t take_slot(void) {
+    g_pager.slots_in_use++;
+    if (g_pager.free_count > 0) return g_pager.free_slots[--g_pager.free_count];
+    return g_pager.next_slot++;
+}
+
+static void release_slot(int64_t slot) {
+    g_pager.slots_in_use--;
+    if (g_pager.slots_in_use == 0) {
+        close_swap();
+        return;
+    }
+    if (g_pager.free_count == g_pager.free_cap) {
+        size_t cap = g_pager.free_cap ? g_pager.free_cap * 2u : 64u;
+        int64_t *grown = (int64_t *)realloc(g_pager.free_slots, cap * sizeof(int64_t));
+        if (!grown) return;   // the slot is simply never reused
+        g_pager.free_slots = grown;
+        g_pager.free_cap = cap;
+    }
+    g_pager.free_slots[g_pager.free_count++] = slot;
+}
+
+static void lru_unlink(DocPage *p) {
+    PageList *list = p->cold ? &g_pager.cold : &g_pager.hot;
+    if (p->older) p->older->newer = p->newer; else list->oldest = p->newer;
+    if (p->newer) p->newer->older = p->older; else list->newest = p->older;
+    p->older = NULL;
+    p->newer = NULL;
+    list->count--;
+}
+
+static void lru_push(DocPage *p, int cold) {
+    PageList *list = cold ? &g_pager.cold : &g_pager.hot;
+    p->cold = cold;
+    p->older = list->newest;
+    p->newer = NULL;
+    if (list->newest) list->newest->newer = p; else list->oldest = p;
+    list->newest = p;
+    list->count++;
+}
+
+static void add_resident(uint64_t bytes) {
+    g_pager.resident += bytes;
+    if (g_pager.resident > g_pager.peak) g_pager.peak = g_pager.resident;
+    mem_account_alloc(MEM_DOCUMENT, (size_t)bytes);
+}
+
+static void sub_resident(uint64_t bytes) {
+    g_pager.resident -= bytes;
+    mem_account_free(MEM_DOCUMENT, (size_t)bytes);
+}
+
+static void drop_packed(DocPage *p) {
+    free(p->packed);
+    p->packed = NULL;
+    sub_resident(p->packed_len);
+    g_pager.packed_bytes -= p->packed_len;
+    g_pager.packed_from -= p->used;
+    p->packed_len = 0;
+}
+
+// Moves the oldest hot page to the cold list, packed when that saves at
+// least an eighth of it.
+static void cool_oldest(void) {
+    DocPage *p = g_pager.hot.oldest;
+    size_t n = 0;
+    char *packed = NULL;
+
+    lru_unlink(p);
+    if (!g_pager.no_compression && p->used > 0) {
+        n = lz_block_compress(p->data, p->used, g_pager.scratch, p->used - p->used / 8u);
+    }
+    if (n > 0) packed = (char *)malloc(n);
+    if (packed) {
+        memcpy(packed, g_pager.scratch, n);
+        free(p->data);
+        p->data = NULL;
+        p->packed = packed;
+        p->packed_len = (uint32_t)n;
+        sub_resident(DOC_PAGE_SIZE);
+        add_resident(n);
+        g_pager.packed_bytes += n;
+        g_pager.packed_from += p->used;
+    }
+    lru_push(p, 1);
+}
+
+// Writes the page out unless the swap file already has its bytes. A packed
+// page is written packed.
+static int spill(DocPage *p) {
+    const char *bytes = p->packed ? p->packed : p->data;
+    size_t len = p->packed ? p->packed_len : p->used;
+
+    if (p->used > 0 && (p->dirty || p->slot < 0)) {
+        if (!g_pager.swap_open && !open_swap()) return 0;
+        if (p->slot < 0) p->slot = take_slot();
+        if (!write_slot(p->slot, bytes, len)) return 0;
+        p->slot_len = (uint32_t)len;
+        g_pager.page_outs++;
+    }
+    lru_unlink(p);
+    if (p->packed) {
+        drop_packed(p);
+    } else {
+        free(p->data);
+        p->data = NULL;
+        sub_resident(DOC_PAGE_SIZE);
+    }
+    p->dirty = 0;
+    g_pager.spilled_pages++;
+    return 1;
+}
+
+// Only cold pages are spilled; hot ones are cooled first so they reach the
+// swap file packed. A failed write (disk full) leaves the page resident and
+// stops the trim; the budget is exceeded rather than anything lost.
+static void trim_to(uint64_t limit) {
+    while (g_pager.resident > limit) {
+        if (!g_pager.cold.oldest) {
+            if (!g_pager.hot.oldest) break;
+            cool_oldest();
+            continue;
+        }
+        if (!spill(g_pager.cold.oldest)) {
+            g_pager.spill_failures++;
+            break;
+        }
+    }
+}
+
+static void trim(void) {
+    while (g_pager.hot.count > DOC_PAGER_HOT_PAGES) cool_oldest();
+    if (g_pager.budget > 0) trim_to(g_pager.budget);
+}
+
+// Allocation failure is answered by spilling every unpinned page once.
+static char *alloc_page_data(void) {
+    char *data = (char *)malloc(DOC_PAGE_SIZE);
+    if (!data && (g_pager.cold.oldest || g_pager.hot.oldest)) {
+        trim_to(0);
+        data = (char *)malloc(DOC_PAGE_SIZE);
+    }
+    return data;
+}
+
+// Fills `data` with the page bytes from wherever they are.
+static int load_page(DocPage *p, char *data) {
+    if (p->used == 0) return 1;
+    if (p->packed) return lz_block_decompress(p->packed, p->packed_len, data, p->used);
+    if (p->slot_len < p->used) {
+        return read_slot(p->slot, g_pager.scratch, p->slot_len) &&
+            lz_block_decompress(g_pager.scratch, p->slot_len, data, p->used);
+    }
+    return read_slot(p->slot, data, p->used);
+}
+
+void doc_pager_set_budget(uint64_t bytes) {
+    pager_lock();
+    g_pager.budget = bytes;
+    trim();
+    pager_unlock();
+}
+
+void doc_pager_set_compression(int on) {
+    pager_lock();
+    g_pager.no_compression = !on;
+    pager_unlock();
+}
+
+uint64_t doc_pager_budget(void) {
+    pager_lock();
+    uint64_t budget = g_pager.budget;
+    pager_unlock();
+    return budget;
+}
+
+void doc_pager_stats(DocPagerStats *out) {
+    pager_lock();
+    out->budget = g_pager.budget;
+    out->resident = g_pager.resident;
+    out->peak_resident = g_pager.peak;
+    out->compressed = g_pager.packed_bytes;
+    out->compressed_from = g_pager.packed_from;
+    out->unpacks = g_pager.unpacks;
+    out->spilled = g_pager.spilled_pages * DOC_PAGE_SIZE;
+    out->swap_size = (uint64_t)g_pager.next_slot * DOC_PAGE_SIZE;
+    out->page_ins = g_pager.page_ins;
+    out->page_outs = g_pager.page_outs;
+    out->spill_failures = g_pager.spill_failures;
+    pager_unlock();
+}
+
+int doc_page_create(DocPage *page) {
+    memset(page, 0, sizeof(*page));
+    page->slot = -1;
+
+    pager_lock();
+    page->data = alloc_page_data();
+    if (!page->data) {
+        pager_unlock();
+        return 0;
+    }
+    page->pins = 1;
+    page->dirty = 1;
+    add_resident(DOC_PAGE_SIZE);
+    trim();
+    pager_unlock();
+    return 1;
+}
+
+void doc_page_destroy(DocPage *page) {
+    pager_lock();
+    if (page->data || page->packed) {
+        if (page->pins == 0) lru_unlink(page);
+        if (page->packed) {
+            drop_packed(page);
+        } else {
+            free(page->data);
+            sub_resident(DOC_PAGE_SIZE);
+        }
+    } else {
+        g_pager.spilled_pages--;
+    }
+    if (page->slot >= 0) release_slot(page->slot);
+    pager_unlock();
+    memset(page, 0, sizeof(*page));
+    page->slot = -1;
+}
+
+char *doc_page_pin(DocPage *page) {
+    char *data;
+
+    pager_lock();
+    if (!page->data) {
+        // Out of the cold list first, so the allocation below cannot spill
+        // the packed bytes it is about to read.
+        if (page->packed) lru_unlink(page);
+        data = alloc_page_data();
+        if (!data || !load_page(page, data)) {
+            free(data);
+            if (page->packed) lru_push(page, 1);
+            pager_unlock();
+            return NULL;
+        }
+        page->data = data;
+        if (page->packed) {
+            drop_packed(page);
+            g_pager.unpacks++;
+        } else {
+            page->dirty = 0;
+            g_pager.spilled_pages--;
+            g_pager.page_ins++;
+        }
+        add_resident(DOC_PAGE_SIZE);
+        page->pins++;
+        trim();
+    } else {
+        if (page->pins == 0) lru_unlink(page);
+        page->pins++;
+    }
+    data = page->data;
+    pager_unlock();
+    return data;
+}
+
+void doc_page_unpin(DocPage *page, size_t used, int dirty) {
+    pager_lock();
+    if (dirty) {
+        page->used = used;
+        page->dirty = 1;
+    }
+    if (page->pins > 0 && --page->pins == 0) {
+        lru_push(page, 0);
+        trim();
+    }
+    pager_unlock();
+}
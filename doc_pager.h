@@ -0,0 +1,68 @@
+// Memory budget for document pages, with cold pages compressed or spilled
+// Every DocStore chunk lives in a DocPage. A page is pinned while its bytes
+// are touched. Unpinned pages go through three tiers shared by all stores:
+// the DOC_PAGER_HOT_PAGES most recently used stay raw, older ones are
+// compressed in memory (lz_block), and whenever the resident bytes pass the
+// budget the coldest are written to a swap file and freed. Pinning a page
+// brings it back raw. Pages whose swap copy is current are dropped without a
+// write. A budget of 0 means unlimited, which is the default.
+
+#ifndef DOC_PAGER_H
+#define DOC_PAGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DOC_PAGE_SIZE (64u * 1024u)
+#define DOC_PAGER_HOT_PAGES 64u     // raw unpinned pages kept before compressing
+
+typedef struct DocPage {
+    char *data;                 // DOC_PAGE_SIZE raw bytes while pinned or hot
+    char *packed;               // compressed bytes while cold, else NULL
+    size_t used;                // leading bytes worth keeping
+    uint32_t packed_len;
+    uint32_t slot_len;          // bytes in the slot; fewer than `used` means compressed
+    int64_t slot;               // swap file slot holding a copy, -1 for none
+    unsigned pins;
+    int dirty;                  // the page content differs from the slot
+    int cold;                   // on the cold list rather than the hot one
+    struct DocPage *older;      // LRU links, set while resident and unpinned
+    struct DocPage *newer;
+} DocPage;
+
+typedef struct {
+    uint64_t budget;
+    uint64_t resident;          // bytes of pages in memory, raw or compressed
+    uint64_t peak_resident;
+    uint64_t compressed;        // bytes of compressed pages in memory
+    uint64_t compressed_from;   // the raw bytes those pages hold
+    uint64_t unpacks;
+    uint64_t spilled;           // bytes of pages that live only in the swap file
+    uint64_t swap_size;
+    uint64_t page_ins;
+    uint64_t page_outs;         // pages written to the swap file
+    uint64_t spill_failures;
+} DocPagerStats;
+
+// Takes effect immediately: pages are spilled until the new budget holds.
+void doc_pager_set_budget(uint64_t bytes);
+uint64_t doc_pager_budget(void);
+void doc_pager_stats(DocPagerStats *out);
+
+// Compression of cold pages is on by default; turning it off decompresses
+// nothing already packed, it only stops packing more.
+void doc_pager_set_compression(int on);
+
+// A new page is resident, pinned and empty. Returns 0 on allocation failure.
+int doc_page_create(DocPage *page);
+void doc_page_destroy(DocPage *page);
+
+// Returns the page bytes, reading them back when spilled; NULL when they
+// cannot be (out of memory or a swap file read error).
+char *doc_page_pin(DocPage *page);
+
+// `dirty` says the bytes changed while pinned; `used`, the number of
+// leading bytes worth keeping, is only taken along with it.
+void doc_page_unpin(DocPage *page, size_t used, int dirty);
+
+#endif
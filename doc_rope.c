@@ -0,0 +1,490 @@
+// Persistent B+-tree rope of immutable, reference counted nodes
+
+#include "doc_rope.h"
+#include "doc_pager.h"
+#include "sys_thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ROPE_MAX_LEAF DOC_PAGE_SIZE
+#define ROPE_MIN_LEAF (DOC_PAGE_SIZE / 4u)
+#define ROPE_MIN_CHILDREN (DOC_ROPE_FANOUT / 2u)
+
+struct DocRope {
+    volatile long refs;
+    unsigned height;            // 0 for a leaf
+    unsigned count;             // children of an inner node
+    uint64_t length;
+    union {
+        DocPage page;           // leaf bytes
+        DocRope *child[DOC_ROPE_FANOUT];
+    } u;
+};
+
+typedef struct {
+    const char *data;
+    size_t len;
+} Piece;
+
+DocRope *doc_rope_retain(DocRope *rope) {
+    if (rope) sys_atomic_add(&rope->refs, 1);
+    return rope;
+}
+
+void doc_rope_release(DocRope *rope) {
+    if (!rope || sys_atomic_add(&rope->refs, -1) > 0) return;
+    if (rope->height == 0) {
+        doc_page_destroy(&rope->u.page);
+    } else {
+        for (unsigned i = 0; i < rope->count; i++) doc_rope_release(rope->u.child[i]);
+    }
+    free(rope);
+}
+
+uint64_t doc_rope_length(const DocRope *rope) {
+    return rope ? rope->length : 0;
+}
+
+unsigned doc_rope_height(const DocRope *rope) {
+    return rope ? rope->height : 0;
+}
+
+// The page lock makes pinning safe from any thread; the bytes never change.
+static const char *leaf_pin(const DocRope *leaf) {
+    return doc_page_pin((DocPage *)&leaf->u.page);
+}
+
+static void leaf_unpin(const DocRope *leaf) {
+    doc_page_unpin((DocPage *)&leaf->u.page, 0, 0);
+}
+
+// A leaf holding the pieces back to back; they total at most ROPE_MAX_LEAF.
+static DocRope *leaf_new(const Piece *pieces, unsigned n) {
+    DocRope *leaf = (DocRope *)calloc(1, sizeof(DocRope));
+    size_t at = 0;
+
+    if (!leaf) return NULL;
+    if (!doc_page_create(&leaf->u.page)) {
+        free(leaf);
+        return NULL;
+    }
+    for (unsigned i = 0; i < n; i++) {
+        memcpy(leaf->u.page.data + at, pieces[i].data, pieces[i].len);
+        at += pieces[i].len;
+    }
+    leaf->refs = 1;
+    leaf->length = at;
+    doc_page_unpin(&leaf->u.page, at, 1);
+    return leaf;
+}
+
+// Takes over the references to `kids`, releasing them on failure.
+static DocRope *inner_new(DocRope *const *kids, unsigned n) {
+    DocRope *node = (DocRope *)calloc(1, sizeof(DocRope));
+    if (!node) {
+        for (unsigned i = 0; i < n; i++) doc_rope_release(kids[i]);
+        return NULL;
+    }
+    node->refs = 1;
+    node->height = kids[0]->height + 1u;
+    node->count = n;
+    for (unsigned i = 0; i < n; i++) {
+        node->u.child[i] = kids[i];
+        node->length += kids[i]->length;
+    }
+    return node;
+}
+
+// Children of equal height under one new node, or two half-full ones and a
+// parent when they do not fit.
+static DocRope *merge_nodes(DocRope *const *a, unsigned na, DocRope *const *b, unsigned nb) {
+    DocRope *all[2u * DOC_ROPE_FANOUT];
+    DocRope *pair[2];
+    unsigned n = na + nb;
+    unsigned half = n / 2u;
+
+    for (unsigned i = 0; i < na; i++) all[i] = doc_rope_retain(a[i]);
+    for (unsigned i = 0; i < nb; i++) all[na + i] = doc_rope_retain(b[i]);
+    if (n <= DOC_ROPE_FANOUT) return inner_new(all, n);
+
+    pair[0] = inner_new(all, half);
+    pair[1] = inner_new(all + half, n - half);
+    if (!pair[0] || !pair[1]) {
+        doc_rope_release(pair[0]);
+        doc_rope_release(pair[1]);
+        return NULL;
+    }
+    return inner_new(pair, 2);
+}
+
+// Whether a node may sit below another without rebalancing.
+static int ok_child(const DocRope *node) {
+    return node->height == 0 ? node->length >= ROPE_MIN_LEAF : node->count >= ROPE_MIN_CHILDREN;
+}
+
+// Concatenates two leaves when they fit one page, else splits the bytes
+// evenly over two.
+static DocRope *merge_leaves(DocRope *a, DocRope *b) {
+    const char *da = leaf_pin(a);
+    const char *db = da ? leaf_pin(b) : NULL;
+    DocRope *out = NULL;
+
+    if (db) {
+        size_t la = (size_t)a->length;
+        size_t lb = (size_t)b->length;
+        size_t half = (la + lb) / 2u;
+        if (la + lb <= ROPE_MAX_LEAF) {
+            Piece both[2] = { { da, la }, { db, lb } };
+            out = leaf_new(both, 2);
+        } else {
+            Piece left[2];
+            Piece right[2];
+            DocRope *pair[2];
+            if (half <= la) {
+                left[0].data = da;
+                left[0].len = half;
+                left[1].data = db;
+                left[1].len = 0;
+                right[0].data = da + half;
+                right[0].len = la - half;
+                right[1].data = db;
+                right[1].len = lb;
+            } else {
+                left[0].data = da;
+                left[0].len = la;
+                left[1].data = db;
+                left[1].len = half - la;
+                right[0].data = db + (half - la);
+                right[0].len = la + lb - half;
+                right[1].data = db;
+                right[1].len = 0;
+            }
+            pair[0] = leaf_new(left, 2);
+            pair[1] = leaf_new(right, 2);
+            if (pair[0] && pair[1]) {
+                out = inner_new(pair, 2);
+            } else {
+                doc_rope_release(pair[0]);
+                doc_rope_release(pair[1]);
+            }
+        }
+        leaf_unpin(b);
+    }
+    if (da) leaf_unpin(a);
+    doc_rope_release(a);
+    doc_rope_release(b);
+    return out;
+}
+
+// Concatenates two non-empty ropes, consuming both. The shorter one is
+// merged in along the spine of the taller, so only that path is copied.
+// Returns NULL on failure.
+static DocRope *join(DocRope *a, DocRope *b) {
+    DocRope *out;
+    DocRope *mid;
+
+    if (a->height < b->height) {
+        if (a->height + 1u == b->height && ok_child(a)) {
+            out = merge_nodes(&a, 1, b->u.child, b->count);
+            doc_rope_release(a);
+        } else {
+            mid = join(a, doc_rope_retain(b->u.child[0]));
+            if (!mid) {
+                out = NULL;
+            } else if (mid->height < b->height) {
+                out = merge_nodes(&mid, 1, b->u.child + 1, b->count - 1u);
+            } else {
+                out = merge_nodes(mid->u.child, mid->count, b->u.child + 1, b->count - 1u);
+            }
+            doc_rope_release(mid);
+        }
+        doc_rope_release(b);
+        return out;
+    }
+
+    if (a->height > b->height) {
+        unsigned last = a->count - 1u;
+        if (b->height + 1u == a->height && ok_child(b)) {
+            out = merge_nodes(a->u.child, a->count, &b, 1);
+            doc_rope_release(b);
+        } else {
+            mid = join(doc_rope_retain(a->u.child[last]), b);
+            if (!mid) {
+                out = NULL;
+            } else if (mid->height < a->height) {
+                out = merge_nodes(a->u.child, last, &mid, 1);
+            } else {
+                out = merge_nodes(a->u.child, last, mid->u.child, mid->count);
+            }
+            doc_rope_release(mid);
+        }
+        doc_rope_release(a);
+        return out;
+    }
+
+    if (ok_child(a) && ok_child(b)) {
+        DocRope *pair[2];
+        pair[0] = a;
+        pair[1] = b;
+        return inner_new(pair, 2);
+    }
+    if (a->height == 0) return merge_leaves(a, b);
+    out = merge_nodes(a->u.child, a->count, b->u.child, b->count);
+    doc_rope_release(a);
+    doc_rope_release(b);
+    return out;
+}
+
+// Joins `piece` (which may be empty) onto `*acc`, consuming it.
+static int append(DocRope **acc, DocRope *piece) {
+    if (!piece) return 1;
+    if (!*acc) {
+        *acc = piece;
+        return 1;
+    }
+    *acc = join(*acc, piece);
+    return *acc != NULL;
+}
+
+// Joins can leave a root with a single child; the child is the same rope.
+static DocRope *collapse(DocRope *rope) {
+    while (rope && rope->height > 0 && rope->count == 1u) {
+        DocRope *only = doc_rope_retain(rope->u.child[0]);
+        doc_rope_release(rope);
+        rope = only;
+    }
+    return rope;
+}
+
+// Whole subtrees in the range are shared; only the two edges are copied.
+static int slice(DocRope *node, uint64_t start, uint64_t end, DocRope **out) {
+    DocRope *acc = NULL;
+    uint64_t at = 0;
+
+    *out = NULL;
+    if (!node || start >= end) return 1;
+    if (start == 0 && end == node->length) {
+        *out = doc_rope_retain(node);
+        return 1;
+    }
+    if (node->height == 0) {
+        const char *data = leaf_pin(node);
+        Piece p;
+        if (!data) return 0;
+        p.data = data + start;
+        p.len = (size_t)(end - start);
+        *out = leaf_new(&p, 1);
+        leaf_unpin(node);
+        return *out != NULL;
+    }
+    for (unsigned i = 0; i < node->count && at < end; i++) {
+        DocRope *child = node->u.child[i];
+        uint64_t child_end = at + child->length;
+        if (child_end > start) {
+            DocRope *piece;
+            if (!slice(child, start > at ? start - at : 0, (end < child_end ? end : child_end) - at, &piece)) {
+                doc_rope_release(acc);
+                return 0;
+            }
+            if (!append(&acc, piece)) return 0;
+        }
+        at = child_end;
+    }
+    *out = acc;
+    return 1;
+}
+
+int doc_rope_build(const char *text, size_t len, DocRope **out) {
+    size_t n = (len + ROPE_MAX_LEAF - 1u) / ROPE_MAX_LEAF;
+    DocRope **level;
+
+    *out = NULL;
+    if (len == 0) return 1;
+    level = (DocRope **)malloc(n * sizeof(DocRope *));
+    if (!level) return 0;
+
+    // Even splits keep every leaf and node at least half full.
+    for (size_t i = 0; i < n; i++) {
+        Piece p;
+        size_t lo = (size_t)((uint64_t)len * i / n);
+        p.data = text + lo;
+        p.len = (size_t)((uint64_t)len * (i + 1u) / n) - lo;
+        level[i] = leaf_new(&p, 1);
+        if (!level[i]) {
+            while (i > 0) doc_rope_release(level[--i]);
+            free(level);
+            return 0;
+        }
+    }
+    while (n > 1u) {
+        size_t groups = (n + DOC_ROPE_FANOUT - 1u) / DOC_ROPE_FANOUT;
+        for (size_t g = 0; g < groups; g++) {
+            size_t lo = n * g / groups;
+            size_t hi = n * (g + 1u) / groups;
+            // Slot g is written only after the group starting at or past it was read.
+            level[g] = inner_new(level + lo, (unsigned)(hi - lo));
+            if (!level[g]) {
+                for (size_t i = 0; i < g; i++) doc_rope_release(level[i]);
+                for (size_t i = hi; i < n; i++) doc_rope_release(level[i]);
+                free(level);
+                return 0;
+            }
+        }
+        n = groups;
+    }
+    *out = level[0];
+    free(level);
+    return 1;
+}
+
+// Rewrites the one leaf an edit falls in and copies the path above it, the
+// common case when typing. Returns -1 when the edit spans leaves or would
+// take the leaf outside its size bounds, else 1 or 0 on failure.
+static int patch(DocRope *node, uint64_t offset, uint64_t delete_len, const char *text, size_t len, DocRope **out) {
+    DocRope *child;
+    DocRope *fresh;
+    DocRope *copy;
+    uint64_t at = 0;
+    unsigned i;
+    int r;
+
+    if (node->height == 0) {
+        uint64_t result = node->length - delete_len + len;
+        const char *data;
+        Piece p[3];
+        if (result > ROPE_MAX_LEAF || result < ROPE_MIN_LEAF) return -1;
+        data = leaf_pin(node);
+        if (!data) return 0;
+        p[0].data = data;
+        p[0].len = (size_t)offset;
+        p[1].data = text;
+        p[1].len = len;
+        p[2].data = data + offset + delete_len;
+        p[2].len = (size_t)(node->length - offset - delete_len);
+        *out = leaf_new(p, 3);
+        leaf_unpin(node);
+        return *out != NULL;
+    }
+
+    for (i = 0; i + 1u < node->count && offset >= at + node->u.child[i]->length; i++) {
+        at += node->u.child[i]->length;
+    }
+    child = node->u.child[i];
+    if (offset + delete_len > at + child->length) return -1;
+    r = patch(child, offset - at, delete_len, text, len, &fresh);
+    if (r != 1) return r;
+
+    copy = (DocRope *)calloc(1, sizeof(DocRope));
+    if (!copy) {
+        doc_rope_release(fresh);
+        return 0;
+    }
+    copy->refs = 1;
+    copy->height = node->height;
+    copy->count = node->count;
+    copy->length = node->length - delete_len + len;
+    for (unsigned j = 0; j < node->count; j++) {
+        copy->u.child[j] = j == i ? fresh : doc_rope_retain(node->u.child[j]);
+    }
+    *out = copy;
+    return 1;
+}
+
+int doc_rope_replace(
+    DocRope *rope,
+    uint64_t offset,
+    uint64_t delete_len,
+    const char *text,
+    size_t len,
+    DocRope **out
+) {
+    uint64_t total = doc_rope_length(rope);
+    DocRope *left;
+    DocRope *mid;
+    DocRope *right;
+    int r;
+
+    *out = NULL;
+    if (offset > total) offset = total;
+    if (delete_len > total - offset) delete_len = total - offset;
+    if (delete_len == 0 && len == 0) {
+        *out = doc_rope_retain(rope);
+        return 1;
+    }
+    if (rope && (r = patch(rope, offset, delete_len, text, len, out)) >= 0) return r;
+
+    if (!slice(rope, 0, offset, &left)) return 0;
+    if (!doc_rope_build(text, len, &mid)) {
+        doc_rope_release(left);
+        return 0;
+    }
+    if (!slice(rope, offset + delete_len, total, &right)) {
+        doc_rope_release(left);
+        doc_rope_release(mid);
+        return 0;
+    }
+    if (!append(&left, mid)) {
+        doc_rope_release(right);
+        return 0;
+    }
+    if (!append(&left, right)) return 0;
+    *out = collapse(left);
+    return 1;
+}
+
+int doc_rope_slice(DocRope *rope, uint64_t offset, uint64_t len, DocRope **out) {
+    uint64_t total = doc_rope_length(rope);
+    if (offset > total) offset = total;
+    if (len > total - offset) len = total - offset;
+    if (!slice(rope, offset, offset + len, out)) return 0;
+    *out = collapse(*out);
+    return 1;
+}
+
+static int emit(
+    const DocRope *node,
+    uint64_t start,
+    uint64_t end,
+    DocRopeSinkFn sink,
+    void *ctx,
+    uint64_t *delivered
+) {
+    uint64_t at = 0;
+
+    if (node->height == 0) {
+        const char *data = leaf_pin(node);
+        int more;
+        if (!data) return 0;   // a spilled leaf could not be read back
+        more = sink(ctx, data + start, (size_t)(end - start));
+        leaf_unpin(node);
+        if (more) *delivered += end - start;
+        return more;
+    }
+    for (unsigned i = 0; i < node->count && at < end; i++) {
+        const DocRope *child = node->u.child[i];
+        uint64_t child_end = at + child->length;
+        if (child_end > start &&
+            !emit(child, start > at ? start - at : 0, (end < child_end ? end : child_end) - at, sink, ctx, delivered)) {
+            return 0;
+        }
+        at = child_end;
+    }
+    return 1;
+}
+
+uint64_t doc_rope_serialize(
+    const DocRope *rope,
+    uint64_t offset,
+    uint64_t len,
+    DocRopeSinkFn sink,
+    void *ctx
+) {
+    uint64_t total = doc_rope_length(rope);
+    uint64_t delivered = 0;
+
+    if (!sink || offset >= total) return 0;
+    if (len > total - offset) len = total - offset;
+    if (len > 0) emit(rope, offset, offset + len, sink, ctx, &delivered);
+    return delivered;
+}
@@ -0,0 +1,54 @@
+// Persistent B+-tree rope of immutable, reference counted nodes
+// Leaves hold up to DOC_PAGE_SIZE bytes in a pager DocPage, inner nodes up
+// to DOC_ROPE_FANOUT children, and every leaf sits at the same depth. No
+// node changes after it is built: an edit copies the leaves it touches and
+// the path above them and shares everything else with the old tree, so
+// holding on to an old root is a snapshot that costs one reference. Nodes
+// may be read and released from any thread.
+// The empty rope is NULL.
+
+#ifndef DOC_ROPE_H
+#define DOC_ROPE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DOC_ROPE_FANOUT 16u
+
+typedef struct DocRope DocRope;
+
+// Receives consecutive pieces of a range; return 0 to stop early.
+typedef int (*DocRopeSinkFn)(void *ctx, const char *data, size_t len);
+
+// Functions returning int give 0 on allocation failure (or a spilled leaf
+// that cannot be read back) and leave NULL in `out`. They never consume
+// the ropes they are given.
+int doc_rope_build(const char *text, size_t len, DocRope **out);
+DocRope *doc_rope_retain(DocRope *rope);
+void doc_rope_release(DocRope *rope);
+
+uint64_t doc_rope_length(const DocRope *rope);
+unsigned doc_rope_height(const DocRope *rope);
+
+// Replaces [offset, offset + delete_len) with `text`, clamped to the rope.
+int doc_rope_replace(
+    DocRope *rope,
+    uint64_t offset,
+    uint64_t delete_len,
+    const char *text,
+    size_t len,
+    DocRope **out
+);
+int doc_rope_slice(DocRope *rope, uint64_t offset, uint64_t len, DocRope **out);
+
+// Streams [offset, offset + len) to `sink` leaf by leaf, clamped to the
+// rope. Returns the number of bytes delivered.
+uint64_t doc_rope_serialize(
+    const DocRope *rope,
+    uint64_t offset,
+    uint64_t len,
+    DocRopeSinkFn sink,
+    void *ctx
+);
+
+#endif
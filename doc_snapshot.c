@@ -0,0 +1,117 @@
+// Immutable document snapshots with a streaming range serializer
+
+#include "doc_snapshot.h"
+#include "doc_rope.h"
+#include "sys_thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct DocSnapshot {
+    volatile long refs;
+    DocRope *root;   // NULL for empty text
+};
+
+struct DocMirror {
+    DocRope *root;
+};
+
+// Takes over the reference to `root`.
+static DocSnapshot *snapshot_wrap(DocRope *root) {
+    DocSnapshot *snap = (DocSnapshot *)malloc(sizeof(DocSnapshot));
+    if (!snap) {
+        doc_rope_release(root);
+        return NULL;
+    }
+    snap->refs = 1;
+    snap->root = root;
+    return snap;
+}
+
+DocSnapshot *doc_snapshot_create(const char *text, size_t len) {
+    DocRope *root;
+    if (!doc_rope_build(text, len, &root)) return NULL;
+    return snapshot_wrap(root);
+}
+
+DocSnapshot *doc_snapshot_retain(DocSnapshot *snap) {
+    if (snap) sys_atomic_add(&snap->refs, 1);
+    return snap;
+}
+
+void doc_snapshot_release(DocSnapshot *snap) {
+    if (!snap || sys_atomic_add(&snap->refs, -1) > 0) return;
+    doc_rope_release(snap->root);
+    free(snap);
+}
+
+uint64_t doc_snapshot_length(const DocSnapshot *snap) {
+    return snap ? doc_rope_length(snap->root) : 0;
+}
+
+DocSnapshot *doc_snapshot_slice(const DocSnapshot *snap, uint64_t offset, uint64_t len) {
+    DocRope *root;
+    if (!snap || !doc_rope_slice(snap->root, offset, len, &root)) return NULL;
+    return snapshot_wrap(root);
+}
+
+uint64_t doc_snapshot_serialize(
+    const DocSnapshot *snap,
+    uint64_t offset,
+    uint64_t len,
+    DocSinkFn sink,
+    void *ctx
+) {
+    return snap ? doc_rope_serialize(snap->root, offset, len, sink, ctx) : 0;
+}
+
+typedef struct {
+    char *dst;
+    size_t at;
+} ReadSink;
+
+static int read_sink(void *ctx, const char *data, size_t len) {
+    ReadSink *rs = (ReadSink *)ctx;
+    memcpy(rs->dst + rs->at, data, len);
+    rs->at += len;
+    return 1;
+}
+
+size_t doc_snapshot_read(const DocSnapshot *snap, uint64_t offset, char *dst, size_t len) {
+    ReadSink rs = { dst, 0 };
+    doc_snapshot_serialize(snap, offset, len, read_sink, &rs);
+    return rs.at;
+}
+
+DocMirror *doc_mirror_create(const char *text, size_t len) {
+    DocMirror *m = (DocMirror *)calloc(1, sizeof(DocMirror));
+    if (!m) return NULL;
+    if (!doc_rope_build(text, len, &m->root)) {
+        free(m);
+        return NULL;
+    }
+    return m;
+}
+
+void doc_mirror_free(DocMirror *m) {
+    if (!m) return;
+    doc_rope_release(m->root);
+    free(m);
+}
+
+int doc_mirror_replace(DocMirror *m, uint64_t offset, uint64_t delete_len, const char *text, size_t len) {
+    DocRope *next;
+    if (!doc_rope_replace(m->root, offset, delete_len, text, len, &next)) return 0;
+    // Snapshots still holding the old root keep the pages they share alive.
+    doc_rope_release(m->root);
+    m->root = next;
+    return 1;
+}
+
+uint64_t doc_mirror_length(const DocMirror *m) {
+    return m ? doc_rope_length(m->root) : 0;
+}
+
+DocSnapshot *doc_mirror_snapshot(DocMirror *m) {
+    return snapshot_wrap(doc_rope_retain(m->root));
+}
@@ -0,0 +1,59 @@
+// Immutable document snapshots with a streaming range serializer
+// A snapshot holds a reference to the root of a DocRope, which is never
+// modified, so readers on any thread can stream ranges out of it; only the
+// pager's short pin/unpin sections are serialized. A DocMirror keeps a rope
+// in step with an editor as it changes: every edit copies only the path it
+// touches, and taking a snapshot of the current text is O(1).
+// Lifetime is reference counted.
+
+#ifndef DOC_SNAPSHOT_H
+#define DOC_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct DocSnapshot DocSnapshot;
+typedef struct DocMirror DocMirror;
+
+// Receives consecutive pieces of a range; return 0 to stop early.
+typedef int (*DocSinkFn)(void *ctx, const char *data, size_t len);
+
+// Copies `text`. Returns NULL on allocation failure. The new snapshot has
+// one reference.
+DocSnapshot *doc_snapshot_create(const char *text, size_t len);
+DocSnapshot *doc_snapshot_retain(DocSnapshot *snap);
+void doc_snapshot_release(DocSnapshot *snap);
+
+uint64_t doc_snapshot_length(const DocSnapshot *snap);
+
+// A new snapshot of [offset, offset + len) sharing all but its two edge
+// pages with `snap`; NULL on failure.
+DocSnapshot *doc_snapshot_slice(const DocSnapshot *snap, uint64_t offset, uint64_t len);
+
+// Streams [offset, offset + len) to `sink` chunk by chunk, clamped to the
+// snapshot length. Returns the number of bytes delivered, which falls short
+// if a spilled chunk cannot be read back.
+uint64_t doc_snapshot_serialize(
+    const DocSnapshot *snap,
+    uint64_t offset,
+    uint64_t len,
+    DocSinkFn sink,
+    void *ctx
+);
+
+// Copies a range into `dst`; returns the number of bytes copied.
+size_t doc_snapshot_read(const DocSnapshot *snap, uint64_t offset, char *dst, size_t len);
+
+// The mirror is owned by one thread; its snapshots may go anywhere.
+DocMirror *doc_mirror_create(const char *text, size_t len);
+void doc_mirror_free(DocMirror *m);
+
+// Replaces [offset, offset + delete_len) with `text`. Returns 0 on
+// failure, leaving the mirror as it was.
+int doc_mirror_replace(DocMirror *m, uint64_t offset, uint64_t delete_len, const char *text, size_t len);
+uint64_t doc_mirror_length(const DocMirror *m);
+
+// The current text; NULL only when out of memory.
+DocSnapshot *doc_mirror_snapshot(DocMirror *m);
+
+#endif
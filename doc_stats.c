@@ -0,0 +1,315 @@
+// Document statistics: words, code points, line lengths and line endings
+
+#include "doc_stats.h"
+#include "sys_thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STATS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#define STATS_BLOCK 16u
+
+typedef struct {
+    uint64_t high;      // bytes >= 0x80
+    uint64_t lead;      // bytes >= 0xC0 (UTF-8 multi-byte leads)
+    uint64_t cr;
+    uint64_t words;
+} ByteCounts;
+
+typedef struct {
+    SysThread thread;
+    const char *text;
+    size_t len;
+    int utf8;
+    DocStats stats;
+} StatsSlice;
+
+static const uint64_t BUCKET_FLOOR[DOC_STATS_BUCKETS] = {0, 1, 16, 64, 128, 256, 1024, 65536};
+static const char *const BUCKET_LABEL[DOC_STATS_BUCKETS] = {
+    "empty", "1-15", "16-63", "64-127", "128-255", "256-1K", "1K-64K", "64K+"
+};
+
+void doc_stats_init(DocStats *s) {
+    memset(s, 0, sizeof(*s));
+    s->first_byte = -1;
+    s->last_byte = -1;
+}
+
+static int is_word_byte(int c) {
+    return c >= 0 && c != ' ' && (c < 9 || c > 13);
+}
+
+static unsigned count_bits(unsigned m) {
+    m = m - ((m >> 1) & 0x55555555u);
+    m = (m & 0x33333333u) + ((m >> 2) & 0x33333333u);
+    m = (m + (m >> 4)) & 0x0F0F0F0Fu;
+    return (m * 0x01010101u) >> 24;
+}
+
+// Bit i set when p[i] is whitespace, >= 0x80, >= 0xC0 and CR respectively.
+static void block_masks(const unsigned char *p, unsigned *space, unsigned *high, unsigned *lead, unsigned *cr) {
+#ifdef STATS_SSE2
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i ctl = _mm_sub_epi8(v, _mm_set1_epi8(9));   // 9..13 -> 0..4
+    __m128i is_ctl = _mm_cmpeq_epi8(_mm_min_epu8(ctl, _mm_set1_epi8(4)), ctl);
+    __m128i is_space = _mm_or_si128(is_ctl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    __m128i top = _mm_and_si128(v, _mm_set1_epi8((char)0xC0));
+    *space = (unsigned)_mm_movemask_epi8(is_space);
+    *high = (unsigned)_mm_movemask_epi8(v);
+    *lead = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(top, _mm_set1_epi8((char)0xC0)));
+    *cr = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+#else
+    unsigned ms = 0;
+    unsigned mh = 0;
+    unsigned ml = 0;
+    unsigned mc = 0;
+    for (unsigned i = 0; i < STATS_BLOCK; i++) {
+        unsigned c = p[i];
+        if (c == ' ' || (c >= 9 && c <= 13)) ms |= 1u << i;
+        if (c >= 0x80) mh |= 1u << i;
+        if (c >= 0xC0) ml |= 1u << i;
+        if (c == '\r') mc |= 1u << i;
+    }
+    *space = ms;
+    *high = mh;
+    *lead = ml;
+    *cr = mc;
+#endif
+}
+
+// A word starts wherever a non-space byte follows whitespace (or the start
+// of the slice); the previous block's last bit carries that across blocks.
+static void count_bytes(ByteCounts *out, const unsigned char *p, size_t len) {
+    unsigned prev_space = 1;
+    size_t i = 0;
+
+    memset(out, 0, sizeof(*out));
+    for (; i + STATS_BLOCK <= len; i += STATS_BLOCK) {
+        unsigned space;
+        unsigned high;
+        unsigned lead;
+        unsigned cr;
+        block_masks(p + i, &space, &high, &lead, &cr);
+        out->words += count_bits(~space & ((space << 1) | prev_space) & 0xFFFFu);
+        out->high += count_bits(high);
+        out->lead += count_bits(lead);
+        out->cr += count_bits(cr);
+        prev_space = (space >> 15) & 1u;
+    }
+    for (; i < len; i++) {
+        unsigned c = p[i];
+        unsigned space = c == ' ' || (c >= 9 && c <= 13);
+        out->words += !space && prev_space;
+        out->high += c >= 0x80;
+        out->lead += c >= 0xC0;
+        out->cr += c == '\r';
+        prev_space = space;
+    }
+}
+
+static void add_line(DocStats *s, uint64_t len) {
+    unsigned bucket = DOC_STATS_BUCKETS - 1u;
+    while (bucket > 0 && len < BUCKET_FLOOR[bucket]) bucket--;
+    s->histogram[bucket]++;
+    s->lines++;
+    if (len > s->longest) s->longest = len;
+}
+
+static void end_line(DocStats *s, uint64_t len) {
+    if (s->has_break) {
+        add_line(s, len);
+    } else {
+        s->head_len = len;
+        s->has_break = 1;
+    }
+}
+
+// General line pass for text with lone CRs.
+static size_t scan_lines_any(DocStats *s, const unsigned char *p, size_t len) {
+    size_t line_start = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned c = p[i];
+        if (c != '\n' && c != '\r') continue;
+        end_line(s, i - line_start);
+        if (c == '\r' && i + 1u < len && p[i + 1u] == '\n') {
+            s->crlf++;
+            i++;
+        } else if (c == '\r') {
+            s->lone_cr++;
+        } else {
+            s->lone_lf++;
+        }
+        line_start = i + 1u;
+    }
+    return line_start;
+}
+
+// Line pass when every CR is part of a CRLF: memchr hops from LF to LF.
+static size_t scan_lines_lf(DocStats *s, const unsigned char *p, size_t len) {
+    size_t line_start = 0;
+    const unsigned char *nl;
+    while ((nl = (const unsigned char *)memchr(p + line_start, '\n', len - line_start)) != NULL) {
+        size_t at = (size_t)(nl - p);
+        if (at > line_start && p[at - 1u] == '\r') {
+            s->crlf++;
+            end_line(s, at - 1u - line_start);
+        } else {
+            s->lone_lf++;
+            end_line(s, at - line_start);
+        }
+        line_start = at + 1u;
+    }
+    return line_start;
+}
+
+void doc_stats_scan(DocStats *s, const char *text, size_t len, int utf8) {
+    const unsigned char *p = (const unsigned char *)text;
+    ByteCounts counts;
+    size_t line_start;
+
+    if (len == 0) return;
+    count_bytes(&counts, p, len);
+
+    line_start = scan_lines_lf(s, p, len);
+    if (s->crlf != counts.cr) {
+        // Lone CRs break lines too; rescan with the general pass.
+        s->crlf = 0;
+        s->lone_lf = 0;
+        s->lines = 0;
+        s->longest = 0;
+        s->has_break = 0;
+        memset(s->histogram, 0, sizeof(s->histogram));
+        line_start = scan_lines_any(s, p, len);
+    }
+
+    s->bytes = len;
+    s->words = counts.words;
+    s->code_points = utf8 ? len - (counts.high - counts.lead) : len;
+    s->non_ascii = utf8 ? counts.lead : counts.high;
+    s->tail_len = len - line_start;
+    if (!s->has_break) s->head_len = len;
+    s->first_byte = p[0];
+    s->last_byte = p[len - 1u];
+}
+
+void doc_stats_merge(DocStats *into, const DocStats *next) {
+    int split_crlf;
+
+    if (next->bytes == 0) return;
+    if (into->bytes == 0) {
+        *into = *next;
+        return;
+    }
+
+    split_crlf = into->last_byte == '\r' && next->first_byte == '\n';
+    into->code_points += next->code_points;
+    into->non_ascii += next->non_ascii;
+    into->words += next->words;
+    if (is_word_byte(into->last_byte) && is_word_byte(next->first_byte)) into->words--;
+    into->crlf += next->crlf;
+    into->lone_lf += next->lone_lf;
+    into->lone_cr += next->lone_cr;
+    if (split_crlf) {
+        // One CRLF whose halves landed in different slices.
+        into->crlf++;
+        into->lone_cr--;
+        into->lone_lf--;
+    }
+    into->lines += next->lines;
+    if (next->longest > into->longest) into->longest = next->longest;
+    for (unsigned i = 0; i < DOC_STATS_BUCKETS; i++) {
+        into->histogram[i] += next->histogram[i];
+    }
+
+    if (!into->has_break && !next->has_break) {
+        into->head_len += next->head_len;
+        into->tail_len = into->head_len;
+    } else if (!into->has_break) {
+        into->head_len += next->head_len;
+        into->tail_len = next->tail_len;
+    } else if (!next->has_break) {
+        into->tail_len += next->bytes;
+    } else {
+        // The line running across the boundary is now complete; between the
+        // halves of a split CRLF there is no line at all.
+        if (!split_crlf) add_line(into, into->tail_len + next->head_len);
+        into->tail_len = next->tail_len;
+    }
+    into->has_break = into->has_break || next->has_break;
+    into->bytes += next->bytes;
+    into->last_byte = next->last_byte;
+}
+
+void doc_stats_finish(DocStats *s) {
+    if (s->finished) return;
+    s->finished = 1;
+    if (s->bytes == 0) return;
+    add_line(s, s->head_len);
+    if (s->has_break) add_line(s, s->tail_len);
+}
+
+static int stats_worker(void *arg) {
+    StatsSlice *slice = (StatsSlice *)arg;
+    doc_stats_scan(&slice->stats, slice->text, slice->len, slice->utf8);
+    return 0;
+}
+
+unsigned doc_stats_compute(DocStats *out, const char *text, size_t len, int utf8, unsigned threads) {
+    StatsSlice *slices;
+    unsigned count;
+    size_t at = 0;
+
+    doc_stats_init(out);
+    if (threads == 0) threads = sys_cpu_count();
+    if (threads > DOC_STATS_MAX_THREADS) threads = DOC_STATS_MAX_THREADS;
+    if ((uint64_t)threads * DOC_STATS_MIN_SLICE > len) threads = (unsigned)(len / DOC_STATS_MIN_SLICE);
+    if (threads < 2u) {
+        doc_stats_scan(out, text, len, utf8);
+        doc_stats_finish(out);
+        return 1;
+    }
+
+    slices = (StatsSlice *)calloc(threads, sizeof(StatsSlice));
+    if (!slices) {
+        doc_stats_scan(out, text, len, utf8);
+        doc_stats_finish(out);
+        return 1;
+    }
+    count = threads;
+    for (unsigned i = 0; i < count; i++) {
+        size_t end = (size_t)((uint64_t)len * (i + 1u) / count);
+        slices[i].text = text + at;
+        slices[i].len = end - at;
+        slices[i].utf8 = utf8;
+        doc_stats_init(&slices[i].stats);
+        at = end;
+    }
+
+    // Slice 0 runs on the calling thread; a slice whose thread fails to
+    // start is scanned inline instead.
+    for (unsigned i = 1; i < count; i++) {
+        if (!sys_thread_start(&slices[i].thread, stats_worker, &slices[i])) {
+            slices[i].thread.fn = NULL;
+            stats_worker(&slices[i]);
+        }
+    }
+    stats_worker(&slices[0]);
+    for (unsigned i = 1; i < count; i++) {
+        if (slices[i].thread.fn) sys_thread_join(&slices[i].thread);
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        doc_stats_merge(out, &slices[i].stats);
+    }
+    doc_stats_finish(out);
+    free(slices);
+    return count;
+}
+
+const char *doc_stats_bucket_label(unsigned bucket) {
+    return bucket < DOC_STATS_BUCKETS ? BUCKET_LABEL[bucket] : "?";
+}
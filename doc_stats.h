@@ -0,0 +1,58 @@
+// Document statistics: words, code points, line lengths and line endings
+// A document is split into slices that are scanned on worker threads; each
+// slice yields a partial that remembers its open first and last line, its
+// edge bytes and whether it starts or ends inside a word, so merging the
+// partials in order gives the same result as one sequential scan.
+
+#ifndef DOC_STATS_H
+#define DOC_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DOC_STATS_BUCKETS 8
+#define DOC_STATS_MIN_SLICE (1024u * 1024u)
+#define DOC_STATS_MAX_THREADS 64u
+
+typedef struct {
+    uint64_t bytes;
+    uint64_t code_points;
+    uint64_t non_ascii;        // code points outside 7-bit ASCII
+    uint64_t words;            // runs of non-whitespace
+    uint64_t crlf;
+    uint64_t lone_lf;
+    uint64_t lone_cr;
+    uint64_t lines;            // set by doc_stats_finish
+    uint64_t longest;          // bytes, line break excluded
+    uint64_t histogram[DOC_STATS_BUCKETS];
+
+    // Partial state: the lines still open at either edge of the slice.
+    uint64_t head_len;
+    uint64_t tail_len;
+    int has_break;
+    int first_byte;            // -1 for an empty slice
+    int last_byte;
+    int finished;
+} DocStats;
+
+void doc_stats_init(DocStats *s);
+
+// Scans one slice into `s` (which must be freshly initialized). With `utf8`
+// set, code points are counted as UTF-8 lead bytes; otherwise every byte is
+// one code point (single-byte code pages).
+void doc_stats_scan(DocStats *s, const char *text, size_t len, int utf8);
+
+// Appends `next`, the slice that directly follows `into` in the document.
+void doc_stats_merge(DocStats *into, const DocStats *next);
+
+// Closes the first and last line; call once after the final merge.
+void doc_stats_finish(DocStats *s);
+
+// Scans `text` on up to `threads` workers (0 = one per CPU), never giving a
+// worker less than DOC_STATS_MIN_SLICE, and finishes the result. Returns the
+// number of slices scanned.
+unsigned doc_stats_compute(DocStats *out, const char *text, size_t len, int utf8, unsigned threads);
+
+const char *doc_stats_bucket_label(unsigned bucket);
+
+#endif
@@ -0,0 +1,275 @@
+// Chunked text storage: a document held as an ordered list of bounded chunks
+
+#include "doc_store.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void doc_store_init(DocStore *s) {
+    if (s) memset(s, 0, sizeof(*s));
+}
+
+static void free_chunk(DocChunk *c) {
+    doc_page_destroy(&c->page);
+    free(c);
+}
+
+void doc_store_free(DocStore *s) {
+    if (!s) return;
+    for (size_t i = 0; i < s->count; i++) {
+        free_chunk(s->chunks[i]);
+    }
+    free(s->chunks);
+    memset(s, 0, sizeof(*s));
+}
+
+uint64_t doc_store_length(const DocStore *s) {
+    return s ? s->length : 0;
+}
+
+size_t doc_store_chunk_count(const DocStore *s) {
+    return s ? s->count : 0;
+}
+
+size_t doc_store_chunk_len(const DocStore *s, size_t index) {
+    return s && index < s->count ? s->chunks[index]->len : 0;
+}
+
+const char *doc_store_pin_chunk(const DocStore *s, size_t index, size_t *len) {
+    if (len) *len = 0;
+    if (!s || index >= s->count) return NULL;
+    const char *data = doc_page_pin(&s->chunks[index]->page);
+    if (data && len) *len = s->chunks[index]->len;
+    return data;
+}
+
+void doc_store_unpin_chunk(const DocStore *s, size_t index) {
+    if (!s || index >= s->count) return;
+    doc_page_unpin(&s->chunks[index]->page, s->chunks[index]->len, 0);
+}
+
+// Finds the chunk holding `offset`. An offset equal to the length maps to
+// index `count`. Sequential access resumes from the previous hit.
+static size_t locate(DocStore *s, uint64_t offset, uint64_t *out_start) {
+    size_t i = 0;
+    uint64_t start = 0;
+
+    if (s->hint_index < s->count && offset >= s->hint_start) {
+        i = s->hint_index;
+        start = s->hint_start;
+    }
+    while (i < s->count && offset >= start + s->chunks[i]->len) {
+        start += s->chunks[i]->len;
+        i++;
+    }
+    if (i < s->count) {
+        s->hint_index = i;
+        s->hint_start = start;
+    }
+    *out_start = start;
+    return i;
+}
+
+static int reserve_slots(DocStore *s, size_t extra) {
+    size_t need = s->count + extra;
+    size_t cap = s->cap ? s->cap : 16u;
+    DocChunk **grown;
+
+    if (need <= s->cap) return 1;
+    while (cap < need) cap *= 2u;
+    grown = (DocChunk **)realloc(s->chunks, cap * sizeof(DocChunk *));
+    if (!grown) return 0;
+    s->chunks = grown;
+    s->cap = cap;
+    return 1;
+}
+
+// Fresh chunks come back pinned; the insert unpins them once filled.
+static DocChunk **alloc_chunks(size_t n) {
+    DocChunk **list = (DocChunk **)calloc(n ? n : 1u, sizeof(DocChunk *));
+    if (!list) return NULL;
+    for (size_t i = 0; i < n; i++) {
+        list[i] = (DocChunk *)malloc(sizeof(DocChunk));
+        if (!list[i] || !doc_page_create(&list[i]->page)) {
+            free(list[i]);
+            for (size_t k = 0; k < i; k++) free_chunk(list[k]);
+            free(list);
+            return NULL;
+        }
+        list[i]->len = 0;
+    }
+    return list;
+}
+
+static int insert_piece(DocStore *s, uint64_t offset, const char *text, size_t len) {
+    uint64_t start;
+    size_t index;
+    size_t within;
+    size_t room;
+    size_t tail_len;
+    size_t spill;
+    size_t fresh_text;
+    size_t last_text_len;
+    size_t fresh;
+    size_t at;
+    int tail_separate;
+    DocChunk *c;
+    char *data = NULL;
+    DocChunk **list;
+
+    index = locate(s, offset, &start);
+    if (index == s->count && index > 0) {
+        // Appending: fill the last chunk's free space first.
+        index--;
+        start -= s->chunks[index]->len;
+    }
+    c = index < s->count ? s->chunks[index] : NULL;
+    within = c ? (size_t)(offset - start) : 0;
+    if (c) {
+        data = doc_page_pin(&c->page);
+        if (!data) return 0;
+    }
+
+    if (c && c->len + len <= DOC_CHUNK_SIZE) {
+        memmove(data + within + len, data + within, c->len - within);
+        memcpy(data + within, text, len);
+        c->len += len;
+        s->length += len;
+        doc_page_unpin(&c->page, c->len, 1);
+        return 1;
+    }
+
+    // Split: the chunk keeps its head plus as much text as fits, the rest of
+    // the text goes into fresh chunks and the old tail follows them.
+    tail_len = c ? c->len - within : 0;
+    room = c ? DOC_CHUNK_SIZE - within : 0;
+    if (room > len) room = len;
+    spill = len - room;
+    fresh_text = (spill + DOC_CHUNK_SIZE - 1u) / DOC_CHUNK_SIZE;
+    last_text_len = fresh_text ? spill - (fresh_text - 1u) * DOC_CHUNK_SIZE : 0;
+    tail_separate = tail_len > 0 && (fresh_text == 0 || last_text_len + tail_len > DOC_CHUNK_SIZE);
+    fresh = fresh_text + (tail_separate ? 1u : 0u);
+
+    list = reserve_slots(s, fresh) ? alloc_chunks(fresh) : NULL;
+    if (!list) {
+        if (c) doc_page_unpin(&c->page, c->len, 0);
+        return 0;
+    }
+
+    // Move the tail to its final place before the text overwrites it.
+    if (tail_len > 0) {
+        DocChunk *dst = tail_separate ? list[fresh - 1u] : list[fresh_text - 1u];
+        at = tail_separate ? 0 : last_text_len;
+        memcpy(dst->page.data + at, data + within, tail_len);
+        dst->len = at + tail_len;
+    }
+    if (c) {
+        memcpy(data + within, text, room);
+        c->len = within + room;
+        doc_page_unpin(&c->page, c->len, 1);
+    }
+    for (size_t k = 0; k < fresh_text; k++) {
+        size_t n = (k + 1u < fresh_text) ? DOC_CHUNK_SIZE : last_text_len;
+        memcpy(list[k]->page.data, text + room + k * DOC_CHUNK_SIZE, n);
+        if (list[k]->len < n) list[k]->len = n;
+    }
+    for (size_t k = 0; k < fresh; k++) {
+        doc_page_unpin(&list[k]->page, list[k]->len, 1);
+    }
+
+    at = c ? index + 1u : index;
+    memmove(s->chunks + at + fresh, s->chunks + at, (s->count - at) * sizeof(DocChunk *));
+    memcpy(s->chunks + at, list, fresh * sizeof(DocChunk *));
+    s->count += fresh;
+    s->length += len;
+    free(list);
+    return 1;
+}
+
+int doc_store_insert(DocStore *s, uint64_t offset, const char *text, size_t len) {
+    size_t done = 0;
+
+    if (!s || offset > s->length) return 0;
+    while (done < len) {
+        size_t n = len - done < DOC_STORE_STEP ? len - done : DOC_STORE_STEP;
+        if (!insert_piece(s, offset + done, text + done, n)) {
+            doc_store_erase(s, offset, done);
+            return 0;
+        }
+        done += n;
+    }
+    return 1;
+}
+
+int doc_store_append(DocStore *s, const char *text, size_t len) {
+    return s ? doc_store_insert(s, s->length, text, len) : 0;
+}
+
+void doc_store_erase(DocStore *s, uint64_t offset, uint64_t len) {
+    uint64_t start;
+    size_t index;
+    size_t first_empty;
+    size_t kept;
+
+    if (!s || offset >= s->length || len == 0) return;
+    if (len > s->length - offset) len = s->length - offset;
+
+    index = locate(s, offset, &start);
+    first_empty = index;
+    while (len > 0 && index < s->count) {
+        DocChunk *c = s->chunks[index];
+        size_t within = (size_t)(offset - start);
+        size_t n = c->len - within;
+        if ((uint64_t)n > len) n = (size_t)len;
+        if (within + n < c->len) {
+            // Only bytes after the erased range have to move; cutting a
+            // chunk's tail or all of it needs no page-in.
+            char *data = doc_page_pin(&c->page);
+            if (!data) break;
+            memmove(data + within, data + within + n, c->len - within - n);
+            doc_page_unpin(&c->page, c->len - n, 1);
+        }
+        c->len -= n;
+        s->length -= n;
+        len -= n;
+        start += c->len;
+        index++;
+    }
+
+    // Drop the chunks that became empty.
+    kept = first_empty;
+    for (size_t i = first_empty; i < s->count; i++) {
+        if (s->chunks[i]->len == 0) {
+            free_chunk(s->chunks[i]);
+        } else {
+            s->chunks[kept++] = s->chunks[i];
+        }
+    }
+    s->count = kept;
+    s->hint_index = 0;
+    s->hint_start = 0;
+}
+
+size_t doc_store_read(DocStore *s, uint64_t offset, char *dst, size_t len) {
+    uint64_t start;
+    size_t index;
+    size_t copied = 0;
+
+    if (!s || offset >= s->length) return 0;
+    index = locate(s, offset, &start);
+    while (copied < len && index < s->count) {
+        DocChunk *c = s->chunks[index];
+        size_t within = (size_t)(offset - start);
+        size_t n = c->len - within;
+        const char *data = doc_page_pin(&c->page);
+        if (!data) break;
+        if (n > len - copied) n = len - copied;
+        memcpy(dst + copied, data + within, n);
+        doc_page_unpin(&c->page, c->len, 0);
+        copied += n;
+        offset += n;
+        start += c->len;
+        index++;
+    }
+    return copied;
+}
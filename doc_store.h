@@ -0,0 +1,58 @@
+// Chunked text storage: a document held as an ordered list of bounded chunks
+// An insert or erase only touches the chunks it overlaps plus the pointer
+// array, so a large insert into a large document costs O(insert + chunks)
+// rather than moving the whole tail of one contiguous buffer. Chunk bytes
+// live in doc_pager pages, so they count against the memory budget and may
+// be spilled to disk while nobody has them pinned.
+
+#ifndef DOC_STORE_H
+#define DOC_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "doc_pager.h"
+
+#define DOC_CHUNK_SIZE DOC_PAGE_SIZE
+#define DOC_STORE_STEP (16u * DOC_CHUNK_SIZE)   // largest insert done in one piece
+
+typedef struct {
+    size_t len;
+    DocPage page;
+} DocChunk;
+
+typedef struct {
+    DocChunk **chunks;
+    size_t count;
+    size_t cap;
+    uint64_t length;
+    size_t hint_index;   // chunk found by the last lookup, for sequential access
+    uint64_t hint_start;
+} DocStore;
+
+void doc_store_init(DocStore *s);
+void doc_store_free(DocStore *s);
+uint64_t doc_store_length(const DocStore *s);
+
+// Both return 0 on allocation failure, leaving the store unchanged. Large
+// inserts go in DOC_STORE_STEP pieces so the budget can spill their pages
+// while the rest is still being copied.
+int doc_store_insert(DocStore *s, uint64_t offset, const char *text, size_t len);
+int doc_store_append(DocStore *s, const char *text, size_t len);
+
+// Stops early only if a spilled chunk cannot be read back.
+void doc_store_erase(DocStore *s, uint64_t offset, uint64_t len);
+
+// Copies up to `len` bytes starting at `offset`; returns the number copied.
+size_t doc_store_read(DocStore *s, uint64_t offset, char *dst, size_t len);
+
+size_t doc_store_chunk_count(const DocStore *s);
+size_t doc_store_chunk_len(const DocStore *s, size_t index);
+
+// Keeps chunk `index` in memory and returns its bytes; every non-NULL
+// result needs one doc_store_unpin_chunk. Safe from several threads as long
+// as nobody modifies the store.
+const char *doc_store_pin_chunk(const DocStore *s, size_t index, size_t *len);
+void doc_store_unpin_chunk(const DocStore *s, size_t index);
+
+#endif
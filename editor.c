@@ -1,8 +1,9 @@
 // Windows-native tiny GUI text editor
-// Build (MinGW): windres resource.rc -O coff -o resource.o && gcc -O2 -Wall -Wextra -std=c11 -mwindows editor.c resource.o -o editor.exe -lcomdlg32 -ld2d1
-// Build (MSVC): rc resource.rc && cl /O2 editor.c resource.res user32.lib gdi32.lib comdlg32.lib d2d1.lib
+// Build (MinGW): windres resource.rc -O coff -o resource.o && gcc -O2 -Wall -Wextra -std=c11 -mwindows editor.c text_metrics.c journal.c crc32.c sys_thread.c text_writer.c eol.c task_queue.c instance_ipc.c batch.c doc_store.c doc_snapshot.c doc_rope.c doc_pager.c lz_block.c mem_account.c line_segments.c marker_tree.c struct_index.c word_index.c multi_edit.c hex_doc.c async_io.c inflate.c gzip.c doc_stats.c line_ops.c json_format.c csv_index.c resource.o -o editor.exe -lcomdlg32 -ld2d1
+// Build (MSVC): rc resource.rc && cl /O2 editor.c text_metrics.c journal.c crc32.c sys_thread.c text_writer.c eol.c task_queue.c instance_ipc.c batch.c doc_store.c doc_snapshot.c doc_rope.c doc_pager.c lz_block.c mem_account.c line_segments.c marker_tree.c struct_index.c word_index.c multi_edit.c hex_doc.c async_io.c inflate.c gzip.c doc_stats.c line_ops.c json_format.c csv_index.c resource.res user32.lib gdi32.lib comdlg32.lib d2d1.lib
 
 #include <windows.h>
+#include <windowsx.h>
 #include <commdlg.h>
 #include <d2d1.h>
 #include <stdio.h>
@@ -11,26 +12,114 @@
 #include <limits.h>
 #include <stdarg.h>
 
+#include "async_io.h"
+#include "batch.h"
+#include "crc32.h"
+#include "csv_index.h"
+#include "doc_snapshot.h"
+#include "doc_stats.h"
+#include "doc_store.h"
+#include "eol.h"
+#include "gzip.h"
+#include "hex_doc.h"
+#include "instance_ipc.h"
+#include "journal.h"
+#include "json_format.h"
+#include "line_ops.h"
+#include "line_segments.h"
+#include "mem_account.h"
+#include "marker_tree.h"
+#include "multi_edit.h"
+#include "struct_index.h"
+#include "task_queue.h"
+#include "text_metrics.h"
+#include "text_writer.h"
+#include "word_index.h"
+
 #define ID_EDIT      100
 #define ID_FILE_NEW  101
 #define ID_FILE_OPEN 102
 #define ID_FILE_SAVE 103
 #define ID_FILE_INFO 104
 #define ID_FILE_EXIT 105
+#define ID_FILE_NEXT_PART 106
+#define ID_FILE_PREV_PART 107
 #define ID_EDIT_UNDO 201
 #define ID_EDIT_CUT  202
 #define ID_EDIT_COPY 203
 #define ID_EDIT_PASTE 204
 #define ID_EDIT_DELETE 205
 #define ID_EDIT_SELECT_ALL 206
+#define ID_EDIT_SORT_LINES 207
+#define ID_EDIT_SORT_NUMERIC 208
+#define ID_EDIT_SORT_NOCASE 209
+#define ID_EDIT_UNIQUE_LINES 210
+#define ID_EDIT_REVERSE_LINES 211
+#define ID_EDIT_TOGGLE_BOOKMARK 212
+#define ID_EDIT_NEXT_BOOKMARK 213
+#define ID_EDIT_PREV_BOOKMARK 214
+#define ID_EDIT_GOTO_MATCH 215
+#define ID_EDIT_COMPLETE 216
+#define ID_EDIT_CARET_ABOVE 217
+#define ID_EDIT_CARET_BELOW 218
+#define ID_EDIT_CARETS_LINE_ENDS 219
 #define ID_VIEW_READ_ONLY 301
 #define ID_VIEW_ALWAYS_ON_TOP 302
 #define ID_VIEW_WORD_WRAP 303
+#define ID_VIEW_CSV 304
+#define ID_VIEW_FOLDS 305
+#define ID_VIEW_LONG_LINE 306
 #define ID_FORMAT_FONT 351
+#define ID_FORMAT_JSON_PRETTY 352
+#define ID_FORMAT_JSON_MINIFY 353
 #define ID_HELP_ABOUT 401
+#define ID_HELP_MEMORY 402
 #define WM_APP_RENDER_READY (WM_APP + 1)
+#define WM_APP_STARTUP_TASK (WM_APP + 2)
+#define WM_APP_REMOTE_LAUNCH (WM_APP + 3)
+#define WM_APP_PASTE_PROGRESS (WM_APP + 4)
+#define WM_APP_PASTE_DONE (WM_APP + 5)
+#define WM_APP_GZIP_PROGRESS (WM_APP + 6)
+#define WM_APP_GZIP_DONE (WM_APP + 7)
+#define WM_APP_JSON_PROGRESS (WM_APP + 8)
+#define WM_APP_JSON_DONE (WM_APP + 9)
+#define WM_APP_CSV_PROGRESS (WM_APP + 10)
+#define WM_APP_CSV_DONE (WM_APP + 11)
+#define WM_APP_WORDS_PROGRESS (WM_APP + 12)
+#define WM_APP_WORDS_DONE (WM_APP + 13)
 
 #define MAX_MENU_TEXTS 128
+#define LOG_BUFFER_SIZE (16 * 1024)
+#define JOURNAL_BATCH_MS 250
+#define MARKER_KIND_BOOKMARK 0x1u
+#define SAVE_BUFFER_SIZE (64 * 1024)
+#define STARTUP_FIRST_PAINT_TARGET_MS 50.0
+#define INSTANCE_SEND_TIMEOUT_MS 2000
+#define PASTE_STREAM_THRESHOLD (4 * 1024 * 1024)
+#define PASTE_CHUNK_UNITS (256 * 1024)
+#define CLIPBOARD_DEFER_THRESHOLD (1024 * 1024)
+#define LONG_LINE_THRESHOLD (64 * 1024)
+#define GZIP_CHUNK (1024 * 1024)
+#define GZIP_TEXT_LIMIT 0x7FFFFFFEu
+#define GZIP_PART_SIZE (256u * 1024u * 1024u)
+#define JSON_INDENT 4
+#define HEX_SNIFF_BYTES 8192
+#define HEX_SCROLL_MAX 0x40000000
+#define HEX_VIEW_MARGIN 12
+#define CSV_VIEW_MAX_COLUMNS 256
+#define CSV_VIEW_MAX_ROWS 256
+#define CSV_VIEW_SAMPLES 1024
+#define CSV_VIEW_ROW_READ (64 * 1024)
+#define CSV_VIEW_CELL_TEXT 512
+#define CSV_COLUMN_GAP 2
+#define STRUCT_AUTO_BYTES (8 * 1024 * 1024)
+#define FOLD_VIEW_LINE_CHARS 512
+#define FOLD_VIEW_GUTTER 10
+#define LONG_VIEW_ROW_BYTES 4096   // bytes drawn per row, more than any screen is wide
+#define LONG_VIEW_CACHE 64         // segment indexes kept for the long lines on screen
+#define WORDS_EDIT_LIMIT (4 * 1024 * 1024)
+#define COMPLETE_MAX_ITEMS 10
+#define COMPLETE_PAD 6
 
 static HWND g_edit = NULL;
 static HBRUSH g_bg_brush = NULL;
@@ -59,15 +148,244 @@ static HBITMAP g_render_frame = NULL;
 static int g_render_frame_w = 0;
 static int g_render_frame_h = 0;
 static FILE *g_log_file = NULL;
+static BOOL g_log_buffered = FALSE;
 static WNDPROC g_edit_proc = NULL;
 static LOGFONTA g_logfont = {0};
 static char g_current_file[MAX_PATH] = "";
 static char g_launch_file[MAX_PATH] = "";
-static char *g_menu_texts[MAX_MENU_TEXTS] = {0};
-static int g_menu_text_count = 0;
+static TextMetricsCache g_metrics_cache;
+static CRITICAL_SECTION g_metrics_lock;
+static BOOL g_metrics_ready = FALSE;
+static JournalWriter *g_journal = NULL;
+static int g_edit_capture_depth = 0;
+static BOOL g_change_captured = FALSE;  // edit_proc is accounting for the EN_CHANGE under way
+static TextFormat g_text_format = {TEXT_ENC_RAW, TEXT_EOL_CRLF};
+static BOOL g_mixed_eol = FALSE;
+static MarkerTree g_markers;       // bookmarks; edit_proc moves them with every edit
+static StructIndex g_struct;       // brackets and folds; built on first use, then kept in step by edit_proc
+static BOOL g_match_shown = FALSE; // a bracket pair is framed in the editor
+static DWORD g_match_at[2];
+static char g_match_char[2];
+static size_t g_long_line_len = 0;    // longest line of the loaded document when it forced wrapping
+static size_t g_long_line_start = 0;
+static HexDoc *g_hex = NULL;   // non-NULL while a binary file is shown in the hex view
+static HWND g_hex_view = NULL;
+static HFONT g_hex_font = NULL;
+static uint64_t g_hex_top = 0;
+static uint64_t g_hex_cursor = 0;
+static BOOL g_hex_low_nibble = FALSE;
+static int g_hex_char_w = 8;
+static int g_hex_line_h = 16;
+static TaskQueue g_startup_tasks;
+static BOOL g_startup_tasks_ready = FALSE;
+static BOOL g_startup_done = FALSE;
+static BOOL g_first_paint_done = FALSE;
+static BOOL g_renderer_ready = FALSE;
+static uint64_t g_startup_base_us = 0;
+static double g_startup_base_ms = 0.0;
 static BOOL g_read_only = FALSE;
 static BOOL g_always_on_top = FALSE;
 static BOOL g_word_wrap = FALSE;
+static BOOL g_doc_wrap = FALSE;   // wrapped for the current document only, because of a long line
+static BOOL g_single_instance = FALSE;
+static InstanceServer *g_instance_server = NULL;
+
+enum { PASTE_RUNNING = 0, PASTE_DONE, PASTE_CANCELLED, PASTE_FAILED };
+
+typedef struct {
+    HWND hwnd;
+    SysThread thread;
+    UINT id;
+    volatile LONG cancel;
+    int status;
+    DocStore text;
+    char *flat;
+    uint64_t started_us;
+} PasteJob;
+
+static PasteJob *g_paste = NULL;
+static UINT g_paste_next_id = 1;
+static unsigned g_paste_percent = 0;
+static DocSnapshot *g_clip_snapshot = NULL;
+static DocMirror *g_doc_mirror = NULL;   // rope copy of the EDIT text, kept in step by edit_proc
+
+enum { GZIP_RUNNING = 0, GZIP_DONE, GZIP_CANCELLED, GZIP_FAILED, GZIP_TOO_LARGE, GZIP_PARTS };
+
+// A .gz whose text is too large for the control is shown one read-only part
+// at a time. The reader stays open with its checkpoints, so moving to another
+// part seeks there instead of inflating from the start again.
+typedef struct {
+    HANDLE file;
+    GzReader *reader;
+    uint64_t total;   // decompressed size
+    uint64_t start;   // offset of the part on screen
+    BOOL was_read_only;
+} GzipParts;
+
+typedef struct {
+    HWND hwnd;
+    SysThread thread;
+    UINT id;
+    volatile LONG cancel;
+    int status;
+    char path[MAX_PATH];
+    HANDLE file;
+    uint64_t compressed_size;
+    DocStore text;
+    char *flat;
+    size_t flat_len;
+    const char *error;
+    size_t checkpoints;
+    uint64_t started_us;
+    unsigned last_percent;
+    GzipParts *parts;     // set when loading another part; the job borrows its reader
+    GzReader *reader;     // kept open when a fresh open ends in GZIP_PARTS
+    uint64_t part_start;
+    uint64_t total;
+} GzipOpenJob;
+
+static GzipOpenJob *g_gzip_open = NULL;
+static UINT g_gzip_next_id = 1;
+static unsigned g_gzip_percent = 0;
+static BOOL g_gzip_source = FALSE;   // document came from a .gz file and is saved back as gzip
+static BOOL g_gzip_save_ok = FALSE;  // the user agreed to store this .gz without compression
+static GzipParts *g_gzip_parts = NULL;
+
+enum { FORMAT_RUNNING = 0, FORMAT_DONE, FORMAT_CANCELLED, FORMAT_FAILED, FORMAT_INVALID, FORMAT_TOO_LARGE };
+
+typedef struct {
+    HWND hwnd;
+    SysThread thread;
+    UINT id;
+    volatile LONG cancel;
+    int status;
+    JsonFormatMode mode;
+    DocSnapshot *source;
+    uint64_t source_len;
+    uint64_t fed;
+    unsigned last_percent;
+    DocStore text;
+    char *flat;
+    size_t flat_len;
+    const char *error;
+    uint64_t error_offset;
+    uint64_t started_us;
+    JsonFormatter formatter;
+} JsonFormatJob;
+
+static JsonFormatJob *g_json_format = NULL;
+static UINT g_json_next_id = 1;
+static unsigned g_json_percent = 0;
+
+enum { CSV_INDEX_RUNNING = 0, CSV_INDEX_DONE, CSV_INDEX_CANCELLED, CSV_INDEX_FAILED };
+
+typedef struct {
+    HWND hwnd;
+    SysThread thread;
+    BOOL joined;
+    UINT id;
+    volatile LONG cancel;
+    int status;
+    DocSnapshot *source;
+    uint64_t source_len;
+    uint64_t fed;
+    unsigned last_percent;
+    SysMutex lock;              // guards `index` between the worker and painting
+    CsvIndex index;
+    char *row;                  // CSV_VIEW_ROW_READ bytes for the row being drawn
+    CsvField fields[CSV_VIEW_MAX_COLUMNS];
+    unsigned widths[CSV_VIEW_MAX_COLUMNS];
+    unsigned columns;           // columns the widths were sampled for
+    uint64_t started_us;
+} CsvViewJob;
+
+static CsvViewJob *g_csv = NULL;   // non-NULL while the CSV column view is shown
+static UINT g_csv_next_id = 1;
+static unsigned g_csv_percent = 0;
+static HWND g_csv_view = NULL;
+static HFONT g_csv_font = NULL;
+static uint64_t g_csv_top = 0;
+static int g_csv_left = 0;         // horizontal scroll, in characters
+static int g_csv_char_w = 8;
+static int g_csv_line_h = 16;
+
+typedef struct {
+    uint64_t line;   // header line, still shown
+    uint64_t last;   // last hidden line
+} FoldRange;
+
+static HWND g_fold_view = NULL;    // non-NULL while the fold view is shown
+static HFONT g_fold_font = NULL;
+static FoldRange *g_folds = NULL;  // collapsed ranges, sorted and disjoint
+static size_t g_fold_count = 0;
+static size_t g_fold_cap = 0;
+static uint64_t g_fold_top = 0;    // rows, where a collapsed range counts as its header
+static uint64_t g_fold_cursor = 0;
+static int g_fold_char_w = 8;
+static int g_fold_line_h = 16;
+
+typedef struct {
+    BOOL used;
+    uint64_t line;
+    uint64_t start;
+    LineSegments segments;
+} LongViewLine;
+
+static HWND g_long_view = NULL;          // non-NULL while the long-line view is shown
+static uint64_t g_long_view_top = 0;     // first line on screen
+static uint64_t g_long_view_left = 0;    // horizontal scroll, in pixels
+static uint64_t g_long_view_width = 0;   // horizontal scroll range, in pixels
+static uint64_t g_long_view_caret = 0;   // byte offset in the document
+static uint64_t g_long_view_want_x = 0;  // x the caret keeps on Up and Down
+static int g_long_view_line_h = 16;
+static uint16_t g_long_view_widths[256];
+static LongViewLine g_long_view_cache[LONG_VIEW_CACHE];
+static size_t g_long_view_cache_next = 0;
+
+enum { WORDS_RUNNING = 0, WORDS_DONE, WORDS_CANCELLED, WORDS_FAILED };
+
+typedef struct {
+    HWND hwnd;
+    SysThread thread;
+    BOOL joined;
+    UINT id;
+    volatile LONG cancel;
+    int status;
+    DocSnapshot *source;
+    uint64_t source_len;
+    uint64_t fed;
+    unsigned last_percent;
+    WordIndex index;            // the worker's until it is joined
+    WordIndex pending;          // edits made meanwhile, merged in at the end
+    uint64_t started_us;
+} WordsJob;
+
+typedef struct {
+    char text[WORD_MAX_LEN + 1];
+    int64_t count;
+} CompleteItem;
+
+static WordIndex g_words;          // ready once ordered; follows edits through the mirror
+static WordsJob *g_words_job = NULL;
+static UINT g_words_next_id = 1;
+static unsigned g_words_percent = 0;
+static BOOL g_complete_wanted = FALSE;   // show the list when the build finishes
+static DWORD g_complete_wanted_at = 0;
+static HWND g_complete = NULL;     // the completion list, shown without taking focus
+static CompleteItem g_complete_items[COMPLETE_MAX_ITEMS];
+static int g_complete_count = 0;
+static int g_complete_sel = 0;
+static DWORD g_complete_caret = 0;
+static WPARAM g_complete_swallow = 0;    // WM_CHAR left over from a key the list used
+static int g_complete_line_h = 16;
+
+static MultiEdit g_multi;          // extra carets; empty when the EDIT caret is the only one
+static const MultiPatch *g_multi_patch = NULL;   // the batched edit being applied
+static BOOL g_multi_busy = FALSE;  // our own EM_SETSEL/EM_REPLACESEL, not the user's
+static BOOL g_column_drag = FALSE;
+static BOOL g_column_moved = FALSE;
+static DWORD g_column_from = 0;
+static BOOL g_alt_click = FALSE;   // Alt went with a click, not to the menu bar
 
 static const COLORREF COLOR_BG = RGB(30, 34, 42);
 static const COLORREF COLOR_HEADER_BG = RGB(20, 23, 30);
@@ -83,9 +401,23 @@ static const COLORREF COLOR_MENU_TEXT_DISABLED = RGB(140, 145, 156);
 static const COLORREF COLOR_INFO_BG = RGB(24, 28, 36);
 static const COLORREF COLOR_INFO_PANEL = RGB(40, 46, 58);
 
+static const char HEADER_HINT[] = "Ctrl+O Open   Ctrl+S Save   Ctrl+Shift+F Font";
+
 static void request_render(void);
 static int get_skin_header_h(HWND hwnd);
 static void get_editor_rect(HWND hwnd, RECT *rc);
+static void abort_streaming_paste(HWND hwnd);
+static void abort_gzip_open(HWND hwnd);
+static void drop_gzip_parts(HWND hwnd);
+static void abort_json_format(HWND hwnd);
+static void leave_csv_view(HWND hwnd);
+static void leave_fold_view(HWND hwnd);
+static void leave_long_line_view(HWND hwnd);
+static void drop_word_index(void);
+static void close_completion(void);
+static void leave_multi_caret(HWND edit);
+static void set_wrap_mode(HWND hwnd, BOOL word_wrap, BOOL doc_wrap);
+static void end_document_wrap(HWND hwnd);
 
 static D2D1_COLOR_F d2d_color(COLORREF c) {
     D2D1_COLOR_F out;
@@ -216,12 +548,19 @@ static BOOL d2d_draw_chrome(HWND hwnd) {
 static void init_logging(void) {
     if (g_log_file) return;
     g_log_file = fopen("editor.log", "ab");
+    // A buffer of known size, so the log shows up in memory accounting.
+    if (g_log_file && setvbuf(g_log_file, NULL, _IOFBF, LOG_BUFFER_SIZE) == 0) {
+        mem_account_alloc(MEM_LOG, LOG_BUFFER_SIZE);
+        g_log_buffered = TRUE;
+    }
 }
 
 static void close_logging(void) {
     if (!g_log_file) return;
     fclose(g_log_file);
     g_log_file = NULL;
+    if (g_log_buffered) mem_account_free(MEM_LOG, LOG_BUFFER_SIZE);
+    g_log_buffered = FALSE;
 }
 
 static void log_message(const char *fmt, ...) {
@@ -248,6 +587,94 @@ static void log_message(const char *fmt, ...) {
     }
 }
 
+// Milliseconds since the process was created. The coarse system clock only
+// anchors WinMain entry; later marks use the monotonic clock.
+static void init_startup_clock(void) {
+    FILETIME created, exited, kernel, user, now;
+    g_startup_base_us = sys_now_us();
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) return;
+    GetSystemTimeAsFileTime(&now);
+
+    ULARGE_INTEGER a, b;
+    a.LowPart = created.dwLowDateTime;
+    a.HighPart = created.dwHighDateTime;
+    b.LowPart = now.dwLowDateTime;
+    b.HighPart = now.dwHighDateTime;
+    if (b.QuadPart > a.QuadPart) {
+        g_startup_base_ms = (double)(b.QuadPart - a.QuadPart) / 10000.0;
+    }
+}
+
+static double startup_elapsed_ms(void) {
+    return g_startup_base_ms + (double)(sys_now_us() - g_startup_base_us) / 1000.0;
+}
+
+static void startup_mark(const char *what) {
+    log_message("startup: %s at %.1f ms", what, startup_elapsed_ms());
+}
+
+static void init_text_metrics(void) {
+    if (g_metrics_ready) return;
+    if (!text_metrics_init(&g_metrics_cache, 64)) return;
+    InitializeCriticalSection(&g_metrics_lock);
+    g_metrics_ready = TRUE;
+}
+
+static void free_text_metrics(void) {
+    if (!g_metrics_ready) return;
+    log_message(
+        "text metrics cache: hits=%llu misses=%llu hit_rate=%u%% invalidated=%llu",
+        g_metrics_cache.hits,
+        g_metrics_cache.misses,
+        text_metrics_hit_percent(&g_metrics_cache),
+        g_metrics_cache.invalidations
+    );
+    DeleteCriticalSection(&g_metrics_lock);
+    text_metrics_free(&g_metrics_cache);
+    g_metrics_ready = FALSE;
+}
+
+// Must run before a font handle is deleted; GDI reuses handle values.
+static void forget_font_metrics(HFONT font) {
+    if (!g_metrics_ready || !font) return;
+    EnterCriticalSection(&g_metrics_lock);
+    text_metrics_invalidate_font(&g_metrics_cache, (uintptr_t)font);
+    LeaveCriticalSection(&g_metrics_lock);
+}
+
+static BOOL lookup_text_metrics(HFONT font, const char *text, SIZE *out) {
+    int cx = 0;
+    int cy = 0;
+    int hit;
+    if (!g_metrics_ready) return FALSE;
+    EnterCriticalSection(&g_metrics_lock);
+    hit = text_metrics_lookup(&g_metrics_cache, (uintptr_t)font, text, strlen(text), &cx, &cy);
+    LeaveCriticalSection(&g_metrics_lock);
+    if (hit) {
+        out->cx = cx;
+        out->cy = cy;
+    }
+    return hit ? TRUE : FALSE;
+}
+
+static void store_text_metrics(HFONT font, const char *text, SIZE sz) {
+    if (!g_metrics_ready) return;
+    EnterCriticalSection(&g_metrics_lock);
+    text_metrics_store(&g_metrics_cache, (uintptr_t)font, text, strlen(text), (int)sz.cx, (int)sz.cy);
+    LeaveCriticalSection(&g_metrics_lock);
+}
+
+// `font` must be the font currently selected into `hdc`.
+static SIZE measure_text_cached(HDC hdc, HFONT font, const char *text) {
+    SIZE sz = {0};
+    if (lookup_text_metrics(font, text, &sz)) {
+        return sz;
+    }
+    GetTextExtentPoint32A(hdc, text, lstrlenA(text), &sz);
+    store_text_metrics(font, text, sz);
+    return sz;
+}
+
 typedef struct {
     char *title;
     char *message;
@@ -290,6 +717,18 @@ static void apply_skin_layout(HWND hwnd) {
     RECT rc;
     get_editor_rect(hwnd, &rc);
     MoveWindow(g_edit, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top, TRUE);
+    if (g_hex_view) {
+        MoveWindow(g_hex_view, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top, TRUE);
+    }
+    if (g_csv_view) {
+        MoveWindow(g_csv_view, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top, TRUE);
+    }
+    if (g_fold_view) {
+        MoveWindow(g_fold_view, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top, TRUE);
+    }
+    if (g_long_view) {
+        MoveWindow(g_long_view, rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top, TRUE);
+    }
     request_render();
     InvalidateRect(hwnd, NULL, TRUE);
 }
@@ -314,7 +753,8 @@ static void render_chrome(HDC hdc, int width, int height, const char *path_text)
     accent.top = header.bottom - 2;
     FillRect(hdc, &accent, g_menu_hot_brush);
 
-    HFONT old_font = (HFONT)SelectObject(hdc, g_header_font ? g_header_font : GetStockObject(DEFAULT_GUI_FONT));
+    HFONT header_font = g_header_font ? g_header_font : (HFONT)GetStockObject(DEFAULT_GUI_FONT);
+    HFONT old_font = (HFONT)SelectObject(hdc, header_font);
     SetBkMode(hdc, TRANSPARENT);
     SetTextColor(hdc, COLOR_TEXT);
     int text_y = (header_h - 16) / 2;
@@ -325,11 +765,9 @@ static void render_chrome(HDC hdc, int width, int height, const char *path_text)
     TextOutA(hdc, SKIN_GAP + 72, text_y, path_text, lstrlenA(path_text));
 
     {
-        const char *hint = "Ctrl+O Open   Ctrl+S Save   Ctrl+Shift+F Font";
-        SIZE hint_sz = {0};
-        GetTextExtentPoint32A(hdc, hint, lstrlenA(hint), &hint_sz);
+        SIZE hint_sz = measure_text_cached(hdc, header_font, HEADER_HINT);
         SetTextColor(hdc, COLOR_SUBTEXT);
-        TextOutA(hdc, width - SKIN_GAP - hint_sz.cx, text_y, hint, lstrlenA(hint));
+        TextOutA(hdc, width - SKIN_GAP - hint_sz.cx, text_y, HEADER_HINT, lstrlenA(HEADER_HINT));
     }
 
     if (g_frame_pen) {
@@ -352,8 +790,8 @@ static void render_chrome(HDC hdc, int width, int height, const char *path_text)
 }
 
 static void draw_header_text(HDC hdc, int width, int header_h, const char *path_text) {
-    HFONT old_font = (HFONT)SelectObject(hdc, g_header_font ? g_header_font : GetStockObject(DEFAULT_GUI_FONT));
-    const char *hint = "Ctrl+O Open   Ctrl+S Save   Ctrl+Shift+F Font";
+    HFONT header_font = g_header_font ? g_header_font : (HFONT)GetStockObject(DEFAULT_GUI_FONT);
+    HFONT old_font = (HFONT)SelectObject(hdc, header_font);
     SIZE hint_sz = {0};
     int text_y = (header_h - 16) / 2;
     if (text_y < 6) text_y = 6;
@@ -365,13 +803,24 @@ static void draw_header_text(HDC hdc, int width, int header_h, const char *path_
     SetTextColor(hdc, COLOR_SUBTEXT);
     TextOutA(hdc, SKIN_GAP + 72, text_y, path_text, lstrlenA(path_text));
 
-    GetTextExtentPoint32A(hdc, hint, lstrlenA(hint), &hint_sz);
+    hint_sz = measure_text_cached(hdc, header_font, HEADER_HINT);
     SetTextColor(hdc, COLOR_SUBTEXT);
-    TextOutA(hdc, width - SKIN_GAP - hint_sz.cx, text_y, hint, lstrlenA(hint));
+    TextOutA(hdc, width - SKIN_GAP - hint_sz.cx, text_y, HEADER_HINT, lstrlenA(HEADER_HINT));
 
     SelectObject(hdc, old_font);
 }
 
+// Frames are compatible with a 32-bit display, so 4 bytes per pixel.
+static size_t render_frame_bytes(int w, int h) {
+    return (size_t)w * (size_t)h * 4u;
+}
+
+static void delete_render_frame(HBITMAP frame, int w, int h) {
+    if (!frame) return;
+    mem_account_free(MEM_RENDER, render_frame_bytes(w, h));
+    DeleteObject(frame);
+}
+
 static HBITMAP build_render_frame(HWND hwnd, int *out_w, int *out_h) {
     RECT rc;
     HDC wnd_dc = NULL;
@@ -402,6 +851,7 @@ static HBITMAP build_render_frame(HWND hwnd, int *out_w, int *out_h) {
         ReleaseDC(hwnd, wnd_dc);
         return NULL;
     }
+    mem_account_alloc(MEM_RENDER, render_frame_bytes(*out_w, *out_h));
     old = (HBITMAP)SelectObject(mem_dc, bmp);
 
     lstrcpynA(path, g_current_file[0] ? g_current_file : "Untitled", MAX_PATH);
@@ -429,10 +879,14 @@ static DWORD WINAPI render_thread_proc(LPVOID param) {
             int h = 0;
             HBITMAP frame = build_render_frame(hwnd, &w, &h);
             HBITMAP old_frame = NULL;
+            int old_w = w;
+            int old_h = h;
 
             if (g_render_lock_ready) {
                 EnterCriticalSection(&g_render_lock);
                 old_frame = g_render_frame;
+                old_w = g_render_frame_w;
+                old_h = g_render_frame_h;
                 g_render_frame = frame;
                 g_render_frame_w = w;
                 g_render_frame_h = h;
@@ -440,9 +894,7 @@ static DWORD WINAPI render_thread_proc(LPVOID param) {
             } else {
                 old_frame = frame;
             }
-            if (old_frame) {
-                DeleteObject(old_frame);
-            }
+            delete_render_frame(old_frame, old_w, old_h);
             PostMessageA(hwnd, WM_APP_RENDER_READY, 0, 0);
         }
     }
@@ -489,6 +941,8 @@ static void start_render_thread(HWND hwnd) {
 
 static void stop_render_thread(void) {
     HBITMAP frame = NULL;
+    int frame_w = 0;
+    int frame_h = 0;
 
     if (g_render_stop_event) {
         SetEvent(g_render_stop_event);
@@ -513,13 +967,13 @@ static void stop_render_thread(void) {
     if (g_render_lock_ready) {
         EnterCriticalSection(&g_render_lock);
         frame = g_render_frame;
+        frame_w = g_render_frame_w;
+        frame_h = g_render_frame_h;
         g_render_frame = NULL;
         g_render_frame_w = 0;
         g_render_frame_h = 0;
         LeaveCriticalSection(&g_render_lock);
-        if (frame) {
-            DeleteObject(frame);
-        }
+        delete_render_frame(frame, frame_w, frame_h);
         DeleteCriticalSection(&g_render_lock);
         g_render_lock_ready = FALSE;
     }
@@ -715,6 +1169,22 @@ static void show_skinned_info_box(HWND parent, const char *title, const char *me
         return;
     }
 
+    // Grow the box to fit long reports, measuring the body as WM_PAINT lays it out.
+    RECT cr;
+    GetClientRect(box, &cr);
+    RECT body_rc = {0, 0, cr.right - 56, 0};
+    HDC hdc = GetDC(box);
+    HGDIOBJ old_font = SelectObject(hdc, state->body_font ? (HGDIOBJ)state->body_font : GetStockObject(DEFAULT_GUI_FONT));
+    DrawTextA(hdc, message ? message : "", -1, &body_rc, DT_LEFT | DT_TOP | DT_WORDBREAK | DT_CALCRECT);
+    SelectObject(hdc, old_font);
+    ReleaseDC(box, hdc);
+    int extra = (64 + body_rc.bottom + 78) - cr.bottom;
+    if (extra > 0) {
+        RECT wr;
+        GetWindowRect(box, &wr);
+        SetWindowPos(box, NULL, 0, 0, wr.right - wr.left, wr.bottom - wr.top + extra, SWP_NOMOVE | SWP_NOZORDER);
+    }
+
     RECT pr = {0};
     RECT br = {0};
     GetWindowRect(parent, &pr);
@@ -738,31 +1208,93 @@ static void show_skinned_info_box(HWND parent, const char *title, const char *me
     SetActiveWindow(parent);
 }
 
-static void free_menu_texts(void) {
-    for (int i = 0; i < g_menu_text_count; i++) {
-        free(g_menu_texts[i]);
-        g_menu_texts[i] = NULL;
+static void split_menu_text(const char *text, char *left, size_t left_cap, char *right, size_t right_cap) {
+    const char *tab = strchr(text, '\t');
+    if (!tab) {
+        lstrcpynA(left, text, (int)left_cap);
+        right[0] = '\0';
+        return;
+    }
+
+    size_t left_len = (size_t)(tab - text);
+    if (left_len >= left_cap) left_len = left_cap - 1u;
+    memcpy(left, text, left_len);
+    left[left_len] = '\0';
+    lstrcpynA(right, tab + 1, (int)right_cap);
+}
+
+static void normalize_menu_label(const char *src, char *dst, size_t dst_cap) {
+    size_t j = 0;
+    for (size_t i = 0; src && src[i] != '\0' && j + 1u < dst_cap; i++) {
+        if (src[i] == '&') {
+            if (src[i + 1] == '&') {
+                dst[j++] = '&';
+                i++;
+            }
+            continue;
+        }
+        dst[j++] = src[i];
     }
-    g_menu_text_count = 0;
+    dst[j] = '\0';
 }
 
-static char *dup_menu_text(const char *text) {
-    size_t n = strlen(text) + 1u;
-    char *copy = (char *)malloc(n);
-    if (!copy) return NULL;
-    memcpy(copy, text, n);
-    if (g_menu_text_count < MAX_MENU_TEXTS) {
-        g_menu_texts[g_menu_text_count++] = copy;
+typedef struct {
+    char *left;
+    char *right;
+} MenuLabel;
+
+static MenuLabel *g_menu_labels[MAX_MENU_TEXTS] = {0};
+static int g_menu_label_count = 0;
+
+static size_t menu_label_size(const MenuLabel *label) {
+    return sizeof(*label) + strlen(label->left) + strlen(label->right) + 2u;
+}
+
+static void free_menu_labels(void) {
+    for (int i = 0; i < g_menu_label_count; i++) {
+        mem_account_free(MEM_RENDER, menu_label_size(g_menu_labels[i]));
+        free(g_menu_labels[i]);
+        g_menu_labels[i] = NULL;
     }
-    return copy;
+    g_menu_label_count = 0;
+}
+
+// Splits and normalizes the label once so WM_MEASUREITEM/WM_DRAWITEM never redo it.
+static MenuLabel *create_menu_label(const char *text) {
+    char left[256];
+    char right[128];
+    char left_draw[256];
+    char right_draw[128];
+    size_t left_n;
+    size_t right_n;
+    MenuLabel *label;
+
+    if (g_menu_label_count >= MAX_MENU_TEXTS) return NULL;
+
+    split_menu_text(text, left, sizeof(left), right, sizeof(right));
+    normalize_menu_label(left, left_draw, sizeof(left_draw));
+    normalize_menu_label(right, right_draw, sizeof(right_draw));
+    left_n = strlen(left_draw) + 1u;
+    right_n = strlen(right_draw) + 1u;
+
+    label = (MenuLabel *)malloc(sizeof(*label) + left_n + right_n);
+    if (!label) return NULL;
+    label->left = (char *)(label + 1);
+    label->right = label->left + left_n;
+    memcpy(label->left, left_draw, left_n);
+    memcpy(label->right, right_draw, right_n);
+    mem_account_alloc(MEM_RENDER, menu_label_size(label));
+
+    g_menu_labels[g_menu_label_count++] = label;
+    return label;
 }
 
 static BOOL append_ownerdraw_item(HMENU menu, UINT flags, UINT_PTR item, const char *text) {
-    char *stored = dup_menu_text(text);
-    if (!stored) {
+    MenuLabel *label = create_menu_label(text);
+    if (!label) {
         return AppendMenuA(menu, flags, item, text);
     }
-    return AppendMenuA(menu, flags | MF_OWNERDRAW, item, (LPCSTR)stored);
+    return AppendMenuA(menu, flags | MF_OWNERDRAW, item, (LPCSTR)label);
 }
 
 static void ensure_menu_font(void) {
@@ -778,6 +1310,44 @@ static void ensure_menu_font(void) {
     }
 }
 
+static void release_menu_font(void) {
+    forget_font_metrics(g_menu_font);
+    if (g_menu_font && g_menu_font != GetStockObject(DEFAULT_GUI_FONT)) {
+        DeleteObject(g_menu_font);
+    }
+    g_menu_font = NULL;
+}
+
+static SIZE measure_menu_text(const char *text) {
+    SIZE sz = {0};
+    HDC hdc;
+    HFONT old_font;
+
+    ensure_menu_font();
+    if (lookup_text_metrics(g_menu_font, text, &sz)) {
+        return sz;
+    }
+
+    hdc = GetDC(NULL);
+    if (!hdc) return sz;
+    old_font = (HFONT)SelectObject(hdc, g_menu_font);
+    GetTextExtentPoint32A(hdc, text, lstrlenA(text), &sz);
+    SelectObject(hdc, old_font);
+    ReleaseDC(NULL, hdc);
+
+    store_text_metrics(g_menu_font, text, sz);
+    return sz;
+}
+
+static void premeasure_menu_labels(void) {
+    for (int i = 0; i < g_menu_label_count; i++) {
+        measure_menu_text(g_menu_labels[i]->left);
+        if (g_menu_labels[i]->right[0]) {
+            measure_menu_text(g_menu_labels[i]->right);
+        }
+    }
+}
+
 static void apply_menu_background_recursive(HMENU menu) {
     if (!g_menu_bg_brush) return;
 
@@ -796,34 +1366,22 @@ static void apply_menu_background_recursive(HMENU menu) {
     }
 }
 
-static void split_menu_text(const char *text, char *left, size_t left_cap, char *right, size_t right_cap) {
-    const char *tab = strchr(text, '\t');
-    if (!tab) {
-        lstrcpynA(left, text, (int)left_cap);
-        right[0] = '\0';
-        return;
-    }
-
-    size_t left_len = (size_t)(tab - text);
-    if (left_len >= left_cap) left_len = left_cap - 1u;
-    memcpy(left, text, left_len);
-    left[left_len] = '\0';
-    lstrcpynA(right, tab + 1, (int)right_cap);
-}
-
-static void normalize_menu_label(const char *src, char *dst, size_t dst_cap) {
-    size_t j = 0;
-    for (size_t i = 0; src && src[i] != '\0' && j + 1u < dst_cap; i++) {
-        if (src[i] == '&') {
-            if (src[i + 1] == '&') {
-                dst[j++] = '&';
-                i++;
-            }
-            continue;
-        }
-        dst[j++] = src[i];
+// Windows keeps each owner-drawn item's WM_MEASUREITEM size until the item
+// changes. Setting its type and data again (to the same values) drops the
+// cached size, so the next time the menu shows it is measured with the new
+// font. ModifyMenu would do the same but destroys an item's submenu.
+static void remeasure_menu_items(HMENU menu) {
+    int count = GetMenuItemCount(menu);
+    for (int i = 0; i < count; i++) {
+        MENUITEMINFOA mii = {0};
+        mii.cbSize = sizeof(mii);
+        mii.fMask = MIIM_FTYPE | MIIM_DATA | MIIM_SUBMENU;
+        if (!GetMenuItemInfoA(menu, (UINT)i, TRUE, &mii)) continue;
+        if (mii.hSubMenu) remeasure_menu_items(mii.hSubMenu);
+        if (!(mii.fType & MFT_OWNERDRAW)) continue;
+        mii.fMask = MIIM_FTYPE | MIIM_DATA;
+        SetMenuItemInfoA(menu, (UINT)i, TRUE, &mii);
     }
-    dst[j] = '\0';
 }
 
 static void enable_dark_menus(void) {
@@ -874,12 +1432,49 @@ static void load_icons_from_exe(HICON *out_big, HICON *out_small) {
 }
 
 static void update_window_title(HWND hwnd) {
-    char title[MAX_PATH + 64];
+    char title[MAX_PATH + 128];
     if (g_current_file[0]) {
         wsprintfA(title, "Editor - %s", g_current_file);
     } else {
         lstrcpynA(title, "Editor - Untitled", (int)sizeof(title));
     }
+    if (g_hex) {
+        lstrcatA(title, hex_doc_patch_count(g_hex) > 0 ? " [hex, modified]" : " [hex]");
+    }
+    if (g_csv) {
+        lstrcatA(title, " [csv]");
+        if (!g_csv->joined) {
+            wsprintfA(title + lstrlenA(title), " - Indexing rows %u%% (Esc to cancel)", g_csv_percent);
+        }
+    }
+    if (g_fold_view) {
+        lstrcatA(title, " [folds]");
+    }
+    if (g_long_view) {
+        lstrcatA(title, " [long line view]");
+    } else if (g_doc_wrap) {
+        lstrcatA(title, " [wrapped: long line]");
+    }
+    if (g_words_job) {
+        wsprintfA(title + lstrlenA(title), " - Indexing words %u%%", g_words_percent);
+    }
+    if (g_paste) {
+        wsprintfA(title + lstrlenA(title), " - Pasting %u%% (Esc to cancel)", g_paste_percent);
+    }
+    if (g_gzip_parts) {
+        wsprintfA(
+            title + lstrlenA(title), " [part: %u-%u of %u MB]", (unsigned)(g_gzip_parts->start >> 20),
+            (unsigned)((g_gzip_parts->start + GZIP_PART_SIZE < g_gzip_parts->total ? g_gzip_parts->start + GZIP_PART_SIZE
+                                                                                     : g_gzip_parts->total) >> 20),
+            (unsigned)(g_gzip_parts->total >> 20)
+        );
+    }
+    if (g_gzip_open) {
+        wsprintfA(title + lstrlenA(title), " - Decompressing %u%% (Esc to cancel)", g_gzip_percent);
+    }
+    if (g_json_format) {
+        wsprintfA(title + lstrlenA(title), " - Formatting JSON %u%% (Esc to cancel)", g_json_percent);
+    }
     SetWindowTextA(hwnd, title);
     request_render();
 }
@@ -897,113 +1492,3534 @@ static char *get_editor_text(size_t *out_len) {
     return buffer;
 }
 
-static void apply_dark_title_bar(HWND hwnd) {
-    HMODULE dwm = LoadLibraryA("dwmapi.dll");
-    if (!dwm) return;
+// Borrows the multiline EDIT control's own buffer, avoiding a full copy.
+static const char *lock_editor_buffer(HWND edit, HLOCAL *out_handle) {
+    HLOCAL handle = (HLOCAL)SendMessageA(edit, EM_GETHANDLE, 0, 0);
+    *out_handle = handle;
+    if (!handle) return NULL;
+    return (const char *)LocalLock(handle);
+}
 
-    typedef HRESULT (WINAPI *DwmSetWindowAttributeFn)(HWND, DWORD, LPCVOID, DWORD);
-    FARPROC raw = GetProcAddress(dwm, "DwmSetWindowAttribute");
-    DwmSetWindowAttributeFn set_attr = NULL;
-    if (raw) {
-        memcpy(&set_attr, &raw, sizeof(set_attr));
+static void unlock_editor_buffer(HLOCAL handle) {
+    if (handle) LocalUnlock(handle);
+}
+
+static void journal_path_for(const char *path, char *out, size_t out_cap) {
+    snprintf(out, out_cap, "%s.journal", path);
+}
+
+// Leaves the journal on disk when it still holds unsaved edits so the next
+// open of the file can offer to recover them.
+static void stop_journal(void) {
+    if (!g_journal) return;
+    {
+        BOOL dirty = journal_pending_edits(g_journal) > 0;
+        uint64_t records = 0;
+        uint64_t batches = 0;
+        journal_stats(g_journal, &records, NULL, &batches);
+        journal_close(g_journal, !dirty);
+        log_message("journal closed records=%llu batches=%llu kept=%d", (unsigned long long)records, (unsigned long long)batches, dirty);
     }
-    if (set_attr) {
-        BOOL enabled = TRUE;
-        const DWORD DWMWA_USE_IMMERSIVE_DARK_MODE = 20;
-        set_attr(hwnd, DWMWA_USE_IMMERSIVE_DARK_MODE, &enabled, sizeof(enabled));
+    g_journal = NULL;
+}
+
+static void start_journal(const char *path, size_t len, uint32_t crc) {
+    char journal_path[MAX_PATH + 16];
+    stop_journal();
+    journal_path_for(path, journal_path, sizeof(journal_path));
+    g_journal = journal_create(journal_path, (uint64_t)len, crc, JOURNAL_BATCH_MS);
+    if (!g_journal) {
+        log_message("journal_create failed path=%s", journal_path);
     }
+}
 
-    FreeLibrary(dwm);
+// The word index reads removed text from the mirror, so it goes too.
+static void drop_doc_mirror(void) {
+    drop_word_index();
+    doc_mirror_free(g_doc_mirror);
+    g_doc_mirror = NULL;
 }
 
-static void save_editor_to_path(HWND hwnd, const char *path) {
-    size_t len = 0;
-    char *buffer = get_editor_text(&len);
-    if (!buffer) {
-        MessageBoxA(hwnd, "Out of memory while saving.", "Save Error", MB_OK | MB_ICONERROR);
-        return;
+// The first snapshot copies the EDIT buffer into the mirror; later ones
+// share its pages and cost O(1) while edits keep it current.
+static DocSnapshot *snapshot_document(void) {
+    size_t len = (size_t)GetWindowTextLengthA(g_edit);
+    if (g_doc_mirror && doc_mirror_length(g_doc_mirror) != (uint64_t)len) {
+        log_message("snapshot: mirror out of step (%llu vs %lu bytes), rebuilding",
+            (unsigned long long)doc_mirror_length(g_doc_mirror), (unsigned long)len);
+        drop_doc_mirror();
+    }
+    if (!g_doc_mirror) {
+        HLOCAL handle = NULL;
+        const char *text = lock_editor_buffer(g_edit, &handle);
+        if (!text) return NULL;
+        g_doc_mirror = doc_mirror_create(text, len);
+        unlock_editor_buffer(handle);
+        if (!g_doc_mirror) return NULL;
     }
+    return doc_mirror_snapshot(g_doc_mirror);
+}
 
-    FILE *f = fopen(path, "wb");
-    if (!f) {
-        free(buffer);
-        MessageBoxA(hwnd, "Could not open file for writing.", "Save Error", MB_OK | MB_ICONERROR);
+static void drop_struct_index(void) {
+    struct_index_free(&g_struct);
+}
+
+// Built from the EDIT buffer the first time brackets or folds are needed;
+// without `force` only for documents up to STRUCT_AUTO_BYTES, so caret moves
+// never stall on a huge file. Edits keep it current from then on.
+static const StructIndex *struct_index_for(HWND edit, BOOL force) {
+    size_t len = (size_t)GetWindowTextLengthA(edit);
+    if (g_struct.blocks && g_struct.bytes == (uint64_t)len) return &g_struct;
+    if (!force && len > STRUCT_AUTO_BYTES) return NULL;
+
+    HLOCAL handle = NULL;
+    const char *text = lock_editor_buffer(edit, &handle);
+    if (!text) return NULL;
+    uint64_t started = sys_now_us();
+    int ok = struct_index_build(&g_struct, text, len);
+    unlock_editor_buffer(handle);
+    if (!ok) {
+        log_message("structure: out of memory indexing %lu bytes", (unsigned long)len);
+        return NULL;
+    }
+    log_message("structure: indexed %llu lines in %.1f ms",
+        (unsigned long long)g_struct.lines, (double)(sys_now_us() - started) / 1000.0);
+    return &g_struct;
+}
+
+// Blocks until a running build stops.
+static void drop_word_index(void) {
+    WordsJob *job = g_words_job;
+    if (job) {
+        InterlockedExchange(&job->cancel, 1);
+        if (!job->joined) sys_thread_join(&job->thread);
+        g_words_job = NULL;
+        word_index_free(&job->index);
+        word_index_free(&job->pending);
+        doc_snapshot_release(job->source);
+        update_window_title(job->hwnd);
+        free(job);
+    }
+    word_index_free(&g_words);
+    g_complete_wanted = FALSE;
+    close_completion();
+}
+
+// Called before the mirror follows the same edit, so it still holds the
+// removed text. While a build runs, edits collect in the job's pending index.
+static void follow_word_edit(const char *text, size_t len, DWORD start, long deleted, long inserted) {
+    WordIndex *wi = g_words_job ? &g_words_job->pending : &g_words;
+    char *old = NULL;
+    BOOL ok = g_doc_mirror != NULL;
+
+    if ((uint64_t)deleted + (uint64_t)inserted > WORDS_EDIT_LIMIT) {
+        log_message("words: %ld bytes changed at once, dropping the index", deleted + inserted);
+        drop_word_index();
         return;
     }
+    if (ok && deleted > 0) {
+        DocSnapshot *snap = doc_mirror_snapshot(g_doc_mirror);
+        old = snap ? (char *)malloc((size_t)deleted) : NULL;
+        ok = old && doc_snapshot_read(snap, start, old, (size_t)deleted) == (size_t)deleted;
+        doc_snapshot_release(snap);
+    }
+    if (ok) ok = word_index_edit(wi, text, len, start, old, (size_t)deleted, (size_t)inserted);
+    free(old);
+    if (!ok) {
+        log_message("words: index update failed, dropping it");
+        drop_word_index();
+    }
+}
 
-    fwrite(buffer, 1, len, f);
-    fclose(f);
-    free(buffer);
+static void journal_whole_text(HWND edit) {
+    HLOCAL handle = NULL;
+    const char *text = lock_editor_buffer(edit, &handle);
+    if (!text) return;
+    size_t len = (size_t)GetWindowTextLengthA(edit);
+    journal_append(g_journal, 0, JOURNAL_DELETE_ALL, text, len, (uint64_t)len);
+    unlock_editor_buffer(handle);
+}
 
-    lstrcpynA(g_current_file, path, MAX_PATH);
-    update_window_title(hwnd);
+typedef struct {
+    DWORD sel_start;
+    DWORD sel_end;
+    int length;
+} EditState;
+
+// Changes that cannot be followed (undo, whose buffer is opaque) only pull
+// bookmarks past the new end back to it.
+static void clamp_markers(int old_len, int new_len) {
+    if (new_len < old_len) marker_tree_edit(&g_markers, (uint64_t)new_len, (uint64_t)(old_len - new_len), 0);
 }
 
-static void save_to_output_txt(HWND hwnd) {
-    save_editor_to_path(hwnd, g_current_file[0] ? g_current_file : "output.txt");
+static void caret_line_range(DWORD *line_start, DWORD *line_end) {
+    DWORD caret = 0;
+    SendMessageA(g_edit, EM_GETSEL, (WPARAM)&caret, 0);
+    LRESULT line = SendMessageA(g_edit, EM_LINEFROMCHAR, (WPARAM)caret, 0);
+    *line_start = (DWORD)SendMessageA(g_edit, EM_LINEINDEX, (WPARAM)line, 0);
+    *line_end = *line_start + (DWORD)SendMessageA(g_edit, EM_LINELENGTH, (WPARAM)*line_start, 0);
 }
 
-static void show_file_info_prompt(HWND hwnd) {
-    size_t len = 0;
-    char *buffer = get_editor_text(&len);
-    if (!buffer) {
-        MessageBoxA(hwnd, "Out of memory while gathering file info.", "File Info", MB_OK | MB_ICONERROR);
+// A bookmark is a zero-length marker on its line; typing at the line start
+// pushes it along, so it stays with the line's text.
+static void toggle_bookmark(void) {
+    DWORD line_start;
+    DWORD line_end;
+    Marker m;
+    BOOL removed = FALSE;
+
+    if (g_hex || g_csv || g_fold_view || g_long_view) {
+        MessageBeep(MB_OK);
         return;
     }
-
-    int lines = 1;
-    for (size_t i = 0; i < len; i++) {
-        if (buffer[i] == '\n') lines++;
+    caret_line_range(&line_start, &line_end);
+    while (marker_tree_next(&g_markers, line_start, MARKER_KIND_BOOKMARK, &m) && m.start <= line_end) {
+        marker_tree_remove(&g_markers, m.id);
+        removed = TRUE;
+    }
+    if (!removed && !marker_tree_add(&g_markers, line_start, line_start, MARKER_KIND_BOOKMARK, 0)) {
+        log_message("bookmarks: out of memory adding one at %lu", (unsigned long)line_start);
+        MessageBeep(MB_ICONERROR);
     }
-    if (len == 0) lines = 0;
-
-    const char *path = g_current_file[0] ? g_current_file : "(unsaved)";
-    char msg[1024];
-    wsprintfA(
-        msg,
-        "File: %s\nCharacters: %u\nApprox. bytes: %u\nLines: %d",
-        path,
-        (unsigned)len,
-        (unsigned)len,
-        lines
-    );
-    show_skinned_info_box(hwnd, "File Info", msg);
-    free(buffer);
 }
 
-static BOOL load_file_into_editor(HWND hwnd, const char *path) {
-    if (!g_edit || !path || path[0] == '\0') {
-        log_message("load_file_into_editor: invalid state g_edit=%p path=%s", (void *)g_edit, path ? path : "(null)");
-        return FALSE;
+// Wraps around at either end of the document.
+static void goto_bookmark(BOOL forward) {
+    DWORD line_start;
+    DWORD line_end;
+    Marker m;
+    BOOL found;
+
+    if (g_hex || g_csv || g_fold_view || g_long_view) {
+        MessageBeep(MB_OK);
+        return;
+    }
+    caret_line_range(&line_start, &line_end);
+    if (forward) {
+        found = marker_tree_next(&g_markers, (uint64_t)line_end + 1u, MARKER_KIND_BOOKMARK, &m) ||
+                marker_tree_next(&g_markers, 0, MARKER_KIND_BOOKMARK, &m);
+    } else {
+        found = marker_tree_prev(&g_markers, line_start, MARKER_KIND_BOOKMARK, &m) ||
+                marker_tree_prev(&g_markers, UINT64_MAX, MARKER_KIND_BOOKMARK, &m);
     }
+    if (!found) {
+        MessageBeep(MB_OK);
+        return;
+    }
+    LRESULT line = SendMessageA(g_edit, EM_LINEFROMCHAR, (WPARAM)m.start, 0);
+    DWORD target = (DWORD)SendMessageA(g_edit, EM_LINEINDEX, (WPARAM)line, 0);
+    SendMessageA(g_edit, EM_SETSEL, target, target);
+    SendMessageA(g_edit, EM_SCROLLCARET, 0, 0);
+}
 
-    HANDLE file = CreateFileA(
-        path,
-        GENERIC_READ,
-        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-        NULL,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL
-    );
-    if (file == INVALID_HANDLE_VALUE) {
-        log_message("load_file_into_editor: CreateFileA failed path=%s err=%lu", path, (unsigned long)GetLastError());
-        return FALSE;
+// The bracket right after the caret, or else right before it, and its pair.
+static BOOL find_bracket_pair(HWND edit, BOOL force, DWORD at[2], char ch[2]) {
+    DWORD start = 0;
+    DWORD end = 0;
+    uint64_t match = 0;
+    BOOL found = FALSE;
+
+    SendMessageA(edit, EM_GETSEL, (WPARAM)&start, (LPARAM)&end);
+    if (start != end) return FALSE;
+    const StructIndex *si = struct_index_for(edit, force);
+    if (!si) return FALSE;
+    HLOCAL handle = NULL;
+    const char *text = lock_editor_buffer(edit, &handle);
+    if (!text) return FALSE;
+    size_t len = (size_t)si->bytes;
+    if (start < len && struct_index_match(si, text, len, start, &match)) {
+        at[0] = start;
+        found = TRUE;
+    } else if (start > 0 && struct_index_match(si, text, len, start - 1u, &match)) {
+        at[0] = start - 1u;
+        found = TRUE;
+    }
+    if (found) {
+        at[1] = (DWORD)match;
+        ch[0] = text[at[0]];
+        ch[1] = text[at[1]];
     }
+    unlock_editor_buffer(handle);
+    return found;
+}
 
-    LARGE_INTEGER file_size = {0};
-    if (!GetFileSizeEx(file, &file_size)) {
-        log_message("load_file_into_editor: GetFileSizeEx failed path=%s err=%lu", path, (unsigned long)GetLastError());
-        CloseHandle(file);
-        return FALSE;
+static BOOL bracket_cell(HWND edit, HDC hdc, DWORD offset, char ch, RECT *rc) {
+    LRESULT pos = SendMessageA(edit, EM_POSFROMCHAR, (WPARAM)offset, 0);
+    TEXTMETRICA tm;
+    SIZE size;
+    if (pos == -1) return FALSE;
+    GetTextMetricsA(hdc, &tm);
+    if (!GetTextExtentPoint32A(hdc, &ch, 1, &size)) size.cx = tm.tmAveCharWidth;
+    rc->left = GET_X_LPARAM(pos);
+    rc->top = GET_Y_LPARAM(pos);
+    rc->right = rc->left + size.cx;
+    rc->bottom = rc->top + tm.tmHeight;
+    return TRUE;
+}
+
+// Drawn over the EDIT control's own painting, after it.
+static void draw_bracket_frames(HWND edit) {
+    if (!g_match_shown) return;
+    HDC hdc = GetDC(edit);
+    HFONT font = (HFONT)SendMessageA(edit, WM_GETFONT, 0, 0);
+    HGDIOBJ old_font = SelectObject(hdc, font ? (HGDIOBJ)font : GetStockObject(SYSTEM_FONT));
+    HGDIOBJ old_pen = SelectObject(hdc, g_frame_pen);
+    HGDIOBJ old_brush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+    for (int i = 0; i < 2; i++) {
+        RECT rc;
+        if (bracket_cell(edit, hdc, g_match_at[i], g_match_char[i], &rc)) {
+            Rectangle(hdc, rc.left, rc.top, rc.right, rc.bottom);
+        }
     }
-    log_message("load_file_into_editor: path=%s size=%lld", path, (long long)file_size.QuadPart);
+    SelectObject(hdc, old_brush);
+    SelectObject(hdc, old_pen);
+    SelectObject(hdc, old_font);
+    ReleaseDC(edit, hdc);
+}
 
-    if (file_size.QuadPart > (__int64)0x7FFFFFFE) {
-        CloseHandle(file);
-        log_message("load_file_into_editor: file too large path=%s", path);
-        MessageBoxA(hwnd, "File is too large for the editor control.", "Open Error", MB_OK | MB_ICONERROR);
-        return FALSE;
+static void invalidate_bracket_frames(HWND edit) {
+    if (!g_match_shown) return;
+    HDC hdc = GetDC(edit);
+    HFONT font = (HFONT)SendMessageA(edit, WM_GETFONT, 0, 0);
+    HGDIOBJ old_font = SelectObject(hdc, font ? (HGDIOBJ)font : GetStockObject(SYSTEM_FONT));
+    for (int i = 0; i < 2; i++) {
+        RECT rc;
+        if (bracket_cell(edit, hdc, g_match_at[i], g_match_char[i], &rc)) InvalidateRect(edit, &rc, FALSE);
+    }
+    SelectObject(hdc, old_font);
+    ReleaseDC(edit, hdc);
+}
+
+// Called after anything that may move the caret or change the text. The
+// EDIT control repaints typed text outside WM_PAINT, so the frames are
+// redrawn even when the pair stays the same.
+static void update_bracket_highlight(HWND edit) {
+    DWORD at[2] = {0, 0};
+    char ch[2] = {0, 0};
+    BOOL shown = !g_hex && !g_csv && !g_fold_view && !g_long_view && find_bracket_pair(edit, FALSE, at, ch);
+    if (shown && g_match_shown && at[0] == g_match_at[0] && at[1] == g_match_at[1]) {
+        draw_bracket_frames(edit);
+        return;
+    }
+    invalidate_bracket_frames(edit);
+    g_match_shown = shown;
+    if (!shown) return;
+    memcpy(g_match_at, at, sizeof(g_match_at));
+    memcpy(g_match_char, ch, sizeof(g_match_char));
+    draw_bracket_frames(edit);
+}
+
+// Lands on the same side of the other bracket, so pressing it again returns.
+static void goto_matching_bracket(void) {
+    DWORD at[2];
+    char ch[2];
+    DWORD caret = 0;
+
+    if (g_hex || g_csv || g_fold_view || g_long_view || !find_bracket_pair(g_edit, TRUE, at, ch)) {
+        MessageBeep(MB_OK);
+        return;
+    }
+    SendMessageA(g_edit, EM_GETSEL, (WPARAM)&caret, 0);
+    DWORD target = caret == at[0] ? at[1] : at[1] + 1u;
+    SendMessageA(g_edit, EM_SETSEL, target, target);
+    SendMessageA(g_edit, EM_SCROLLCARET, 0, 0);
+}
+
+static void read_edit_state(HWND edit, EditState *st) {
+    SendMessageA(edit, EM_GETSEL, (WPARAM)&st->sel_start, (LPARAM)&st->sel_end);
+    st->length = GetWindowTextLengthA(edit);
+}
+
+// One replaced span to the journal, the word index, the document mirror and
+// the structure index, whichever are active. `text` is the document as it
+// stands after this span and `len` its length.
+static void follow_edit_span(const char *text, size_t len, DWORD start, long deleted, long inserted) {
+    if (g_journal) journal_append(g_journal, start, (uint64_t)deleted, text + start, (size_t)inserted, (uint64_t)len);
+    if (g_words.ordered || g_words_job) follow_word_edit(text, len, start, deleted, inserted);
+    if (g_doc_mirror && !doc_mirror_replace(g_doc_mirror, start, (uint64_t)deleted, text + start, (size_t)inserted)) {
+        log_message("snapshot: mirror update failed, dropping it");
+        drop_doc_mirror();
+    }
+    if (g_struct.blocks && !struct_index_edit(&g_struct, text, len, start, (uint64_t)deleted, (uint64_t)inserted)) {
+        log_message("structure: index update failed, dropping it");
+        drop_struct_index();
+    }
+}
+
+static void follow_patch_span(void *ctx, const char *text, size_t len, uint64_t offset, uint64_t delete_len, uint64_t insert_len) {
+    (void)ctx;
+    follow_edit_span(text, len, (DWORD)offset, (long)delete_len, (long)insert_len);
+}
+
+// Every mutating EDIT message replaces [a, a + deleted) with [a, a + inserted)
+// and leaves the caret (or the selected insertion) right after the new text,
+// so the change follows from the selection and length before and after. It
+// goes to the bookmarks and then to follow_edit_span.
+static void capture_edit_change(HWND edit, const EditState *before, const EditState *after) {
+    DWORD start = before->sel_start < after->sel_start ? before->sel_start : after->sel_start;
+    long inserted = (long)after->sel_end - (long)start;
+    long deleted = (long)before->length - (long)after->length + inserted;
+    HLOCAL handle = NULL;
+    const char *text;
+
+    if (inserted == 0 && deleted == 0) return;
+    // Any other edit leaves the extra carets behind.
+    if (!g_multi_patch && g_multi.count > 0) {
+        multi_edit_clear(&g_multi);
+        InvalidateRect(edit, NULL, FALSE);
+    }
+    if (inserted < 0 || deleted < 0 || (long)start + deleted > (long)before->length) {
+        clamp_markers(before->length, after->length);
+        if (g_journal) journal_whole_text(edit);
+        drop_doc_mirror();
+        drop_struct_index();
+        return;
+    }
+
+    // A batched edit replaces one span, but bookmarks between its carets
+    // stay put: follow its ranges, the last first so earlier offsets hold.
+    BOOL marked = TRUE;
+    if (g_multi_patch) {
+        for (size_t i = g_multi_patch->range_count; marked && i-- > 0;) {
+            const MultiRange *r = &g_multi_patch->ranges[i];
+            marked = marker_tree_edit(&g_markers, r->offset, r->delete_len, r->insert_len) != 0;
+        }
+    } else {
+        marked = marker_tree_edit(&g_markers, start, (uint64_t)deleted, (uint64_t)inserted) != 0;
+    }
+    if (!marked) {
+        log_message("bookmarks: out of memory following an edit, clearing them");
+        marker_tree_clear(&g_markers);
+    }
+    text = lock_editor_buffer(edit, &handle);
+    if (!text) {
+        drop_doc_mirror();
+        drop_struct_index();
+        return;
+    }
+    if (g_multi_patch && g_multi_patch->start == start && g_multi_patch->end == start + (uint64_t)deleted) {
+        // Range by range, so the indexes only rescan the lines the carets are on.
+        multi_patch_each_span(g_multi_patch, text, (size_t)after->length, follow_patch_span, NULL);
+    } else {
+        follow_edit_span(text, (size_t)after->length, start, deleted, inserted);
+    }
+    unlock_editor_buffer(handle);
+}
+
+// EN_CHANGE arrives while the EDIT control is still inside the message that
+// changed the text. When edit_proc did not wrap that message, nothing above
+// saw the change, so the mirror and indexes can no longer be trusted.
+static void follow_uncaptured_change(HWND edit) {
+    if (g_change_captured) return;
+    if (!g_journal && !g_doc_mirror && !g_struct.blocks && !g_words.ordered && !g_words_job && !g_multi.count &&
+        !marker_tree_count(&g_markers)) {
+        return;
+    }
+    int len = GetWindowTextLengthA(edit);
+    log_message("edit: change outside edit_proc, resyncing (%d bytes)", len);
+    // The old length is not known here; no bookmark can sit past INT_MAX.
+    clamp_markers(INT_MAX, len);
+    if (g_multi.count > 0) {
+        multi_edit_clear(&g_multi);
+        InvalidateRect(edit, NULL, FALSE);
+    }
+    if (g_journal) journal_whole_text(edit);
+    drop_doc_mirror();
+    drop_struct_index();
+}
+
+static void apply_dark_title_bar(HWND hwnd) {
+    HMODULE dwm = LoadLibraryA("dwmapi.dll");
+    if (!dwm) return;
+
+    typedef HRESULT (WINAPI *DwmSetWindowAttributeFn)(HWND, DWORD, LPCVOID, DWORD);
+    FARPROC raw = GetProcAddress(dwm, "DwmSetWindowAttribute");
+    DwmSetWindowAttributeFn set_attr = NULL;
+    if (raw) {
+        memcpy(&set_attr, &raw, sizeof(set_attr));
+    }
+    if (set_attr) {
+        BOOL enabled = TRUE;
+        const DWORD DWMWA_USE_IMMERSIVE_DARK_MODE = 20;
+        set_attr(hwnd, DWMWA_USE_IMMERSIVE_DARK_MODE, &enabled, sizeof(enabled));
+    }
+
+    FreeLibrary(dwm);
+}
+
+static int file_sink(void *ctx, const void *data, size_t len) {
+    return aio_write((AioFile *)ctx, data, len);
+}
+
+static int gzip_sink(void *ctx, const void *data, size_t len) {
+    return gz_writer_write((GzWriter *)ctx, data, len);
+}
+
+// The document holds ANSI text for files that were UTF-16 on disk.
+static size_t acp_widen(void *ctx, const char *src, size_t src_len, uint16_t *dst, size_t dst_cap, size_t *consumed) {
+    size_t cut = 0;
+    int units;
+    (void)ctx;
+
+    // Never split a DBCS pair; each byte yields at most one UTF-16 unit.
+    while (cut < src_len) {
+        size_t step = IsDBCSLeadByte((BYTE)src[cut]) ? 2u : 1u;
+        if (cut + step > src_len || cut + step > dst_cap) break;
+        cut += step;
+    }
+    *consumed = cut;
+    if (cut == 0) return 0;
+
+    units = MultiByteToWideChar(CP_ACP, 0, src, (int)cut, (WCHAR *)dst, (int)dst_cap);
+    return units > 0 ? (size_t)units : 0;
+}
+
+// Streams straight from the EDIT buffer through a fixed-size output buffer,
+// re-encoding to the format the file was loaded with. Documents opened from
+// a .gz file are wrapped in gzip again (stored blocks, no compression).
+static BOOL save_editor_to_path(HWND hwnd, const char *path) {
+    static unsigned char out_buf[SAVE_BUFFER_SIZE];
+    static GzWriter gz_out;
+    TextWriter writer;
+    HLOCAL handle = NULL;
+    size_t len = (size_t)GetWindowTextLengthA(g_edit);
+    uint32_t crc = 0;
+
+    AioFile *f = aio_open(path, 1, AIO_BACKEND_AUTO);
+    if (!f) {
+        MessageBoxA(hwnd, "Could not open file for writing.", "Save Error", MB_OK | MB_ICONERROR);
+        return FALSE;
+    }
+
+    const char *text = lock_editor_buffer(g_edit, &handle);
+    if (!text) {
+        aio_close(f);
+        MessageBoxA(hwnd, "Could not access the editor text while saving.", "Save Error", MB_OK | MB_ICONERROR);
+        return FALSE;
+    }
+
+    if (g_gzip_source) {
+        gz_writer_init(&gz_out, file_sink, f);
+        text_writer_init(&writer, g_text_format, out_buf, sizeof(out_buf), gzip_sink, &gz_out);
+    } else {
+        text_writer_init(&writer, g_text_format, out_buf, sizeof(out_buf), file_sink, f);
+    }
+    if (g_text_format.encoding == TEXT_ENC_UTF16LE || g_text_format.encoding == TEXT_ENC_UTF16BE) {
+        text_writer_set_widen(&writer, acp_widen, NULL);
+    }
+
+    BOOL written = TRUE;
+    for (size_t pos = 0; pos < len && written; pos += SAVE_BUFFER_SIZE) {
+        size_t chunk = (len - pos < SAVE_BUFFER_SIZE) ? (len - pos) : SAVE_BUFFER_SIZE;
+        crc = crc32_update(crc, text + pos, chunk);
+        written = text_writer_write(&writer, text + pos, chunk);
+    }
+    unlock_editor_buffer(handle);
+    if (written) written = text_writer_finish(&writer);
+    if (written && g_gzip_source) written = gz_writer_finish(&gz_out);
+    if (!aio_close(f)) written = FALSE;
+    if (!written) {
+        MessageBoxA(hwnd, "Could not write the whole file.", "Save Error", MB_OK | MB_ICONERROR);
+        return FALSE;
+    }
+    log_message(
+        "save_editor_to_path: path=%s encoding=%s eol=%s gzip=%d bytes_in=%llu bytes_out=%llu",
+        path,
+        text_encoding_name(g_text_format.encoding),
+        text_eol_name(g_text_format.eol),
+        g_gzip_source ? 1 : 0,
+        (unsigned long long)writer.bytes_in,
+        (unsigned long long)writer.bytes_out
+    );
+
+    if (g_journal && lstrcmpiA(path, g_current_file) == 0) {
+        journal_compact(g_journal, (uint64_t)len, crc);
+    } else {
+        start_journal(path, len, crc);
+    }
+
+    lstrcpynA(g_current_file, path, MAX_PATH);
+    update_window_title(hwnd);
+    return TRUE;
+}
+
+// Writes the text as plain text to a file the user picks, defaulting to the
+// .gz name without its extension. The document stops being a gzip source.
+static void save_as_plain_text(HWND hwnd) {
+    OPENFILENAMEA ofn = {0};
+    char path[MAX_PATH];
+    int n;
+
+    lstrcpynA(path, g_current_file, MAX_PATH);
+    n = lstrlenA(path);
+    if (n > 3 && lstrcmpiA(path + n - 3, ".gz") == 0) path[n - 3] = '\0';
+
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = hwnd;
+    ofn.lpstrFile = path;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.lpstrFilter = "Text Files (*.txt)\0*.txt\0All Files (*.*)\0*.*\0";
+    ofn.nFilterIndex = 2;
+    ofn.Flags = OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST | OFN_HIDEREADONLY;
+    if (!GetSaveFileNameA(&ofn)) return;
+
+    g_gzip_source = FALSE;
+    if (!save_editor_to_path(hwnd, path)) {
+        g_gzip_source = TRUE;
+    }
+}
+
+// gz_writer only stores blocks, so saving back over a .gz can make it many
+// times larger than the file that was opened. Ask once per document.
+static void save_to_output_txt(HWND hwnd) {
+    // Saving one part back would cut the file down to that part.
+    if (g_gzip_parts) {
+        MessageBoxA(hwnd, "Only a part of this compressed file is open, so it cannot be saved.", "Save", MB_OK | MB_ICONWARNING);
+        return;
+    }
+    if (g_gzip_source && !g_gzip_save_ok) {
+        char msg[512];
+        snprintf(
+            msg, sizeof(msg),
+            "This editor writes gzip files without compression, so %s will grow to about "
+            "%.1f MB, the size of the text.\n\n"
+            "Yes: save it uncompressed anyway\n"
+            "No: save the text as a plain file instead\n"
+            "Cancel: do not save",
+            g_current_file,
+            (double)GetWindowTextLengthA(g_edit) / 1048576.0
+        );
+        int choice = MessageBoxA(hwnd, msg, "Save Compressed File", MB_YESNOCANCEL | MB_ICONWARNING);
+        if (choice == IDCANCEL) return;
+        if (choice == IDNO) {
+            save_as_plain_text(hwnd);
+            return;
+        }
+        g_gzip_save_ok = TRUE;
+    }
+    save_editor_to_path(hwnd, g_current_file[0] ? g_current_file : "output.txt");
+}
+
+// The accounted subsystems, then what Windows holds for us: the EDIT
+// control's buffer and the GDI object count.
+static void format_memory_usage(char *dst, size_t cap, const char *prefix, const char *sep) {
+    HLOCAL handle = g_edit ? (HLOCAL)SendMessageA(g_edit, EM_GETHANDLE, 0, 0) : NULL;
+    size_t at = (size_t)snprintf(dst, cap, "%s", prefix);
+    if (at >= cap) return;
+    at += mem_account_report(dst + at, cap - at, sep);
+    if (at >= cap) return;
+    snprintf(
+        dst + at, cap - at, "%sedit control %.1f MB%sGDI objects %lu",
+        sep,
+        handle ? (double)LocalSize(handle) / 1048576.0 : 0.0,
+        sep,
+        (unsigned long)GetGuiResources(GetCurrentProcess(), GR_GDIOBJECTS)
+    );
+}
+
+static void show_memory_usage(HWND hwnd) {
+    char report[1024];
+    format_memory_usage(report, sizeof(report), "memory: ", ", ");
+    log_message("%s", report);
+    format_memory_usage(report, sizeof(report), "", "\n");
+    lstrcatA(report, "\n\nAlso written to editor.log.");
+    show_skinned_info_box(hwnd, "Memory Usage", report);
+}
+
+static void show_file_info_prompt(HWND hwnd) {
+    if (g_hex) {
+        char info[MAX_PATH + 192];
+        snprintf(
+            info, sizeof(info),
+            "File: %s\nView: Hex (binary content)\nBytes: %llu\nUnsaved byte changes: %llu\nWritable: %s",
+            g_current_file,
+            (unsigned long long)hex_doc_size(g_hex),
+            (unsigned long long)hex_doc_patch_count(g_hex),
+            hex_doc_writable(g_hex) && !g_read_only ? "yes" : "no"
+        );
+        show_skinned_info_box(hwnd, "File Info", info);
+        return;
+    }
+
+    HLOCAL handle = NULL;
+    size_t len = (size_t)GetWindowTextLengthA(g_edit);
+    const char *text = lock_editor_buffer(g_edit, &handle);
+    if (!text) {
+        MessageBoxA(hwnd, "Could not access the editor text while gathering file info.", "File Info", MB_OK | MB_ICONERROR);
+        return;
+    }
+
+    // UTF-16 files were converted to the ANSI code page on load; everything
+    // else is counted as UTF-8.
+    BOOL utf8 = g_text_format.encoding != TEXT_ENC_UTF16LE && g_text_format.encoding != TEXT_ENC_UTF16BE;
+    DocStats stats;
+    uint64_t started = sys_now_us();
+    unsigned slices = doc_stats_compute(&stats, text, len, utf8, 0);
+    double ms = (double)(sys_now_us() - started) / 1000.0;
+    unlock_editor_buffer(handle);
+
+    const char *path = g_current_file[0] ? g_current_file : "(unsaved)";
+    char msg[2048];
+    int at = snprintf(
+        msg, sizeof(msg),
+        "File: %s\nBytes: %llu\nCode points: %llu (%.1f%% non-ASCII)\nWords: %llu\n"
+        "Lines: %llu (longest %llu bytes)\nLine lengths:",
+        path,
+        (unsigned long long)stats.bytes,
+        (unsigned long long)stats.code_points,
+        stats.code_points ? 100.0 * (double)stats.non_ascii / (double)stats.code_points : 0.0,
+        (unsigned long long)stats.words,
+        (unsigned long long)stats.lines,
+        (unsigned long long)stats.longest
+    );
+    const char *sep = " ";
+    for (unsigned i = 0; i < DOC_STATS_BUCKETS && at > 0 && (size_t)at < sizeof(msg); i++) {
+        if (stats.histogram[i] == 0) continue;
+        at += snprintf(
+            msg + at, sizeof(msg) - (size_t)at, "%s%s: %llu",
+            sep,
+            doc_stats_bucket_label(i),
+            (unsigned long long)stats.histogram[i]
+        );
+        sep = ", ";
+    }
+    if (at > 0 && (size_t)at < sizeof(msg)) {
+        snprintf(
+            msg + at, sizeof(msg) - (size_t)at,
+            "\nEncoding: %s\nLine endings: %s%s (CRLF %llu, LF %llu, CR %llu in the document)"
+            "\nScanned in %.1f ms on %u thread%s",
+            text_encoding_name(g_text_format.encoding),
+            text_eol_name(g_text_format.eol),
+            g_mixed_eol ? ", mixed in source" : "",
+            (unsigned long long)stats.crlf,
+            (unsigned long long)stats.lone_lf,
+            (unsigned long long)stats.lone_cr,
+            ms,
+            slices,
+            slices == 1 ? "" : "s"
+        );
+    }
+    if (g_gzip_source) {
+        lstrcatA(msg, "\nCompression: gzip (saved back as uncompressed gzip)");
+    }
+    if (g_csv) {
+        sys_mutex_lock(&g_csv->lock);
+        snprintf(
+            msg + lstrlenA(msg), sizeof(msg) - (size_t)lstrlenA(msg),
+            "\nCSV view: %llu rows%s, %u columns, separator %s",
+            (unsigned long long)csv_index_rows(&g_csv->index),
+            g_csv->joined ? "" : " so far",
+            csv_index_columns(&g_csv->index),
+            g_csv->index.sep == '\t' ? "tab" : (g_csv->index.sep == ',' ? "comma" : (g_csv->index.sep == ';' ? "semicolon" : "pipe"))
+        );
+        sys_mutex_unlock(&g_csv->lock);
+    }
+    DocPagerStats pages;
+    doc_pager_stats(&pages);
+    if (pages.budget > 0 || pages.peak_resident > 0) {
+        char budget[32] = "unlimited";
+        if (pages.budget > 0) snprintf(budget, sizeof(budget), "%llu MB", (unsigned long long)(pages.budget >> 20));
+        snprintf(
+            msg + lstrlenA(msg), sizeof(msg) - (size_t)lstrlenA(msg),
+            "\nDocument pages: %.1f MB resident (peak %.1f MB, budget %s), %.1f MB packed from %.1f MB,"
+            " %.1f MB spilled, %llu in / %llu out%s",
+            (double)pages.resident / 1048576.0,
+            (double)pages.peak_resident / 1048576.0,
+            budget,
+            (double)pages.compressed / 1048576.0,
+            (double)pages.compressed_from / 1048576.0,
+            (double)pages.spilled / 1048576.0,
+            (unsigned long long)pages.page_ins,
+            (unsigned long long)pages.page_outs,
+            pages.spill_failures ? ", swap file writes failing" : ""
+        );
+    }
+    format_memory_usage(msg + lstrlenA(msg), sizeof(msg) - (size_t)lstrlenA(msg), "\nMemory: ", ", ");
+    if (g_long_line_len > 0) {
+        wsprintfA(
+            msg + lstrlenA(msg),
+            "\nLongest line on load: %u bytes at offset %u%s",
+            (unsigned)g_long_line_len,
+            (unsigned)g_long_line_start,
+            g_doc_wrap ? ", wrapped for editing in this document only" : ""
+        );
+    }
+    show_skinned_info_box(hwnd, "File Info", msg);
+}
+
+// Works on the lines the selection touches, or the whole document when
+// nothing is selected, and puts the result back with one EM_REPLACESEL so a
+// single undo restores the original order.
+static void run_line_operation(HWND hwnd, LineSortMode sort, BOOL unique, BOOL reverse, const char *title) {
+    if (g_hex || g_csv || g_fold_view || g_long_view || g_read_only || g_paste || g_gzip_open || g_json_format) {
+        MessageBeep(MB_OK);
+        return;
+    }
+
+    DWORD start = 0;
+    DWORD end = 0;
+    DWORD len = (DWORD)GetWindowTextLengthA(g_edit);
+    SendMessageA(g_edit, EM_GETSEL, (WPARAM)&start, (LPARAM)&end);
+    if (end < start || end > len) end = start;
+    if (start == end) {
+        start = 0;
+        end = len;
+    }
+
+    HLOCAL handle = NULL;
+    const char *text = lock_editor_buffer(g_edit, &handle);
+    if (!text) {
+        MessageBoxA(hwnd, "Could not access the editor text.", title, MB_OK | MB_ICONERROR);
+        return;
+    }
+    while (start > 0 && text[start - 1] != '\n') start--;
+    if (end > start && text[end - 1] != '\n') {
+        while (end < len && text[end] != '\r' && text[end] != '\n') end++;
+    }
+
+    LineOps ops = { sort, unique, reverse, 0 };
+    LineOpsResult result;
+    size_t out_len = 0;
+    HCURSOR old_cursor = SetCursor(LoadCursor(NULL, IDC_WAIT));
+    uint64_t started = sys_now_us();
+    char *out = line_ops_apply(text + start, end - start, &ops, "\r\n", &out_len, &result);
+    double ms = (double)(sys_now_us() - started) / 1000.0;
+    unlock_editor_buffer(handle);
+    SetCursor(old_cursor);
+    if (!out) {
+        MessageBoxA(hwnd, "Not enough memory to rearrange the lines.", title, MB_OK | MB_ICONERROR);
+        return;
+    }
+
+    SendMessageA(g_edit, EM_SETSEL, start, end);
+    SendMessageA(g_edit, EM_REPLACESEL, TRUE, (LPARAM)out);
+    SendMessageA(g_edit, EM_SETSEL, start, start + (DWORD)out_len);
+    log_message(
+        "lines: %s %llu -> %llu lines (%llu bytes) in %.1f ms on %u thread(s)",
+        title,
+        (unsigned long long)result.lines_in,
+        (unsigned long long)result.lines_out,
+        (unsigned long long)out_len,
+        ms,
+        result.threads
+    );
+    free(out);
+}
+
+static size_t find_longest_line(const char *text, size_t size, size_t *out_start) {
+    size_t longest = 0;
+    size_t start = 0;
+    *out_start = 0;
+    while (start <= size) {
+        const char *nl = (const char *)memchr(text + start, '\n', size - start);
+        size_t end = nl ? (size_t)(nl - text) : size;
+        size_t len = end - start;
+        if (len > 0 && text[end - 1u] == '\r') len--;
+        if (len > longest) {
+            longest = len;
+            *out_start = start;
+        }
+        if (!nl) break;
+        start = end + 1u;
+    }
+    return longest;
+}
+
+// Minified JSON and single-line logs make a line-based layout quadratic: with
+// ES_AUTOHSCROLL the EDIT control re-measures the whole line on every caret
+// move. Such a document opens in the long-line view, which keeps the line
+// whole; the EDIT control behind it is wrapped for editing, which keeps every
+// visual row bounded. The global Word Wrap setting is left alone and comes
+// back with the next document. The title bar says when this happened.
+static void wrap_long_line_document(HWND hwnd, const char *text, size_t size) {
+    size_t start = 0;
+    size_t longest = find_longest_line(text, size, &start);
+
+    if (longest < LONG_LINE_THRESHOLD) {
+        end_document_wrap(hwnd);
+        return;
+    }
+    g_long_line_len = longest;
+    g_long_line_start = start;
+    log_message(
+        "wrap_long_line_document: %llu bytes at %llu, wrap %s",
+        (unsigned long long)longest,
+        (unsigned long long)start,
+        g_word_wrap ? "already on" : "on for this document"
+    );
+    if (!g_word_wrap && !g_doc_wrap) {
+        SetWindowTextA(g_edit, "");
+        set_wrap_mode(hwnd, FALSE, TRUE);
+    }
+}
+
+// The EDIT control only breaks lines on CRLF, so lone LF and CR are expanded
+// on load; the writer turns them back into the original style on save.
+static BOOL normalize_line_endings(char **buffer, size_t *size, EolScan *scan) {
+    eol_scan_init(scan);
+    eol_scan_update(scan, *buffer, *size);
+    if (eol_scan_lone_lf(scan) == 0 && eol_scan_lone_cr(scan) == 0) return TRUE;
+
+    uint64_t out_size = eol_scan_crlf_size(scan, *size);
+    if (out_size >= (uint64_t)((size_t)-1)) return FALSE;
+    char *out = (char *)malloc((size_t)out_size + 1u);
+    if (!out) return FALSE;
+
+    int after_cr = 0;
+    size_t written = eol_to_crlf(*buffer, *size, out, &after_cr);
+    out[written] = '\0';
+    free(*buffer);
+    *buffer = out;
+    *size = written;
+    return TRUE;
+}
+
+// Binary files are shown in a hex/ASCII view that reads only the visible
+// rows from a paged mapping; byte edits are patched in place on save.
+static HFONT create_view_font(void) {
+    return CreateFontA(
+        g_logfont.lfHeight ? g_logfont.lfHeight : -16, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE,
+        DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
+        CLEARTYPE_QUALITY, FIXED_PITCH | FF_MODERN, "Consolas"
+    );
+}
+
+static void measure_view_font(HWND hwnd, HFONT font, int *char_w, int *line_h) {
+    TEXTMETRICA tm;
+    HDC hdc = GetDC(hwnd);
+    HGDIOBJ old_font = SelectObject(hdc, font ? (HGDIOBJ)font : GetStockObject(ANSI_FIXED_FONT));
+    GetTextMetricsA(hdc, &tm);
+    SelectObject(hdc, old_font);
+    ReleaseDC(hwnd, hdc);
+    *char_w = tm.tmAveCharWidth > 0 ? tm.tmAveCharWidth : 8;
+    *line_h = tm.tmHeight > 0 ? tm.tmHeight : 16;
+}
+
+static uint64_t hex_row_count(void) {
+    return (hex_doc_size(g_hex) + HEX_ROW_BYTES - 1u) / HEX_ROW_BYTES;
+}
+
+static uint64_t hex_visible_rows(void) {
+    RECT rc;
+    GetClientRect(g_hex_view, &rc);
+    int rows = g_hex_line_h > 0 ? (rc.bottom - rc.top) / g_hex_line_h : 1;
+    return rows > 0 ? (uint64_t)rows : 1u;
+}
+
+// Scroll bars take an int; views with more rows than that are scaled.
+static int scroll_pos_from_row(uint64_t row, uint64_t rows) {
+    if (rows <= HEX_SCROLL_MAX) return (int)row;
+    return (int)((double)row * HEX_SCROLL_MAX / (double)rows);
+}
+
+static uint64_t row_from_scroll_pos(int pos, uint64_t rows) {
+    if (rows <= HEX_SCROLL_MAX) return (uint64_t)pos;
+    return (uint64_t)((double)pos * (double)rows / HEX_SCROLL_MAX);
+}
+
+// Any unit works: rows for the vertical bars, pixels for the long-line view.
+static void set_scaled_scrollbar(HWND hwnd, int bar, uint64_t top, uint64_t rows, uint64_t visible) {
+    SCROLLINFO si = {0};
+    si.cbSize = sizeof(si);
+    si.fMask = SIF_RANGE | SIF_PAGE | SIF_POS | SIF_DISABLENOSCROLL;
+    si.nMin = 0;
+    if (rows <= HEX_SCROLL_MAX) {
+        si.nMax = rows > 0 ? (int)(rows - 1u) : 0;
+        si.nPage = (UINT)visible;
+    } else {
+        si.nMax = HEX_SCROLL_MAX;
+        si.nPage = 1;
+    }
+    si.nPos = scroll_pos_from_row(top, rows);
+    SetScrollInfo(hwnd, bar, &si, TRUE);
+}
+
+static void set_row_scrollbar(HWND hwnd, uint64_t top, uint64_t rows, uint64_t visible) {
+    set_scaled_scrollbar(hwnd, SB_VERT, top, rows, visible);
+}
+
+static void hex_update_scrollbar(void) {
+    set_row_scrollbar(g_hex_view, g_hex_top, hex_row_count(), hex_visible_rows());
+}
+
+static void hex_scroll_to(uint64_t top) {
+    uint64_t rows = hex_row_count();
+    uint64_t visible = hex_visible_rows();
+    uint64_t max_top = rows > visible ? rows - visible : 0;
+    if (top > max_top) top = max_top;
+    if (top == g_hex_top) return;
+    g_hex_top = top;
+    hex_update_scrollbar();
+    InvalidateRect(g_hex_view, NULL, FALSE);
+}
+
+static void hex_move_cursor(uint64_t offset) {
+    uint64_t size = hex_doc_size(g_hex);
+    uint64_t row;
+    uint64_t visible = hex_visible_rows();
+
+    if (size == 0) return;
+    if (offset >= size) offset = size - 1u;
+    g_hex_cursor = offset;
+    g_hex_low_nibble = FALSE;
+    row = offset / HEX_ROW_BYTES;
+    if (row < g_hex_top) {
+        hex_scroll_to(row);
+    } else if (row >= g_hex_top + visible) {
+        hex_scroll_to(row - visible + 1u);
+    }
+    InvalidateRect(g_hex_view, NULL, FALSE);
+}
+
+// Character column of byte `i` in a row formatted by hex_format_row.
+static int hex_byte_column(size_t i) {
+    return 18 + (int)i * 3 + (i >= HEX_ROW_BYTES / 2u ? 1 : 0);
+}
+
+static int hex_ascii_column(size_t i) {
+    return 69 + (int)i;
+}
+
+static void hex_paint(HWND hwnd) {
+    PAINTSTRUCT ps;
+    HDC hdc = BeginPaint(hwnd, &ps);
+    RECT rc;
+    GetClientRect(hwnd, &rc);
+    FillRect(hdc, &rc, g_editor_brush);
+
+    HGDIOBJ old_font = SelectObject(hdc, g_hex_font ? (HGDIOBJ)g_hex_font : GetStockObject(ANSI_FIXED_FONT));
+    SetBkMode(hdc, TRANSPARENT);
+    uint64_t visible = hex_visible_rows() + 1u;
+    uint64_t size = hex_doc_size(g_hex);
+    unsigned char bytes[HEX_ROW_BYTES];
+    char text[HEX_ROW_TEXT];
+
+    for (uint64_t r = 0; r < visible; r++) {
+        uint64_t offset = (g_hex_top + r) * HEX_ROW_BYTES;
+        int y = (int)r * g_hex_line_h;
+        size_t n;
+        if (offset >= size) break;
+        n = hex_doc_read(g_hex, offset, bytes, HEX_ROW_BYTES);
+        hex_format_row(offset, bytes, n, text);
+
+        if (g_hex_cursor >= offset && g_hex_cursor < offset + n) {
+            size_t i = (size_t)(g_hex_cursor - offset);
+            RECT cell = {
+                HEX_VIEW_MARGIN + hex_byte_column(i) * g_hex_char_w, y,
+                HEX_VIEW_MARGIN + (hex_byte_column(i) + 2) * g_hex_char_w, y + g_hex_line_h
+            };
+            FillRect(hdc, &cell, g_menu_hot_brush);
+            cell.left = HEX_VIEW_MARGIN + hex_ascii_column(i) * g_hex_char_w;
+            cell.right = cell.left + g_hex_char_w;
+            FillRect(hdc, &cell, g_menu_hot_brush);
+        }
+        SetTextColor(hdc, COLOR_TEXT);
+        TextOutA(hdc, HEX_VIEW_MARGIN, y, text, lstrlenA(text));
+
+        // Unsaved bytes are redrawn in the accent color.
+        SetTextColor(hdc, COLOR_ACCENT);
+        for (size_t i = 0; i < n && hex_doc_patch_count(g_hex) > 0; i++) {
+            if (!hex_doc_is_patched(g_hex, offset + i)) continue;
+            TextOutA(hdc, HEX_VIEW_MARGIN + hex_byte_column(i) * g_hex_char_w, y, text + hex_byte_column(i), 2);
+            TextOutA(hdc, HEX_VIEW_MARGIN + hex_ascii_column(i) * g_hex_char_w, y, text + hex_ascii_column(i), 1);
+        }
+    }
+    SelectObject(hdc, old_font);
+    EndPaint(hwnd, &ps);
+}
+
+static void hex_edit_nibble(HWND hwnd, unsigned value) {
+    unsigned char byte = 0;
+    if (g_read_only || !hex_doc_writable(g_hex) || hex_doc_size(g_hex) == 0) {
+        MessageBeep(MB_OK);
+        return;
+    }
+    hex_doc_read(g_hex, g_hex_cursor, &byte, 1);
+    if (g_hex_low_nibble) {
+        byte = (unsigned char)((byte & 0xF0u) | value);
+    } else {
+        byte = (unsigned char)((byte & 0x0Fu) | (value << 4));
+    }
+    if (!hex_doc_set_byte(g_hex, g_hex_cursor, byte)) {
+        MessageBeep(MB_ICONERROR);
+        return;
+    }
+    if (g_hex_low_nibble) {
+        hex_move_cursor(g_hex_cursor + 1u);
+    } else {
+        g_hex_low_nibble = TRUE;
+        InvalidateRect(hwnd, NULL, FALSE);
+    }
+    update_window_title(GetParent(hwnd));
+}
+
+static LRESULT CALLBACK hex_view_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
+    switch (msg) {
+        case WM_ERASEBKGND:
+            return 1;
+
+        case WM_PAINT:
+            hex_paint(hwnd);
+            return 0;
+
+        case WM_SIZE:
+            hex_update_scrollbar();
+            return 0;
+
+        case WM_VSCROLL: {
+            uint64_t page = hex_visible_rows();
+            switch (LOWORD(wparam)) {
+                case SB_LINEUP: hex_scroll_to(g_hex_top > 0 ? g_hex_top - 1u : 0); break;
+                case SB_LINEDOWN: hex_scroll_to(g_hex_top + 1u); break;
+                case SB_PAGEUP: hex_scroll_to(g_hex_top > page ? g_hex_top - page : 0); break;
+                case SB_PAGEDOWN: hex_scroll_to(g_hex_top + page); break;
+                case SB_TOP: hex_scroll_to(0); break;
+                case SB_BOTTOM: hex_scroll_to(hex_row_count()); break;
+                case SB_THUMBTRACK:
+                case SB_THUMBPOSITION: {
+                    SCROLLINFO si = {0};
+                    si.cbSize = sizeof(si);
+                    si.fMask = SIF_TRACKPOS;
+                    GetScrollInfo(hwnd, SB_VERT, &si);
+                    hex_scroll_to(row_from_scroll_pos(si.nTrackPos, hex_row_count()));
+                    break;
+                }
+                default:
+                    break;
+            }
+            return 0;
+        }
+
+        case WM_MOUSEWHEEL: {
+            int steps = GET_WHEEL_DELTA_WPARAM(wparam) / WHEEL_DELTA * 3;
+            if (steps > 0) {
+                hex_scroll_to(g_hex_top > (uint64_t)steps ? g_hex_top - (uint64_t)steps : 0);
+            } else {
+                hex_scroll_to(g_hex_top + (uint64_t)(-steps));
+            }
+            return 0;
+        }
+
+        case WM_LBUTTONDOWN: {
+            int x = (GET_X_LPARAM(lparam) - HEX_VIEW_MARGIN) / (g_hex_char_w > 0 ? g_hex_char_w : 1);
+            uint64_t row = g_hex_top + (uint64_t)(GET_Y_LPARAM(lparam) / (g_hex_line_h > 0 ? g_hex_line_h : 1));
+            SetFocus(hwnd);
+            for (size_t i = 0; i < HEX_ROW_BYTES; i++) {
+                if ((x >= hex_byte_column(i) && x < hex_byte_column(i) + 2) || x == hex_ascii_column(i)) {
+                    hex_move_cursor(row * HEX_ROW_BYTES + i);
+                    break;
+                }
+            }
+            return 0;
+        }
+
+        case WM_GETDLGCODE:
+            return DLGC_WANTARROWS | DLGC_WANTCHARS;
+
+        case WM_KEYDOWN: {
+            uint64_t page = hex_visible_rows() * HEX_ROW_BYTES;
+            BOOL ctrl = (GetKeyState(VK_CONTROL) & 0x8000) != 0;
+            switch (wparam) {
+                case VK_LEFT: hex_move_cursor(g_hex_cursor > 0 ? g_hex_cursor - 1u : 0); return 0;
+                case VK_RIGHT: hex_move_cursor(g_hex_cursor + 1u); return 0;
+                case VK_UP:
+                    if (g_hex_cursor >= HEX_ROW_BYTES) hex_move_cursor(g_hex_cursor - HEX_ROW_BYTES);
+                    return 0;
+                case VK_DOWN: hex_move_cursor(g_hex_cursor + HEX_ROW_BYTES); return 0;
+                case VK_PRIOR: hex_move_cursor(g_hex_cursor > page ? g_hex_cursor - page : 0); return 0;
+                case VK_NEXT: hex_move_cursor(g_hex_cursor + page); return 0;
+                case VK_HOME:
+                    hex_move_cursor(ctrl ? 0 : g_hex_cursor - g_hex_cursor % HEX_ROW_BYTES);
+                    return 0;
+                case VK_END:
+                    hex_move_cursor(ctrl ? hex_doc_size(g_hex) : g_hex_cursor - g_hex_cursor % HEX_ROW_BYTES + HEX_ROW_BYTES - 1u);
+                    return 0;
+                default:
+                    break;
+            }
+            break;
+        }
+
+        case WM_CHAR: {
+            char c = (char)wparam;
+            if (c >= '0' && c <= '9') {
+                hex_edit_nibble(hwnd, (unsigned)(c - '0'));
+            } else if (c >= 'a' && c <= 'f') {
+                hex_edit_nibble(hwnd, (unsigned)(c - 'a' + 10));
+            } else if (c >= 'A' && c <= 'F') {
+                hex_edit_nibble(hwnd, (unsigned)(c - 'A' + 10));
+            }
+            return 0;
+        }
+
+        default:
+            break;
+    }
+    return DefWindowProcA(hwnd, msg, wparam, lparam);
+}
+
+static BOOL register_hex_view_class(HINSTANCE instance) {
+    WNDCLASSA wc = {0};
+    wc.lpfnWndProc = hex_view_proc;
+    wc.hInstance = instance;
+    wc.hCursor = LoadCursor(NULL, IDC_IBEAM);
+    wc.lpszClassName = "EditorHexViewClass";
+    return RegisterClassA(&wc) != 0;
+}
+
+static BOOL save_hex_patches(HWND hwnd) {
+    size_t count = hex_doc_patch_count(g_hex);
+    if (count == 0) return TRUE;
+    if (!hex_doc_write_back(g_hex)) {
+        log_message("save_hex_patches: write-back failed path=%s err=%lu", g_current_file, (unsigned long)GetLastError());
+        MessageBoxA(hwnd, "Could not write the changed bytes.", "Save Error", MB_OK | MB_ICONERROR);
+        return FALSE;
+    }
+    log_message("save_hex_patches: wrote %llu patched bytes path=%s", (unsigned long long)count, g_current_file);
+    update_window_title(hwnd);
+    InvalidateRect(g_hex_view, NULL, FALSE);
+    return TRUE;
+}
+
+// Returns FALSE when the user cancels leaving a hex view with unsaved bytes.
+static BOOL confirm_hex_patches(HWND hwnd) {
+    if (!g_hex || hex_doc_patch_count(g_hex) == 0) return TRUE;
+    int choice = MessageBoxA(
+        hwnd, "Write the changed bytes to the file?", "Hex View", MB_YESNOCANCEL | MB_ICONQUESTION
+    );
+    if (choice == IDCANCEL) return FALSE;
+    if (choice == IDYES) return save_hex_patches(hwnd);
+    hex_doc_discard(g_hex);
+    return TRUE;
+}
+
+static void leave_hex_view(void) {
+    if (!g_hex) return;
+    DestroyWindow(g_hex_view);
+    g_hex_view = NULL;
+    hex_doc_close(g_hex);
+    g_hex = NULL;
+    if (g_hex_font) {
+        DeleteObject(g_hex_font);
+        g_hex_font = NULL;
+    }
+    ShowWindow(g_edit, SW_SHOW);
+}
+
+static BOOL enter_hex_view(HWND hwnd, const char *path) {
+    HexDoc *doc = hex_doc_open(path);
+    if (!doc) {
+        log_message("enter_hex_view: open failed path=%s err=%lu", path, (unsigned long)GetLastError());
+        return FALSE;
+    }
+
+    abort_streaming_paste(hwnd);
+    abort_gzip_open(hwnd);
+    drop_gzip_parts(hwnd);
+    abort_json_format(hwnd);
+    leave_csv_view(hwnd);
+    leave_fold_view(hwnd);
+    leave_long_line_view(hwnd);
+    stop_journal();
+    leave_hex_view();
+    SetWindowTextA(g_edit, "");
+    end_document_wrap(hwnd);
+    ShowWindow(g_edit, SW_HIDE);
+
+    g_hex = doc;
+    g_hex_top = 0;
+    g_hex_cursor = 0;
+    g_hex_low_nibble = FALSE;
+    g_hex_font = create_view_font();
+
+    RECT rc;
+    get_editor_rect(hwnd, &rc);
+    g_hex_view = CreateWindowExA(
+        0, "EditorHexViewClass", "",
+        WS_CHILD | WS_VISIBLE | WS_VSCROLL,
+        rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top,
+        hwnd, NULL, (HINSTANCE)GetWindowLongPtrA(hwnd, GWLP_HINSTANCE), NULL
+    );
+
+    measure_view_font(g_hex_view, g_hex_font, &g_hex_char_w, &g_hex_line_h);
+    hex_update_scrollbar();
+    SetFocus(g_hex_view);
+    lstrcpynA(g_current_file, path, MAX_PATH);
+    update_window_title(hwnd);
+    log_message(
+        "enter_hex_view: path=%s size=%llu writable=%d",
+        path,
+        (unsigned long long)hex_doc_size(doc),
+        hex_doc_writable(doc)
+    );
+    return TRUE;
+}
+
+// The CSV column view shows a snapshot of the document as aligned columns.
+// A worker builds the row index in the background; painting splits only the
+// visible rows, and column widths come from sampled rows, not a full pass.
+static size_t csv_read(void *ctx, uint64_t offset, char *dst, size_t len) {
+    return doc_snapshot_read((const DocSnapshot *)ctx, offset, dst, len);
+}
+
+static uint64_t csv_row_count(void) {
+    sys_mutex_lock(&g_csv->lock);
+    uint64_t rows = csv_index_rows(&g_csv->index);
+    sys_mutex_unlock(&g_csv->lock);
+    return rows;
+}
+
+static uint64_t csv_visible_rows(void) {
+    RECT rc;
+    GetClientRect(g_csv_view, &rc);
+    int rows = g_csv_line_h > 0 ? (rc.bottom - rc.top) / g_csv_line_h : 1;
+    return rows > 0 ? (uint64_t)rows : 1u;
+}
+
+// Total width of the sampled columns, gaps included, in characters.
+static int csv_total_width(void) {
+    int width = 0;
+    for (unsigned c = 0; c < g_csv->columns; c++) {
+        width += (int)(g_csv->widths[c] > 0 ? g_csv->widths[c] : 1u) + CSV_COLUMN_GAP;
+    }
+    return width;
+}
+
+static int csv_visible_chars(void) {
+    RECT rc;
+    GetClientRect(g_csv_view, &rc);
+    int chars = g_csv_char_w > 0 ? (rc.right - rc.left - HEX_VIEW_MARGIN) / g_csv_char_w : 1;
+    return chars > 0 ? chars : 1;
+}
+
+static void csv_update_scrollbars(void) {
+    set_row_scrollbar(g_csv_view, g_csv_top, csv_row_count(), csv_visible_rows());
+
+    SCROLLINFO si = {0};
+    int total = csv_total_width();
+    si.cbSize = sizeof(si);
+    si.fMask = SIF_RANGE | SIF_PAGE | SIF_POS | SIF_DISABLENOSCROLL;
+    si.nMin = 0;
+    si.nMax = total > 0 ? total - 1 : 0;
+    si.nPage = (UINT)csv_visible_chars();
+    si.nPos = g_csv_left;
+    SetScrollInfo(g_csv_view, SB_HORZ, &si, TRUE);
+}
+
+static void csv_scroll_to(uint64_t top, int left) {
+    uint64_t rows = csv_row_count();
+    uint64_t visible = csv_visible_rows();
+    uint64_t max_top = rows > visible ? rows - visible : 0;
+    int max_left = csv_total_width() - csv_visible_chars();
+    if (top > max_top) top = max_top;
+    if (left > max_left) left = max_left;
+    if (left < 0) left = 0;
+    if (top == g_csv_top && left == g_csv_left) return;
+    g_csv_top = top;
+    g_csv_left = left;
+    csv_update_scrollbars();
+    InvalidateRect(g_csv_view, NULL, FALSE);
+}
+
+// Resamples the widths when the index has seen more columns than they cover
+// (or always, with `force`, once indexing is complete).
+static void csv_refresh_widths(BOOL force) {
+    BOOL utf8 = g_text_format.encoding != TEXT_ENC_UTF16LE && g_text_format.encoding != TEXT_ENC_UTF16BE;
+    sys_mutex_lock(&g_csv->lock);
+    unsigned columns = csv_index_columns(&g_csv->index);
+    if (columns > CSV_VIEW_MAX_COLUMNS) columns = CSV_VIEW_MAX_COLUMNS;
+    if (force || columns > g_csv->columns) {
+        memset(g_csv->widths, 0, sizeof(g_csv->widths));
+        csv_sample_widths(&g_csv->index, csv_read, g_csv->source, g_csv->widths, columns, CSV_VIEW_SAMPLES, utf8);
+        g_csv->columns = columns;
+    }
+    sys_mutex_unlock(&g_csv->lock);
+}
+
+static void csv_paint(HWND hwnd) {
+    PAINTSTRUCT ps;
+    HDC hdc = BeginPaint(hwnd, &ps);
+    RECT rc;
+    GetClientRect(hwnd, &rc);
+    FillRect(hdc, &rc, g_editor_brush);
+
+    HGDIOBJ old_font = SelectObject(hdc, g_csv_font ? (HGDIOBJ)g_csv_font : GetStockObject(ANSI_FIXED_FONT));
+    SetBkMode(hdc, TRANSPARENT);
+    uint64_t offsets[CSV_VIEW_MAX_ROWS + 1];
+    uint64_t visible = csv_visible_rows() + 1u;
+    if (visible > CSV_VIEW_MAX_ROWS) visible = CSV_VIEW_MAX_ROWS;
+    sys_mutex_lock(&g_csv->lock);
+    size_t rows = csv_index_locate(&g_csv->index, g_csv_top, (size_t)visible, csv_read, g_csv->source, offsets);
+    char sep = g_csv->index.sep;
+    sys_mutex_unlock(&g_csv->lock);
+
+    int left = HEX_VIEW_MARGIN - g_csv_left * g_csv_char_w;
+    char text[CSV_VIEW_CELL_TEXT];
+    for (size_t r = 0; r < rows; r++) {
+        uint64_t span = offsets[r + 1u] - offsets[r];
+        size_t len = doc_snapshot_read(g_csv->source, offsets[r], g_csv->row, span < CSV_VIEW_ROW_READ ? (size_t)span : CSV_VIEW_ROW_READ);
+        size_t count = csv_split_row(g_csv->row, len, sep, g_csv->fields, CSV_VIEW_MAX_COLUMNS);
+        int y = (int)r * g_csv_line_h;
+        int x = left;
+
+        // The first row is usually a header.
+        SetTextColor(hdc, g_csv_top + r == 0 ? COLOR_ACCENT : COLOR_TEXT);
+        if (count > CSV_VIEW_MAX_COLUMNS) count = CSV_VIEW_MAX_COLUMNS;
+        for (size_t c = 0; c < count && x < rc.right; c++) {
+            unsigned chars = c < g_csv->columns && g_csv->widths[c] > 0 ? g_csv->widths[c] : 1u;
+            int w = (int)chars * g_csv_char_w;
+            if (x + w > 0) {
+                RECT cell = {x, y, x + w, y + g_csv_line_h};
+                size_t n = csv_field_text(g_csv->row, &g_csv->fields[c], text, sizeof(text));
+                for (size_t i = 0; i < n; i++) {
+                    if ((unsigned char)text[i] < ' ') text[i] = ' ';
+                }
+                ExtTextOutA(hdc, x, y, ETO_CLIPPED, &cell, text, (UINT)n, NULL);
+            }
+            x += w + CSV_COLUMN_GAP * g_csv_char_w;
+        }
+    }
+
+    // Column rules sit in the middle of each gap.
+    HGDIOBJ old_pen = SelectObject(hdc, g_frame_pen);
+    int x = left;
+    for (unsigned c = 0; c + 1u < g_csv->columns && x < rc.right; c++) {
+        x += (int)(g_csv->widths[c] > 0 ? g_csv->widths[c] : 1u) * g_csv_char_w;
+        int rule = x + CSV_COLUMN_GAP * g_csv_char_w / 2;
+        if (rule > 0) {
+            MoveToEx(hdc, rule, 0, NULL);
+            LineTo(hdc, rule, (int)rows * g_csv_line_h);
+        }
+        x += CSV_COLUMN_GAP * g_csv_char_w;
+    }
+    SelectObject(hdc, old_pen);
+    SelectObject(hdc, old_font);
+    EndPaint(hwnd, &ps);
+}
+
+static LRESULT CALLBACK csv_view_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
+    switch (msg) {
+        case WM_ERASEBKGND:
+            return 1;
+
+        case WM_PAINT:
+            if (!g_csv) break;
+            csv_paint(hwnd);
+            return 0;
+
+        case WM_SIZE:
+            if (g_csv) csv_update_scrollbars();
+            return 0;
+
+        case WM_VSCROLL: {
+            uint64_t page = csv_visible_rows();
+            switch (LOWORD(wparam)) {
+                case SB_LINEUP: csv_scroll_to(g_csv_top > 0 ? g_csv_top - 1u : 0, g_csv_left); break;
+                case SB_LINEDOWN: csv_scroll_to(g_csv_top + 1u, g_csv_left); break;
+                case SB_PAGEUP: csv_scroll_to(g_csv_top > page ? g_csv_top - page : 0, g_csv_left); break;
+                case SB_PAGEDOWN: csv_scroll_to(g_csv_top + page, g_csv_left); break;
+                case SB_TOP: csv_scroll_to(0, g_csv_left); break;
+                case SB_BOTTOM: csv_scroll_to(csv_row_count(), g_csv_left); break;
+                case SB_THUMBTRACK:
+                case SB_THUMBPOSITION: {
+                    SCROLLINFO si = {0};
+                    si.cbSize = sizeof(si);
+                    si.fMask = SIF_TRACKPOS;
+                    GetScrollInfo(hwnd, SB_VERT, &si);
+                    csv_scroll_to(row_from_scroll_pos(si.nTrackPos, csv_row_count()), g_csv_left);
+                    break;
+                }
+                default:
+                    break;
+            }
+            return 0;
+        }
+
+        case WM_HSCROLL: {
+            int page = csv_visible_chars();
+            switch (LOWORD(wparam)) {
+                case SB_LINELEFT: csv_scroll_to(g_csv_top, g_csv_left - 1); break;
+                case SB_LINERIGHT: csv_scroll_to(g_csv_top, g_csv_left + 1); break;
+                case SB_PAGELEFT: csv_scroll_to(g_csv_top, g_csv_left - page); break;
+                case SB_PAGERIGHT: csv_scroll_to(g_csv_top, g_csv_left + page); break;
+                case SB_LEFT: csv_scroll_to(g_csv_top, 0); break;
+                case SB_RIGHT: csv_scroll_to(g_csv_top, csv_total_width()); break;
+                case SB_THUMBTRACK:
+                case SB_THUMBPOSITION: {
+                    SCROLLINFO si = {0};
+                    si.cbSize = sizeof(si);
+                    si.fMask = SIF_TRACKPOS;
+                    GetScrollInfo(hwnd, SB_HORZ, &si);
+                    csv_scroll_to(g_csv_top, si.nTrackPos);
+                    break;
+                }
+                default:
+                    break;
+            }
+            return 0;
+        }
+
+        case WM_MOUSEWHEEL: {
+            int steps = GET_WHEEL_DELTA_WPARAM(wparam) / WHEEL_DELTA * 3;
+            if (steps > 0) {
+                csv_scroll_to(g_csv_top > (uint64_t)steps ? g_csv_top - (uint64_t)steps : 0, g_csv_left);
+            } else if (steps < 0) {
+                csv_scroll_to(g_csv_top + (uint64_t)(-steps), g_csv_left);
+            }
+            return 0;
+        }
+
+        case WM_LBUTTONDOWN:
+            SetFocus(hwnd);
+            return 0;
+
+        case WM_KEYDOWN: {
+            uint64_t page = csv_visible_rows();
+            BOOL ctrl = (GetKeyState(VK_CONTROL) & 0x8000) != 0;
+            switch (wparam) {
+                case VK_UP: csv_scroll_to(g_csv_top > 0 ? g_csv_top - 1u : 0, g_csv_left); return 0;
+                case VK_DOWN: csv_scroll_to(g_csv_top + 1u, g_csv_left); return 0;
+                case VK_PRIOR: csv_scroll_to(g_csv_top > page ? g_csv_top - page : 0, g_csv_left); return 0;
+                case VK_NEXT: csv_scroll_to(g_csv_top + page, g_csv_left); return 0;
+                case VK_LEFT: csv_scroll_to(g_csv_top, g_csv_left - (ctrl ? csv_visible_chars() : 1)); return 0;
+                case VK_RIGHT: csv_scroll_to(g_csv_top, g_csv_left + (ctrl ? csv_visible_chars() : 1)); return 0;
+                case VK_HOME: csv_scroll_to(ctrl ? 0 : g_csv_top, 0); return 0;
+                case VK_END: csv_scroll_to(ctrl ? csv_row_count() : g_csv_top, ctrl ? g_csv_left : csv_total_width()); return 0;
+                case VK_ESCAPE:
+                    if (g_csv && !g_csv->joined) InterlockedExchange(&g_csv->cancel, 1);
+                    return 0;
+                default:
+                    break;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+    return DefWindowProcA(hwnd, msg, wparam, lparam);
+}
+
+static BOOL register_csv_view_class(HINSTANCE instance) {
+    WNDCLASSA wc = {0};
+    wc.lpfnWndProc = csv_view_proc;
+    wc.hInstance = instance;
+    wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+    wc.lpszClassName = "EditorCsvViewClass";
+    return RegisterClassA(&wc) != 0;
+}
+
+static int csv_index_sink(void *ctx, const char *data, size_t len) {
+    CsvViewJob *job = (CsvViewJob *)ctx;
+    if (job->cancel) {
+        job->status = CSV_INDEX_CANCELLED;
+        return 0;
+    }
+    sys_mutex_lock(&job->lock);
+    int ok = csv_index_feed(&job->index, data, len);
+    sys_mutex_unlock(&job->lock);
+    if (!ok) {
+        job->status = CSV_INDEX_FAILED;
+        return 0;
+    }
+    job->fed += len;
+    unsigned percent = (unsigned)(job->fed * 100u / job->source_len);
+    if (percent != job->last_percent) {
+        job->last_percent = percent;
+        PostMessageA(job->hwnd, WM_APP_CSV_PROGRESS, job->id, percent);
+    }
+    return 1;
+}
+
+static int csv_index_worker(void *arg) {
+    CsvViewJob *job = (CsvViewJob *)arg;
+
+    doc_snapshot_serialize(job->source, 0, job->source_len, csv_index_sink, job);
+    if (job->status == CSV_INDEX_RUNNING) {
+        sys_mutex_lock(&job->lock);
+        int ok = csv_index_finish(&job->index);
+        sys_mutex_unlock(&job->lock);
+        job->status = ok ? CSV_INDEX_DONE : CSV_INDEX_FAILED;
+    }
+    PostMessageA(job->hwnd, WM_APP_CSV_DONE, job->id, 0);
+    return 0;
+}
+
+// Blocks until the worker stops; a cancelled index keeps the rows it found.
+static void leave_csv_view(HWND hwnd) {
+    CsvViewJob *job = g_csv;
+    if (!job) return;
+    InterlockedExchange(&job->cancel, 1);
+    if (!job->joined) sys_thread_join(&job->thread);
+    DestroyWindow(g_csv_view);
+    g_csv_view = NULL;
+    g_csv = NULL;
+    if (g_csv_font) {
+        DeleteObject(g_csv_font);
+        g_csv_font = NULL;
+    }
+    sys_mutex_destroy(&job->lock);
+    csv_index_free(&job->index);
+    doc_snapshot_release(job->source);
+    free(job->row);
+    free(job);
+
+    CheckMenuItem(GetMenu(hwnd), ID_VIEW_CSV, MF_BYCOMMAND | MF_UNCHECKED);
+    if (g_edit) {
+        SendMessageA(g_edit, EM_SETREADONLY, g_read_only || g_paste || g_gzip_open || g_json_format, 0);
+        ShowWindow(g_edit, SW_SHOW);
+        SetFocus(g_edit);
+    }
+    update_window_title(hwnd);
+}
+
+static BOOL path_has_extension(const char *path, const char *ext) {
+    const char *dot = strrchr(path, '.');
+    return dot && !strpbrk(dot, "\\/") && lstrcmpiA(dot, ext) == 0;
+}
+
+static void enter_csv_view(HWND hwnd) {
+    if (g_hex || g_csv || g_fold_view || g_long_view || g_paste || g_gzip_open || g_json_format) {
+        MessageBeep(MB_OK);
+        return;
+    }
+
+    size_t len = (size_t)GetWindowTextLengthA(g_edit);
+    HLOCAL handle = NULL;
+    const char *text = lock_editor_buffer(g_edit, &handle);
+    char sep = ',';
+    if (path_has_extension(g_current_file, ".tsv") || path_has_extension(g_current_file, ".tab")) {
+        sep = '\t';
+    } else if (text) {
+        sep = csv_detect_separator(text, len);
+    }
+    unlock_editor_buffer(handle);
+    DocSnapshot *source = text ? snapshot_document() : NULL;
+    CsvViewJob *job = source ? (CsvViewJob *)calloc(1, sizeof(CsvViewJob)) : NULL;
+    if (job) job->row = (char *)malloc(CSV_VIEW_ROW_READ);
+    if (!job || !job->row || !sys_mutex_init(&job->lock)) {
+        if (job) free(job->row);
+        free(job);
+        doc_snapshot_release(source);
+        MessageBoxA(hwnd, "Not enough memory to show the CSV columns.", "CSV Columns", MB_OK | MB_ICONERROR);
+        return;
+    }
+    job->hwnd = hwnd;
+    job->id = g_csv_next_id++;
+    job->source = source;
+    job->source_len = len;
+    job->started_us = sys_now_us();
+    csv_index_init(&job->index, sep);
+
+    // An empty document has nothing to index; the view just stays blank.
+    if (len == 0) {
+        csv_index_finish(&job->index);
+        job->status = CSV_INDEX_DONE;
+        job->joined = TRUE;
+    } else if (!sys_thread_start(&job->thread, csv_index_worker, job)) {
+        sys_mutex_destroy(&job->lock);
+        doc_snapshot_release(source);
+        free(job->row);
+        free(job);
+        return;
+    }
+
+    g_csv = job;
+    g_csv_percent = 0;
+    g_csv_top = 0;
+    g_csv_left = 0;
+    g_csv_font = create_view_font();
+    SendMessageA(g_edit, EM_SETREADONLY, TRUE, 0);
+    ShowWindow(g_edit, SW_HIDE);
+
+    RECT rc;
+    get_editor_rect(hwnd, &rc);
+    g_csv_view = CreateWindowExA(
+        0, "EditorCsvViewClass", "",
+        WS_CHILD | WS_VISIBLE | WS_VSCROLL | WS_HSCROLL,
+        rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top,
+        hwnd, NULL, (HINSTANCE)GetWindowLongPtrA(hwnd, GWLP_HINSTANCE), NULL
+    );
+    measure_view_font(g_csv_view, g_csv_font, &g_csv_char_w, &g_csv_line_h);
+    csv_update_scrollbars();
+    SetFocus(g_csv_view);
+    CheckMenuItem(GetMenu(hwnd), ID_VIEW_CSV, MF_BYCOMMAND | MF_CHECKED);
+    update_window_title(hwnd);
+    log_message("csv: indexing %llu bytes, separator 0x%02x", (unsigned long long)len, (unsigned)(unsigned char)sep);
+}
+
+static void finish_csv_index(HWND hwnd, UINT id) {
+    if (!g_csv || g_csv->id != id || g_csv->joined) return;
+    sys_thread_join(&g_csv->thread);
+    g_csv->joined = TRUE;
+
+    double ms = (double)(sys_now_us() - g_csv->started_us) / 1000.0;
+    uint64_t started = sys_now_us();
+    csv_refresh_widths(TRUE);
+    double sample_ms = (double)(sys_now_us() - started) / 1000.0;
+    log_message(
+        "csv: status=%d %llu rows, %u columns, %llu checkpoints in %.1f ms (%.1f MB/s), widths sampled in %.1f ms",
+        g_csv->status,
+        (unsigned long long)csv_index_rows(&g_csv->index),
+        csv_index_columns(&g_csv->index),
+        (unsigned long long)g_csv->index.count,
+        ms,
+        ms > 0.0 ? (double)g_csv->fed / 1000.0 / ms : 0.0,
+        sample_ms
+    );
+    if (g_csv->status == CSV_INDEX_FAILED) {
+        MessageBoxA(hwnd, "Not enough memory to index the rest of the rows.", "CSV Columns", MB_OK | MB_ICONERROR);
+    }
+    csv_update_scrollbars();
+    InvalidateRect(g_csv_view, NULL, FALSE);
+    update_window_title(hwnd);
+}
+
+// Ctrl+Space lists words of the document that extend the one before the
+// caret, most frequent first. The first request builds the word index on a
+// worker from a snapshot; after that, edits keep it current.
+static int words_index_sink(void *ctx, const char *data, size_t len) {
+    WordsJob *job = (WordsJob *)ctx;
+    if (job->cancel) {
+        job->status = WORDS_CANCELLED;
+        return 0;
+    }
+    if (!word_index_feed(&job->index, data, len)) {
+        job->status = WORDS_FAILED;
+        return 0;
+    }
+    job->fed += len;
+    unsigned percent = (unsigned)(job->fed * 100u / job->source_len);
+    if (percent != job->last_percent) {
+        job->last_percent = percent;
+        PostMessageA(job->hwnd, WM_APP_WORDS_PROGRESS, job->id, percent);
+    }
+    return 1;
+}
+
+static int words_index_worker(void *arg) {
+    WordsJob *job = (WordsJob *)arg;
+
+    uint64_t done = doc_snapshot_serialize(job->source, 0, job->source_len, words_index_sink, job);
+    if (job->status == WORDS_RUNNING && done != job->source_len) job->status = WORDS_FAILED;
+    if (job->status == WORDS_RUNNING) {
+        job->status = word_index_finish(&job->index) ? WORDS_DONE : WORDS_FAILED;
+    }
+    PostMessageA(job->hwnd, WM_APP_WORDS_DONE, job->id, 0);
+    return 0;
+}
+
+static BOOL start_word_index(HWND hwnd) {
+    size_t len = (size_t)GetWindowTextLengthA(g_edit);
+    DocSnapshot *source = len > 0 ? snapshot_document() : NULL;
+    WordsJob *job = source ? (WordsJob *)calloc(1, sizeof(WordsJob)) : NULL;
+    if (!job) {
+        doc_snapshot_release(source);
+        return FALSE;
+    }
+    job->hwnd = hwnd;
+    job->id = g_words_next_id++;
+    job->source = source;
+    job->source_len = len;
+    job->started_us = sys_now_us();
+    if (!sys_thread_start(&job->thread, words_index_worker, job)) {
+        doc_snapshot_release(source);
+        free(job);
+        return FALSE;
+    }
+    g_words_job = job;
+    g_words_percent = 0;
+    update_window_title(hwnd);
+    log_message("words: indexing %llu bytes", (unsigned long long)len);
+    return TRUE;
+}
+
+static void close_completion(void) {
+    if (!g_complete) return;
+    DestroyWindow(g_complete);
+    g_complete = NULL;
+}
+
+// The word bytes right before the caret, if there is no selection.
+static size_t completion_prefix(HWND edit, DWORD *start, char *prefix) {
+    DWORD sel_start = 0;
+    DWORD sel_end = 0;
+    size_t n = 0;
+    SendMessageA(edit, EM_GETSEL, (WPARAM)&sel_start, (LPARAM)&sel_end);
+    *start = sel_end;
+    if (sel_start != sel_end) return 0;
+
+    HLOCAL handle = NULL;
+    const char *text = lock_editor_buffer(edit, &handle);
+    if (!text) return 0;
+    while (n < WORD_MAX_LEN && n < sel_end && word_index_is_word_byte((unsigned char)text[sel_end - n - 1u])) n++;
+    if (n == WORD_MAX_LEN || (n > 0 && text[sel_end - n] >= '0' && text[sel_end - n] <= '9')) n = 0;
+    memcpy(prefix, text + sel_end - n, n);
+    unlock_editor_buffer(handle);
+    *start = sel_end - (DWORD)n;
+    return n;
+}
+
+// Shows, moves or closes the list for the word now before the caret.
+static BOOL refresh_completion(HWND edit) {
+    char prefix[WORD_MAX_LEN];
+    WordHit hits[COMPLETE_MAX_ITEMS];
+    DWORD start = 0;
+    size_t len = g_words.ordered ? completion_prefix(edit, &start, prefix) : 0;
+    size_t count = len > 0 ? word_index_complete(&g_words, prefix, len, hits, COMPLETE_MAX_ITEMS) : 0;
+    if (count == 0) {
+        close_completion();
+        return FALSE;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        memcpy(g_complete_items[i].text, hits[i].text, hits[i].len);
+        g_complete_items[i].text[hits[i].len] = '\0';
+        g_complete_items[i].count = hits[i].count;
+    }
+    g_complete_count = (int)count;
+    g_complete_sel = 0;
+    g_complete_caret = start + (DWORD)len;
+
+    // Sized to the longest word plus its count, under the start of the word.
+    HDC hdc = GetDC(edit);
+    HFONT font = (HFONT)SendMessageA(edit, WM_GETFONT, 0, 0);
+    HGDIOBJ old_font = SelectObject(hdc, font ? (HGDIOBJ)font : GetStockObject(SYSTEM_FONT));
+    TEXTMETRICA tm;
+    int width = 0;
+    GetTextMetricsA(hdc, &tm);
+    for (int i = 0; i < g_complete_count; i++) {
+        char line[WORD_MAX_LEN + 32];
+        SIZE size;
+        int n = wsprintfA(line, "%s  %u", g_complete_items[i].text, (unsigned)g_complete_items[i].count);
+        if (GetTextExtentPoint32A(hdc, line, n, &size) && size.cx > width) width = size.cx;
+    }
+    SelectObject(hdc, old_font);
+    ReleaseDC(edit, hdc);
+    g_complete_line_h = tm.tmHeight > 0 ? tm.tmHeight : 16;
+
+    LRESULT pos = SendMessageA(edit, EM_POSFROMCHAR, start, 0);
+    POINT at;
+    at.x = GET_X_LPARAM(pos);
+    at.y = GET_Y_LPARAM(pos) + g_complete_line_h;
+    ClientToScreen(edit, &at);
+    int w = width + 4 * COMPLETE_PAD + 2;
+    int h = g_complete_count * g_complete_line_h + 2;
+    if (!g_complete) {
+        g_complete = CreateWindowExA(
+            WS_EX_NOACTIVATE | WS_EX_TOOLWINDOW, "EditorCompletionClass", "",
+            WS_POPUP | WS_BORDER,
+            at.x, at.y, w, h,
+            GetParent(edit), NULL, (HINSTANCE)GetWindowLongPtrA(edit, GWLP_HINSTANCE), NULL
+        );
+        if (!g_complete) return FALSE;
+        ShowWindow(g_complete, SW_SHOWNOACTIVATE);
+    } else {
+        SetWindowPos(g_complete, NULL, at.x, at.y, w, h, SWP_NOACTIVATE | SWP_NOZORDER);
+        InvalidateRect(g_complete, NULL, FALSE);
+    }
+    return TRUE;
+}
+
+// Types the rest of the chosen word.
+static void accept_completion(HWND edit) {
+    char word[WORD_MAX_LEN + 1];
+    DWORD caret = g_complete_caret;
+    DWORD start = 0;
+    char prefix[WORD_MAX_LEN];
+    size_t len = completion_prefix(edit, &start, prefix);
+    lstrcpynA(word, g_complete_items[g_complete_sel].text, (int)sizeof(word));
+    close_completion();
+    if (len == 0 || start + len != caret || (size_t)lstrlenA(word) <= len) return;
+    SendMessageA(edit, EM_REPLACESEL, TRUE, (LPARAM)(word + len));
+}
+
+static void complete_word(HWND hwnd) {
+    DWORD caret = 0;
+    if (!g_edit || (GetWindowLongA(g_edit, GWL_STYLE) & ES_READONLY)) {
+        MessageBeep(MB_OK);
+        return;
+    }
+    leave_multi_caret(g_edit);
+    SendMessageA(g_edit, EM_GETSEL, 0, (LPARAM)&caret);
+    // A mirror out of step means some change was not followed.
+    if (g_words.ordered && (!g_doc_mirror || doc_mirror_length(g_doc_mirror) != (uint64_t)GetWindowTextLengthA(g_edit))) {
+        log_message("words: index out of step, rebuilding");
+        drop_doc_mirror();
+    }
+    if (g_words.ordered) {
+        if (!refresh_completion(g_edit)) MessageBeep(MB_OK);
+        return;
+    }
+    if (!g_words_job && !start_word_index(hwnd)) {
+        MessageBeep(MB_OK);
+        return;
+    }
+    g_complete_wanted = TRUE;
+    g_complete_wanted_at = caret;
+}
+
+static void finish_word_index(HWND hwnd, UINT id) {
+    WordsJob *job = g_words_job;
+    if (!job || job->id != id || job->joined) return;
+    sys_thread_join(&job->thread);
+    job->joined = TRUE;
+
+    double ms = (double)(sys_now_us() - job->started_us) / 1000.0;
+    BOOL ok = job->status == WORDS_DONE && word_index_merge(&job->index, &job->pending);
+    log_message(
+        "words: status=%d %lu words from %llu bytes in %.1f ms (%.1f MB/s), %lu changed meanwhile",
+        job->status,
+        (unsigned long)job->index.words,
+        (unsigned long long)job->fed,
+        ms,
+        ms > 0.0 ? (double)job->fed / 1000.0 / ms : 0.0,
+        (unsigned long)job->pending.words
+    );
+    g_words_job = NULL;
+    word_index_free(&g_words);
+    if (ok) {
+        g_words = job->index;
+    } else {
+        word_index_free(&job->index);
+    }
+    word_index_free(&job->pending);
+    doc_snapshot_release(job->source);
+    free(job);
+    update_window_title(hwnd);
+
+    if (!ok) {
+        g_complete_wanted = FALSE;
+        MessageBoxA(hwnd, "Not enough memory to index the words of the document.", "Complete Word", MB_OK | MB_ICONERROR);
+        return;
+    }
+    if (g_complete_wanted && GetFocus() == g_edit) {
+        DWORD caret = 0;
+        SendMessageA(g_edit, EM_GETSEL, 0, (LPARAM)&caret);
+        if (caret == g_complete_wanted_at) refresh_completion(g_edit);
+    }
+    g_complete_wanted = FALSE;
+}
+
+static LRESULT CALLBACK completion_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
+    switch (msg) {
+        case WM_MOUSEACTIVATE:
+            return MA_NOACTIVATE;
+
+        case WM_LBUTTONDOWN: {
+            int row = GET_Y_LPARAM(lparam) / (g_complete_line_h > 0 ? g_complete_line_h : 1);
+            if (row >= 0 && row < g_complete_count) {
+                g_complete_sel = row;
+                accept_completion(g_edit);
+            }
+            return 0;
+        }
+
+        case WM_ERASEBKGND:
+            return 1;
+
+        case WM_PAINT: {
+            PAINTSTRUCT ps;
+            RECT client;
+            HDC hdc = BeginPaint(hwnd, &ps);
+            HFONT font = (HFONT)SendMessageA(g_edit, WM_GETFONT, 0, 0);
+            HGDIOBJ old_font = SelectObject(hdc, font ? (HGDIOBJ)font : GetStockObject(SYSTEM_FONT));
+            GetClientRect(hwnd, &client);
+            FillRect(hdc, &client, g_menu_bg_brush);
+            SetBkMode(hdc, TRANSPARENT);
+            for (int i = 0; i < g_complete_count; i++) {
+                RECT row = client;
+                char count[24];
+                row.top = i * g_complete_line_h;
+                row.bottom = row.top + g_complete_line_h;
+                if (i == g_complete_sel) FillRect(hdc, &row, g_menu_hot_brush);
+                row.left += COMPLETE_PAD;
+                row.right -= COMPLETE_PAD;
+                SetTextColor(hdc, COLOR_MENU_TEXT);
+                DrawTextA(hdc, g_complete_items[i].text, -1, &row, DT_LEFT | DT_SINGLELINE | DT_NOPREFIX | DT_VCENTER);
+                wsprintfA(count, "%u", (unsigned)g_complete_items[i].count);
+                SetTextColor(hdc, COLOR_SUBTEXT);
+                DrawTextA(hdc, count, -1, &row, DT_RIGHT | DT_SINGLELINE | DT_NOPREFIX | DT_VCENTER);
+            }
+            SelectObject(hdc, old_font);
+            EndPaint(hwnd, &ps);
+            return 0;
+        }
+
+        default:
+            break;
+    }
+    return DefWindowProcA(hwnd, msg, wparam, lparam);
+}
+
+static BOOL register_completion_class(HINSTANCE instance) {
+    WNDCLASSA wc = {0};
+    wc.lpfnWndProc = completion_proc;
+    wc.hInstance = instance;
+    wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+    wc.lpszClassName = "EditorCompletionClass";
+    return RegisterClassA(&wc) != 0;
+}
+
+// The fold view shows the document with bracket and indented blocks collapsed
+// to their first line. The EDIT control cannot hide lines, so this is a
+// read-only window painting the visible lines straight from the EDIT buffer;
+// the structure index supplies line starts and fold ranges.
+static uint64_t fold_row_count(void) {
+    const StructIndex *si = struct_index_for(g_edit, TRUE);
+    uint64_t rows = si ? si->lines : 0;
+    for (size_t i = 0; i < g_fold_count; i++) rows -= g_folds[i].last - g_folds[i].line;
+    return rows;
+}
+
+static uint64_t fold_line_of_row(uint64_t row) {
+    uint64_t line = row;
+    for (size_t i = 0; i < g_fold_count && g_folds[i].line < line; i++) {
+        line += g_folds[i].last - g_folds[i].line;
+    }
+    return line;
+}
+
+// First collapsed range whose header is at or after `line`.
+static size_t fold_find(uint64_t line) {
+    size_t lo = 0;
+    size_t hi = g_fold_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2u;
+        if (g_folds[mid].line < line) {
+            lo = mid + 1u;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static uint64_t fold_visible_rows(void) {
+    RECT rc;
+    GetClientRect(g_fold_view, &rc);
+    int rows = g_fold_line_h > 0 ? (rc.bottom - rc.top) / g_fold_line_h : 1;
+    return rows > 0 ? (uint64_t)rows : 1u;
+}
+
+static void fold_update_scrollbar(void) {
+    set_row_scrollbar(g_fold_view, g_fold_top, fold_row_count(), fold_visible_rows());
+}
+
+static void fold_scroll_to(uint64_t top) {
+    uint64_t rows = fold_row_count();
+    uint64_t visible = fold_visible_rows();
+    uint64_t max_top = rows > visible ? rows - visible : 0;
+    if (top > max_top) top = max_top;
+    if (top == g_fold_top) return;
+    g_fold_top = top;
+    fold_update_scrollbar();
+    InvalidateRect(g_fold_view, NULL, FALSE);
+}
+
+static void fold_move_cursor(uint64_t row) {
+    uint64_t rows = fold_row_count();
+    uint64_t visible = fold_visible_rows();
+
+    if (rows == 0) return;
+    if (row >= rows) row = rows - 1u;
+    g_fold_cursor = row;
+    if (row < g_fold_top) {
+        fold_scroll_to(row);
+    } else if (row >= g_fold_top + visible) {
+        fold_scroll_to(row - visible + 1u);
+    }
+    InvalidateRect(g_fold_view, NULL, FALSE);
+}
+
+// Collapsing a range drops the collapsed ranges it overlaps, so they stay
+// disjoint; those come back expanded.
+static void fold_toggle(uint64_t row) {
+    const StructIndex *si = struct_index_for(g_edit, TRUE);
+    uint64_t line = fold_line_of_row(row);
+    uint64_t last = 0;
+    size_t i = fold_find(line);
+
+    if (!si) return;
+    if (i < g_fold_count && g_folds[i].line == line) {
+        memmove(g_folds + i, g_folds + i + 1u, (g_fold_count - i - 1u) * sizeof(FoldRange));
+        g_fold_count--;
+    } else if (struct_index_fold(si, line, &last)) {
+        size_t j = i;
+        while (j < g_fold_count && g_folds[j].line <= last) j++;
+        if (j == i && g_fold_count == g_fold_cap) {
+            size_t cap = g_fold_cap ? g_fold_cap * 2u : 16u;
+            FoldRange *grown = (FoldRange *)realloc(g_folds, cap * sizeof(FoldRange));
+            if (!grown) {
+                MessageBeep(MB_ICONERROR);
+                return;
+            }
+            g_folds = grown;
+            g_fold_cap = cap;
+        }
+        memmove(g_folds + i + 1u, g_folds + j, (g_fold_count - j) * sizeof(FoldRange));
+        g_fold_count = g_fold_count - (j - i) + 1u;
+        g_folds[i].line = line;
+        g_folds[i].last = last;
+    } else {
+        MessageBeep(MB_OK);
+        return;
+    }
+    fold_update_scrollbar();
+    fold_move_cursor(row);
+}
+
+// Tabs are expanded and control bytes blanked; long lines are cut at `cap`.
+static int fold_expand_line(const char *p, uint64_t len, char *out, int cap) {
+    int n = 0;
+    for (uint64_t i = 0; i < len && n < cap; i++) {
+        if (p[i] == '\t') {
+            do {
+                out[n++] = ' ';
+            } while (n < cap && n % (int)STRUCT_TAB_WIDTH != 0);
+        } else {
+            out[n++] = (unsigned char)p[i] < ' ' ? ' ' : p[i];
+        }
+    }
+    return n;
+}
+
+static void fold_paint(HWND hwnd) {
+    PAINTSTRUCT ps;
+    HDC hdc = BeginPaint(hwnd, &ps);
+    RECT rc;
+    GetClientRect(hwnd, &rc);
+    FillRect(hdc, &rc, g_editor_brush);
+
+    const StructIndex *si = struct_index_for(g_edit, TRUE);
+    HLOCAL handle = NULL;
+    const char *text = si ? lock_editor_buffer(g_edit, &handle) : NULL;
+    if (!text) {
+        EndPaint(hwnd, &ps);
+        return;
+    }
+    HGDIOBJ old_font = SelectObject(hdc, g_fold_font ? (HGDIOBJ)g_fold_font : GetStockObject(ANSI_FIXED_FONT));
+    SetBkMode(hdc, TRANSPARENT);
+    uint64_t visible = fold_visible_rows() + 1u;
+    uint64_t line = fold_line_of_row(g_fold_top);
+    size_t f = fold_find(line);
+    char gutter[32];
+    char row_text[FOLD_VIEW_LINE_CHARS + 8];
+
+    for (uint64_t r = 0; r < visible && line < si->lines; r++) {
+        int y = (int)r * g_fold_line_h;
+        BOOL folded = f < g_fold_count && g_folds[f].line == line;
+        uint64_t last = 0;
+        uint64_t len = 0;
+        uint64_t start = struct_index_line_start(si, line, &len);
+        char sign = folded ? '+' : (struct_index_fold(si, line, &last) ? '-' : ' ');
+        int g = snprintf(gutter, sizeof(gutter), "%7llu %c", (unsigned long long)(line + 1u), sign);
+        int n = fold_expand_line(text + start, len, row_text, FOLD_VIEW_LINE_CHARS);
+        int x = HEX_VIEW_MARGIN + (g > FOLD_VIEW_GUTTER ? g + 1 : FOLD_VIEW_GUTTER) * g_fold_char_w;
+
+        if (folded) {
+            memcpy(row_text + n, " ...", 4);
+            n += 4;
+        }
+        if (g_fold_top + r == g_fold_cursor) {
+            RECT cursor = {0, y, rc.right, y + g_fold_line_h};
+            FillRect(hdc, &cursor, g_menu_hot_brush);
+        }
+        SetTextColor(hdc, COLOR_SUBTEXT);
+        TextOutA(hdc, HEX_VIEW_MARGIN, y, gutter, g);
+        SetTextColor(hdc, COLOR_TEXT);
+        TextOutA(hdc, x, y, row_text, n);
+
+        if (folded) {
+            line = g_folds[f].last + 1u;
+            f++;
+        } else {
+            line++;
+        }
+    }
+    unlock_editor_buffer(handle);
+    SelectObject(hdc, old_font);
+    EndPaint(hwnd, &ps);
+}
+
+static LRESULT CALLBACK fold_view_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
+    switch (msg) {
+        case WM_ERASEBKGND:
+            return 1;
+
+        case WM_PAINT:
+            if (!g_fold_view) break;
+            fold_paint(hwnd);
+            return 0;
+
+        case WM_SIZE:
+            if (g_fold_view) fold_update_scrollbar();
+            return 0;
+
+        case WM_VSCROLL: {
+            uint64_t page = fold_visible_rows();
+            switch (LOWORD(wparam)) {
+                case SB_LINEUP: fold_scroll_to(g_fold_top > 0 ? g_fold_top - 1u : 0); break;
+                case SB_LINEDOWN: fold_scroll_to(g_fold_top + 1u); break;
+                case SB_PAGEUP: fold_scroll_to(g_fold_top > page ? g_fold_top - page : 0); break;
+                case SB_PAGEDOWN: fold_scroll_to(g_fold_top + page); break;
+                case SB_TOP: fold_scroll_to(0); break;
+                case SB_BOTTOM: fold_scroll_to(fold_row_count()); break;
+                case SB_THUMBTRACK:
+                case SB_THUMBPOSITION: {
+                    SCROLLINFO si = {0};
+                    si.cbSize = sizeof(si);
+                    si.fMask = SIF_TRACKPOS;
+                    GetScrollInfo(hwnd, SB_VERT, &si);
+                    fold_scroll_to(row_from_scroll_pos(si.nTrackPos, fold_row_count()));
+                    break;
+                }
+                default:
+                    break;
+            }
+            return 0;
+        }
+
+        case WM_MOUSEWHEEL: {
+            int steps = GET_WHEEL_DELTA_WPARAM(wparam) / WHEEL_DELTA * 3;
+            if (steps > 0) {
+                fold_scroll_to(g_fold_top > (uint64_t)steps ? g_fold_top - (uint64_t)steps : 0);
+            } else if (steps < 0) {
+                fold_scroll_to(g_fold_top + (uint64_t)(-steps));
+            }
+            return 0;
+        }
+
+        // A click on the gutter toggles the fold there.
+        case WM_LBUTTONDOWN: {
+            uint64_t row = g_fold_top + (uint64_t)(GET_Y_LPARAM(lparam) / (g_fold_line_h > 0 ? g_fold_line_h : 1));
+            SetFocus(hwnd);
+            if (row >= fold_row_count()) return 0;
+            if (GET_X_LPARAM(lparam) < HEX_VIEW_MARGIN + FOLD_VIEW_GUTTER * g_fold_char_w) {
+                fold_toggle(row);
+            } else {
+                fold_move_cursor(row);
+            }
+            return 0;
+        }
+
+        case WM_LBUTTONDBLCLK:
+            if (GET_X_LPARAM(lparam) >= HEX_VIEW_MARGIN + FOLD_VIEW_GUTTER * g_fold_char_w) {
+                leave_fold_view(GetParent(hwnd));
+            }
+            return 0;
+
+        case WM_GETDLGCODE:
+            return DLGC_WANTARROWS | DLGC_WANTCHARS;
+
+        case WM_KEYDOWN: {
+            uint64_t page = fold_visible_rows();
+            switch (wparam) {
+                case VK_UP: fold_move_cursor(g_fold_cursor > 0 ? g_fold_cursor - 1u : 0); return 0;
+                case VK_DOWN: fold_move_cursor(g_fold_cursor + 1u); return 0;
+                case VK_PRIOR: fold_move_cursor(g_fold_cursor > page ? g_fold_cursor - page : 0); return 0;
+                case VK_NEXT: fold_move_cursor(g_fold_cursor + page); return 0;
+                case VK_HOME: fold_move_cursor(0); return 0;
+                case VK_END: fold_move_cursor(fold_row_count()); return 0;
+                case VK_SPACE:
+                case VK_RETURN:
+                    fold_toggle(g_fold_cursor);
+                    return 0;
+                case VK_ESCAPE:
+                    leave_fold_view(GetParent(hwnd));
+                    return 0;
+                default:
+                    break;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+    return DefWindowProcA(hwnd, msg, wparam, lparam);
+}
+
+static BOOL register_fold_view_class(HINSTANCE instance) {
+    WNDCLASSA wc = {0};
+    wc.style = CS_DBLCLKS;
+    wc.lpfnWndProc = fold_view_proc;
+    wc.hInstance = instance;
+    wc.hCursor = LoadCursor(NULL, IDC_ARROW);
+    wc.lpszClassName = "EditorFoldViewClass";
+    return RegisterClassA(&wc) != 0;
+}
+
+// Returns to the editor with the caret on the cursor's line.
+static void leave_fold_view(HWND hwnd) {
+    if (!g_fold_view) return;
+    const StructIndex *si = struct_index_for(g_edit, TRUE);
+    uint64_t line = fold_line_of_row(g_fold_cursor);
+
+    DestroyWindow(g_fold_view);
+    g_fold_view = NULL;
+    free(g_folds);
+    g_folds = NULL;
+    g_fold_count = 0;
+    g_fold_cap = 0;
+    if (g_fold_font) {
+        DeleteObject(g_fold_font);
+        g_fold_font = NULL;
+    }
+
+    CheckMenuItem(GetMenu(hwnd), ID_VIEW_FOLDS, MF_BYCOMMAND | MF_UNCHECKED);
+    if (g_edit) {
+        SendMessageA(g_edit, EM_SETREADONLY, g_read_only || g_paste || g_gzip_open || g_json_format, 0);
+        ShowWindow(g_edit, SW_SHOW);
+        if (si) {
+            DWORD at = (DWORD)struct_index_line_start(si, line, NULL);
+            SendMessageA(g_edit, EM_SETSEL, at, at);
+            SendMessageA(g_edit, EM_SCROLLCARET, 0, 0);
+        }
+        SetFocus(g_edit);
+    }
+    update_window_title(hwnd);
+}
+
+static void enter_fold_view(HWND hwnd) {
+    if (g_hex || g_csv || g_fold_view || g_long_view || g_paste || g_gzip_open || g_json_format) {
+        MessageBeep(MB_OK);
+        return;
+    }
+    const StructIndex *si = struct_index_for(g_edit, TRUE);
+    if (!si) {
+        MessageBoxA(hwnd, "Not enough memory to index the document structure.", "Fold View", MB_OK | MB_ICONERROR);
+        return;
+    }
+
+    DWORD caret = 0;
+    SendMessageA(g_edit, EM_GETSEL, (WPARAM)&caret, 0);
+    g_fold_count = 0;
+    g_fold_top = 0;
+    g_fold_cursor = struct_index_line_of(si, caret);
+    g_fold_font = create_view_font();
+    SendMessageA(g_edit, EM_SETREADONLY, TRUE, 0);
+    ShowWindow(g_edit, SW_HIDE);
+
+    RECT rc;
+    get_editor_rect(hwnd, &rc);
+    g_fold_view = CreateWindowExA(
+        0, "EditorFoldViewClass", "",
+        WS_CHILD | WS_VISIBLE | WS_VSCROLL,
+        rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top,
+        hwnd, NULL, (HINSTANCE)GetWindowLongPtrA(hwnd, GWLP_HINSTANCE), NULL
+    );
+    measure_view_font(g_fold_view, g_fold_font, &g_fold_char_w, &g_fold_line_h);
+    fold_update_scrollbar();
+    fold_move_cursor(g_fold_cursor);
+    SetFocus(g_fold_view);
+    CheckMenuItem(GetMenu(hwnd), ID_VIEW_FOLDS, MF_BYCOMMAND | MF_CHECKED);
+    update_window_title(hwnd);
+    log_message("folds: showing %llu lines", (unsigned long long)si->lines);
+}
+
+// The long-line view paints the document straight from the EDIT buffer with a
+// horizontal pixel scroll, for lines too long for the EDIT control to lay out
+// unwrapped. A line of LONG_LINE_THRESHOLD bytes or more gets a segment index
+// the first time it is shown, so caret moves, clicks and scrolling map between
+// byte offsets and x positions in O(log n) plus one segment; shorter lines are
+// measured from their start. Tabs are STRUCT_TAB_WIDTH spaces wide rather than
+// tab stops, so a segment's width does not depend on where it begins.
+static void long_view_drop_cache(void) {
+    for (size_t i = 0; i < LONG_VIEW_CACHE; i++) {
+        if (g_long_view_cache[i].used) line_segments_free(&g_long_view_cache[i].segments);
+        g_long_view_cache[i].used = FALSE;
+    }
+    g_long_view_cache_next = 0;
+}
+
+// Per-byte widths of the editor font; control bytes are drawn as spaces.
+static void long_view_measure_font(void) {
+    INT widths[256];
+    TEXTMETRICA tm;
+    HDC hdc = GetDC(g_long_view);
+    HGDIOBJ old_font = SelectObject(hdc, g_font ? (HGDIOBJ)g_font : GetStockObject(SYSTEM_FONT));
+    GetTextMetricsA(hdc, &tm);
+    if (!GetCharWidth32A(hdc, 0, 255, widths)) {
+        for (int c = 0; c < 256; c++) widths[c] = tm.tmAveCharWidth;
+    }
+    SelectObject(hdc, old_font);
+    ReleaseDC(g_long_view, hdc);
+
+    int space = widths[' '] > 0 ? widths[' '] : 1;
+    for (int c = 0; c < 256; c++) {
+        int w = c < ' ' ? space : widths[c];
+        g_long_view_widths[c] = (uint16_t)(w < 1 ? 1 : (w > 0xFFFF ? 0xFFFF : w));
+    }
+    g_long_view_widths['\t'] = (uint16_t)(space * (int)STRUCT_TAB_WIDTH);
+    g_long_view_line_h = tm.tmHeight > 0 ? tm.tmHeight : 16;
+    long_view_drop_cache();
+}
+
+// Segment index of a long line, built on first use. NULL for short lines and
+// when memory runs out; both are then measured from the line start.
+static const LineSegments *long_view_segments(const char *text, uint64_t line, uint64_t start, uint64_t len) {
+    if (len < LONG_LINE_THRESHOLD) return NULL;
+    for (size_t i = 0; i < LONG_VIEW_CACHE; i++) {
+        LongViewLine *c = &g_long_view_cache[i];
+        if (c->used && c->line == line && c->start == start && c->segments.len == len) return &c->segments;
+    }
+
+    LongViewLine *slot = &g_long_view_cache[g_long_view_cache_next];
+    g_long_view_cache_next = (g_long_view_cache_next + 1u) % LONG_VIEW_CACHE;
+    if (slot->used) line_segments_free(&slot->segments);
+    slot->used = FALSE;
+
+    HCURSOR old_cursor = SetCursor(LoadCursor(NULL, IDC_WAIT));
+    uint64_t started = sys_now_us();
+    BOOL built = line_segments_build(&slot->segments, text + start, (size_t)len, g_long_view_widths);
+    SetCursor(old_cursor);
+    if (!built) {
+        log_message("long line view: no memory to index line %llu", (unsigned long long)line);
+        return NULL;
+    }
+    slot->used = TRUE;
+    slot->line = line;
+    slot->start = start;
+    log_message(
+        "long line view: indexed line %llu, %llu bytes in %zu segments, %.1f ms",
+        (unsigned long long)line, (unsigned long long)len, slot->segments.count,
+        (double)(sys_now_us() - started) / 1000.0
+    );
+    return &slot->segments;
+}
+
+static uint64_t long_view_x_of(const char *text, uint64_t line, uint64_t start, uint64_t len, uint64_t offset) {
+    const LineSegments *ls = long_view_segments(text, line, start, len);
+    uint64_t x = 0;
+    if (ls) return line_segments_x_of(ls, text + start, (size_t)offset);
+    for (uint64_t i = 0; i < offset && i < len; i++) x += g_long_view_widths[(unsigned char)text[start + i]];
+    return x;
+}
+
+// Offset within the line of the character boundary nearest to x.
+static uint64_t long_view_offset_at(const char *text, uint64_t line, uint64_t start, uint64_t len, uint64_t x) {
+    const LineSegments *ls = long_view_segments(text, line, start, len);
+    uint64_t at_x = 0;
+    if (ls) return line_segments_offset_at(ls, text + start, x);
+    for (uint64_t i = 0; i < len; i++) {
+        uint32_t w = g_long_view_widths[(unsigned char)text[start + i]];
+        if (at_x + w > x) return (x - at_x) * 2u >= w ? i + 1u : i;
+        at_x += w;
+    }
+    return len;
+}
+
+// First byte of the line that reaches past x, and where it starts.
+static uint64_t long_view_first_visible(const char *text, uint64_t line, uint64_t start, uint64_t len, uint64_t x,
+                                        uint64_t *byte_x) {
+    const LineSegments *ls = long_view_segments(text, line, start, len);
+    uint64_t i = 0;
+    uint64_t at_x = 0;
+    if (ls && len > 0) i = (uint64_t)line_segments_segment_at(ls, x, &at_x) * LINE_SEGMENT_BYTES;
+    while (i < len && at_x + g_long_view_widths[(unsigned char)text[start + i]] <= x) {
+        at_x += g_long_view_widths[(unsigned char)text[start + i]];
+        i++;
+    }
+    *byte_x = at_x;
+    return i;
+}
+
+static uint64_t long_view_visible_rows(void) {
+    RECT rc;
+    GetClientRect(g_long_view, &rc);
+    int rows = g_long_view_line_h > 0 ? (rc.bottom - rc.top) / g_long_view_line_h : 1;
+    return rows > 0 ? (uint64_t)rows : 1u;
+}
+
+static uint64_t long_view_span(void) {
+    RECT rc;
+    GetClientRect(g_long_view, &rc);
+    int span = rc.right - rc.left - HEX_VIEW_MARGIN;
+    return span > 1 ? (uint64_t)span : 1u;
+}
+
+// Widest line on screen from `top`, plus room for the caret after its end.
+static uint64_t long_view_content_width(uint64_t top) {
+    const StructIndex *si = struct_index_for(g_edit, TRUE);
+    HLOCAL handle = NULL;
+    const char *text = si ? lock_editor_buffer(g_edit, &handle) : NULL;
+    uint64_t widest = 0;
+    if (!text) return 0;
+    uint64_t visible = long_view_visible_rows();
+    for (uint64_t line = top; line < top + visible && line < si->lines; line++) {
+        uint64_t len = 0;
+        uint64_t start = struct_index_line_start(si, line, &len);
+        uint64_t width = long_view_x_of(text, line, start, len, len);
+        if (width > widest) widest = width;
+    }
+    unlock_editor_buffer(handle);
+    return widest + 2u * g_long_view_widths[' '];
+}
+
+static void long_view_update_scrollbars(void) {
+    const StructIndex *si = struct_index_for(g_edit, TRUE);
+    uint64_t span = long_view_span();
+    set_row_scrollbar(g_long_view, g_long_view_top, si ? si->lines : 0, long_view_visible_rows());
+    g_long_view_width = long_view_content_width(g_long_view_top);
+    if (g_long_view_width < g_long_view_left + span) g_long_view_width = g_long_view_left + span;
+    set_scaled_scrollbar(g_long_view, SB_HORZ, g_long_view_left, g_long_view_width, span);
+}
+
+static void long_view_scroll_to(uint64_t top, uint64_t left) {
+    const StructIndex *si = struct_index_for(g_edit, TRUE);
+    uint64_t rows = si ? si->lines : 0;
+    uint64_t visible = long_view_visible_rows();
+    uint64_t max_top = rows > visible ? rows - visible : 0;
+    if (top > max_top) top = max_top;
+    uint64_t width = long_view_content_width(top);
+    uint64_t span = long_view_span();
+    uint64_t max_left = width > span ? width - span : 0;
+    if (left > max_left) left = max_left;
+    if (top == g_long_view_top && left == g_long_view_left) return;
+    g_long_view_top = top;
+    g_long_view_left = left;
+    long_view_update_scrollbars();
+    InvalidateRect(g_long_view, NULL, FALSE);
+}
+
+// Scrolls the least needed to bring the caret on screen, with a third of the
+// width to spare when it jumps sideways.
+static void long_view_show_caret(const char *text, const StructIndex *si) {
+    uint64_t line = struct_index_line_of(si, g_long_view_caret);
+    uint64_t len = 0;
+    uint64_t start = struct_index_line_start(si, line, &len);
+    uint64_t x = long_view_x_of(text, line, start, len, g_long_view_caret - start);
+    uint64_t visible = long_view_visible_rows();
+    uint64_t span = long_view_span();
+    uint64_t top = g_long_view_top;
+    uint64_t left = g_long_view_left;
+
+    if (line < top) {
+        top = line;
+    } else if (line >= top + visible) {
+        top = line - visible + 1u;
+    }
+    if (x < left) {
+        left = x > span / 3u ? x - span / 3u : 0;
+    } else if (x + 2u >= left + span) {
+        left = x - span * 2u / 3u;
+    }
+    long_view_scroll_to(top, left);
+    InvalidateRect(g_long_view, NULL, FALSE);
+}
+
+static void long_view_key(WPARAM key) {
+    const StructIndex *si = struct_index_for(g_edit, TRUE);
+    HLOCAL handle = NULL;
+    const char *text = si ? lock_editor_buffer(g_edit, &handle) : NULL;
+    if (!text || si->lines == 0) {
+        if (text) unlock_editor_buffer(handle);
+        return;
+    }
+
+    BOOL ctrl = GetKeyState(VK_CONTROL) < 0;
+    uint64_t caret = g_long_view_caret;
+    uint64_t line = struct_index_line_of(si, caret);
+    uint64_t len = 0;
+    uint64_t start = struct_index_line_start(si, line, &len);
+    uint64_t page = long_view_visible_rows();
+    uint64_t target = line;
+    BOOL vertical = FALSE;
+
+    switch (key) {
+        case VK_LEFT:
+            if (caret > start) {
+                caret--;
+            } else if (line > 0) {
+                caret = struct_index_line_start(si, line - 1u, &len) + len;
+            }
+            break;
+        case VK_RIGHT:
+            if (caret < start + len) {
+                caret++;
+            } else if (line + 1u < si->lines) {
+                caret = struct_index_line_start(si, line + 1u, NULL);
+            }
+            break;
+        case VK_HOME:
+            caret = ctrl ? 0 : start;
+            break;
+        case VK_END:
+            if (ctrl) {
+                caret = struct_index_line_start(si, si->lines - 1u, &len) + len;
+            } else {
+                caret = start + len;
+            }
+            break;
+        case VK_UP: target = line > 0 ? line - 1u : 0; vertical = TRUE; break;
+        case VK_DOWN: target = line + 1u < si->lines ? line + 1u : line; vertical = TRUE; break;
+        case VK_PRIOR: target = line > page ? line - page : 0; vertical = TRUE; break;
+        case VK_NEXT: target = line + page < si->lines ? line + page : si->lines - 1u; vertical = TRUE; break;
+        default:
+            unlock_editor_buffer(handle);
+            return;
+    }
+    if (vertical) {
+        start = struct_index_line_start(si, target, &len);
+        caret = start + long_view_offset_at(text, target, start, len, g_long_view_want_x);
+    } else {
+        line = struct_index_line_of(si, caret);
+        start = struct_index_line_start(si, line, &len);
+        g_long_view_want_x = long_view_x_of(text, line, start, len, caret - start);
+    }
+    g_long_view_caret = caret;
+    long_view_show_caret(text, si);
+    unlock_editor_buffer(handle);
+}
+
+static void long_view_click(int x, int y) {
+    const StructIndex *si = struct_index_for(g_edit, TRUE);
+    HLOCAL handle = NULL;
+    const char *text = si ? lock_editor_buffer(g_edit, &handle) : NULL;
+    if (!text || si->lines == 0) {
+        if (text) unlock_editor_buffer(handle);
+        return;
+    }
+    uint64_t line = g_long_view_top + (uint64_t)(y > 0 ? y / (g_long_view_line_h > 0 ? g_long_view_line_h : 1) : 0);
+    uint64_t len = 0;
+    if (line >= si->lines) line = si->lines - 1u;
+    uint64_t start = struct_index_line_start(si, line, &len);
+    uint64_t at = g_long_view_left + (uint64_t)(x > HEX_VIEW_MARGIN ? x - HEX_VIEW_MARGIN : 0);
+    uint64_t offset = long_view_offset_at(text, line, start, len, at);
+    g_long_view_caret = start + offset;
+    g_long_view_want_x = long_view_x_of(text, line, start, len, offset);
+    long_view_show_caret(text, si);
+    unlock_editor_buffer(handle);
+}
+
+// Each row draws only the bytes that reach the screen, with the index's own
+// widths passed to ExtTextOut so the text lines up with the caret mapping.
+static void long_view_paint(HWND hwnd) {
+    PAINTSTRUCT ps;
+    HDC hdc = BeginPaint(hwnd, &ps);
+    RECT rc;
+    GetClientRect(hwnd, &rc);
+    FillRect(hdc, &rc, g_editor_brush);
+
+    const StructIndex *si = struct_index_for(g_edit, TRUE);
+    HLOCAL handle = NULL;
+    const char *text = si ? lock_editor_buffer(g_edit, &handle) : NULL;
+    if (!text) {
+        EndPaint(hwnd, &ps);
+        return;
+    }
+    HGDIOBJ old_font = SelectObject(hdc, g_font ? (HGDIOBJ)g_font : GetStockObject(SYSTEM_FONT));
+    SetBkMode(hdc, TRANSPARENT);
+    SetTextColor(hdc, COLOR_TEXT);
+    uint64_t caret_line = struct_index_line_of(si, g_long_view_caret);
+    uint64_t visible = long_view_visible_rows() + 1u;
+    uint64_t span = long_view_span();
+    static char row_text[LONG_VIEW_ROW_BYTES];
+    static INT row_dx[LONG_VIEW_ROW_BYTES];
+
+    for (uint64_t r = 0; r < visible && g_long_view_top + r < si->lines; r++) {
+        uint64_t line = g_long_view_top + r;
+        uint64_t len = 0;
+        uint64_t start = struct_index_line_start(si, line, &len);
+        int y = (int)r * g_long_view_line_h;
+        RECT row = {0, y, rc.right, y + g_long_view_line_h};
+        RECT clip = {HEX_VIEW_MARGIN, y, rc.right, y + g_long_view_line_h};
+
+        if (line == caret_line) FillRect(hdc, &row, g_menu_hot_brush);
+        uint64_t at_x = 0;
+        uint64_t i = long_view_first_visible(text, line, start, len, g_long_view_left, &at_x);
+        if (i < len) {
+            int x = HEX_VIEW_MARGIN - (int)(g_long_view_left - at_x);
+            int right = x;
+            UINT n = 0;
+            for (; i < len && n < LONG_VIEW_ROW_BYTES && right < rc.right; i++, n++) {
+                unsigned char c = (unsigned char)text[start + i];
+                row_text[n] = c < ' ' ? ' ' : (char)c;
+                row_dx[n] = g_long_view_widths[c];
+                right += row_dx[n];
+            }
+            ExtTextOutA(hdc, x, y, ETO_CLIPPED, &clip, row_text, n, row_dx);
+        }
+        if (line == caret_line) {
+            uint64_t x = long_view_x_of(text, line, start, len, g_long_view_caret - start);
+            if (x >= g_long_view_left && x - g_long_view_left < span) {
+                RECT caret = {HEX_VIEW_MARGIN + (int)(x - g_long_view_left), y, 0, y + g_long_view_line_h};
+                caret.right = caret.left + 2;
+                InvertRect(hdc, &caret);
+            }
+        }
+    }
+    unlock_editor_buffer(handle);
+    SelectObject(hdc, old_font);
+    EndPaint(hwnd, &ps);
+}
+
+static LRESULT CALLBACK long_line_view_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
+    switch (msg) {
+        case WM_ERASEBKGND:
+            return 1;
+
+        case WM_PAINT:
+            if (!g_long_view) break;
+            long_view_paint(hwnd);
+            return 0;
+
+        case WM_SIZE:
+            if (g_long_view) long_view_update_scrollbars();
+            return 0;
+
+        case WM_VSCROLL: {
+            const StructIndex *si = struct_index_for(g_edit, TRUE);
+            uint64_t rows = si ? si->lines : 0;
+            uint64_t page = long_view_visible_rows();
+            uint64_t top = g_long_view_top;
+            switch (LOWORD(wparam)) {
+                case SB_LINEUP: top = top > 0 ? top - 1u : 0; break;
+                case SB_LINEDOWN: top++; break;
+                case SB_PAGEUP: top = top > page ? top - page : 0; break;
+                case SB_PAGEDOWN: top += page; break;
+                case SB_TOP: top = 0; break;
+                case SB_BOTTOM: top = rows; break;
+                case SB_THUMBTRACK:
+                case SB_THUMBPOSITION: {
+                    SCROLLINFO info = {0};
+                    info.cbSize = sizeof(info);
+                    info.fMask = SIF_TRACKPOS;
+                    GetScrollInfo(hwnd, SB_VERT, &info);
+                    top = row_from_scroll_pos(info.nTrackPos, rows);
+                    break;
+                }
+                default:
+                    break;
+            }
+            long_view_scroll_to(top, g_long_view_left);
+            return 0;
+        }
+
+        case WM_HSCROLL: {
+            uint64_t page = long_view_span();
+            uint64_t step = 4u * g_long_view_widths[' '];
+            uint64_t left = g_long_view_left;
+            switch (LOWORD(wparam)) {
+                case SB_LINELEFT: left = left > step ? left - step : 0; break;
+                case SB_LINERIGHT: left += step; break;
+                case SB_PAGELEFT: left = left > page ? left - page : 0; break;
+                case SB_PAGERIGHT: left += page; break;
+                case SB_LEFT: left = 0; break;
+                case SB_RIGHT: left = g_long_view_width; break;
+                case SB_THUMBTRACK:
+                case SB_THUMBPOSITION: {
+                    SCROLLINFO info = {0};
+                    info.cbSize = sizeof(info);
+                    info.fMask = SIF_TRACKPOS;
+                    GetScrollInfo(hwnd, SB_HORZ, &info);
+                    left = row_from_scroll_pos(info.nTrackPos, g_long_view_width);
+                    break;
+                }
+                default:
+                    break;
+            }
+            long_view_scroll_to(g_long_view_top, left);
+            return 0;
+        }
+
+        // Shift+wheel scrolls sideways.
+        case WM_MOUSEWHEEL: {
+            int steps = GET_WHEEL_DELTA_WPARAM(wparam) / WHEEL_DELTA * 3;
+            if (GET_KEYSTATE_WPARAM(wparam) & MK_SHIFT) {
+                uint64_t step = (uint64_t)(steps < 0 ? -steps : steps) * 4u * g_long_view_widths[' '];
+                if (steps > 0) {
+                    long_view_scroll_to(g_long_view_top, g_long_view_left > step ? g_long_view_left - step : 0);
+                } else if (steps < 0) {
+                    long_view_scroll_to(g_long_view_top, g_long_view_left + step);
+                }
+            } else if (steps > 0) {
+                long_view_scroll_to(g_long_view_top > (uint64_t)steps ? g_long_view_top - (uint64_t)steps : 0,
+                                    g_long_view_left);
+            } else if (steps < 0) {
+                long_view_scroll_to(g_long_view_top + (uint64_t)(-steps), g_long_view_left);
+            }
+            return 0;
+        }
+
+        case WM_LBUTTONDOWN:
+            SetFocus(hwnd);
+            long_view_click(GET_X_LPARAM(lparam), GET_Y_LPARAM(lparam));
+            return 0;
+
+        // The first click of the pair already placed the caret.
+        case WM_LBUTTONDBLCLK:
+            leave_long_line_view(GetParent(hwnd));
+            return 0;
+
+        case WM_GETDLGCODE:
+            return DLGC_WANTARROWS | DLGC_WANTCHARS;
+
+        case WM_KEYDOWN:
+            if (wparam == VK_ESCAPE) {
+                leave_long_line_view(GetParent(hwnd));
+                return 0;
+            }
+            long_view_key(wparam);
+            return 0;
+
+        default:
+            break;
+    }
+    return DefWindowProcA(hwnd, msg, wparam, lparam);
+}
+
+static BOOL register_long_line_view_class(HINSTANCE instance) {
+    WNDCLASSA wc = {0};
+    wc.style = CS_DBLCLKS;
+    wc.lpfnWndProc = long_line_view_proc;
+    wc.hInstance = instance;
+    wc.hCursor = LoadCursor(NULL, IDC_IBEAM);
+    wc.lpszClassName = "EditorLongLineViewClass";
+    return RegisterClassA(&wc) != 0;
+}
+
+// Returns to the editor with its caret where the view's caret was. The EDIT
+// control keeps the per-document wrap for long lines, so editing there stays
+// bounded.
+static void leave_long_line_view(HWND hwnd) {
+    if (!g_long_view) return;
+    DWORD at = (DWORD)g_long_view_caret;
+
+    DestroyWindow(g_long_view);
+    g_long_view = NULL;
+    long_view_drop_cache();
+
+    CheckMenuItem(GetMenu(hwnd), ID_VIEW_LONG_LINE, MF_BYCOMMAND | MF_UNCHECKED);
+    if (g_edit) {
+        SendMessageA(g_edit, EM_SETREADONLY, g_read_only || g_paste || g_gzip_open || g_json_format, 0);
+        ShowWindow(g_edit, SW_SHOW);
+        SendMessageA(g_edit, EM_SETSEL, at, at);
+        SendMessageA(g_edit, EM_SCROLLCARET, 0, 0);
+        SetFocus(g_edit);
+    }
+    update_window_title(hwnd);
+}
+
+static void enter_long_line_view(HWND hwnd) {
+    if (g_hex || g_csv || g_fold_view || g_long_view || g_paste || g_gzip_open || g_json_format) {
+        MessageBeep(MB_OK);
+        return;
+    }
+    const StructIndex *si = struct_index_for(g_edit, TRUE);
+    if (!si) {
+        MessageBoxA(hwnd, "Not enough memory to index the document structure.", "Long Line View", MB_OK | MB_ICONERROR);
+        return;
+    }
+
+    DWORD caret = 0;
+    SendMessageA(g_edit, EM_GETSEL, (WPARAM)&caret, 0);
+    g_long_view_top = 0;
+    g_long_view_left = 0;
+    g_long_view_caret = caret;
+    SendMessageA(g_edit, EM_SETREADONLY, TRUE, 0);
+    ShowWindow(g_edit, SW_HIDE);
+
+    RECT rc;
+    get_editor_rect(hwnd, &rc);
+    g_long_view = CreateWindowExA(
+        0, "EditorLongLineViewClass", "",
+        WS_CHILD | WS_VISIBLE | WS_VSCROLL | WS_HSCROLL,
+        rc.left, rc.top, rc.right - rc.left, rc.bottom - rc.top,
+        hwnd, NULL, (HINSTANCE)GetWindowLongPtrA(hwnd, GWLP_HINSTANCE), NULL
+    );
+    long_view_measure_font();
+
+    HLOCAL handle = NULL;
+    const char *text = lock_editor_buffer(g_edit, &handle);
+    if (text) {
+        uint64_t len = 0;
+        uint64_t line = struct_index_line_of(si, caret);
+        uint64_t start = struct_index_line_start(si, line, &len);
+        g_long_view_want_x = long_view_x_of(text, line, start, len, caret - start);
+        long_view_show_caret(text, si);
+        unlock_editor_buffer(handle);
+    }
+    long_view_update_scrollbars();
+    SetFocus(g_long_view);
+    CheckMenuItem(GetMenu(hwnd), ID_VIEW_LONG_LINE, MF_BYCOMMAND | MF_CHECKED);
+    update_window_title(hwnd);
+    log_message("long line view: showing %llu lines", (unsigned long long)si->lines);
+}
+
+static BOOL file_looks_binary(HANDLE file) {
+    unsigned char sniff[HEX_SNIFF_BYTES];
+    DWORD got = 0;
+    LARGE_INTEGER zero = {0};
+    BOOL ok = ReadFile(file, sniff, sizeof(sniff), &got, NULL);
+    SetFilePointerEx(file, zero, NULL, FILE_BEGIN);
+    return ok && hex_looks_binary(sniff, got);
+}
+
+// Decodes a loaded file (BOM, line endings, journal recovery) into the EDIT
+// control. Takes ownership of `buffer`, which has room for a terminator.
+// With `parts` set the text is one part of a larger .gz: it opens read-only
+// and without a journal, and `parts` becomes g_gzip_parts.
+static BOOL show_loaded_text(HWND hwnd, const char *path, char *buffer, size_t size, BOOL gzip, GzipParts *parts) {
+    buffer[size] = '\0';
+
+    TextFormat format = {TEXT_ENC_RAW, TEXT_EOL_CRLF};
+    text_detect_bom(buffer, size, &format.encoding);
+    if (format.encoding != TEXT_ENC_UTF16LE && format.encoding != TEXT_ENC_UTF16BE && memchr(buffer, '\0', size)) {
+        free(buffer);
+        if (gzip) {
+            // The hex view maps the file on disk, which here is the compressed stream.
+            log_message("load_file_into_editor: binary content in gzip file path=%s", path);
+            MessageBoxA(hwnd, "The compressed file does not contain text.", "Open Error", MB_OK | MB_ICONERROR);
+            return FALSE;
+        }
+        // A NUL past the sniffed prefix: still binary, never lossy text.
+        return enter_hex_view(hwnd, path);
+    }
+    if (format.encoding == TEXT_ENC_UTF16LE || format.encoding == TEXT_ENC_UTF16BE) {
+        size_t utf16_bytes = size - 2u;
+        int wchar_count = (int)(utf16_bytes / 2u);
+        WCHAR *wide = NULL;
+        char *converted = NULL;
+        int out_bytes = 0;
+
+        wide = (WCHAR *)malloc(((size_t)wchar_count + 1u) * sizeof(WCHAR));
+        if (!wide) {
+            free(buffer);
+            return FALSE;
+        }
+        memcpy(wide, buffer + 2, (size_t)wchar_count * sizeof(WCHAR));
+        wide[wchar_count] = L'\0';
+        if (format.encoding == TEXT_ENC_UTF16BE) {
+            for (int i = 0; i < wchar_count; i++) {
+                wide[i] = (WCHAR)((wide[i] >> 8) | (wide[i] << 8));
+            }
+        }
+
+        out_bytes = WideCharToMultiByte(CP_ACP, 0, wide, wchar_count, NULL, 0, NULL, NULL);
+        if (out_bytes <= 0) {
+            free(wide);
+            free(buffer);
+            return FALSE;
+        }
+
+        converted = (char *)malloc((size_t)out_bytes + 1u);
+        if (!converted) {
+            free(wide);
+            free(buffer);
+            return FALSE;
+        }
+        if (WideCharToMultiByte(CP_ACP, 0, wide, wchar_count, converted, out_bytes, NULL, NULL) <= 0) {
+            free(converted);
+            free(wide);
+            free(buffer);
+            return FALSE;
+        }
+        converted[out_bytes] = '\0';
+        free(wide);
+        free(buffer);
+        buffer = converted;
+        size = (size_t)out_bytes;
+        log_message("load_file_into_editor: converted %s BOM file path=%s", text_encoding_name(format.encoding), path);
+    } else if (format.encoding == TEXT_ENC_UTF8_BOM) {
+        memmove(buffer, buffer + 3, size - 3u);
+        size -= 3u;
+        buffer[size] = '\0';
+        log_message("load_file_into_editor: stripped UTF-8 BOM path=%s", path);
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        if (buffer[i] == '\0') {
+            buffer[i] = ' ';
+        }
+    }
+    buffer[size] = '\0';
+
+    EolScan eol_scan;
+    if (!normalize_line_endings(&buffer, &size, &eol_scan)) {
+        log_message("load_file_into_editor: out of memory normalizing line endings path=%s", path);
+        free(buffer);
+        return FALSE;
+    }
+    format.eol = eol_scan_dominant(&eol_scan);
+    if (eol_scan_is_mixed(&eol_scan) || format.eol != TEXT_EOL_CRLF) {
+        log_message(
+            "load_file_into_editor: line endings crlf=%llu lf=%llu cr=%llu saving as %s path=%s",
+            (unsigned long long)eol_scan_crlf(&eol_scan),
+            (unsigned long long)eol_scan_lone_lf(&eol_scan),
+            (unsigned long long)eol_scan_lone_cr(&eol_scan),
+            text_eol_name(format.eol),
+            path
+        );
+    }
+
+    abort_streaming_paste(hwnd);
+    abort_gzip_open(hwnd);
+    abort_json_format(hwnd);
+    leave_csv_view(hwnd);
+    leave_fold_view(hwnd);
+    leave_long_line_view(hwnd);
+    leave_hex_view();
+    if (g_gzip_parts != parts) drop_gzip_parts(hwnd);
+    stop_journal();
+    char journal_path[MAX_PATH + 16];
+    char *recovered = NULL;
+    size_t recovered_len = 0;
+    JournalInfo journal_info = {0};
+    journal_path_for(path, journal_path, sizeof(journal_path));
+    int journal_status = parts ? JOURNAL_MISSING
+                               : journal_replay(journal_path, buffer, size, &recovered, &recovered_len, &journal_info);
+    if (journal_status == JOURNAL_OK && journal_info.records > 0) {
+        char prompt[MAX_PATH + 320];
+        snprintf(
+            prompt, sizeof(prompt),
+            "Unsaved changes to %s from a previous session were found (%llu edits).%s\n\nRecover them?",
+            path, (unsigned long long)journal_info.records,
+            journal_info.diverged
+                ? "\n\nThe journal stopped matching the document after these edits, so the"
+                  " recovered text is from that point and later changes are missing."
+                : ""
+        );
+        if (MessageBoxA(hwnd, prompt, "Recover Unsaved Changes", MB_YESNO | MB_ICONQUESTION) != IDYES) {
+            free(recovered);
+            recovered = NULL;
+        }
+    } else if (journal_status != JOURNAL_OK && journal_status != JOURNAL_MISSING) {
+        log_message("load_file_into_editor: ignoring journal path=%s status=%d", journal_path, journal_status);
+    }
+    if (recovered) {
+        log_message(
+            "load_file_into_editor: recovered %llu journal edits (torn bytes %llu, diverged %d) path=%s",
+            (unsigned long long)journal_info.records, (unsigned long long)journal_info.torn_bytes,
+            journal_info.diverged, path
+        );
+    }
+
+    wrap_long_line_document(hwnd, recovered ? recovered : buffer, recovered ? recovered_len : size);
+    if (!SendMessageA(g_edit, WM_SETTEXT, 0, (LPARAM)(recovered ? recovered : buffer))) {
+        log_message("load_file_into_editor: WM_SETTEXT failed path=%s", path);
+        free(recovered);
+        free(buffer);
+        return FALSE;
+    }
+    if (recovered) {
+        g_journal = journal_resume(journal_path, &journal_info, JOURNAL_BATCH_MS);
+        free(recovered);
+    }
+    if (!g_journal && !parts) {
+        start_journal(path, size, crc32_update(0, buffer, size));
+    }
+    if (parts) {
+        if (g_gzip_parts != parts) parts->was_read_only = g_read_only;
+        g_gzip_parts = parts;
+        g_read_only = TRUE;
+        SendMessageA(g_edit, EM_SETREADONLY, TRUE, 0);
+        CheckMenuItem(GetMenu(hwnd), ID_VIEW_READ_ONLY, MF_BYCOMMAND | MF_CHECKED);
+    }
+    g_text_format = format;
+    g_mixed_eol = eol_scan_is_mixed(&eol_scan) ? TRUE : FALSE;
+    g_gzip_source = gzip;
+    g_gzip_save_ok = FALSE;
+    lstrcpynA(g_current_file, path, MAX_PATH);
+    update_window_title(hwnd);
+    free(buffer);
+    // A line past the threshold is read in the long-line view; the wrapped
+    // EDIT control behind it is where editing happens.
+    if (g_long_line_len > 0) enter_long_line_view(hwnd);
+    log_message("load_file_into_editor: success path=%s bytes=%llu", path, (unsigned long long)size);
+    return TRUE;
+}
+
+static size_t gzip_file_read(void *ctx, unsigned char *buf, size_t cap) {
+    DWORD got = 0;
+    if (cap > 0x40000000u) cap = 0x40000000u;
+    if (!ReadFile((HANDLE)ctx, buf, (DWORD)cap, &got, NULL)) return 0;
+    return (size_t)got;
+}
+
+static int gzip_file_seek(void *ctx, uint64_t offset) {
+    LARGE_INTEGER at;
+    at.QuadPart = (LONGLONG)offset;
+    return SetFilePointerEx((HANDLE)ctx, at, NULL, FILE_BEGIN) ? 1 : 0;
+}
+
+static void report_gzip_progress(GzipOpenJob *job, uint64_t done, uint64_t whole) {
+    if (whole == 0) return;
+    unsigned percent = (unsigned)((done > whole ? whole : done) * 100u / whole);
+    if (percent != job->last_percent) {
+        job->last_percent = percent;
+        PostMessageA(job->hwnd, WM_APP_GZIP_PROGRESS, job->id, percent);
+    }
+}
+
+// Appends text to the job's store until the stream ends (GZIP_DONE) or
+// `limit` bytes are in (GZIP_TOO_LARGE, whether or not more follows).
+static int inflate_into_store(GzipOpenJob *job, GzReader *reader, unsigned char *chunk, uint64_t limit) {
+    for (;;) {
+        uint64_t have = doc_store_length(&job->text);
+        if (have == limit) return GZIP_TOO_LARGE;
+        size_t got = gz_reader_read(reader, chunk, limit - have < GZIP_CHUNK ? (size_t)(limit - have) : GZIP_CHUNK);
+        if (got == 0) return gz_reader_error(reader) ? GZIP_FAILED : GZIP_DONE;
+        if (!doc_store_append(&job->text, (const char *)chunk, got)) return GZIP_FAILED;
+        if (job->cancel) return GZIP_CANCELLED;
+        if (job->parts) {
+            report_gzip_progress(job, have + got, limit);
+        } else {
+            report_gzip_progress(job, gz_reader_compressed_pos(reader), job->compressed_size);
+        }
+    }
+}
+
+// Inflates the rest of an oversized stream without keeping it, which lays
+// checkpoints over all of it and gives the full size, then cuts the store
+// down to the first part.
+static int measure_gzip_rest(GzipOpenJob *job, GzReader *reader, unsigned char *chunk) {
+    uint64_t kept = doc_store_length(&job->text);
+    while (gz_reader_read(reader, chunk, GZIP_CHUNK) > 0) {
+        if (job->cancel) return GZIP_CANCELLED;
+        report_gzip_progress(job, gz_reader_compressed_pos(reader), job->compressed_size);
+    }
+    if (gz_reader_error(reader)) return GZIP_FAILED;
+    job->total = gz_reader_tell(reader);
+    if (job->total == kept) return GZIP_DONE;
+    doc_store_erase(&job->text, GZIP_PART_SIZE, kept - GZIP_PART_SIZE);
+    return GZIP_PARTS;
+}
+
+// Inflates a .gz file into a DocStore on a worker, then flattens it for the
+// usual text pipeline on the UI thread. With `parts` set it loads one part
+// of an oversized file through the seek index instead.
+static int gzip_open_worker(void *arg) {
+    GzipOpenJob *job = (GzipOpenJob *)arg;
+    unsigned char *chunk = (unsigned char *)malloc(GZIP_CHUNK);
+    GzReader *reader = job->parts ? job->parts->reader
+                                  : gz_reader_open(gzip_file_read, gzip_file_seek, job->file, GZ_CHECKPOINT_SPAN);
+    int status = GZIP_FAILED;
+
+    if (chunk && reader && job->parts) {
+        uint64_t left = job->parts->total - job->part_start;
+        if (gz_reader_seek(reader, job->part_start)) {
+            status = inflate_into_store(job, reader, chunk, left < GZIP_PART_SIZE ? left : GZIP_PART_SIZE);
+            // The part is a known slice, so ending short means the file changed.
+            if (status == GZIP_TOO_LARGE) status = GZIP_PARTS;
+            else if (status == GZIP_DONE) status = GZIP_FAILED;
+        }
+        job->error = gz_reader_error(reader);
+    } else if (chunk && reader) {
+        status = inflate_into_store(job, reader, chunk, GZIP_TEXT_LIMIT);
+        if (status == GZIP_TOO_LARGE) status = measure_gzip_rest(job, reader, chunk);
+        job->error = gz_reader_error(reader);
+        job->checkpoints = gz_reader_checkpoints(reader);
+    }
+    if (status == GZIP_PARTS && !job->parts) {
+        job->reader = reader;
+    } else if (!job->parts) {
+        gz_reader_close(reader);
+    }
+    free(chunk);
+
+    if (status == GZIP_DONE || status == GZIP_PARTS) {
+        job->flat_len = (size_t)doc_store_length(&job->text);
+        job->flat = (char *)malloc(job->flat_len + 1u);
+        // A short read means a spilled chunk could not be read back.
+        if (!job->flat || doc_store_read(&job->text, 0, job->flat, job->flat_len) != job->flat_len) {
+            status = GZIP_FAILED;
+        }
+    }
+    doc_store_free(&job->text);
+    job->status = status;
+    PostMessageA(job->hwnd, WM_APP_GZIP_DONE, job->id, 0);
+    return 0;
+}
+
+static void free_gzip_open_job(GzipOpenJob *job) {
+    sys_thread_join(&job->thread);
+    gz_reader_close(job->reader);
+    if (job->file != INVALID_HANDLE_VALUE) CloseHandle(job->file);
+    doc_store_free(&job->text);
+    free(job->flat);
+    free(job);
+}
+
+static void end_gzip_open(HWND hwnd) {
+    free_gzip_open_job(g_gzip_open);
+    g_gzip_open = NULL;
+    if (g_edit) SendMessageA(g_edit, EM_SETREADONLY, g_read_only || g_paste || g_json_format || g_csv || g_fold_view || g_long_view, 0);
+    update_window_title(hwnd);
+}
+
+// Blocks until the worker stops; used when another document replaces this one.
+static void abort_gzip_open(HWND hwnd) {
+    if (!g_gzip_open) return;
+    InterlockedExchange(&g_gzip_open->cancel, 1);
+    log_message("gzip: open of %s aborted", g_gzip_open->path);
+    end_gzip_open(hwnd);
+}
+
+static void free_gzip_parts(GzipParts *parts) {
+    if (!parts) return;
+    gz_reader_close(parts->reader);
+    CloseHandle(parts->file);
+    free(parts);
+}
+
+// A part load borrows the reader, so it stops first.
+static void drop_gzip_parts(HWND hwnd) {
+    if (!g_gzip_parts) return;
+    if (g_gzip_open && g_gzip_open->parts) abort_gzip_open(hwnd);
+    g_read_only = g_gzip_parts->was_read_only;
+    free_gzip_parts(g_gzip_parts);
+    g_gzip_parts = NULL;
+    if (g_edit) SendMessageA(g_edit, EM_SETREADONLY, g_read_only || g_paste || g_gzip_open || g_json_format || g_csv || g_fold_view || g_long_view, 0);
+    CheckMenuItem(GetMenu(hwnd), ID_VIEW_READ_ONLY, MF_BYCOMMAND | (g_read_only ? MF_CHECKED : MF_UNCHECKED));
+}
+
+// Takes ownership of `file`; for another part of the file on screen `parts`
+// is set and `file` is INVALID_HANDLE_VALUE. The current document stays
+// visible, read-only, until the decompressed text replaces it.
+static BOOL start_gzip_open(HWND hwnd, const char *path, HANDLE file, uint64_t compressed_size, GzipParts *parts,
+                            uint64_t part_start) {
+    abort_gzip_open(hwnd);
+    abort_streaming_paste(hwnd);
+    abort_json_format(hwnd);
+    leave_csv_view(hwnd);
+    leave_fold_view(hwnd);
+    leave_long_line_view(hwnd);
+
+    GzipOpenJob *job = (GzipOpenJob *)calloc(1, sizeof(GzipOpenJob));
+    if (!job) {
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        return FALSE;
+    }
+    job->hwnd = hwnd;
+    job->id = g_gzip_next_id++;
+    job->file = file;
+    job->compressed_size = compressed_size;
+    job->parts = parts;
+    job->part_start = part_start;
+    job->started_us = sys_now_us();
+    lstrcpynA(job->path, path, MAX_PATH);
+    doc_store_init(&job->text);
+
+    g_gzip_open = job;
+    g_gzip_percent = 0;
+    if (!sys_thread_start(&job->thread, gzip_open_worker, job)) {
+        g_gzip_open = NULL;
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        free(job);
+        return FALSE;
+    }
+    SendMessageA(g_edit, EM_SETREADONLY, TRUE, 0);
+    update_window_title(hwnd);
+    log_message(
+        "gzip: decompressing path=%s compressed=%llu part=%llu", path, (unsigned long long)compressed_size,
+        (unsigned long long)part_start
+    );
+    return TRUE;
+}
+
+static void move_gzip_part(HWND hwnd, BOOL forward) {
+    if (!g_gzip_parts || g_gzip_open) return;
+    uint64_t start = g_gzip_parts->start;
+    if (forward) {
+        if (g_gzip_parts->total - start <= GZIP_PART_SIZE) return;
+        start += GZIP_PART_SIZE;
+    } else {
+        if (start == 0) return;
+        start -= GZIP_PART_SIZE;
+    }
+    start_gzip_open(hwnd, g_current_file, INVALID_HANDLE_VALUE, 0, g_gzip_parts, start);
+}
+
+static void finish_gzip_open(HWND hwnd, UINT id) {
+    if (!g_gzip_open || g_gzip_open->id != id) return;
+    sys_thread_join(&g_gzip_open->thread);
+
+    GzipOpenJob *job = g_gzip_open;
+    int status = job->status;
+    double ms = (double)(sys_now_us() - job->started_us) / 1000.0;
+    char path[MAX_PATH];
+    char *text = job->flat;
+    size_t len = job->flat_len;
+    GzipParts *parts = job->parts;
+    uint64_t part_start = job->part_start;
+
+    lstrcpynA(path, job->path, MAX_PATH);
+    if (status == GZIP_PARTS && !parts) {
+        parts = (GzipParts *)calloc(1, sizeof(GzipParts));
+        if (parts) {
+            parts->file = job->file;
+            parts->reader = job->reader;
+            parts->total = job->total;
+            job->file = INVALID_HANDLE_VALUE;
+            job->reader = NULL;
+        } else {
+            status = GZIP_FAILED;
+        }
+    }
+    if (status == GZIP_DONE || status == GZIP_PARTS) {
+        log_message(
+            "gzip: inflated %llu bytes at %llu in %.1f ms (%.1f MB/s), %u checkpoints path=%s",
+            (unsigned long long)len,
+            (unsigned long long)job->part_start,
+            ms,
+            ms > 0.0 ? (double)len / 1000.0 / ms : 0.0,
+            (unsigned)job->checkpoints,
+            path
+        );
+        job->flat = NULL;
+    } else {
+        log_message(
+            "gzip: %s after %.1f ms path=%s%s%s",
+            status == GZIP_CANCELLED ? "cancelled" : "failed",
+            ms,
+            path,
+            job->error ? " error=" : "",
+            job->error ? job->error : ""
+        );
+    }
+    end_gzip_open(hwnd);
+
+    if (status == GZIP_DONE) {
+        show_loaded_text(hwnd, path, text, len, TRUE, NULL);
+    } else if (status == GZIP_PARTS) {
+        BOOL first = parts != g_gzip_parts;
+        uint64_t shown = parts->start;
+        parts->start = part_start;
+        if (!show_loaded_text(hwnd, path, text, len, TRUE, parts) && g_gzip_parts == parts) {
+            parts->start = shown;
+            update_window_title(hwnd);
+        }
+        if (g_gzip_parts != parts) {
+            free_gzip_parts(parts);
+        } else if (first) {
+            char msg[320];
+            snprintf(
+                msg, sizeof(msg),
+                "The decompressed text is %.1f MB, more than the editor holds at once. It is shown read-only "
+                "in parts of %u MB; Alt+Page Down and Alt+Page Up move between them.",
+                (double)parts->total / 1048576.0, GZIP_PART_SIZE >> 20
+            );
+            MessageBoxA(hwnd, msg, "Large Compressed File", MB_OK | MB_ICONINFORMATION);
+        }
+    } else if (status == GZIP_FAILED) {
+        MessageBoxA(hwnd, "Could not decompress the file; it is damaged or incomplete.", "Open Error", MB_OK | MB_ICONERROR);
+    }
+}
+
+static BOOL file_is_gzip(HANDLE file) {
+    unsigned char magic[3];
+    DWORD got = 0;
+    LARGE_INTEGER zero = {0};
+    BOOL ok = ReadFile(file, magic, sizeof(magic), &got, NULL);
+    SetFilePointerEx(file, zero, NULL, FILE_BEGIN);
+    return ok && gz_is_gzip(magic, got);
+}
+
+// JSON pretty-print and minify run on a snapshot of the document so the UI
+// stays live; the result replaces the whole text with one EM_REPLACESEL.
+static int json_output_sink(void *ctx, const void *data, size_t len) {
+    JsonFormatJob *job = (JsonFormatJob *)ctx;
+    if (doc_store_length(&job->text) + len > 0x7FFFFFFEu) {
+        job->status = FORMAT_TOO_LARGE;
+        return 0;
+    }
+    if (!doc_store_append(&job->text, (const char *)data, len)) {
+        job->status = FORMAT_FAILED;
+        return 0;
+    }
+    return 1;
+}
+
+static int json_input_sink(void *ctx, const char *data, size_t len) {
+    JsonFormatJob *job = (JsonFormatJob *)ctx;
+    if (job->cancel) {
+        job->status = FORMAT_CANCELLED;
+        return 0;
+    }
+    if (!json_format_feed(&job->formatter, data, len)) return 0;
+    job->fed += len;
+    unsigned percent = (unsigned)(job->fed * 100u / job->source_len);
+    if (percent != job->last_percent) {
+        job->last_percent = percent;
+        PostMessageA(job->hwnd, WM_APP_JSON_PROGRESS, job->id, percent);
+    }
+    return 1;
+}
+
+static int json_format_worker(void *arg) {
+    JsonFormatJob *job = (JsonFormatJob *)arg;
+
+    doc_snapshot_serialize(job->source, 0, job->source_len, json_input_sink, job);
+    if (job->status == FORMAT_RUNNING && json_format_finish(&job->formatter)) {
+        job->status = FORMAT_DONE;
+    } else if (job->status == FORMAT_RUNNING) {
+        job->status = FORMAT_INVALID;
+        job->error = json_format_error(&job->formatter);
+        job->error_offset = json_format_error_offset(&job->formatter);
+    }
+
+    if (job->status == FORMAT_DONE) {
+        job->flat_len = (size_t)doc_store_length(&job->text);
+        job->flat = (char *)malloc(job->flat_len + 1u);
+        if (job->flat && doc_store_read(&job->text, 0, job->flat, job->flat_len) == job->flat_len) {
+            job->flat[job->flat_len] = '\0';
+        } else {
+            job->status = FORMAT_FAILED;
+        }
+    }
+    doc_store_free(&job->text);
+    PostMessageA(job->hwnd, WM_APP_JSON_DONE, job->id, 0);
+    return 0;
+}
+
+static void end_json_format(HWND hwnd) {
+    JsonFormatJob *job = g_json_format;
+    sys_thread_join(&job->thread);
+    doc_snapshot_release(job->source);
+    doc_store_free(&job->text);
+    free(job->flat);
+    free(job);
+    g_json_format = NULL;
+    if (g_edit) SendMessageA(g_edit, EM_SETREADONLY, g_read_only || g_paste || g_gzip_open || g_csv || g_fold_view || g_long_view, 0);
+    update_window_title(hwnd);
+}
+
+// Blocks until the worker stops; used when another document replaces this one.
+static void abort_json_format(HWND hwnd) {
+    if (!g_json_format) return;
+    InterlockedExchange(&g_json_format->cancel, 1);
+    log_message("json: formatting aborted");
+    end_json_format(hwnd);
+}
+
+static void start_json_format(HWND hwnd, JsonFormatMode mode) {
+    if (g_hex || g_csv || g_fold_view || g_long_view || g_read_only || g_paste || g_gzip_open || g_json_format) {
+        MessageBeep(MB_OK);
+        return;
+    }
+
+    size_t len = (size_t)GetWindowTextLengthA(g_edit);
+    DocSnapshot *source = snapshot_document();
+    JsonFormatJob *job = source ? (JsonFormatJob *)calloc(1, sizeof(JsonFormatJob)) : NULL;
+    if (!job) {
+        doc_snapshot_release(source);
+        MessageBoxA(hwnd, "Not enough memory to format the document.", "Format JSON", MB_OK | MB_ICONERROR);
+        return;
+    }
+    job->hwnd = hwnd;
+    job->id = g_json_next_id++;
+    job->mode = mode;
+    job->source = source;
+    job->source_len = len;
+    job->started_us = sys_now_us();
+    doc_store_init(&job->text);
+    json_format_init(&job->formatter, mode, JSON_INDENT, "\r\n", json_output_sink, job);
+
+    g_json_format = job;
+    g_json_percent = 0;
+    if (!sys_thread_start(&job->thread, json_format_worker, job)) {
+        g_json_format = NULL;
+        doc_snapshot_release(source);
+        free(job);
+        return;
+    }
+    SendMessageA(g_edit, EM_SETREADONLY, TRUE, 0);
+    update_window_title(hwnd);
+    log_message("json: %s of %llu bytes started", mode == JSON_PRETTY ? "pretty print" : "minify", (unsigned long long)len);
+}
+
+static void finish_json_format(HWND hwnd, UINT id) {
+    if (!g_json_format || g_json_format->id != id) return;
+    sys_thread_join(&g_json_format->thread);
+
+    JsonFormatJob *job = g_json_format;
+    int status = job->status;
+    double ms = (double)(sys_now_us() - job->started_us) / 1000.0;
+    uint64_t in_len = job->source_len;
+    uint64_t error_offset = job->error_offset;
+    const char *error = job->error;   // static strings in json_format.c
+    char *text = job->flat;
+    size_t len = job->flat_len;
+
+    job->flat = NULL;
+    end_json_format(hwnd);
+
+    if (status == FORMAT_DONE) {
+        SendMessageA(g_edit, EM_SETSEL, 0, -1);
+        SendMessageA(g_edit, EM_REPLACESEL, TRUE, (LPARAM)text);
+        SendMessageA(g_edit, EM_SETSEL, 0, 0);
+        SendMessageA(g_edit, EM_SCROLLCARET, 0, 0);
+        log_message(
+            "json: %llu -> %llu bytes in %.1f ms (%.1f MB/s)",
+            (unsigned long long)in_len,
+            (unsigned long long)len,
+            ms,
+            ms > 0.0 ? (double)in_len / 1000.0 / ms : 0.0
+        );
+        free(text);
+        return;
+    }
+
+    log_message("json: stopped status=%d after %.1f ms%s%s", status, ms, error ? " error=" : "", error ? error : "");
+    if (status == FORMAT_INVALID) {
+        char msg[160];
+        snprintf(msg, sizeof(msg), "The document is not valid JSON: %s at byte %llu.", error, (unsigned long long)error_offset);
+        SendMessageA(g_edit, EM_SETSEL, (WPARAM)error_offset, (LPARAM)error_offset);
+        SendMessageA(g_edit, EM_SCROLLCARET, 0, 0);
+        MessageBoxA(hwnd, msg, "Format JSON", MB_OK | MB_ICONWARNING);
+    } else if (status == FORMAT_TOO_LARGE) {
+        MessageBoxA(hwnd, "The formatted document is too large for the editor control.", "Format JSON", MB_OK | MB_ICONERROR);
+    } else if (status == FORMAT_FAILED) {
+        MessageBoxA(hwnd, "Not enough memory to format the document.", "Format JSON", MB_OK | MB_ICONERROR);
+    }
+}
+
+static BOOL load_file_into_editor(HWND hwnd, const char *path) {
+    if (!g_edit || !path || path[0] == '\0') {
+        log_message("load_file_into_editor: invalid state g_edit=%p path=%s", (void *)g_edit, path ? path : "(null)");
+        return FALSE;
+    }
+
+    HANDLE file = CreateFileA(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+    if (file == INVALID_HANDLE_VALUE) {
+        log_message("load_file_into_editor: CreateFileA failed path=%s err=%lu", path, (unsigned long)GetLastError());
+        return FALSE;
+    }
+
+    LARGE_INTEGER file_size = {0};
+    if (!GetFileSizeEx(file, &file_size)) {
+        log_message("load_file_into_editor: GetFileSizeEx failed path=%s err=%lu", path, (unsigned long)GetLastError());
+        CloseHandle(file);
+        return FALSE;
+    }
+    log_message("load_file_into_editor: path=%s size=%lld", path, (long long)file_size.QuadPart);
+
+    // Compressed logs are inflated on a worker; the text arrives with WM_APP_GZIP_DONE.
+    if (file_is_gzip(file)) {
+        return start_gzip_open(hwnd, path, file, (uint64_t)file_size.QuadPart, NULL, 0);
+    }
+
+    // The EDIT control cannot hold NUL bytes; binary files open in the hex view.
+    if (file_looks_binary(file)) {
+        CloseHandle(file);
+        return enter_hex_view(hwnd, path);
+    }
+
+    if (file_size.QuadPart > (__int64)0x7FFFFFFE) {
+        CloseHandle(file);
+        log_message("load_file_into_editor: file too large path=%s", path);
+        MessageBoxA(hwnd, "File is too large for the editor control.", "Open Error", MB_OK | MB_ICONERROR);
+        return FALSE;
     }
 
     if (file_size.QuadPart < 0) {
@@ -1020,24 +5036,30 @@ static BOOL load_file_into_editor(HWND hwnd, const char *path) {
         return FALSE;
     }
 
-    size_t total_read = 0;
-    while (total_read < size) {
-        DWORD chunk_read = 0;
-        size_t remaining = size - total_read;
-        DWORD to_read = (remaining > 1024u * 1024u) ? (1024u * 1024u) : (DWORD)remaining;
-        if (!ReadFile(file, buffer + total_read, to_read, &chunk_read, NULL)) {
-            log_message("load_file_into_editor: ReadFile failed path=%s err=%lu", path, (unsigned long)GetLastError());
-            CloseHandle(file);
-            free(buffer);
-            return FALSE;
-        }
-        if (chunk_read == 0) {
-            break;
-        }
-        total_read += (size_t)chunk_read;
-    }
     CloseHandle(file);
 
+    // Keeps several 1 MB reads in flight instead of one blocking ReadFile at a time.
+    uint64_t read_started = sys_now_us();
+    AioFile *in = aio_open(path, 0, AIO_BACKEND_AUTO);
+    if (!in) {
+        log_message("load_file_into_editor: aio_open failed path=%s err=%lu", path, (unsigned long)GetLastError());
+        free(buffer);
+        return FALSE;
+    }
+    size_t total_read = (size_t)aio_read_all(in, buffer, size);
+    AioBackend backend = aio_backend(in);
+    if (!aio_close(in)) {
+        log_message("load_file_into_editor: read failed path=%s err=%lu", path, (unsigned long)GetLastError());
+        free(buffer);
+        return FALSE;
+    }
+    log_message(
+        "load_file_into_editor: read %llu bytes via %s in %.1f ms",
+        (unsigned long long)total_read,
+        aio_backend_name(backend),
+        (double)(sys_now_us() - read_started) / 1000.0
+    );
+
     if (total_read != size) {
         log_message(
             "load_file_into_editor: short read path=%s expected=%llu got=%llu",
@@ -1048,136 +5070,874 @@ static BOOL load_file_into_editor(HWND hwnd, const char *path) {
         free(buffer);
         return FALSE;
     }
-    buffer[size] = '\0';
+    return show_loaded_text(hwnd, path, buffer, size, FALSE, NULL);
+}
 
-    if (size >= 2 && (unsigned char)buffer[0] == 0xFF && (unsigned char)buffer[1] == 0xFE) {
-        size_t utf16_bytes = size - 2u;
-        int wchar_count = (int)(utf16_bytes / 2u);
-        WCHAR *wide = NULL;
-        char *converted = NULL;
-        int out_bytes = 0;
+static void open_file_into_editor(HWND hwnd) {
+    OPENFILENAMEA ofn = {0};
+    char path[MAX_PATH] = {0};
 
-        wide = (WCHAR *)malloc(((size_t)wchar_count + 1u) * sizeof(WCHAR));
-        if (!wide) {
-            free(buffer);
-            return FALSE;
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = hwnd;
+    ofn.lpstrFile = path;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.lpstrFilter = "Text Files (*.txt)\0*.txt\0All Files (*.*)\0*.*\0";
+    ofn.nFilterIndex = 1;
+    ofn.Flags = OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST | OFN_HIDEREADONLY;
+
+    if (!GetOpenFileNameA(&ofn)) {
+        return;
+    }
+
+    if (!confirm_hex_patches(hwnd)) {
+        return;
+    }
+    if (!load_file_into_editor(hwnd, path)) {
+        MessageBoxA(hwnd, "Could not open the selected file.", "Open Error", MB_OK | MB_ICONERROR);
+    }
+}
+
+static void apply_editor_font(const LOGFONTA *lf) {
+    HFONT new_font = CreateFontIndirectA(lf);
+    if (!new_font) return;
+
+    SendMessageA(g_edit, WM_SETFONT, (WPARAM)new_font, TRUE);
+    if (g_font) {
+        forget_font_metrics(g_font);
+        DeleteObject(g_font);
+    }
+    g_font = new_font;
+    if (g_long_view) {
+        long_view_measure_font();
+        long_view_update_scrollbars();
+        InvalidateRect(g_long_view, NULL, FALSE);
+    }
+}
+
+static void choose_editor_font(HWND hwnd) {
+    CHOOSEFONTA cf = {0};
+    LOGFONTA lf = g_logfont;
+
+    cf.lStructSize = sizeof(cf);
+    cf.hwndOwner = hwnd;
+    cf.lpLogFont = &lf;
+    cf.Flags = CF_SCREENFONTS | CF_INITTOLOGFONTSTRUCT | CF_NOVERTFONTS;
+
+    if (ChooseFontA(&cf)) {
+        g_logfont = lf;
+        apply_editor_font(&g_logfont);
+    }
+}
+
+// Large pastes are converted (UTF-16 -> ANSI, line endings -> CRLF) on a
+// worker that streams the clipboard into a DocStore, then land in the EDIT
+// control with a single EM_REPLACESEL so they undo as one step.
+static int paste_worker(void *arg) {
+    PasteJob *job = (PasteJob *)arg;
+    HANDLE handle = NULL;
+    const unsigned char *data = NULL;
+    BOOL wide = TRUE;
+    BOOL opened = OpenClipboard(NULL);
+    char *ansi = NULL;
+    char *crlf = NULL;
+    int status = PASTE_FAILED;
+
+    if (opened) {
+        handle = GetClipboardData(CF_UNICODETEXT);
+        if (!handle) {
+            handle = GetClipboardData(CF_TEXT);
+            wide = FALSE;
         }
-        memcpy(wide, buffer + 2, (size_t)wchar_count * sizeof(WCHAR));
-        wide[wchar_count] = L'\0';
+        data = handle ? (const unsigned char *)GlobalLock(handle) : NULL;
+    }
+    ansi = (char *)malloc(PASTE_CHUNK_UNITS * 2u);
+    crlf = (char *)malloc(PASTE_CHUNK_UNITS * 4u);
+
+    if (data && ansi && crlf) {
+        size_t unit_size = wide ? sizeof(WCHAR) : 1u;
+        size_t total = GlobalSize(handle) / unit_size;
+        size_t pos = 0;
+        unsigned last_percent = 0;
+        int after_cr = 0;
+
+        status = PASTE_DONE;
+        while (pos < total) {
+            size_t units = total - pos;
+            size_t end = 0;
+            size_t produced;
+            BOOL last = FALSE;
+
+            if (units > PASTE_CHUNK_UNITS) units = PASTE_CHUNK_UNITS;
+            // Clipboard text stops at its terminator, not at the allocation size.
+            for (; end < units; end++) {
+                if (wide ? ((const WCHAR *)data)[pos + end] == 0 : data[pos + end] == 0) break;
+            }
+            if (end < units) {
+                units = end;
+                last = TRUE;
+            } else if (wide && pos + units < total) {
+                WCHAR tail = ((const WCHAR *)data)[pos + units - 1u];
+                if (tail >= 0xD800 && tail <= 0xDBFF) units--;
+            }
 
-        out_bytes = WideCharToMultiByte(CP_ACP, 0, wide, wchar_count, NULL, 0, NULL, NULL);
-        if (out_bytes <= 0) {
-            free(wide);
-            free(buffer);
-            return FALSE;
+            if (units > 0) {
+                size_t ansi_len;
+                if (wide) {
+                    int n = WideCharToMultiByte(
+                        CP_ACP, 0, (const WCHAR *)data + pos, (int)units,
+                        ansi, PASTE_CHUNK_UNITS * 2, NULL, NULL
+                    );
+                    if (n <= 0) {
+                        status = PASTE_FAILED;
+                        break;
+                    }
+                    ansi_len = (size_t)n;
+                } else {
+                    memcpy(ansi, data + pos, units);
+                    ansi_len = units;
+                }
+                produced = eol_to_crlf(ansi, ansi_len, crlf, &after_cr);
+                if (!doc_store_append(&job->text, crlf, produced)) {
+                    status = PASTE_FAILED;
+                    break;
+                }
+            }
+            pos += units;
+            if (last) break;
+
+            if (job->cancel) {
+                status = PASTE_CANCELLED;
+                break;
+            }
+            {
+                unsigned percent = (unsigned)((uint64_t)pos * 100u / total);
+                if (percent != last_percent) {
+                    last_percent = percent;
+                    PostMessageA(job->hwnd, WM_APP_PASTE_PROGRESS, job->id, percent);
+                }
+            }
+        }
+    }
+    if (data) GlobalUnlock(handle);
+    if (opened) CloseClipboard();
+    free(ansi);
+    free(crlf);
+
+    if (status == PASTE_DONE) {
+        size_t len = (size_t)doc_store_length(&job->text);
+        job->flat = (char *)malloc(len + 1u);
+        if (job->flat && doc_store_read(&job->text, 0, job->flat, len) == len) {
+            job->flat[len] = '\0';
+        } else {
+            status = PASTE_FAILED;
         }
+    }
+    doc_store_free(&job->text);
+    job->status = status;
+    PostMessageA(job->hwnd, WM_APP_PASTE_DONE, job->id, 0);
+    return 0;
+}
 
-        converted = (char *)malloc((size_t)out_bytes + 1u);
-        if (!converted) {
-            free(wide);
-            free(buffer);
+static void free_paste_job(PasteJob *job) {
+    sys_thread_join(&job->thread);
+    doc_store_free(&job->text);
+    free(job->flat);
+    free(job);
+}
+
+static void end_streaming_paste(HWND hwnd) {
+    free_paste_job(g_paste);
+    g_paste = NULL;
+    if (g_edit) SendMessageA(g_edit, EM_SETREADONLY, g_read_only || g_gzip_open || g_json_format || g_csv || g_fold_view || g_long_view, 0);
+    update_window_title(hwnd);
+}
+
+// Blocks until the worker stops; used when the document is about to be replaced.
+static void abort_streaming_paste(HWND hwnd) {
+    if (!g_paste) return;
+    InterlockedExchange(&g_paste->cancel, 1);
+    log_message("paste: aborted");
+    end_streaming_paste(hwnd);
+}
+
+static size_t clipboard_text_bytes(HWND hwnd) {
+    size_t bytes = 0;
+    if (!OpenClipboard(hwnd)) return 0;
+    HANDLE handle = GetClipboardData(CF_UNICODETEXT);
+    if (!handle) handle = GetClipboardData(CF_TEXT);
+    if (handle) bytes = GlobalSize(handle);
+    CloseClipboard();
+    return bytes;
+}
+
+// Returns TRUE when the paste is handled here (or one is already running).
+static BOOL start_streaming_paste(HWND hwnd) {
+    if (g_csv || g_fold_view || g_long_view || g_paste || g_gzip_open || g_json_format) return TRUE;
+    size_t bytes = clipboard_text_bytes(hwnd);
+    if (bytes < PASTE_STREAM_THRESHOLD) return FALSE;
+
+    PasteJob *job = (PasteJob *)calloc(1, sizeof(PasteJob));
+    if (!job) return FALSE;
+    job->hwnd = hwnd;
+    job->id = g_paste_next_id++;
+    job->started_us = sys_now_us();
+    doc_store_init(&job->text);
+
+    g_paste = job;
+    g_paste_percent = 0;
+    if (!sys_thread_start(&job->thread, paste_worker, job)) {
+        g_paste = NULL;
+        free(job);
+        return FALSE;
+    }
+    SendMessageA(g_edit, EM_SETREADONLY, TRUE, 0);
+    update_window_title(hwnd);
+    log_message("paste: streaming %llu clipboard bytes", (unsigned long long)bytes);
+    return TRUE;
+}
+
+static void finish_streaming_paste(HWND hwnd, UINT id) {
+    if (!g_paste || g_paste->id != id) return;
+    sys_thread_join(&g_paste->thread);
+
+    int status = g_paste->status;
+    double ms = (double)(sys_now_us() - g_paste->started_us) / 1000.0;
+    if (status == PASTE_DONE) {
+        SendMessageA(g_edit, EM_SETREADONLY, g_read_only, 0);
+        SendMessageA(g_edit, EM_REPLACESEL, TRUE, (LPARAM)g_paste->flat);
+        log_message("paste: inserted %u bytes in %.1f ms", (unsigned)strlen(g_paste->flat), ms);
+    } else {
+        log_message("paste: %s after %.1f ms", status == PASTE_CANCELLED ? "cancelled" : "failed", ms);
+    }
+    end_streaming_paste(hwnd);
+    if (status == PASTE_FAILED) {
+        MessageBoxA(hwnd, "Could not paste the clipboard contents.", "Paste Error", MB_OK | MB_ICONERROR);
+    }
+}
+
+// Large copies only snapshot the selection and promise CF_TEXT; the global
+// block is built in WM_RENDERFORMAT if another program actually pastes.
+// CF_UNICODETEXT is synthesized by the system from CF_TEXT on demand.
+static BOOL defer_copy_selection(HWND edit, HWND owner) {
+    DWORD start = 0;
+    DWORD end = 0;
+    DocSnapshot *whole;
+    DocSnapshot *snap;
+
+    SendMessageA(edit, EM_GETSEL, (WPARAM)&start, (LPARAM)&end);
+    if (end < start || end - start < CLIPBOARD_DEFER_THRESHOLD) return FALSE;
+    whole = snapshot_document();
+    snap = whole ? doc_snapshot_slice(whole, start, end - start) : NULL;
+    doc_snapshot_release(whole);
+    if (!snap) return FALSE;
+
+    if (!OpenClipboard(owner)) {
+        doc_snapshot_release(snap);
+        return FALSE;
+    }
+    // Sends WM_DESTROYCLIPBOARD to us first if we own an older snapshot.
+    EmptyClipboard();
+    g_clip_snapshot = snap;
+    SetClipboardData(CF_TEXT, NULL);
+    CloseClipboard();
+    log_message("clipboard: deferred copy of %lu bytes", (unsigned long)(end - start));
+    return TRUE;
+}
+
+typedef struct {
+    char *dst;
+    size_t at;
+} ClipSink;
+
+static int clip_sink(void *ctx, const char *data, size_t len) {
+    ClipSink *sink = (ClipSink *)ctx;
+    memcpy(sink->dst + sink->at, data, len);
+    sink->at += len;
+    return 1;
+}
+
+static HGLOBAL render_clip_snapshot(void) {
+    uint64_t len = doc_snapshot_length(g_clip_snapshot);
+    uint64_t started = sys_now_us();
+    HGLOBAL mem = GlobalAlloc(GMEM_MOVEABLE, (SIZE_T)len + 1u);
+    ClipSink sink;
+
+    if (!mem) {
+        log_message("clipboard: out of memory rendering %llu bytes", (unsigned long long)len);
+        return NULL;
+    }
+    sink.dst = (char *)GlobalLock(mem);
+    sink.at = 0;
+    doc_snapshot_serialize(g_clip_snapshot, 0, len, clip_sink, &sink);
+    sink.dst[sink.at] = '\0';
+    GlobalUnlock(mem);
+    log_message(
+        "clipboard: rendered %llu bytes in %.1f ms",
+        (unsigned long long)len,
+        (double)(sys_now_us() - started) / 1000.0
+    );
+    return mem;
+}
+
+static void release_clip_snapshot(void) {
+    doc_snapshot_release(g_clip_snapshot);
+    g_clip_snapshot = NULL;
+}
+
+static BOOL is_edit_mutation(UINT msg, WPARAM wparam) {
+    switch (msg) {
+        case WM_CHAR:
+        case WM_CUT:
+        case WM_PASTE:
+        case WM_CLEAR:
+        case EM_REPLACESEL:
+            return TRUE;
+        case WM_KEYDOWN:
+            return wparam == VK_DELETE || wparam == VK_INSERT;
+        case WM_IME_CHAR:
+        case WM_IME_COMPOSITION:
+            return TRUE;
+        default:
             return FALSE;
-        }
-        if (WideCharToMultiByte(CP_ACP, 0, wide, wchar_count, converted, out_bytes, NULL, NULL) <= 0) {
-            free(converted);
-            free(wide);
-            free(buffer);
+    }
+}
+
+// Messages after which the caret may sit next to a different bracket.
+static BOOL may_move_caret(UINT msg) {
+    switch (msg) {
+        case WM_KEYDOWN:
+        case WM_CHAR:
+        case WM_LBUTTONDOWN:
+        case WM_LBUTTONUP:
+        case EM_SETSEL:
+        case EM_REPLACESEL:
+        case WM_CLEAR:
+        case WM_CUT:
+        case WM_PASTE:
+        case WM_UNDO:
+        case EM_UNDO:
+        case WM_SETTEXT:
+            return TRUE;
+        default:
             return FALSE;
+    }
+}
+
+// Extra carets come from Alt+click, Alt+drag (a column selection) and the
+// Edit menu. While there are any, typing and caret keys go to all of them:
+// each keystroke is one batched edit, applied as a single EM_REPLACESEL over
+// the span from the first caret to the last, so it is also one undo step.
+// The EDIT control shows the primary caret; the others are drawn over it.
+static void leave_multi_caret(HWND edit) {
+    if (g_multi.count == 0) return;
+    multi_edit_clear(&g_multi);
+    if (edit) InvalidateRect(edit, NULL, FALSE);
+}
+
+static int edit_line_height(HWND edit) {
+    HDC hdc = GetDC(edit);
+    HFONT font = (HFONT)SendMessageA(edit, WM_GETFONT, 0, 0);
+    HGDIOBJ old_font = SelectObject(hdc, font ? (HGDIOBJ)font : GetStockObject(SYSTEM_FONT));
+    TEXTMETRICA tm;
+    int height = GetTextMetricsA(hdc, &tm) && tm.tmHeight > 0 ? tm.tmHeight : 16;
+    SelectObject(hdc, old_font);
+    ReleaseDC(edit, hdc);
+    return height;
+}
+
+// Like EM_CHARFROMPOS, whose 16-bit result only holds the low bits of the
+// offset in large documents; the line start supplies the rest.
+static DWORD char_from_point(HWND edit, LPARAM point) {
+    LRESULT hit = SendMessageA(edit, EM_CHARFROMPOS, 0, point);
+    int y = GET_Y_LPARAM(point);
+    LRESULT line = SendMessageA(edit, EM_GETFIRSTVISIBLELINE, 0, 0) + (y > 0 ? y / edit_line_height(edit) : 0);
+    LRESULT lines = SendMessageA(edit, EM_GETLINECOUNT, 0, 0);
+    if (line >= lines) line = lines - 1;
+    DWORD start = (DWORD)SendMessageA(edit, EM_LINEINDEX, (WPARAM)line, 0);
+    DWORD at = (start & ~0xFFFFu) | (DWORD)LOWORD(hit);
+    if (at < start) at += 0x10000u;
+    DWORD end = start + (DWORD)SendMessageA(edit, EM_LINELENGTH, (WPARAM)start, 0);
+    return at > end ? end : at;
+}
+
+// Left edge of the character at `offset`; the end of the text has none, so
+// it is found after the last character.
+static BOOL caret_point(HWND edit, HDC hdc, const char *text, DWORD len, DWORD offset, POINT *pt) {
+    LRESULT pos = SendMessageA(edit, EM_POSFROMCHAR, (WPARAM)offset, 0);
+    SIZE size;
+    if (pos != -1) {
+        pt->x = GET_X_LPARAM(pos);
+        pt->y = GET_Y_LPARAM(pos);
+        return TRUE;
+    }
+    if (offset == 0 || offset != len || text[offset - 1u] == '\n') return FALSE;
+    pos = SendMessageA(edit, EM_POSFROMCHAR, (WPARAM)(offset - 1u), 0);
+    if (pos == -1 || !GetTextExtentPoint32A(hdc, text + offset - 1u, 1, &size)) return FALSE;
+    pt->x = GET_X_LPARAM(pos) + size.cx;
+    pt->y = GET_Y_LPARAM(pos);
+    return TRUE;
+}
+
+// Only the carets on visible lines are looked at.
+static void draw_multi_carets(HWND edit) {
+    if (g_multi.count == 0) return;
+    HLOCAL handle = NULL;
+    const char *text = lock_editor_buffer(edit, &handle);
+    if (!text) return;
+    DWORD len = (DWORD)GetWindowTextLengthA(edit);
+    HDC hdc = GetDC(edit);
+    HFONT font = (HFONT)SendMessageA(edit, WM_GETFONT, 0, 0);
+    HGDIOBJ old_font = SelectObject(hdc, font ? (HGDIOBJ)font : GetStockObject(SYSTEM_FONT));
+    HGDIOBJ old_pen = SelectObject(hdc, g_frame_pen);
+    HGDIOBJ old_brush = SelectObject(hdc, GetStockObject(NULL_BRUSH));
+    RECT client;
+    GetClientRect(edit, &client);
+
+    int line_h = edit_line_height(edit);
+    LRESULT first = SendMessageA(edit, EM_GETFIRSTVISIBLELINE, 0, 0);
+    LRESULT last = first + (client.bottom - client.top) / line_h + 1;
+    DWORD from = (DWORD)SendMessageA(edit, EM_LINEINDEX, (WPARAM)first, 0);
+    LRESULT last_start = SendMessageA(edit, EM_LINEINDEX, (WPARAM)(last + 1), 0);
+    DWORD to = last_start == -1 ? len : (DWORD)last_start;
+    size_t lo = 0;
+    size_t hi = g_multi.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2u;
+        const MultiCaret *c = &g_multi.carets[mid];
+        if ((c->anchor > c->caret ? c->anchor : c->caret) < from) {
+            lo = mid + 1u;
+        } else {
+            hi = mid;
         }
-        converted[out_bytes] = '\0';
-        free(wide);
-        free(buffer);
-        buffer = converted;
-        size = (size_t)out_bytes;
-        log_message("load_file_into_editor: converted UTF-16LE BOM file path=%s", path);
-    } else if (size >= 3 &&
-               (unsigned char)buffer[0] == 0xEF &&
-               (unsigned char)buffer[1] == 0xBB &&
-               (unsigned char)buffer[2] == 0xBF) {
-        memmove(buffer, buffer + 3, size - 3u);
-        size -= 3u;
-        buffer[size] = '\0';
-        log_message("load_file_into_editor: stripped UTF-8 BOM path=%s", path);
     }
 
-    for (size_t i = 0; i < size; i++) {
-        if (buffer[i] == '\0') {
-            buffer[i] = ' ';
+    for (size_t i = lo; i < g_multi.count; i++) {
+        const MultiCaret *c = &g_multi.carets[i];
+        DWORD sel_lo = (DWORD)(c->anchor < c->caret ? c->anchor : c->caret);
+        DWORD sel_hi = (DWORD)(c->anchor > c->caret ? c->anchor : c->caret);
+        POINT a;
+        POINT b;
+        if (sel_lo > to) break;
+        if (i == g_multi.primary) continue;
+        // A selection is framed line by line.
+        for (DWORD seg = sel_lo > from ? sel_lo : from; seg < sel_hi && seg <= to;) {
+            LRESULT line = SendMessageA(edit, EM_LINEFROMCHAR, (WPARAM)seg, 0);
+            DWORD line_start = (DWORD)SendMessageA(edit, EM_LINEINDEX, (WPARAM)line, 0);
+            DWORD line_end = line_start + (DWORD)SendMessageA(edit, EM_LINELENGTH, (WPARAM)line_start, 0);
+            DWORD seg_end = sel_hi < line_end ? sel_hi : line_end;
+            if (seg_end > seg && caret_point(edit, hdc, text, len, seg, &a) && caret_point(edit, hdc, text, len, seg_end, &b)) {
+                Rectangle(hdc, a.x, a.y, b.x + 1, a.y + line_h);
+            }
+            LRESULT next = SendMessageA(edit, EM_LINEINDEX, (WPARAM)(line + 1), 0);
+            if (next == -1 || (DWORD)next <= seg) break;
+            seg = (DWORD)next;
+        }
+        if (c->caret >= from && caret_point(edit, hdc, text, len, (DWORD)c->caret, &a)) {
+            MoveToEx(hdc, a.x, a.y, NULL);
+            LineTo(hdc, a.x, a.y + line_h);
         }
     }
-    buffer[size] = '\0';
+    SelectObject(hdc, old_brush);
+    SelectObject(hdc, old_pen);
+    SelectObject(hdc, old_font);
+    ReleaseDC(edit, hdc);
+    unlock_editor_buffer(handle);
+}
 
-    if (!SendMessageA(g_edit, WM_SETTEXT, 0, (LPARAM)buffer)) {
-        log_message("load_file_into_editor: WM_SETTEXT failed path=%s", path);
-        free(buffer);
-        return FALSE;
+// Puts the EDIT selection on the primary caret and repaints the rest. Once
+// the carets have merged into one, the EDIT control has it to itself again.
+static void show_multi_carets(HWND edit) {
+    if (g_multi.count > 0) {
+        const MultiCaret *c = &g_multi.carets[g_multi.primary];
+        g_multi_busy = TRUE;
+        SendMessageA(edit, EM_SETSEL, (WPARAM)c->anchor, (LPARAM)c->caret);
+        SendMessageA(edit, EM_SCROLLCARET, 0, 0);
+        g_multi_busy = FALSE;
+        if (g_multi.count == 1) multi_edit_clear(&g_multi);
     }
-    lstrcpynA(g_current_file, path, MAX_PATH);
-    update_window_title(hwnd);
-    free(buffer);
-    log_message("load_file_into_editor: success path=%s bytes=%llu", path, (unsigned long long)size);
-    return TRUE;
+    InvalidateRect(edit, NULL, FALSE);
 }
 
-static void open_file_into_editor(HWND hwnd) {
-    OPENFILENAMEA ofn = {0};
-    char path[MAX_PATH] = {0};
+static void apply_multi_patch(HWND edit, MultiPatch *patch) {
+    if (patch->range_count > 0) {
+        uint64_t started = sys_now_us();
+        g_multi_busy = TRUE;
+        g_multi_patch = patch;
+        SendMessageA(edit, EM_SETSEL, (WPARAM)patch->start, (LPARAM)patch->end);
+        SendMessageA(edit, EM_REPLACESEL, TRUE, (LPARAM)patch->text);
+        g_multi_patch = NULL;
+        g_multi_busy = FALSE;
+        if (patch->range_count >= 1000u) {
+            log_message("carets: %lu ranges over %lu bytes applied in %.1f ms",
+                (unsigned long)patch->range_count, (unsigned long)(patch->end - patch->start),
+                (double)(sys_now_us() - started) / 1000.0);
+        }
+    }
+    multi_patch_free(patch);
+    show_multi_carets(edit);
+}
 
-    ofn.lStructSize = sizeof(ofn);
-    ofn.hwndOwner = hwnd;
-    ofn.lpstrFile = path;
-    ofn.nMaxFile = MAX_PATH;
-    ofn.lpstrFilter = "Text Files (*.txt)\0*.txt\0All Files (*.*)\0*.*\0";
-    ofn.nFilterIndex = 1;
-    ofn.Flags = OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST | OFN_HIDEREADONLY;
+// Starts from the EDIT selection when there are no extra carets yet.
+static BOOL seed_multi_caret(HWND edit, const char *text, size_t len) {
+    DWORD sel_start = 0;
+    DWORD sel_end = 0;
+    if (g_multi.count > 0) return TRUE;
+    SendMessageA(edit, EM_GETSEL, (WPARAM)&sel_start, (LPARAM)&sel_end);
+    return multi_edit_add(&g_multi, text, len, sel_start, sel_end);
+}
 
-    if (!GetOpenFileNameA(&ofn)) {
+typedef enum { MULTI_ADD_ABOVE, MULTI_ADD_BELOW, MULTI_LINE_ENDS, MULTI_COLUMN, MULTI_CLICK } MultiCommand;
+
+static void multi_caret_command(HWND edit, MultiCommand command, DWORD from, DWORD to) {
+    if (!edit || !IsWindowVisible(edit)) {
+        MessageBeep(MB_OK);
         return;
     }
+    close_completion();
+    HLOCAL handle = NULL;
+    const char *text = lock_editor_buffer(edit, &handle);
+    size_t len = (size_t)GetWindowTextLengthA(edit);
+    int ok = text != NULL;
+    if (ok) {
+        switch (command) {
+            case MULTI_ADD_ABOVE:
+            case MULTI_ADD_BELOW:
+                ok = seed_multi_caret(edit, text, len) &&
+                     multi_edit_add_vertical(&g_multi, text, len, command == MULTI_ADD_BELOW);
+                break;
+            case MULTI_LINE_ENDS:
+                SendMessageA(edit, EM_GETSEL, (WPARAM)&from, (LPARAM)&to);
+                ok = multi_edit_line_ends(&g_multi, text, len, from, to);
+                break;
+            case MULTI_COLUMN:
+                ok = multi_edit_column_select(&g_multi, text, len, from, to);
+                break;
+            case MULTI_CLICK:
+                ok = seed_multi_caret(edit, text, len) && multi_edit_add(&g_multi, text, len, from, from);
+                break;
+        }
+    }
+    unlock_editor_buffer(handle);
+    if (!ok && command != MULTI_COLUMN) MessageBeep(MB_OK);
+    show_multi_carets(edit);
+}
+
+static char *read_clipboard_text(HWND owner, size_t *out_len) {
+    char *copy = NULL;
+    if (!OpenClipboard(owner)) return NULL;
+    HANDLE handle = GetClipboardData(CF_TEXT);
+    const char *data = handle ? (const char *)GlobalLock(handle) : NULL;
+    if (data) {
+        size_t len = strlen(data);
+        copy = (char *)malloc(len + 1u);
+        if (copy) {
+            memcpy(copy, data, len + 1u);
+            *out_len = len;
+        }
+        GlobalUnlock(handle);
+    }
+    CloseClipboard();
+    return copy;
+}
+
+static BOOL write_clipboard_text(HWND owner, const char *data, size_t len) {
+    HGLOBAL mem = GlobalAlloc(GMEM_MOVEABLE, len + 1u);
+    char *dst = mem ? (char *)GlobalLock(mem) : NULL;
+    if (!dst) {
+        if (mem) GlobalFree(mem);
+        return FALSE;
+    }
+    memcpy(dst, data, len + 1u);
+    GlobalUnlock(mem);
+    if (!OpenClipboard(owner)) {
+        GlobalFree(mem);
+        return FALSE;
+    }
+    EmptyClipboard();
+    if (!SetClipboardData(CF_TEXT, mem)) GlobalFree(mem);
+    CloseClipboard();
+    return TRUE;
+}
+
+// Keys and clipboard messages while there are extra carets. Returns FALSE
+// to let the EDIT control have the message, after leaving multi-caret mode
+// when the message would move its caret on its own.
+static BOOL multi_caret_message(HWND edit, UINT msg, WPARAM wparam) {
+    BOOL read_only = (GetWindowLongA(edit, GWL_STYLE) & ES_READONLY) != 0;
+    BOOL extend = GetKeyState(VK_SHIFT) < 0;
+    const char *insert = NULL;
+    char typed[2] = {0, 0};
+    enum { MULTI_NONE, MULTI_TYPE, MULTI_BACK, MULTI_DELETE, MULTI_PASTE, MULTI_COPY, MULTI_CUT } op = MULTI_NONE;
+    MultiMove move = MULTI_LEFT;
+    BOOL moving = FALSE;
+
+    switch (msg) {
+        case WM_KEYDOWN:
+            switch (wparam) {
+                case VK_LEFT: move = MULTI_LEFT; moving = TRUE; break;
+                case VK_RIGHT: move = MULTI_RIGHT; moving = TRUE; break;
+                case VK_HOME: move = MULTI_HOME; moving = TRUE; break;
+                case VK_END: move = MULTI_END; moving = TRUE; break;
+                case VK_UP: move = MULTI_UP; moving = TRUE; break;
+                case VK_DOWN: move = MULTI_DOWN; moving = TRUE; break;
+                case VK_DELETE: op = MULTI_DELETE; break;
+                case VK_TAB: op = MULTI_TYPE; insert = "\t"; break;
+                case VK_ESCAPE:
+                case VK_PRIOR:
+                case VK_NEXT:
+                    leave_multi_caret(edit);
+                    return FALSE;
+                default:
+                    return FALSE;
+            }
+            if (moving && GetKeyState(VK_CONTROL) < 0) {
+                leave_multi_caret(edit);
+                return FALSE;
+            }
+            break;
+        case WM_CHAR:
+            switch (wparam) {
+                case 0x03: op = MULTI_COPY; break;
+                case 0x16: op = MULTI_PASTE; break;
+                case 0x18: op = MULTI_CUT; break;
+                case 0x08: op = MULTI_BACK; break;
+                case '\r': op = MULTI_TYPE; insert = "\r\n"; break;
+                case 0x1A:
+                case 0x01:
+                    leave_multi_caret(edit);
+                    return FALSE;
+                default:
+                    // Tab was typed on its key; other control characters do nothing.
+                    if (wparam < 0x20 || wparam == 0x7F || wparam > 0xFF) return TRUE;
+                    typed[0] = (char)wparam;
+                    insert = typed;
+                    op = MULTI_TYPE;
+                    break;
+            }
+            break;
+        case WM_COPY: op = MULTI_COPY; break;
+        case WM_CUT: op = MULTI_CUT; break;
+        case WM_PASTE: op = MULTI_PASTE; break;
+        case WM_CLEAR: op = MULTI_DELETE; break;
+        case WM_LBUTTONDOWN:
+        case WM_UNDO:
+        case EM_UNDO:
+        case WM_SETTEXT:
+        case EM_SETSEL:
+            leave_multi_caret(edit);
+            return FALSE;
+        default:
+            return FALSE;
+    }
 
-    if (!load_file_into_editor(hwnd, path)) {
-        MessageBoxA(hwnd, "Could not open the selected file.", "Open Error", MB_OK | MB_ICONERROR);
+    HWND owner = GetParent(edit);
+    char *clip = NULL;
+    size_t clip_len = 0;
+    if (op != MULTI_NONE && op != MULTI_COPY && read_only) {
+        MessageBeep(MB_OK);
+        return TRUE;
+    }
+    if (op == MULTI_PASTE) {
+        // Huge clipboards take the streaming paste at the primary caret.
+        if (clipboard_text_bytes(owner) >= PASTE_STREAM_THRESHOLD) {
+            leave_multi_caret(edit);
+            return FALSE;
+        }
+        clip = read_clipboard_text(owner, &clip_len);
+        if (!clip) return TRUE;
     }
-}
-
-static void apply_editor_font(const LOGFONTA *lf) {
-    HFONT new_font = CreateFontIndirectA(lf);
-    if (!new_font) return;
 
-    SendMessageA(g_edit, WM_SETFONT, (WPARAM)new_font, TRUE);
-    if (g_font) {
-        DeleteObject(g_font);
+    HLOCAL handle = NULL;
+    const char *text = lock_editor_buffer(edit, &handle);
+    size_t len = (size_t)GetWindowTextLengthA(edit);
+    MultiPatch patch;
+    int ok = text != NULL;
+    memset(&patch, 0, sizeof(patch));
+    if (ok) {
+        if (moving) {
+            multi_edit_move(&g_multi, text, len, move, extend);
+        } else if (op == MULTI_COPY || op == MULTI_CUT) {
+            size_t copied = 0;
+            char *out = multi_edit_copy(&g_multi, text, len, "\r\n", &copied);
+            ok = out && (copied == 0 || write_clipboard_text(owner, out, copied));
+            free(out);
+            if (ok && op == MULTI_CUT) ok = multi_edit_type(&g_multi, text, len, "", 0, &patch);
+        } else if (op == MULTI_TYPE) {
+            ok = multi_edit_type(&g_multi, text, len, insert, strlen(insert), &patch);
+        } else if (op == MULTI_BACK || op == MULTI_DELETE) {
+            ok = multi_edit_delete(&g_multi, text, len, op == MULTI_DELETE, &patch);
+        } else if (op == MULTI_PASTE) {
+            ok = multi_edit_paste(&g_multi, text, len, clip, clip_len, &patch);
+        }
     }
-    g_font = new_font;
+    unlock_editor_buffer(handle);
+    free(clip);
+    if (!ok) {
+        log_message("carets: out of memory applying an edit");
+        MessageBeep(MB_OK);
+        return TRUE;
+    }
+    apply_multi_patch(edit, &patch);
+    return TRUE;
 }
 
-static void choose_editor_font(HWND hwnd) {
-    CHOOSEFONTA cf = {0};
-    LOGFONTA lf = g_logfont;
-
-    cf.lStructSize = sizeof(cf);
-    cf.hwndOwner = hwnd;
-    cf.lpLogFont = &lf;
-    cf.Flags = CF_SCREENFONTS | CF_INITTOLOGFONTSTRUCT | CF_NOVERTFONTS;
-
-    if (ChooseFontA(&cf)) {
-        g_logfont = lf;
-        apply_editor_font(&g_logfont);
+// Alt+drag selects a column; Alt+click without moving adds a caret.
+static BOOL column_mouse_message(HWND edit, UINT msg, WPARAM wparam, LPARAM lparam) {
+    switch (msg) {
+        case WM_LBUTTONDOWN:
+            if (GetKeyState(VK_MENU) >= 0) return FALSE;
+            SetFocus(edit);
+            SetCapture(edit);
+            g_column_drag = TRUE;
+            g_column_moved = FALSE;
+            g_column_from = char_from_point(edit, lparam);
+            g_alt_click = TRUE;
+            return TRUE;
+        case WM_MOUSEMOVE:
+            if (!g_column_drag) return FALSE;
+            {
+                DWORD to = char_from_point(edit, lparam);
+                if (!g_column_moved && to == g_column_from) return TRUE;
+                g_column_moved = TRUE;
+                multi_caret_command(edit, MULTI_COLUMN, g_column_from, to);
+            }
+            return TRUE;
+        case WM_LBUTTONUP:
+            if (!g_column_drag) return FALSE;
+            g_column_drag = FALSE;
+            ReleaseCapture();
+            if (!g_column_moved) multi_caret_command(edit, MULTI_CLICK, g_column_from, g_column_from);
+            return TRUE;
+        case WM_CAPTURECHANGED:
+            g_column_drag = FALSE;
+            return FALSE;
+        case WM_SYSKEYUP:
+            // Releasing Alt after using it with the mouse must not open the menu.
+            if (wparam != VK_MENU || !g_alt_click) return FALSE;
+            g_alt_click = FALSE;
+            return TRUE;
+        default:
+            return FALSE;
     }
 }
 
 static LRESULT CALLBACK edit_proc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
+    if (msg == WM_PAINT && (g_match_shown || g_multi.count > 0)) {
+        LRESULT result = CallWindowProcA(g_edit_proc, hwnd, msg, wparam, lparam);
+        draw_bracket_frames(hwnd);
+        draw_multi_carets(hwnd);
+        return result;
+    }
+    if (g_edit_capture_depth == 0 && !g_multi_busy) {
+        if (column_mouse_message(hwnd, msg, wparam, lparam)) return 0;
+        if (g_multi.count > 0 && multi_caret_message(hwnd, msg, wparam)) return 0;
+    }
+    if (msg == WM_PASTE && g_edit_capture_depth == 0 && start_streaming_paste(GetParent(hwnd))) {
+        return 0;
+    }
+    if ((msg == WM_COPY || msg == WM_CUT) && g_edit_capture_depth == 0 &&
+        defer_copy_selection(hwnd, GetParent(hwnd))) {
+        if (msg == WM_CUT) SendMessageA(hwnd, WM_CLEAR, 0, 0);
+        return 0;
+    }
+    if (msg == WM_KEYDOWN && wparam == VK_ESCAPE && (g_paste || g_gzip_open || g_json_format)) {
+        if (g_paste) InterlockedExchange(&g_paste->cancel, 1);
+        if (g_gzip_open) InterlockedExchange(&g_gzip_open->cancel, 1);
+        if (g_json_format) InterlockedExchange(&g_json_format->cancel, 1);
+        return 0;
+    }
+    if (g_complete_swallow && msg == WM_CHAR) {
+        BOOL same = wparam == g_complete_swallow;
+        g_complete_swallow = 0;
+        if (same) return 0;
+    }
+    if (g_complete) {
+        if (msg == WM_KEYDOWN) {
+            switch (wparam) {
+                case VK_UP:
+                case VK_DOWN:
+                    g_complete_sel = (g_complete_sel + (wparam == VK_UP ? g_complete_count - 1 : 1)) % g_complete_count;
+                    InvalidateRect(g_complete, NULL, FALSE);
+                    return 0;
+                case VK_RETURN:
+                case VK_TAB:
+                    g_complete_swallow = wparam == VK_RETURN ? '\r' : '\t';
+                    accept_completion(hwnd);
+                    return 0;
+                case VK_ESCAPE:
+                    g_complete_swallow = 0x1B;
+                    close_completion();
+                    return 0;
+                default:
+                    break;
+            }
+        }
+        if (msg == WM_KILLFOCUS || msg == WM_LBUTTONDOWN || msg == WM_MOUSEWHEEL || msg == WM_VSCROLL || msg == WM_HSCROLL) {
+            close_completion();
+        }
+    }
     if (msg == WM_KEYDOWN && wparam == VK_TAB) {
         SendMessageA(hwnd, EM_REPLACESEL, TRUE, (LPARAM)"\t");
         return 0;
     }
+
+    if ((g_journal || g_doc_mirror || g_struct.blocks || marker_tree_count(&g_markers) || g_multi.count) &&
+        g_edit_capture_depth == 0) {
+        LRESULT result;
+        // Alt+Backspace is the EDIT control's own undo key.
+        if (msg == WM_UNDO || msg == EM_UNDO || msg == WM_SETTEXT || (msg == WM_SYSKEYDOWN && wparam == VK_BACK)) {
+            // The EDIT undo buffer is opaque, so journal the whole result;
+            // the mirror and structure index are rebuilt when next needed.
+            int old_len = GetWindowTextLengthA(hwnd);
+            g_edit_capture_depth++;
+            g_change_captured = TRUE;
+            result = CallWindowProcA(g_edit_proc, hwnd, msg, wparam, lparam);
+            g_change_captured = FALSE;
+            g_edit_capture_depth--;
+            if (g_journal) journal_whole_text(hwnd);
+            drop_doc_mirror();
+            drop_struct_index();
+            if (msg == WM_SETTEXT) {
+                marker_tree_clear(&g_markers);
+            } else {
+                clamp_markers(old_len, GetWindowTextLengthA(hwnd));
+            }
+            update_bracket_highlight(hwnd);
+            return result;
+        }
+        if (is_edit_mutation(msg, wparam)) {
+            EditState before;
+            EditState after;
+            read_edit_state(hwnd, &before);
+            g_edit_capture_depth++;
+            g_change_captured = TRUE;
+            result = CallWindowProcA(g_edit_proc, hwnd, msg, wparam, lparam);
+            g_change_captured = FALSE;
+            g_edit_capture_depth--;
+            read_edit_state(hwnd, &after);
+            capture_edit_change(hwnd, &before, &after);
+            update_bracket_highlight(hwnd);
+            if (g_complete) refresh_completion(hwnd);
+            return result;
+        }
+    }
+    if (may_move_caret(msg) && g_edit_capture_depth == 0) {
+        LRESULT result = CallWindowProcA(g_edit_proc, hwnd, msg, wparam, lparam);
+        update_bracket_highlight(hwnd);
+        if (g_complete) {
+            DWORD caret = 0;
+            SendMessageA(hwnd, EM_GETSEL, 0, (LPARAM)&caret);
+            if (caret != g_complete_caret) close_completion();
+        }
+        return result;
+    }
     return CallWindowProcA(g_edit_proc, hwnd, msg, wparam, lparam);
 }
 
 static DWORD get_edit_style(void) {
     DWORD style = WS_CHILD | WS_VISIBLE | WS_VSCROLL |
                   ES_LEFT | ES_MULTILINE | ES_AUTOVSCROLL;
-    if (!g_word_wrap) {
+    if (!g_word_wrap && !g_doc_wrap) {
         style |= WS_HSCROLL | ES_AUTOHSCROLL;
     }
     return style;
@@ -1204,22 +5964,118 @@ static void create_editor_control(HWND hwnd, HINSTANCE instance, const char *ini
     g_edit_proc = (WNDPROC)SetWindowLongPtrA(g_edit, GWLP_WNDPROC, (LONG_PTR)edit_proc);
     apply_editor_font(&g_logfont);
     SendMessageA(g_edit, EM_SETMARGINS, EC_LEFTMARGIN | EC_RIGHTMARGIN, MAKELPARAM(12, 12));
-    SendMessageA(g_edit, EM_SETREADONLY, g_read_only, 0);
+    SendMessageA(g_edit, EM_SETREADONLY, g_read_only || g_paste || g_gzip_open || g_json_format || g_csv || g_fold_view || g_long_view, 0);
+    if (g_hex || g_csv || g_fold_view || g_long_view) ShowWindow(g_edit, SW_HIDE);
 }
 
+// Hands the staged text to the new control as its own buffer, so no flat
+// copy exists next to it. Falls back to appending chunk by chunk; the
+// caller keeps edit_proc from capturing those appends.
+static BOOL restore_staged_text(DocStore *staged) {
+    size_t len = (size_t)doc_store_length(staged);
+    HLOCAL fresh = LocalAlloc(LMEM_MOVEABLE, len + 1u);
+    char *dst = fresh ? (char *)LocalLock(fresh) : NULL;
+    if (dst && doc_store_read(staged, 0, dst, len) == len) {
+        dst[len] = '\0';
+        LocalUnlock(fresh);
+        HLOCAL old = (HLOCAL)SendMessageA(g_edit, EM_GETHANDLE, 0, 0);
+        SendMessageA(g_edit, EM_SETHANDLE, (WPARAM)fresh, 0);
+        if (old) LocalFree(old);
+        return TRUE;
+    }
+    if (dst) LocalUnlock(fresh);
+    if (fresh) LocalFree(fresh);
+
+    char *piece = (char *)malloc(DOC_CHUNK_SIZE + 1u);
+    uint64_t at = 0;
+    if (!piece) return FALSE;
+    while (at < len) {
+        size_t got = doc_store_read(staged, at, piece, DOC_CHUNK_SIZE);
+        if (got == 0) break;
+        piece[got] = '\0';
+        SendMessageA(g_edit, EM_SETSEL, (WPARAM)at, (LPARAM)at);
+        SendMessageA(g_edit, EM_REPLACESEL, FALSE, (LPARAM)piece);
+        at += got;
+    }
+    free(piece);
+    SendMessageA(g_edit, EM_EMPTYUNDOBUFFER, 0, 0);
+    return at == len;
+}
+
+// The text waits in a DocStore while neither control exists, so the memory
+// budget applies to it instead of a second full copy.
 static void recreate_editor_control(HWND hwnd) {
-    char *text = get_editor_text(NULL);
+    HINSTANCE instance = (HINSTANCE)GetWindowLongPtrA(hwnd, GWLP_HINSTANCE);
     DWORD sel_start = 0;
     DWORD sel_end = 0;
     SendMessageA(g_edit, EM_GETSEL, (WPARAM)&sel_start, (LPARAM)&sel_end);
+    multi_edit_clear(&g_multi);
+
+    HLOCAL handle = NULL;
+    size_t len = (size_t)GetWindowTextLengthA(g_edit);
+    const char *text = lock_editor_buffer(g_edit, &handle);
+    DocStore staged;
+    doc_store_init(&staged);
+    BOOL ok = text && doc_store_append(&staged, text, len);
+    unlock_editor_buffer(handle);
+
+    if (!ok) {
+        char *flat = get_editor_text(NULL);
+        DestroyWindow(g_edit);
+        create_editor_control(hwnd, instance, flat ? flat : "");
+        free(flat);
+    } else {
+        DestroyWindow(g_edit);
+        create_editor_control(hwnd, instance, "");
+        // The text comes back unchanged, so the journal, the mirror, the
+        // indexes and the bookmarks must not see the restore as edits.
+        uint64_t journaled = g_journal ? journal_pending_edits(g_journal) : 0;
+        g_edit_capture_depth++;
+        g_change_captured = TRUE;
+        BOOL restored = restore_staged_text(&staged);
+        g_change_captured = FALSE;
+        g_edit_capture_depth--;
+        if (g_journal && journal_pending_edits(g_journal) != journaled) {
+            log_message("recreate: restore reached the journal, rewriting the whole text");
+            journal_whole_text(g_edit);
+        }
+        if (!restored) {
+            int now = GetWindowTextLengthA(g_edit);
+            log_message("recreate: could not restore %llu bytes", (unsigned long long)len);
+            clamp_markers((int)len, now);
+            if (g_journal) journal_whole_text(g_edit);
+            drop_doc_mirror();
+            drop_struct_index();
+            MessageBoxA(hwnd, "Some of the text could not be restored after switching the view.", "Editor", MB_OK | MB_ICONERROR);
+        }
+    }
+    doc_store_free(&staged);
+    SendMessageA(g_edit, EM_SETSEL, sel_start, sel_end);
+}
 
-    DestroyWindow(g_edit);
-    create_editor_control(hwnd, (HINSTANCE)GetWindowLongPtrA(hwnd, GWLP_HINSTANCE), text ? text : "");
+static void set_wrap_mode(HWND hwnd, BOOL word_wrap, BOOL doc_wrap) {
+    BOOL was = g_word_wrap || g_doc_wrap;
+    g_word_wrap = word_wrap;
+    g_doc_wrap = doc_wrap && !word_wrap;
+    CheckMenuItem(
+        GetMenu(hwnd),
+        ID_VIEW_WORD_WRAP,
+        MF_BYCOMMAND | ((g_word_wrap || g_doc_wrap) ? MF_CHECKED : MF_UNCHECKED)
+    );
+    if (was != (g_word_wrap || g_doc_wrap)) {
+        recreate_editor_control(hwnd);
+    }
+    update_window_title(hwnd);
+}
 
-    if (text) {
-        free(text);
+// Drops a long-line wrap when its document goes away; the text goes with it
+// so the control is not rebuilt around the old line.
+static void end_document_wrap(HWND hwnd) {
+    g_long_line_len = 0;
+    if (g_doc_wrap) {
+        SetWindowTextA(g_edit, "");
+        set_wrap_mode(hwnd, g_word_wrap, FALSE);
     }
-    SendMessageA(g_edit, EM_SETSEL, sel_start, sel_end);
 }
 
 static HMENU build_menu(void) {
@@ -1234,6 +6090,8 @@ static HMENU build_menu(void) {
     append_ownerdraw_item(file_menu, MF_STRING, ID_FILE_OPEN, "&Open...\tCtrl+O");
     append_ownerdraw_item(file_menu, MF_STRING, ID_FILE_SAVE, "&Save\tCtrl+S");
     append_ownerdraw_item(file_menu, MF_STRING, ID_FILE_INFO, "File &Info");
+    append_ownerdraw_item(file_menu, MF_STRING, ID_FILE_NEXT_PART, "Ne&xt Part\tAlt+PgDn");
+    append_ownerdraw_item(file_menu, MF_STRING, ID_FILE_PREV_PART, "&Previous Part\tAlt+PgUp");
     AppendMenuA(file_menu, MF_SEPARATOR, 0, NULL);
     append_ownerdraw_item(file_menu, MF_STRING, ID_FILE_EXIT, "E&xit\tCtrl+Q");
     append_ownerdraw_item(main_menu, MF_POPUP, (UINT_PTR)file_menu, "&File");
@@ -1246,16 +6104,40 @@ static HMENU build_menu(void) {
     append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_DELETE, "&Delete\tDel");
     AppendMenuA(edit_menu, MF_SEPARATOR, 0, NULL);
     append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_SELECT_ALL, "Select &All\tCtrl+A");
+    AppendMenuA(edit_menu, MF_SEPARATOR, 0, NULL);
+    append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_TOGGLE_BOOKMARK, "Toggle &Bookmark\tCtrl+F2");
+    append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_NEXT_BOOKMARK, "Next Bookmar&k\tF2");
+    append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_PREV_BOOKMARK, "Pre&vious Bookmark\tShift+F2");
+    append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_GOTO_MATCH, "Go to &Matching Bracket\tCtrl+]");
+    append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_COMPLETE, "&Complete Word\tCtrl+Space");
+    AppendMenuA(edit_menu, MF_SEPARATOR, 0, NULL);
+    append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_CARET_ABOVE, "Add Caret Abo&ve\tCtrl+Alt+Up");
+    append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_CARET_BELOW, "Add Caret Belo&w\tCtrl+Alt+Down");
+    append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_CARETS_LINE_ENDS, "Carets at &Line Ends\tAlt+Shift+I");
+    AppendMenuA(edit_menu, MF_SEPARATOR, 0, NULL);
+    append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_SORT_LINES, "&Sort Lines");
+    append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_SORT_NUMERIC, "Sort Lines (&Numeric)");
+    append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_SORT_NOCASE, "Sort Lines (&Ignore Case)");
+    append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_UNIQUE_LINES, "Uni&que Lines");
+    append_ownerdraw_item(edit_menu, MF_STRING, ID_EDIT_REVERSE_LINES, "&Reverse Lines");
     append_ownerdraw_item(main_menu, MF_POPUP, (UINT_PTR)edit_menu, "&Edit");
 
     append_ownerdraw_item(view_menu, MF_STRING, ID_VIEW_READ_ONLY, "&Read Only");
     append_ownerdraw_item(view_menu, MF_STRING, ID_VIEW_WORD_WRAP, "&Word Wrap");
     append_ownerdraw_item(view_menu, MF_STRING, ID_VIEW_ALWAYS_ON_TOP, "Always on &Top");
+    AppendMenuA(view_menu, MF_SEPARATOR, 0, NULL);
+    append_ownerdraw_item(view_menu, MF_STRING, ID_VIEW_CSV, "&CSV Columns");
+    append_ownerdraw_item(view_menu, MF_STRING, ID_VIEW_FOLDS, "&Fold View");
+    append_ownerdraw_item(view_menu, MF_STRING, ID_VIEW_LONG_LINE, "&Long Line View");
     append_ownerdraw_item(main_menu, MF_POPUP, (UINT_PTR)view_menu, "&View");
 
     append_ownerdraw_item(format_menu, MF_STRING, ID_FORMAT_FONT, "&Font...\tCtrl+Shift+F");
+    AppendMenuA(format_menu, MF_SEPARATOR, 0, NULL);
+    append_ownerdraw_item(format_menu, MF_STRING, ID_FORMAT_JSON_PRETTY, "JSON &Pretty Print");
+    append_ownerdraw_item(format_menu, MF_STRING, ID_FORMAT_JSON_MINIFY, "JSON &Minify");
     append_ownerdraw_item(main_menu, MF_POPUP, (UINT_PTR)format_menu, "F&ormat");
 
+    append_ownerdraw_item(help_menu, MF_STRING, ID_HELP_MEMORY, "&Memory Usage");
     append_ownerdraw_item(help_menu, MF_STRING, ID_HELP_ABOUT, "&About");
     append_ownerdraw_item(main_menu, MF_POPUP, (UINT_PTR)help_menu, "&Help");
 
@@ -1292,32 +6174,200 @@ static const char *next_cmd_token(const char *p, char *out, size_t out_cap) {
     return p;
 }
 
-static void apply_launch_parameters(const char *cmdline) {
+typedef struct {
+    BOOL read_only;
+    BOOL word_wrap;
+    BOOL always_on_top;
+    BOOL single_instance;
+    DWORD memory_budget_mb;
+    BOOL no_compression;
+    char file[MAX_PATH];
+} LaunchOptions;
+
+static void parse_launch_parameters(const char *cmdline, LaunchOptions *opts) {
     const char *p = cmdline;
     char token[MAX_PATH];
 
+    ZeroMemory(opts, sizeof(*opts));
     while ((p = next_cmd_token(p, token, sizeof(token))) != NULL) {
         if (token[0] == '\0') {
             continue;
         }
 
         if (lstrcmpiA(token, "--read-only") == 0 || lstrcmpiA(token, "-r") == 0) {
-            g_read_only = TRUE;
+            opts->read_only = TRUE;
             continue;
         }
         if (lstrcmpiA(token, "--word-wrap") == 0 || lstrcmpiA(token, "-w") == 0) {
-            g_word_wrap = TRUE;
+            opts->word_wrap = TRUE;
             continue;
         }
         if (lstrcmpiA(token, "--topmost") == 0 || lstrcmpiA(token, "-t") == 0) {
-            g_always_on_top = TRUE;
+            opts->always_on_top = TRUE;
+            continue;
+        }
+        if (lstrcmpiA(token, "--single-instance") == 0 || lstrcmpiA(token, "-s") == 0) {
+            opts->single_instance = TRUE;
             continue;
         }
+        if (lstrcmpiA(token, "--no-compression") == 0) {
+            opts->no_compression = TRUE;
+            continue;
+        }
+        char key[17];
+        lstrcpynA(key, token, (int)sizeof(key));
+        if (lstrcmpiA(key, "--memory-budget=") == 0) {
+            opts->memory_budget_mb = (DWORD)strtoul(token + 16, NULL, 10);
+            continue;
+        }
+
+        if (token[0] != '-' && opts->file[0] == '\0') {
+            lstrcpynA(opts->file, token, MAX_PATH);
+        }
+    }
+}
 
-        if (token[0] != '-' && g_launch_file[0] == '\0') {
-            lstrcpynA(g_launch_file, token, MAX_PATH);
+static void apply_launch_parameters(const char *cmdline) {
+    LaunchOptions opts;
+    parse_launch_parameters(cmdline, &opts);
+
+    if (opts.read_only) g_read_only = TRUE;
+    if (opts.word_wrap) g_word_wrap = TRUE;
+    if (opts.always_on_top) g_always_on_top = TRUE;
+    if (opts.single_instance) g_single_instance = TRUE;
+    if (opts.memory_budget_mb) doc_pager_set_budget((uint64_t)opts.memory_budget_mb << 20);
+    if (opts.no_compression) doc_pager_set_compression(0);
+    if (opts.file[0] && g_launch_file[0] == '\0') {
+        lstrcpynA(g_launch_file, opts.file, MAX_PATH);
+    }
+}
+
+static void instance_channel_name(char *out, size_t out_cap) {
+    DWORD session = 0;
+    ProcessIdToSessionId(GetCurrentProcessId(), &session);
+    snprintf(out, out_cap, "TinyCEditor-%lu", (unsigned long)session);
+}
+
+// Relative paths are relative to the launching process, not to us.
+static void resolve_launch_path(const char *cwd, const char *file, char *out, DWORD out_cap) {
+    char joined[MAX_PATH * 2];
+    BOOL absolute = file[0] == '\\' || file[0] == '/' || (file[0] != '\0' && file[1] == ':');
+
+    if (absolute || !cwd || cwd[0] == '\0') {
+        lstrcpynA(joined, file, (int)sizeof(joined));
+    } else {
+        snprintf(joined, sizeof(joined), "%s\\%s", cwd, file);
+    }
+    DWORD n = GetFullPathNameA(joined, out_cap, out, NULL);
+    if (n == 0 || n >= out_cap) {
+        lstrcpynA(out, joined, (int)out_cap);
+    }
+}
+
+// Runs on the IPC thread: copy the request and let the UI thread apply it.
+static void on_instance_request(void *ctx, const char *cwd, const char *cmdline) {
+    size_t cwd_len = strlen(cwd);
+    size_t cmd_len = strlen(cmdline);
+    char *request = (char *)malloc(cwd_len + cmd_len + 2u);
+    if (!request) return;
+    memcpy(request, cwd, cwd_len + 1u);
+    memcpy(request + cwd_len + 1u, cmdline, cmd_len + 1u);
+    if (!PostMessageA((HWND)ctx, WM_APP_REMOTE_LAUNCH, 0, (LPARAM)request)) {
+        free(request);
+    }
+}
+
+static void apply_remote_launch(HWND hwnd, const char *cwd, const char *cmdline) {
+    LaunchOptions opts;
+    parse_launch_parameters(cmdline, &opts);
+    log_message("single-instance: request cwd=%s cmd=%s", cwd, cmdline);
+
+    if (opts.read_only && !g_read_only) SendMessageA(hwnd, WM_COMMAND, ID_VIEW_READ_ONLY, 0);
+    if (opts.word_wrap && !g_word_wrap) set_wrap_mode(hwnd, TRUE, FALSE);
+    if (opts.always_on_top && !g_always_on_top) SendMessageA(hwnd, WM_COMMAND, ID_VIEW_ALWAYS_ON_TOP, 0);
+    if (opts.memory_budget_mb) doc_pager_set_budget((uint64_t)opts.memory_budget_mb << 20);
+    if (opts.file[0]) {
+        char path[MAX_PATH];
+        resolve_launch_path(cwd, opts.file, path, MAX_PATH);
+        if (confirm_hex_patches(hwnd) && !load_file_into_editor(hwnd, path)) {
+            MessageBoxA(hwnd, "Could not open file passed via launch parameters.", "Open Error", MB_OK | MB_ICONERROR);
         }
     }
+
+    if (IsIconic(hwnd)) {
+        ShowWindow(hwnd, SW_RESTORE);
+    }
+    SetForegroundWindow(hwnd);
+}
+
+// Work that the first frame does not need runs from WM_APP_STARTUP_TASK, one
+// task per message, so input and paint stay responsive in between.
+static void startup_open_launch_file(void *arg) {
+    HWND hwnd = (HWND)arg;
+    if (!load_file_into_editor(hwnd, g_launch_file)) {
+        MessageBoxA(hwnd, "Could not open file passed via launch parameters.", "Open Error", MB_OK | MB_ICONERROR);
+    }
+    startup_mark("file ready");
+}
+
+static void startup_init_renderer(void *arg) {
+    HWND hwnd = (HWND)arg;
+    if (!d2d_ensure_factory()) {
+        start_render_thread(hwnd);
+    }
+    g_renderer_ready = TRUE;
+    InvalidateRect(hwnd, NULL, FALSE);
+}
+
+static void startup_load_icons(void *arg) {
+    HWND hwnd = (HWND)arg;
+    HICON big_icon = NULL;
+    HICON small_icon = NULL;
+    load_icons_from_exe(&big_icon, &small_icon);
+    if (big_icon) {
+        SendMessageA(hwnd, WM_SETICON, ICON_BIG, (LPARAM)big_icon);
+    }
+    if (small_icon) {
+        SendMessageA(hwnd, WM_SETICON, ICON_SMALL, (LPARAM)small_icon);
+    }
+}
+
+static void startup_prepare_menus(void *arg) {
+    (void)arg;
+    enable_dark_menus();
+    premeasure_menu_labels();
+}
+
+static void queue_startup_tasks(HWND hwnd) {
+    if (!g_startup_tasks_ready) {
+        startup_init_renderer(hwnd);
+        startup_load_icons(hwnd);
+        startup_prepare_menus(NULL);
+        if (g_launch_file[0]) startup_open_launch_file(hwnd);
+        return;
+    }
+    if (g_launch_file[0]) {
+        task_queue_push(&g_startup_tasks, "open launch file", startup_open_launch_file, hwnd);
+    }
+    task_queue_push(&g_startup_tasks, "renderer", startup_init_renderer, hwnd);
+    task_queue_push(&g_startup_tasks, "icons", startup_load_icons, hwnd);
+    task_queue_push(&g_startup_tasks, "menus", startup_prepare_menus, NULL);
+}
+
+static void run_startup_task(HWND hwnd) {
+    const char *name = NULL;
+    uint64_t elapsed_us = 0;
+
+    if (!g_startup_tasks_ready) return;
+    if (task_queue_run_next(&g_startup_tasks, &name, &elapsed_us)) {
+        log_message("startup: deferred %s took %.1f ms", name, (double)elapsed_us / 1000.0);
+    }
+    if (task_queue_pending(&g_startup_tasks) > 0) {
+        PostMessageA(hwnd, WM_APP_STARTUP_TASK, 0, 0);
+    } else if (!g_startup_done) {
+        g_startup_done = TRUE;
+        startup_mark("deferred work done");
+    }
 }
 
 static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) {
@@ -1347,14 +6397,7 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
             create_editor_control(hwnd, ((LPCREATESTRUCTA)lparam)->hInstance, "");
             update_window_title(hwnd);
             apply_dark_title_bar(hwnd);
-            if (!d2d_ensure_factory()) {
-                start_render_thread(hwnd);
-            }
-            if (g_launch_file[0]) {
-                if (!load_file_into_editor(hwnd, g_launch_file)) {
-                    MessageBoxA(hwnd, "Could not open file passed via launch parameters.", "Open Error", MB_OK | MB_ICONERROR);
-                }
-            }
+            queue_startup_tasks(hwnd);
             if (g_always_on_top) {
                 SetWindowPos(
                     hwnd,
@@ -1387,10 +6430,15 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
             return 0;
 
         case WM_SIZE:
+            close_completion();
             apply_skin_layout(hwnd);
             d2d_resize(hwnd);
             return 0;
 
+        case WM_MOVE:
+            close_completion();
+            break;
+
         case WM_GETMINMAXINFO: {
             MINMAXINFO *mmi = (MINMAXINFO *)lparam;
             mmi->ptMinTrackSize.x = WINDOW_MIN_W;
@@ -1424,6 +6472,21 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
             width = rc.right - rc.left;
             height = rc.bottom - rc.top;
 
+            if (!g_renderer_ready) {
+                // Until the deferred renderer task runs, paint directly with GDI.
+                render_chrome(hdc, width, height, path);
+                EndPaint(hwnd, &ps);
+                if (!g_first_paint_done) {
+                    double ms = startup_elapsed_ms();
+                    g_first_paint_done = TRUE;
+                    log_message(
+                        "startup: first paint at %.1f ms%s",
+                        ms, ms > STARTUP_FIRST_PAINT_TARGET_MS ? " (over target)" : ""
+                    );
+                }
+                return 0;
+            }
+
             if (d2d_draw_chrome(hwnd)) {
                 draw_header_text(hdc, width, get_skin_header_h(hwnd), path);
                 EndPaint(hwnd, &ps);
@@ -1460,9 +6523,103 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
             InvalidateRect(hwnd, NULL, FALSE);
             return 0;
 
+        case WM_APP_STARTUP_TASK:
+            run_startup_task(hwnd);
+            return 0;
+
+        case WM_RENDERFORMAT:
+            if (wparam == CF_TEXT && g_clip_snapshot) {
+                HGLOBAL mem = render_clip_snapshot();
+                if (mem) SetClipboardData(CF_TEXT, mem);
+            }
+            return 0;
+
+        case WM_RENDERALLFORMATS:
+            // Leave real data behind when we exit while still owning the clipboard.
+            if (g_clip_snapshot && OpenClipboard(hwnd)) {
+                if (GetClipboardOwner() == hwnd) {
+                    HGLOBAL mem = render_clip_snapshot();
+                    if (mem) SetClipboardData(CF_TEXT, mem);
+                }
+                CloseClipboard();
+            }
+            return 0;
+
+        case WM_DESTROYCLIPBOARD:
+            release_clip_snapshot();
+            return 0;
+
+        case WM_APP_PASTE_PROGRESS:
+            if (g_paste && g_paste->id == (UINT)wparam) {
+                g_paste_percent = (unsigned)lparam;
+                update_window_title(hwnd);
+            }
+            return 0;
+
+        case WM_APP_PASTE_DONE:
+            finish_streaming_paste(hwnd, (UINT)wparam);
+            return 0;
+
+        case WM_APP_GZIP_PROGRESS:
+            if (g_gzip_open && g_gzip_open->id == (UINT)wparam) {
+                g_gzip_percent = (unsigned)lparam;
+                update_window_title(hwnd);
+            }
+            return 0;
+
+        case WM_APP_GZIP_DONE:
+            finish_gzip_open(hwnd, (UINT)wparam);
+            return 0;
+
+        case WM_APP_JSON_PROGRESS:
+            if (g_json_format && g_json_format->id == (UINT)wparam) {
+                g_json_percent = (unsigned)lparam;
+                update_window_title(hwnd);
+            }
+            return 0;
+
+        case WM_APP_JSON_DONE:
+            finish_json_format(hwnd, (UINT)wparam);
+            return 0;
+
+        case WM_APP_CSV_PROGRESS:
+            if (g_csv && g_csv->id == (UINT)wparam) {
+                g_csv_percent = (unsigned)lparam;
+                csv_refresh_widths(FALSE);
+                csv_update_scrollbars();
+                InvalidateRect(g_csv_view, NULL, FALSE);
+                update_window_title(hwnd);
+            }
+            return 0;
+
+        case WM_APP_CSV_DONE:
+            finish_csv_index(hwnd, (UINT)wparam);
+            return 0;
+
+        case WM_APP_WORDS_PROGRESS:
+            if (g_words_job && g_words_job->id == (UINT)wparam) {
+                g_words_percent = (unsigned)lparam;
+                update_window_title(hwnd);
+            }
+            return 0;
+
+        case WM_APP_WORDS_DONE:
+            finish_word_index(hwnd, (UINT)wparam);
+            return 0;
+
+        case WM_APP_REMOTE_LAUNCH: {
+            char *request = (char *)lparam;
+            apply_remote_launch(hwnd, request, request + strlen(request) + 1);
+            free(request);
+            return 0;
+        }
+
         case WM_SETTINGCHANGE:
+            release_menu_font();
+            premeasure_menu_labels();
             enable_dark_menus();
             if (GetMenu(hwnd)) {
+                remeasure_menu_items(GetMenu(hwnd));
                 apply_menu_background_recursive(GetMenu(hwnd));
             }
             DrawMenuBar(hwnd);
@@ -1476,39 +6633,25 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
             }
             BOOL is_menu_bar_item = ((HMENU)(UINT_PTR)mis->CtlID == GetMenu(hwnd));
 
-            const char *text = (const char *)mis->itemData;
-            if (!text) {
+            const MenuLabel *label = (const MenuLabel *)mis->itemData;
+            if (!label) {
                 mis->itemWidth = 0;
                 mis->itemHeight = 8;
                 return TRUE;
             }
 
-            char left[256];
-            char right[128];
-            char left_draw[256];
-            char right_draw[128];
-            split_menu_text(text, left, sizeof(left), right, sizeof(right));
-            normalize_menu_label(left, left_draw, sizeof(left_draw));
-            normalize_menu_label(right, right_draw, sizeof(right_draw));
-
-            HDC hdc = GetDC(hwnd);
-            ensure_menu_font();
-            HFONT old_font = (HFONT)SelectObject(hdc, g_menu_font);
-            SIZE sz_left = {0};
+            SIZE sz_left = measure_menu_text(label->left);
             SIZE sz_right = {0};
-            GetTextExtentPoint32A(hdc, left_draw, lstrlenA(left_draw), &sz_left);
-            if (right_draw[0]) {
-                GetTextExtentPoint32A(hdc, right_draw, lstrlenA(right_draw), &sz_right);
+            if (label->right[0]) {
+                sz_right = measure_menu_text(label->right);
             }
-            SelectObject(hdc, old_font);
-            ReleaseDC(hwnd, hdc);
 
             mis->itemHeight = (UINT)((sz_left.cy + 8) < 24 ? 24 : (sz_left.cy + 8));
             if (is_menu_bar_item) {
                 mis->itemWidth = (UINT)(sz_left.cx + 18);
             } else {
                 UINT width = (UINT)(sz_left.cx + 40);
-                if (right_draw[0]) {
+                if (label->right[0]) {
                     width += (UINT)(sz_right.cx + 24);
                 }
                 mis->itemWidth = width;
@@ -1523,16 +6666,8 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
             }
             BOOL is_menu_bar_item = ((HMENU)dis->hwndItem == GetMenu(hwnd));
 
-            const char *text = (const char *)dis->itemData;
-            if (!text) return TRUE;
-
-            char left[256];
-            char right[128];
-            char left_draw[256];
-            char right_draw[128];
-            split_menu_text(text, left, sizeof(left), right, sizeof(right));
-            normalize_menu_label(left, left_draw, sizeof(left_draw));
-            normalize_menu_label(right, right_draw, sizeof(right_draw));
+            const MenuLabel *label = (const MenuLabel *)dis->itemData;
+            if (!label) return TRUE;
 
             BOOL selected = (dis->itemState & ODS_SELECTED) != 0;
             BOOL disabled = (dis->itemState & ODS_DISABLED) != 0;
@@ -1556,12 +6691,11 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
             }
 
             int text_x = is_menu_bar_item ? (rc.left + 8) : (rc.left + 28);
-            TextOutA(dis->hDC, text_x, rc.top + 4, left_draw, lstrlenA(left_draw));
+            TextOutA(dis->hDC, text_x, rc.top + 4, label->left, lstrlenA(label->left));
 
-            if (right_draw[0] && !is_menu_bar_item) {
-                SIZE sz_right = {0};
-                GetTextExtentPoint32A(dis->hDC, right_draw, lstrlenA(right_draw), &sz_right);
-                TextOutA(dis->hDC, rc.right - sz_right.cx - 12, rc.top + 4, right_draw, lstrlenA(right_draw));
+            if (label->right[0] && !is_menu_bar_item) {
+                SIZE sz_right = measure_text_cached(dis->hDC, g_menu_font, label->right);
+                TextOutA(dis->hDC, rc.right - sz_right.cx - 12, rc.top + 4, label->right, lstrlenA(label->right));
             }
 
             SelectObject(dis->hDC, old_font);
@@ -1571,7 +6705,23 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
         case WM_COMMAND:
             switch (LOWORD(wparam)) {
                 case ID_FILE_NEW:
+                    if (!confirm_hex_patches(hwnd)) return 0;
+                    leave_hex_view();
+                    abort_streaming_paste(hwnd);
+                    abort_gzip_open(hwnd);
+                    drop_gzip_parts(hwnd);
+                    abort_json_format(hwnd);
+                    leave_csv_view(hwnd);
+                    leave_fold_view(hwnd);
+                    leave_long_line_view(hwnd);
+                    stop_journal();
                     SetWindowTextA(g_edit, "");
+                    g_text_format.encoding = TEXT_ENC_RAW;
+                    g_text_format.eol = TEXT_EOL_CRLF;
+                    g_mixed_eol = FALSE;
+                    g_gzip_source = FALSE;
+                    g_gzip_save_ok = FALSE;
+                    end_document_wrap(hwnd);
                     g_current_file[0] = '\0';
                     update_window_title(hwnd);
                     InvalidateRect(hwnd, NULL, FALSE);
@@ -1581,17 +6731,27 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
                     InvalidateRect(hwnd, NULL, FALSE);
                     return 0;
                 case ID_FILE_SAVE:
+                    if (g_hex) {
+                        save_hex_patches(hwnd);
+                        return 0;
+                    }
                     save_to_output_txt(hwnd);
                     InvalidateRect(hwnd, NULL, FALSE);
                     return 0;
                 case ID_FILE_INFO:
                     show_file_info_prompt(hwnd);
                     return 0;
+                case ID_FILE_NEXT_PART:
+                    move_gzip_part(hwnd, TRUE);
+                    return 0;
+                case ID_FILE_PREV_PART:
+                    move_gzip_part(hwnd, FALSE);
+                    return 0;
                 case ID_FILE_EXIT:
                     PostMessage(hwnd, WM_CLOSE, 0, 0);
                     return 0;
                 case ID_EDIT_UNDO:
-                    if (SendMessageA(g_edit, EM_CANUNDO, 0, 0)) {
+                    if (!g_csv && SendMessageA(g_edit, EM_CANUNDO, 0, 0)) {
                         SendMessageA(g_edit, WM_UNDO, 0, 0);
                     }
                     return 0;
@@ -1610,10 +6770,49 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
                 case ID_EDIT_SELECT_ALL:
                     SendMessageA(g_edit, EM_SETSEL, 0, -1);
                     return 0;
+                case ID_EDIT_SORT_LINES:
+                    run_line_operation(hwnd, LINE_SORT_LEXICAL, FALSE, FALSE, "Sort Lines");
+                    return 0;
+                case ID_EDIT_SORT_NUMERIC:
+                    run_line_operation(hwnd, LINE_SORT_NUMERIC, FALSE, FALSE, "Sort Lines (Numeric)");
+                    return 0;
+                case ID_EDIT_SORT_NOCASE:
+                    run_line_operation(hwnd, LINE_SORT_NOCASE, FALSE, FALSE, "Sort Lines (Ignore Case)");
+                    return 0;
+                case ID_EDIT_UNIQUE_LINES:
+                    run_line_operation(hwnd, LINE_SORT_NONE, TRUE, FALSE, "Unique Lines");
+                    return 0;
+                case ID_EDIT_REVERSE_LINES:
+                    run_line_operation(hwnd, LINE_SORT_NONE, FALSE, TRUE, "Reverse Lines");
+                    return 0;
+                case ID_EDIT_TOGGLE_BOOKMARK:
+                    toggle_bookmark();
+                    return 0;
+                case ID_EDIT_NEXT_BOOKMARK:
+                    goto_bookmark(TRUE);
+                    return 0;
+                case ID_EDIT_PREV_BOOKMARK:
+                    goto_bookmark(FALSE);
+                    return 0;
+                case ID_EDIT_GOTO_MATCH:
+                    goto_matching_bracket();
+                    return 0;
+                case ID_EDIT_COMPLETE:
+                    complete_word(hwnd);
+                    return 0;
+                case ID_EDIT_CARET_ABOVE:
+                    multi_caret_command(g_edit, MULTI_ADD_ABOVE, 0, 0);
+                    return 0;
+                case ID_EDIT_CARET_BELOW:
+                    multi_caret_command(g_edit, MULTI_ADD_BELOW, 0, 0);
+                    return 0;
+                case ID_EDIT_CARETS_LINE_ENDS:
+                    multi_caret_command(g_edit, MULTI_LINE_ENDS, 0, 0);
+                    return 0;
                 case ID_VIEW_READ_ONLY: {
                     HMENU menu = GetMenu(hwnd);
                     g_read_only = !g_read_only;
-                    SendMessageA(g_edit, EM_SETREADONLY, g_read_only, 0);
+                    SendMessageA(g_edit, EM_SETREADONLY, g_read_only || g_paste || g_gzip_open || g_json_format || g_csv || g_fold_view || g_long_view, 0);
                     CheckMenuItem(
                         menu,
                         ID_VIEW_READ_ONLY,
@@ -1637,17 +6836,38 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
                     );
                     return 0;
                 }
-                case ID_VIEW_WORD_WRAP: {
-                    HMENU menu = GetMenu(hwnd);
-                    g_word_wrap = !g_word_wrap;
-                    CheckMenuItem(
-                        menu,
-                        ID_VIEW_WORD_WRAP,
-                        MF_BYCOMMAND | (g_word_wrap ? MF_CHECKED : MF_UNCHECKED)
-                    );
-                    recreate_editor_control(hwnd);
+                case ID_VIEW_WORD_WRAP:
+                    // Unchecking a wrap forced by a long line only lifts it for this document.
+                    if (g_doc_wrap) {
+                        set_wrap_mode(hwnd, g_word_wrap, FALSE);
+                    } else {
+                        set_wrap_mode(hwnd, !g_word_wrap, FALSE);
+                    }
+                    return 0;
+                case ID_VIEW_CSV:
+                    if (g_csv) {
+                        leave_csv_view(hwnd);
+                    } else {
+                        enter_csv_view(hwnd);
+                    }
+                    return 0;
+                case ID_VIEW_FOLDS:
+                    if (g_fold_view) {
+                        leave_fold_view(hwnd);
+                    } else {
+                        enter_fold_view(hwnd);
+                    }
+                    return 0;
+                case ID_VIEW_LONG_LINE:
+                    if (g_long_view) {
+                        leave_long_line_view(hwnd);
+                    } else {
+                        enter_long_line_view(hwnd);
+                    }
+                    return 0;
+                case ID_HELP_MEMORY:
+                    show_memory_usage(hwnd);
                     return 0;
-                }
                 case ID_HELP_ABOUT:
                     show_skinned_info_box(
                         hwnd,
@@ -1658,12 +6878,43 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
                 case ID_FORMAT_FONT:
                     choose_editor_font(hwnd);
                     return 0;
+                case ID_FORMAT_JSON_PRETTY:
+                    start_json_format(hwnd, JSON_PRETTY);
+                    return 0;
+                case ID_FORMAT_JSON_MINIFY:
+                    start_json_format(hwnd, JSON_MINIFY);
+                    return 0;
+                case ID_EDIT:
+                    if (HIWORD(wparam) == EN_CHANGE) follow_uncaptured_change((HWND)lparam);
+                    break;
                 default:
                     break;
             }
             break;
 
+        case WM_CLOSE:
+            if (!confirm_hex_patches(hwnd)) return 0;
+            break;
+
         case WM_DESTROY:
+            abort_streaming_paste(hwnd);
+            abort_gzip_open(hwnd);
+            drop_gzip_parts(hwnd);
+            abort_json_format(hwnd);
+            leave_csv_view(hwnd);
+            leave_fold_view(hwnd);
+            leave_long_line_view(hwnd);
+            release_clip_snapshot();
+            drop_doc_mirror();
+            drop_struct_index();
+            marker_tree_free(&g_markers);
+            multi_edit_free(&g_multi);
+            leave_hex_view();
+            if (g_instance_server) {
+                instance_server_stop(g_instance_server);
+                g_instance_server = NULL;
+            }
+            stop_journal();
             stop_render_thread();
             d2d_release_target();
             if (g_d2d_factory) {
@@ -1671,6 +6922,7 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
                 g_d2d_factory = NULL;
             }
             if (g_font) {
+                forget_font_metrics(g_font);
                 DeleteObject(g_font);
                 g_font = NULL;
             }
@@ -1703,14 +6955,12 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
                 g_menu_hot_brush = NULL;
             }
             if (g_header_font) {
+                forget_font_metrics(g_header_font);
                 DeleteObject(g_header_font);
                 g_header_font = NULL;
             }
-            if (g_menu_font && g_menu_font != GetStockObject(DEFAULT_GUI_FONT)) {
-                DeleteObject(g_menu_font);
-            }
-            g_menu_font = NULL;
-            free_menu_texts();
+            release_menu_font();
+            free_menu_labels();
             PostQuitMessage(0);
             return 0;
 
@@ -1721,22 +6971,93 @@ static LRESULT CALLBACK wndproc(HWND hwnd, UINT msg, WPARAM wparam, LPARAM lpara
     return DefWindowProcA(hwnd, msg, wparam, lparam);
 }
 
+static int split_cmdline(const char *cmdline, char ***out_argv) {
+    const char *p = cmdline;
+    char token[MAX_PATH * 4];
+    char **argv = NULL;
+    int argc = 0;
+    int cap = 0;
+
+    while ((p = next_cmd_token(p, token, sizeof(token))) != NULL) {
+        size_t len = strlen(token);
+        if (len == 0) continue;
+        if (argc == cap) {
+            int new_cap = cap ? cap * 2 : 8;
+            char **grown = (char **)realloc(argv, (size_t)new_cap * sizeof(char *));
+            if (!grown) break;
+            argv = grown;
+            cap = new_cap;
+        }
+        argv[argc] = (char *)malloc(len + 1u);
+        if (!argv[argc]) break;
+        memcpy(argv[argc], token, len + 1u);
+        argc++;
+    }
+    *out_argv = argv;
+    return argc;
+}
+
+static void free_cmdline_args(int argc, char **argv) {
+    for (int i = 0; i < argc; i++) {
+        free(argv[i]);
+    }
+    free(argv);
+}
+
+// Batch flags run the engines headlessly and never create a window. Output
+// goes to redirected handles when there are any, else to the parent console.
+static int run_batch_command(int argc, char **argv) {
+    HANDLE std_out = GetStdHandle(STD_OUTPUT_HANDLE);
+    if ((std_out == NULL || std_out == INVALID_HANDLE_VALUE) && AttachConsole(ATTACH_PARENT_PROCESS)) {
+        freopen("CONOUT$", "w", stdout);
+        freopen("CONOUT$", "w", stderr);
+    }
+
+    uint64_t start = sys_now_us();
+    int rc = batch_main(argc, argv, stdout, stderr);
+    fflush(stdout);
+    fflush(stderr);
+    log_message("batch: exit code=%d in %.1f ms", rc, (double)(sys_now_us() - start) / 1000.0);
+    return rc;
+}
+
 int WINAPI WinMain(HINSTANCE instance, HINSTANCE prev, LPSTR cmd, int show) {
     (void)prev;
+    init_startup_clock();
     init_logging();
     log_message("WinMain start cmd=%s", cmd ? cmd : "");
 
-    HICON app_icon = NULL;
-    HICON small_icon = NULL;
-    load_icons_from_exe(&app_icon, &small_icon);
-    if (!app_icon) {
-        app_icon = LoadIconA(NULL, IDI_APPLICATION);
-    }
-    if (!small_icon) {
-        small_icon = app_icon;
+    char **batch_argv = NULL;
+    int batch_argc = split_cmdline(cmd ? cmd : "", &batch_argv);
+    if (batch_is_command(batch_argc, batch_argv)) {
+        int rc = run_batch_command(batch_argc, batch_argv);
+        free_cmdline_args(batch_argc, batch_argv);
+        close_logging();
+        return rc;
     }
+    free_cmdline_args(batch_argc, batch_argv);
     apply_launch_parameters(cmd);
 
+    char instance_channel[64];
+    instance_channel_name(instance_channel, sizeof(instance_channel));
+    if (g_single_instance) {
+        char cwd[MAX_PATH] = "";
+        GetCurrentDirectoryA(MAX_PATH, cwd);
+        // The running instance may raise its window once we hand over.
+        AllowSetForegroundWindow(ASFW_ANY);
+        if (instance_send(instance_channel, cwd, cmd ? cmd : "", INSTANCE_SEND_TIMEOUT_MS)) {
+            startup_mark("handed launch to running instance");
+            close_logging();
+            return 0;
+        }
+    }
+    init_text_metrics();
+    g_startup_tasks_ready = task_queue_init(&g_startup_tasks) ? TRUE : FALSE;
+
+    // The exe's own icons are extracted after the first paint.
+    HICON app_icon = LoadIconA(NULL, IDI_APPLICATION);
+    HICON small_icon = app_icon;
+
     const char *class_name = "TinyCEditorWindow";
     WNDCLASSEXA wc = {0};
     wc.cbSize = sizeof(wc);
@@ -1753,8 +7074,11 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE prev, LPSTR cmd, int show) {
         return 1;
     }
     register_info_box_class(instance);
-
-    enable_dark_menus();
+    register_hex_view_class(instance);
+    register_csv_view_class(instance);
+    register_fold_view_class(instance);
+    register_long_line_view_class(instance);
+    register_completion_class(instance);
 
     HWND hwnd = CreateWindowExA(
         0,
@@ -1773,23 +7097,43 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE prev, LPSTR cmd, int show) {
         return 1;
     }
     log_message("CreateWindowExA success hwnd=%p", (void *)hwnd);
+    startup_mark("window created");
+    if (g_single_instance) {
+        g_instance_server = instance_server_start(instance_channel, on_instance_request, hwnd);
+        if (!g_instance_server) {
+            log_message("single-instance: could not claim channel %s", instance_channel);
+        }
+    }
 
     ACCEL accels[] = {
         {FVIRTKEY | FCONTROL, 'N', ID_FILE_NEW},
         {FVIRTKEY | FCONTROL, 'O', ID_FILE_OPEN},
         {FVIRTKEY | FCONTROL, 'S', ID_FILE_SAVE},
         {FVIRTKEY | FCONTROL, 'Q', ID_FILE_EXIT},
+        {FVIRTKEY | FALT, VK_NEXT, ID_FILE_NEXT_PART},
+        {FVIRTKEY | FALT, VK_PRIOR, ID_FILE_PREV_PART},
         {FVIRTKEY | FCONTROL, 'Z', ID_EDIT_UNDO},
         {FVIRTKEY | FCONTROL, 'X', ID_EDIT_CUT},
         {FVIRTKEY | FCONTROL, 'C', ID_EDIT_COPY},
         {FVIRTKEY | FCONTROL, 'V', ID_EDIT_PASTE},
         {FVIRTKEY | FCONTROL, 'A', ID_EDIT_SELECT_ALL},
+        {FVIRTKEY | FCONTROL, VK_F2, ID_EDIT_TOGGLE_BOOKMARK},
+        {FVIRTKEY, VK_F2, ID_EDIT_NEXT_BOOKMARK},
+        {FVIRTKEY | FSHIFT, VK_F2, ID_EDIT_PREV_BOOKMARK},
+        {FVIRTKEY | FCONTROL, VK_OEM_6, ID_EDIT_GOTO_MATCH},
+        {FVIRTKEY | FCONTROL, VK_SPACE, ID_EDIT_COMPLETE},
+        {FVIRTKEY | FCONTROL | FALT, VK_UP, ID_EDIT_CARET_ABOVE},
+        {FVIRTKEY | FCONTROL | FALT, VK_DOWN, ID_EDIT_CARET_BELOW},
+        {FVIRTKEY | FALT | FSHIFT, 'I', ID_EDIT_CARETS_LINE_ENDS},
         {FVIRTKEY | FCONTROL | FSHIFT, 'F', ID_FORMAT_FONT}
     };
     HACCEL accel_table = CreateAcceleratorTableA(accels, (int)(sizeof(accels) / sizeof(accels[0])));
 
     ShowWindow(hwnd, show);
     UpdateWindow(hwnd);
+    if (g_startup_tasks_ready) {
+        PostMessageA(hwnd, WM_APP_STARTUP_TASK, 0, 0);
+    }
 
     MSG msg;
     while (GetMessageA(&msg, NULL, 0, 0) > 0) {
@@ -1803,6 +7147,11 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE prev, LPSTR cmd, int show) {
         DestroyAcceleratorTable(accel_table);
     }
 
+    if (g_startup_tasks_ready) {
+        task_queue_free(&g_startup_tasks);
+        g_startup_tasks_ready = FALSE;
+    }
+    free_text_metrics();
     log_message("WinMain exit code=%ld", (long)msg.wParam);
     close_logging();
     return (int)msg.wParam;
@@ -0,0 +1,276 @@
+// Line-ending detection and conversion kernels (SSE2 with a scalar fallback)
+
+#include "eol.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EOL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#define EOL_BLOCK 16u
+
+static unsigned count_bits(unsigned m) {
+    m = m - ((m >> 1) & 0x55555555u);
+    m = (m & 0x33333333u) + ((m >> 2) & 0x33333333u);
+    m = (m + (m >> 4)) & 0x0F0F0F0Fu;
+    return (m * 0x01010101u) >> 24;
+}
+
+static unsigned lowest_bit(unsigned m) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctz(m);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, m);
+    return (unsigned)index;
+#else
+    unsigned n = 0;
+    while (!(m & 1u)) {
+        m >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// Bit i set when src[i] is `a` (and, in `mask_b`, when it is `b`).
+static void block_masks(const char *src, char a, char b, unsigned *mask_a, unsigned *mask_b) {
+#ifdef EOL_SSE2
+    __m128i v = _mm_loadu_si128((const __m128i *)src);
+    *mask_a = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(a)));
+    *mask_b = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(b)));
+#else
+    unsigned ma = 0;
+    unsigned mb = 0;
+    for (unsigned i = 0; i < EOL_BLOCK; i++) {
+        if (src[i] == a) ma |= 1u << i;
+        if (src[i] == b) mb |= 1u << i;
+    }
+    *mask_a = ma;
+    *mask_b = mb;
+#endif
+}
+
+static void copy_block(char *dst, const char *src) {
+#ifdef EOL_SSE2
+    _mm_storeu_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+#else
+    memcpy(dst, src, EOL_BLOCK);
+#endif
+}
+
+void eol_scan_init(EolScan *scan) {
+    if (scan) memset(scan, 0, sizeof(*scan));
+}
+
+void eol_scan_update(EolScan *scan, const char *text, size_t len) {
+    size_t i = 0;
+    if (!scan || !text) return;
+
+    while (i + EOL_BLOCK <= len) {
+        unsigned cr;
+        unsigned lf;
+        block_masks(text + i, '\r', '\n', &cr, &lf);
+        if (cr | lf) {
+            scan->cr += count_bits(cr);
+            scan->lf += count_bits(lf);
+            scan->crlf += count_bits(cr & (lf >> 1));
+            if (scan->last_was_cr && (lf & 1u)) scan->crlf++;
+        }
+        scan->last_was_cr = (cr >> (EOL_BLOCK - 1u)) & 1u;
+        i += EOL_BLOCK;
+    }
+    for (; i < len; i++) {
+        char c = text[i];
+        if (c == '\n') {
+            scan->lf++;
+            if (scan->last_was_cr) scan->crlf++;
+        } else if (c == '\r') {
+            scan->cr++;
+        }
+        scan->last_was_cr = (c == '\r');
+    }
+}
+
+uint64_t eol_scan_crlf(const EolScan *scan) {
+    return scan ? scan->crlf : 0;
+}
+
+uint64_t eol_scan_lone_lf(const EolScan *scan) {
+    return scan ? scan->lf - scan->crlf : 0;
+}
+
+uint64_t eol_scan_lone_cr(const EolScan *scan) {
+    return scan ? scan->cr - scan->crlf : 0;
+}
+
+TextEol eol_scan_dominant(const EolScan *scan) {
+    uint64_t crlf = eol_scan_crlf(scan);
+    uint64_t lf = eol_scan_lone_lf(scan);
+    uint64_t cr = eol_scan_lone_cr(scan);
+
+    if (lf > crlf && lf >= cr) return TEXT_EOL_LF;
+    if (cr > crlf && cr > lf) return TEXT_EOL_CR;
+    return TEXT_EOL_CRLF;
+}
+
+int eol_scan_is_mixed(const EolScan *scan) {
+    int styles = (eol_scan_crlf(scan) > 0) + (eol_scan_lone_lf(scan) > 0) + (eol_scan_lone_cr(scan) > 0);
+    return styles > 1;
+}
+
+uint64_t eol_scan_crlf_size(const EolScan *scan, uint64_t len) {
+    return len + eol_scan_lone_lf(scan) + eol_scan_lone_cr(scan);
+}
+
+size_t eol_to_crlf(const char *src, size_t len, char *dst, int *after_cr) {
+    size_t i = 0;
+    size_t o = 0;
+    int skip_lf = *after_cr;
+
+    while (i < len) {
+        size_t base = i;
+        size_t end;
+        unsigned cr;
+        unsigned lf;
+        unsigned m;
+
+        if (i + EOL_BLOCK <= len) {
+            block_masks(src + i, '\r', '\n', &cr, &lf);
+            m = cr | lf;
+            if (m == 0) {
+                copy_block(dst + o, src + i);
+                o += EOL_BLOCK;
+                i += EOL_BLOCK;
+                skip_lf = 0;
+                continue;
+            }
+            end = base + EOL_BLOCK;
+        } else {
+            m = 0;
+            for (size_t k = i; k < len; k++) {
+                if (src[k] == '\r' || src[k] == '\n') m |= 1u << (k - base);
+            }
+            end = len;
+        }
+
+        while (m) {
+            size_t at = base + lowest_bit(m);
+            size_t run = at - i;
+            m &= m - 1u;
+            if (run > 0) {
+                memcpy(dst + o, src + i, run);
+                o += run;
+                skip_lf = 0;
+            }
+            if (src[at] == '\r') {
+                dst[o++] = '\r';
+                dst[o++] = '\n';
+                skip_lf = 1;
+            } else {
+                if (!skip_lf) {
+                    dst[o++] = '\r';
+                    dst[o++] = '\n';
+                }
+                skip_lf = 0;
+            }
+            i = at + 1u;
+        }
+        if (i < end) {
+            memcpy(dst + o, src + i, end - i);
+            o += end - i;
+            skip_lf = 0;
+            i = end;
+        }
+    }
+    *after_cr = skip_lf;
+    return o;
+}
+
+size_t eol_from_crlf(const char *src, size_t len, char *dst, TextEol target, int *pending_cr) {
+    char eol_char = (target == TEXT_EOL_CR) ? '\r' : '\n';
+    size_t i = 0;
+    size_t o = 0;
+
+    if (len == 0) return 0;
+    if (*pending_cr) {
+        *pending_cr = 0;
+        if (src[0] == '\n') {
+            dst[o++] = eol_char;
+            i = 1;
+        } else {
+            dst[o++] = '\r';
+        }
+    }
+
+    while (i < len) {
+        size_t base = i;
+        size_t end;
+        unsigned cr;
+        unsigned lf;
+
+        if (i + EOL_BLOCK <= len) {
+            block_masks(src + i, '\r', '\n', &cr, &lf);
+            if (cr == 0) {
+                copy_block(dst + o, src + i);
+                o += EOL_BLOCK;
+                i += EOL_BLOCK;
+                continue;
+            }
+            end = base + EOL_BLOCK;
+        } else {
+            cr = 0;
+            for (size_t k = i; k < len; k++) {
+                if (src[k] == '\r') cr |= 1u << (k - base);
+            }
+            end = len;
+        }
+
+        while (cr) {
+            size_t at = base + lowest_bit(cr);
+            cr &= cr - 1u;
+            if (at < i) continue;  // already consumed as part of a CRLF pair
+            if (at > i) {
+                memcpy(dst + o, src + i, at - i);
+                o += at - i;
+            }
+            if (at + 1u == len) {
+                *pending_cr = 1;
+                i = len;
+            } else if (src[at + 1u] == '\n') {
+                dst[o++] = eol_char;
+                i = at + 2u;
+            } else {
+                dst[o++] = '\r';
+                i = at + 1u;
+            }
+        }
+        if (i < end) {
+            memcpy(dst + o, src + i, end - i);
+            o += end - i;
+            i = end;
+        }
+    }
+    return o;
+}
+
+size_t eol_from_crlf_finish(char *dst, int *pending_cr) {
+    if (!*pending_cr) return 0;
+    *pending_cr = 0;
+    dst[0] = '\r';
+    return 1;
+}
+
+const char *text_eol_name(TextEol eol) {
+    switch (eol) {
+        case TEXT_EOL_LF: return "LF";
+        case TEXT_EOL_CR: return "CR";
+        default: return "CRLF";
+    }
+}
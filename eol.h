@@ -0,0 +1,51 @@
+// Line-ending detection and conversion kernels (SSE2 with a scalar fallback)
+// All functions stream: state carried in the structs/flags lets a CR at the
+// end of one chunk pair up with an LF at the start of the next.
+
+#ifndef EOL_H
+#define EOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    TEXT_EOL_CRLF = 0,
+    TEXT_EOL_LF,
+    TEXT_EOL_CR
+} TextEol;
+
+typedef struct {
+    uint64_t cr;
+    uint64_t lf;
+    uint64_t crlf;
+    int last_was_cr;
+} EolScan;
+
+void eol_scan_init(EolScan *scan);
+void eol_scan_update(EolScan *scan, const char *text, size_t len);
+
+// Counts of each style; a CR immediately followed by LF only counts as CRLF.
+uint64_t eol_scan_crlf(const EolScan *scan);
+uint64_t eol_scan_lone_lf(const EolScan *scan);
+uint64_t eol_scan_lone_cr(const EolScan *scan);
+
+// Most frequent style (CRLF on ties and for text without line breaks).
+TextEol eol_scan_dominant(const EolScan *scan);
+int eol_scan_is_mixed(const EolScan *scan);
+
+// Bytes eol_to_crlf produces for the scanned text.
+uint64_t eol_scan_crlf_size(const EolScan *scan, uint64_t len);
+
+// Rewrites lone LF and lone CR as CRLF. `dst` needs room for 2 * len bytes.
+// `*after_cr` must start at 0 and be passed unchanged between chunks.
+size_t eol_to_crlf(const char *src, size_t len, char *dst, int *after_cr);
+
+// Rewrites CRLF pairs as `target` (LF or CR); lone CR and LF pass through.
+// `dst` needs room for len + 1 bytes. A trailing CR is held back in
+// `*pending_cr` until the next chunk (or eol_from_crlf_finish) decides it.
+size_t eol_from_crlf(const char *src, size_t len, char *dst, TextEol target, int *pending_cr);
+size_t eol_from_crlf_finish(char *dst, int *pending_cr);
+
+const char *text_eol_name(TextEol eol);
+
+#endif
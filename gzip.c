@@ -0,0 +1,336 @@
+// gzip container (RFC 1952): a streaming reader with a seekable checkpoint
+// index, and a store-only writer
+
+#include "gzip.h"
+#include "crc32.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define GZ_FLAG_HCRC 0x02
+#define GZ_FLAG_EXTRA 0x04
+#define GZ_FLAG_NAME 0x08
+#define GZ_FLAG_COMMENT 0x10
+#define GZ_FLAG_RESERVED 0xE0
+
+enum { GZ_HEADER = 0, GZ_BODY, GZ_TRAILER, GZ_END };
+
+typedef struct {
+    uint64_t out;          // uncompressed offset of the block start
+    uint64_t member_out;   // the same, counted from the start of its member
+    uint64_t bit;          // compressed bit position of the block start
+    size_t window_len;
+    unsigned char *window;
+} GzCheckpoint;
+
+struct GzReader {
+    Inflater *inf;
+    InflateReadFn read;
+    GzSeekFn seek;
+    void *ctx;
+    int state;
+    unsigned members;
+    uint32_t crc;
+    int crc_valid;          // false after resuming from a checkpoint
+    uint64_t out;
+    uint64_t member_out;
+    uint64_t span;
+    GzCheckpoint *points;
+    size_t count;
+    size_t cap;
+    const char *error;
+};
+
+int gz_is_gzip(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    return len >= 3 && p[0] == 0x1F && p[1] == 0x8B && p[2] == 8;
+}
+
+static void rewind_reader(GzReader *r) {
+    inflate_init(r->inf, r->read, r->ctx, 0);
+    r->state = GZ_HEADER;
+    r->members = 0;
+    r->crc = 0;
+    r->crc_valid = 1;
+    r->out = 0;
+    r->member_out = 0;
+    r->error = NULL;
+}
+
+GzReader *gz_reader_open(InflateReadFn read, GzSeekFn seek, void *ctx, uint64_t span) {
+    GzReader *r;
+    if (!read) return NULL;
+    r = (GzReader *)calloc(1, sizeof(GzReader));
+    if (!r) return NULL;
+    r->inf = (Inflater *)malloc(sizeof(Inflater));
+    if (!r->inf) {
+        free(r);
+        return NULL;
+    }
+    r->read = read;
+    r->seek = seek;
+    r->ctx = ctx;
+    r->span = span ? span : GZ_CHECKPOINT_SPAN;
+    rewind_reader(r);
+    return r;
+}
+
+void gz_reader_close(GzReader *r) {
+    if (!r) return;
+    for (size_t i = 0; i < r->count; i++) {
+        free(r->points[i].window);
+    }
+    free(r->points);
+    free(r->inf);
+    free(r);
+}
+
+static int skip_bytes(Inflater *inf, size_t n) {
+    while (n-- > 0) {
+        if (inflate_get_byte(inf) < 0) return 0;
+    }
+    return 1;
+}
+
+static int skip_string(Inflater *inf) {
+    int c;
+    do {
+        c = inflate_get_byte(inf);
+    } while (c > 0);
+    return c == 0;
+}
+
+// Parses a member header. A clean end of input (or trailing garbage) after
+// the first member ends the stream, as gzip itself does.
+static void read_header(GzReader *r) {
+    Inflater *inf = r->inf;
+    int id1 = inflate_get_byte(inf);
+    int id2 = id1 == 0x1F ? inflate_get_byte(inf) : -1;
+    int method = id2 == 0x8B ? inflate_get_byte(inf) : -1;
+    int flags;
+
+    if (method != 8) {
+        if (r->members == 0) r->error = id1 < 0 ? "empty file" : "not a gzip file";
+        r->state = GZ_END;
+        return;
+    }
+    flags = inflate_get_byte(inf);
+    if (flags < 0 || (flags & GZ_FLAG_RESERVED) || !skip_bytes(inf, 6)) {
+        r->error = "bad gzip header";
+        r->state = GZ_END;
+        return;
+    }
+    if (flags & GZ_FLAG_EXTRA) {
+        int lo = inflate_get_byte(inf);
+        int hi = inflate_get_byte(inf);
+        if (lo < 0 || hi < 0 || !skip_bytes(inf, (size_t)(lo | (hi << 8)))) flags = -1;
+    }
+    if (flags >= 0 && (flags & GZ_FLAG_NAME) && !skip_string(inf)) flags = -1;
+    if (flags >= 0 && (flags & GZ_FLAG_COMMENT) && !skip_string(inf)) flags = -1;
+    if (flags >= 0 && (flags & GZ_FLAG_HCRC) && !skip_bytes(inf, 2)) flags = -1;
+    if (flags < 0) {
+        r->error = "truncated gzip header";
+        r->state = GZ_END;
+        return;
+    }
+
+    inflate_restart(inf);
+    r->members++;
+    r->crc = 0;
+    r->crc_valid = 1;
+    r->member_out = 0;
+    r->state = GZ_BODY;
+}
+
+static void read_trailer(GzReader *r) {
+    unsigned char t[8];
+    uint32_t crc;
+    uint32_t isize;
+
+    for (size_t i = 0; i < sizeof(t); i++) {
+        int c = inflate_get_byte(r->inf);
+        if (c < 0) {
+            r->error = "truncated gzip trailer";
+            r->state = GZ_END;
+            return;
+        }
+        t[i] = (unsigned char)c;
+    }
+    crc = (uint32_t)t[0] | ((uint32_t)t[1] << 8) | ((uint32_t)t[2] << 16) | ((uint32_t)t[3] << 24);
+    isize = (uint32_t)t[4] | ((uint32_t)t[5] << 8) | ((uint32_t)t[6] << 16) | ((uint32_t)t[7] << 24);
+    if ((r->crc_valid && crc != r->crc) || isize != (uint32_t)r->member_out) {
+        r->error = "gzip checksum mismatch";
+        r->state = GZ_END;
+        return;
+    }
+    r->state = GZ_HEADER;
+}
+
+// Appends a checkpoint when the decoder sits at a block start at least one
+// span past the last one. Failing to grow the index only costs seek speed.
+static void maybe_checkpoint(GzReader *r) {
+    uint64_t next = r->count ? r->points[r->count - 1u].out + r->span : r->span;
+    GzCheckpoint *cp;
+
+    if (r->out < next || !inflate_at_block_start(r->inf)) return;
+    if (r->count == r->cap) {
+        size_t cap = r->cap ? r->cap * 2u : 64u;
+        GzCheckpoint *grown = (GzCheckpoint *)realloc(r->points, cap * sizeof(GzCheckpoint));
+        if (!grown) return;
+        r->points = grown;
+        r->cap = cap;
+    }
+    cp = &r->points[r->count];
+    cp->window = (unsigned char *)malloc(INFLATE_WINDOW);
+    if (!cp->window) return;
+    cp->window_len = inflate_window(r->inf, cp->window);
+    cp->out = r->out;
+    cp->member_out = r->member_out;
+    cp->bit = inflate_bit_position(r->inf);
+    r->count++;
+}
+
+size_t gz_reader_read(GzReader *r, void *dst, size_t cap) {
+    unsigned char *out = (unsigned char *)dst;
+    size_t n = 0;
+
+    if (!r) return 0;
+    while (n < cap && r->state != GZ_END) {
+        if (r->state == GZ_HEADER) {
+            read_header(r);
+        } else if (r->state == GZ_TRAILER) {
+            read_trailer(r);
+        } else {
+            size_t got;
+            maybe_checkpoint(r);
+            got = inflate_read(r->inf, out + n, cap - n);
+            if (got > 0) {
+                if (r->crc_valid) r->crc = crc32_update(r->crc, out + n, got);
+                n += got;
+                r->out += got;
+                r->member_out += got;
+            } else if (inflate_error(r->inf)) {
+                r->error = inflate_error(r->inf) == INFLATE_ERR_TRUNCATED
+                    ? "unexpected end of gzip data"
+                    : "corrupt gzip data";
+                r->state = GZ_END;
+            } else if (inflate_done(r->inf)) {
+                r->state = GZ_TRAILER;
+            }
+        }
+    }
+    return n;
+}
+
+const char *gz_reader_error(const GzReader *r) {
+    return r ? r->error : "no reader";
+}
+
+uint64_t gz_reader_tell(const GzReader *r) {
+    return r ? r->out : 0;
+}
+
+uint64_t gz_reader_compressed_pos(const GzReader *r) {
+    return r ? inflate_bit_position(r->inf) / 8u : 0;
+}
+
+size_t gz_reader_checkpoints(const GzReader *r) {
+    return r ? r->count : 0;
+}
+
+int gz_reader_seek(GzReader *r, uint64_t offset) {
+    unsigned char scratch[16384];
+    const GzCheckpoint *best = NULL;
+    size_t lo = 0;
+    size_t hi;
+
+    if (!r) return 0;
+    hi = r->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2u;
+        if (r->points[mid].out <= offset) {
+            lo = mid + 1u;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo > 0) best = &r->points[lo - 1u];
+
+    // Decoding on from the current position beats any checkpoint behind it.
+    if (offset < r->out || (best && best->out > r->out)) {
+        if (!r->seek) return 0;
+        if (best) {
+            if (!r->seek(r->ctx, best->bit / 8u)) return 0;
+            inflate_resume(r->inf, best->bit, best->window, best->window_len, best->member_out);
+            r->state = GZ_BODY;
+            r->crc_valid = 0;
+            r->out = best->out;
+            r->member_out = best->member_out;
+            r->error = NULL;
+        } else {
+            if (!r->seek(r->ctx, 0)) return 0;
+            rewind_reader(r);
+        }
+    }
+
+    while (r->out < offset) {
+        uint64_t left = offset - r->out;
+        size_t want = left < sizeof(scratch) ? (size_t)left : sizeof(scratch);
+        if (gz_reader_read(r, scratch, want) == 0) return 0;
+    }
+    return r->error == NULL;
+}
+
+static int emit_block(GzWriter *w, int final) {
+    size_t len = w->used;
+    w->block[0] = (unsigned char)(final ? 1 : 0);
+    w->block[1] = (unsigned char)(len & 0xFF);
+    w->block[2] = (unsigned char)(len >> 8);
+    w->block[3] = (unsigned char)(~len & 0xFF);
+    w->block[4] = (unsigned char)((~len >> 8) & 0xFF);
+    w->used = 0;
+    if (!w->sink(w->ctx, w->block, 5 + len)) w->failed = 1;
+    return !w->failed;
+}
+
+int gz_writer_init(GzWriter *w, GzSinkFn sink, void *ctx) {
+    static const unsigned char header[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF };
+    if (!w || !sink) return 0;
+    w->sink = sink;
+    w->ctx = ctx;
+    w->crc = 0;
+    w->size = 0;
+    w->used = 0;
+    w->failed = !sink(ctx, header, sizeof(header));
+    return !w->failed;
+}
+
+int gz_writer_write(GzWriter *w, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    if (!w || w->failed) return 0;
+    w->crc = crc32_update(w->crc, p, len);
+    w->size += len;
+    while (len > 0) {
+        size_t n = GZ_STORED_BLOCK - w->used;
+        if (n > len) n = len;
+        memcpy(w->block + 5 + w->used, p, n);
+        w->used += n;
+        p += n;
+        len -= n;
+        if (w->used == GZ_STORED_BLOCK && !emit_block(w, 0)) return 0;
+    }
+    return 1;
+}
+
+int gz_writer_finish(GzWriter *w) {
+    unsigned char trailer[8];
+    uint32_t size32;
+    if (!w || w->failed || !emit_block(w, 1)) return 0;
+    size32 = (uint32_t)w->size;
+    for (int i = 0; i < 4; i++) {
+        trailer[i] = (unsigned char)(w->crc >> (8 * i));
+        trailer[4 + i] = (unsigned char)(size32 >> (8 * i));
+    }
+    if (!w->sink(w->ctx, trailer, sizeof(trailer))) w->failed = 1;
+    return !w->failed;
+}
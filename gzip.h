@@ -0,0 +1,59 @@
+// gzip container (RFC 1952): a streaming reader with a seekable checkpoint
+// index, and a store-only writer
+// The reader records a checkpoint (bit position plus the 32 KB window) at the
+// first block boundary after every `span` bytes of output, so seeking back
+// resumes from the nearest checkpoint instead of the start of the file.
+
+#ifndef GZIP_H
+#define GZIP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "inflate.h"
+
+#define GZ_CHECKPOINT_SPAN (4u * 1024u * 1024u)
+#define GZ_STORED_BLOCK 65535u
+
+// Repositions the compressed input at an absolute byte offset; 1 on success.
+typedef int (*GzSeekFn)(void *ctx, uint64_t offset);
+typedef int (*GzSinkFn)(void *ctx, const void *data, size_t len);
+
+typedef struct GzReader GzReader;
+
+int gz_is_gzip(const void *data, size_t len);
+
+// `seek` may be NULL for a forward-only reader (gz_reader_seek then fails).
+GzReader *gz_reader_open(InflateReadFn read, GzSeekFn seek, void *ctx, uint64_t span);
+void gz_reader_close(GzReader *r);
+
+// Returns 0 at the end of the last member or on error.
+size_t gz_reader_read(GzReader *r, void *dst, size_t cap);
+
+// NULL while the stream is intact, otherwise a short description.
+const char *gz_reader_error(const GzReader *r);
+
+uint64_t gz_reader_tell(const GzReader *r);
+uint64_t gz_reader_compressed_pos(const GzReader *r);
+size_t gz_reader_checkpoints(const GzReader *r);
+
+// Moves to an uncompressed offset, decoding forward from the closest
+// checkpoint at or before it. Returns 1 on success, 0 past the end or on error.
+int gz_reader_seek(GzReader *r, uint64_t offset);
+
+// Writes a valid gzip member using stored (uncompressed) deflate blocks.
+typedef struct {
+    GzSinkFn sink;
+    void *ctx;
+    uint32_t crc;
+    uint64_t size;
+    size_t used;
+    int failed;
+    unsigned char block[5 + GZ_STORED_BLOCK];
+} GzWriter;
+
+int gz_writer_init(GzWriter *w, GzSinkFn sink, void *ctx);
+int gz_writer_write(GzWriter *w, const void *data, size_t len);
+int gz_writer_finish(GzWriter *w);
+
+#endif
@@ -0,0 +1,369 @@
+// Paged byte view of a file with in-place patching, for the hex view
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "hex_doc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    uint64_t index;      // page number, valid when data != NULL
+    unsigned char *data;
+    size_t len;
+    uint64_t used;       // LRU stamp
+} HexPage;
+
+typedef struct {
+    uint64_t offset;
+    unsigned char value;
+} HexPatch;
+
+struct HexDoc {
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+    char *path;          // for reopening with write access on write-back
+    int writable;
+    uint64_t size;
+    HexPage pages[HEX_PAGE_SLOTS];
+    uint64_t clock;
+    HexPatch *patches;   // sorted by offset, one entry per byte
+    size_t patch_count;
+    size_t patch_cap;
+};
+
+static void unmap_page(HexPage *page) {
+    if (!page->data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(page->data);
+#else
+    munmap(page->data, page->len);
+#endif
+    page->data = NULL;
+    page->len = 0;
+    page->used = 0;
+}
+
+static HexPage *get_page(HexDoc *doc, uint64_t index) {
+    HexPage *victim = &doc->pages[0];
+    uint64_t start = index * HEX_PAGE_SIZE;
+    size_t len;
+    void *view;
+
+    for (size_t i = 0; i < HEX_PAGE_SLOTS; i++) {
+        HexPage *page = &doc->pages[i];
+        if (page->data && page->index == index) {
+            page->used = ++doc->clock;
+            return page;
+        }
+        if (page->used < victim->used) victim = page;
+    }
+
+    len = doc->size - start < HEX_PAGE_SIZE ? (size_t)(doc->size - start) : HEX_PAGE_SIZE;
+    unmap_page(victim);
+#ifdef _WIN32
+    view = MapViewOfFile(doc->mapping, FILE_MAP_READ, (DWORD)(start >> 32), (DWORD)start, len);
+    if (!view) return NULL;
+#else
+    view = mmap(NULL, len, PROT_READ, MAP_SHARED, doc->fd, (off_t)start);
+    if (view == MAP_FAILED) return NULL;
+#endif
+    victim->index = index;
+    victim->data = (unsigned char *)view;
+    victim->len = len;
+    victim->used = ++doc->clock;
+    return victim;
+}
+
+HexDoc *hex_doc_open(const char *path) {
+    HexDoc *doc = (HexDoc *)calloc(1, sizeof(HexDoc));
+    if (!doc || !path) {
+        free(doc);
+        return NULL;
+    }
+    doc->path = (char *)malloc(strlen(path) + 1u);
+    if (!doc->path) {
+        free(doc);
+        return NULL;
+    }
+    strcpy(doc->path, path);
+
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    DWORD attributes = GetFileAttributesA(path);
+    doc->writable = attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_READONLY);
+    doc->file = CreateFileA(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL
+    );
+    if (doc->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(doc->file, &size)) {
+        if (doc->file != INVALID_HANDLE_VALUE) CloseHandle(doc->file);
+        free(doc->path);
+        free(doc);
+        return NULL;
+    }
+    doc->size = (uint64_t)size.QuadPart;
+    // Empty files cannot be mapped; they simply have no pages.
+    if (doc->size > 0) {
+        doc->mapping = CreateFileMappingA(doc->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!doc->mapping) {
+            CloseHandle(doc->file);
+            free(doc->path);
+            free(doc);
+            return NULL;
+        }
+    }
+#else
+    struct stat st;
+    doc->writable = access(path, W_OK) == 0;
+    doc->fd = open(path, O_RDONLY);
+    if (doc->fd < 0 || fstat(doc->fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (doc->fd >= 0) close(doc->fd);
+        free(doc->path);
+        free(doc);
+        return NULL;
+    }
+    doc->size = (uint64_t)st.st_size;
+#endif
+    return doc;
+}
+
+void hex_doc_close(HexDoc *doc) {
+    if (!doc) return;
+    for (size_t i = 0; i < HEX_PAGE_SLOTS; i++) {
+        unmap_page(&doc->pages[i]);
+    }
+#ifdef _WIN32
+    if (doc->mapping) CloseHandle(doc->mapping);
+    CloseHandle(doc->file);
+#else
+    close(doc->fd);
+#endif
+    free(doc->path);
+    free(doc->patches);
+    free(doc);
+}
+
+uint64_t hex_doc_size(const HexDoc *doc) {
+    return doc ? doc->size : 0;
+}
+
+int hex_doc_writable(const HexDoc *doc) {
+    return doc ? doc->writable : 0;
+}
+
+// First patch at or after `offset`.
+static size_t patch_lower_bound(const HexDoc *doc, uint64_t offset) {
+    size_t lo = 0;
+    size_t hi = doc->patch_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2u;
+        if (doc->patches[mid].offset < offset) {
+            lo = mid + 1u;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+size_t hex_doc_read(HexDoc *doc, uint64_t offset, unsigned char *dst, size_t len) {
+    size_t copied = 0;
+    size_t p;
+
+    if (!doc || !dst || offset >= doc->size) return 0;
+    if ((uint64_t)len > doc->size - offset) len = (size_t)(doc->size - offset);
+
+    while (copied < len) {
+        uint64_t at = offset + copied;
+        HexPage *page = get_page(doc, at / HEX_PAGE_SIZE);
+        size_t within = (size_t)(at % HEX_PAGE_SIZE);
+        size_t n;
+        if (!page) break;
+        n = page->len - within;
+        if (n > len - copied) n = len - copied;
+        memcpy(dst + copied, page->data + within, n);
+        copied += n;
+    }
+
+    for (p = patch_lower_bound(doc, offset); p < doc->patch_count; p++) {
+        uint64_t at = doc->patches[p].offset;
+        if (at >= offset + copied) break;
+        dst[at - offset] = doc->patches[p].value;
+    }
+    return copied;
+}
+
+int hex_doc_set_byte(HexDoc *doc, uint64_t offset, unsigned char value) {
+    size_t p;
+
+    if (!doc || offset >= doc->size) return 0;
+    p = patch_lower_bound(doc, offset);
+    if (p < doc->patch_count && doc->patches[p].offset == offset) {
+        doc->patches[p].value = value;
+        return 1;
+    }
+    if (doc->patch_count == doc->patch_cap) {
+        size_t cap = doc->patch_cap ? doc->patch_cap * 2u : 64u;
+        HexPatch *grown = (HexPatch *)realloc(doc->patches, cap * sizeof(HexPatch));
+        if (!grown) return 0;
+        doc->patches = grown;
+        doc->patch_cap = cap;
+    }
+    memmove(doc->patches + p + 1u, doc->patches + p, (doc->patch_count - p) * sizeof(HexPatch));
+    doc->patches[p].offset = offset;
+    doc->patches[p].value = value;
+    doc->patch_count++;
+    return 1;
+}
+
+int hex_doc_is_patched(const HexDoc *doc, uint64_t offset) {
+    size_t p;
+    if (!doc) return 0;
+    p = patch_lower_bound(doc, offset);
+    return p < doc->patch_count && doc->patches[p].offset == offset;
+}
+
+size_t hex_doc_patch_count(const HexDoc *doc) {
+    return doc ? doc->patch_count : 0;
+}
+
+void hex_doc_discard(HexDoc *doc) {
+    if (doc) doc->patch_count = 0;
+}
+
+#ifdef _WIN32
+typedef HANDLE WriteTarget;
+#else
+typedef int WriteTarget;
+#endif
+
+static int write_at(WriteTarget out, uint64_t offset, const unsigned char *data, size_t len) {
+#ifdef _WIN32
+    OVERLAPPED ov;
+    DWORD written = 0;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = (DWORD)offset;
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+    return WriteFile(out, data, (DWORD)len, &written, &ov) && written == (DWORD)len;
+#else
+    while (len > 0) {
+        ssize_t n = pwrite(out, data, len, (off_t)offset);
+        if (n <= 0) return 0;
+        data += n;
+        offset += (uint64_t)n;
+        len -= (size_t)n;
+    }
+    return 1;
+#endif
+}
+
+int hex_doc_write_back(HexDoc *doc) {
+    unsigned char run[4096];
+    size_t p = 0;
+    size_t done = 0;
+
+    if (!doc || !doc->writable) return 0;
+    if (doc->patch_count == 0) return 1;
+    // The write handle lives only for this call; the read handle and its
+    // mappings share the file, so they see the new bytes.
+#ifdef _WIN32
+    WriteTarget out = CreateFileA(
+        doc->path, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL
+    );
+    if (out == INVALID_HANDLE_VALUE) return 0;
+#else
+    WriteTarget out = open(doc->path, O_WRONLY);
+    if (out < 0) return 0;
+#endif
+    while (p < doc->patch_count) {
+        uint64_t start = doc->patches[p].offset;
+        size_t n = 0;
+        // Coalesce consecutive offsets into one write.
+        while (p < doc->patch_count && n < sizeof(run) && doc->patches[p].offset == start + n) {
+            run[n++] = doc->patches[p++].value;
+        }
+        if (!write_at(out, start, run, n)) break;
+        done = p;
+    }
+
+    memmove(doc->patches, doc->patches + done, (doc->patch_count - done) * sizeof(HexPatch));
+    doc->patch_count -= done;
+#ifdef _WIN32
+    if (done > 0) FlushFileBuffers(out);
+    CloseHandle(out);
+#else
+    if (done > 0) fsync(out);
+    close(out);
+#endif
+    return doc->patch_count == 0;
+}
+
+size_t hex_format_row(uint64_t offset, const unsigned char *bytes, size_t n, char *out) {
+    static const char digits[] = "0123456789abcdef";
+    char *o = out;
+
+    if (n > HEX_ROW_BYTES) n = HEX_ROW_BYTES;
+    for (int shift = 60; shift >= 0; shift -= 4) {
+        *o++ = digits[(offset >> shift) & 0xFu];
+    }
+    *o++ = ' ';
+    for (size_t i = 0; i < HEX_ROW_BYTES; i++) {
+        *o++ = ' ';
+        if (i == HEX_ROW_BYTES / 2u) *o++ = ' ';
+        if (i < n) {
+            *o++ = digits[bytes[i] >> 4];
+            *o++ = digits[bytes[i] & 0xFu];
+        } else {
+            *o++ = ' ';
+            *o++ = ' ';
+        }
+    }
+    *o++ = ' ';
+    *o++ = ' ';
+    *o++ = '|';
+    for (size_t i = 0; i < n; i++) {
+        *o++ = (bytes[i] >= 0x20 && bytes[i] < 0x7F) ? (char)bytes[i] : '.';
+    }
+    *o++ = '|';
+    *o = '\0';
+    return (size_t)(o - out);
+}
+
+int hex_looks_binary(const unsigned char *data, size_t len) {
+    size_t control = 0;
+
+    // UTF-16 text is full of NULs but has its own decoder.
+    if (len >= 2 && ((data[0] == 0xFF && data[1] == 0xFE) || (data[0] == 0xFE && data[1] == 0xFF))) {
+        return 0;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = data[i];
+        if (c == 0) return 1;
+        if (c < 0x20 && c != '\t' && c != '\n' && c != '\r' && c != '\f' && c != '\b' && c != 0x1B) {
+            control++;
+        }
+    }
+    return len > 0 && control * 10u > len;
+}
@@ -0,0 +1,49 @@
+// Paged byte view of a file with in-place patching, for the hex view
+// The file is never loaded whole: reads go through a small LRU of mapped
+// pages, byte edits live in a sorted overlay, and write-back stores only the
+// patched runs at their offsets, so saving never rewrites the whole file.
+
+#ifndef HEX_DOC_H
+#define HEX_DOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HEX_PAGE_SIZE (1024u * 1024u)   // multiple of the 64 KB Windows mapping granularity
+#define HEX_PAGE_SLOTS 8u
+#define HEX_ROW_BYTES 16u
+#define HEX_ROW_TEXT 96u                // enough for one formatted row plus NUL
+
+typedef struct HexDoc HexDoc;
+
+// Returns NULL when the file cannot be opened or mapped. The file is opened
+// read-only and shared for writing, so other programs can still save it;
+// hex_doc_writable reports whether write-back is expected to succeed.
+HexDoc *hex_doc_open(const char *path);
+void hex_doc_close(HexDoc *doc);
+
+uint64_t hex_doc_size(const HexDoc *doc);
+int hex_doc_writable(const HexDoc *doc);
+
+// Copies bytes with pending patches applied; returns the number copied.
+size_t hex_doc_read(HexDoc *doc, uint64_t offset, unsigned char *dst, size_t len);
+
+// Patches stay in memory until hex_doc_write_back. Returns 0 on allocation
+// failure or when the offset is past the end (the size never changes).
+int hex_doc_set_byte(HexDoc *doc, uint64_t offset, unsigned char value);
+int hex_doc_is_patched(const HexDoc *doc, uint64_t offset);
+size_t hex_doc_patch_count(const HexDoc *doc);
+void hex_doc_discard(HexDoc *doc);
+
+// Reopens the file for writing, writes each run of patched bytes in place,
+// flushes and closes it again. Returns 1 on success; on failure the
+// unwritten patches are kept.
+int hex_doc_write_back(HexDoc *doc);
+
+// "0000000000001230  48 65 6c ...  |Hel...|" for up to HEX_ROW_BYTES bytes.
+size_t hex_format_row(uint64_t offset, const unsigned char *bytes, size_t n, char *out);
+
+// Heuristic used to pick the hex view: a NUL byte, or mostly control bytes.
+int hex_looks_binary(const unsigned char *data, size_t len);
+
+#endif
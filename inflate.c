@@ -0,0 +1,362 @@
+// Streaming raw DEFLATE decoder (RFC 1951)
+
+#include "inflate.h"
+
+#include <string.h>
+
+enum { ST_HEADER = 0, ST_STORED, ST_HUFFMAN, ST_DONE };
+
+static const uint16_t LEN_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LEN_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DIST_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DIST_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t CLEN_ORDER[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+void inflate_init(Inflater *d, InflateReadFn read, void *ctx, uint64_t in_offset) {
+    d->read = read;
+    d->read_ctx = ctx;
+    d->in_pos = 0;
+    d->in_len = 0;
+    d->in_loaded = in_offset;
+    d->bitbuf = 0;
+    d->bitcnt = 0;
+    d->overrun = 0;
+    d->wpos = 0;
+    d->total_out = 0;
+    d->state = ST_HEADER;
+    d->last_block = 0;
+    d->stored_left = 0;
+    d->copy_len = 0;
+    d->copy_dist = 0;
+    d->error = INFLATE_OK;
+}
+
+// Tops the bit buffer up to at least 57 bits; past the end of input it pads
+// with zeros and counts them so a real shortage can be reported.
+static void refill(Inflater *d) {
+    while (d->bitcnt <= 56) {
+        if (d->in_pos == d->in_len) {
+            d->in_pos = 0;
+            d->in_len = d->overrun ? 0 : d->read(d->read_ctx, d->in, INFLATE_IN_BUF);
+            if (d->in_len == 0) {
+                d->overrun++;
+                d->bitcnt += 8;
+                continue;
+            }
+        }
+        d->bitbuf |= (uint64_t)d->in[d->in_pos++] << d->bitcnt;
+        d->bitcnt += 8;
+        d->in_loaded++;
+    }
+}
+
+static unsigned bits(Inflater *d, unsigned n) {
+    unsigned v;
+    if (n == 0) return 0;
+    if (d->bitcnt < n) refill(d);
+    v = (unsigned)(d->bitbuf & ((1u << n) - 1u));
+    d->bitbuf >>= n;
+    d->bitcnt -= n;
+    return v;
+}
+
+// Bits taken from the padding mean the input really ended.
+static int truncated(const Inflater *d) {
+    return d->bitcnt < d->overrun * 8u;
+}
+
+static void fail(Inflater *d, int error) {
+    if (!d->error) d->error = error;
+    d->state = ST_DONE;
+}
+
+// Builds a direct lookup table indexed by the next INFLATE_FAST_BITS input
+// bits. Returns 0 for an over-subscribed code.
+static int build_table(uint16_t *table, const uint8_t *lengths, unsigned count) {
+    unsigned len_count[16] = {0};
+    unsigned next_code[16];
+    unsigned code = 0;
+    int left = 1;
+
+    for (unsigned i = 0; i < count; i++) len_count[lengths[i]]++;
+    len_count[0] = 0;
+    for (unsigned len = 1; len < 16; len++) {
+        left <<= 1;
+        left -= (int)len_count[len];
+        if (left < 0) return 0;
+    }
+    for (unsigned len = 1; len < 16; len++) {
+        code = (code + len_count[len - 1u]) << 1;
+        next_code[len] = code;
+    }
+
+    // Unused entries stay 0, which decodes as "invalid code".
+    memset(table, 0, sizeof(uint16_t) << INFLATE_FAST_BITS);
+    for (unsigned sym = 0; sym < count; sym++) {
+        unsigned len = lengths[sym];
+        unsigned rev = 0;
+        unsigned c;
+        if (len == 0) continue;
+        c = next_code[len]++;
+        for (unsigned i = 0; i < len; i++) {
+            rev = (rev << 1) | ((c >> i) & 1u);
+        }
+        for (unsigned at = rev; at < (1u << INFLATE_FAST_BITS); at += 1u << len) {
+            table[at] = (uint16_t)(sym | (len << 9));
+        }
+    }
+    return 1;
+}
+
+static int decode(Inflater *d, const uint16_t *table) {
+    uint16_t entry;
+    unsigned len;
+    if (d->bitcnt < INFLATE_FAST_BITS) refill(d);
+    entry = table[d->bitbuf & ((1u << INFLATE_FAST_BITS) - 1u)];
+    len = entry >> 9;
+    if (len == 0) return -1;
+    d->bitbuf >>= len;
+    d->bitcnt -= len;
+    return entry & 0x1FF;
+}
+
+static int fixed_tables(Inflater *d) {
+    uint8_t lengths[320];
+    unsigned i = 0;
+    for (; i < 144; i++) lengths[i] = 8;
+    for (; i < 256; i++) lengths[i] = 9;
+    for (; i < 280; i++) lengths[i] = 7;
+    for (; i < 288; i++) lengths[i] = 8;
+    for (i = 0; i < 30; i++) lengths[288 + i] = 5;
+    return build_table(d->lit_table, lengths, 288) && build_table(d->dist_table, lengths + 288, 30);
+}
+
+static int dynamic_tables(Inflater *d) {
+    uint8_t lengths[320];
+    uint8_t clen[19];
+    unsigned nlen = bits(d, 5) + 257u;
+    unsigned ndist = bits(d, 5) + 1u;
+    unsigned ncode = bits(d, 4) + 4u;
+    unsigned i;
+
+    if (nlen > 286 || ndist > 30) return 0;
+    memset(clen, 0, sizeof(clen));
+    for (i = 0; i < ncode; i++) clen[CLEN_ORDER[i]] = (uint8_t)bits(d, 3);
+    // The code-length code reuses the literal table as scratch space.
+    if (!build_table(d->lit_table, clen, 19)) return 0;
+
+    for (i = 0; i < nlen + ndist;) {
+        int sym = decode(d, d->lit_table);
+        unsigned repeat;
+        uint8_t value = 0;
+        if (sym < 0) return 0;
+        if (sym < 16) {
+            lengths[i++] = (uint8_t)sym;
+            continue;
+        }
+        if (sym == 16) {
+            if (i == 0) return 0;
+            value = lengths[i - 1u];
+            repeat = 3u + bits(d, 2);
+        } else if (sym == 17) {
+            repeat = 3u + bits(d, 3);
+        } else {
+            repeat = 11u + bits(d, 7);
+        }
+        if (i + repeat > nlen + ndist) return 0;
+        while (repeat--) lengths[i++] = value;
+    }
+    if (lengths[256] == 0) return 0;
+    return build_table(d->lit_table, lengths, nlen) && build_table(d->dist_table, lengths + nlen, ndist);
+}
+
+static void block_header(Inflater *d) {
+    unsigned type;
+    if (d->last_block) {
+        d->state = ST_DONE;
+        return;
+    }
+    d->last_block = (int)bits(d, 1);
+    type = bits(d, 2);
+    if (type == 0) {
+        unsigned len;
+        unsigned nlen;
+        inflate_align(d);
+        len = bits(d, 16);
+        nlen = bits(d, 16);
+        if ((len ^ 0xFFFFu) != nlen) {
+            fail(d, INFLATE_ERR_DATA);
+            return;
+        }
+        d->stored_left = len;
+        d->state = ST_STORED;
+    } else if (type == 1) {
+        fixed_tables(d);
+        d->state = ST_HUFFMAN;
+    } else if (type == 2) {
+        if (!dynamic_tables(d)) {
+            fail(d, truncated(d) ? INFLATE_ERR_TRUNCATED : INFLATE_ERR_DATA);
+            return;
+        }
+        d->state = ST_HUFFMAN;
+    } else {
+        fail(d, INFLATE_ERR_DATA);
+        return;
+    }
+    if (truncated(d)) fail(d, INFLATE_ERR_TRUNCATED);
+}
+
+static void put(Inflater *d, unsigned char c) {
+    d->window[d->wpos] = c;
+    d->wpos = (d->wpos + 1u) & (INFLATE_WINDOW - 1u);
+}
+
+size_t inflate_read(Inflater *d, unsigned char *dst, size_t cap) {
+    size_t n = 0;
+
+    while (n < cap && d->state != ST_DONE) {
+        if (d->copy_len > 0) {
+            // Locals: stores through dst may alias the decoder's fields.
+            unsigned char *window = d->window;
+            size_t wpos = d->wpos;
+            size_t from = (wpos - d->copy_dist) & (INFLATE_WINDOW - 1u);
+            size_t count = d->copy_len < cap - n ? d->copy_len : cap - n;
+            for (size_t i = 0; i < count; i++) {
+                unsigned char c = window[from];
+                from = (from + 1u) & (INFLATE_WINDOW - 1u);
+                window[wpos] = c;
+                wpos = (wpos + 1u) & (INFLATE_WINDOW - 1u);
+                dst[n + i] = c;
+            }
+            n += count;
+            d->wpos = wpos;
+            d->copy_len -= count;
+            continue;
+        }
+
+        if (d->state == ST_HEADER) {
+            block_header(d);
+        } else if (d->state == ST_STORED) {
+            while (d->stored_left > 0 && n < cap) {
+                unsigned char c = (unsigned char)bits(d, 8);
+                put(d, c);
+                dst[n++] = c;
+                d->stored_left--;
+            }
+            if (truncated(d)) {
+                fail(d, INFLATE_ERR_TRUNCATED);
+            } else if (d->stored_left == 0) {
+                d->state = ST_HEADER;
+                if (n > 0) break;
+            }
+        } else {
+            int sym = decode(d, d->lit_table);
+            if (sym < 256) {
+                if (sym < 0 || truncated(d)) {
+                    fail(d, truncated(d) ? INFLATE_ERR_TRUNCATED : INFLATE_ERR_DATA);
+                    break;
+                }
+                put(d, (unsigned char)sym);
+                dst[n++] = (unsigned char)sym;
+            } else if (sym == 256) {
+                d->state = ST_HEADER;
+                if (n > 0) break;
+            } else {
+                unsigned li = (unsigned)sym - 257u;
+                int ds;
+                size_t dist;
+                if (li >= 29) {
+                    fail(d, INFLATE_ERR_DATA);
+                    break;
+                }
+                d->copy_len = LEN_BASE[li] + bits(d, LEN_EXTRA[li]);
+                ds = decode(d, d->dist_table);
+                if (ds < 0 || ds >= 30) {
+                    fail(d, truncated(d) ? INFLATE_ERR_TRUNCATED : INFLATE_ERR_DATA);
+                    break;
+                }
+                dist = DIST_BASE[ds] + bits(d, DIST_EXTRA[ds]);
+                if (dist > d->total_out + n || truncated(d)) {
+                    fail(d, truncated(d) ? INFLATE_ERR_TRUNCATED : INFLATE_ERR_DATA);
+                    break;
+                }
+                d->copy_dist = dist;
+            }
+        }
+    }
+    d->total_out += n;
+    return n;
+}
+
+int inflate_done(const Inflater *d) {
+    return d->state == ST_DONE;
+}
+
+int inflate_error(const Inflater *d) {
+    return d->error;
+}
+
+int inflate_at_block_start(const Inflater *d) {
+    return d->state == ST_HEADER && d->copy_len == 0 && !d->last_block;
+}
+
+uint64_t inflate_bit_position(const Inflater *d) {
+    return d->in_loaded * 8u - (d->bitcnt - d->overrun * 8u);
+}
+
+size_t inflate_window(const Inflater *d, unsigned char *dst) {
+    size_t len = d->total_out < INFLATE_WINDOW ? (size_t)d->total_out : INFLATE_WINDOW;
+    size_t start = (d->wpos - len) & (INFLATE_WINDOW - 1u);
+    size_t first = INFLATE_WINDOW - start < len ? INFLATE_WINDOW - start : len;
+    memcpy(dst, d->window + start, first);
+    memcpy(dst + first, d->window, len - first);
+    return len;
+}
+
+void inflate_resume(
+    Inflater *d,
+    uint64_t bit_position,
+    const unsigned char *window,
+    size_t window_len,
+    uint64_t total_out
+) {
+    inflate_init(d, d->read, d->read_ctx, bit_position / 8u);
+    memcpy(d->window, window, window_len);
+    d->wpos = window_len & (INFLATE_WINDOW - 1u);
+    d->total_out = total_out;
+    bits(d, (unsigned)(bit_position % 8u));
+}
+
+void inflate_align(Inflater *d) {
+    bits(d, d->bitcnt % 8u);
+}
+
+int inflate_get_byte(Inflater *d) {
+    unsigned v;
+    inflate_align(d);
+    v = bits(d, 8);
+    return truncated(d) ? -1 : (int)v;
+}
+
+void inflate_restart(Inflater *d) {
+    d->state = ST_HEADER;
+    d->last_block = 0;
+    d->stored_left = 0;
+    d->copy_len = 0;
+    d->wpos = 0;
+    d->total_out = 0;
+}
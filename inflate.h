@@ -0,0 +1,89 @@
+// Streaming raw DEFLATE decoder (RFC 1951)
+// Input is pulled through a callback, output is produced into caller buffers
+// in any amount, so a stream of any size decodes with fixed memory. Decoding
+// can be resumed from a block boundary given the bit position and the last
+// 32 KB of output, which is what the gzip checkpoint index stores.
+
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define INFLATE_WINDOW 32768u
+#define INFLATE_IN_BUF 65536u
+#define INFLATE_FAST_BITS 15u
+
+// Fills `buf` with up to `cap` bytes; returns 0 at end of input.
+typedef size_t (*InflateReadFn)(void *ctx, unsigned char *buf, size_t cap);
+
+enum {
+    INFLATE_OK = 0,
+    INFLATE_ERR_DATA,       // malformed stream
+    INFLATE_ERR_TRUNCATED   // input ended inside the stream
+};
+
+typedef struct {
+    InflateReadFn read;
+    void *read_ctx;
+    unsigned char in[INFLATE_IN_BUF];
+    size_t in_pos;
+    size_t in_len;
+    uint64_t in_loaded;       // bytes moved into the bit buffer so far
+    uint64_t bitbuf;
+    unsigned bitcnt;
+    unsigned overrun;         // zero bytes padded in after the input ended
+
+    unsigned char window[INFLATE_WINDOW];
+    size_t wpos;
+    uint64_t total_out;
+
+    int state;
+    int last_block;
+    size_t stored_left;
+    size_t copy_len;
+    size_t copy_dist;
+    int error;
+
+    uint16_t lit_table[1u << INFLATE_FAST_BITS];   // symbol | length << 9
+    uint16_t dist_table[1u << INFLATE_FAST_BITS];
+} Inflater;
+
+// `in_offset` is only used for position reporting (the stream's byte offset
+// in the file). Inflater is large (~200 KB); allocate it on the heap.
+void inflate_init(Inflater *d, InflateReadFn read, void *ctx, uint64_t in_offset);
+
+// Decodes up to `cap` bytes, stopping early at the end of a block so callers
+// see every block start. Returns 0 only at the end of the stream or on error.
+size_t inflate_read(Inflater *d, unsigned char *dst, size_t cap);
+
+int inflate_done(const Inflater *d);
+int inflate_error(const Inflater *d);
+
+// True between blocks, the only place a decoder can be resumed from.
+int inflate_at_block_start(const Inflater *d);
+
+// Stream position in bits, counting from in_offset * 8 as given to init.
+uint64_t inflate_bit_position(const Inflater *d);
+
+// Copies the last min(total_out, 32 KB) output bytes, oldest first.
+size_t inflate_window(const Inflater *d, unsigned char *dst);
+
+// Continues at a block start. The caller positions the input so the next
+// read returns the byte holding `bit_position`; `window` is what
+// inflate_window returned there.
+void inflate_resume(
+    Inflater *d,
+    uint64_t bit_position,
+    const unsigned char *window,
+    size_t window_len,
+    uint64_t total_out
+);
+
+// Byte-level access after the final block (for container trailers and
+// headers): drops bits up to the next byte boundary, then reads bytes.
+void inflate_align(Inflater *d);
+int inflate_get_byte(Inflater *d);   // -1 at end of input
+void inflate_restart(Inflater *d);   // begin a new raw stream at the current byte
+
+#endif
@@ -0,0 +1,393 @@
+// Local channel that lets a new launch hand its command line to a running instance
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "instance_ipc.h"
+#include "sys_thread.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define IPC_MAGIC 0x31435045u  // "EPC1"
+#define IPC_HEADER_SIZE 8u
+#define IPC_PATH_MAX 260
+
+#ifdef _WIN32
+typedef HANDLE IpcConn;
+#else
+typedef int IpcConn;
+#endif
+
+struct InstanceServer {
+    char path[IPC_PATH_MAX];
+    InstanceHandlerFn handler;
+    void *ctx;
+    SysThread thread;
+    SysMutex lock;
+    int stopping;
+#ifdef _WIN32
+    HANDLE pipe;
+#else
+    int fd;
+#endif
+};
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v & 0xFFu);
+    p[1] = (unsigned char)((v >> 8) & 0xFFu);
+    p[2] = (unsigned char)((v >> 16) & 0xFFu);
+    p[3] = (unsigned char)((v >> 24) & 0xFFu);
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+#ifdef _WIN32
+
+static int channel_path(const char *name, char *out, size_t cap) {
+    int n = snprintf(out, cap, "\\\\.\\pipe\\%s", name);
+    return n > 0 && (size_t)n < cap;
+}
+
+static int conn_read(IpcConn c, void *buf, size_t len) {
+    unsigned char *p = (unsigned char *)buf;
+    while (len > 0) {
+        DWORD got = 0;
+        if (!ReadFile(c, p, (DWORD)len, &got, NULL) || got == 0) return 0;
+        p += got;
+        len -= got;
+    }
+    return 1;
+}
+
+static int conn_write(IpcConn c, const void *buf, size_t len) {
+    const unsigned char *p = (const unsigned char *)buf;
+    while (len > 0) {
+        DWORD put = 0;
+        if (!WriteFile(c, p, (DWORD)len, &put, NULL) || put == 0) return 0;
+        p += put;
+        len -= put;
+    }
+    return 1;
+}
+
+static void conn_close(IpcConn c) {
+    CloseHandle(c);
+}
+
+static HANDLE create_pipe(const char *path, int first) {
+    DWORD open_mode = PIPE_ACCESS_DUPLEX | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+    return CreateNamedPipeA(
+        path,
+        open_mode,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+        PIPE_UNLIMITED_INSTANCES,
+        4096, 4096, 0, NULL
+    );
+}
+
+static IpcConn client_connect(const char *path, unsigned timeout_ms) {
+    uint64_t deadline = sys_now_us() + (uint64_t)timeout_ms * 1000u;
+    for (;;) {
+        HANDLE h = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        uint64_t now;
+        if (h != INVALID_HANDLE_VALUE) return h;
+        if (GetLastError() != ERROR_PIPE_BUSY) return INVALID_HANDLE_VALUE;
+        now = sys_now_us();
+        if (now >= deadline) return INVALID_HANDLE_VALUE;
+        WaitNamedPipeA(path, (DWORD)((deadline - now) / 1000u) + 1u);
+    }
+}
+
+#define CONN_INVALID(c) ((c) == INVALID_HANDLE_VALUE)
+
+#else
+
+static int channel_path(const char *name, char *out, size_t cap) {
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    int n;
+    if (!dir || !dir[0]) dir = "/tmp";
+    n = snprintf(out, cap, "%s/%s-%u.sock", dir, name, (unsigned)getuid());
+    return n > 0 && (size_t)n < cap && (size_t)n < sizeof(((struct sockaddr_un *)0)->sun_path);
+}
+
+static int conn_read(IpcConn c, void *buf, size_t len) {
+    unsigned char *p = (unsigned char *)buf;
+    while (len > 0) {
+        ssize_t got = read(c, p, len);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return 0;
+        p += got;
+        len -= (size_t)got;
+    }
+    return 1;
+}
+
+static int conn_write(IpcConn c, const void *buf, size_t len) {
+    const unsigned char *p = (const unsigned char *)buf;
+    while (len > 0) {
+#ifdef MSG_NOSIGNAL
+        ssize_t put = send(c, p, len, MSG_NOSIGNAL);
+#else
+        ssize_t put = write(c, p, len);
+#endif
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return 0;
+        p += put;
+        len -= (size_t)put;
+    }
+    return 1;
+}
+
+static void conn_close(IpcConn c) {
+    close(c);
+}
+
+static void set_timeouts(int fd, unsigned timeout_ms) {
+    struct timeval tv;
+    tv.tv_sec = (time_t)(timeout_ms / 1000u);
+    tv.tv_usec = (suseconds_t)((timeout_ms % 1000u) * 1000u);
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static void fill_addr(struct sockaddr_un *addr, const char *path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path, strlen(path) + 1u);
+}
+
+static IpcConn client_connect(const char *path, unsigned timeout_ms) {
+    uint64_t deadline = sys_now_us() + (uint64_t)timeout_ms * 1000u;
+    struct sockaddr_un addr;
+    fill_addr(&addr, path);
+
+    for (;;) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        set_timeouts(fd, timeout_ms);
+        if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) return fd;
+        close(fd);
+        // A full backlog during a burst of launches is worth waiting out.
+        if (errno != EAGAIN && errno != EINTR) return -1;
+        if (sys_now_us() >= deadline) return -1;
+        {
+            struct timespec pause = {0, 1000000L};
+            nanosleep(&pause, NULL);
+        }
+    }
+}
+
+#define CONN_INVALID(c) ((c) < 0)
+
+#endif
+
+static void serve_connection(InstanceServer *server, IpcConn c) {
+    unsigned char header[IPC_HEADER_SIZE];
+    unsigned char ack = 0;
+    uint32_t len;
+    char *payload;
+
+    if (!conn_read(c, header, sizeof(header))) return;
+    if (get_u32(header) != IPC_MAGIC) return;
+    len = get_u32(header + 4);
+    if (len < 2u || len > INSTANCE_IPC_MAX_PAYLOAD) return;
+
+    payload = (char *)malloc(len);
+    if (!payload) return;
+    if (conn_read(c, payload, len) && payload[len - 1u] == '\0') {
+        size_t cwd_len = strlen(payload);
+        if (cwd_len + 1u < len) {
+            server->handler(server->ctx, payload, payload + cwd_len + 1u);
+            ack = 1;
+        }
+    }
+    free(payload);
+    conn_write(c, &ack, 1);
+}
+
+static int is_stopping(InstanceServer *server) {
+    int stopping;
+    sys_mutex_lock(&server->lock);
+    stopping = server->stopping;
+    sys_mutex_unlock(&server->lock);
+    return stopping;
+}
+
+static int server_main(void *arg) {
+    InstanceServer *server = (InstanceServer *)arg;
+#ifdef _WIN32
+    for (;;) {
+        BOOL connected = ConnectNamedPipe(server->pipe, NULL) ? TRUE : (GetLastError() == ERROR_PIPE_CONNECTED);
+        if (is_stopping(server)) break;
+        if (connected) {
+            serve_connection(server, server->pipe);
+            FlushFileBuffers(server->pipe);
+        }
+        DisconnectNamedPipe(server->pipe);
+    }
+#else
+    for (;;) {
+        int c = accept(server->fd, NULL, NULL);
+        if (c < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        if (is_stopping(server)) {
+            close(c);
+            break;
+        }
+        set_timeouts(c, 2000u);
+        serve_connection(server, c);
+        close(c);
+    }
+#endif
+    return 0;
+}
+
+InstanceServer *instance_server_start(const char *name, InstanceHandlerFn handler, void *ctx) {
+    InstanceServer *server;
+
+    if (!name || !handler) return NULL;
+    server = (InstanceServer *)calloc(1, sizeof(*server));
+    if (!server) return NULL;
+    if (!channel_path(name, server->path, sizeof(server->path))) {
+        free(server);
+        return NULL;
+    }
+    server->handler = handler;
+    server->ctx = ctx;
+
+#ifdef _WIN32
+    // FILE_FLAG_FIRST_PIPE_INSTANCE fails when another process owns the name.
+    server->pipe = create_pipe(server->path, 1);
+    if (server->pipe == INVALID_HANDLE_VALUE) {
+        free(server);
+        return NULL;
+    }
+#else
+    {
+        struct sockaddr_un addr;
+        fill_addr(&addr, server->path);
+        server->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server->fd < 0) {
+            free(server);
+            return NULL;
+        }
+        if (bind(server->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            int probe;
+            if (errno != EADDRINUSE) goto fail_socket;
+            // Live owner, or a socket file left behind by a crash?
+            probe = client_connect(server->path, 0);
+            if (probe >= 0) {
+                close(probe);
+                goto fail_socket;
+            }
+            unlink(server->path);
+            if (bind(server->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) goto fail_socket;
+        }
+        chmod(server->path, S_IRUSR | S_IWUSR);
+        if (listen(server->fd, 16) != 0) {
+            unlink(server->path);
+            goto fail_socket;
+        }
+    }
+#endif
+
+    if (!sys_mutex_init(&server->lock)) goto fail_channel;
+    if (!sys_thread_start(&server->thread, server_main, server)) {
+        sys_mutex_destroy(&server->lock);
+        goto fail_channel;
+    }
+    return server;
+
+fail_channel:
+#ifdef _WIN32
+    CloseHandle(server->pipe);
+#else
+    unlink(server->path);
+#endif
+#ifndef _WIN32
+fail_socket:
+    close(server->fd);
+#endif
+    free(server);
+    return NULL;
+}
+
+void instance_server_stop(InstanceServer *server) {
+    IpcConn wake;
+    if (!server) return;
+
+    sys_mutex_lock(&server->lock);
+    server->stopping = 1;
+    sys_mutex_unlock(&server->lock);
+
+    // Unblock ConnectNamedPipe/accept with a connection of our own.
+    wake = client_connect(server->path, 1000u);
+    if (!CONN_INVALID(wake)) conn_close(wake);
+    sys_thread_join(&server->thread);
+
+#ifdef _WIN32
+    CloseHandle(server->pipe);
+#else
+    close(server->fd);
+    unlink(server->path);
+#endif
+    sys_mutex_destroy(&server->lock);
+    free(server);
+}
+
+int instance_send(const char *name, const char *cwd, const char *cmdline, unsigned timeout_ms) {
+    char path[IPC_PATH_MAX];
+    unsigned char *msg;
+    size_t cwd_len;
+    size_t cmd_len;
+    size_t payload_len;
+    unsigned char ack = 0;
+    IpcConn c;
+    int ok;
+
+    if (!name) return 0;
+    if (!cwd) cwd = "";
+    if (!cmdline) cmdline = "";
+    cwd_len = strlen(cwd);
+    cmd_len = strlen(cmdline);
+    payload_len = cwd_len + cmd_len + 2u;
+    if (payload_len > INSTANCE_IPC_MAX_PAYLOAD) return 0;
+    if (!channel_path(name, path, sizeof(path))) return 0;
+
+    msg = (unsigned char *)malloc(IPC_HEADER_SIZE + payload_len);
+    if (!msg) return 0;
+    put_u32(msg, IPC_MAGIC);
+    put_u32(msg + 4, (uint32_t)payload_len);
+    memcpy(msg + IPC_HEADER_SIZE, cwd, cwd_len + 1u);
+    memcpy(msg + IPC_HEADER_SIZE + cwd_len + 1u, cmdline, cmd_len + 1u);
+
+    c = client_connect(path, timeout_ms);
+    if (CONN_INVALID(c)) {
+        free(msg);
+        return 0;
+    }
+    ok = conn_write(c, msg, IPC_HEADER_SIZE + payload_len) && conn_read(c, &ack, 1) && ack == 1;
+    conn_close(c);
+    free(msg);
+    return ok;
+}
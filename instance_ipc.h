@@ -0,0 +1,29 @@
+// Local channel that lets a new launch hand its command line to a running instance
+// Windows: named pipe \\.\pipe\<name>. Elsewhere: Unix domain socket in
+// $XDG_RUNTIME_DIR (or /tmp) named <name>-<uid>.sock.
+//
+// Request: magic u32 | payload_len u32 | cwd NUL cmdline NUL (little-endian)
+// Reply:   one byte, 1 when the running instance accepted the request
+
+#ifndef INSTANCE_IPC_H
+#define INSTANCE_IPC_H
+
+#include <stddef.h>
+
+#define INSTANCE_IPC_MAX_PAYLOAD (64u * 1024u)
+
+// Called on the server's thread; both strings are only valid during the call.
+typedef void (*InstanceHandlerFn)(void *ctx, const char *cwd, const char *cmdline);
+
+typedef struct InstanceServer InstanceServer;
+
+// Claims `name` and starts accepting requests. Returns NULL when another
+// live instance already owns the name (or the channel cannot be created).
+InstanceServer *instance_server_start(const char *name, InstanceHandlerFn handler, void *ctx);
+void instance_server_stop(InstanceServer *server);
+
+// Delivers one request. Returns 1 once the running instance acknowledged it,
+// 0 when there is nobody listening or it did not answer within `timeout_ms`.
+int instance_send(const char *name, const char *cwd, const char *cmdline, unsigned timeout_ms);
+
+#endif
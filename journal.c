@@ -0,0 +1,624 @@
+// Append-only edit journal used to recover unsaved work after a crash
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "journal.h"
+#include "mem_account.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "crc32.h"
+#include "sys_thread.h"
+
+#define JOURNAL_HEADER_SIZE 24u
+#define JOURNAL_RECORD_HEADER_SIZE 40u
+#define JOURNAL_RECORD_MAGIC 0x31524445u
+#define JOURNAL_MAX_PAYLOAD (1u << 30)
+#define JOURNAL_BATCH_BYTES (256u * 1024u)
+
+static const char JOURNAL_MAGIC[8] = {'E', 'D', 'J', 'R', 'N', 'L', '0', '2'};
+
+struct JournalWriter {
+    FILE *file;
+    char *path;
+    SysMutex lock;
+    SysCond wake;
+    SysCond drained;
+    SysThread thread;
+    unsigned char *pending;
+    size_t pending_len;
+    size_t pending_cap;
+    uint64_t pending_records;
+    unsigned char *spare;
+    size_t spare_cap;
+    uint64_t next_seq;
+    uint64_t edits;
+    unsigned batch_ms;
+    int stop;
+    int busy;
+    int failed;
+    int flush_requested;
+    uint64_t records_written;
+    uint64_t bytes_written;
+    uint64_t batches;
+};
+
+typedef struct {
+    uint32_t insert_len;
+    uint64_t seq;
+    uint64_t offset;
+    uint64_t delete_len;
+    uint64_t doc_len;
+} RecordHeader;
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+static int sync_file(FILE *f) {
+    if (fflush(f) != 0) return 0;
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+static int truncate_file(FILE *f, uint64_t size) {
+#ifdef _WIN32
+    return _chsize_s(_fileno(f), (__int64)size) == 0;
+#else
+    return ftruncate(fileno(f), (off_t)size) == 0;
+#endif
+}
+
+static int write_header(FILE *f, uint64_t base_len, uint32_t base_crc) {
+    unsigned char h[JOURNAL_HEADER_SIZE];
+    memcpy(h, JOURNAL_MAGIC, 8);
+    put_u64(h + 8, base_len);
+    put_u32(h + 16, base_crc);
+    put_u32(h + 20, crc32_update(0, h, 20));
+    return fwrite(h, 1, sizeof(h), f) == sizeof(h) && sync_file(f);
+}
+
+static int writer_main(void *arg) {
+    JournalWriter *w = (JournalWriter *)arg;
+
+    sys_mutex_lock(&w->lock);
+    for (;;) {
+        unsigned char *batch;
+        size_t batch_len;
+        uint64_t batch_records;
+        int ok;
+        int failed;
+
+        while (w->pending_len == 0 && !w->stop) {
+            sys_cond_wait(&w->wake, &w->lock);
+        }
+        if (w->pending_len == 0) break;
+
+        // Give the typist a moment so several keystrokes share one write and sync.
+        if (!w->stop && !w->flush_requested && w->pending_len < JOURNAL_BATCH_BYTES) {
+            sys_cond_timedwait(&w->wake, &w->lock, w->batch_ms);
+        }
+
+        batch = w->pending;
+        batch_len = w->pending_len;
+        batch_records = w->pending_records;
+        w->pending = w->spare;
+        w->spare = batch;
+        {
+            size_t cap = w->pending_cap;
+            w->pending_cap = w->spare_cap;
+            w->spare_cap = cap;
+        }
+        w->pending_len = 0;
+        w->pending_records = 0;
+        w->busy = 1;
+        failed = w->failed;
+        sys_mutex_unlock(&w->lock);
+
+        ok = !failed && fwrite(batch, 1, batch_len, w->file) == batch_len && sync_file(w->file);
+
+        sys_mutex_lock(&w->lock);
+        w->busy = 0;
+        if (ok) {
+            w->records_written += batch_records;
+            w->bytes_written += batch_len;
+            w->batches++;
+        } else {
+            w->failed = 1;
+        }
+        sys_cond_broadcast(&w->drained);
+    }
+    sys_mutex_unlock(&w->lock);
+    return 0;
+}
+
+static JournalWriter *start_writer(FILE *f, const char *path, uint64_t next_seq, unsigned batch_ms) {
+    JournalWriter *w = (JournalWriter *)calloc(1, sizeof(*w));
+    size_t n = strlen(path) + 1u;
+    if (!w) return NULL;
+
+    w->path = (char *)malloc(n);
+    if (!w->path) {
+        free(w);
+        return NULL;
+    }
+    memcpy(w->path, path, n);
+    w->file = f;
+    w->next_seq = next_seq;
+    w->batch_ms = batch_ms ? batch_ms : 1u;
+
+    sys_mutex_init(&w->lock);
+    sys_cond_init(&w->wake);
+    sys_cond_init(&w->drained);
+    if (!sys_thread_start(&w->thread, writer_main, w)) {
+        sys_cond_destroy(&w->drained);
+        sys_cond_destroy(&w->wake);
+        sys_mutex_destroy(&w->lock);
+        free(w->path);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+JournalWriter *journal_create(const char *path, uint64_t base_len, uint32_t base_crc, unsigned batch_ms) {
+    JournalWriter *w;
+    FILE *f;
+    if (!path) return NULL;
+
+    f = fopen(path, "wb");
+    if (!f) return NULL;
+    if (!write_header(f, base_len, base_crc)) {
+        fclose(f);
+        remove(path);
+        return NULL;
+    }
+    w = start_writer(f, path, 0, batch_ms);
+    if (!w) {
+        fclose(f);
+        remove(path);
+    }
+    return w;
+}
+
+JournalWriter *journal_resume(const char *path, const JournalInfo *info, unsigned batch_ms) {
+    JournalWriter *w;
+    FILE *f;
+    if (!path || !info) return NULL;
+
+    f = fopen(path, "r+b");
+    if (!f) return NULL;
+    if (!truncate_file(f, info->valid_bytes) || fseek(f, 0, SEEK_END) != 0) {
+        fclose(f);
+        return NULL;
+    }
+    w = start_writer(f, path, info->next_seq, batch_ms);
+    if (!w) {
+        fclose(f);
+        return NULL;
+    }
+    w->edits = info->records;
+    return w;
+}
+
+static int reserve_pending(JournalWriter *w, size_t extra) {
+    size_t need = w->pending_len + extra;
+    size_t cap = w->pending_cap ? w->pending_cap : 4096u;
+    unsigned char *grown;
+    if (need <= w->pending_cap) return 1;
+    while (cap < need) cap *= 2u;
+    grown = (unsigned char *)realloc(w->pending, cap);
+    if (!grown) return 0;
+    mem_account_alloc(MEM_UNDO, cap - w->pending_cap);
+    w->pending = grown;
+    w->pending_cap = cap;
+    return 1;
+}
+
+static int queue_record(JournalWriter *w, uint64_t offset, uint64_t delete_len, const char *text, uint32_t text_len, uint64_t doc_len) {
+    unsigned char *p;
+    uint32_t crc;
+
+    if (!reserve_pending(w, JOURNAL_RECORD_HEADER_SIZE + (size_t)text_len + 4u)) return 0;
+    p = w->pending + w->pending_len;
+    put_u32(p, JOURNAL_RECORD_MAGIC);
+    put_u32(p + 4, text_len);
+    put_u64(p + 8, w->next_seq);
+    put_u64(p + 16, offset);
+    put_u64(p + 24, delete_len);
+    put_u64(p + 32, doc_len);
+    if (text_len) {
+        memcpy(p + JOURNAL_RECORD_HEADER_SIZE, text, text_len);
+    }
+    crc = crc32_update(0, p, JOURNAL_RECORD_HEADER_SIZE + (size_t)text_len);
+    put_u32(p + JOURNAL_RECORD_HEADER_SIZE + text_len, crc);
+
+    w->pending_len += JOURNAL_RECORD_HEADER_SIZE + (size_t)text_len + 4u;
+    w->pending_records++;
+    w->next_seq++;
+    return 1;
+}
+
+int journal_append(JournalWriter *w, uint64_t offset, uint64_t delete_len, const char *text, size_t text_len, uint64_t doc_len) {
+    int was_idle;
+    int ok = 1;
+    if (!w) return 0;
+
+    sys_mutex_lock(&w->lock);
+    if (w->failed) {
+        sys_mutex_unlock(&w->lock);
+        return 0;
+    }
+    was_idle = (w->pending_len == 0);
+
+    // Payloads above 1 GiB are split; the tail pieces are plain inserts, and
+    // each piece records the length without the pieces still to come.
+    do {
+        uint32_t piece = text_len > JOURNAL_MAX_PAYLOAD ? JOURNAL_MAX_PAYLOAD : (uint32_t)text_len;
+        ok = queue_record(w, offset, delete_len, text, piece, doc_len - (text_len - piece));
+        offset += piece;
+        delete_len = 0;
+        text += piece;
+        text_len -= piece;
+    } while (ok && text_len > 0);
+
+    if (!ok) {
+        w->failed = 1;
+    }
+    w->edits++;
+    if (was_idle || w->pending_len >= JOURNAL_BATCH_BYTES) {
+        sys_cond_signal(&w->wake);
+    }
+    sys_mutex_unlock(&w->lock);
+    return ok;
+}
+
+int journal_flush(JournalWriter *w) {
+    int ok;
+    if (!w) return 0;
+
+    sys_mutex_lock(&w->lock);
+    w->flush_requested = 1;
+    sys_cond_signal(&w->wake);
+    while ((w->pending_len > 0 || w->busy) && !w->failed) {
+        sys_cond_wait(&w->drained, &w->lock);
+    }
+    w->flush_requested = 0;
+    ok = !w->failed;
+    sys_mutex_unlock(&w->lock);
+    return ok;
+}
+
+int journal_compact(JournalWriter *w, uint64_t base_len, uint32_t base_crc) {
+    FILE *f;
+    int ok;
+    if (!w) return 0;
+
+    journal_flush(w);
+
+    sys_mutex_lock(&w->lock);
+    // Everything before this point is covered by the saved file.
+    w->pending_len = 0;
+    w->pending_records = 0;
+    fclose(w->file);
+    f = fopen(w->path, "wb");
+    w->file = f;
+    ok = f && write_header(f, base_len, base_crc);
+    if (!f) {
+        // The writer thread must never see a NULL stream.
+        w->file = fopen(w->path, "ab");
+    }
+    w->failed = !ok || !w->file;
+    w->next_seq = 0;
+    w->edits = 0;
+    sys_mutex_unlock(&w->lock);
+    return ok;
+}
+
+uint64_t journal_pending_edits(const JournalWriter *w) {
+    return w ? w->edits : 0;
+}
+
+void journal_stats(JournalWriter *w, uint64_t *records, uint64_t *bytes, uint64_t *batches) {
+    if (!w) return;
+    sys_mutex_lock(&w->lock);
+    if (records) *records = w->records_written;
+    if (bytes) *bytes = w->bytes_written;
+    if (batches) *batches = w->batches;
+    sys_mutex_unlock(&w->lock);
+}
+
+void journal_close(JournalWriter *w, int discard) {
+    if (!w) return;
+
+    sys_mutex_lock(&w->lock);
+    w->stop = 1;
+    sys_cond_signal(&w->wake);
+    sys_mutex_unlock(&w->lock);
+    sys_thread_join(&w->thread);
+
+    if (w->file) {
+        fclose(w->file);
+    }
+    if (discard) {
+        remove(w->path);
+    }
+    sys_cond_destroy(&w->drained);
+    sys_cond_destroy(&w->wake);
+    sys_mutex_destroy(&w->lock);
+    mem_account_free(MEM_UNDO, w->pending_cap + w->spare_cap);
+    free(w->pending);
+    free(w->spare);
+    free(w->path);
+    free(w);
+}
+
+// Gap buffer: replayed edits cluster around the caret, so moving the gap is
+// far cheaper than shifting the whole document for every record.
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t gap_start;
+    size_t gap_end;
+} GapText;
+
+static size_t gap_len(const GapText *g) {
+    return g->cap - (g->gap_end - g->gap_start);
+}
+
+static void gap_move(GapText *g, size_t pos) {
+    if (pos < g->gap_start) {
+        size_t n = g->gap_start - pos;
+        memmove(g->buf + g->gap_end - n, g->buf + pos, n);
+        g->gap_start -= n;
+        g->gap_end -= n;
+    } else if (pos > g->gap_start) {
+        size_t n = pos - g->gap_start;
+        memmove(g->buf + g->gap_start, g->buf + g->gap_end, n);
+        g->gap_start += n;
+        g->gap_end += n;
+    }
+}
+
+static int gap_reserve(GapText *g, size_t n) {
+    size_t len = gap_len(g);
+    size_t tail = g->cap - g->gap_end;
+    size_t cap;
+    char *grown;
+    if (g->gap_end - g->gap_start >= n) return 1;
+
+    cap = g->cap * 2u;
+    if (cap < len + n + 65536u) cap = len + n + 65536u;
+    grown = (char *)malloc(cap);
+    if (!grown) return 0;
+    memcpy(grown, g->buf, g->gap_start);
+    memcpy(grown + cap - tail, g->buf + g->gap_end, tail);
+    free(g->buf);
+    g->buf = grown;
+    g->gap_end = cap - tail;
+    g->cap = cap;
+    return 1;
+}
+
+static int gap_replace(GapText *g, uint64_t offset, uint64_t delete_len, const unsigned char *text, size_t text_len) {
+    if (delete_len == JOURNAL_DELETE_ALL) {
+        offset = 0;
+        delete_len = gap_len(g);
+    }
+    gap_move(g, (size_t)offset);
+    g->gap_end += (size_t)delete_len;
+    if (text_len == 0) return 1;
+    if (!gap_reserve(g, text_len)) return 0;
+    memcpy(g->buf + g->gap_start, text, text_len);
+    g->gap_start += text_len;
+    return 1;
+}
+
+static int read_journal_header(FILE *f, JournalInfo *info) {
+    unsigned char h[JOURNAL_HEADER_SIZE];
+    if (fread(h, 1, sizeof(h), f) != sizeof(h)) return JOURNAL_BAD_HEADER;
+    if (memcmp(h, JOURNAL_MAGIC, 8) != 0) return JOURNAL_BAD_HEADER;
+    if (get_u32(h + 20) != crc32_update(0, h, 20)) return JOURNAL_BAD_HEADER;
+
+    memset(info, 0, sizeof(*info));
+    info->base_len = get_u64(h + 8);
+    info->base_crc = get_u32(h + 16);
+    info->valid_bytes = JOURNAL_HEADER_SIZE;
+    return JOURNAL_OK;
+}
+
+// 64-bit seek and tell, so sizes past 2 GiB work.
+static uint64_t file_size_of(FILE *f) {
+#ifdef _WIN32
+    __int64 size;
+    if (_fseeki64(f, 0, SEEK_END) != 0) return 0;
+    size = _ftelli64(f);
+#else
+    off_t size;
+    if (fseeko(f, 0, SEEK_END) != 0) return 0;
+    size = ftello(f);
+#endif
+    return size < 0 ? 0 : (uint64_t)size;
+}
+
+static int seek_to(FILE *f, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(f, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// Walks the intact prefix of the journal. With `g` the records are applied.
+static int walk_records(FILE *f, JournalInfo *info, GapText *g) {
+    unsigned char h[JOURNAL_RECORD_HEADER_SIZE];
+    unsigned char crc_bytes[4];
+    unsigned char *payload = NULL;
+    size_t payload_cap = 0;
+    uint64_t doc_len = info->base_len;
+    uint64_t size = file_size_of(f);
+    int status = JOURNAL_OK;
+
+    if (!seek_to(f, info->valid_bytes)) return JOURNAL_IO_ERROR;
+    for (;;) {
+        RecordHeader rh;
+        uint32_t crc;
+
+        if (fread(h, 1, sizeof(h), f) != sizeof(h)) break;
+        if (get_u32(h) != JOURNAL_RECORD_MAGIC) break;
+        rh.insert_len = get_u32(h + 4);
+        rh.seq = get_u64(h + 8);
+        rh.offset = get_u64(h + 16);
+        rh.delete_len = get_u64(h + 24);
+        rh.doc_len = get_u64(h + 32);
+        if (rh.seq != info->next_seq || rh.insert_len > JOURNAL_MAX_PAYLOAD) break;
+        // A payload running past the end of the file is a torn or corrupt
+        // header; stop here rather than allocate what it claims.
+        if (size - info->valid_bytes < JOURNAL_RECORD_HEADER_SIZE + (uint64_t)rh.insert_len + 4u) break;
+
+        if (rh.insert_len > payload_cap) {
+            unsigned char *grown = (unsigned char *)realloc(payload, rh.insert_len);
+            if (!grown) {
+                status = JOURNAL_NO_MEMORY;
+                break;
+            }
+            payload = grown;
+            payload_cap = rh.insert_len;
+        }
+        if (fread(payload, 1, rh.insert_len, f) != rh.insert_len) break;
+        if (fread(crc_bytes, 1, 4, f) != 4) break;
+        crc = crc32_update(crc32_update(0, h, sizeof(h)), payload, rh.insert_len);
+        if (crc != get_u32(crc_bytes)) break;
+
+        if (rh.delete_len == JOURNAL_DELETE_ALL) {
+            doc_len = rh.insert_len;
+        } else {
+            if (rh.offset > doc_len || rh.delete_len > doc_len - rh.offset) {
+                info->diverged = 1;
+                break;
+            }
+            doc_len = doc_len - rh.delete_len + rh.insert_len;
+        }
+        if (doc_len != rh.doc_len) {
+            info->diverged = 1;
+            break;
+        }
+        if (g && !gap_replace(g, rh.offset, rh.delete_len, payload, rh.insert_len)) {
+            status = JOURNAL_NO_MEMORY;
+            break;
+        }
+
+        info->records++;
+        info->next_seq++;
+        info->valid_bytes += JOURNAL_RECORD_HEADER_SIZE + (uint64_t)rh.insert_len + 4u;
+    }
+    free(payload);
+    return status;
+}
+
+static uint64_t torn_bytes_of(FILE *f, uint64_t valid_bytes) {
+    uint64_t size = file_size_of(f);
+    return size > valid_bytes ? size - valid_bytes : 0;
+}
+
+int journal_scan(const char *path, JournalInfo *info) {
+    FILE *f;
+    int status;
+    if (!path || !info) return JOURNAL_MISSING;
+
+    f = fopen(path, "rb");
+    if (!f) return JOURNAL_MISSING;
+    status = read_journal_header(f, info);
+    if (status == JOURNAL_OK) {
+        status = walk_records(f, info, NULL);
+        info->torn_bytes = torn_bytes_of(f, info->valid_bytes);
+    }
+    fclose(f);
+    return status;
+}
+
+int journal_replay(const char *path, const char *base, size_t base_len, char **out_text, size_t *out_len, JournalInfo *info) {
+    GapText g = {0};
+    FILE *f;
+    char *text;
+    size_t len;
+    int status;
+
+    if (!path || !out_text || !out_len || !info) return JOURNAL_MISSING;
+    *out_text = NULL;
+    *out_len = 0;
+
+    f = fopen(path, "rb");
+    if (!f) return JOURNAL_MISSING;
+    status = read_journal_header(f, info);
+    if (status != JOURNAL_OK) {
+        fclose(f);
+        return status;
+    }
+    if (info->base_len != (uint64_t)base_len || info->base_crc != crc32_update(0, base, base_len)) {
+        fclose(f);
+        return JOURNAL_BASE_MISMATCH;
+    }
+
+    g.cap = base_len + 65536u;
+    g.buf = (char *)malloc(g.cap);
+    if (!g.buf) {
+        fclose(f);
+        return JOURNAL_NO_MEMORY;
+    }
+    memcpy(g.buf, base, base_len);
+    g.gap_start = base_len;
+    g.gap_end = g.cap;
+
+    status = walk_records(f, info, &g);
+    info->torn_bytes = torn_bytes_of(f, info->valid_bytes);
+    fclose(f);
+    if (status != JOURNAL_OK) {
+        free(g.buf);
+        return status;
+    }
+
+    len = gap_len(&g);
+    gap_move(&g, len);
+    if (!gap_reserve(&g, 1)) {
+        free(g.buf);
+        return JOURNAL_NO_MEMORY;
+    }
+    text = (char *)realloc(g.buf, len + 1u);
+    if (!text) {
+        text = g.buf;
+    }
+    text[len] = '\0';
+    *out_text = text;
+    *out_len = len;
+    return JOURNAL_OK;
+}
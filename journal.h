@@ -0,0 +1,76 @@
+// Append-only edit journal used to recover unsaved work after a crash
+//
+// Layout (all integers little-endian):
+//   header  "EDJRNL02" | base_len u64 | base_crc u32 | header_crc u32
+//   record  magic u32 | insert_len u32 | seq u64 | offset u64 | delete_len u64 | doc_len u64 | payload | crc u32
+// A record replaces [offset, offset + delete_len) with its payload; delete_len
+// JOURNAL_DELETE_ALL replaces the whole document. doc_len is the length the
+// document had after the edit. Replay stops at the first record that is
+// short, fails its checksum or is out of sequence, so a torn tail from a
+// crash mid-write is simply ignored. It also stops where the document length
+// disagrees with doc_len: an edit was missed, and applying later offsets to
+// the wrong text would only produce garbage.
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JOURNAL_DELETE_ALL UINT64_MAX
+
+enum {
+    JOURNAL_OK = 0,
+    JOURNAL_MISSING,
+    JOURNAL_BAD_HEADER,
+    JOURNAL_BASE_MISMATCH,
+    JOURNAL_NO_MEMORY,
+    JOURNAL_IO_ERROR
+};
+
+typedef struct {
+    uint64_t base_len;
+    uint32_t base_crc;
+    uint64_t records;
+    uint64_t next_seq;
+    uint64_t valid_bytes;
+    uint64_t torn_bytes;
+    int diverged;          // replay stopped at a record that did not fit
+} JournalInfo;
+
+typedef struct JournalWriter JournalWriter;
+
+// Starts a fresh journal at `path` for a document whose saved text has the
+// given length and CRC-32. Records are batched for up to `batch_ms` and
+// written and synced by a background thread.
+JournalWriter *journal_create(const char *path, uint64_t base_len, uint32_t base_crc, unsigned batch_ms);
+
+// Reopens a journal after journal_replay, dropping any torn tail it reported.
+JournalWriter *journal_resume(const char *path, const JournalInfo *info, unsigned batch_ms);
+
+// Queues one edit; `doc_len` is the document length after it. Returns 0
+// once the writer has failed (disk full, etc.).
+int journal_append(JournalWriter *w, uint64_t offset, uint64_t delete_len, const char *text, size_t text_len, uint64_t doc_len);
+
+// Blocks until everything queued so far is on disk.
+int journal_flush(JournalWriter *w);
+
+// Call after a real save: restarts the journal against the new saved text.
+int journal_compact(JournalWriter *w, uint64_t base_len, uint32_t base_crc);
+
+// Number of edits queued since creation or the last compaction.
+uint64_t journal_pending_edits(const JournalWriter *w);
+
+void journal_stats(JournalWriter *w, uint64_t *records, uint64_t *bytes, uint64_t *batches);
+
+// Stops the writer. With `discard` the journal file is deleted.
+void journal_close(JournalWriter *w, int discard);
+
+// Reads the header and counts intact records without applying them.
+int journal_scan(const char *path, JournalInfo *info);
+
+// Applies the journal to `base`. On JOURNAL_OK `*out_text` is a malloc'd,
+// NUL-terminated copy of the recovered document.
+int journal_replay(const char *path, const char *base, size_t base_len, char **out_text, size_t *out_len, JournalInfo *info);
+
+#endif
@@ -0,0 +1,417 @@
+// Streaming JSON pretty-printer and minifier
+
+#include "json_format.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#define JSON_BLOCK 16u
+
+enum {
+    G_VALUE = 0,        // a value must follow (after ':' or ',' in an array)
+    G_ARRAY_FIRST,      // after '[': a value or ']'
+    G_OBJECT_FIRST,     // after '{': a key or '}'
+    G_KEY,              // after ',' in an object
+    G_COLON,
+    G_AFTER_VALUE,      // ',' or a close; at depth 0, another top-level value
+};
+
+enum { LEX_NONE = 0, LEX_STRING, LEX_ESCAPE, LEX_UNICODE, LEX_LITERAL };
+
+// Number DFA (RFC 8259 grammar); N_START is only ever left.
+enum { N_START = 0, N_SIGN, N_ZERO, N_INT, N_DOT, N_FRAC, N_E, N_ESIGN, N_EXP, N_BAD };
+
+static const char INDENT_SPACES[] = "                                ";
+static const char INDENT_TABS[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+
+#ifdef JSON_SSE2
+static unsigned lowest_bit(unsigned m) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctz(m);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, m);
+    return (unsigned)index;
+#else
+    unsigned n = 0;
+    while (!(m & 1u)) {
+        m >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+#endif
+
+// Length of the plain run at `p`: bytes other than '"', '\\' and controls.
+static size_t string_run(const unsigned char *p, size_t len) {
+    size_t i = 0;
+#ifdef JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    for (; i + JSON_BLOCK <= len; i += JSON_BLOCK) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash));
+        unsigned m;
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));   // v <= 0x1F
+        m = (unsigned)_mm_movemask_epi8(hit);
+        if (m) return i + lowest_bit(m);
+    }
+#endif
+    while (i < len && p[i] != '"' && p[i] != '\\' && p[i] >= 0x20) i++;
+    return i;
+}
+
+static int fail(JsonFormatter *f, size_t at, const char *msg) {
+    if (!f->error) {
+        f->error = msg;
+        f->error_offset = f->offset + at;
+    }
+    return 0;
+}
+
+static void flush(JsonFormatter *f) {
+    if (f->used == 0 || f->error) return;
+    if (!f->sink(f->ctx, f->out, f->used)) {
+        f->error = "output stopped";
+        f->error_offset = f->offset;
+    }
+    f->written += f->used;
+    f->used = 0;
+}
+
+static void put(JsonFormatter *f, const void *data, size_t len) {
+    const char *p = (const char *)data;
+    while (len > 0) {
+        size_t n = JSON_OUT_BUFFER - f->used;
+        if (n > len) n = len;
+        memcpy(f->out + f->used, p, n);
+        f->used += n;
+        p += n;
+        len -= n;
+        if (f->used == JSON_OUT_BUFFER) flush(f);
+    }
+}
+
+static void put_byte(JsonFormatter *f, char c) {
+    f->out[f->used++] = c;
+    if (f->used == JSON_OUT_BUFFER) flush(f);
+}
+
+static void new_line(JsonFormatter *f, unsigned depth) {
+    const char *fill = f->indent ? INDENT_SPACES : INDENT_TABS;
+    size_t fill_len = f->indent ? sizeof(INDENT_SPACES) - 1u : sizeof(INDENT_TABS) - 1u;
+    uint64_t left = (uint64_t)depth * (f->indent ? f->indent : 1u);
+
+    put(f, f->eol, f->eol_len);
+    while (left > 0) {
+        size_t n = left < fill_len ? (size_t)left : fill_len;
+        put(f, fill, n);
+        left -= n;
+    }
+}
+
+static int is_object(const JsonFormatter *f, unsigned depth) {
+    return (f->objects[depth / 8u] >> (depth % 8u)) & 1u;
+}
+
+static void value_done(JsonFormatter *f) {
+    f->state = G_AFTER_VALUE;
+    if (f->depth == 0) f->values++;
+}
+
+// Checks that a value may start here and lays out what goes before it.
+static int begin_value(JsonFormatter *f, size_t at) {
+    if (f->state == G_AFTER_VALUE && f->depth == 0) {
+        if (f->values > 0) put(f, f->eol, f->eol_len);
+    } else if (f->state == G_COLON) {
+        return fail(f, at, "expected ':'");
+    } else if (f->state == G_AFTER_VALUE) {
+        return fail(f, at, "expected ',' or a close");
+    } else if (f->state != G_VALUE && f->state != G_ARRAY_FIRST) {
+        return fail(f, at, "expected a string key");
+    }
+    if (f->pending_open) {
+        new_line(f, f->depth);
+        f->pending_open = 0;
+    }
+    return 1;
+}
+
+static int open_container(JsonFormatter *f, size_t at, char c) {
+    unsigned depth = f->depth;
+    if (!begin_value(f, at)) return 0;
+    if (depth >= JSON_MAX_DEPTH) return fail(f, at, "nesting too deep");
+    if (c == '{') {
+        f->objects[depth / 8u] |= (unsigned char)(1u << (depth % 8u));
+        f->state = G_OBJECT_FIRST;
+    } else {
+        f->objects[depth / 8u] &= (unsigned char)~(1u << (depth % 8u));
+        f->state = G_ARRAY_FIRST;
+    }
+    f->depth++;
+    put_byte(f, c);
+    f->pending_open = f->mode == JSON_PRETTY;
+    return 1;
+}
+
+static int close_container(JsonFormatter *f, size_t at, char c) {
+    int object = c == '}';
+    int empty = f->state == (object ? G_OBJECT_FIRST : G_ARRAY_FIRST);
+
+    if (f->depth == 0) return fail(f, at, "unbalanced close");
+    if (is_object(f, f->depth - 1u) != object) return fail(f, at, object ? "'}' closes an array" : "']' closes an object");
+    if (!empty && f->state != G_AFTER_VALUE) return fail(f, at, "expected a value");
+    f->depth--;
+    if (f->pending_open) {
+        f->pending_open = 0;
+    } else if (f->mode == JSON_PRETTY) {
+        new_line(f, f->depth);
+    }
+    put_byte(f, c);
+    value_done(f);
+    return 1;
+}
+
+static unsigned number_step(unsigned s, unsigned c) {
+    int digit = c >= '0' && c <= '9';
+    switch (s) {
+        case N_START:
+            if (c == '-') return N_SIGN;
+            return c == '0' ? N_ZERO : digit ? N_INT : N_BAD;
+        case N_SIGN:
+            return c == '0' ? N_ZERO : digit ? N_INT : N_BAD;
+        case N_ZERO:
+            return c == '.' ? N_DOT : (c == 'e' || c == 'E') ? N_E : N_BAD;
+        case N_INT:
+            return digit ? N_INT : c == '.' ? N_DOT : (c == 'e' || c == 'E') ? N_E : N_BAD;
+        case N_DOT:
+        case N_FRAC:
+            return digit ? N_FRAC : (s == N_FRAC && (c == 'e' || c == 'E')) ? N_E : N_BAD;
+        case N_E:
+            return (c == '+' || c == '-') ? N_ESIGN : digit ? N_EXP : N_BAD;
+        case N_ESIGN:
+        case N_EXP:
+            return digit ? N_EXP : N_BAD;
+        default:
+            return N_BAD;
+    }
+}
+
+static int is_literal_byte(unsigned c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '+' || c == '-' || c == '.';
+}
+
+static int literal_step(JsonFormatter *f, size_t at, unsigned c) {
+    if (f->number) {
+        f->lit_state = number_step(f->lit_state, c);
+        if (f->lit_state == N_BAD) return fail(f, at, "invalid number");
+    } else if (f->lit_word[f->lit_state] != (char)c) {
+        return fail(f, at, "invalid literal");
+    } else {
+        f->lit_state++;
+    }
+    return 1;
+}
+
+static int end_literal(JsonFormatter *f, size_t at) {
+    f->lex = LEX_NONE;
+    if (f->number) {
+        unsigned s = f->lit_state;
+        if (s != N_ZERO && s != N_INT && s != N_FRAC && s != N_EXP) return fail(f, at, "invalid number");
+    } else if (f->lit_word[f->lit_state] != '\0') {
+        return fail(f, at, "invalid literal");
+    }
+    value_done(f);
+    return 1;
+}
+
+static int begin_literal(JsonFormatter *f, size_t at, unsigned c) {
+    int number = c == '-' || (c >= '0' && c <= '9');
+    const char *word = c == 't' ? "true" : c == 'f' ? "false" : c == 'n' ? "null" : NULL;
+
+    if (!number && !word) return fail(f, at, "unexpected character");
+    if (!begin_value(f, at)) return 0;
+    f->lex = LEX_LITERAL;
+    f->number = number;
+    f->lit_word = word;
+    f->lit_state = N_START;
+    if (!literal_step(f, at, c)) return 0;
+    put_byte(f, (char)c);
+    return 1;
+}
+
+static int begin_string(JsonFormatter *f, size_t at) {
+    if (f->state == G_OBJECT_FIRST || f->state == G_KEY) {
+        if (f->pending_open) {
+            new_line(f, f->depth);
+            f->pending_open = 0;
+        }
+        f->is_key = 1;
+    } else if (!begin_value(f, at)) {
+        return 0;
+    }
+    f->lex = LEX_STRING;
+    put_byte(f, '"');
+    return 1;
+}
+
+static void end_string(JsonFormatter *f) {
+    f->lex = LEX_NONE;
+    put_byte(f, '"');
+    if (f->is_key) {
+        f->is_key = 0;
+        f->state = G_COLON;
+    } else {
+        value_done(f);
+    }
+}
+
+static int hex_digit(unsigned c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// One structural byte outside any token.
+static int structural(JsonFormatter *f, size_t at, unsigned c) {
+    switch (c) {
+        case '{':
+        case '[':
+            return open_container(f, at, (char)c);
+        case '}':
+        case ']':
+            return close_container(f, at, (char)c);
+        case ',':
+            if (f->state != G_AFTER_VALUE || f->depth == 0) return fail(f, at, "unexpected ','");
+            put_byte(f, ',');
+            if (f->mode == JSON_PRETTY) new_line(f, f->depth);
+            f->state = is_object(f, f->depth - 1u) ? G_KEY : G_VALUE;
+            return 1;
+        case ':':
+            if (f->state != G_COLON) return fail(f, at, "unexpected ':'");
+            put(f, ": ", f->mode == JSON_PRETTY ? 2u : 1u);
+            f->state = G_VALUE;
+            return 1;
+        case '"':
+            return begin_string(f, at);
+        default:
+            return begin_literal(f, at, c);
+    }
+}
+
+int json_format_init(JsonFormatter *f, JsonFormatMode mode, unsigned indent, const char *eol, JsonSinkFn sink, void *ctx) {
+    if (!f || !sink) return 0;
+    memset(f, 0, offsetof(JsonFormatter, objects));
+    f->mode = mode;
+    f->indent = indent;
+    f->eol = eol ? eol : "\n";
+    f->eol_len = strlen(f->eol);
+    f->sink = sink;
+    f->ctx = ctx;
+    f->state = G_AFTER_VALUE;   // at depth 0: ready for the first value
+    return 1;
+}
+
+int json_format_feed(JsonFormatter *f, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    size_t i = 0;
+
+    if (!f || f->error) return 0;
+    while (i < len && !f->error) {
+        unsigned c = p[i];
+        switch (f->lex) {
+            case LEX_STRING: {
+                // Copy the plain run in one piece.
+                size_t end = i + string_run(p + i, len - i);
+                put(f, p + i, end - i);
+                i = end;
+                if (i == len) break;
+                c = p[i];
+                if (c == '"') {
+                    end_string(f);
+                } else if (c == '\\') {
+                    put_byte(f, '\\');
+                    f->lex = LEX_ESCAPE;
+                } else {
+                    fail(f, i, "control character in string");
+                    break;
+                }
+                i++;
+                break;
+            }
+            case LEX_ESCAPE:
+                if (c == 'u') {
+                    f->lex = LEX_UNICODE;
+                    f->hex_left = 4;
+                } else if (strchr("\"\\/bfnrt", (int)c) && c != 0) {
+                    f->lex = LEX_STRING;
+                } else {
+                    fail(f, i, "invalid escape");
+                    break;
+                }
+                put_byte(f, (char)c);
+                i++;
+                break;
+            case LEX_UNICODE:
+                if (!hex_digit(c)) {
+                    fail(f, i, "invalid \\u escape");
+                    break;
+                }
+                put_byte(f, (char)c);
+                if (--f->hex_left == 0) f->lex = LEX_STRING;
+                i++;
+                break;
+            case LEX_LITERAL: {
+                size_t end = i;
+                while (end < len && is_literal_byte(p[end]) && literal_step(f, end, p[end])) end++;
+                put(f, p + i, end - i);
+                i = end;
+                // The byte after the literal is handled as structure next.
+                if (i < len && !f->error) end_literal(f, i);
+                break;
+            }
+            default:
+                if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                    i++;
+                    break;
+                }
+                structural(f, i, c);
+                i++;
+                break;
+        }
+    }
+    f->offset += i;
+    return f->error == NULL;
+}
+
+int json_format_finish(JsonFormatter *f) {
+    if (!f || f->error) return 0;
+    if (f->lex == LEX_LITERAL) {
+        end_literal(f, 0);
+    } else if (f->lex != LEX_NONE) {
+        fail(f, 0, "unterminated string");
+    }
+    if (!f->error && f->depth > 0) {
+        fail(f, 0, is_object(f, f->depth - 1u) ? "unclosed object" : "unclosed array");
+    } else if (!f->error && (f->state != G_AFTER_VALUE || f->values == 0)) {
+        fail(f, 0, "no JSON value");
+    }
+    flush(f);
+    return f->error == NULL;
+}
+
+const char *json_format_error(const JsonFormatter *f) {
+    return f ? f->error : "no formatter";
+}
+
+uint64_t json_format_error_offset(const JsonFormatter *f) {
+    return f ? f->error_offset : 0;
+}
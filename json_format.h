@@ -0,0 +1,62 @@
+// Streaming JSON pretty-printer and minifier
+// Input is fed in arbitrary chunks and output leaves through a sink in
+// JSON_OUT_BUFFER pieces, so memory stays fixed at sizeof(JsonFormatter)
+// whatever the document size. The input is validated as it streams: the
+// first error stops the formatter and records its byte offset. Several
+// top-level values in a row (JSON Lines) are accepted and kept one per line.
+
+#ifndef JSON_FORMAT_H
+#define JSON_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_MAX_DEPTH 4096u
+#define JSON_OUT_BUFFER (64u * 1024u)
+
+typedef enum { JSON_PRETTY = 0, JSON_MINIFY } JsonFormatMode;
+
+// Same shape as TextSinkFn; return 0 to stop the formatter.
+typedef int (*JsonSinkFn)(void *ctx, const void *data, size_t len);
+
+typedef struct {
+    JsonFormatMode mode;
+    unsigned indent;            // spaces per level; 0 indents with tabs
+    const char *eol;
+    size_t eol_len;
+    JsonSinkFn sink;
+    void *ctx;
+
+    int state;                  // grammar position
+    int lex;                    // token being scanned
+    int is_key;                 // the current string is an object key
+    int pending_open;           // a container was opened and nothing followed yet
+    int number;                 // literal is a number (else true/false/null)
+    unsigned lit_state;         // number DFA state or matched word length
+    const char *lit_word;
+    unsigned hex_left;          // \u digits still expected
+    unsigned depth;
+    uint64_t values;            // completed top-level values
+    uint64_t offset;            // input bytes consumed by earlier feeds
+    uint64_t written;
+    const char *error;
+    uint64_t error_offset;
+    size_t used;
+    unsigned char objects[JSON_MAX_DEPTH / 8u];   // bit set per level: object, not array
+    char out[JSON_OUT_BUFFER];
+} JsonFormatter;
+
+// `eol` separates lines in the output (pretty mode) and top-level values in
+// either mode; the caller keeps it alive. Returns 0 on bad arguments.
+int json_format_init(JsonFormatter *f, JsonFormatMode mode, unsigned indent, const char *eol, JsonSinkFn sink, void *ctx);
+
+// Both return 0 once the input turned out invalid or the sink stopped.
+int json_format_feed(JsonFormatter *f, const void *data, size_t len);
+int json_format_finish(JsonFormatter *f);
+
+// NULL while everything is fine, otherwise a short description; the offset
+// is the input byte the error was found at.
+const char *json_format_error(const JsonFormatter *f);
+uint64_t json_format_error_offset(const JsonFormatter *f);
+
+#endif
@@ -0,0 +1,594 @@
+// Line operations: sort (lexical, numeric, case-insensitive), unique, reverse
+
+#include "line_ops.h"
+#include "sys_thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INSERTION_RUN 16u
+#define RADIX_MIN 1024u             // smaller runs are merge sorted directly
+#define RADIX_LSD_MAX 65536u        // buckets small enough to stay in cache
+#define REFINE_LIMIT 64u            // bytes of a tied group compared by radix
+#define NUMERIC_DIGITS 13u          // 4-bit digits below the length field
+#define NUMERIC_MAX_INT 0x7FFu      // integer-part lengths that fit 11 bits
+#define KEY_SIGN UINT64_C(0x8000000000000000)
+#define KEY_MAGNITUDE UINT64_C(0x7FFFFFFFFFFFFFFF)
+
+typedef struct {
+    uint64_t key;       // orders lines; equal keys fall back to the text
+    uint32_t start;
+    uint32_t len;       // line break excluded
+} LineRef;
+
+typedef struct {
+    const unsigned char *text;
+    LineSortMode mode;  // LINE_SORT_NONE restores document order
+    int keyed;          // keys hold line_key() values and are compared first
+} SortCtx;
+
+typedef struct {
+    int negative;
+    const unsigned char *digits;    // integer part without leading zeros
+    size_t int_len;
+    const unsigned char *frac;      // fraction without trailing zeros
+    size_t frac_len;
+} Number;
+
+typedef struct {
+    SysThread thread;
+    const SortCtx *ctx;
+    LineRef *lines;
+    LineRef *tmp;
+    size_t count;
+    size_t split;       // merge: length of the left run
+    char *out;          // output: where this part's first line goes
+    const char *eol;
+    size_t eol_len;
+    int open_end;       // output: the last line gets no line break
+} LinePart;
+
+static unsigned fold_byte(unsigned c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+static int is_digit(unsigned c) {
+    return c >= '0' && c <= '9';
+}
+
+// The first eight bytes, big-endian and zero-padded, so comparing keys
+// compares line prefixes.
+static uint64_t prefix_key(const unsigned char *p, size_t len, int fold) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < 8u; i++) {
+        unsigned c = i < len ? p[i] : 0u;
+        key = (key << 8) | (fold ? fold_byte(c) : c);
+    }
+    return key;
+}
+
+// Reads an optionally signed decimal after leading blanks, as sort -n does;
+// a line without one counts as zero.
+static void parse_number(const unsigned char *p, size_t len, Number *n) {
+    size_t i = 0;
+
+    memset(n, 0, sizeof(*n));
+    while (i < len && (p[i] == ' ' || p[i] == '\t')) i++;
+    if (i < len && (p[i] == '-' || p[i] == '+')) {
+        n->negative = p[i] == '-';
+        i++;
+    }
+    while (i < len && p[i] == '0') i++;
+    n->digits = p + i;
+    while (i < len && is_digit(p[i])) {
+        n->int_len++;
+        i++;
+    }
+    if (i + 1u < len && p[i] == '.' && is_digit(p[i + 1u])) {
+        n->frac = p + ++i;
+        while (i < len && is_digit(p[i])) {
+            n->frac_len++;
+            i++;
+        }
+        while (n->frac_len > 0 && n->frac[n->frac_len - 1u] == '0') n->frac_len--;
+    }
+    if (n->int_len == 0 && n->frac_len == 0) n->negative = 0;
+}
+
+static int compare_numbers(const Number *a, const Number *b) {
+    int c;
+    if (a->negative != b->negative) return a->negative ? -1 : 1;
+    if (a->int_len != b->int_len) {
+        c = a->int_len < b->int_len ? -1 : 1;
+    } else {
+        size_t n = a->frac_len < b->frac_len ? a->frac_len : b->frac_len;
+        c = memcmp(a->digits, b->digits, a->int_len);
+        if (c == 0 && n > 0) c = memcmp(a->frac, b->frac, n);
+        if (c == 0) c = a->frac_len < b->frac_len ? -1 : a->frac_len > b->frac_len;
+    }
+    c = c < 0 ? -1 : c > 0;
+    return a->negative ? -c : c;
+}
+
+// The integer part's length, then its first 13 digits (fraction included):
+// a key never orders two numbers the wrong way round, it only ties numbers it
+// cannot tell apart.
+static uint64_t numeric_key(const unsigned char *p, size_t len) {
+    Number n;
+    uint64_t mag;
+
+    parse_number(p, len, &n);
+    if (n.int_len >= NUMERIC_MAX_INT) {
+        mag = KEY_MAGNITUDE;
+    } else {
+        mag = (uint64_t)n.int_len << (4u * NUMERIC_DIGITS);
+        for (size_t i = 0; i < NUMERIC_DIGITS; i++) {
+            unsigned d = 0;
+            if (i < n.int_len) {
+                d = n.digits[i] - '0';
+            } else if (i - n.int_len < n.frac_len) {
+                d = n.frac[i - n.int_len] - '0';
+            }
+            mag |= (uint64_t)d << (4u * (NUMERIC_DIGITS - 1u - i));
+        }
+    }
+    return n.negative ? KEY_MAGNITUDE - mag : KEY_SIGN | mag;
+}
+
+static uint64_t line_key(const SortCtx *ctx, const LineRef *line) {
+    const unsigned char *p = ctx->text + line->start;
+    switch (ctx->mode) {
+        case LINE_SORT_LEXICAL:
+            return prefix_key(p, line->len, 0);
+        case LINE_SORT_NOCASE:
+            return prefix_key(p, line->len, 1);
+        case LINE_SORT_NUMERIC:
+            return numeric_key(p, line->len);
+        default:
+            return line->start;
+    }
+}
+
+static int compare_bytes(const unsigned char *text, const LineRef *a, const LineRef *b, size_t skip) {
+    size_t n = a->len < b->len ? a->len : b->len;
+    int c = n > skip ? memcmp(text + a->start + skip, text + b->start + skip, n - skip) : 0;
+    if (c != 0) return c;
+    return a->len < b->len ? -1 : a->len > b->len;
+}
+
+static int compare_folded(const unsigned char *text, const LineRef *a, const LineRef *b) {
+    const unsigned char *pa = text + a->start;
+    const unsigned char *pb = text + b->start;
+    size_t n = a->len < b->len ? a->len : b->len;
+    for (size_t i = 0; i < n; i++) {
+        unsigned ca = fold_byte(pa[i]);
+        unsigned cb = fold_byte(pb[i]);
+        if (ca != cb) return ca < cb ? -1 : 1;
+    }
+    return a->len < b->len ? -1 : a->len > b->len;
+}
+
+// Lines equal under the mode fall back to byte order and then position, so
+// identical lines always end up next to each other, earliest first.
+static int compare_lines(const SortCtx *ctx, const LineRef *a, const LineRef *b) {
+    int c = 0;
+    size_t skip = 0;
+
+    if (ctx->keyed) {
+        if (a->key != b->key) return a->key < b->key ? -1 : 1;
+        if (ctx->mode == LINE_SORT_NONE) return 0;
+        // The key already matched the first eight bytes.
+        if (ctx->mode == LINE_SORT_LEXICAL && a->len >= 8u && b->len >= 8u) skip = 8u;
+    }
+    if (ctx->mode == LINE_SORT_NOCASE) {
+        c = compare_folded(ctx->text, a, b);
+    } else if (ctx->mode == LINE_SORT_NUMERIC) {
+        Number na;
+        Number nb;
+        parse_number(ctx->text + a->start, a->len, &na);
+        parse_number(ctx->text + b->start, b->len, &nb);
+        c = compare_numbers(&na, &nb);
+    }
+    if (c == 0) c = compare_bytes(ctx->text, a, b, skip);
+    if (c == 0) c = a->start < b->start ? -1 : a->start > b->start;
+    return c;
+}
+
+static void insertion_sort(LineRef *a, size_t n, const SortCtx *ctx) {
+    for (size_t i = 1; i < n; i++) {
+        LineRef v = a[i];
+        size_t j = i;
+        while (j > 0 && compare_lines(ctx, &v, &a[j - 1u]) < 0) {
+            a[j] = a[j - 1u];
+            j--;
+        }
+        a[j] = v;
+    }
+}
+
+// Merges the sorted runs a[0, split) and a[split, n) in place; only the left
+// run is staged in `tmp`.
+static void merge_runs(LineRef *a, LineRef *tmp, size_t split, size_t n, const SortCtx *ctx) {
+    size_t i = 0;
+    size_t j = split;
+    size_t k = 0;
+
+    if (split == 0 || split >= n || compare_lines(ctx, &a[split - 1u], &a[split]) <= 0) return;
+    memcpy(tmp, a, split * sizeof(LineRef));
+    while (i < split && j < n) {
+        if (compare_lines(ctx, &a[j], &tmp[i]) < 0) {
+            a[k++] = a[j++];
+        } else {
+            a[k++] = tmp[i++];
+        }
+    }
+    memcpy(a + k, tmp + i, (split - i) * sizeof(LineRef));
+}
+
+static void merge_sort(LineRef *a, LineRef *tmp, size_t n, const SortCtx *ctx) {
+    size_t half;
+    if (n <= INSERTION_RUN) {
+        insertion_sort(a, n, ctx);
+        return;
+    }
+    half = n / 2u;
+    merge_sort(a, tmp, half, ctx);
+    merge_sort(a + half, tmp + half, n - half, ctx);
+    merge_runs(a, tmp, half, n, ctx);
+}
+
+// Stable LSD radix sort on the low `bytes` bytes of the key, skipping the
+// bytes every key shares.
+static void radix_sort_lsd(LineRef *a, LineRef *tmp, size_t n, unsigned bytes) {
+    size_t counts[8][256];
+    LineRef *src = a;
+    LineRef *dst = tmp;
+
+    memset(counts, 0, sizeof(counts));
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = a[i].key;
+        for (unsigned b = 0; b < bytes; b++) {
+            counts[b][(key >> (8u * b)) & 0xFFu]++;
+        }
+    }
+    for (unsigned b = 0; b < bytes; b++) {
+        size_t *bucket = counts[b];
+        unsigned shift = 8u * b;
+        size_t sum = 0;
+        LineRef *swap;
+
+        if (bucket[(src[0].key >> shift) & 0xFFu] == n) continue;
+        for (unsigned d = 0; d < 256u; d++) {
+            size_t count = bucket[d];
+            bucket[d] = sum;
+            sum += count;
+        }
+        for (size_t i = 0; i < n; i++) {
+            dst[bucket[(src[i].key >> shift) & 0xFFu]++] = src[i];
+        }
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != a) memcpy(a, src, n * sizeof(LineRef));
+}
+
+// Large inputs are split on their most significant varying byte first, so
+// the LSD passes run on buckets that fit in cache.
+static void radix_sort(LineRef *a, LineRef *tmp, size_t n, unsigned bytes) {
+    size_t bucket[256];
+    size_t at = 0;
+    unsigned shift = 0;
+
+    while (n > RADIX_LSD_MAX && bytes > 0) {
+        shift = 8u * (bytes - 1u);
+        memset(bucket, 0, sizeof(bucket));
+        for (size_t i = 0; i < n; i++) {
+            bucket[(a[i].key >> shift) & 0xFFu]++;
+        }
+        if (bucket[(a[0].key >> shift) & 0xFFu] != n) break;
+        bytes--;
+    }
+    if (n <= RADIX_LSD_MAX || bytes == 0) {
+        radix_sort_lsd(a, tmp, n, bytes);
+        return;
+    }
+
+    for (unsigned d = 0; d < 256u; d++) {
+        size_t count = bucket[d];
+        bucket[d] = at;
+        at += count;
+    }
+    for (size_t i = 0; i < n; i++) {
+        tmp[bucket[(a[i].key >> shift) & 0xFFu]++] = a[i];
+    }
+    memcpy(a, tmp, n * sizeof(LineRef));
+    at = 0;
+    for (unsigned d = 0; d < 256u; d++) {
+        size_t count = bucket[d] - at;
+        if (count > 1u) radix_sort(a + at, tmp + at, count, bytes - 1u);
+        at = bucket[d];
+    }
+}
+
+// Radix sorts a group of tied lines again on their next eight bytes, down to
+// REFINE_LIMIT. Only a pre-order: the caller still merge sorts the group.
+static void refine_group(LineRef *a, LineRef *tmp, size_t n, const SortCtx *ctx, size_t offset) {
+    int fold = ctx->mode == LINE_SORT_NOCASE;
+    int more = 0;
+    size_t i = 0;
+
+    if (n < RADIX_MIN || offset >= REFINE_LIMIT) return;
+    for (size_t j = 0; j < n; j++) {
+        size_t rest = a[j].len > offset ? a[j].len - offset : 0;
+        a[j].key = rest ? prefix_key(ctx->text + a[j].start + offset, rest, fold) : 0;
+        more |= rest > 8u;
+    }
+    radix_sort(a, tmp, n, 8u);
+    if (!more) return;
+    while (i < n) {
+        size_t j = i + 1u;
+        while (j < n && a[j].key == a[i].key) j++;
+        if (j - i > 1u) refine_group(a + i, tmp + i, j - i, ctx, offset + 8u);
+        i = j;
+    }
+}
+
+// Radix sorts a run on its keys, then orders each group of tied keys by the
+// full comparison. Lexical and folded groups arrive from refine_group already
+// in order, so that merge sort only confirms it; numeric groups are pre-ordered
+// by their bytes, which is the final order whenever their numbers are equal.
+static void sort_run(LineRef *a, LineRef *tmp, size_t n, const SortCtx *ctx) {
+    SortCtx full = *ctx;
+    size_t i = 0;
+
+    for (size_t j = 0; j < n; j++) {
+        a[j].key = line_key(ctx, &a[j]);
+    }
+    if (n < RADIX_MIN) {
+        merge_sort(a, tmp, n, ctx);
+        return;
+    }
+    radix_sort(a, tmp, n, 8u);
+    if (ctx->mode == LINE_SORT_NONE) return;
+
+    full.keyed = 0;
+    while (i < n) {
+        uint64_t key = a[i].key;
+        size_t j = i + 1u;
+        while (j < n && a[j].key == key) j++;
+        if (j - i > 1u) {
+            refine_group(a + i, tmp + i, j - i, ctx, ctx->mode == LINE_SORT_NUMERIC ? 0 : 8u);
+            merge_sort(a + i, tmp + i, j - i, &full);
+            for (size_t k = i; k < j; k++) {
+                a[k].key = key;
+            }
+        }
+        i = j;
+    }
+}
+
+static int sort_worker(void *arg) {
+    LinePart *part = (LinePart *)arg;
+    sort_run(part->lines, part->tmp, part->count, part->ctx);
+    return 0;
+}
+
+static int merge_worker(void *arg) {
+    LinePart *part = (LinePart *)arg;
+    merge_runs(part->lines, part->tmp, part->split, part->count, part->ctx);
+    return 0;
+}
+
+static int copy_worker(void *arg) {
+    LinePart *part = (LinePart *)arg;
+    const unsigned char *text = part->ctx->text;
+    char *out = part->out;
+    for (size_t i = 0; i < part->count; i++) {
+        const LineRef *line = &part->lines[i];
+        memcpy(out, text + line->start, line->len);
+        out += line->len;
+        if (i + 1u < part->count || !part->open_end) {
+            memcpy(out, part->eol, part->eol_len);
+            out += part->eol_len;
+        }
+    }
+    return 0;
+}
+
+// Part 0 runs on the calling thread; a part whose thread fails to start runs
+// inline instead.
+static void run_parts(LinePart *parts, unsigned count, int (*fn)(void *)) {
+    for (unsigned i = 1; i < count; i++) {
+        if (!sys_thread_start(&parts[i].thread, fn, &parts[i])) {
+            parts[i].thread.fn = NULL;
+            fn(&parts[i]);
+        }
+    }
+    fn(&parts[0]);
+    for (unsigned i = 1; i < count; i++) {
+        if (parts[i].thread.fn) sys_thread_join(&parts[i].thread);
+    }
+}
+
+static unsigned part_count(size_t lines, unsigned threads) {
+    if ((uint64_t)threads * LINE_OPS_MIN_RUN > lines) threads = (unsigned)(lines / LINE_OPS_MIN_RUN);
+    return threads ? threads : 1u;
+}
+
+// Sorts each part's run on its own thread, then merges neighbouring runs
+// pairwise until one is left; each round halves the number of runs.
+static unsigned sort_lines(LineRef *lines, LineRef *tmp, size_t n, const SortCtx *ctx, unsigned threads) {
+    LinePart parts[LINE_OPS_MAX_THREADS];
+    size_t bounds[LINE_OPS_MAX_THREADS + 1u];
+    unsigned runs = part_count(n, threads);
+    unsigned used = runs;
+
+    memset(parts, 0, sizeof(parts));
+    for (unsigned i = 0; i <= runs; i++) {
+        bounds[i] = (size_t)((uint64_t)n * i / runs);
+    }
+    for (unsigned i = 0; i < runs; i++) {
+        parts[i].ctx = ctx;
+        parts[i].lines = lines + bounds[i];
+        parts[i].tmp = tmp + bounds[i];
+        parts[i].count = bounds[i + 1u] - bounds[i];
+    }
+    run_parts(parts, runs, sort_worker);
+
+    while (runs > 1u) {
+        unsigned pairs = runs / 2u;
+        unsigned next = (runs + 1u) / 2u;
+        for (unsigned p = 0; p < pairs; p++) {
+            size_t from = bounds[2u * p];
+            parts[p].lines = lines + from;
+            parts[p].tmp = tmp + from;
+            parts[p].split = bounds[2u * p + 1u] - from;
+            parts[p].count = bounds[2u * p + 2u] - from;
+        }
+        run_parts(parts, pairs, merge_worker);
+        for (unsigned k = 0; k < next; k++) {
+            bounds[k] = bounds[2u * k];
+        }
+        bounds[next] = n;
+        runs = next;
+    }
+    return used;
+}
+
+// Drops every line identical to the one before it; after sort_lines that
+// leaves the first copy of each line. Returns the new count.
+static size_t drop_repeats(LineRef *lines, size_t n, const unsigned char *text) {
+    size_t kept = n ? 1u : 0u;
+    for (size_t i = 1; i < n; i++) {
+        const LineRef *prev = &lines[kept - 1u];
+        if (lines[i].len == prev->len && memcmp(text + lines[i].start, text + prev->start, prev->len) == 0) continue;
+        lines[kept++] = lines[i];
+    }
+    return kept;
+}
+
+static char *build_output(const LineRef *lines, size_t n, const SortCtx *ctx, const char *eol, int open_end, unsigned threads, size_t *out_len) {
+    LinePart parts[LINE_OPS_MAX_THREADS];
+    size_t offsets[LINE_OPS_MAX_THREADS];
+    size_t eol_len = strlen(eol);
+    unsigned count = part_count(n, threads);
+    size_t total = 0;
+    size_t next_part = 1;
+    char *out;
+
+    memset(parts, 0, sizeof(parts));
+    offsets[0] = 0;
+    for (unsigned i = 0; i < count; i++) {
+        size_t from = (size_t)((uint64_t)n * i / count);
+        parts[i].ctx = ctx;
+        parts[i].lines = (LineRef *)lines + from;
+        parts[i].count = (size_t)((uint64_t)n * (i + 1u) / count) - from;
+        parts[i].eol = eol;
+        parts[i].eol_len = eol_len;
+    }
+    parts[count - 1u].open_end = open_end;
+
+    // Offsets of each part's first line, found in the same pass as the size.
+    for (size_t i = 0; i < n; i++) {
+        if (next_part < count && parts[next_part].lines == lines + i) {
+            offsets[next_part++] = total;
+        }
+        total += lines[i].len + eol_len;
+    }
+    if (n > 0 && open_end) total -= eol_len;
+
+    out = (char *)malloc(total + 1u);
+    if (!out) return NULL;
+    for (unsigned i = 0; i < count; i++) {
+        parts[i].out = out + offsets[i];
+    }
+    run_parts(parts, count, copy_worker);
+    out[total] = '\0';
+    *out_len = total;
+    return out;
+}
+
+char *line_ops_apply(const char *text, size_t len, const LineOps *ops, const char *eol, size_t *out_len, LineOpsResult *result) {
+    const unsigned char *p = (const unsigned char *)text;
+    const unsigned char *nl;
+    SortCtx ctx;
+    LineRef *lines;
+    LineRef *tmp = NULL;
+    size_t count = 0;
+    size_t kept;
+    size_t at = 0;
+    unsigned threads;
+    unsigned used = 1;
+    int trailing = len > 0 && p[len - 1u] == '\n';
+    char *out;
+
+    if (!ops || !out_len || len > LINE_OPS_MAX_TEXT) return NULL;
+    if (!eol) eol = "\n";
+
+    while ((nl = (const unsigned char *)memchr(p + at, '\n', len - at)) != NULL) {
+        count++;
+        at = (size_t)(nl - p) + 1u;
+    }
+    if (at < len) count++;
+
+    lines = (LineRef *)malloc((count ? count : 1u) * sizeof(LineRef));
+    if (!lines) return NULL;
+    at = 0;
+    for (size_t i = 0; i < count; i++) {
+        nl = (const unsigned char *)memchr(p + at, '\n', len - at);
+        size_t end = nl ? (size_t)(nl - p) : len;
+        size_t content = nl && end > at && p[end - 1u] == '\r' ? end - 1u : end;
+        lines[i].key = 0;
+        lines[i].start = (uint32_t)at;
+        lines[i].len = (uint32_t)(content - at);
+        at = end + 1u;
+    }
+
+    threads = ops->threads ? ops->threads : sys_cpu_count();
+    if (threads > LINE_OPS_MAX_THREADS) threads = LINE_OPS_MAX_THREADS;
+    if ((ops->sort != LINE_SORT_NONE || ops->unique) && count > 1u) {
+        tmp = (LineRef *)malloc(count * sizeof(LineRef));
+        if (!tmp) {
+            free(lines);
+            return NULL;
+        }
+    }
+
+    ctx.text = p;
+    ctx.mode = LINE_SORT_NONE;
+    ctx.keyed = 1;
+    kept = count;
+    if (tmp && ops->unique) {
+        // Sorting brings copies together; without a requested order the
+        // survivors are put back in document order afterwards.
+        ctx.mode = ops->sort != LINE_SORT_NONE ? ops->sort : LINE_SORT_LEXICAL;
+        used = sort_lines(lines, tmp, count, &ctx, threads);
+        kept = drop_repeats(lines, count, p);
+        if (ops->sort == LINE_SORT_NONE) {
+            ctx.mode = LINE_SORT_NONE;
+            sort_lines(lines, tmp, kept, &ctx, threads);
+        }
+    } else if (tmp) {
+        ctx.mode = ops->sort;
+        used = sort_lines(lines, tmp, count, &ctx, threads);
+    }
+    free(tmp);
+
+    if (ops->reverse) {
+        for (size_t i = 0, j = kept; i + 1u < j; i++, j--) {
+            LineRef swap = lines[i];
+            lines[i] = lines[j - 1u];
+            lines[j - 1u] = swap;
+        }
+    }
+
+    out = build_output(lines, kept, &ctx, eol, !trailing, threads, out_len);
+    free(lines);
+    if (out && result) {
+        result->lines_in = count;
+        result->lines_out = kept;
+        result->threads = used;
+    }
+    return out;
+}
@@ -0,0 +1,45 @@
+// Line operations: sort (lexical, numeric, case-insensitive), unique, reverse
+// Lines are handled as (offset, length) references into the caller's text,
+// each carrying an 8-byte sort key, so sorting never moves line content; the
+// text is copied once, in its final order, when the result is built. Each
+// thread radix sorts its run on the keys and merge sorts the tied groups;
+// the runs are then merged pairwise.
+
+#ifndef LINE_OPS_H
+#define LINE_OPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LINE_OPS_MAX_TEXT 0xFFFFFFFFu
+#define LINE_OPS_MIN_RUN 65536u
+#define LINE_OPS_MAX_THREADS 64u
+
+typedef enum {
+    LINE_SORT_NONE = 0,
+    LINE_SORT_LEXICAL,      // byte order
+    LINE_SORT_NOCASE,       // ASCII case folded, then byte order
+    LINE_SORT_NUMERIC       // leading decimal number (none = 0), then byte order
+} LineSortMode;
+
+typedef struct {
+    LineSortMode sort;
+    int unique;             // drop repeated lines, keeping the first of each
+    int reverse;            // reverse the final order
+    unsigned threads;       // 0 = one per CPU
+} LineOps;
+
+typedef struct {
+    size_t lines_in;
+    size_t lines_out;
+    unsigned threads;       // workers the sort ran on
+} LineOpsResult;
+
+// Lines end at LF; a CR right before it belongs to the line break. The
+// result joins the lines with `eol` and ends with it only when `text` ended
+// with a line break. Equal lines keep their original order. Returns a
+// malloc'd, NUL-terminated buffer, or NULL when out of memory or when `len`
+// exceeds LINE_OPS_MAX_TEXT. `result` may be NULL.
+char *line_ops_apply(const char *text, size_t len, const LineOps *ops, const char *eol, size_t *out_len, LineOpsResult *result);
+
+#endif
@@ -0,0 +1,124 @@
+// Segment index for very long lines
+
+#include "line_segments.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t measure(const LineSegments *ls, const char *text, size_t from, size_t to) {
+    const unsigned char *p = (const unsigned char *)text;
+    uint32_t width = 0;
+    for (size_t i = from; i < to; i++) {
+        width += ls->char_width[p[i]];
+    }
+    return width;
+}
+
+static size_t segment_end(const LineSegments *ls, size_t segment) {
+    size_t end = (segment + 1u) * LINE_SEGMENT_BYTES;
+    return end < ls->len ? end : ls->len;
+}
+
+// Sum of the widths of segments [0, segment).
+static uint64_t tree_prefix(const LineSegments *ls, size_t segment) {
+    uint64_t sum = 0;
+    for (size_t i = segment; i > 0; i -= i & (~i + 1u)) {
+        sum += ls->tree[i];
+    }
+    return sum;
+}
+
+int line_segments_build(LineSegments *ls, const char *text, size_t len, const uint16_t char_width[256]) {
+    if (!ls) return 0;
+    memset(ls, 0, sizeof(*ls));
+    memcpy(ls->char_width, char_width, sizeof(ls->char_width));
+    ls->len = len;
+    ls->count = (len + LINE_SEGMENT_BYTES - 1u) / LINE_SEGMENT_BYTES;
+    ls->widths = (uint32_t *)malloc((ls->count ? ls->count : 1u) * sizeof(uint32_t));
+    ls->tree = (uint64_t *)calloc(ls->count + 1u, sizeof(uint64_t));
+    if (!ls->widths || !ls->tree) {
+        line_segments_free(ls);
+        return 0;
+    }
+
+    // Linear Fenwick construction: each node passes its sum to its parent.
+    for (size_t s = 0; s < ls->count; s++) {
+        ls->widths[s] = measure(ls, text, s * LINE_SEGMENT_BYTES, segment_end(ls, s));
+        ls->tree[s + 1u] += ls->widths[s];
+    }
+    for (size_t i = 1; i <= ls->count; i++) {
+        size_t parent = i + (i & (~i + 1u));
+        if (parent <= ls->count) ls->tree[parent] += ls->tree[i];
+    }
+    ls->tree_step = 1;
+    while (ls->tree_step * 2u <= ls->count) ls->tree_step *= 2u;
+    return 1;
+}
+
+void line_segments_free(LineSegments *ls) {
+    if (!ls) return;
+    free(ls->widths);
+    free(ls->tree);
+    ls->widths = NULL;
+    ls->tree = NULL;
+    ls->count = 0;
+    ls->len = 0;
+}
+
+uint64_t line_segments_width(const LineSegments *ls) {
+    return ls ? tree_prefix(ls, ls->count) : 0;
+}
+
+uint64_t line_segments_x_of(const LineSegments *ls, const char *text, size_t offset) {
+    size_t segment;
+    if (!ls || ls->count == 0) return 0;
+    if (offset >= ls->len) return line_segments_width(ls);
+    segment = offset / LINE_SEGMENT_BYTES;
+    return tree_prefix(ls, segment) + measure(ls, text, segment * LINE_SEGMENT_BYTES, offset);
+}
+
+size_t line_segments_segment_at(const LineSegments *ls, uint64_t x, uint64_t *segment_x) {
+    size_t pos = 0;
+    uint64_t before = 0;
+
+    // Fenwick descent: largest prefix of whole segments whose width is <= x.
+    if (ls) {
+        for (size_t step = ls->tree_step; step > 0; step /= 2u) {
+            size_t next = pos + step;
+            if (next <= ls->count && before + ls->tree[next] <= x) {
+                pos = next;
+                before += ls->tree[next];
+            }
+        }
+    }
+    if (ls && pos >= ls->count && ls->count > 0) {
+        // Past the end: report the last segment.
+        pos = ls->count - 1u;
+        before -= ls->widths[pos];
+    }
+    if (segment_x) *segment_x = before;
+    return pos;
+}
+
+size_t line_segments_offset_at(const LineSegments *ls, const char *text, uint64_t x) {
+    const unsigned char *p = (const unsigned char *)text;
+    uint64_t at_x;
+    size_t segment;
+    size_t end;
+    size_t i;
+
+    if (!ls || ls->count == 0) return 0;
+    if (x >= line_segments_width(ls)) return ls->len;
+
+    segment = line_segments_segment_at(ls, x, &at_x);
+    end = segment_end(ls, segment);
+    for (i = segment * LINE_SEGMENT_BYTES; i < end; i++) {
+        uint32_t w = ls->char_width[p[i]];
+        if (at_x + w > x) {
+            // Snap to whichever edge of the character is closer.
+            return (x - at_x) * 2u >= w ? i + 1u : i;
+        }
+        at_x += w;
+    }
+    return end;
+}
@@ -0,0 +1,42 @@
+// Segment index for very long lines
+// A line is cut into fixed-size byte segments and a Fenwick tree keeps the
+// prefix sums of their widths, so mapping an x position to a byte offset (or
+// back) costs O(log n) plus a scan of one segment instead of a walk from the
+// start of the line. Widths come from a caller-supplied per-byte table, so the
+// same index serves pixel layout (GDI char widths) and plain column counts.
+// The index does not keep the text; queries that scan a segment take it again,
+// and a changed line needs a new index.
+
+#ifndef LINE_SEGMENTS_H
+#define LINE_SEGMENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LINE_SEGMENT_BYTES 4096u
+
+typedef struct {
+    size_t len;          // bytes in the indexed line
+    size_t count;        // segments
+    uint32_t *widths;    // width of each segment
+    uint64_t *tree;      // Fenwick tree over widths, 1-based
+    size_t tree_step;    // highest power of two <= count, for descents
+    uint16_t char_width[256];
+} LineSegments;
+
+// Returns 0 on allocation failure.
+int line_segments_build(LineSegments *ls, const char *text, size_t len, const uint16_t char_width[256]);
+void line_segments_free(LineSegments *ls);
+
+uint64_t line_segments_width(const LineSegments *ls);
+
+// x position of the boundary before byte `offset`.
+uint64_t line_segments_x_of(const LineSegments *ls, const char *text, size_t offset);
+
+// Byte offset of the boundary nearest to `x` (caret placement).
+size_t line_segments_offset_at(const LineSegments *ls, const char *text, uint64_t x);
+
+// Segment containing `x` and its starting x, for drawing only visible segments.
+size_t line_segments_segment_at(const LineSegments *ls, uint64_t x, uint64_t *segment_x);
+
+#endif
@@ -0,0 +1,180 @@
+// LZ77 block codec for in-memory page compression
+
+#include "lz_block.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define LZ_HASH_BITS 12u
+#define LZ_MIN_MATCH 4u
+
+static uint32_t load32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static unsigned hash4(uint32_t v) {
+    return (unsigned)((v * 2654435761u) >> (32u - LZ_HASH_BITS));
+}
+
+// Length of the common run at a and b, comparing 8 bytes at a time until
+// they differ.
+static size_t match_length(const unsigned char *a, const unsigned char *b, const unsigned char *end) {
+    const unsigned char *start = a;
+    while ((size_t)(end - a) >= 8u) {
+        uint64_t x;
+        uint64_t y;
+        memcpy(&x, a, 8);
+        memcpy(&y, b, 8);
+        if (x != y) break;
+        a += 8;
+        b += 8;
+    }
+    while (a < end && *a == *b) {
+        a++;
+        b++;
+    }
+    return (size_t)(a - start);
+}
+
+// Writes the bytes continuing a length of 15 or more; NULL when out of room.
+static unsigned char *put_length(unsigned char *op, const unsigned char *end, size_t n) {
+    while (n >= 255u) {
+        if (op >= end) return NULL;
+        *op++ = 255;
+        n -= 255u;
+    }
+    if (op >= end) return NULL;
+    *op++ = (unsigned char)n;
+    return op;
+}
+
+static unsigned char *put_sequence(
+    unsigned char *op,
+    const unsigned char *end,
+    const unsigned char *lit,
+    size_t lit_len,
+    size_t offset,
+    size_t match_len
+) {
+    size_t m = match_len ? match_len - LZ_MIN_MATCH : 0;
+
+    if (op >= end) return NULL;
+    *op++ = (unsigned char)(((lit_len < 15u ? lit_len : 15u) << 4) | (m < 15u ? m : 15u));
+    if (lit_len >= 15u && !(op = put_length(op, end, lit_len - 15u))) return NULL;
+    if ((size_t)(end - op) < lit_len) return NULL;
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+    if (match_len == 0) return op;
+
+    if ((size_t)(end - op) < 2u) return NULL;
+    *op++ = (unsigned char)(offset & 0xFFu);
+    *op++ = (unsigned char)(offset >> 8);
+    if (m >= 15u && !(op = put_length(op, end, m - 15u))) return NULL;
+    return op;
+}
+
+size_t lz_block_compress(const void *src, size_t len, void *dst, size_t cap) {
+    const unsigned char *in = (const unsigned char *)src;
+    const unsigned char *in_end = in + len;
+    unsigned char *out = (unsigned char *)dst;
+    unsigned char *op = out;
+    const unsigned char *out_end = out + cap;
+    uint16_t table[1u << LZ_HASH_BITS];
+    size_t anchor = 0;
+    size_t pos = 0;
+    unsigned misses = 0;
+
+    if (len > LZ_BLOCK_MAX) return 0;
+    memset(table, 0, sizeof(table));
+    while (len >= LZ_MIN_MATCH && pos <= len - LZ_MIN_MATCH) {
+        uint32_t v = load32(in + pos);
+        unsigned h = hash4(v);
+        size_t cand = table[h];
+        table[h] = (uint16_t)pos;
+        if (cand >= pos || load32(in + cand) != v) {
+            // Step further the longer nothing matches, so incompressible
+            // data is given up on quickly.
+            misses++;
+            pos += 1u + (misses >> 5);
+            continue;
+        }
+
+        size_t match_len = LZ_MIN_MATCH + match_length(in + pos + LZ_MIN_MATCH, in + cand + LZ_MIN_MATCH, in_end);
+        while (pos > anchor && cand > 0 && in[pos - 1u] == in[cand - 1u]) {
+            pos--;
+            cand--;
+            match_len++;
+        }
+        op = put_sequence(op, out_end, in + anchor, pos - anchor, pos - cand, match_len);
+        if (!op) return 0;
+        pos += match_len;
+        anchor = pos;
+        misses = 0;
+        if (pos >= 2u && pos <= len - LZ_MIN_MATCH) {
+            table[hash4(load32(in + pos - 2u))] = (uint16_t)(pos - 2u);
+        }
+    }
+    op = put_sequence(op, out_end, in + anchor, len - anchor, 0, 0);
+    return op ? (size_t)(op - out) : 0;
+}
+
+int lz_block_decompress(const void *src, size_t len, void *dst, size_t out_len) {
+    const unsigned char *ip = (const unsigned char *)src;
+    const unsigned char *in_end = ip + len;
+    unsigned char *out = (unsigned char *)dst;
+    unsigned char *op = out;
+    unsigned char *out_end = out + out_len;
+
+    while (ip < in_end) {
+        unsigned token = *ip++;
+        size_t lit = token >> 4;
+        size_t m = token & 15u;
+        size_t offset;
+        unsigned b;
+
+        if (lit == 15u) {
+            do {
+                if (ip >= in_end) return 0;
+                b = *ip++;
+                lit += b;
+            } while (b == 255u);
+        }
+        if ((size_t)(in_end - ip) < lit || (size_t)(out_end - op) < lit) return 0;
+        if (lit <= 16u && (size_t)(in_end - ip) >= 16u && (size_t)(out_end - op) >= 16u) {
+            memcpy(op, ip, 16);   // fixed size copies compile to two moves
+        } else {
+            memcpy(op, ip, lit);
+        }
+        op += lit;
+        ip += lit;
+        if (ip == in_end) break;
+
+        if ((size_t)(in_end - ip) < 2u) return 0;
+        offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (m == 15u) {
+            do {
+                if (ip >= in_end) return 0;
+                b = *ip++;
+                m += b;
+            } while (b == 255u);
+        }
+        m += LZ_MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(op - out) || (size_t)(out_end - op) < m) return 0;
+
+        const unsigned char *from = op - offset;
+        if (offset >= 8u && (size_t)(out_end - op) >= m + 8u) {
+            // Copying 8 bytes at a time may run past the match; the extra
+            // bytes are overwritten by what follows.
+            for (size_t i = 0; i < m; i += 8u) memcpy(op + i, from + i, 8);
+        } else if (offset >= m) {
+            memcpy(op, from, m);
+        } else {
+            for (size_t i = 0; i < m; i++) op[i] = from[i];
+        }
+        op += m;
+    }
+    return op == out_end;
+}
@@ -0,0 +1,24 @@
+// LZ77 block codec for in-memory page compression
+// A block is a run of sequences: a token byte (literal count in the high
+// nibble, match length - 4 in the low one, 15 meaning more length bytes
+// follow, each 255 adding and continuing), the literals, then a 16-bit
+// little-endian match offset and any extra match length. The last sequence
+// has literals only. Blocks are at most LZ_BLOCK_MAX bytes, so a position
+// always fits the 16-bit offset. Matches are found with a single-probe hash
+// table, trading ratio for speed; text and logs typically shrink 3-8x.
+
+#ifndef LZ_BLOCK_H
+#define LZ_BLOCK_H
+
+#include <stddef.h>
+
+#define LZ_BLOCK_MAX 65536u
+
+// Returns the compressed size, or 0 when `len` exceeds LZ_BLOCK_MAX or the
+// output does not fit in `cap` (the caller then keeps the block raw).
+size_t lz_block_compress(const void *src, size_t len, void *dst, size_t cap);
+
+// Decodes exactly `out_len` bytes; returns 0 on malformed input.
+int lz_block_decompress(const void *src, size_t len, void *dst, size_t out_len);
+
+#endif
@@ -0,0 +1,364 @@
+// Edit-stable markers (bookmarks, search hits, highlight ranges)
+
+#include "marker_tree.h"
+#include "mem_account.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MARKER_FREE 0x80000000u   // slot is on the free list
+
+// 64 bytes, one cache line per marker.
+struct MarkerNode {
+    uint64_t start;
+    uint64_t end;
+    uint64_t max_end;       // largest end in the subtree
+    uint64_t shift;         // still to be added to both child subtrees (mod 2^64)
+    uint32_t left;
+    uint32_t right;
+    uint32_t parent;        // next free slot while on the free list
+    uint32_t prio;
+    uint32_t kind;
+    uint32_t kinds;         // kinds present in the subtree
+    uint32_t flags;
+    uint32_t pad;
+};
+
+static uint32_t next_prio(MarkerTree *t) {
+    uint32_t x = t->seed ? t->seed : 0x9E3779B9u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    t->seed = x;
+    return x;
+}
+
+static void apply_shift(MarkerNode *n, uint64_t s) {
+    n->start += s;
+    n->end += s;
+    n->max_end += s;
+    n->shift += s;
+}
+
+// Hands a node's pending shift down to its children.
+static void push(MarkerTree *t, uint32_t i) {
+    MarkerNode *n = &t->nodes[i];
+    if (n->shift == 0) return;
+    if (n->left) apply_shift(&t->nodes[n->left], n->shift);
+    if (n->right) apply_shift(&t->nodes[n->right], n->shift);
+    n->shift = 0;
+}
+
+static void pull(MarkerTree *t, uint32_t i) {
+    MarkerNode *n = &t->nodes[i];
+    n->max_end = n->end;
+    n->kinds = n->kind;
+    if (n->left) {
+        MarkerNode *c = &t->nodes[n->left];
+        if (c->max_end > n->max_end) n->max_end = c->max_end;
+        n->kinds |= c->kinds;
+        c->parent = i;
+    }
+    if (n->right) {
+        MarkerNode *c = &t->nodes[n->right];
+        if (c->max_end > n->max_end) n->max_end = c->max_end;
+        n->kinds |= c->kinds;
+        c->parent = i;
+    }
+}
+
+// Nodes ordered before (start, id) go left. Equal starts are ordered by id.
+static void split(MarkerTree *t, uint32_t i, uint64_t start, uint32_t id, uint32_t *l, uint32_t *r) {
+    MarkerNode *n;
+    if (!i) {
+        *l = 0;
+        *r = 0;
+        return;
+    }
+    push(t, i);
+    n = &t->nodes[i];
+    if (n->start < start || (n->start == start && i < id)) {
+        split(t, n->right, start, id, &n->right, r);
+        *l = i;
+    } else {
+        split(t, n->left, start, id, l, &n->left);
+        *r = i;
+    }
+    pull(t, i);
+}
+
+static uint32_t merge(MarkerTree *t, uint32_t a, uint32_t b) {
+    if (!a) return b;
+    if (!b) return a;
+    if (t->nodes[a].prio > t->nodes[b].prio) {
+        uint32_t right;
+        push(t, a);
+        right = merge(t, t->nodes[a].right, b);
+        t->nodes[a].right = right;
+        pull(t, a);
+        return a;
+    } else {
+        uint32_t left;
+        push(t, b);
+        left = merge(t, a, t->nodes[b].left);
+        t->nodes[b].left = left;
+        pull(t, b);
+        return b;
+    }
+}
+
+static void set_root(MarkerTree *t, uint32_t root) {
+    t->root = root;
+    if (root) t->nodes[root].parent = 0;
+}
+
+// Pushes every pending shift on the way from the root down to `i`, so its
+// stored offsets and those of its children are absolute.
+static void push_path(MarkerTree *t, uint32_t i) {
+    if (t->nodes[i].parent) push_path(t, t->nodes[i].parent);
+    push(t, i);
+}
+
+static void insert_node(MarkerTree *t, uint32_t i) {
+    uint32_t l;
+    uint32_t r;
+    MarkerNode *n = &t->nodes[i];
+    n->left = 0;
+    n->right = 0;
+    n->shift = 0;
+    pull(t, i);
+    split(t, t->root, n->start, i, &l, &r);
+    set_root(t, merge(t, merge(t, l, i), r));
+}
+
+// Takes `i` out of the tree; its offsets stay absolute.
+static void detach_node(MarkerTree *t, uint32_t i) {
+    MarkerNode *n = &t->nodes[i];
+    uint32_t parent = n->parent;
+    uint32_t child;
+
+    push_path(t, i);
+    child = merge(t, n->left, n->right);
+    if (!parent) {
+        set_root(t, child);
+        return;
+    }
+    if (t->nodes[parent].left == i) {
+        t->nodes[parent].left = child;
+    } else {
+        t->nodes[parent].right = child;
+    }
+    if (child) t->nodes[child].parent = parent;
+    for (; parent; parent = t->nodes[parent].parent) pull(t, parent);
+}
+
+static int valid_id(const MarkerTree *t, MarkerId id) {
+    return id > 0 && id < t->used && !(t->nodes[id].flags & MARKER_FREE);
+}
+
+void marker_tree_free(MarkerTree *t) {
+    if (t->cap) mem_account_free(MEM_SEARCH, (size_t)t->cap * sizeof(MarkerNode));
+    if (t->touched_cap) mem_account_free(MEM_SEARCH, t->touched_cap * sizeof(Marker));
+    free(t->nodes);
+    free(t->touched);
+    memset(t, 0, sizeof(*t));
+}
+
+void marker_tree_clear(MarkerTree *t) {
+    t->used = 0;
+    t->live = 0;
+    t->free_list = 0;
+    t->root = 0;
+}
+
+static uint32_t alloc_node(MarkerTree *t) {
+    uint32_t i;
+    if (t->free_list) {
+        i = t->free_list;
+        t->free_list = t->nodes[i].parent;
+        return i;
+    }
+    if (t->used == 0) t->used = 1;
+    if (t->used >= t->cap) {
+        uint32_t cap = t->cap ? t->cap * 2u : 256u;
+        MarkerNode *grown;
+        if (cap < t->cap || cap > UINT32_MAX / 2u) return 0;
+        grown = (MarkerNode *)realloc(t->nodes, (size_t)cap * sizeof(MarkerNode));
+        if (!grown) return 0;
+        mem_account_alloc(MEM_SEARCH, (size_t)(cap - t->cap) * sizeof(MarkerNode));
+        t->nodes = grown;
+        t->cap = cap;
+    }
+    return t->used++;
+}
+
+MarkerId marker_tree_add(MarkerTree *t, uint64_t start, uint64_t end, uint32_t kind, unsigned flags) {
+    uint32_t i = alloc_node(t);
+    MarkerNode *n;
+
+    if (!i) return 0;
+    n = &t->nodes[i];
+    memset(n, 0, sizeof(*n));
+    n->start = start;
+    n->end = end > start ? end : start;
+    n->prio = next_prio(t);
+    n->kind = kind;
+    n->flags = flags & MARKER_GROWS;
+    insert_node(t, i);
+    t->live++;
+    return i;
+}
+
+int marker_tree_remove(MarkerTree *t, MarkerId id) {
+    if (!valid_id(t, id)) return 0;
+    detach_node(t, id);
+    t->nodes[id].flags = MARKER_FREE;
+    t->nodes[id].parent = t->free_list;
+    t->free_list = id;
+    t->live--;
+    return 1;
+}
+
+int marker_tree_get(const MarkerTree *t, MarkerId id, Marker *out) {
+    uint64_t shift = 0;
+    if (!valid_id(t, id)) return 0;
+    // Offsets are stored relative to the shifts still pending above.
+    for (uint32_t p = t->nodes[id].parent; p; p = t->nodes[p].parent) shift += t->nodes[p].shift;
+    out->id = id;
+    out->start = t->nodes[id].start + shift;
+    out->end = t->nodes[id].end + shift;
+    out->kind = t->nodes[id].kind;
+    return 1;
+}
+
+uint32_t marker_tree_count(const MarkerTree *t) {
+    return t->live;
+}
+
+static int visit(MarkerTree *t, uint32_t i, uint64_t from, uint64_t to, uint32_t kinds, MarkerVisitFn fn, void *ctx) {
+    while (i) {
+        MarkerNode *n = &t->nodes[i];
+        if (n->max_end < from || !(n->kinds & kinds)) return 1;
+        push(t, i);
+        if (!visit(t, n->left, from, to, kinds, fn, ctx)) return 0;
+        if (n->start > to) return 1;
+        if (n->end >= from && (n->kind & kinds)) {
+            Marker m;
+            m.id = i;
+            m.start = n->start;
+            m.end = n->end;
+            m.kind = n->kind;
+            if (!fn(ctx, &m)) return 0;
+        }
+        i = n->right;
+    }
+    return 1;
+}
+
+void marker_tree_query(MarkerTree *t, uint64_t from, uint64_t to, uint32_t kinds, MarkerVisitFn fn, void *ctx) {
+    visit(t, t->root, from, to, kinds, fn, ctx);
+}
+
+static uint32_t find_next(MarkerTree *t, uint32_t i, uint64_t from, uint32_t kinds) {
+    while (i) {
+        MarkerNode *n = &t->nodes[i];
+        if (!(n->kinds & kinds)) return 0;
+        push(t, i);
+        if (n->start >= from) {
+            uint32_t hit = find_next(t, n->left, from, kinds);
+            if (hit) return hit;
+            if (n->kind & kinds) return i;
+        }
+        i = n->right;
+    }
+    return 0;
+}
+
+static uint32_t find_prev(MarkerTree *t, uint32_t i, uint64_t before, uint32_t kinds) {
+    while (i) {
+        MarkerNode *n = &t->nodes[i];
+        if (!(n->kinds & kinds)) return 0;
+        push(t, i);
+        if (n->start < before) {
+            uint32_t hit = find_prev(t, n->right, before, kinds);
+            if (hit) return hit;
+            if (n->kind & kinds) return i;
+        }
+        i = n->left;
+    }
+    return 0;
+}
+
+int marker_tree_next(MarkerTree *t, uint64_t from, uint32_t kinds, Marker *out) {
+    uint32_t i = find_next(t, t->root, from, kinds);
+    return i ? marker_tree_get(t, i, out) : 0;
+}
+
+int marker_tree_prev(MarkerTree *t, uint64_t before, uint32_t kinds, Marker *out) {
+    uint32_t i = find_prev(t, t->root, before, kinds);
+    return i ? marker_tree_get(t, i, out) : 0;
+}
+
+typedef struct {
+    MarkerTree *t;
+    size_t count;
+    int failed;
+} TouchedList;
+
+static int collect_touched(void *ctx, const Marker *m) {
+    TouchedList *list = (TouchedList *)ctx;
+    MarkerTree *t = list->t;
+    if (list->count == t->touched_cap) {
+        size_t cap = t->touched_cap ? t->touched_cap * 2u : 64u;
+        Marker *grown = (Marker *)realloc(t->touched, cap * sizeof(Marker));
+        if (!grown) {
+            list->failed = 1;
+            return 0;
+        }
+        mem_account_alloc(MEM_SEARCH, (cap - t->touched_cap) * sizeof(Marker));
+        t->touched = grown;
+        t->touched_cap = cap;
+    }
+    t->touched[list->count++] = *m;
+    return 1;
+}
+
+// Where an offset in or at the edges of the replaced range ends up.
+static uint64_t map_offset(uint64_t x, uint64_t offset, uint64_t delete_len, uint64_t insert_len, int after) {
+    if (x < offset) return x;
+    if (x > offset + delete_len) return x - delete_len + insert_len;
+    return after ? offset + insert_len : offset;
+}
+
+int marker_tree_edit(MarkerTree *t, uint64_t offset, uint64_t delete_len, uint64_t insert_len) {
+    TouchedList list;
+    uint32_t l;
+    uint32_t r;
+
+    if (!t->root || (delete_len == 0 && insert_len == 0)) return 1;
+    list.t = t;
+    list.count = 0;
+    list.failed = 0;
+    marker_tree_query(t, offset, offset + delete_len, ~0u, collect_touched, &list);
+    if (list.failed) return 0;
+
+    // What is left either ends before the edit or starts after it, so the
+    // tail keeps its order and moves as one subtree.
+    for (size_t k = 0; k < list.count; k++) detach_node(t, t->touched[k].id);
+    if (delete_len != insert_len) {
+        split(t, t->root, offset + delete_len + 1u, 0, &l, &r);
+        if (r) apply_shift(&t->nodes[r], insert_len - delete_len);
+        set_root(t, merge(t, l, r));
+    }
+
+    for (size_t k = 0; k < list.count; k++) {
+        const Marker *m = &t->touched[k];
+        MarkerNode *n = &t->nodes[m->id];
+        int grows = (n->flags & MARKER_GROWS) != 0;
+        n->start = map_offset(m->start, offset, delete_len, insert_len, !grows);
+        n->end = map_offset(m->end, offset, delete_len, insert_len, grows);
+        if (n->end < n->start) n->end = n->start;
+        insert_node(t, m->id);
+    }
+    return 1;
+}
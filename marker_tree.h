@@ -0,0 +1,67 @@
+// Edit-stable markers (bookmarks, search hits, highlight ranges)
+// Markers live in a treap ordered by start offset, where every node also
+// keeps the largest end and the kinds found in its subtree. An edit visits
+// only the markers that touch the changed range, and shifts everything after
+// it with one lazy offset on a subtree, so it costs O(log n + k) for k
+// touching markers instead of a pass over all of them.
+// Offsets are bytes. A zeroed MarkerTree is empty and ready to use.
+
+#ifndef MARKER_TREE_H
+#define MARKER_TREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MARKER_GROWS 0x1u   // text inserted at either edge joins the range
+
+typedef uint32_t MarkerId;   // 0 is never a marker; ids are reused after removal
+
+typedef struct MarkerNode MarkerNode;
+
+typedef struct {
+    MarkerId id;
+    uint64_t start;
+    uint64_t end;
+    uint32_t kind;
+} Marker;
+
+typedef struct {
+    MarkerNode *nodes;       // pool indexed by id; slot 0 is unused
+    uint32_t cap;
+    uint32_t used;           // slots handed out so far, free ones included
+    uint32_t live;
+    uint32_t free_list;
+    uint32_t root;
+    uint32_t seed;
+    Marker *touched;         // scratch for the markers an edit moves
+    size_t touched_cap;
+} MarkerTree;
+
+// Return 0 to stop the walk. The tree must not be changed from inside.
+typedef int (*MarkerVisitFn)(void *ctx, const Marker *m);
+
+void marker_tree_free(MarkerTree *t);
+void marker_tree_clear(MarkerTree *t);
+
+// `kind` is a single bit so queries can ask for several kinds at once.
+// Returns 0 on allocation failure.
+MarkerId marker_tree_add(MarkerTree *t, uint64_t start, uint64_t end, uint32_t kind, unsigned flags);
+int marker_tree_remove(MarkerTree *t, MarkerId id);
+int marker_tree_get(const MarkerTree *t, MarkerId id, Marker *out);
+uint32_t marker_tree_count(const MarkerTree *t);
+
+// Moves the markers for [offset, offset + delete_len) being replaced by
+// `insert_len` bytes. A start inside or at the edges of the replaced bytes
+// moves after the new text and an end before it, unless the marker grows.
+// Returns 0 on allocation failure, leaving the markers as they were.
+int marker_tree_edit(MarkerTree *t, uint64_t offset, uint64_t delete_len, uint64_t insert_len);
+
+// Visits the markers of `kinds` overlapping [from, to] in start order.
+void marker_tree_query(MarkerTree *t, uint64_t from, uint64_t to, uint32_t kinds, MarkerVisitFn fn, void *ctx);
+
+// First marker of `kinds` starting at or after `from`, and the last one
+// starting before `before`; 0 when there is none.
+int marker_tree_next(MarkerTree *t, uint64_t from, uint32_t kinds, Marker *out);
+int marker_tree_prev(MarkerTree *t, uint64_t before, uint32_t kinds, Marker *out);
+
+#endif
@@ -0,0 +1,106 @@
+// Per-subsystem memory counters with peak tracking
+
+#include "mem_account.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+typedef struct {
+    volatile int64_t current;
+    volatile int64_t peak;
+    char pad[64 - 2 * sizeof(int64_t)];   // one tag per cache line
+} TagCounters;
+
+static TagCounters g_tags[MEM_TAG_COUNT];
+
+static const char *const TAG_NAMES[MEM_TAG_COUNT] = {
+    "document", "undo", "render", "log", "search"
+};
+
+#ifdef _WIN32
+static int64_t atomic_add(volatile int64_t *p, int64_t v) {
+    return InterlockedExchangeAdd64((volatile LONG64 *)p, v) + v;
+}
+
+static int atomic_cas(volatile int64_t *p, int64_t expected, int64_t value) {
+    return InterlockedCompareExchange64((volatile LONG64 *)p, value, expected) == expected;
+}
+
+static int64_t atomic_load(volatile int64_t *p) {
+    return InterlockedCompareExchange64((volatile LONG64 *)p, 0, 0);
+}
+#else
+static int64_t atomic_add(volatile int64_t *p, int64_t v) {
+    return __atomic_add_fetch(p, v, __ATOMIC_RELAXED);
+}
+
+static int atomic_cas(volatile int64_t *p, int64_t expected, int64_t value) {
+    return __atomic_compare_exchange_n(p, &expected, value, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+static int64_t atomic_load(volatile int64_t *p) {
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+#endif
+
+void mem_account_alloc(MemTag tag, size_t bytes) {
+    TagCounters *t = &g_tags[tag];
+    int64_t now = atomic_add(&t->current, (int64_t)bytes);
+    int64_t peak = t->peak;
+
+    // A plain read is enough to skip the common case; the CAS settles races.
+    while (now > peak) {
+        if (atomic_cas(&t->peak, peak, now)) break;
+        peak = atomic_load(&t->peak);
+    }
+}
+
+void mem_account_free(MemTag tag, size_t bytes) {
+    atomic_add(&g_tags[tag].current, -(int64_t)bytes);
+}
+
+void mem_account_usage(MemTag tag, MemUsage *out) {
+    TagCounters *t = &g_tags[tag];
+    int64_t current = atomic_load(&t->current);
+    out->current = current > 0 ? (uint64_t)current : 0;
+    out->peak = (uint64_t)atomic_load(&t->peak);
+}
+
+const char *mem_tag_name(MemTag tag) {
+    return (unsigned)tag < MEM_TAG_COUNT ? TAG_NAMES[tag] : "?";
+}
+
+static void format_bytes(char *dst, size_t cap, uint64_t bytes) {
+    if (bytes >= 1024u * 1024u) {
+        snprintf(dst, cap, "%.1f MB", (double)bytes / 1048576.0);
+    } else if (bytes >= 1024u) {
+        snprintf(dst, cap, "%.1f KB", (double)bytes / 1024.0);
+    } else {
+        snprintf(dst, cap, "%llu B", (unsigned long long)bytes);
+    }
+}
+
+size_t mem_account_report(char *dst, size_t cap, const char *sep) {
+    size_t at = 0;
+
+    if (cap == 0) return 0;
+    dst[0] = '\0';
+    for (int i = 0; i < MEM_TAG_COUNT && at < cap; i++) {
+        MemUsage u;
+        char current[32];
+        char peak[32];
+        int n;
+
+        mem_account_usage((MemTag)i, &u);
+        format_bytes(current, sizeof(current), u.current);
+        format_bytes(peak, sizeof(peak), u.peak);
+        n = snprintf(dst + at, cap - at, "%s%s %s (peak %s)", i ? sep : "", TAG_NAMES[i], current, peak);
+        if (n < 0) break;
+        at += (size_t)n;
+    }
+    return at < cap ? at : cap - 1u;
+}
@@ -0,0 +1,39 @@
+// Per-subsystem memory counters with peak tracking
+// Subsystems report the bytes they allocate and release under a tag. Each
+// tag's counters are lock-free atomics on their own cache line, so a report
+// costs one atomic add, plus a compare-exchange when it sets a new peak.
+// Reports are made per page, frame or batch, never per small object. The
+// counters only know what is reported; memory owned by Windows controls
+// (the EDIT buffer, GDI objects) is sampled by the caller.
+
+#ifndef MEM_ACCOUNT_H
+#define MEM_ACCOUNT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    MEM_DOCUMENT = 0,       // DocStore pages: snapshots, staging copies
+    MEM_UNDO,               // edit journal batches
+    MEM_RENDER,             // back buffer frames, menu labels
+    MEM_LOG,
+    MEM_SEARCH,             // markers and navigation indexes (bookmarks, brackets, folds, words)
+    MEM_TAG_COUNT
+} MemTag;
+
+typedef struct {
+    uint64_t current;
+    uint64_t peak;
+} MemUsage;
+
+void mem_account_alloc(MemTag tag, size_t bytes);
+void mem_account_free(MemTag tag, size_t bytes);
+
+void mem_account_usage(MemTag tag, MemUsage *out);
+const char *mem_tag_name(MemTag tag);
+
+// Writes one "name current (peak N)" entry per tag joined by `sep`; returns
+// the length written, truncated to fit `cap`.
+size_t mem_account_report(char *dst, size_t cap, const char *sep);
+
+#endif
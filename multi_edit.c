@@ -0,0 +1,535 @@
+// Multiple carets and batched edits
+
+#include "multi_edit.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_COLUMN UINT64_MAX   // worked out again when a vertical move needs it
+
+// One caret's share of a batched edit.
+typedef struct {
+    uint64_t at;
+    uint64_t del;
+    const char *ins;
+    size_t ins_len;
+} Piece;
+
+static uint64_t caret_lo(const MultiCaret *c) {
+    return c->anchor < c->caret ? c->anchor : c->caret;
+}
+
+static uint64_t caret_hi(const MultiCaret *c) {
+    return c->anchor > c->caret ? c->anchor : c->caret;
+}
+
+// Clamps to the text and moves a position inside a CRLF before it.
+static uint64_t snap(const char *text, size_t len, uint64_t pos) {
+    if (pos > len) pos = len;
+    if (pos > 0 && pos < len && text[pos - 1u] == '\r' && text[pos] == '\n') pos--;
+    return pos;
+}
+
+static uint64_t line_start(const char *text, uint64_t pos) {
+    while (pos > 0 && text[pos - 1u] != '\n') pos--;
+    return pos;
+}
+
+// End of the line starting at `start`, before its line break.
+static uint64_t line_end(const char *text, size_t len, uint64_t start) {
+    const char *nl = (const char *)memchr(text + start, '\n', len - (size_t)start);
+    uint64_t end = nl ? (uint64_t)(nl - text) : len;
+    if (nl && end > start && text[end - 1u] == '\r') end--;
+    return end;
+}
+
+// Start of the next line, or `len` when `start` is on the last one.
+static uint64_t next_line(const char *text, size_t len, uint64_t start, int *found) {
+    const char *nl = (const char *)memchr(text + start, '\n', len - (size_t)start);
+    *found = nl != NULL;
+    return nl ? (uint64_t)(nl - text) + 1u : len;
+}
+
+static uint64_t step_left(const char *text, uint64_t pos) {
+    if (pos >= 2u && text[pos - 1u] == '\n' && text[pos - 2u] == '\r') return pos - 2u;
+    return pos > 0 ? pos - 1u : 0;
+}
+
+static uint64_t step_right(const char *text, size_t len, uint64_t pos) {
+    if (pos + 1u < len && text[pos] == '\r' && text[pos + 1u] == '\n') return pos + 2u;
+    return pos < len ? pos + 1u : len;
+}
+
+static uint64_t column_of(const char *text, uint64_t start, uint64_t pos) {
+    uint64_t column = 0;
+    for (uint64_t p = start; p < pos; p++) {
+        column += text[p] == '\t' ? MULTI_TAB_WIDTH - column % MULTI_TAB_WIDTH : 1u;
+    }
+    return column;
+}
+
+// The last position on [start, end) whose column does not pass `column`.
+static uint64_t at_column(const char *text, uint64_t start, uint64_t end, uint64_t column) {
+    uint64_t at = 0;
+    uint64_t p = start;
+    while (p < end) {
+        uint64_t width = text[p] == '\t' ? MULTI_TAB_WIDTH - at % MULTI_TAB_WIDTH : 1u;
+        if (at + width > column) break;
+        at += width;
+        p++;
+    }
+    return p;
+}
+
+static uint64_t caret_column(const char *text, const MultiCaret *c) {
+    if (c->column != NO_COLUMN) return c->column;
+    return column_of(text, line_start(text, c->caret), c->caret);
+}
+
+// Where `pos` goes on the line above or below, keeping `column`; returns 0
+// when there is no such line.
+static int vertical(const char *text, size_t len, uint64_t pos, uint64_t column, int down, uint64_t *out) {
+    uint64_t start = line_start(text, pos);
+    if (down) {
+        int found;
+        start = next_line(text, len, start, &found);
+        if (!found) return 0;
+    } else {
+        if (start == 0) return 0;
+        start = line_start(text, start - 1u);
+    }
+    *out = at_column(text, start, line_end(text, len, start), column);
+    return 1;
+}
+
+static int reserve(MultiEdit *me, size_t count) {
+    size_t cap = me->cap ? me->cap : 16u;
+    MultiCaret *grown;
+    if (count <= me->cap) return 1;
+    while (cap < count) cap *= 2u;
+    grown = (MultiCaret *)realloc(me->carets, cap * sizeof(MultiCaret));
+    if (!grown) return 0;
+    me->carets = grown;
+    me->cap = cap;
+    return 1;
+}
+
+void multi_edit_free(MultiEdit *me) {
+    free(me->carets);
+    memset(me, 0, sizeof(*me));
+}
+
+void multi_edit_clear(MultiEdit *me) {
+    me->count = 0;
+    me->primary = 0;
+}
+
+// A caret at the edge of a selection joins it; two selections that only
+// touch stay apart.
+static int overlaps(const MultiCaret *a, const MultiCaret *b) {
+    uint64_t a_hi = caret_hi(a);
+    uint64_t b_lo = caret_lo(b);
+    return b_lo < a_hi || (b_lo == a_hi && (caret_lo(a) == a_hi || b_lo == caret_hi(b)));
+}
+
+// The carets are in order of their starts; joins the ones that overlap.
+static void merge_carets(MultiEdit *me) {
+    size_t kept = 0;
+    for (size_t i = 0; i < me->count; i++) {
+        MultiCaret c = me->carets[i];
+        if (kept > 0 && overlaps(&me->carets[kept - 1u], &c)) {
+            MultiCaret *prev = &me->carets[kept - 1u];
+            uint64_t lo = caret_lo(prev);
+            uint64_t hi = caret_hi(prev) > caret_hi(&c) ? caret_hi(prev) : caret_hi(&c);
+            if (prev->caret >= prev->anchor) {
+                prev->anchor = lo;
+                prev->caret = hi;
+            } else {
+                prev->anchor = hi;
+                prev->caret = lo;
+            }
+            prev->column = NO_COLUMN;
+            if (me->primary == i) me->primary = kept - 1u;
+            continue;
+        }
+        if (me->primary == i) me->primary = kept;
+        me->carets[kept++] = c;
+    }
+    me->count = kept;
+}
+
+int multi_edit_add(MultiEdit *me, const char *text, size_t len, uint64_t anchor, uint64_t caret) {
+    MultiCaret c;
+    size_t lo = 0;
+    size_t hi = me->count;
+
+    if (!reserve(me, me->count + 1u)) return 0;
+    c.anchor = snap(text, len, anchor);
+    c.caret = snap(text, len, caret);
+    c.column = NO_COLUMN;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2u;
+        if (caret_lo(&me->carets[mid]) <= caret_lo(&c)) {
+            lo = mid + 1u;
+        } else {
+            hi = mid;
+        }
+    }
+    memmove(me->carets + lo + 1u, me->carets + lo, (me->count - lo) * sizeof(MultiCaret));
+    me->carets[lo] = c;
+    me->count++;
+    me->primary = lo;
+    merge_carets(me);
+    return 1;
+}
+
+// Swaps in a freshly built caret list.
+static void replace_carets(MultiEdit *me, MultiCaret *carets, size_t count, size_t cap, size_t primary) {
+    free(me->carets);
+    me->carets = carets;
+    me->count = count;
+    me->cap = cap;
+    me->primary = primary;
+}
+
+static MultiCaret *push_caret(MultiCaret *carets, size_t *count, size_t *cap) {
+    if (*count == *cap) {
+        size_t grown_cap = *cap ? *cap * 2u : 64u;
+        MultiCaret *grown = (MultiCaret *)realloc(carets, grown_cap * sizeof(MultiCaret));
+        if (!grown) return NULL;
+        carets = grown;
+        *cap = grown_cap;
+    }
+    return carets;
+}
+
+int multi_edit_column_select(MultiEdit *me, const char *text, size_t len, uint64_t from, uint64_t to) {
+    uint64_t from_start;
+    uint64_t to_start;
+    uint64_t first;
+    uint64_t last;
+    uint64_t from_column;
+    uint64_t to_column;
+    MultiCaret *carets = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+
+    from = snap(text, len, from);
+    to = snap(text, len, to);
+    from_start = line_start(text, from);
+    to_start = line_start(text, to);
+    from_column = column_of(text, from_start, from);
+    to_column = column_of(text, to_start, to);
+    first = from_start < to_start ? from_start : to_start;
+    last = from_start < to_start ? to_start : from_start;
+
+    for (uint64_t start = first;;) {
+        uint64_t end = line_end(text, len, start);
+        MultiCaret *grown = push_caret(carets, &count, &cap);
+        int found;
+        if (!grown) {
+            free(carets);
+            return 0;
+        }
+        carets = grown;
+        carets[count].anchor = at_column(text, start, end, from_column);
+        carets[count].caret = at_column(text, start, end, to_column);
+        carets[count].column = to_column;
+        count++;
+        if (start == last) break;
+        start = next_line(text, len, start, &found);
+    }
+    replace_carets(me, carets, count, cap, to_start < from_start ? 0 : count - 1u);
+    return 1;
+}
+
+int multi_edit_line_ends(MultiEdit *me, const char *text, size_t len, uint64_t from, uint64_t to) {
+    uint64_t first;
+    uint64_t last;
+    MultiCaret *carets = NULL;
+    size_t count = 0;
+    size_t cap = 0;
+
+    from = snap(text, len, from);
+    to = snap(text, len, to);
+    if (to < from) {
+        uint64_t swap = to;
+        to = from;
+        from = swap;
+    }
+    if (to > from && text[to - 1u] == '\n') to--;
+    first = line_start(text, from);
+    last = line_start(text, to);
+
+    for (uint64_t start = first;;) {
+        uint64_t end = line_end(text, len, start);
+        MultiCaret *grown = push_caret(carets, &count, &cap);
+        int found;
+        if (!grown) {
+            free(carets);
+            return 0;
+        }
+        carets = grown;
+        carets[count].anchor = end;
+        carets[count].caret = end;
+        carets[count].column = NO_COLUMN;
+        count++;
+        if (start == last) break;
+        start = next_line(text, len, start, &found);
+    }
+    replace_carets(me, carets, count, cap, count - 1u);
+    return 1;
+}
+
+int multi_edit_add_vertical(MultiEdit *me, const char *text, size_t len, int down) {
+    const MultiCaret *from;
+    uint64_t column;
+    uint64_t pos;
+
+    if (me->count == 0) return 0;
+    from = &me->carets[down ? me->count - 1u : 0];
+    column = caret_column(text, from);
+    if (!vertical(text, len, from->caret, column, down, &pos)) return 0;
+    if (!multi_edit_add(me, text, len, pos, pos)) return 0;
+    me->carets[me->primary].column = column;
+    return 1;
+}
+
+// Caret moves keep the order of the carets, so only neighbours can meet.
+void multi_edit_move(MultiEdit *me, const char *text, size_t len, MultiMove move, int extend) {
+    for (size_t i = 0; i < me->count; i++) {
+        MultiCaret *c = &me->carets[i];
+        uint64_t lo = caret_lo(c);
+        uint64_t hi = caret_hi(c);
+        uint64_t pos = c->caret;
+        uint64_t column = NO_COLUMN;
+
+        switch (move) {
+            case MULTI_LEFT:
+                pos = !extend && lo != hi ? lo : step_left(text, pos);
+                break;
+            case MULTI_RIGHT:
+                pos = !extend && lo != hi ? hi : step_right(text, len, pos);
+                break;
+            case MULTI_HOME:
+                pos = line_start(text, pos);
+                break;
+            case MULTI_END:
+                pos = line_end(text, len, line_start(text, pos));
+                break;
+            case MULTI_UP:
+            case MULTI_DOWN:
+                column = caret_column(text, c);
+                vertical(text, len, pos, column, move == MULTI_DOWN, &pos);
+                break;
+        }
+        c->caret = pos;
+        if (!extend) c->anchor = pos;
+        c->column = column;
+    }
+    merge_carets(me);
+}
+
+// Applies one piece per caret, in caret order. A piece reaching into the
+// one before it is cut back, so the ranges never overlap.
+static int build_patch(MultiEdit *me, const char *text, Piece *pieces, MultiPatch *out) {
+    size_t changed = 0;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    uint64_t removed = 0;
+    uint64_t added = 0;
+    int64_t shift = 0;
+    char *dst;
+
+    memset(out, 0, sizeof(*out));
+    for (size_t i = 0; i < me->count; i++) {
+        Piece *p = &pieces[i];
+        if (i > 0 && p->at < pieces[i - 1u].at + pieces[i - 1u].del) {
+            uint64_t prev_end = pieces[i - 1u].at + pieces[i - 1u].del;
+            p->del = p->at + p->del > prev_end ? p->at + p->del - prev_end : 0;
+            p->at = prev_end;
+        }
+        if (p->del == 0 && p->ins_len == 0) continue;
+        if (changed == 0) start = p->at;
+        end = p->at + p->del;
+        removed += p->del;
+        added += p->ins_len;
+        changed++;
+    }
+    if (changed == 0) return 1;
+
+    out->len = (size_t)(end - start - removed + added);
+    out->text = (char *)malloc(out->len + 1u);
+    out->ranges = (MultiRange *)malloc(changed * sizeof(MultiRange));
+    if (!out->text || !out->ranges) {
+        multi_patch_free(out);
+        return 0;
+    }
+    out->start = start;
+    out->end = end;
+
+    // One pass: the untouched text between ranges, then each replacement.
+    dst = out->text;
+    for (size_t i = 0, from = (size_t)start; i < me->count; i++) {
+        const Piece *p = &pieces[i];
+        MultiCaret *c = &me->carets[i];
+        if (p->del > 0 || p->ins_len > 0) {
+            MultiRange *r = &out->ranges[out->range_count++];
+            memcpy(dst, text + from, (size_t)p->at - from);
+            dst += (size_t)p->at - from;
+            if (p->ins_len > 0) memcpy(dst, p->ins, p->ins_len);
+            dst += p->ins_len;
+            from = (size_t)(p->at + p->del);
+            r->offset = p->at;
+            r->delete_len = p->del;
+            r->insert_len = p->ins_len;
+        }
+        c->caret = (uint64_t)((int64_t)(p->at + p->ins_len) + shift);
+        c->anchor = c->caret;
+        c->column = NO_COLUMN;
+        shift += (int64_t)p->ins_len - (int64_t)p->del;
+    }
+    *dst = '\0';
+    merge_carets(me);
+    return 1;
+}
+
+static Piece *alloc_pieces(const MultiEdit *me) {
+    return (Piece *)malloc((me->count ? me->count : 1u) * sizeof(Piece));
+}
+
+int multi_edit_type(MultiEdit *me, const char *text, size_t len, const char *insert, size_t insert_len, MultiPatch *out) {
+    Piece *pieces = alloc_pieces(me);
+    int ok;
+    (void)len;
+    if (!pieces) return 0;
+    for (size_t i = 0; i < me->count; i++) {
+        pieces[i].at = caret_lo(&me->carets[i]);
+        pieces[i].del = caret_hi(&me->carets[i]) - pieces[i].at;
+        pieces[i].ins = insert;
+        pieces[i].ins_len = insert_len;
+    }
+    ok = build_patch(me, text, pieces, out);
+    free(pieces);
+    return ok;
+}
+
+int multi_edit_delete(MultiEdit *me, const char *text, size_t len, int forward, MultiPatch *out) {
+    Piece *pieces = alloc_pieces(me);
+    int ok;
+    if (!pieces) return 0;
+    for (size_t i = 0; i < me->count; i++) {
+        const MultiCaret *c = &me->carets[i];
+        uint64_t lo = caret_lo(c);
+        uint64_t hi = caret_hi(c);
+        if (lo == hi) {
+            if (forward) {
+                hi = step_right(text, len, hi);
+            } else {
+                lo = step_left(text, lo);
+            }
+        }
+        pieces[i].at = lo;
+        pieces[i].del = hi - lo;
+        pieces[i].ins = NULL;
+        pieces[i].ins_len = 0;
+    }
+    ok = build_patch(me, text, pieces, out);
+    free(pieces);
+    return ok;
+}
+
+int multi_edit_paste(MultiEdit *me, const char *text, size_t len, const char *clip, size_t clip_len, MultiPatch *out) {
+    Piece *pieces;
+    size_t lines = 0;
+    size_t at = 0;
+    int ok;
+
+    // A line break at the very end does not start another line.
+    for (size_t i = 0; i < clip_len; i++) {
+        if (clip[i] == '\n') lines++;
+    }
+    if (clip_len > 0 && clip[clip_len - 1u] != '\n') lines++;
+    if (lines != me->count || me->count < 2u) return multi_edit_type(me, text, len, clip, clip_len, out);
+
+    pieces = alloc_pieces(me);
+    if (!pieces) return 0;
+    for (size_t i = 0; i < me->count; i++) {
+        const char *nl = (const char *)memchr(clip + at, '\n', clip_len - at);
+        size_t end = nl ? (size_t)(nl - clip) : clip_len;
+        size_t n = end - at;
+        if (n > 0 && clip[end - 1u] == '\r') n--;
+        pieces[i].at = caret_lo(&me->carets[i]);
+        pieces[i].del = caret_hi(&me->carets[i]) - pieces[i].at;
+        pieces[i].ins = clip + at;
+        pieces[i].ins_len = n;
+        at = nl ? end + 1u : clip_len;
+    }
+    ok = build_patch(me, text, pieces, out);
+    free(pieces);
+    return ok;
+}
+
+char *multi_edit_copy(const MultiEdit *me, const char *text, size_t len, const char *eol, size_t *out_len) {
+    size_t eol_len = strlen(eol);
+    size_t total = 0;
+    size_t pieces = 0;
+    char *out;
+    char *dst;
+    (void)len;
+
+    for (size_t i = 0; i < me->count; i++) {
+        uint64_t n = caret_hi(&me->carets[i]) - caret_lo(&me->carets[i]);
+        if (n == 0) continue;
+        total += (size_t)n + (pieces > 0 ? eol_len : 0);
+        pieces++;
+    }
+    out = (char *)malloc(total + 1u);
+    if (!out) return NULL;
+    dst = out;
+    pieces = 0;
+    for (size_t i = 0; i < me->count; i++) {
+        uint64_t lo = caret_lo(&me->carets[i]);
+        uint64_t n = caret_hi(&me->carets[i]) - lo;
+        if (n == 0) continue;
+        if (pieces++ > 0) {
+            memcpy(dst, eol, eol_len);
+            dst += eol_len;
+        }
+        memcpy(dst, text + lo, (size_t)n);
+        dst += n;
+    }
+    *dst = '\0';
+    if (out_len) *out_len = total;
+    return out;
+}
+
+// Once the ranges after range i are applied, the text from the end of range
+// i - 1 on is the final text shifted by the size change of ranges 0..i-1.
+void multi_patch_each_span(const MultiPatch *patch, const char *text, size_t len, MultiSpanFn fn, void *ctx) {
+    const MultiRange *r = patch->ranges;
+    int64_t shift_hi = 0;
+    for (size_t i = 0; i < patch->range_count; i++) shift_hi += (int64_t)r[i].insert_len - (int64_t)r[i].delete_len;
+
+    for (size_t hi = patch->range_count; hi > 0;) {
+        size_t lo = hi - 1u;
+        int64_t shift_lo = shift_hi - ((int64_t)r[lo].insert_len - (int64_t)r[lo].delete_len);
+        while (lo > 0) {
+            uint64_t gap = r[lo - 1u].offset + r[lo - 1u].delete_len;
+            if (memchr(text + (size_t)((int64_t)gap + shift_lo), '\n', (size_t)(r[lo].offset - gap))) break;
+            lo--;
+            shift_lo -= (int64_t)r[lo].insert_len - (int64_t)r[lo].delete_len;
+        }
+        uint64_t delete_len = r[hi - 1u].offset + r[hi - 1u].delete_len - r[lo].offset;
+        fn(ctx, text + shift_lo, (size_t)((int64_t)len - shift_lo), r[lo].offset, delete_len,
+            (uint64_t)((int64_t)delete_len + shift_hi - shift_lo));
+        hi = lo;
+        shift_hi = shift_lo;
+    }
+}
+
+void multi_patch_free(MultiPatch *patch) {
+    free(patch->text);
+    free(patch->ranges);
+    memset(patch, 0, sizeof(*patch));
+}
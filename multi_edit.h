@@ -0,0 +1,110 @@
+// Multiple carets and batched edits
+// Carets, each with an anchor so it can hold a selection, are kept sorted
+// and disjoint. A keystroke turns into one range per caret, and the ranges
+// become a single patch in one pass: the text from the first range to the
+// last with every range applied. The caller replaces that span once, so a
+// keystroke is one change and one undo step however many carets there are,
+// and the carets only move by the running size difference.
+// Offsets are bytes. A CRLF is stepped over and deleted as one unit, and a
+// caret never sits inside one. Columns count characters with tabs expanded
+// to MULTI_TAB_WIDTH; vertical moves keep each caret's column.
+
+#ifndef MULTI_EDIT_H
+#define MULTI_EDIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MULTI_TAB_WIDTH 8u
+
+typedef struct {
+    uint64_t anchor;
+    uint64_t caret;
+    uint64_t column;       // goal column for vertical moves
+} MultiCaret;
+
+typedef struct {
+    MultiCaret *carets;    // sorted, selections disjoint
+    size_t count;
+    size_t cap;
+    size_t primary;        // the caret the view follows
+} MultiEdit;
+
+typedef struct {
+    uint64_t offset;       // in the text before the patch
+    uint64_t delete_len;
+    uint64_t insert_len;
+} MultiRange;
+
+typedef struct {
+    uint64_t start;        // [start, end) of the old text is replaced by `text`
+    uint64_t end;
+    char *text;            // NUL-terminated
+    size_t len;
+    MultiRange *ranges;    // ascending; range_count is 0 when nothing changes
+    size_t range_count;
+} MultiPatch;
+
+typedef enum {
+    MULTI_LEFT = 0,
+    MULTI_RIGHT,
+    MULTI_HOME,
+    MULTI_END,
+    MULTI_UP,
+    MULTI_DOWN
+} MultiMove;
+
+// A zeroed MultiEdit has no carets. Functions taking `text` read the
+// current document; those that build a patch move the carets as if it had
+// been applied. Everything returns 0 on allocation failure, leaving the
+// carets as they were.
+void multi_edit_free(MultiEdit *me);
+void multi_edit_clear(MultiEdit *me);
+
+// Adds a caret, merging it with any it overlaps, and makes it the primary.
+int multi_edit_add(MultiEdit *me, const char *text, size_t len, uint64_t anchor, uint64_t caret);
+
+// Replaces the carets with a rectangle from the column of `from` to the
+// column of `to` on every line between them; lines too short for it get a
+// caret at their end.
+int multi_edit_column_select(MultiEdit *me, const char *text, size_t len, uint64_t from, uint64_t to);
+
+// Replaces the carets with one at the end of each line in [from, to]. A
+// `to` at the start of a line leaves that line out.
+int multi_edit_line_ends(MultiEdit *me, const char *text, size_t len, uint64_t from, uint64_t to);
+
+// Adds a caret on the line below the last caret (or above the first), at
+// its column. Returns 0 as well when there is no such line.
+int multi_edit_add_vertical(MultiEdit *me, const char *text, size_t len, int down);
+
+// With `extend` the anchors stay; otherwise LEFT and RIGHT first collapse a
+// selection to its edge.
+void multi_edit_move(MultiEdit *me, const char *text, size_t len, MultiMove move, int extend);
+
+// Replaces every selection (or inserts at every caret) with `insert`.
+int multi_edit_type(MultiEdit *me, const char *text, size_t len, const char *insert, size_t insert_len, MultiPatch *out);
+
+// Deletes the selections, and a character before (or after) empty carets.
+int multi_edit_delete(MultiEdit *me, const char *text, size_t len, int forward, MultiPatch *out);
+
+// Pastes one line of `clip` per caret when it has exactly that many lines,
+// otherwise all of it at each caret.
+int multi_edit_paste(MultiEdit *me, const char *text, size_t len, const char *clip, size_t clip_len, MultiPatch *out);
+
+// The selected text of every caret joined with `eol`; NULL when out of
+// memory. The result is malloc'd and NUL-terminated.
+char *multi_edit_copy(const MultiEdit *me, const char *text, size_t len, const char *eol, size_t *out_len);
+
+// Hands a patch that has been applied, leaving `text` of `len` bytes, to
+// `fn` range by range, the last first, so every offset is the one in the
+// text before the patch. Each call gets the document as it stands after
+// that range, in `text` and `len`; its bytes before the range ahead of the
+// span are stale and must not be read. Ranges without a line break between
+// them go as one span, so code that rescans whole lines or words around an
+// edit only ever reads bytes that are current.
+typedef void (*MultiSpanFn)(void *ctx, const char *text, size_t len, uint64_t offset, uint64_t delete_len, uint64_t insert_len);
+void multi_patch_each_span(const MultiPatch *patch, const char *text, size_t len, MultiSpanFn fn, void *ctx);
+
+void multi_patch_free(MultiPatch *patch);
+
+#endif
@@ -0,0 +1,667 @@
+// Incremental bracket and indent structure index
+
+#include "struct_index.h"
+#include "mem_account.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum { LEX_CODE = 0, LEX_COMMENT = 1 };
+
+// Bytes the code state has to look at; everything else is skipped.
+static const unsigned char SPECIAL[256] = {
+    ['/'] = 1, ['"'] = 1, ['\''] = 1,
+    ['('] = 1, ['['] = 1, ['{'] = 1, [')'] = 1, [']'] = 1, ['}'] = 1
+};
+
+// Receives each bracket outside strings and comments with its offset in the
+// line; return 0 to stop.
+typedef int (*BracketFn)(void *ctx, size_t pos, char c);
+
+typedef struct {
+    size_t b;            // block
+    uint32_t i;          // line within the block
+    uint64_t line;
+    uint64_t start;      // offset of the line
+} Cursor;
+
+static int is_opener(char c) {
+    return c == '(' || c == '[' || c == '{';
+}
+
+static int is_closer(char c) {
+    return c == ')' || c == ']' || c == '}';
+}
+
+static char pair_of(char c) {
+    switch (c) {
+        case '(': return ')';
+        case '[': return ']';
+        case '{': return '}';
+        case ')': return '(';
+        case ']': return '[';
+        case '}': return '{';
+        default: return 0;
+    }
+}
+
+// Lexes one line (`n` bytes, break included) starting in `state`. `fn` may
+// be NULL and `out` may be NULL; returns 0 if `fn` stopped the walk.
+static int lex_line(const char *p, size_t n, int state, BracketFn fn, void *ctx, StructLine *out) {
+    size_t i = 0;
+    int32_t depth = 0;
+    int32_t low = 0;
+    unsigned indent = 0;
+    int blank;
+
+    while (i < n && (p[i] == ' ' || p[i] == '\t')) {
+        indent = p[i] == '\t' ? (indent / STRUCT_TAB_WIDTH + 1u) * STRUCT_TAB_WIDTH : indent + 1u;
+        i++;
+    }
+    blank = i == n || p[i] == '\r' || p[i] == '\n';
+
+    while (i < n) {
+        unsigned char c;
+        if (state == LEX_COMMENT) {
+            const char *star = (const char *)memchr(p + i, '*', n - i);
+            if (!star) break;
+            i = (size_t)(star - p) + 1u;
+            if (i < n && p[i] == '/') {
+                state = LEX_CODE;
+                i++;
+            }
+            continue;
+        }
+        c = (unsigned char)p[i];
+        if (!SPECIAL[c]) {
+            i++;
+            continue;
+        }
+        switch (c) {
+            case '/':
+                if (i + 1u < n && p[i + 1u] == '/') {
+                    i = n;
+                    continue;
+                }
+                if (i + 1u < n && p[i + 1u] == '*') {
+                    state = LEX_COMMENT;
+                    i += 2u;
+                    continue;
+                }
+                break;
+            case '"':
+            case '\'':
+                // Strings end at the closing quote or the line end.
+                for (i++; i < n && p[i] != (char)c && p[i] != '\n'; i++) {
+                    if (p[i] == '\\') i++;
+                }
+                break;
+            case '(':
+            case '[':
+            case '{':
+                depth++;
+                if (fn && !fn(ctx, i, (char)c)) return 0;
+                break;
+            default:
+                depth--;
+                if (depth < low) low = depth;
+                if (fn && !fn(ctx, i, (char)c)) return 0;
+                break;
+        }
+        i++;
+    }
+
+    if (out) {
+        out->len = (uint32_t)n;
+        out->delta = depth;
+        out->low = low;
+        out->indent = blank ? STRUCT_BLANK : (uint16_t)(indent < STRUCT_BLANK ? indent : STRUCT_BLANK - 1u);
+        out->state = (uint8_t)state;
+        out->brk = 0;
+        if (n > 0 && p[n - 1u] == '\n') out->brk = n > 1u && p[n - 2u] == '\r' ? 2 : 1;
+    }
+    return 1;
+}
+
+static StructLine *alloc_lines(void) {
+    StructLine *lines = (StructLine *)malloc(STRUCT_BLOCK_LINES * sizeof(StructLine));
+    if (lines) mem_account_alloc(MEM_SEARCH, STRUCT_BLOCK_LINES * sizeof(StructLine));
+    return lines;
+}
+
+static void free_lines(StructLine *lines) {
+    if (!lines) return;
+    mem_account_free(MEM_SEARCH, STRUCT_BLOCK_LINES * sizeof(StructLine));
+    free(lines);
+}
+
+static void summarize(StructBlock *blk) {
+    int64_t depth = 0;
+    blk->bytes = 0;
+    blk->low = 0;
+    blk->min_indent = STRUCT_BLANK;
+    for (uint32_t i = 0; i < blk->count; i++) {
+        const StructLine *ln = &blk->lines[i];
+        if (depth + ln->low < blk->low) blk->low = depth + ln->low;
+        depth += ln->delta;
+        blk->bytes += ln->len;
+        if (ln->indent < blk->min_indent) blk->min_indent = ln->indent;
+    }
+    blk->delta = depth;
+}
+
+static int reserve_blocks(StructIndex *si, size_t need) {
+    StructBlock *grown;
+    size_t cap = si->cap ? si->cap : 16u;
+    if (need <= si->cap) return 1;
+    while (cap < need) cap *= 2u;
+    grown = (StructBlock *)realloc(si->blocks, cap * sizeof(StructBlock));
+    if (!grown) return 0;
+    si->blocks = grown;
+    si->cap = cap;
+    return 1;
+}
+
+void struct_index_free(StructIndex *si) {
+    for (size_t b = 0; b < si->count; b++) free_lines(si->blocks[b].lines);
+    free(si->blocks);
+    memset(si, 0, sizeof(*si));
+}
+
+int struct_index_build(StructIndex *si, const char *text, size_t len) {
+    size_t at = 0;
+    int state = LEX_CODE;
+    StructBlock *blk = NULL;
+
+    struct_index_free(si);
+    for (;;) {
+        const char *nl = (const char *)memchr(text + at, '\n', len - at);
+        size_t n = nl ? (size_t)(nl - (text + at)) + 1u : len - at;
+
+        if (!blk || blk->count == STRUCT_BLOCK_LINES) {
+            if (blk) summarize(blk);
+            if (!reserve_blocks(si, si->count + 1u)) break;
+            blk = &si->blocks[si->count];
+            memset(blk, 0, sizeof(*blk));
+            blk->lines = alloc_lines();
+            if (!blk->lines) break;
+            si->count++;
+        }
+        lex_line(text + at, n, state, NULL, NULL, &blk->lines[blk->count]);
+        state = blk->lines[blk->count].state;
+        blk->count++;
+        si->lines++;
+        at += n;
+        if (!nl) {
+            summarize(blk);
+            si->bytes = len;
+            si->rescanned = si->lines;
+            return 1;
+        }
+    }
+    struct_index_free(si);
+    return 0;
+}
+
+static const StructLine *line_at(const StructIndex *si, Cursor c) {
+    return &si->blocks[c.b].lines[c.i];
+}
+
+static int state_before(const StructIndex *si, Cursor c) {
+    if (c.i > 0) return si->blocks[c.b].lines[c.i - 1u].state;
+    if (c.b > 0) return si->blocks[c.b - 1u].lines[si->blocks[c.b - 1u].count - 1u].state;
+    return LEX_CODE;
+}
+
+static int cursor_next(const StructIndex *si, Cursor *c) {
+    c->start += si->blocks[c->b].lines[c->i].len;
+    c->line++;
+    if (++c->i < si->blocks[c->b].count) return 1;
+    c->i = 0;
+    return ++c->b < si->count;
+}
+
+static int cursor_prev(const StructIndex *si, Cursor *c) {
+    if (c->i == 0) {
+        if (c->b == 0) return 0;
+        c->b--;
+        c->i = si->blocks[c->b].count;
+    }
+    c->i--;
+    c->line--;
+    c->start -= si->blocks[c->b].lines[c->i].len;
+    return 1;
+}
+
+// The line holding `offset`; an offset at a line start belongs to that line.
+static Cursor locate_offset(const StructIndex *si, uint64_t offset) {
+    Cursor c = { 0, 0, 0, 0 };
+    const StructBlock *blk;
+    while (c.b + 1u < si->count && offset >= c.start + si->blocks[c.b].bytes) {
+        c.start += si->blocks[c.b].bytes;
+        c.line += si->blocks[c.b].count;
+        c.b++;
+    }
+    blk = &si->blocks[c.b];
+    while (c.i + 1u < blk->count && offset >= c.start + blk->lines[c.i].len) {
+        c.start += blk->lines[c.i].len;
+        c.line++;
+        c.i++;
+    }
+    return c;
+}
+
+static Cursor locate_line(const StructIndex *si, uint64_t line) {
+    Cursor c = { 0, 0, 0, 0 };
+    while (c.b + 1u < si->count && line >= c.line + si->blocks[c.b].count) {
+        c.start += si->blocks[c.b].bytes;
+        c.line += si->blocks[c.b].count;
+        c.b++;
+    }
+    while (c.line < line && c.i + 1u < si->blocks[c.b].count) {
+        c.start += si->blocks[c.b].lines[c.i].len;
+        c.line++;
+        c.i++;
+    }
+    return c;
+}
+
+// First line from `c` on where `*need` unclosed openers are all closed;
+// `*need` is left at the count that line starts with.
+static int find_close(const StructIndex *si, Cursor c, int64_t *need, Cursor *out) {
+    while (c.b < si->count) {
+        const StructBlock *blk = &si->blocks[c.b];
+        const StructLine *ln;
+        if (c.i == 0 && *need + blk->low > 0) {
+            *need += blk->delta;
+            c.start += blk->bytes;
+            c.line += blk->count;
+            c.b++;
+            continue;
+        }
+        ln = &blk->lines[c.i];
+        if (*need + ln->low <= 0) {
+            *out = c;
+            return 1;
+        }
+        *need += ln->delta;
+        if (!cursor_next(si, &c)) return 0;
+    }
+    return 0;
+}
+
+// Last line from `c` back where `*need` unopened closers all find openers.
+// Read backwards a line's depth falls to its low minus its delta.
+static int find_open(const StructIndex *si, Cursor c, int64_t *need, Cursor *out) {
+    for (;;) {
+        const StructBlock *blk = &si->blocks[c.b];
+        const StructLine *ln;
+        if (c.i + 1u == blk->count && *need + blk->low - blk->delta > 0) {
+            uint64_t block_start = c.start + blk->lines[c.i].len - blk->bytes;
+            uint64_t block_line = c.line - c.i;
+            *need -= blk->delta;
+            if (c.b == 0) return 0;
+            c.b--;
+            c.i = si->blocks[c.b].count - 1u;
+            c.line = block_line - 1u;
+            c.start = block_start - si->blocks[c.b].lines[c.i].len;
+            continue;
+        }
+        ln = &blk->lines[c.i];
+        if (*need + ln->low - ln->delta <= 0) {
+            *out = c;
+            return 1;
+        }
+        *need -= ln->delta;
+        if (!cursor_prev(si, &c)) return 0;
+    }
+}
+
+static int find_indent(const StructIndex *si, Cursor c, unsigned indent, Cursor *out) {
+    while (c.b < si->count) {
+        const StructBlock *blk = &si->blocks[c.b];
+        if (c.i == 0 && blk->min_indent > indent) {
+            c.start += blk->bytes;
+            c.line += blk->count;
+            c.b++;
+            continue;
+        }
+        if (blk->lines[c.i].indent <= indent) {
+            *out = c;
+            return 1;
+        }
+        if (!cursor_next(si, &c)) return 0;
+    }
+    return 0;
+}
+
+// Replaces `remove` lines from (b, i) with `recs`, re-chunking the blocks
+// involved. A small remainder is merged with the next block so edits do not
+// leave a trail of near-empty blocks.
+static int replace_lines(StructIndex *si, size_t b, uint32_t i, uint64_t remove, const StructLine *recs, size_t n) {
+    size_t e = b;
+    uint64_t end = (uint64_t)i + remove;
+    size_t tail_from;
+    size_t total;
+    size_t chunks;
+    size_t at = 0;
+    StructLine *flat;
+    StructBlock *fresh;
+
+    while (end > si->blocks[e].count) {
+        end -= si->blocks[e].count;
+        e++;
+    }
+    tail_from = (size_t)end;
+    total = i + n + (si->blocks[e].count - tail_from);
+    if (total < STRUCT_BLOCK_LINES / 4u && e + 1u < si->count) {
+        total += si->blocks[e + 1u].count;
+    }
+    chunks = total ? (total + STRUCT_BLOCK_LINES - 1u) / STRUCT_BLOCK_LINES : 0;
+
+    flat = (StructLine *)malloc((total ? total : 1u) * sizeof(StructLine));
+    fresh = (StructBlock *)calloc(chunks ? chunks : 1u, sizeof(StructBlock));
+    if (!flat || !fresh || !reserve_blocks(si, si->count + chunks)) {
+        free(flat);
+        free(fresh);
+        return 0;
+    }
+    for (size_t k = 0; k < chunks; k++) {
+        fresh[k].lines = alloc_lines();
+        if (!fresh[k].lines) {
+            for (size_t j = 0; j < k; j++) free_lines(fresh[j].lines);
+            free(flat);
+            free(fresh);
+            return 0;
+        }
+    }
+
+    memcpy(flat, si->blocks[b].lines, i * sizeof(StructLine));
+    at = i;
+    memcpy(flat + at, recs, n * sizeof(StructLine));
+    at += n;
+    memcpy(flat + at, si->blocks[e].lines + tail_from, (si->blocks[e].count - tail_from) * sizeof(StructLine));
+    at += si->blocks[e].count - tail_from;
+    if (at < total) {
+        e++;
+        memcpy(flat + at, si->blocks[e].lines, si->blocks[e].count * sizeof(StructLine));
+    }
+
+    // Even splits leave room in every block for the next few inserts.
+    for (size_t k = 0; k < chunks; k++) {
+        size_t lo = total * k / chunks;
+        size_t hi = total * (k + 1u) / chunks;
+        memcpy(fresh[k].lines, flat + lo, (hi - lo) * sizeof(StructLine));
+        fresh[k].count = (uint32_t)(hi - lo);
+        summarize(&fresh[k]);
+    }
+    for (size_t k = b; k <= e; k++) free_lines(si->blocks[k].lines);
+    memmove(si->blocks + b + chunks, si->blocks + e + 1u, (si->count - e - 1u) * sizeof(StructBlock));
+    memcpy(si->blocks + b, fresh, chunks * sizeof(StructBlock));
+    si->count = si->count - (e + 1u - b) + chunks;
+    free(flat);
+    free(fresh);
+    return 1;
+}
+
+int struct_index_edit(StructIndex *si, const char *text, size_t len, uint64_t offset, uint64_t delete_len, uint64_t insert_len) {
+    Cursor first;
+    Cursor last;
+    uint64_t region_end;
+    uint64_t remove;
+    uint64_t at;
+    int old_state;
+    int state;
+    StructLine *recs = NULL;
+    size_t n = 0;
+    size_t cap = 0;
+
+    if (!si->blocks) return 1;
+    if (offset + delete_len > si->bytes || si->bytes - delete_len + insert_len != len) return 0;
+
+    first = locate_offset(si, offset);
+    last = locate_offset(si, offset + delete_len);
+    old_state = line_at(si, last)->state;
+    region_end = last.start + line_at(si, last)->len - delete_len + insert_len;
+    remove = last.line - first.line + 1u;
+
+    // Lex the changed lines as they are now.
+    at = first.start;
+    state = state_before(si, first);
+    for (;;) {
+        const char *nl = (const char *)memchr(text + at, '\n', (size_t)(region_end - at));
+        size_t line_len = nl ? (size_t)(nl - (text + at)) + 1u : (size_t)(region_end - at);
+        if (n == cap) {
+            size_t grown_cap = cap ? cap * 2u : 16u;
+            StructLine *grown = (StructLine *)realloc(recs, grown_cap * sizeof(StructLine));
+            if (!grown) {
+                free(recs);
+                return 0;
+            }
+            recs = grown;
+            cap = grown_cap;
+        }
+        lex_line(text + at, line_len, state, NULL, NULL, &recs[n]);
+        state = recs[n++].state;
+        at += line_len;
+        // A break ending the last line leaves an empty line after it.
+        if (at >= region_end && !(nl && last.line + 1u == si->lines)) break;
+    }
+
+    if (!replace_lines(si, first.b, first.i, remove, recs, n)) {
+        free(recs);
+        return 0;
+    }
+    free(recs);
+    si->lines = si->lines - remove + n;
+    si->bytes = len;
+    si->rescanned = n;
+
+    // Lines below only change when the comment state they start in did.
+    if (state != old_state && first.line + n < si->lines) {
+        Cursor c = locate_line(si, first.line + n);
+        for (;;) {
+            StructBlock *blk = &si->blocks[c.b];
+            StructLine *ln = &blk->lines[c.i];
+            int before = ln->state;
+            int more;
+            lex_line(text + c.start, ln->len, state, NULL, NULL, ln);
+            si->rescanned++;
+            state = ln->state;
+            more = state != before && c.i + 1u < blk->count;
+            if (!more) summarize(blk);
+            if (state == before) break;
+            if (!cursor_next(si, &c)) break;
+        }
+    }
+    return 1;
+}
+
+uint64_t struct_index_line_of(const StructIndex *si, uint64_t offset) {
+    return si->blocks ? locate_offset(si, offset).line : 0;
+}
+
+uint64_t struct_index_line_start(const StructIndex *si, uint64_t line, uint64_t *len) {
+    Cursor c;
+    if (len) *len = 0;
+    if (!si->blocks || line >= si->lines) return si->bytes;
+    c = locate_line(si, line);
+    if (len) *len = line_at(si, c)->len - line_at(si, c)->brk;
+    return c.start;
+}
+
+typedef struct {
+    size_t from;         // the bracket being matched, or SIZE_MAX when counting from the start
+    int64_t need;        // openers still to close
+    size_t hit;
+    int started;
+    int found;
+} ForwardScan;
+
+static int forward_fn(void *ctx, size_t pos, char c) {
+    ForwardScan *fs = (ForwardScan *)ctx;
+    if (!fs->started) {
+        if (pos < fs->from) return 1;
+        if (pos > fs->from) return 0;   // the byte there is inside a string or comment
+        fs->started = 1;
+        fs->need = 1;
+        return 1;
+    }
+    fs->need += is_opener(c) ? 1 : -1;
+    if (fs->need > 0) return 1;
+    fs->hit = pos;
+    fs->found = 1;
+    return 0;
+}
+
+typedef struct {
+    size_t limit;        // collect brackets at offsets up to this one
+    size_t *pos;
+    char *kind;
+    size_t count;
+    size_t cap;
+    int failed;
+} BracketList;
+
+static int collect_fn(void *ctx, size_t pos, char c) {
+    BracketList *bl = (BracketList *)ctx;
+    if (pos > bl->limit) return 0;
+    if (bl->count == bl->cap) {
+        size_t cap = bl->cap ? bl->cap * 2u : 64u;
+        size_t *pos_grown = (size_t *)realloc(bl->pos, cap * sizeof(size_t));
+        char *kind_grown;
+        if (pos_grown) bl->pos = pos_grown;
+        kind_grown = pos_grown ? (char *)realloc(bl->kind, cap) : NULL;
+        if (!kind_grown) {
+            bl->failed = 1;
+            return 0;
+        }
+        bl->kind = kind_grown;
+        bl->cap = cap;
+    }
+    bl->pos[bl->count] = pos;
+    bl->kind[bl->count] = c;
+    bl->count++;
+    return 1;
+}
+
+// Walks the collected brackets from the last one back, counting unopened
+// closers; returns the index where they are all opened, or SIZE_MAX.
+static size_t walk_back(const BracketList *bl, size_t from, int64_t *need) {
+    for (size_t k = from; k-- > 0;) {
+        *need += is_closer(bl->kind[k]) ? 1 : -1;
+        if (*need == 0) return k;
+    }
+    return SIZE_MAX;
+}
+
+static int match_forward(const StructIndex *si, const char *text, Cursor c, size_t within, uint64_t *match) {
+    ForwardScan fs;
+    Cursor m;
+
+    memset(&fs, 0, sizeof(fs));
+    fs.from = within;
+    lex_line(text + c.start, line_at(si, c)->len, state_before(si, c), forward_fn, &fs, NULL);
+    if (!fs.started) return 0;
+    if (fs.found) {
+        *match = c.start + fs.hit;
+        return 1;
+    }
+    if (!cursor_next(si, &c) || !find_close(si, c, &fs.need, &m)) return 0;
+    fs.found = 0;
+    lex_line(text + m.start, line_at(si, m)->len, state_before(si, m), forward_fn, &fs, NULL);
+    if (!fs.found) return 0;
+    *match = m.start + fs.hit;
+    return 1;
+}
+
+static int match_backward(const StructIndex *si, const char *text, Cursor c, size_t within, uint64_t *match) {
+    BracketList bl;
+    int64_t need = 1;
+    size_t k;
+    Cursor m;
+    int ok = 0;
+
+    memset(&bl, 0, sizeof(bl));
+    bl.limit = within;
+    lex_line(text + c.start, line_at(si, c)->len, state_before(si, c), collect_fn, &bl, NULL);
+    if (bl.failed || bl.count == 0 || bl.pos[bl.count - 1u] != within) goto done;
+    k = walk_back(&bl, bl.count - 1u, &need);
+    if (k != SIZE_MAX) {
+        *match = c.start + bl.pos[k];
+        ok = 1;
+        goto done;
+    }
+    if (!cursor_prev(si, &c) || !find_open(si, c, &need, &m)) goto done;
+    bl.count = 0;
+    bl.limit = SIZE_MAX;
+    lex_line(text + m.start, line_at(si, m)->len, state_before(si, m), collect_fn, &bl, NULL);
+    if (bl.failed) goto done;
+    k = walk_back(&bl, bl.count, &need);
+    if (k != SIZE_MAX) {
+        *match = m.start + bl.pos[k];
+        ok = 1;
+    }
+done:
+    free(bl.pos);
+    free(bl.kind);
+    return ok;
+}
+
+int struct_index_match(const StructIndex *si, const char *text, size_t len, uint64_t offset, uint64_t *match) {
+    Cursor c;
+    char ch;
+    int ok;
+
+    if (!si->blocks || si->bytes != len || offset >= len) return 0;
+    ch = text[offset];
+    if (!pair_of(ch)) return 0;
+    c = locate_offset(si, offset);
+    if (is_opener(ch)) {
+        ok = match_forward(si, text, c, (size_t)(offset - c.start), match);
+    } else {
+        ok = match_backward(si, text, c, (size_t)(offset - c.start), match);
+    }
+    return ok && text[*match] == pair_of(ch);
+}
+
+int struct_index_fold(const StructIndex *si, uint64_t line, uint64_t *last) {
+    Cursor c;
+    Cursor m;
+    const StructLine *ln;
+    uint64_t end;
+
+    if (!si->blocks || line + 1u >= si->lines) return 0;
+    c = locate_line(si, line);
+    ln = line_at(si, c);
+
+    if (ln->delta > ln->low) {
+        // The outermost bracket left open on this line closes on line m.
+        Cursor next = c;
+        int64_t need = (int64_t)ln->delta - ln->low;
+        cursor_next(si, &next);
+        if (!find_close(si, next, &need, &m)) return 0;
+        if (m.line < line + 2u) return 0;
+        *last = m.line - 1u;
+        return 1;
+    }
+
+    if (ln->indent == STRUCT_BLANK) return 0;
+    m = c;
+    cursor_next(si, &m);
+    if (find_indent(si, m, ln->indent, &m)) {
+        end = m.line - 1u;
+        cursor_prev(si, &m);
+    } else {
+        end = si->lines - 1u;
+        m = locate_line(si, end);
+    }
+    // Trailing blank lines stay outside the fold.
+    while (end > line && line_at(si, m)->indent == STRUCT_BLANK) {
+        end--;
+        cursor_prev(si, &m);
+    }
+    if (end <= line) return 0;
+    *last = end;
+    return 1;
+}
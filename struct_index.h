@@ -0,0 +1,72 @@
+// Incremental bracket and indent structure index
+// Each line is summarized by its length, its bracket balance, the lowest
+// bracket depth it reaches, its indent and the lexer state it ends in (inside
+// a block comment or not). Lines sit in blocks of up to STRUCT_BLOCK_LINES
+// with the same summary for the whole block, so bracket matching and fold
+// ranges skip whole blocks and only scan the text of the two lines at the
+// ends. An edit rescans the lines it touched, plus following lines only while
+// their starting lexer state changed. Strings, character literals and C-style
+// comments are skipped; ( [ { pair up by depth and the ends are checked for
+// the same kind. The index does not keep the text; calls that scan take it.
+
+#ifndef STRUCT_INDEX_H
+#define STRUCT_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STRUCT_BLOCK_LINES 512u
+#define STRUCT_TAB_WIDTH 8u
+#define STRUCT_BLANK 0xFFFFu   // indent of a line holding only whitespace
+
+typedef struct {
+    uint32_t len;          // bytes, line break included
+    int32_t delta;         // openers minus closers
+    int32_t low;           // lowest depth reached, relative to the line start
+    uint16_t indent;
+    uint8_t state;         // lexer state at the end of the line
+    uint8_t brk;           // bytes of the line break: 0, 1 or 2
+} StructLine;
+
+typedef struct {
+    StructLine *lines;
+    uint32_t count;
+    uint16_t min_indent;   // over non-blank lines
+    uint64_t bytes;
+    int64_t delta;
+    int64_t low;
+} StructBlock;
+
+typedef struct {
+    StructBlock *blocks;   // NULL until built
+    size_t count;
+    size_t cap;
+    uint64_t lines;
+    uint64_t bytes;
+    uint64_t rescanned;    // lines lexed by the last build or edit
+} StructIndex;
+
+// Returns 0 on allocation failure. A zeroed StructIndex is unbuilt.
+int struct_index_build(StructIndex *si, const char *text, size_t len);
+void struct_index_free(StructIndex *si);
+
+// Follows [offset, offset + delete_len) having been replaced by
+// `insert_len` bytes; `text` is the whole document after the change.
+// Returns 0 on allocation failure, after which the index must be rebuilt.
+int struct_index_edit(StructIndex *si, const char *text, size_t len, uint64_t offset, uint64_t delete_len, uint64_t insert_len);
+
+uint64_t struct_index_line_of(const StructIndex *si, uint64_t offset);
+// Start offset and length without the line break.
+uint64_t struct_index_line_start(const StructIndex *si, uint64_t line, uint64_t *len);
+
+// Offset of the bracket pairing with the one at `offset`. Returns 0 when
+// there is no bracket there (or it is in a string or comment), it is
+// unbalanced, or the pair is of different kinds.
+int struct_index_match(const StructIndex *si, const char *text, size_t len, uint64_t offset, uint64_t *match);
+
+// Lines a fold at `line` hides: from line + 1 through `*last`. A line opening
+// a bracket that closes on a later line folds up to the closing line; other
+// lines fold the indented block below them. Returns 0 when not foldable.
+int struct_index_fold(const StructIndex *si, uint64_t line, uint64_t *last);
+
+#endif
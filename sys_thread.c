@@ -0,0 +1,199 @@
+// Minimal thread, lock and clock layer shared by the portable engines
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "sys_thread.h"
+
+#ifdef _WIN32
+
+int sys_mutex_init(SysMutex *m) {
+    InitializeCriticalSection(&m->cs);
+    return 1;
+}
+
+void sys_mutex_destroy(SysMutex *m) {
+    DeleteCriticalSection(&m->cs);
+}
+
+void sys_mutex_lock(SysMutex *m) {
+    EnterCriticalSection(&m->cs);
+}
+
+void sys_mutex_unlock(SysMutex *m) {
+    LeaveCriticalSection(&m->cs);
+}
+
+int sys_cond_init(SysCond *c) {
+    InitializeConditionVariable(&c->cv);
+    return 1;
+}
+
+void sys_cond_destroy(SysCond *c) {
+    (void)c;
+}
+
+void sys_cond_wait(SysCond *c, SysMutex *m) {
+    SleepConditionVariableCS(&c->cv, &m->cs, INFINITE);
+}
+
+int sys_cond_timedwait(SysCond *c, SysMutex *m, unsigned timeout_ms) {
+    if (SleepConditionVariableCS(&c->cv, &m->cs, timeout_ms)) return 1;
+    return GetLastError() == ERROR_TIMEOUT ? 0 : 1;
+}
+
+void sys_cond_signal(SysCond *c) {
+    WakeConditionVariable(&c->cv);
+}
+
+void sys_cond_broadcast(SysCond *c) {
+    WakeAllConditionVariable(&c->cv);
+}
+
+static DWORD WINAPI thread_trampoline(LPVOID param) {
+    SysThread *t = (SysThread *)param;
+    t->result = t->fn(t->arg);
+    return 0;
+}
+
+int sys_thread_start(SysThread *t, int (*fn)(void *), void *arg) {
+    t->fn = fn;
+    t->arg = arg;
+    t->result = 0;
+    t->handle = CreateThread(NULL, 0, thread_trampoline, t, 0, NULL);
+    return t->handle != NULL;
+}
+
+int sys_thread_join(SysThread *t) {
+    if (!t->handle) return 0;
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+    t->handle = NULL;
+    return t->result;
+}
+
+static BOOL CALLBACK once_trampoline(PINIT_ONCE once, PVOID param, PVOID *context) {
+    (void)once;
+    (void)context;
+    ((void (*)(void))param)();
+    return TRUE;
+}
+
+void sys_once(SysOnce *o, void (*fn)(void)) {
+    InitOnceExecuteOnce(&o->once, once_trampoline, (PVOID)fn, NULL);
+}
+
+long sys_atomic_add(volatile long *p, long v) {
+    return InterlockedExchangeAdd(p, v) + v;
+}
+
+unsigned sys_cpu_count(void) {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors ? (unsigned)si.dwNumberOfProcessors : 1u;
+}
+
+uint64_t sys_now_us(void) {
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000u +
+           (uint64_t)((now.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart);
+}
+
+#else
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+int sys_mutex_init(SysMutex *m) {
+    return pthread_mutex_init(&m->m, NULL) == 0;
+}
+
+void sys_mutex_destroy(SysMutex *m) {
+    pthread_mutex_destroy(&m->m);
+}
+
+void sys_mutex_lock(SysMutex *m) {
+    pthread_mutex_lock(&m->m);
+}
+
+void sys_mutex_unlock(SysMutex *m) {
+    pthread_mutex_unlock(&m->m);
+}
+
+int sys_cond_init(SysCond *c) {
+    return pthread_cond_init(&c->cv, NULL) == 0;
+}
+
+void sys_cond_destroy(SysCond *c) {
+    pthread_cond_destroy(&c->cv);
+}
+
+void sys_cond_wait(SysCond *c, SysMutex *m) {
+    pthread_cond_wait(&c->cv, &m->m);
+}
+
+int sys_cond_timedwait(SysCond *c, SysMutex *m, unsigned timeout_ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += (time_t)(timeout_ms / 1000u);
+    ts.tv_nsec += (long)(timeout_ms % 1000u) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(&c->cv, &m->m, &ts) == ETIMEDOUT ? 0 : 1;
+}
+
+void sys_cond_signal(SysCond *c) {
+    pthread_cond_signal(&c->cv);
+}
+
+void sys_cond_broadcast(SysCond *c) {
+    pthread_cond_broadcast(&c->cv);
+}
+
+static void *thread_trampoline(void *param) {
+    SysThread *t = (SysThread *)param;
+    t->result = t->fn(t->arg);
+    return NULL;
+}
+
+int sys_thread_start(SysThread *t, int (*fn)(void *), void *arg) {
+    t->fn = fn;
+    t->arg = arg;
+    t->result = 0;
+    return pthread_create(&t->handle, NULL, thread_trampoline, t) == 0;
+}
+
+int sys_thread_join(SysThread *t) {
+    pthread_join(t->handle, NULL);
+    return t->result;
+}
+
+void sys_once(SysOnce *o, void (*fn)(void)) {
+    pthread_once(&o->once, fn);
+}
+
+long sys_atomic_add(volatile long *p, long v) {
+    return __atomic_add_fetch(p, v, __ATOMIC_ACQ_REL);
+}
+
+unsigned sys_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned)n : 1u;
+}
+
+uint64_t sys_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+#endif
@@ -0,0 +1,53 @@
+// Minimal thread, lock and clock layer shared by the portable engines
+// Windows: CRITICAL_SECTION + CONDITION_VARIABLE + CreateThread. Elsewhere: pthreads.
+
+#ifndef SYS_THREAD_H
+#define SYS_THREAD_H
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+typedef struct { CRITICAL_SECTION cs; } SysMutex;
+typedef struct { CONDITION_VARIABLE cv; } SysCond;
+typedef struct { HANDLE handle; int (*fn)(void *); void *arg; int result; } SysThread;
+typedef struct { INIT_ONCE once; } SysOnce;
+#define SYS_ONCE_INIT {INIT_ONCE_STATIC_INIT}
+#else
+#include <pthread.h>
+typedef struct { pthread_mutex_t m; } SysMutex;
+typedef struct { pthread_cond_t cv; } SysCond;
+typedef struct { pthread_t handle; int (*fn)(void *); void *arg; int result; } SysThread;
+typedef struct { pthread_once_t once; } SysOnce;
+#define SYS_ONCE_INIT {PTHREAD_ONCE_INIT}
+#endif
+
+int sys_mutex_init(SysMutex *m);
+void sys_mutex_destroy(SysMutex *m);
+void sys_mutex_lock(SysMutex *m);
+void sys_mutex_unlock(SysMutex *m);
+
+int sys_cond_init(SysCond *c);
+void sys_cond_destroy(SysCond *c);
+void sys_cond_wait(SysCond *c, SysMutex *m);
+// Returns 0 on timeout, 1 when woken (spurious wakeups included).
+int sys_cond_timedwait(SysCond *c, SysMutex *m, unsigned timeout_ms);
+void sys_cond_signal(SysCond *c);
+void sys_cond_broadcast(SysCond *c);
+
+// `t` must stay valid until sys_thread_join returns.
+int sys_thread_start(SysThread *t, int (*fn)(void *), void *arg);
+int sys_thread_join(SysThread *t);
+
+// Runs `fn` exactly once per SysOnce, however many threads get here first;
+// for globals that need a lock before anyone can take one.
+void sys_once(SysOnce *o, void (*fn)(void));
+
+// Adds `v` and returns the new value, with acquire and release ordering so
+// the last reference dropped sees every write made through the others.
+long sys_atomic_add(volatile long *p, long v);
+
+unsigned sys_cpu_count(void);
+uint64_t sys_now_us(void);
+
+#endif
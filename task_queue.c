@@ -0,0 +1,88 @@
+// FIFO of deferred work run one item at a time by the owner's event loop
+// Ring buffer that doubles when full.
+
+#include "task_queue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int task_queue_init(TaskQueue *q) {
+    if (!q) return 0;
+    memset(q, 0, sizeof(*q));
+    return sys_mutex_init(&q->lock);
+}
+
+void task_queue_free(TaskQueue *q) {
+    if (!q) return;
+    free(q->tasks);
+    sys_mutex_destroy(&q->lock);
+    memset(q, 0, sizeof(*q));
+}
+
+static int grow(TaskQueue *q) {
+    size_t cap = q->cap ? q->cap * 2u : 8u;
+    Task *tasks = (Task *)malloc(cap * sizeof(Task));
+    if (!tasks) return 0;
+    for (size_t i = 0; i < q->count; i++) {
+        tasks[i] = q->tasks[(q->head + i) % q->cap];
+    }
+    free(q->tasks);
+    q->tasks = tasks;
+    q->cap = cap;
+    q->head = 0;
+    return 1;
+}
+
+int task_queue_push(TaskQueue *q, const char *name, TaskFn fn, void *arg) {
+    int ok = 1;
+    if (!q || !fn) return 0;
+
+    sys_mutex_lock(&q->lock);
+    if (q->count == q->cap) ok = grow(q);
+    if (ok) {
+        Task *t = &q->tasks[(q->head + q->count) % q->cap];
+        t->name = name ? name : "task";
+        t->fn = fn;
+        t->arg = arg;
+        q->count++;
+    }
+    sys_mutex_unlock(&q->lock);
+    return ok;
+}
+
+size_t task_queue_pending(TaskQueue *q) {
+    size_t count;
+    if (!q) return 0;
+    sys_mutex_lock(&q->lock);
+    count = q->count;
+    sys_mutex_unlock(&q->lock);
+    return count;
+}
+
+int task_queue_run_next(TaskQueue *q, const char **out_name, uint64_t *out_elapsed_us) {
+    Task t;
+    uint64_t start;
+    uint64_t elapsed;
+
+    if (!q) return 0;
+    sys_mutex_lock(&q->lock);
+    if (q->count == 0) {
+        sys_mutex_unlock(&q->lock);
+        return 0;
+    }
+    t = q->tasks[q->head];
+    q->head = (q->head + 1u) % q->cap;
+    q->count--;
+    sys_mutex_unlock(&q->lock);
+
+    // The lock is not held here so a task may queue follow-up work.
+    start = sys_now_us();
+    t.fn(t.arg);
+    elapsed = sys_now_us() - start;
+
+    q->ran++;
+    q->busy_us += elapsed;
+    if (out_name) *out_name = t.name;
+    if (out_elapsed_us) *out_elapsed_us = elapsed;
+    return 1;
+}
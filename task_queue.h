@@ -0,0 +1,39 @@
+// FIFO of deferred work run one item at a time by the owner's event loop
+// Pushing is thread-safe; tasks always run on the thread calling task_queue_run_next.
+
+#ifndef TASK_QUEUE_H
+#define TASK_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sys_thread.h"
+
+typedef void (*TaskFn)(void *arg);
+
+typedef struct {
+    const char *name;  // static string, used for the timing log
+    TaskFn fn;
+    void *arg;
+} Task;
+
+typedef struct {
+    Task *tasks;
+    size_t head;
+    size_t count;
+    size_t cap;
+    SysMutex lock;
+    uint64_t ran;
+    uint64_t busy_us;
+} TaskQueue;
+
+int task_queue_init(TaskQueue *q);
+void task_queue_free(TaskQueue *q);
+int task_queue_push(TaskQueue *q, const char *name, TaskFn fn, void *arg);
+size_t task_queue_pending(TaskQueue *q);
+
+// Runs the oldest task. Returns 0 when the queue was empty; otherwise reports
+// its name and how long it took.
+int task_queue_run_next(TaskQueue *q, const char **out_name, uint64_t *out_elapsed_us);
+
+#endif
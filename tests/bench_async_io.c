@@ -0,0 +1,93 @@
+// Async file I/O: each backend reading a whole file against a plain
+// sequential read() loop, with a cold cache when the page cache can be
+// dropped (root) and with a warm one
+// Usage: bench_async_io [file MB]   (default 1024)
+
+#define _GNU_SOURCE
+#include "check.h"
+#include "async_io.h"
+#include "sys_thread.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+static double cpu_seconds(void) {
+    struct rusage u;
+    getrusage(RUSAGE_SELF, &u);
+    return (double)(u.ru_utime.tv_sec + u.ru_stime.tv_sec) + (double)(u.ru_utime.tv_usec + u.ru_stime.tv_usec) / 1e6;
+}
+
+static int drop_cache(void) {
+    sync();
+    FILE *f = fopen("/proc/sys/vm/drop_caches", "w");
+    if (!f) return 0;
+    int ok = fputs("3", f) >= 0;
+    return fclose(f) == 0 && ok;
+}
+
+static uint64_t read_loop(const char *path, unsigned char *dst, uint64_t size) {
+    int fd = open(path, O_RDONLY);
+    uint64_t got = 0;
+    ssize_t n;
+    CHECK(fd >= 0);
+    while (got < size && (n = read(fd, dst + got, size - got > AIO_CHUNK ? AIO_CHUNK : (size_t)(size - got))) > 0) {
+        got += (uint64_t)n;
+    }
+    close(fd);
+    return got;
+}
+
+int main(int argc, char **argv) {
+    size_t file_mb = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 1024u;
+    uint64_t size = (uint64_t)file_mb << 20;
+    const char *names[] = {"sequential read()", "sync", "threads", "io_uring"};
+    const AioBackend backends[] = {AIO_BACKEND_SYNC, AIO_BACKEND_SYNC, AIO_BACKEND_THREADS, AIO_BACKEND_URING};
+    unsigned char *dst = (unsigned char *)malloc((size_t)size);
+    char path[512];
+    CHECK(dst != NULL);
+    snprintf(path, sizeof(path), "%s.bin", argv[0]);
+
+    AioFile *out = aio_open(path, 1, AIO_BACKEND_AUTO);
+    CHECK(out != NULL);
+    memset(dst, 'x', AIO_CHUNK);
+    for (size_t i = 0; i < file_mb; i++) CHECK(aio_write(out, dst, AIO_CHUNK));
+    CHECK(aio_close(out));
+    memset(dst, 0, (size_t)size);   // fault the buffer in before timing
+
+    for (int cold = 1; cold >= 0; cold--) {
+        if (cold && !drop_cache()) {
+            printf("cold: skipped, cannot drop the page cache\n");
+            continue;
+        }
+        for (int m = 0; m < 4; m++) {
+            if (cold) {
+                drop_cache();
+            } else {
+                read_loop(path, dst, size);
+            }
+            uint64_t started = sys_now_us();
+            double cpu = cpu_seconds();
+            uint64_t got;
+            const char *used = "";
+            if (m == 0) {
+                got = read_loop(path, dst, size);
+            } else {
+                AioFile *in = aio_open(path, 0, backends[m]);
+                CHECK(in != NULL);
+                used = aio_backend_name(aio_backend(in));
+                got = aio_read_all(in, dst, size);
+                CHECK(aio_close(in));
+            }
+            CHECK(got == size);
+            double secs = (double)(sys_now_us() - started) / 1e6;
+            printf("%s %-18s %7.0f MB/s  cpu %.2f s  %s\n",
+                cold ? "cold" : "warm", names[m], (double)file_mb / secs, cpu_seconds() - cpu, used);
+        }
+    }
+
+    remove(path);
+    free(dst);
+    return 0;
+}
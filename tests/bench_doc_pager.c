@@ -0,0 +1,111 @@
+// Compressed pages: resident memory of a log-like document with cold-page
+// compression on and off, and the latency of reading one screen (8 KB) on
+// random jumps and on page-down through the document
+// Usage: bench_doc_pager [document MB]   (default 1024)
+
+#define _DEFAULT_SOURCE
+#include "check.h"
+#include "doc_pager.h"
+#include "doc_store.h"
+#include "sys_thread.h"
+
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define SCREEN 8192u
+#define READS 20000
+
+static long rss_mb(void) {
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    CHECK(f != NULL && fscanf(f, "%ld %ld", &pages, &resident) == 2);
+    fclose(f);
+    return resident * sysconf(_SC_PAGESIZE) / 1048576;
+}
+
+static int compare_us(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static size_t generate_log(char *dst, size_t cap) {
+    static const char *levels[] = {"INFO", "INFO", "INFO", "WARN", "DEBUG", "ERROR"};
+    static const char *paths[] = {"/api/v1/items", "/api/v1/users", "/static/app.js", "/health", "/api/v2/search"};
+    uint64_t x = 88172645463325252ull;
+    size_t len = 0;
+    while (len + 200u < cap) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        len += (size_t)snprintf(dst + len, cap - len,
+            "2026-10-18 %02u:%02u:%02u.%03u %-5s [worker-%u] request id=%u path=%s/%u status=%u ms=%u\n",
+            (unsigned)(x % 24u), (unsigned)(x >> 8) % 60u, (unsigned)(x >> 16) % 60u, (unsigned)(x >> 24) % 1000u,
+            levels[(x >> 32) % 6u], (unsigned)(x >> 35) % 16u, (unsigned)(x >> 20) % 1000000u,
+            paths[(x >> 40) % 5u], (unsigned)(x >> 44) % 500u, (x >> 50) % 10u ? 200u : 404u, (unsigned)(x >> 54) % 300u);
+    }
+    return len;
+}
+
+static void run(int compress, size_t doc_mb) {
+    size_t source_cap = 64u << 20;
+    char *source = (char *)malloc(source_cap);
+    CHECK(source != NULL);
+    size_t source_len = generate_log(source, source_cap);
+    uint64_t size = (uint64_t)doc_mb << 20;
+    DocStore s;
+    DocPagerStats st;
+
+    doc_pager_set_compression(compress);
+    long base = rss_mb();
+    doc_store_init(&s);
+    uint64_t started = sys_now_us();
+    for (uint64_t done = 0; done < size; done += 1u << 20) {
+        size_t from = (size_t)((done * 7919u) % (source_len - (1u << 20)));
+        CHECK(doc_store_append(&s, source + from, 1u << 20));
+    }
+    double load_s = (double)(sys_now_us() - started) / 1e6;
+    free(source);
+    doc_pager_stats(&st);
+    printf("%s: load %.0f MB/s, RSS +%ld MB, pages %.0f MB resident (%.0f MB packed from %.0f MB)\n",
+        compress ? "compressed" : "raw", (double)doc_mb / load_s, rss_mb() - base,
+        (double)st.resident / 1048576.0, (double)st.compressed / 1048576.0, (double)st.compressed_from / 1048576.0);
+
+    static uint64_t lat[READS];
+    static char screen[SCREEN];
+    uint64_t x = 12345;
+    for (int jump = 1; jump >= 0; jump--) {
+        uint64_t at = 0;
+        for (int i = 0; i < READS; i++) {
+            if (jump) {
+                x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+                at = x % (size - SCREEN);
+            } else {
+                at = (at + SCREEN) % (size - SCREEN);
+            }
+            started = sys_now_us();
+            CHECK(doc_store_read(&s, at, screen, SCREEN) == SCREEN);
+            lat[i] = sys_now_us() - started;
+        }
+        qsort(lat, READS, sizeof(lat[0]), compare_us);
+        printf("  %-11s screen reads: p50 %llu us, p99 %llu us, max %llu us\n", jump ? "random-jump" : "page-down",
+            (unsigned long long)lat[READS / 2], (unsigned long long)lat[READS * 99 / 100], (unsigned long long)lat[READS - 1]);
+    }
+    doc_store_free(&s);
+}
+
+int main(int argc, char **argv) {
+    size_t doc_mb = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 1024u;
+    // Each mode in its own process, so the RSS of one does not hide the other.
+    for (int compress = 0; compress <= 1; compress++) {
+        fflush(stdout);
+        pid_t child = fork();
+        CHECK(child >= 0);
+        if (child == 0) {
+            run(compress, doc_mb);
+            fflush(stdout);
+            _exit(0);
+        }
+        int status = 0;
+        CHECK(waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    return 0;
+}
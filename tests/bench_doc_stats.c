@@ -0,0 +1,50 @@
+// Document statistics: scan throughput by worker count, against the
+// single-slice scan
+// Usage: bench_doc_stats [document MB]   (default 1024)
+
+#include "check.h"
+#include "doc_stats.h"
+#include "sys_thread.h"
+
+#include <string.h>
+
+int main(int argc, char **argv) {
+    size_t doc_mb = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 1024u;
+    size_t len = doc_mb << 20;
+    char *text = (char *)malloc(len);
+    static const char line[] = "caf\xc3\xa9 log entry: value=42 status ok\r\n";
+    CHECK(text != NULL);
+    for (size_t at = 0; at < len; at += sizeof(line) - 1u) {
+        size_t n = len - at < sizeof(line) - 1u ? len - at : sizeof(line) - 1u;
+        memcpy(text + at, line, n);
+    }
+    printf("%u CPUs\n", sys_cpu_count());
+
+    unsigned top = sys_cpu_count() * 2u;
+    if (top < 8u) top = 8u;
+    if (top > DOC_STATS_MAX_THREADS) top = DOC_STATS_MAX_THREADS;
+    DocStats base;
+    double base_ms = 0.0;
+    doc_stats_init(&base);
+    for (unsigned threads = 1; threads <= top; threads *= 2) {
+        DocStats s;
+        double best = 1e30;
+        unsigned slices = 0;
+        for (int k = 0; k < 3; k++) {
+            uint64_t started = sys_now_us();
+            slices = doc_stats_compute(&s, text, len, 1, threads);
+            double ms = (double)(sys_now_us() - started) / 1000.0;
+            if (ms < best) best = ms;
+        }
+        if (threads == 1) {
+            base = s;
+            base_ms = best;
+        }
+        CHECK(s.words == base.words && s.lines == base.lines && s.code_points == base.code_points);
+        printf("threads %2u, %2u slices: %7.1f ms, %6.0f MB/s, %.2fx\n",
+            threads, slices, best, (double)doc_mb * 1000.0 / best, base_ms / best);
+    }
+    printf("lines %llu, words %llu\n", (unsigned long long)base.lines, (unsigned long long)base.words);
+    free(text);
+    return 0;
+}
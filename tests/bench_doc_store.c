@@ -0,0 +1,56 @@
+// Chunked store: a large insert into the middle of a large document,
+// against moving the tail of one flat buffer
+// Usage: bench_doc_store [document MB] [insert MB]   (default 1024 and 500)
+
+#include "check.h"
+#include "doc_store.h"
+#include "sys_thread.h"
+
+#include <string.h>
+
+int main(int argc, char **argv) {
+    size_t doc_mb = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 1024u;
+    size_t insert_mb = argc > 2 ? (size_t)strtoul(argv[2], NULL, 10) : 500u;
+    size_t mb = 1024u * 1024u;
+    char *block = (char *)malloc(mb);
+    char *insert = (char *)malloc(insert_mb * mb);
+    DocStore s;
+    CHECK(block && insert);
+    memset(block, 'x', mb);
+    memset(insert, 'y', insert_mb * mb);
+
+    doc_store_init(&s);
+    uint64_t started = sys_now_us();
+    for (size_t i = 0; i < doc_mb; i++) CHECK(doc_store_append(&s, block, mb));
+    printf("build %zu MB: %.2f s\n", doc_mb, (double)(sys_now_us() - started) / 1e6);
+
+    uint64_t offset = (uint64_t)doc_mb * mb / 2u + 12345u;
+    started = sys_now_us();
+    CHECK(doc_store_insert(&s, offset, insert, insert_mb * mb));
+    printf("insert %zu MB in the middle: %.2f s, %zu chunks\n",
+        insert_mb, (double)(sys_now_us() - started) / 1e6, doc_store_chunk_count(&s));
+    CHECK(doc_store_length(&s) == (uint64_t)(doc_mb + insert_mb) * mb);
+
+    char probe[4];
+    CHECK(doc_store_read(&s, offset - 2u, probe, 4) == 4 && memcmp(probe, "xxyy", 4) == 0);
+    CHECK(doc_store_read(&s, offset + insert_mb * mb - 2u, probe, 4) == 4 && memcmp(probe, "yyxx", 4) == 0);
+
+    started = sys_now_us();
+    doc_store_insert(&s, offset, "k", 1);
+    printf("one keystroke after it: %.1f us\n", (double)(sys_now_us() - started));
+
+    started = sys_now_us();
+    doc_store_erase(&s, offset, insert_mb * mb + 1u);
+    printf("erase it again: %.2f s\n", (double)(sys_now_us() - started) / 1e6);
+    CHECK(doc_store_length(&s) == (uint64_t)doc_mb * mb);
+    doc_store_free(&s);
+
+    // For scale: the tail move a flat buffer would need for the same insert.
+    started = sys_now_us();
+    memmove(insert + 1, insert, insert_mb * mb - 1u);
+    printf("one %zu MB memmove for comparison: %.2f s\n", insert_mb, (double)(sys_now_us() - started) / 1e6);
+
+    free(insert);
+    free(block);
+    return 0;
+}
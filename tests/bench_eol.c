@@ -0,0 +1,62 @@
+// Line-ending kernels: MB/s for scanning and converting, on text with long
+// lines and on text that is mostly line breaks
+// Usage: bench_eol [MB]   (default 256)
+
+#include "check.h"
+#include "eol.h"
+#include "sys_thread.h"
+
+#include <string.h>
+
+static void run(const char *name, const char *chunk, size_t chunk_len, size_t mb) {
+    char *dst = (char *)malloc(2u * chunk_len + 1u);
+    size_t rounds = mb * 1024u * 1024u / chunk_len;
+    uint64_t started;
+    double secs;
+    CHECK(dst != NULL);
+
+    EolScan scan;
+    eol_scan_init(&scan);
+    started = sys_now_us();
+    for (size_t i = 0; i < rounds; i++) eol_scan_update(&scan, chunk, chunk_len);
+    secs = (double)(sys_now_us() - started) / 1e6;
+    printf("%-12s scan      %6.0f MB/s\n", name, (double)mb / secs);
+
+    int after_cr = 0;
+    size_t out = 0;
+    started = sys_now_us();
+    for (size_t i = 0; i < rounds; i++) out += eol_to_crlf(chunk, chunk_len, dst, &after_cr);
+    secs = (double)(sys_now_us() - started) / 1e6;
+    CHECK(out == eol_scan_crlf_size(&scan, (uint64_t)rounds * chunk_len));
+    printf("%-12s to CRLF   %6.0f MB/s\n", name, (double)mb / secs);
+
+    int pending_cr = 0;
+    started = sys_now_us();
+    for (size_t i = 0; i < rounds; i++) eol_from_crlf(chunk, chunk_len, dst, TEXT_EOL_LF, &pending_cr);
+    eol_from_crlf_finish(dst, &pending_cr);
+    secs = (double)(sys_now_us() - started) / 1e6;
+    printf("%-12s from CRLF %6.0f MB/s\n", name, (double)mb / secs);
+    free(dst);
+}
+
+int main(int argc, char **argv) {
+    size_t mb = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 256u;
+    size_t chunk_len = 1024u * 1024u;
+    char *chunk = (char *)malloc(chunk_len);
+    CHECK(chunk != NULL);
+
+    // 80-column lines, mostly LF with some CRLF and a lone CR.
+    for (size_t i = 0; i < chunk_len; i++) chunk[i] = (char)('a' + i % 26);
+    for (size_t i = 79; i < chunk_len; i += 80u) {
+        chunk[i] = '\n';
+        if (i % 800u == 79u) chunk[i - 1u] = '\r';
+        if (i % 8000u == 79u) chunk[i - 5u] = '\r';
+    }
+    run("80 columns", chunk, chunk_len, mb);
+
+    // Every other byte a line break, cut so chunks end on a CR.
+    for (size_t i = 0; i < chunk_len; i++) chunk[i] = "\r\n\rx"[i % 4u];
+    run("dense", chunk, chunk_len - 1u, mb);
+    free(chunk);
+    return 0;
+}
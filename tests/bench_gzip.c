@@ -0,0 +1,119 @@
+// gzip reader: inflate throughput, random access through the checkpoint
+// index, and the size of saving the text back with the store-only writer
+// The input is a generated log file compressed with the system gzip.
+// Usage: bench_gzip [text MB]   (default 256)
+
+#define _POSIX_C_SOURCE 200809L
+#include "check.h"
+#include "gzip.h"
+#include "sys_thread.h"
+
+#include <string.h>
+#include <sys/types.h>
+
+static size_t file_read(void *ctx, unsigned char *buf, size_t cap) {
+    return fread(buf, 1, cap, (FILE *)ctx);
+}
+
+static int file_seek(void *ctx, uint64_t offset) {
+    return fseeko((FILE *)ctx, (off_t)offset, SEEK_SET) == 0;
+}
+
+static int count_sink(void *ctx, const void *data, size_t len) {
+    (void)data;
+    *(uint64_t *)ctx += len;
+    return 1;
+}
+
+static uint64_t file_size(const char *path) {
+    FILE *f = fopen(path, "rb");
+    CHECK(f != NULL && fseeko(f, 0, SEEK_END) == 0);
+    uint64_t size = (uint64_t)ftello(f);
+    fclose(f);
+    return size;
+}
+
+int main(int argc, char **argv) {
+    size_t text_mb = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 256u;
+    uint64_t size = (uint64_t)text_mb << 20;
+    static const char *words[] = {"error", "warn", "info", "GET /index.html", "200", "404", "user=42", "timeout", "ms"};
+    char *text = (char *)malloc((size_t)size);
+    char path[512], gz_path[520], cmd[1100];
+    CHECK(text != NULL);
+    snprintf(path, sizeof(path), "%s.log", argv[0]);
+    snprintf(gz_path, sizeof(gz_path), "%s.gz", path);
+
+    uint64_t x = 88172645463325252ull;
+    size_t at = 0;
+    while (at < size) {
+        char line[256];
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        int n = snprintf(line, sizeof(line), "2026-10-18 12:%02u:%02u", (unsigned)(x % 60u), (unsigned)(x / 60u % 60u));
+        for (unsigned w = 3u + (unsigned)(x >> 20) % 9u; w > 0; w--) {
+            x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+            n += snprintf(line + n, sizeof(line) - (size_t)n, " %s", words[x % 9u]);
+        }
+        line[n++] = '\n';
+        if ((uint64_t)n > size - at) n = (int)(size - at);
+        memcpy(text + at, line, (size_t)n);
+        at += (size_t)n;
+    }
+    FILE *f = fopen(path, "wb");
+    CHECK(f != NULL && fwrite(text, 1, (size_t)size, f) == size && fclose(f) == 0);
+    snprintf(cmd, sizeof(cmd), "gzip -6 -f '%s'", path);
+    if (system(cmd) != 0) {
+        printf("gzip: skipped, the gzip command is not available\n");
+        remove(path);
+        return 0;
+    }
+    uint64_t gz_size = file_size(gz_path);
+
+    f = fopen(gz_path, "rb");
+    CHECK(f != NULL);
+    GzReader *r = gz_reader_open(file_read, file_seek, f, GZ_CHECKPOINT_SPAN);
+    unsigned char *buf = (unsigned char *)malloc(1u << 20);
+    CHECK(r != NULL && buf != NULL);
+    uint64_t started = sys_now_us();
+    uint64_t out = 0;
+    size_t n;
+    while ((n = gz_reader_read(r, buf, 1u << 20)) > 0) {
+        CHECK(out + n <= size && memcmp(buf, text + out, n) == 0);
+        out += n;
+    }
+    double secs = (double)(sys_now_us() - started) / 1e6;
+    CHECK(out == size && gz_reader_error(r) == NULL);
+    printf("inflate %.1f MB from %.1f MB: %.0f MB/s, %zu checkpoints\n",
+        (double)size / 1048576.0, (double)gz_size / 1048576.0, (double)size / 1048576.0 / secs, gz_reader_checkpoints(r));
+
+    double worst = 0.0, total = 0.0;
+    for (int k = 0; k < 200; k++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        uint64_t offset = x % size;
+        started = sys_now_us();
+        CHECK(gz_reader_seek(r, offset));
+        size_t want = size - offset < 4096u ? (size_t)(size - offset) : 4096u;
+        size_t got = 0;
+        while (got < want && (n = gz_reader_read(r, buf + got, want - got)) > 0) got += n;
+        double ms = (double)(sys_now_us() - started) / 1000.0;
+        CHECK(got == want && memcmp(buf, text + offset, want) == 0);
+        total += ms;
+        if (ms > worst) worst = ms;
+    }
+    printf("seek + 4 KB read: %.2f ms average, %.2f ms worst\n", total / 200.0, worst);
+    gz_reader_close(r);
+    fclose(f);
+
+    static GzWriter w;
+    uint64_t saved = 0;
+    started = sys_now_us();
+    CHECK(gz_writer_init(&w, count_sink, &saved));
+    CHECK(gz_writer_write(&w, text, (size_t)size) && gz_writer_finish(&w));
+    printf("save back (stored blocks): %.1f MB, %.1fx the gzip -6 file, %.0f MB/s\n",
+        (double)saved / 1048576.0, (double)saved / (double)gz_size,
+        (double)size / 1048576.0 / ((double)(sys_now_us() - started) / 1e6));
+
+    remove(gz_path);
+    free(buf);
+    free(text);
+    return 0;
+}
@@ -0,0 +1,64 @@
+// Hex view document: open time, random row reads, formatting every row of
+// the file as a scroll would, and write-back of scattered patches
+// Usage: bench_hex_doc [file MB]   (default 1024)
+
+#include "check.h"
+#include "hex_doc.h"
+#include "sys_thread.h"
+
+#include <string.h>
+
+int main(int argc, char **argv) {
+    size_t file_mb = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 1024u;
+    uint64_t size = (uint64_t)file_mb << 20;
+    unsigned char *block = (unsigned char *)malloc(1u << 20);
+    char path[512];
+    CHECK(block != NULL && size > 0);
+    snprintf(path, sizeof(path), "%s.bin", argv[0]);
+
+    FILE *f = fopen(path, "wb");
+    CHECK(f != NULL);
+    for (size_t i = 0; i < (1u << 20); i++) block[i] = (unsigned char)((i * 2654435761u) >> 13);
+    for (size_t i = 0; i < file_mb; i++) CHECK(fwrite(block, 1, 1u << 20, f) == (1u << 20));
+    CHECK(fclose(f) == 0);
+
+    uint64_t started = sys_now_us();
+    HexDoc *doc = hex_doc_open(path);
+    CHECK(doc != NULL);
+    printf("open %zu MB: %.3f ms\n", file_mb, (double)(sys_now_us() - started) / 1000.0);
+
+    unsigned char rows[HEX_ROW_BYTES * 64];
+    uint64_t x = 88172645463325252ull;
+    started = sys_now_us();
+    for (int k = 0; k < 200000; k++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        CHECK(hex_doc_read(doc, x % size, rows, sizeof(rows)) > 0);
+    }
+    printf("random 64-row reads: %.2f us each\n", (double)(sys_now_us() - started) / 200000.0);
+
+    char text[HEX_ROW_TEXT];
+    size_t chars = 0;
+    started = sys_now_us();
+    for (uint64_t at = 0; at < size; at += sizeof(rows)) {
+        size_t n = hex_doc_read(doc, at, rows, sizeof(rows));
+        for (size_t r = 0; r < n; r += HEX_ROW_BYTES) {
+            chars += hex_format_row(at + r, rows + r, n - r < HEX_ROW_BYTES ? n - r : HEX_ROW_BYTES, text);
+        }
+    }
+    double secs = (double)(sys_now_us() - started) / 1e6;
+    printf("format every row: %.2f s, %.0f MB/s (%zu chars)\n", secs, (double)file_mb / secs, chars);
+
+    for (int k = 0; k < 1000; k++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        CHECK(hex_doc_set_byte(doc, x % size, (unsigned char)x));
+    }
+    size_t patches = hex_doc_patch_count(doc);
+    started = sys_now_us();
+    CHECK(hex_doc_write_back(doc));
+    printf("write-back of %zu scattered bytes: %.2f ms\n", patches, (double)(sys_now_us() - started) / 1000.0);
+
+    hex_doc_close(doc);
+    remove(path);
+    free(block);
+    return 0;
+}
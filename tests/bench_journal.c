@@ -0,0 +1,65 @@
+// Edit journal throughput: keystroke-sized records, large pastes and replay
+// Usage: bench_journal [paste MB]   (default 256)
+
+#include "check.h"
+#include "crc32.h"
+#include "journal.h"
+#include "sys_thread.h"
+
+#include <string.h>
+
+int main(int argc, char **argv) {
+    size_t paste_mb = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 256u;
+    char path[512];
+    snprintf(path, sizeof(path), "%s.journal", argv[0]);
+
+    // Keystrokes: one byte each, batched by the writer thread.
+    JournalWriter *w = journal_create(path, 0, crc32_update(0, "", 0), 20);
+    CHECK(w != NULL);
+    const unsigned keys = 200000;
+    uint64_t started = sys_now_us();
+    for (unsigned i = 0; i < keys; i++) {
+        CHECK(journal_append(w, i, 0, "k", 1, (uint64_t)i + 1u));
+    }
+    uint64_t queued = sys_now_us() - started;
+    CHECK(journal_flush(w));
+    uint64_t flushed = sys_now_us() - started;
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+    uint64_t batches = 0;
+    journal_stats(w, &records, &bytes, &batches);
+    printf("keystrokes: %u records, %.2f us each to queue, %.1f ms to disk in %llu batches\n",
+        keys, (double)queued / keys, (double)flushed / 1000.0, (unsigned long long)batches);
+
+    // Pastes of 1 MB each.
+    size_t chunk = 1024u * 1024u;
+    char *data = (char *)malloc(chunk);
+    CHECK(data != NULL);
+    for (size_t i = 0; i < chunk; i++) data[i] = (char)('a' + i % 26);
+    uint64_t doc_len = keys;
+    started = sys_now_us();
+    for (size_t i = 0; i < paste_mb; i++) {
+        doc_len += chunk;
+        CHECK(journal_append(w, doc_len - chunk, 0, data, chunk, doc_len));
+    }
+    CHECK(journal_flush(w));
+    double secs = (double)(sys_now_us() - started) / 1e6;
+    printf("pastes: %zu MB in %.2f s, %.0f MB/s with fsync\n", paste_mb, secs, (double)paste_mb / secs);
+    journal_close(w, 0);
+
+    // Replay of everything above.
+    char *out = NULL;
+    size_t out_len = 0;
+    JournalInfo info;
+    started = sys_now_us();
+    CHECK(journal_replay(path, "", 0, &out, &out_len, &info) == JOURNAL_OK);
+    secs = (double)(sys_now_us() - started) / 1e6;
+    CHECK(out_len == doc_len && info.records == keys + paste_mb);
+    printf("replay: %llu records, %.1f MB in %.2f s, %.0f MB/s\n",
+        (unsigned long long)info.records, (double)out_len / 1048576.0, secs, (double)out_len / 1048576.0 / secs);
+
+    free(out);
+    free(data);
+    remove(path);
+    return 0;
+}
@@ -0,0 +1,78 @@
+// JSON formatter: pretty-print and minify throughput on a generated
+// document streamed in 1 MB chunks, asserting that peak resident memory
+// stays under 8 MB whatever the document size
+// Usage: bench_json_format [document MB]   (default 1024)
+
+#define _DEFAULT_SOURCE
+#include "check.h"
+#include "json_format.h"
+#include "sys_thread.h"
+
+#include <string.h>
+#include <sys/resource.h>
+
+#define RSS_LIMIT_KB 8192L
+
+static int count_sink(void *ctx, const void *data, size_t len) {
+    (void)data;
+    *(uint64_t *)ctx += len;
+    return 1;
+}
+
+static long peak_rss_kb(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+// One array of records. A 1 MB chunk of records is generated once and fed
+// over and over, so the document is never held in memory and generation
+// stays out of the timing.
+static char g_chunk[1024 * 1024];
+static size_t g_chunk_len;
+
+static void generate_chunk(void) {
+    unsigned id = 0;
+    while (g_chunk_len + 256u < sizeof(g_chunk)) {
+        g_chunk_len += (size_t)snprintf(g_chunk + g_chunk_len, sizeof(g_chunk) - g_chunk_len,
+            ",{\"id\": %u, \"name\": \"user \\\"%u\\\" caf\\u00e9\", \"tags\": [\"a\", \"b\", %u],"
+            " \"score\": -%u.5e3, \"ok\": %s, \"nested\": {\"x\": null, \"y\": []}}\n",
+            id, id * 7u, id % 100u, id % 1000u, id % 2u ? "true" : "false");
+        id++;
+    }
+}
+
+static uint64_t run(JsonFormatMode mode, uint64_t size, uint64_t *written) {
+    static JsonFormatter f;
+    uint64_t fed = 0;
+    *written = 0;
+    CHECK(json_format_init(&f, mode, 2, "\n", count_sink, written));
+    CHECK(json_format_feed(&f, "[{}", 3));
+    while (fed < size) {
+        CHECK(json_format_feed(&f, g_chunk, g_chunk_len));
+        fed += g_chunk_len;
+    }
+    CHECK(json_format_feed(&f, "]", 1));
+    CHECK(json_format_finish(&f));
+    CHECK(json_format_error(&f) == NULL);
+    return fed + 4u;
+}
+
+int main(int argc, char **argv) {
+    size_t doc_mb = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 1024u;
+    uint64_t size = (uint64_t)doc_mb << 20;
+    static const char *names[] = {"pretty", "minify"};
+    generate_chunk();
+
+    for (int mode = JSON_PRETTY; mode <= JSON_MINIFY; mode++) {
+        uint64_t written = 0;
+        uint64_t started = sys_now_us();
+        uint64_t in = run((JsonFormatMode)mode, size, &written);
+        double secs = (double)(sys_now_us() - started) / 1e6;
+        printf("%s: %.0f MB in, %.0f MB out, %.0f MB/s\n",
+            names[mode], (double)in / 1048576.0, (double)written / 1048576.0, (double)in / 1048576.0 / secs);
+    }
+    printf("peak RSS %ld KB (limit %ld KB)\n", peak_rss_kb(), RSS_LIMIT_KB);
+    CHECK(peak_rss_kb() < RSS_LIMIT_KB);
+    return 0;
+}
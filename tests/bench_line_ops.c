@@ -0,0 +1,83 @@
+// Line operations: sorting tens of millions of lines against qsort over an
+// array of line pointers, for each sort mode and for unique
+// Usage: bench_line_ops [million lines] [threads]   (default 50, one per CPU)
+
+#include "check.h"
+#include "line_ops.h"
+#include "sys_thread.h"
+
+#include <string.h>
+
+typedef struct {
+    const char *p;
+    size_t len;
+} Line;
+
+static int compare_lines(const void *va, const void *vb) {
+    const Line *a = (const Line *)va;
+    const Line *b = (const Line *)vb;
+    int c = memcmp(a->p, b->p, a->len < b->len ? a->len : b->len);
+    if (c != 0) return c;
+    return a->len < b->len ? -1 : a->len > b->len;
+}
+
+int main(int argc, char **argv) {
+    size_t millions = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 50u;
+    unsigned threads = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 10) : 0u;
+    size_t count = millions * 1000000u;
+    size_t cap = count * 17u;
+    char *text = (char *)malloc(cap);
+    size_t len = 0;
+    uint64_t x = 88172645463325252ull;
+    CHECK(text != NULL);
+
+    // "1234567 abcdefgh\n": a number then letters, 8 to 16 bytes.
+    for (size_t i = 0; i < count; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        int n = snprintf(text + len, cap - len, "%u ", (unsigned)(x % 10000000u));
+        len += (size_t)n;
+        for (unsigned k = (unsigned)(x >> 40) % 8u; k > 0; k--) text[len++] = (char)('a' + (x >> (k * 5u)) % 26u);
+        text[len++] = '\n';
+    }
+    printf("%zu lines, %.0f MB, %u CPUs\n", count, (double)len / 1048576.0, sys_cpu_count());
+
+    Line *lines = (Line *)malloc(count * sizeof(Line));
+    CHECK(lines != NULL);
+    uint64_t started = sys_now_us();
+    size_t at = 0;
+    for (size_t i = 0; i < count; i++) {
+        const char *nl = (const char *)memchr(text + at, '\n', len - at);
+        lines[i].p = text + at;
+        lines[i].len = (size_t)(nl - (text + at));
+        at += lines[i].len + 1u;
+    }
+    qsort(lines, count, sizeof(Line), compare_lines);
+    printf("qsort of line pointers (lexical, no output): %.2f s\n", (double)(sys_now_us() - started) / 1e6);
+
+    static const char *names[] = {"none", "lexical", "nocase", "numeric"};
+    for (int mode = LINE_SORT_LEXICAL; mode <= LINE_SORT_NUMERIC; mode++) {
+        for (int unique = 0; unique <= 1; unique++) {
+            LineOps ops = {(LineSortMode)mode, unique, 0, threads};
+            LineOpsResult result;
+            size_t out_len = 0;
+            started = sys_now_us();
+            char *out = line_ops_apply(text, len, &ops, "\n", &out_len, &result);
+            double secs = (double)(sys_now_us() - started) / 1e6;
+            CHECK(out != NULL);
+            if (mode == LINE_SORT_LEXICAL && !unique) {
+                // Same order as qsort: compare the output with the sorted pointers.
+                const char *o = out;
+                for (size_t i = 0; i < count; i++) {
+                    CHECK(memcmp(o, lines[i].p, lines[i].len) == 0 && o[lines[i].len] == '\n');
+                    o += lines[i].len + 1u;
+                }
+            }
+            printf("line_ops %-7s%s: %.2f s on %u threads, %zu lines out\n",
+                names[mode], unique ? " unique" : "       ", secs, result.threads, result.lines_out);
+            free(out);
+        }
+    }
+    free(lines);
+    free(text);
+    return 0;
+}
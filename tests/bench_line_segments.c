@@ -0,0 +1,97 @@
+// Line segment index: build time for one line of a gigabyte with no line
+// breaks, then latency of the lookups the long-line view makes per caret move
+// and per repaint (x of an offset, offset at an x, first visible segment)
+// Usage: bench_line_segments [MB]   (default 1024)
+
+#include "check.h"
+#include "line_segments.h"
+#include "sys_thread.h"
+
+#include <string.h>
+
+#define LOOKUPS 100000
+
+static uint64_t g_samples[LOOKUPS];
+static unsigned g_seed = 2463534242u;
+
+static unsigned next_rand(void) {
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 7;
+    g_seed ^= g_seed << 17;
+    return g_seed;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, uint64_t *v, size_t n) {
+    uint64_t sum = 0;
+    qsort(v, n, sizeof(v[0]), compare_u64);
+    for (size_t i = 0; i < n; i++) sum += v[i];
+    printf("%-26s avg %8.1f us  p50 %6llu  p99 %6llu  max %6llu\n", name, (double)sum / (double)n,
+        (unsigned long long)v[n / 2], (unsigned long long)v[n * 99 / 100], (unsigned long long)v[n - 1]);
+}
+
+// Random 64-bit value below `limit`, for offsets and x positions past 4 GB.
+static uint64_t below(uint64_t limit) {
+    uint64_t r = ((uint64_t)next_rand() << 32) | next_rand();
+    return limit ? r % limit : 0;
+}
+
+int main(int argc, char **argv) {
+    long mb = argc > 1 ? strtol(argv[1], NULL, 10) : 1024;
+    size_t len = (size_t)mb << 20;
+    char *text = (char *)malloc(len);
+    uint16_t width[256];
+    volatile uint64_t sink = 0;
+    CHECK(text != NULL);
+
+    // Minified JSON-like bytes measured with proportional widths, tab stops
+    // at four spaces.
+    for (size_t i = 0; i < len; i++) text[i] = "{\"key\":[1,2,3],\"name\":\"value\"}\t"[i & 31u];
+    for (int c = 0; c < 256; c++) width[c] = (uint16_t)(6u + (unsigned)c % 7u);
+    width['\t'] = 4u * width[' '];
+
+    LineSegments ls;
+    uint64_t started = sys_now_us();
+    CHECK(line_segments_build(&ls, text, len, width));
+    printf("build: %.1f MB line in %.1f ms, %zu segments, %.1f MB index, %llu px wide\n", (double)len / 1048576.0,
+        (double)(sys_now_us() - started) / 1000.0, ls.count,
+        (double)(ls.count * (sizeof(uint32_t) + sizeof(uint64_t))) / 1048576.0,
+        (unsigned long long)line_segments_width(&ls));
+
+    uint64_t total = line_segments_width(&ls);
+    for (int i = 0; i < LOOKUPS; i++) {
+        size_t offset = (size_t)below(len + 1u);
+        started = sys_now_us();
+        sink += line_segments_x_of(&ls, text, offset);
+        g_samples[i] = sys_now_us() - started;
+    }
+    report("x of an offset", g_samples, LOOKUPS);
+    for (int i = 0; i < LOOKUPS; i++) {
+        uint64_t x = below(total);
+        started = sys_now_us();
+        sink += line_segments_offset_at(&ls, text, x);
+        g_samples[i] = sys_now_us() - started;
+    }
+    report("offset at an x", g_samples, LOOKUPS);
+    for (int i = 0; i < LOOKUPS; i++) {
+        uint64_t x = below(total), segment_x;
+        started = sys_now_us();
+        sink += line_segments_segment_at(&ls, x, &segment_x);
+        g_samples[i] = sys_now_us() - started;
+    }
+    report("first visible segment", g_samples, LOOKUPS);
+
+    // The walk the view would need without the index: the far end of the line.
+    started = sys_now_us();
+    for (size_t i = 0; i < len; i++) sink += width[(unsigned char)text[i]];
+    printf("linear walk to the end: %.1f ms\n", (double)(sys_now_us() - started) / 1000.0);
+
+    line_segments_free(&ls);
+    free(text);
+    return 0;
+}
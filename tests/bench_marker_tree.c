@@ -0,0 +1,90 @@
+// Marker tree: adding a million markers over a 1 GB document, edit latency
+// with all of them live, next-of-kind lookups, and the per-edit cost of the
+// flat array a naive implementation would shift on every keystroke
+// Usage: bench_marker_tree [markers]   (default 1000000)
+
+#include "check.h"
+#include "marker_tree.h"
+#include "sys_thread.h"
+
+#include <string.h>
+
+#define EDITS 200000
+#define NAIVE_EDITS 2000
+#define LOOKUPS 100000
+
+static unsigned next_rand(unsigned *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static uint64_t next_offset(unsigned *s, uint64_t len) {
+    uint64_t r = ((uint64_t)next_rand(s) << 32) | next_rand(s);
+    return r % len;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv) {
+    uint32_t count = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 1000000u;
+    uint64_t len = 1ull << 30;
+    unsigned seed = 2463534242u;
+    MarkerTree t;
+    memset(&t, 0, sizeof(t));
+
+    uint64_t started = sys_now_us();
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t start = next_offset(&seed, len);
+        uint64_t end = start + (i % 4u ? 0 : next_rand(&seed) % 200u);
+        CHECK(marker_tree_add(&t, start, end, 1u << (i % 3u), 0));
+    }
+    printf("add %u markers: %.0f ms\n", count, (double)(sys_now_us() - started) / 1000.0);
+
+    // Keystroke-sized edits at random places, each touching few markers.
+    static uint64_t latency[EDITS];
+    started = sys_now_us();
+    for (int e = 0; e < EDITS; e++) {
+        uint64_t offset = next_offset(&seed, len);
+        uint64_t del = next_rand(&seed) % 4u;
+        uint64_t ins = next_rand(&seed) % 4u;
+        uint64_t before = sys_now_us();
+        CHECK(marker_tree_edit(&t, offset, del, ins));
+        latency[e] = sys_now_us() - before;
+        len = len - del + ins;
+    }
+    double avg = (double)(sys_now_us() - started) / EDITS;
+    qsort(latency, EDITS, sizeof(latency[0]), compare_u64);
+    printf("%d edits: %.2f us avg, p50 %llu us, p99 %llu us, max %llu us\n", EDITS, avg,
+        (unsigned long long)latency[EDITS / 2], (unsigned long long)latency[EDITS * 99 / 100],
+        (unsigned long long)latency[EDITS - 1]);
+
+    Marker m;
+    int hits = 0;
+    started = sys_now_us();
+    for (int i = 0; i < LOOKUPS; i++) hits += marker_tree_next(&t, next_offset(&seed, len), 4u, &m);
+    printf("next of one kind: %.2f us (%d found)\n", (double)(sys_now_us() - started) / LOOKUPS, hits);
+    marker_tree_free(&t);
+
+    // The naive model: every start and end in one array, all moved per edit.
+    uint64_t *flat = (uint64_t *)malloc((size_t)count * 2u * sizeof(uint64_t));
+    CHECK(flat != NULL);
+    for (size_t i = 0; i < (size_t)count * 2u; i++) flat[i] = next_offset(&seed, len);
+    started = sys_now_us();
+    for (int e = 0; e < NAIVE_EDITS; e++) {
+        uint64_t offset = next_offset(&seed, len);
+        for (size_t i = 0; i < (size_t)count * 2u; i++) {
+            if (flat[i] > offset) flat[i]++;
+        }
+    }
+    double naive = (double)(sys_now_us() - started) / NAIVE_EDITS;
+    printf("flat array shifted per edit: %.0f us (%.0fx the tree), checksum %llu\n", naive, naive / avg,
+        (unsigned long long)flat[count / 2u]);
+    free(flat);
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Memory counters: cost of an alloc/free report pair next to the malloc and
+// free it accounts for, on one thread and on eight sharing one tag or using
+// their own, and DocStore append throughput with its per-page reports
+// Usage: bench_mem_account [million pairs]   (default 20)
+
+#include "check.h"
+#include "doc_store.h"
+#include "mem_account.h"
+#include "sys_thread.h"
+
+#include <string.h>
+
+#define MAX_THREADS 8
+
+enum { RUN_MALLOC = 1, RUN_ACCOUNT = 2 };
+
+typedef struct {
+    SysThread thread;
+    MemTag tag;
+    int what;
+    long pairs;
+} Worker;
+
+static int worker_main(void *arg) {
+    Worker *w = (Worker *)arg;
+    void *volatile keep = NULL;
+    for (long i = 0; i < w->pairs; i++) {
+        size_t size = 64u + (size_t)(i & 255);
+        if (w->what & RUN_MALLOC) {
+            void *p = malloc(size);
+            keep = p;
+            free(p);
+        }
+        if (w->what & RUN_ACCOUNT) {
+            mem_account_alloc(w->tag, size);
+            mem_account_free(w->tag, size);
+        }
+    }
+    (void)keep;
+    return 0;
+}
+
+static double run(int threads, int same_tag, int what, long pairs) {
+    static Worker workers[MAX_THREADS];
+    uint64_t started = sys_now_us();
+    for (int i = 0; i < threads; i++) {
+        workers[i].tag = same_tag ? MEM_DOCUMENT : (MemTag)(i % MEM_TAG_COUNT);
+        workers[i].what = what;
+        workers[i].pairs = pairs;
+        CHECK(sys_thread_start(&workers[i].thread, worker_main, &workers[i]));
+    }
+    for (int i = 0; i < threads; i++) sys_thread_join(&workers[i].thread);
+    return (double)(sys_now_us() - started) * 1000.0 / (double)pairs;
+}
+
+int main(int argc, char **argv) {
+    long pairs = (argc > 1 ? strtol(argv[1], NULL, 10) : 20L) * 1000000L;
+    static const char *names[] = {"", "malloc+free", "report pair", "malloc+free+report"};
+    printf("%u CPUs, ns per pair on each thread\n", sys_cpu_count());
+
+    for (int threads = 1; threads <= MAX_THREADS; threads *= MAX_THREADS) {
+        for (int same_tag = 1; same_tag >= 0; same_tag--) {
+            if (threads == 1 && !same_tag) continue;
+            printf("%d thread%s%-10s", threads, threads > 1 ? "s" : " ", threads == 1 ? "" : same_tag ? ", one tag" : ", own tags");
+            for (int what = RUN_MALLOC; what <= (RUN_MALLOC | RUN_ACCOUNT); what++) {
+                printf("  %s %.1f", names[what], run(threads, same_tag, what, pairs));
+            }
+            printf("\n");
+        }
+    }
+
+    // The counters see one report per 64 KB page here.
+    char *chunk = (char *)malloc(1u << 20);
+    CHECK(chunk != NULL);
+    memset(chunk, 'a', 1u << 20);
+    double best = 1e30;
+    for (int rep = 0; rep < 5; rep++) {
+        DocStore s;
+        doc_store_init(&s);
+        uint64_t started = sys_now_us();
+        for (int k = 0; k < 512; k++) CHECK(doc_store_append(&s, chunk, 1u << 20));
+        double secs = (double)(sys_now_us() - started) / 1e6;
+        doc_store_free(&s);
+        if (secs < best) best = secs;
+    }
+    printf("DocStore append of 512 MB: %.0f MB/s (best of 5)\n", 512.0 / best);
+
+    char report[512];
+    mem_account_report(report, sizeof(report), ", ");
+    printf("%s\n", report);
+    free(chunk);
+    return 0;
+}
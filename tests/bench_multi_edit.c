@@ -0,0 +1,138 @@
+// Multiple carets on a 64 MB document: carets at every line end, a 10,000
+// line column selection and 10,000 carets spread over the file, with the
+// cost of building a patch per keystroke, splicing it, handing it out range
+// by range, moving the carets and copying and pasting one line per caret
+// Usage: bench_multi_edit [MB]   (default 64)
+
+#include "check.h"
+#include "multi_edit.h"
+#include "sys_thread.h"
+
+#include <string.h>
+
+#define RUNS 20
+
+static char *g_text;
+static size_t g_len;
+
+static void splice(const MultiPatch *p) {
+    if (p->range_count == 0) return;
+    memmove(g_text + p->start + p->len, g_text + p->end, g_len - p->end);
+    memcpy(g_text + p->start, p->text, p->len);
+    g_len = g_len - (size_t)(p->end - p->start) + p->len;
+}
+
+static void count_span(void *ctx, const char *text, size_t len, uint64_t offset, uint64_t delete_len, uint64_t insert_len) {
+    (void)text;
+    (void)len;
+    (void)offset;
+    (void)delete_len;
+    (void)insert_len;
+    ++*(size_t *)ctx;
+}
+
+typedef struct {
+    uint64_t build;
+    uint64_t splice;
+    uint64_t spans;
+    size_t span_count;
+} PatchTimes;
+
+static void time_patch(MultiPatch *p, PatchTimes *t, uint64_t started) {
+    uint64_t built = sys_now_us();
+    splice(p);
+    uint64_t spliced = sys_now_us();
+    t->span_count = 0;
+    multi_patch_each_span(p, g_text, g_len, count_span, &t->span_count);
+    t->build += built - started;
+    t->splice += spliced - built;
+    t->spans += sys_now_us() - spliced;
+    multi_patch_free(p);
+}
+
+static void print_patch(const char *name, const PatchTimes *t) {
+    printf("  %-12s %8.0f us to build the patch, %6.0f us to splice it, %6.0f us for %zu spans\n", name,
+        (double)t->build / RUNS, (double)t->splice / RUNS, (double)t->spans / RUNS, t->span_count);
+}
+
+static void run(const char *name, MultiEdit *me) {
+    MultiPatch p;
+    PatchTimes typing = {0, 0, 0, 0};
+    PatchTimes backspace = {0, 0, 0, 0};
+    printf("%s: %zu carets\n", name, me->count);
+    for (int i = 0; i < RUNS; i++) {
+        uint64_t started = sys_now_us();
+        CHECK(multi_edit_type(me, g_text, g_len, "x", 1, &p));
+        time_patch(&p, &typing, started);
+    }
+    print_patch("type a char", &typing);
+    for (int i = 0; i < RUNS; i++) {
+        uint64_t started = sys_now_us();
+        CHECK(multi_edit_delete(me, g_text, g_len, 0, &p));
+        time_patch(&p, &backspace, started);
+    }
+    print_patch("backspace", &backspace);
+
+    uint64_t started = sys_now_us();
+    for (int i = 0; i < RUNS; i++) multi_edit_move(me, g_text, g_len, i % 2 ? MULTI_LEFT : MULTI_RIGHT, 0);
+    printf("  left/right   %8.0f us\n", (double)(sys_now_us() - started) / RUNS);
+    started = sys_now_us();
+    for (int i = 0; i < RUNS; i++) multi_edit_move(me, g_text, g_len, i % 2 ? MULTI_UP : MULTI_DOWN, 0);
+    printf("  up/down      %8.0f us\n", (double)(sys_now_us() - started) / RUNS);
+
+    size_t n;
+    multi_edit_move(me, g_text, g_len, MULTI_HOME, 1);
+    started = sys_now_us();
+    char *copy = multi_edit_copy(me, g_text, g_len, "\r\n", &n);
+    uint64_t copied = sys_now_us();
+    CHECK(copy != NULL);
+    CHECK(multi_edit_paste(me, g_text, g_len, copy, n, &p));
+    printf("  copy %zu lines: %.0f us, paste them back one per caret: %.0f us\n", me->count,
+        (double)(copied - started), (double)(sys_now_us() - copied));
+    splice(&p);
+    multi_patch_free(&p);
+    free(copy);
+}
+
+int main(int argc, char **argv) {
+    size_t target = (size_t)(argc > 1 ? strtoul(argv[1], NULL, 10) : 64u) << 20;
+    unsigned seed = 2463534242u;
+    size_t lines = 0;
+    g_text = (char *)malloc(target * 2u);
+    CHECK(g_text != NULL);
+    while (g_len < target) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        g_len += (size_t)sprintf(g_text + g_len, "    value_%06u = compute(%u, \"%s\");\r\n", seed % 1000000u, seed % 977u,
+            (seed >> 8) % 2u ? "alpha" : "beta_gamma");
+        lines++;
+    }
+    printf("document %.1f MB, %zu lines\n", (double)g_len / 1048576.0, lines);
+
+    MultiEdit me;
+    memset(&me, 0, sizeof(me));
+    uint64_t started = sys_now_us();
+    CHECK(multi_edit_line_ends(&me, g_text, g_len, 0, g_len));
+    printf("carets at all %zu line ends: %.1f ms\n", me.count, (double)(sys_now_us() - started) / 1000.0);
+
+    size_t from = g_len / 2u;
+    size_t to = from;
+    for (size_t k = 0; k < 10000;) k += g_text[to++] == '\n';
+    started = sys_now_us();
+    CHECK(multi_edit_column_select(&me, g_text, g_len, from + 4u, to + 4u));
+    printf("10,000-line column selection: %.0f us\n", (double)(sys_now_us() - started));
+    multi_edit_move(&me, g_text, g_len, MULTI_LEFT, 0);
+    run("adjacent lines", &me);
+
+    multi_edit_clear(&me);
+    size_t line = 0;
+    for (size_t at = 0; at < g_len && me.count < 10000; at++) {
+        if (g_text[at] == '\n' && ++line % (lines / 10000u) == 0) CHECK(multi_edit_add(&me, g_text, g_len, at - 1u, at - 1u));
+    }
+    run("spread over the document", &me);
+
+    multi_edit_free(&me);
+    free(g_text);
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Structure index: build time for a C-like document of a million lines, then
+// latency of the edits the editor feeds it (typing, line breaks, braces, an
+// opened comment that relexes lines up to the next */) and of the lookups
+// Usage: bench_struct_index [lines]   (default 1000000)
+
+#include "check.h"
+#include "struct_index.h"
+#include "sys_thread.h"
+
+#include <string.h>
+
+#define EDITS 20000
+#define LOOKUPS 2000
+
+static char *g_text;
+static size_t g_len;
+static uint64_t g_samples[EDITS * 2];
+static unsigned g_seed = 2463534242u;
+
+static unsigned next_rand(void) {
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 7;
+    g_seed ^= g_seed << 17;
+    return g_seed;
+}
+
+static size_t find_from(size_t at, char c) {
+    while (at < g_len && g_text[at] != c) at++;
+    return at < g_len ? at : 0;
+}
+
+static uint64_t apply(StructIndex *si, size_t offset, size_t del, const char *insert, size_t n) {
+    memmove(g_text + offset + n, g_text + offset + del, g_len - offset - del);
+    memcpy(g_text + offset, insert, n);
+    g_len = g_len - del + n;
+    uint64_t started = sys_now_us();
+    CHECK(struct_index_edit(si, g_text, g_len, offset, del, n));
+    return sys_now_us() - started;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, uint64_t *v, size_t n) {
+    uint64_t sum = 0;
+    qsort(v, n, sizeof(v[0]), compare_u64);
+    for (size_t i = 0; i < n; i++) sum += v[i];
+    printf("%-26s avg %8.1f us  p50 %6llu  p99 %6llu  max %6llu\n", name, (double)sum / (double)n,
+        (unsigned long long)v[n / 2], (unsigned long long)v[n * 99 / 100], (unsigned long long)v[n - 1]);
+}
+
+int main(int argc, char **argv) {
+    static const char *const lines[] = {
+        "static int f%d(int x) {\r\n", "    if (x > %d) {\r\n",
+        "        return g(x, \"}\", '{') + %d; // }\r\n", "    }\r\n",
+        "    /* comment %d */\r\n", "    return 0;\r\n", "}\r\n", "\r\n",
+    };
+    long count = argc > 1 ? strtol(argv[1], NULL, 10) : 1000000;
+    size_t cap = (size_t)count * 48u + (1u << 20);
+    g_text = (char *)malloc(cap);
+    CHECK(g_text != NULL);
+    for (long i = 0; i < count; i++) g_len += (size_t)sprintf(g_text + g_len, lines[i % 8], (int)i);
+
+    StructIndex si;
+    memset(&si, 0, sizeof(si));
+    uint64_t started = sys_now_us();
+    CHECK(struct_index_build(&si, g_text, g_len));
+    printf("build: %llu lines, %.1f MB in %.1f ms, %zu blocks\n", (unsigned long long)si.lines,
+        (double)g_len / 1048576.0, (double)(sys_now_us() - started) / 1000.0, si.count);
+
+    for (int i = 0; i < EDITS; i++) g_samples[i] = apply(&si, next_rand() % g_len, 0, "x", 1);
+    report("type a character", g_samples, EDITS);
+    for (int i = 0; i < EDITS; i++) g_samples[i] = apply(&si, find_from(next_rand() % g_len, '\n') + 1u, 0, "\r\n", 2);
+    report("insert a line break", g_samples, EDITS);
+    for (int i = 0; i < EDITS; i++) {
+        size_t at = find_from(next_rand() % g_len, '{');
+        g_samples[2 * i] = apply(&si, at, 1, "", 0);
+        g_samples[2 * i + 1] = apply(&si, at, 0, "{", 1);
+    }
+    report("delete and retype {", g_samples, EDITS * 2);
+    for (int i = 0; i < 200; i++) {
+        size_t at = find_from(next_rand() % g_len, '\n') + 1u;
+        g_samples[2 * i] = apply(&si, at, 0, "/*", 2);
+        g_samples[2 * i + 1] = apply(&si, at, 2, "", 0);
+    }
+    report("open and close /*", g_samples, 400);
+
+    uint64_t match;
+    for (int i = 0; i < LOOKUPS; i++) {
+        size_t at = find_from(next_rand() % (g_len / 2u), '{');
+        started = sys_now_us();
+        struct_index_match(&si, g_text, g_len, at, &match);
+        g_samples[i] = sys_now_us() - started;
+    }
+    report("match a bracket", g_samples, LOOKUPS);
+    for (int i = 0; i < LOOKUPS; i++) {
+        uint64_t last;
+        uint64_t line = next_rand() % si.lines;
+        started = sys_now_us();
+        struct_index_fold(&si, line, &last);
+        g_samples[i] = sys_now_us() - started;
+    }
+    report("fold range", g_samples, LOOKUPS);
+
+    // One stray { at the top pairs the last } with the first line.
+    size_t first = find_from(0, '{');
+    size_t last = g_len - 1u;
+    while (g_text[last] != '}') last--;
+    apply(&si, first, 1, " ", 1);
+    for (int i = 0; i < 200; i++) {
+        started = sys_now_us();
+        struct_index_match(&si, g_text, g_len, last, &match);
+        g_samples[i] = sys_now_us() - started;
+    }
+    report("match across the file", g_samples, 200);
+
+    struct_index_free(&si);
+    free(g_text);
+    return 0;
+}
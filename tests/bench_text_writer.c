@@ -0,0 +1,68 @@
+// Text writer throughput and peak memory for each encoding and line ending
+// Usage: bench_text_writer [MB per run]   (default 512; 2048 for the 2 GB case)
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "check.h"
+#include "sys_thread.h"
+#include "text_writer.h"
+
+#include <string.h>
+#include <sys/resource.h>
+
+static int count_sink(void *ctx, const void *data, size_t len) {
+    (void)data;
+    *(uint64_t *)ctx += len;
+    return 1;
+}
+
+static long peak_rss_kb(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+int main(int argc, char **argv) {
+    static const TextEncoding encodings[] = {TEXT_ENC_RAW, TEXT_ENC_UTF8_BOM, TEXT_ENC_UTF16LE, TEXT_ENC_UTF16BE};
+    static const TextEol eols[] = {TEXT_EOL_CRLF, TEXT_EOL_LF, TEXT_EOL_CR};
+    size_t mb = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 512u;
+    size_t chunk_len = 1024u * 1024u;
+    char *chunk = (char *)malloc(chunk_len);
+    uint64_t lines = 0;
+    CHECK(chunk != NULL);
+
+    // 64-byte lines with a two-byte character in each.
+    for (size_t i = 0; i < chunk_len; i += 64u) {
+        memset(chunk + i, 'x', 64u);
+        memcpy(chunk + i + 10u, "\xC3\xA9", 2);
+        memcpy(chunk + i + 62u, "\r\n", 2);
+        lines++;
+    }
+    long rss_before = peak_rss_kb();
+
+    for (size_t e = 0; e < 4; e++) {
+        for (size_t l = 0; l < 3; l++) {
+            TextFormat format = {encodings[e], eols[l]};
+            unsigned char out_buf[64 * 1024];
+            uint64_t written = 0;
+            TextWriter w;
+            uint64_t started = sys_now_us();
+            CHECK(text_writer_init(&w, format, out_buf, sizeof(out_buf), count_sink, &written));
+            for (size_t i = 0; i < mb; i++) CHECK(text_writer_write(&w, chunk, chunk_len));
+            CHECK(text_writer_finish(&w));
+            double secs = (double)(sys_now_us() - started) / 1e6;
+
+            // Every line is 60 ASCII bytes, one two-byte character and a line ending.
+            uint64_t eol_units = format.eol == TEXT_EOL_CRLF ? 2u : 1u;
+            uint64_t per_line = format.encoding == TEXT_ENC_UTF16LE || format.encoding == TEXT_ENC_UTF16BE
+                ? (61u + eol_units) * 2u : 62u + eol_units;
+            uint64_t bom = format.encoding == TEXT_ENC_RAW ? 0u : format.encoding == TEXT_ENC_UTF8_BOM ? 3u : 2u;
+            CHECK(written == bom + per_line * lines * mb);
+            printf("%-15s %-4s %zu MB in %.2f s, %.0f MB/s\n",
+                text_encoding_name(format.encoding), text_eol_name(format.eol), mb, secs, (double)mb / secs);
+        }
+    }
+    printf("peak RSS %ld KB, %ld KB above the 1 MB input chunk\n", peak_rss_kb(), peak_rss_kb() - rss_before);
+    free(chunk);
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Word index: streamed build of a log-like document (1 GB by default), then
+// latency of typing, backspacing, pasting and cutting lines and completing
+// prefixes with the whole document indexed
+// Usage: bench_word_index [MB]   (default 1024)
+
+#include "check.h"
+#include "mem_account.h"
+#include "sys_thread.h"
+#include "word_index.h"
+
+#include <string.h>
+
+#define EDITS 20000
+#define CHUNK (1u << 20)
+
+static char *g_text;
+static size_t g_len;
+static uint64_t g_samples[EDITS];
+static unsigned g_seed = 2463534242u;
+
+static unsigned next_rand(void) {
+    g_seed ^= g_seed << 13;
+    g_seed ^= g_seed >> 7;
+    g_seed ^= g_seed << 17;
+    return g_seed;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char *name) {
+    uint64_t sum = 0;
+    qsort(g_samples, EDITS, sizeof(g_samples[0]), compare_u64);
+    for (size_t i = 0; i < EDITS; i++) sum += g_samples[i];
+    printf("%-22s avg %7.2f us  p99 %5llu us  max %6llu us\n", name, (double)sum / EDITS,
+        (unsigned long long)g_samples[EDITS * 99 / 100], (unsigned long long)g_samples[EDITS - 1]);
+}
+
+static uint64_t timed_edit(WordIndex *wi, size_t offset, const char *deleted, size_t del, size_t ins) {
+    uint64_t started = sys_now_us();
+    CHECK(word_index_edit(wi, g_text, g_len, offset, deleted, del, ins));
+    return sys_now_us() - started;
+}
+
+int main(int argc, char **argv) {
+    static const char *const levels[] = {"INFO", "WARN", "DEBUG", "ERROR"};
+    static const char *const common[] = {
+        "request", "handler", "connection", "session", "timeout", "retrying",
+        "completed", "user", "cache", "database", "query", "response",
+    };
+    size_t target = (size_t)(argc > 1 ? strtoul(argv[1], NULL, 10) : 1024u) << 20;
+    g_text = (char *)malloc(target + (16u << 20));
+    CHECK(g_text != NULL);
+    while (g_len < target) {
+        g_len += (size_t)sprintf(g_text + g_len, "2024-05-%02u 12:%02u:%02u.%03u %s [worker_%u] ",
+            next_rand() % 28u + 1u, next_rand() % 60u, next_rand() % 60u, next_rand() % 1000u,
+            levels[next_rand() % 4u], next_rand() % 64u);
+        unsigned words = 6u + next_rand() % 8u;
+        for (unsigned i = 0; i < words; i++) {
+            char end = i + 1u < words ? ' ' : '\n';
+            if (next_rand() % 4u == 0) {
+                g_len += (size_t)sprintf(g_text + g_len, "id_%05u%c", next_rand() % 1000000u, end);
+            } else {
+                g_len += (size_t)sprintf(g_text + g_len, "%s%c", common[next_rand() % 12u], end);
+            }
+        }
+    }
+
+    WordIndex wi;
+    memset(&wi, 0, sizeof(wi));
+    uint64_t started = sys_now_us();
+    for (size_t at = 0; at < g_len; at += CHUNK) {
+        CHECK(word_index_feed(&wi, g_text + at, g_len - at < CHUNK ? g_len - at : CHUNK));
+    }
+    uint64_t fed = sys_now_us();
+    CHECK(word_index_finish(&wi));
+    uint64_t finished = sys_now_us();
+    MemUsage usage;
+    mem_account_usage(MEM_SEARCH, &usage);
+    printf("%.1f MB, %zu words: feed %.0f ms (%.0f MB/s), finish %.0f ms, index %.1f MB\n",
+        (double)g_len / 1048576.0, wi.words, (double)(fed - started) / 1000.0,
+        (double)g_len / 1048576.0 / ((double)(fed - started) / 1e6), (double)(finished - fed) / 1000.0,
+        (double)usage.current / 1048576.0);
+
+    // A new identifier typed near the end, then backspaced away.
+    static const char word[] = "zebra_handler ";
+    size_t pos = g_len - (4u << 20);
+    while (g_text[pos] != '\n') pos++;
+    pos++;
+    for (int i = 0; i < EDITS; i++) {
+        memmove(g_text + pos + 1, g_text + pos, g_len - pos);
+        g_text[pos] = word[i % (int)(sizeof(word) - 1)];
+        g_len++;
+        g_samples[i] = timed_edit(&wi, pos++, NULL, 0, 1);
+    }
+    report("type a character");
+    for (int i = 0; i < EDITS; i++) {
+        char gone = g_text[--pos];
+        memmove(g_text + pos, g_text + pos + 1, g_len - pos - 1);
+        g_len--;
+        g_samples[i] = timed_edit(&wi, pos, &gone, 1, 0);
+    }
+    report("backspace");
+
+    for (int i = 0; i < EDITS; i++) {
+        size_t at = g_len - (8u << 20) + next_rand() % (6u << 20);
+        char line[256];
+        size_t n = (size_t)sprintf(line, "pasted_%u line with request handler id_%05u and more words here\n",
+            next_rand() % 100000u, next_rand() % 1000000u);
+        if (i % 2) {
+            memmove(g_text + at + n, g_text + at, g_len - at);
+            memcpy(g_text + at, line, n);
+            g_len += n;
+            g_samples[i] = timed_edit(&wi, at, NULL, 0, n);
+        } else {
+            memcpy(line, g_text + at, n);
+            memmove(g_text + at, g_text + at + n, g_len - at - n);
+            g_len -= n;
+            g_samples[i] = timed_edit(&wi, at, line, n, 0);
+        }
+    }
+    report("paste or cut a line");
+
+    static const char *const prefixes[] = {"re", "req", "id_", "id_12", "id_9999", "han", "co", "wor", "pas", "zeb", "q", "xyz"};
+    for (int i = 0; i < EDITS; i++) {
+        WordHit hits[10];
+        const char *p = prefixes[i % 12];
+        started = sys_now_us();
+        word_index_complete(&wi, p, strlen(p), hits, 10);
+        g_samples[i] = sys_now_us() - started;
+    }
+    report("complete, 10 best");
+
+    word_index_free(&wi);
+    free(g_text);
+    return 0;
+}
@@ -0,0 +1,19 @@
+// Checks for the module tests
+// A failed check prints where it failed and exits, so a test binary either
+// finishes with status 0 or stops at the first broken expectation.
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#endif
@@ -0,0 +1,44 @@
+#!/bin/sh
+# Headless batch mode on a large file: MB/s for each action, with the peak
+# resident set of every run held under a fixed limit however large the file.
+# Usage: tests/cli_throughput.sh [MB]   (default 2048)
+set -e
+
+MB=${1:-2048}
+RSS_LIMIT_KB=${RSS_LIMIT_KB:-65536}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+CLI=./editor-cli
+RSS=./tests/peak_rss
+
+yes 'a line of log text with a TODO marker and padding 0123456789abcdef' | head -c $((MB * 1024 * 1024)) > "$DIR/in.txt"
+LINES=$(wc -l < "$DIR/in.txt")
+SIZE=$(wc -c < "$DIR/in.txt")
+
+run() {
+    name=$1
+    shift
+    start=$(date +%s%N)
+    "$RSS" "$RSS_LIMIT_KB" "$@" > "$DIR/out.log"
+    end=$(date +%s%N)
+    ms=$(( (end - start) / 1000000 ))
+    [ "$ms" -gt 0 ] || ms=1
+    echo "$name: $MB MB in $ms ms, $(( MB * 1000 / ms )) MB/s"
+}
+
+run stats "$CLI" --stats "$DIR/in.txt"
+grep -q "lines: *$LINES\$" "$DIR/out.log" || grep -q "lines: *$((LINES + 1))\$" "$DIR/out.log"
+
+run find "$CLI" --find=TODO "$DIR/in.txt"
+[ "$(wc -l < "$DIR/out.log")" -eq "$LINES" ]
+
+run normalize-eol "$CLI" --normalize-eol=crlf --output="$DIR/crlf.txt" "$DIR/in.txt"
+[ "$(wc -c < "$DIR/crlf.txt")" -eq $((SIZE + LINES)) ]
+
+run convert-utf16 "$CLI" --convert-to=utf16le --output="$DIR/u16.txt" "$DIR/crlf.txt"
+[ "$(wc -c < "$DIR/u16.txt")" -eq $(( (SIZE + LINES) * 2 + 2 )) ]
+
+run back-to-utf8-lf "$CLI" --convert-to=utf8 --normalize-eol=lf --output="$DIR/back.txt" "$DIR/u16.txt"
+cmp "$DIR/in.txt" "$DIR/back.txt"
+
+echo "cli_throughput: ok"
@@ -0,0 +1,85 @@
+// CSV index driver for tests/csv_python.sh: indexes a file fed in random
+// chunk sizes, then either prints every field (unquoted, fields separated by
+// 0x1F and rows ended by 0x1E) or only the row and column counts
+// Usage: csv_dump FILE SEPARATOR [--count]
+
+#define _POSIX_C_SOURCE 200809L
+#include "check.h"
+#include "csv_index.h"
+#include "sys_thread.h"
+
+#include <string.h>
+#include <sys/types.h>
+
+#define WINDOW_ROWS 4096u
+#define MAX_FIELDS 1024u
+
+static size_t file_read(void *ctx, uint64_t offset, char *dst, size_t len) {
+    FILE *f = (FILE *)ctx;
+    if (fseeko(f, (off_t)offset, SEEK_SET) != 0) return 0;
+    return fread(dst, 1, len, f);
+}
+
+int main(int argc, char **argv) {
+    static char chunk[1 << 20];
+    static uint64_t offsets[WINDOW_ROWS + 1u];
+    static CsvField fields[MAX_FIELDS];
+    static char text[1 << 16];
+    CsvIndex idx;
+    uint64_t x = 88172645463325252ull;
+    size_t n;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s FILE SEPARATOR [--count]\n", argv[0]);
+        return 2;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    CHECK(f != NULL);
+    char sep = argv[2][0] == 't' ? '\t' : argv[2][0];
+    int count_only = argc > 3 && strcmp(argv[3], "--count") == 0;
+
+    csv_index_init(&idx, sep);
+    uint64_t started = sys_now_us();
+    for (;;) {
+        size_t want = sizeof(chunk);
+        if (!count_only) {
+            // Odd chunk sizes put chunk edges inside quotes and CRLF pairs.
+            x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+            want = 1u + (size_t)(x % (x & 1u ? 17u : sizeof(chunk)));
+        }
+        n = fread(chunk, 1, want, f);
+        if (n == 0) break;
+        CHECK(csv_index_feed(&idx, chunk, n));
+    }
+    CHECK(csv_index_finish(&idx));
+    uint64_t rows = csv_index_rows(&idx);
+    if (count_only) {
+        printf("rows %llu, columns %u, index %.1f KB, %.0f ms\n",
+            (unsigned long long)rows, csv_index_columns(&idx), (double)idx.count * 8.0 / 1024.0,
+            (double)(sys_now_us() - started) / 1000.0);
+        csv_index_free(&idx);
+        fclose(f);
+        return 0;
+    }
+
+    for (uint64_t first = 0; first < rows; first += WINDOW_ROWS) {
+        size_t got = csv_index_locate(&idx, first, WINDOW_ROWS, file_read, f, offsets);
+        CHECK(got == (rows - first < WINDOW_ROWS ? rows - first : WINDOW_ROWS));
+        for (size_t r = 0; r < got; r++) {
+            size_t len = (size_t)(offsets[r + 1u] - offsets[r]);
+            char *row = (char *)malloc(len ? len : 1u);
+            CHECK(row != NULL && file_read(f, offsets[r], row, len) == len);
+            size_t count = csv_split_row(row, len, sep, fields, MAX_FIELDS);
+            CHECK(count <= MAX_FIELDS);
+            for (size_t i = 0; i < count; i++) {
+                if (i > 0) putchar('\x1f');
+                fwrite(text, 1, csv_field_text(row, &fields[i], text, sizeof(text)), stdout);
+            }
+            putchar('\x1e');
+            free(row);
+        }
+    }
+    csv_index_free(&idx);
+    fclose(f);
+    return 0;
+}
@@ -0,0 +1,68 @@
+#!/bin/sh
+# CSV index against Python's csv module: field-by-field agreement on random
+# documents with quoted separators, doubled quotes and line breaks inside
+# fields, then indexing throughput on a large file next to csv.reader.
+# Usage: tests/csv_python.sh [MB]   (default 2048)
+set -e
+
+MB=${1:-2048}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+DUMP=./tests/csv_dump
+
+if ! command -v python3 > /dev/null; then
+    echo "csv_python: skipped, python3 not found"
+    exit 0
+fi
+
+python3 - "$DIR" "$DUMP" <<'PY'
+import csv, random, subprocess, sys
+random.seed(4)
+pieces = ['a', 'bc', ' ', '', '1.5', 'x y', ',', ';', '\t', '|', '"', '""', '\r\n', '\n', 'café']
+for n in range(300):
+    sep = ',;\t|'[n % 4]
+    path = '%s/%d.csv' % (sys.argv[1], n)
+    rows = []
+    for r in range(random.randrange(1, 40)):
+        rows.append([''.join(random.choice(pieces) for _ in range(random.randrange(0, 4)))
+                     for _ in range(random.randrange(1, 8))])
+    eol = '\r\n' if n % 3 == 0 else '\n'
+    with open(path, 'w', newline='', encoding='utf-8') as f:
+        csv.writer(f, delimiter=sep, lineterminator=eol,
+                   quoting=csv.QUOTE_ALL if n % 5 == 0 else csv.QUOTE_MINIMAL).writerows(rows)
+        if n % 2:
+            f.write('tail' + sep + 'no line break')
+
+    with open(path, newline='', encoding='utf-8') as f:
+        want = [row if row else [''] for row in csv.reader(f, delimiter=sep)]
+    out = subprocess.run([sys.argv[2], path, 't' if sep == '\t' else sep], check=True, stdout=subprocess.PIPE).stdout
+    got = [r.split('\x1f') for r in out.decode('utf-8').split('\x1e')[:-1]]
+    if got != want:
+        for i, (a, b) in enumerate(zip(got, want)):
+            if a != b:
+                sys.exit('%s row %d: got %r, csv module %r' % (path, i, a, b))
+        sys.exit('%s: %d rows, csv module %d' % (path, len(got), len(want)))
+PY
+echo "csv_python: 300 documents agree with the csv module"
+
+python3 - "$DIR/big.csv" "$MB" <<'PY'
+import sys
+line = '2026-10-18,"Smith, Jane",42,"said ""hi""\nthen left",3.14159,ok\n'
+block = line * (1048576 // len(line))
+with open(sys.argv[1], 'w', newline='') as f:
+    for _ in range(int(sys.argv[2])):
+        f.write(block)
+PY
+SIZE=$(wc -c < "$DIR/big.csv")
+start=$(date +%s%N)
+"$DUMP" "$DIR/big.csv" , --count > "$DIR/count.txt"
+end=$(date +%s%N)
+ms=$(( (end - start) / 1000000 + 1 ))
+echo "csv_index: $MB MB in $ms ms, $(( SIZE / 1048576 * 1000 / ms )) MB/s; $(cat "$DIR/count.txt")"
+start=$(date +%s%N)
+PYROWS=$(python3 -c "import csv,sys; print(sum(1 for _ in csv.reader(open(sys.argv[1], newline=''))))" "$DIR/big.csv")
+end=$(date +%s%N)
+ms=$(( (end - start) / 1000000 + 1 ))
+echo "python csv.reader: $MB MB in $ms ms, $(( SIZE / 1048576 * 1000 / ms )) MB/s; rows $PYROWS"
+grep -q "^rows $PYROWS," "$DIR/count.txt"
+echo "csv_python: ok"
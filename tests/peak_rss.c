@@ -0,0 +1,34 @@
+// Runs a command and fails when its peak resident set exceeds a limit
+// Usage: peak_rss LIMIT_KB COMMAND [ARGS...]
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s LIMIT_KB COMMAND [ARGS...]\n", argv[0]);
+        return 2;
+    }
+    long limit_kb = strtol(argv[1], NULL, 10);
+    pid_t child = fork();
+    if (child < 0) return 2;
+    if (child == 0) {
+        execvp(argv[2], argv + 2);
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage ru;
+    if (wait4(child, &status, 0, &ru) != child) return 2;
+    fprintf(stderr, "peak RSS %ld KB (limit %ld KB)\n", ru.ru_maxrss, limit_kb);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s failed\n", argv[2]);
+        return 1;
+    }
+    return ru.ru_maxrss > limit_kb ? 1 : 0;
+}
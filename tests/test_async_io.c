@@ -0,0 +1,77 @@
+// Async file I/O: every backend writes a file in uneven pieces, and every
+// backend reads it back whole and as a chunk stream
+
+#include "check.h"
+#include "async_io.h"
+
+#include <string.h>
+
+static unsigned char pattern(uint64_t at) {
+    return (unsigned char)((at * 2654435761u) >> 11);
+}
+
+int main(int argc, char **argv) {
+    const AioBackend backends[] = {AIO_BACKEND_URING, AIO_BACKEND_THREADS, AIO_BACKEND_SYNC, AIO_BACKEND_AUTO};
+    const uint64_t sizes[] = {0, 1, AIO_CHUNK, 7u * AIO_CHUNK + 12345u};
+    size_t nb = sizeof(backends) / sizeof(backends[0]);
+    char path[512];
+    unsigned char *piece = (unsigned char *)malloc(300000u);
+    unsigned char *buf = (unsigned char *)malloc(8u * AIO_CHUNK + 16u);
+    (void)argc;
+    CHECK(piece && buf);
+    snprintf(path, sizeof(path), "%s.bin", argv[0]);
+    srand(3);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        uint64_t size = sizes[s];
+        for (size_t w = 0; w < nb; w++) {
+            AioFile *out = aio_open(path, 1, backends[w]);
+            CHECK(out != NULL);
+            uint64_t at = 0;
+            while (at < size) {
+                size_t n = (size_t)rand() % 300000u;
+                if (n > size - at) n = (size_t)(size - at);
+                for (size_t i = 0; i < n; i++) piece[i] = pattern(at + i);
+                CHECK(aio_write(out, piece, n));
+                at += n;
+            }
+            CHECK(aio_close(out));
+
+            for (size_t r = 0; r < nb; r++) {
+                AioFile *in = aio_open(path, 0, backends[r]);
+                CHECK(in != NULL && aio_size(in) == size);
+                memset(buf, 0, (size_t)size + 16u);
+                // Asking for more than the file holds returns what is there.
+                CHECK(aio_read_all(in, buf, size + 16u) == size);
+                for (uint64_t i = 0; i < size; i++) CHECK(buf[i] == pattern(i));
+                CHECK(aio_close(in));
+
+                in = aio_open(path, 0, backends[r]);
+                CHECK(in != NULL);
+                const unsigned char *chunk;
+                size_t n;
+                uint64_t pos = 0;
+                while ((chunk = (const unsigned char *)aio_next(in, &n)) != NULL) {
+                    CHECK(n > 0 && n <= AIO_CHUNK);
+                    for (size_t i = 0; i < n; i++) CHECK(chunk[i] == pattern(pos + i));
+                    pos += n;
+                }
+                CHECK(pos == size && !aio_failed(in));
+                CHECK(aio_close(in));
+            }
+        }
+    }
+
+    // Closing a stream with reads still in flight.
+    AioFile *in = aio_open(path, 0, AIO_BACKEND_AUTO);
+    size_t n;
+    CHECK(in != NULL && aio_next(in, &n) != NULL);
+    aio_close(in);
+
+    remove(path);
+    CHECK(aio_open(path, 0, AIO_BACKEND_AUTO) == NULL);
+    free(piece);
+    free(buf);
+    printf("async_io: ok\n");
+    return 0;
+}
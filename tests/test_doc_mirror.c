@@ -0,0 +1,177 @@
+// Document mirror under concurrency: one writer applies random edits while
+// reader threads stream snapshots it published and compare them with the
+// copy of the text taken at the same moment
+// Usage: test_doc_mirror [edits]   (default 10000)
+
+#include "check.h"
+#include "doc_snapshot.h"
+#include "sys_thread.h"
+
+#include <string.h>
+
+#define SLOTS 8
+#define READERS 3
+#define MAX_INSERT 60000u
+
+typedef struct {
+    DocSnapshot *snap;
+    char *text;
+    size_t len;
+} Published;
+
+typedef struct {
+    SysThread thread;
+    unsigned seed;
+    long checks;
+} Reader;
+
+static Published g_slots[SLOTS];
+static SysMutex g_lock;
+static int g_stop = 0;
+
+static unsigned next_rand(unsigned *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+typedef struct {
+    const char *want;
+    size_t at;
+} Compare;
+
+static int compare(void *ctx, const char *data, size_t len) {
+    Compare *c = (Compare *)ctx;
+    CHECK(memcmp(c->want + c->at, data, len) == 0);
+    c->at += len;
+    return 1;
+}
+
+static int reader_main(void *arg) {
+    Reader *r = (Reader *)arg;
+    for (;;) {
+        Published p = {NULL, NULL, 0};
+        size_t slot = next_rand(&r->seed) % SLOTS;
+        sys_mutex_lock(&g_lock);
+        int stop = g_stop;
+        if (!stop && g_slots[slot].snap) {
+            p.snap = doc_snapshot_retain(g_slots[slot].snap);
+            p.len = g_slots[slot].len;
+            p.text = (char *)malloc(p.len + 1u);
+            CHECK(p.text != NULL);
+            memcpy(p.text, g_slots[slot].text, p.len);
+        }
+        sys_mutex_unlock(&g_lock);
+        if (stop) return 0;
+        if (!p.snap) continue;
+
+        // The writer keeps editing; the snapshot must not notice.
+        size_t offset = p.len ? next_rand(&r->seed) % p.len : 0;
+        size_t n = next_rand(&r->seed) % 100000u;
+        if (n > p.len - offset) n = p.len - offset;
+        Compare c = {p.text + offset, 0};
+        CHECK(doc_snapshot_length(p.snap) == p.len);
+        CHECK(doc_snapshot_serialize(p.snap, offset, n, compare, &c) == n);
+        CHECK(c.at == n);
+        doc_snapshot_release(p.snap);
+        free(p.text);
+        r->checks++;
+    }
+}
+
+static void publish(DocMirror *m, const char *ref, size_t len, size_t slot) {
+    Published p = {doc_mirror_snapshot(m), (char *)malloc(len + 1u), len};
+    CHECK(p.snap != NULL && p.text != NULL);
+    memcpy(p.text, ref, len);
+    sys_mutex_lock(&g_lock);
+    Published old = g_slots[slot];
+    g_slots[slot] = p;
+    sys_mutex_unlock(&g_lock);
+    doc_snapshot_release(old.snap);
+    free(old.text);
+}
+
+static void check_whole(DocMirror *m, const char *ref, size_t len, unsigned *seed) {
+    DocSnapshot *snap = doc_mirror_snapshot(m);
+    char *buf = (char *)malloc(len + 1u);
+    CHECK(snap != NULL && buf != NULL);
+    CHECK(doc_snapshot_read(snap, 0, buf, len) == len);
+    CHECK(memcmp(buf, ref, len) == 0);
+
+    size_t a = len ? next_rand(seed) % len : 0;
+    size_t n = next_rand(seed) % (len - a + 1u);
+    DocSnapshot *slice = doc_snapshot_slice(snap, a, n);
+    doc_snapshot_release(snap);
+    CHECK(slice != NULL && doc_snapshot_length(slice) == n);
+    CHECK(doc_snapshot_read(slice, 0, buf, n) == n);
+    CHECK(memcmp(buf, ref + a, n) == 0);
+    doc_snapshot_release(slice);
+    free(buf);
+}
+
+int main(int argc, char **argv) {
+    long edits = argc > 1 ? strtol(argv[1], NULL, 10) : 10000;
+    size_t len = 1u << 20;
+    size_t cap = 16u << 20;
+    unsigned seed = 2463534242u;
+    char *ref = (char *)malloc(cap);
+    char *insert = (char *)malloc(MAX_INSERT);
+    CHECK(ref != NULL && insert != NULL);
+    for (size_t i = 0; i < len; i++) ref[i] = "abcdefgh\n"[next_rand(&seed) % 9u];
+
+    CHECK(sys_mutex_init(&g_lock));
+    DocMirror *m = doc_mirror_create(ref, len);
+    CHECK(m != NULL);
+    Reader readers[READERS];
+    for (int i = 0; i < READERS; i++) {
+        readers[i].seed = 1u + (unsigned)i * 7919u;
+        readers[i].checks = 0;
+        CHECK(sys_thread_start(&readers[i].thread, reader_main, &readers[i]));
+    }
+
+    uint64_t started = sys_now_us();
+    for (long e = 0; e < edits; e++) {
+        // Mostly keystrokes, some block edits, a few large pastes and cuts.
+        unsigned kind = next_rand(&seed) % 100u;
+        unsigned span = kind < 80 ? 3u : kind < 95 ? 5000u : MAX_INSERT;
+        size_t offset = next_rand(&seed) % (len + 1u);
+        size_t del = next_rand(&seed) % span;
+        size_t n = next_rand(&seed) % span;
+        if (del > len - offset) del = len - offset;
+        if (len - del + n > cap) n = 0;
+        for (size_t i = 0; i < n; i++) insert[i] = (char)('A' + next_rand(&seed) % 26u);
+
+        CHECK(doc_mirror_replace(m, offset, del, insert, n));
+        memmove(ref + offset + n, ref + offset + del, len - offset - del);
+        memcpy(ref + offset, insert, n);
+        len = len - del + n;
+        CHECK(doc_mirror_length(m) == len);
+
+        if (e % 50 == 0) publish(m, ref, len, next_rand(&seed) % SLOTS);
+        if (e % 997 == 0) check_whole(m, ref, len, &seed);
+    }
+
+    sys_mutex_lock(&g_lock);
+    g_stop = 1;
+    sys_mutex_unlock(&g_lock);
+    long checks = 0;
+    for (int i = 0; i < READERS; i++) {
+        sys_thread_join(&readers[i].thread);
+        checks += readers[i].checks;
+    }
+    check_whole(m, ref, len, &seed);
+    printf("%ld edits, %ld snapshot reads by %d readers in %.1f s, %zu bytes at the end\n",
+        edits, checks, READERS, (double)(sys_now_us() - started) / 1e6, len);
+    CHECK(checks > 0);
+
+    for (int i = 0; i < SLOTS; i++) {
+        doc_snapshot_release(g_slots[i].snap);
+        free(g_slots[i].text);
+    }
+    doc_mirror_free(m);
+    sys_mutex_destroy(&g_lock);
+    free(insert);
+    free(ref);
+    return 0;
+}
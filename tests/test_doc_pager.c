@@ -0,0 +1,73 @@
+// Page budget: a document several times larger than the address space the
+// process is allowed (RLIMIT_AS) is appended under a 32 MB budget, read back
+// intact, and edited, with resident pages held to the budget throughout
+// Usage: test_doc_pager [document MB]   (default 512)
+
+#define _DEFAULT_SOURCE
+#include "check.h"
+#include "doc_pager.h"
+#include "doc_store.h"
+#include "sys_thread.h"
+
+#include <string.h>
+#include <sys/resource.h>
+
+#define BUDGET_MB 32u
+#define ADDRESS_SPACE_MB 160u
+
+static unsigned char pattern(uint64_t at) {
+    return (unsigned char)((at * 2654435761u) >> 13);
+}
+
+int main(int argc, char **argv) {
+    size_t doc_mb = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 512u;
+    uint64_t size = (uint64_t)doc_mb << 20;
+    size_t mb = 1u << 20;
+    struct rlimit limit;
+    DocStore s;
+    DocPagerStats st;
+
+    limit.rlim_cur = limit.rlim_max = (rlim_t)ADDRESS_SPACE_MB << 20;
+    CHECK(setrlimit(RLIMIT_AS, &limit) == 0);
+    doc_pager_set_budget((uint64_t)BUDGET_MB << 20);
+
+    char *buf = (char *)malloc(mb);
+    CHECK(buf != NULL);
+    doc_store_init(&s);
+    uint64_t started = sys_now_us();
+    for (uint64_t done = 0; done < size; done += mb) {
+        for (size_t i = 0; i < mb; i++) buf[i] = (char)pattern(done + i);
+        CHECK(doc_store_append(&s, buf, mb));
+    }
+    double append_s = (double)(sys_now_us() - started) / 1e6;
+    CHECK(doc_store_length(&s) == size);
+
+    // An edit in the middle pins and dirties spilled pages.
+    uint64_t middle = size / 2u + 777u;
+    memset(buf, '#', 4096);
+    CHECK(doc_store_insert(&s, middle, buf, 4096));
+    doc_store_erase(&s, middle, 4096);
+
+    started = sys_now_us();
+    for (uint64_t at = 0; at < size;) {
+        size_t got = doc_store_read(&s, at, buf, mb);
+        CHECK(got > 0);
+        for (size_t i = 0; i < got; i++) CHECK((unsigned char)buf[i] == pattern(at + i));
+        at += got;
+    }
+    double read_s = (double)(sys_now_us() - started) / 1e6;
+
+    doc_pager_stats(&st);
+    printf("doc_pager: %zu MB under a %u MB address space, budget %u MB: append %.0f MB/s, read %.0f MB/s, "
+        "peak resident %.1f MB, swap %.0f MB\n",
+        doc_mb, ADDRESS_SPACE_MB, BUDGET_MB, (double)doc_mb / append_s, (double)doc_mb / read_s,
+        (double)st.peak_resident / 1048576.0, (double)st.swap_size / 1048576.0);
+    // A few pages may be pinned over the budget while an operation runs.
+    CHECK(st.peak_resident <= ((uint64_t)BUDGET_MB << 20) + 16u * DOC_PAGE_SIZE);
+    CHECK(st.spill_failures == 0 && st.page_outs > 0 && st.page_ins > 0);
+
+    doc_store_free(&s);
+    free(buf);
+    printf("doc_pager: ok\n");
+    return 0;
+}
@@ -0,0 +1,98 @@
+// Snapshots: ranged reads, streaming serialization with early stops, and
+// slices (of slices) that outlive the snapshot they were cut from
+
+#include "check.h"
+#include "doc_snapshot.h"
+
+#include <string.h>
+
+typedef struct {
+    char *dst;
+    size_t at;
+    int calls;
+    int stop_after;         // refuse the call after this many, 0 for never
+} Collect;
+
+static int collect(void *ctx, const char *data, size_t len) {
+    Collect *c = (Collect *)ctx;
+    if (c->stop_after && c->calls == c->stop_after) return 0;
+    c->calls++;
+    CHECK(len > 0);
+    memcpy(c->dst + c->at, data, len);
+    c->at += len;
+    return 1;
+}
+
+static size_t clamp(size_t len, size_t offset, size_t n) {
+    if (offset >= len) return 0;
+    return n > len - offset ? len - offset : n;
+}
+
+static void check_serialize(const DocSnapshot *snap, const char *ref, size_t ref_len, char *tmp) {
+    size_t offset = ref_len ? (size_t)rand() % (ref_len + 1u) : 0;
+    size_t n = (size_t)rand() % 400000u;
+    size_t want = clamp(ref_len, offset, n);
+    Collect c = {tmp, 0, 0, 0};
+    CHECK(doc_snapshot_serialize(snap, offset, n, collect, &c) == want);
+    CHECK(c.at == want && memcmp(tmp, ref + offset, want) == 0);
+    CHECK(doc_snapshot_read(snap, offset, tmp, n) == want);
+    CHECK(memcmp(tmp, ref + offset, want) == 0);
+
+    // A sink that stops early gets whole pieces up to that point.
+    if (c.calls > 1) {
+        Collect stop = {tmp, 0, 0, 1 + rand() % (c.calls - 1)};
+        uint64_t got = doc_snapshot_serialize(snap, offset, n, collect, &stop);
+        CHECK(got == stop.at && got < want);
+        CHECK(memcmp(tmp, ref + offset, stop.at) == 0);
+    }
+}
+
+int main(void) {
+    char *tmp = (char *)malloc(1u << 20);
+    CHECK(tmp != NULL);
+    srand(7);
+
+    for (int t = 0; t < 200; t++) {
+        size_t len = t == 0 ? 0u : (size_t)rand() % 600000u;
+        char *src = (char *)malloc(len + 1u);
+        CHECK(src != NULL);
+        for (size_t i = 0; i < len; i++) src[i] = (char)rand();
+
+        DocSnapshot *snap = doc_snapshot_create(src, len);
+        CHECK(snap != NULL && doc_snapshot_length(snap) == len);
+        for (int k = 0; k < 10; k++) check_serialize(snap, src, len, tmp);
+
+        // A slice, then a slice of that, both used after the original is gone.
+        size_t a = len ? (size_t)rand() % (len + 1u) : 0;
+        size_t a_len = clamp(len, a, (size_t)rand() % 500000u);
+        DocSnapshot *slice = doc_snapshot_slice(snap, a, a_len);
+        CHECK(slice != NULL && doc_snapshot_length(slice) == a_len);
+        size_t b = a_len ? (size_t)rand() % (a_len + 1u) : 0;
+        size_t b_len = clamp(a_len, b, (size_t)rand() % 300000u);
+        DocSnapshot *inner = doc_snapshot_slice(slice, b, b_len);
+        CHECK(inner != NULL && doc_snapshot_length(inner) == b_len);
+
+        DocSnapshot *kept = doc_snapshot_retain(snap);
+        doc_snapshot_release(snap);
+        doc_snapshot_release(kept);
+        for (int k = 0; k < 5; k++) check_serialize(slice, src + a, a_len, tmp);
+        doc_snapshot_release(slice);
+        for (int k = 0; k < 5; k++) check_serialize(inner, src + a + b, b_len, tmp);
+        doc_snapshot_release(inner);
+        free(src);
+    }
+
+    // Ranges past the end deliver nothing.
+    DocSnapshot *snap = doc_snapshot_create("abc", 3);
+    Collect c = {tmp, 0, 0, 0};
+    CHECK(doc_snapshot_serialize(snap, 3, 10, collect, &c) == 0 && c.calls == 0);
+    CHECK(doc_snapshot_serialize(snap, 99, 10, collect, &c) == 0);
+    DocSnapshot *empty = doc_snapshot_slice(snap, 1, 0);
+    CHECK(empty != NULL && doc_snapshot_length(empty) == 0);
+    doc_snapshot_release(empty);
+    doc_snapshot_release(snap);
+
+    free(tmp);
+    printf("doc_snapshot: ok\n");
+    return 0;
+}
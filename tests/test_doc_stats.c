@@ -0,0 +1,121 @@
+// Document statistics: every way of cutting short documents into three
+// slices merges to the same counts as a byte-by-byte reference scan, and the
+// threaded scan of a large document agrees with it too
+
+#include "check.h"
+#include "doc_stats.h"
+
+#include <string.h>
+
+static void bucket(DocStats *r, uint64_t len) {
+    static const uint64_t floor[DOC_STATS_BUCKETS] = {0, 1, 16, 64, 128, 256, 1024, 65536};
+    unsigned b = DOC_STATS_BUCKETS - 1u;
+    while (b > 0 && len < floor[b]) b--;
+    r->histogram[b]++;
+    r->lines++;
+    if (len > r->longest) r->longest = len;
+}
+
+static void reference(DocStats *r, const unsigned char *p, size_t n, int utf8) {
+    size_t line_start = 0;
+    int in_word = 0;
+    doc_stats_init(r);
+    r->bytes = n;
+    for (size_t i = 0; i < n; i++) {
+        unsigned c = p[i];
+        int word = c != ' ' && (c < 9 || c > 13);
+        if (word && !in_word) r->words++;
+        in_word = word;
+        if (utf8) {
+            if ((c & 0xC0u) != 0x80u) r->code_points++;
+            if (c >= 0xC0u) r->non_ascii++;
+        } else {
+            r->code_points++;
+            if (c >= 0x80u) r->non_ascii++;
+        }
+        if (c == '\r' || c == '\n') {
+            uint64_t len = i - line_start;
+            if (c == '\r' && i + 1u < n && p[i + 1u] == '\n') {
+                r->crlf++;
+                r->code_points++;
+                i++;
+            } else if (c == '\r') {
+                r->lone_cr++;
+            } else {
+                r->lone_lf++;
+            }
+            bucket(r, len);
+            line_start = i + 1u;
+        }
+    }
+    if (n > 0) bucket(r, n - line_start);
+}
+
+static int same(const DocStats *a, const DocStats *b) {
+    return a->bytes == b->bytes && a->code_points == b->code_points && a->non_ascii == b->non_ascii &&
+           a->words == b->words && a->crlf == b->crlf && a->lone_lf == b->lone_lf && a->lone_cr == b->lone_cr &&
+           a->lines == b->lines && a->longest == b->longest &&
+           memcmp(a->histogram, b->histogram, sizeof(a->histogram)) == 0;
+}
+
+// Short runs of spaces, breaks, words and two-byte UTF-8, so cuts land
+// inside CRLF pairs, words and sequences.
+static void generate(unsigned char *p, size_t n) {
+    static const char alphabet[] = "ab \r\n\t";
+    for (size_t i = 0; i < n; i++) {
+        int r = rand() % 10;
+        p[i] = r < 6 ? (unsigned char)alphabet[rand() % 6] : r < 8 ? 0xC3 : r < 9 ? 0xA9 : 'x';
+    }
+}
+
+int main(void) {
+    unsigned char small[300];
+    srand(5);
+
+    for (int it = 0; it < 1500; it++) {
+        size_t n = (size_t)rand() % 200u;
+        int utf8 = it & 1;
+        DocStats want;
+        generate(small, n);
+        reference(&want, small, n, utf8);
+        for (size_t a = 0; a <= n; a++) {
+            size_t b = a + (n > a ? (size_t)rand() % (n - a + 1u) : 0u);
+            DocStats x, y, z, merged;
+            doc_stats_init(&x);
+            doc_stats_init(&y);
+            doc_stats_init(&z);
+            doc_stats_init(&merged);
+            doc_stats_scan(&x, (const char *)small, a, utf8);
+            doc_stats_scan(&y, (const char *)small + a, b - a, utf8);
+            doc_stats_scan(&z, (const char *)small + b, n - b, utf8);
+            doc_stats_merge(&merged, &x);
+            doc_stats_merge(&merged, &y);
+            doc_stats_merge(&merged, &z);
+            doc_stats_finish(&merged);
+            CHECK(same(&merged, &want));
+        }
+    }
+
+    // Threaded scans split at DOC_STATS_MIN_SLICE multiples, whatever the CPU count.
+    size_t n = 20u * DOC_STATS_MIN_SLICE + 4321u;
+    unsigned char *big = (unsigned char *)malloc(n);
+    CHECK(big != NULL);
+    generate(big, n);
+    for (int utf8 = 0; utf8 <= 1; utf8++) {
+        DocStats want, got;
+        reference(&want, big, n, utf8);
+        for (unsigned threads = 1; threads <= 16; threads *= 2) {
+            unsigned slices = doc_stats_compute(&got, (const char *)big, n, utf8, threads);
+            CHECK(slices >= 1 && slices <= threads);
+            CHECK(same(&got, &want));
+        }
+    }
+    free(big);
+
+    DocStats empty;
+    CHECK(doc_stats_compute(&empty, "", 0, 1, 4) >= 1);
+    CHECK(empty.bytes == 0 && empty.lines == 0 && empty.words == 0);
+
+    printf("doc_stats: ok\n");
+    return 0;
+}
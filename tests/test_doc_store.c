@@ -0,0 +1,107 @@
+// Chunked store: random inserts and erases against a flat reference, first
+// with unlimited memory and then with a budget small enough to spill pages
+
+#include "check.h"
+#include "doc_pager.h"
+#include "doc_store.h"
+
+#include <string.h>
+
+#define REF_CAP (6u * 1024u * 1024u)
+
+static void check_contents(DocStore *s, const char *ref, size_t ref_len, char *tmp) {
+    CHECK(doc_store_length(s) == ref_len);
+    CHECK(doc_store_read(s, 0, tmp, ref_len) == ref_len);
+    CHECK(memcmp(tmp, ref, ref_len) == 0);
+
+    // Reads that start and end inside chunks.
+    for (int r = 0; r < 20 && ref_len > 0; r++) {
+        size_t offset = (size_t)rand() % ref_len;
+        size_t n = (size_t)rand() % 200000u;
+        if (n > ref_len - offset) n = ref_len - offset;
+        CHECK(doc_store_read(s, offset, tmp, n) == n);
+        CHECK(memcmp(tmp, ref + offset, n) == 0);
+    }
+    CHECK(doc_store_read(s, ref_len, tmp, 10) == 0);
+
+    // Chunks are non-empty, bounded, add up, and pin to their bytes.
+    uint64_t total = 0;
+    for (size_t i = 0; i < doc_store_chunk_count(s); i++) {
+        size_t len = doc_store_chunk_len(s, i);
+        size_t pinned_len = 0;
+        CHECK(len > 0 && len <= DOC_CHUNK_SIZE);
+        const char *bytes = doc_store_pin_chunk(s, i, &pinned_len);
+        CHECK(bytes != NULL && pinned_len == len);
+        CHECK(memcmp(bytes, ref + total, len) == 0);
+        doc_store_unpin_chunk(s, i);
+        total += len;
+    }
+    CHECK(total == ref_len);
+}
+
+static void random_edits(unsigned seed, int iterations) {
+    char *ref = (char *)malloc(REF_CAP);
+    char *tmp = (char *)malloc(REF_CAP);
+    size_t ref_len = 0;
+    DocStore s;
+    CHECK(ref && tmp);
+    doc_store_init(&s);
+    srand(seed);
+
+    for (int it = 0; it < iterations; it++) {
+        int op = rand() % 3;
+        if (op < 2) {
+            // Mostly small inserts, sometimes several chunks' worth.
+            size_t n = rand() % 4 == 0 ? (size_t)rand() % 300000u : (size_t)rand() % 100u;
+            if (ref_len + n < REF_CAP) {
+                size_t offset = ref_len ? (size_t)rand() % (ref_len + 1u) : 0;
+                for (size_t i = 0; i < n; i++) tmp[i] = (char)('a' + rand() % 26);
+                if (op == 1 && offset == ref_len) {
+                    CHECK(doc_store_append(&s, tmp, n));
+                } else {
+                    CHECK(doc_store_insert(&s, offset, tmp, n));
+                }
+                memmove(ref + offset + n, ref + offset, ref_len - offset);
+                memcpy(ref + offset, tmp, n);
+                ref_len += n;
+            } else {
+                op = 2;
+            }
+        }
+        if (op == 2 && ref_len > 0) {
+            size_t offset = (size_t)rand() % ref_len;
+            size_t n = (size_t)rand() % (rand() % 4 == 0 ? 400000u : 200u);
+            if (n > ref_len - offset) n = ref_len - offset;
+            doc_store_erase(&s, offset, n);
+            memmove(ref + offset, ref + offset + n, ref_len - offset - n);
+            ref_len -= n;
+        }
+        CHECK(doc_store_length(&s) == ref_len);
+        if (it % 250 == 0 || it == iterations - 1) check_contents(&s, ref, ref_len, tmp);
+    }
+
+    // Erasing everything leaves an empty store that still takes inserts.
+    doc_store_erase(&s, 0, ref_len);
+    CHECK(doc_store_length(&s) == 0 && doc_store_chunk_count(&s) == 0);
+    CHECK(doc_store_insert(&s, 0, "x", 1) && doc_store_length(&s) == 1);
+
+    doc_store_free(&s);
+    free(ref);
+    free(tmp);
+}
+
+int main(void) {
+    random_edits(5, 3000);
+
+    // Under a 1 MB budget most chunks live in the swap file between uses.
+    doc_pager_set_budget(1024u * 1024u);
+    random_edits(6, 1500);
+    DocPagerStats stats;
+    doc_pager_stats(&stats);
+    CHECK(stats.page_outs > 0 && stats.page_ins > 0);
+    CHECK(stats.spill_failures == 0);
+    doc_pager_set_budget(0);
+
+    printf("doc_store: ok\n");
+    return 0;
+}
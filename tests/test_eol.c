@@ -0,0 +1,159 @@
+// Line-ending kernels against a byte-at-a-time reference, with the input cut
+// into chunks everywhere, lone CRs and LFs at chunk edges included
+
+#include "check.h"
+#include "eol.h"
+
+#include <string.h>
+
+static size_t ref_to_crlf(const char *s, size_t n, char *d) {
+    size_t o = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == '\r' || s[i] == '\n') {
+            d[o++] = '\r';
+            d[o++] = '\n';
+            if (s[i] == '\r' && i + 1u < n && s[i + 1] == '\n') i++;
+        } else {
+            d[o++] = s[i];
+        }
+    }
+    return o;
+}
+
+static size_t ref_from_crlf(const char *s, size_t n, char *d, char eol) {
+    size_t o = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == '\r' && i + 1u < n && s[i + 1] == '\n') {
+            d[o++] = eol;
+            i++;
+        } else {
+            d[o++] = s[i];
+        }
+    }
+    return o;
+}
+
+// Runs every kernel over `s` cut at the given chunk boundaries and compares
+// with the reference. `cuts` are ascending positions inside (0, n).
+static void check_chunks(const char *s, size_t n, const size_t *cuts, size_t cut_count) {
+    char *ref = (char *)malloc(2u * n + 2u);
+    char *out = (char *)malloc(2u * n + 2u);
+    size_t ref_len;
+    size_t out_len = 0;
+    int after_cr = 0;
+    EolScan scan;
+    CHECK(ref && out);
+
+    // To CRLF, and the scan that sizes it.
+    eol_scan_init(&scan);
+    for (size_t c = 0, at = 0; c <= cut_count; c++) {
+        size_t end = c < cut_count ? cuts[c] : n;
+        out_len += eol_to_crlf(s + at, end - at, out + out_len, &after_cr);
+        eol_scan_update(&scan, s + at, end - at);
+        at = end;
+    }
+    ref_len = ref_to_crlf(s, n, ref);
+    CHECK(out_len == ref_len && memcmp(out, ref, ref_len) == 0);
+    CHECK(eol_scan_crlf_size(&scan, n) == ref_len);
+
+    uint64_t cr = 0;
+    uint64_t lf = 0;
+    uint64_t crlf = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == '\r') cr++;
+        if (s[i] == '\n') lf++;
+        if (s[i] == '\r' && i + 1u < n && s[i + 1] == '\n') crlf++;
+    }
+    CHECK(scan.cr == cr && scan.lf == lf && scan.crlf == crlf);
+    CHECK(eol_scan_crlf(&scan) == crlf);
+    CHECK(eol_scan_lone_cr(&scan) == cr - crlf && eol_scan_lone_lf(&scan) == lf - crlf);
+    CHECK(eol_scan_is_mixed(&scan) == ((crlf > 0) + (cr > crlf) + (lf > crlf) > 1));
+
+    // From CRLF to LF and to CR.
+    for (int t = 0; t < 2; t++) {
+        TextEol target = t ? TEXT_EOL_CR : TEXT_EOL_LF;
+        int pending_cr = 0;
+        out_len = 0;
+        for (size_t c = 0, at = 0; c <= cut_count; c++) {
+            size_t end = c < cut_count ? cuts[c] : n;
+            out_len += eol_from_crlf(s + at, end - at, out + out_len, target, &pending_cr);
+            at = end;
+        }
+        out_len += eol_from_crlf_finish(out + out_len, &pending_cr);
+        ref_len = ref_from_crlf(s, n, ref, t ? '\r' : '\n');
+        CHECK(out_len == ref_len && memcmp(out, ref, ref_len) == 0);
+    }
+    free(ref);
+    free(out);
+}
+
+// Every single cut and every pair of cuts.
+static void check_all_splits(const char *s) {
+    size_t n = strlen(s);
+    size_t cuts[2];
+    check_chunks(s, n, cuts, 0);
+    for (size_t a = 1; a < n; a++) {
+        cuts[0] = a;
+        check_chunks(s, n, cuts, 1);
+        for (size_t b = a + 1u; b < n; b++) {
+            cuts[1] = b;
+            check_chunks(s, n, cuts, 2);
+        }
+    }
+}
+
+int main(void) {
+    // Pathological inputs around the 16-byte block width.
+    static const char *cases[] = {
+        "\r",
+        "\n",
+        "\r\n",
+        "\n\r",
+        "\r\r\r\n\n\n",
+        "abcdefghijklmno\r\nabcdefghijklmn\r\r\n",
+        "0123456789abcde\r",
+        "0123456789abcdef\r\n0123456789abcdef\n\r",
+        "\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r",
+        "lone\rcr\rs and lone\nlfs\nand crlf\r\n mixed over three blocks\r",
+        "________________________________\r",
+        "\r_______________________________\n",
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) check_all_splits(cases[i]);
+
+    // Random text, dense or sparse in line breaks, in random chunks.
+    static const char alphabet[] = "ab\r\n";
+    size_t cuts[64];
+    srand(3);
+    for (int it = 0; it < 20000; it++) {
+        size_t n = (size_t)rand() % 400u;
+        char *s = (char *)malloc(n + 1u);
+        size_t cut_count = 0;
+        int sparse = it % 3 == 0;
+        CHECK(s != NULL);
+        for (size_t i = 0; i < n; i++) s[i] = sparse && rand() % 10 ? 'x' : alphabet[rand() % 4];
+        for (size_t at = 0; cut_count < 64u;) {
+            at += 1u + (size_t)rand() % 40u;
+            if (at >= n) break;
+            cuts[cut_count++] = at;
+        }
+        check_chunks(s, n, cuts, cut_count);
+        free(s);
+    }
+
+    // Dominant style, with CRLF winning ties and text without breaks.
+    {
+        EolScan scan;
+        eol_scan_init(&scan);
+        CHECK(eol_scan_dominant(&scan) == TEXT_EOL_CRLF);
+        eol_scan_update(&scan, "a\nb\nc\r\n", 7);
+        CHECK(eol_scan_dominant(&scan) == TEXT_EOL_LF && eol_scan_is_mixed(&scan));
+        eol_scan_update(&scan, "\r", 1);
+        eol_scan_update(&scan, "\n", 1);
+        CHECK(eol_scan_dominant(&scan) == TEXT_EOL_CRLF);
+        eol_scan_update(&scan, "\r\r\r", 3);
+        CHECK(eol_scan_dominant(&scan) == TEXT_EOL_CR);
+    }
+
+    printf("eol: ok\n");
+    return 0;
+}
@@ -0,0 +1,246 @@
+// gzip reader: round trips through the store-only writer and through the
+// system gzip (two members), seeks back and forth through the checkpoint
+// index, the part-by-part reading the editor does for oversized files, and
+// damaged or truncated input
+
+#define _POSIX_C_SOURCE 200809L
+#include "check.h"
+#include "gzip.h"
+
+#include <string.h>
+
+#define SPAN (256u * 1024u)
+
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t pos;
+    size_t cap;
+} Buffer;
+
+static size_t buffer_read(void *ctx, unsigned char *buf, size_t cap) {
+    Buffer *b = (Buffer *)ctx;
+    size_t n = b->len - b->pos < cap ? b->len - b->pos : cap;
+    memcpy(buf, b->data + b->pos, n);
+    b->pos += n;
+    return n;
+}
+
+static int buffer_seek(void *ctx, uint64_t offset) {
+    Buffer *b = (Buffer *)ctx;
+    if (offset > b->len) return 0;
+    b->pos = (size_t)offset;
+    return 1;
+}
+
+static int buffer_sink(void *ctx, const void *data, size_t len) {
+    Buffer *b = (Buffer *)ctx;
+    if (b->len + len > b->cap) {
+        b->cap = (b->len + len) * 2u;
+        b->data = (unsigned char *)realloc(b->data, b->cap);
+        CHECK(b->data != NULL);
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    return 1;
+}
+
+static unsigned next_rand(unsigned *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static char *make_log(size_t size, unsigned seed) {
+    static const char *words[] = {"error", "warn", "info", "GET /index.html", "200", "404", "user=42", "timeout", "ms"};
+    char *text = (char *)malloc(size + 1u);
+    size_t at = 0;
+    CHECK(text != NULL);
+    while (at < size) {
+        char line[256];
+        int n = snprintf(line, sizeof(line), "2026-10-18 12:%02u:%02u", next_rand(&seed) % 60u, next_rand(&seed) % 60u);
+        for (unsigned w = 3u + next_rand(&seed) % 9u; w > 0; w--) {
+            n += snprintf(line + n, sizeof(line) - (size_t)n, " %s", words[next_rand(&seed) % 9u]);
+        }
+        line[n++] = '\n';
+        if ((size_t)n > size - at) n = (int)(size - at);
+        memcpy(text + at, line, (size_t)n);
+        at += (size_t)n;
+    }
+    return text;
+}
+
+static void read_exact(GzReader *r, unsigned char *dst, size_t len) {
+    size_t got = 0, n;
+    while (got < len && (n = gz_reader_read(r, dst + got, len - got)) > 0) got += n;
+    CHECK(got == len);
+}
+
+static void check_stream(GzReader *r, const char *text, size_t len) {
+    unsigned char *buf = (unsigned char *)malloc(65536u);
+    size_t out = 0, n;
+    CHECK(buf != NULL);
+    while ((n = gz_reader_read(r, buf, 65536u)) > 0) {
+        CHECK(out + n <= len && memcmp(buf, text + out, n) == 0);
+        out += n;
+    }
+    CHECK(out == len && gz_reader_error(r) == NULL);
+    CHECK(gz_reader_tell(r) == len);
+    free(buf);
+}
+
+// Random seeks both ways, then the editor's pattern: the whole stream once,
+// then fixed-size parts in any order through the index.
+static void check_seeks(GzReader *r, const char *text, size_t len, unsigned seed) {
+    unsigned char buf[4096];
+    for (int k = 0; k < 300; k++) {
+        uint64_t offset = next_rand(&seed) % (len + 1u);
+        size_t want = len - offset < sizeof(buf) ? (size_t)(len - offset) : sizeof(buf);
+        CHECK(gz_reader_seek(r, offset));
+        CHECK(gz_reader_tell(r) == offset);
+        read_exact(r, buf, want);
+        CHECK(memcmp(buf, text + offset, want) == 0);
+    }
+    CHECK(gz_reader_seek(r, len));
+    CHECK(gz_reader_read(r, buf, sizeof(buf)) == 0 && gz_reader_error(r) == NULL);
+    CHECK(!gz_reader_seek(r, len + 1u));
+
+    size_t part = len / 5u + 1u;
+    unsigned char *chunk = (unsigned char *)malloc(part);
+    CHECK(chunk != NULL);
+    for (int k = 0; k < 10; k++) {
+        size_t start = (size_t)(next_rand(&seed) % 5u) * part;
+        if (start > len) start = len;
+        size_t n = len - start < part ? len - start : part;
+        CHECK(gz_reader_seek(r, start));
+        read_exact(r, chunk, n);
+        CHECK(memcmp(chunk, text + start, n) == 0);
+    }
+    free(chunk);
+}
+
+static void test_stored_round_trip(void) {
+    static const size_t sizes[] = {0, 1, GZ_STORED_BLOCK - 1u, GZ_STORED_BLOCK, GZ_STORED_BLOCK + 1u, 3u << 20};
+    static GzWriter w;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char *text = make_log(sizes[i], 11u + (unsigned)i);
+        Buffer gz = {0};
+        CHECK(gz_writer_init(&w, buffer_sink, &gz));
+        // Uneven writes, so blocks fill across calls.
+        for (size_t at = 0; at < sizes[i];) {
+            size_t n = sizes[i] - at < 7777u ? sizes[i] - at : 7777u;
+            CHECK(gz_writer_write(&w, text + at, n));
+            at += n;
+        }
+        CHECK(gz_writer_finish(&w));
+        CHECK(gz_is_gzip(gz.data, gz.len));
+
+        GzReader *r = gz_reader_open(buffer_read, buffer_seek, &gz, SPAN);
+        CHECK(r != NULL);
+        check_stream(r, text, sizes[i]);
+        if (sizes[i] > 0) check_seeks(r, text, sizes[i], 5u);
+        gz_reader_close(r);
+        free(gz.data);
+        free(text);
+    }
+}
+
+static int load_file(const char *path, Buffer *b) {
+    FILE *f = fopen(path, "rb");
+    unsigned char buf[65536];
+    size_t n;
+    if (!f) return 0;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) buffer_sink(b, buf, n);
+    fclose(f);
+    return 1;
+}
+
+// Two members written by the system gzip, as `cat a.gz b.gz` gives.
+static void test_deflate_members(const char *self) {
+    size_t first = 5u << 20, second = 3u << 20;
+    char *text = make_log(first + second, 99u);
+    char path[512], cmd[1200];
+    Buffer gz = {0};
+
+    for (int m = 0; m < 2; m++) {
+        snprintf(path, sizeof(path), "%s.%d.log", self, m);
+        FILE *f = fopen(path, "wb");
+        CHECK(f != NULL);
+        CHECK(fwrite(text + (m ? first : 0), 1, m ? second : first, f) == (m ? second : first));
+        CHECK(fclose(f) == 0);
+        snprintf(cmd, sizeof(cmd), "gzip -6 -f '%s'", path);
+        if (system(cmd) != 0) {
+            printf("gzip: deflate cases skipped, the gzip command is not available\n");
+            remove(path);
+            free(gz.data);
+            free(text);
+            return;
+        }
+        snprintf(path, sizeof(path), "%s.%d.log.gz", self, m);
+        CHECK(load_file(path, &gz));
+        remove(path);
+    }
+
+    GzReader *r = gz_reader_open(buffer_read, buffer_seek, &gz, SPAN);
+    CHECK(r != NULL);
+    check_stream(r, text, first + second);
+    // Checkpoints land on block starts, so there are fewer than one per span.
+    CHECK(gz_reader_checkpoints(r) >= (first + second) / SPAN / 4u);
+    check_seeks(r, text, first + second, 3u);
+    gz_reader_close(r);
+
+    // A forward-only reader decodes the same but cannot go back.
+    {
+        unsigned char buf[64];
+        gz.pos = 0;
+        r = gz_reader_open(buffer_read, NULL, &gz, SPAN);
+        CHECK(r != NULL);
+        CHECK(gz_reader_seek(r, first + 100u));
+        read_exact(r, buf, sizeof(buf));
+        CHECK(memcmp(buf, text + first + 100u, sizeof(buf)) == 0);
+        CHECK(!gz_reader_seek(r, 10u));
+        gz_reader_close(r);
+    }
+
+    // A flipped byte in the first member's deflate data is reported, by the
+    // decoder or by the member's CRC.
+    static const size_t flips[] = {4096u, 100000u};
+    for (size_t i = 0; i < sizeof(flips) / sizeof(flips[0]); i++) {
+        unsigned char buf[65536];
+        gz.data[flips[i]] ^= 0x10;
+        gz.pos = 0;
+        r = gz_reader_open(buffer_read, buffer_seek, &gz, SPAN);
+        CHECK(r != NULL);
+        while (gz_reader_read(r, buf, sizeof(buf)) > 0) {
+        }
+        CHECK(gz_reader_error(r) != NULL);
+        gz_reader_close(r);
+        gz.data[flips[i]] ^= 0x10;
+    }
+
+    // Cut inside the second member.
+    gz.len -= 1000u;
+    gz.pos = 0;
+    r = gz_reader_open(buffer_read, buffer_seek, &gz, SPAN);
+    CHECK(r != NULL);
+    {
+        unsigned char buf[65536];
+        while (gz_reader_read(r, buf, sizeof(buf)) > 0) {
+        }
+        CHECK(gz_reader_error(r) != NULL);
+        CHECK(gz_reader_tell(r) < first + second);
+    }
+    gz_reader_close(r);
+
+    free(gz.data);
+    free(text);
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    test_stored_round_trip();
+    test_deflate_members(argv[0]);
+    printf("gzip: ok\n");
+    return 0;
+}
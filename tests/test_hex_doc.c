@@ -0,0 +1,127 @@
+// Hex view document: paging through more pages than the LRU holds, the patch
+// overlay, write-back through a short-lived write handle, and a file that
+// another writer changes while it is open
+
+#include "check.h"
+#include "hex_doc.h"
+
+#include <string.h>
+#include <sys/stat.h>
+
+#define PAGES 13u   // more than HEX_PAGE_SLOTS, last page partial
+
+static unsigned char model[PAGES * HEX_PAGE_SIZE];
+
+static unsigned char pattern(uint64_t at) {
+    return (unsigned char)((at * 2654435761u) >> 13);
+}
+
+static unsigned char file_byte(const char *path, uint64_t at) {
+    FILE *f = fopen(path, "rb");
+    CHECK(f != NULL && fseek(f, (long)at, SEEK_SET) == 0);
+    int c = fgetc(f);
+    fclose(f);
+    CHECK(c != EOF);
+    return (unsigned char)c;
+}
+
+int main(int argc, char **argv) {
+    char path[512];
+    unsigned char buf[3 * HEX_PAGE_SIZE];
+    uint64_t size = (uint64_t)PAGES * HEX_PAGE_SIZE - 777u;
+    (void)argc;
+    snprintf(path, sizeof(path), "%s.bin", argv[0]);
+    for (uint64_t i = 0; i < size; i++) model[i] = pattern(i);
+    FILE *f = fopen(path, "wb");
+    CHECK(f != NULL && fwrite(model, 1, (size_t)size, f) == size && fclose(f) == 0);
+    srand(11);
+
+    HexDoc *doc = hex_doc_open(path);
+    CHECK(doc != NULL && hex_doc_size(doc) == size && hex_doc_writable(doc));
+
+    // Random reads, some spanning page boundaries, keep evicting pages.
+    for (int k = 0; k < 1000; k++) {
+        uint64_t at = ((uint64_t)rand() * 7919u) % (size + 10u);
+        size_t len = (size_t)rand() % sizeof(buf);
+        if (k % 3 == 0) at = ((uint64_t)(rand() % PAGES) + 1u) * HEX_PAGE_SIZE - (uint64_t)(rand() % 64);
+        size_t want = at >= size ? 0 : (size_t)(size - at < len ? size - at : len);
+        CHECK(hex_doc_read(doc, at, buf, len) == want);
+        CHECK(memcmp(buf, model + at, want) == 0);
+    }
+
+    // Patches overlay reads, including a rewritten byte and the last byte.
+    for (int k = 0; k < 5000; k++) {
+        uint64_t at = k < 300 ? size - 1u - (uint64_t)k : ((uint64_t)rand() * 7919u) % size;
+        unsigned char v = (unsigned char)rand();
+        CHECK(hex_doc_set_byte(doc, at, v));
+        model[at] = v;
+    }
+    CHECK(!hex_doc_set_byte(doc, size, 1));
+    CHECK(hex_doc_is_patched(doc, size - 1u));
+    size_t patches = hex_doc_patch_count(doc);
+    CHECK(patches > 4000 && patches <= 5000);
+    for (int k = 0; k < 500; k++) {
+        uint64_t at = ((uint64_t)rand() * 7919u) % size;
+        size_t got = hex_doc_read(doc, at, buf, 70000u);
+        CHECK(memcmp(buf, model + at, got) == 0);
+    }
+    // Nothing reaches the file before write-back.
+    CHECK(file_byte(path, size - 1u) == pattern(size - 1u));
+
+    CHECK(hex_doc_write_back(doc));
+    CHECK(hex_doc_patch_count(doc) == 0);
+    for (int k = 0; k < 300; k++) {
+        uint64_t at = k < 100 ? size - 1u - (uint64_t)k : ((uint64_t)rand() * 7919u) % size;
+        CHECK(file_byte(path, at) == model[at]);
+        CHECK(hex_doc_read(doc, at, buf, 1) == 1 && buf[0] == model[at]);
+    }
+
+    // The document only holds a read handle, so another writer can still
+    // change the file, and the shared mappings show it.
+    FILE *other = fopen(path, "r+b");
+    CHECK(other != NULL && fseek(other, 4096, SEEK_SET) == 0);
+    CHECK(fputc(0x5A, other) != EOF && fclose(other) == 0);
+    model[4096] = 0x5A;
+    CHECK(hex_doc_read(doc, 4000, buf, 200) == 200 && memcmp(buf, model + 4000, 200) == 0);
+    hex_doc_close(doc);
+
+    // A read-only file opens for viewing; write-back fails and keeps the patches.
+    CHECK(chmod(path, 0444) == 0);
+    doc = hex_doc_open(path);
+    CHECK(doc != NULL);
+    if (!hex_doc_writable(doc)) {   // root can write anyway
+        CHECK(hex_doc_set_byte(doc, 10, 1));
+        CHECK(!hex_doc_write_back(doc) && hex_doc_patch_count(doc) == 1);
+        hex_doc_discard(doc);
+        CHECK(hex_doc_patch_count(doc) == 0);
+    }
+    hex_doc_close(doc);
+    chmod(path, 0644);
+
+    // Empty files open with no pages.
+    f = fopen(path, "wb");
+    CHECK(f != NULL && fclose(f) == 0);
+    doc = hex_doc_open(path);
+    CHECK(doc != NULL && hex_doc_size(doc) == 0 && hex_doc_read(doc, 0, buf, 16) == 0);
+    CHECK(!hex_doc_set_byte(doc, 0, 1) && hex_doc_write_back(doc));
+    hex_doc_close(doc);
+    remove(path);
+    CHECK(hex_doc_open(path) == NULL);
+
+    char row[HEX_ROW_TEXT];
+    const unsigned char hello[] = "Hello\n";
+    size_t n = hex_format_row(0x1230, hello, 6, row);
+    CHECK(n == strlen(row) && n < HEX_ROW_TEXT);
+    CHECK(strncmp(row, "0000000000001230  48 65 6c 6c 6f 0a", 35) == 0);
+    CHECK(strcmp(row + n - 8, "|Hello.|") == 0);
+
+    const unsigned char elf[] = {0x7F, 'E', 'L', 'F', 0, 1};
+    const unsigned char text[] = "hello\r\nworld\t";
+    const unsigned char utf16[] = {0xFF, 0xFE, 'a', 0};
+    CHECK(hex_looks_binary(elf, sizeof(elf)));
+    CHECK(!hex_looks_binary(text, sizeof(text) - 1u));
+    CHECK(!hex_looks_binary(utf16, sizeof(utf16)));
+
+    printf("hex_doc: ok\n");
+    return 0;
+}
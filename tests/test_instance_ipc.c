@@ -0,0 +1,119 @@
+// Single-instance channel: claiming the name, request contents, a burst of
+// concurrent launches with their latency, oversized requests and a channel
+// left behind by a crashed instance
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "check.h"
+#include "instance_ipc.h"
+#include "sys_thread.h"
+
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define BURST_THREADS 8
+#define BURST_REQUESTS 50
+
+static SysMutex g_lock;
+static int g_received;
+static int g_mismatched;
+static char g_name[64];
+
+static void on_request(void *ctx, const char *cwd, const char *cmdline) {
+    (void)ctx;
+    sys_mutex_lock(&g_lock);
+    g_received++;
+    if (strcmp(cwd, "/work dir") != 0 || strncmp(cmdline, "--read-only \"file ", 18) != 0) g_mismatched++;
+    sys_mutex_unlock(&g_lock);
+}
+
+typedef struct {
+    SysThread thread;
+    int index;
+    int acked;
+    uint64_t latency_us[BURST_REQUESTS];
+} Client;
+
+static int client_main(void *arg) {
+    Client *c = (Client *)arg;
+    char cmdline[64];
+    for (int i = 0; i < BURST_REQUESTS; i++) {
+        snprintf(cmdline, sizeof(cmdline), "--read-only \"file %d-%d.txt\"", c->index, i);
+        uint64_t started = sys_now_us();
+        c->acked += instance_send(g_name, "/work dir", cmdline, 2000);
+        c->latency_us[i] = sys_now_us() - started;
+    }
+    return 0;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+int main(void) {
+    snprintf(g_name, sizeof(g_name), "editor-test-%ld", (long)getpid());
+    sys_mutex_init(&g_lock);
+
+    // Nobody listening yet.
+    CHECK(!instance_send(g_name, "/", "x", 200));
+
+    InstanceServer *server = instance_server_start(g_name, on_request, NULL);
+    CHECK(server != NULL);
+    CHECK(instance_server_start(g_name, on_request, NULL) == NULL);
+
+    // A burst of launches from several threads at once.
+    static Client clients[BURST_THREADS];
+    uint64_t started = sys_now_us();
+    for (int t = 0; t < BURST_THREADS; t++) {
+        clients[t].index = t;
+        CHECK(sys_thread_start(&clients[t].thread, client_main, &clients[t]));
+    }
+    static uint64_t all[BURST_THREADS * BURST_REQUESTS];
+    int acked = 0;
+    for (int t = 0; t < BURST_THREADS; t++) {
+        sys_thread_join(&clients[t].thread);
+        acked += clients[t].acked;
+        memcpy(all + t * BURST_REQUESTS, clients[t].latency_us, sizeof(clients[t].latency_us));
+    }
+    uint64_t elapsed = sys_now_us() - started;
+    CHECK(acked == BURST_THREADS * BURST_REQUESTS);
+    CHECK(g_received == acked && g_mismatched == 0);
+    qsort(all, BURST_THREADS * BURST_REQUESTS, sizeof(all[0]), compare_u64);
+    printf("instance_ipc: %d requests from %d threads in %.1f ms; latency median %llu us, p99 %llu us, max %llu us\n",
+        acked, BURST_THREADS, (double)elapsed / 1000.0,
+        (unsigned long long)all[acked / 2], (unsigned long long)all[acked * 99 / 100], (unsigned long long)all[acked - 1]);
+    CHECK(all[acked - 1] < 2000000u);
+
+    // Oversized requests are refused by the sender.
+    char *big = (char *)malloc(INSTANCE_IPC_MAX_PAYLOAD + 1u);
+    CHECK(big != NULL);
+    memset(big, 'x', INSTANCE_IPC_MAX_PAYLOAD);
+    big[INSTANCE_IPC_MAX_PAYLOAD] = '\0';
+    CHECK(!instance_send(g_name, "/", big, 500));
+    free(big);
+    CHECK(g_received == acked);
+
+    instance_server_stop(server);
+    CHECK(!instance_send(g_name, "/", "x", 200));
+
+    // A crashed instance leaves its channel behind; the next one takes over.
+    pid_t child = fork();
+    CHECK(child >= 0);
+    if (child == 0) {
+        _exit(instance_server_start(g_name, on_request, NULL) ? 0 : 1);
+    }
+    int status = 0;
+    CHECK(waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    CHECK(!instance_send(g_name, "/", "x", 200));
+    server = instance_server_start(g_name, on_request, NULL);
+    CHECK(server != NULL);
+    CHECK(instance_send(g_name, "/work dir", "--read-only \"file last\"", 2000));
+    instance_server_stop(server);
+
+    sys_mutex_destroy(&g_lock);
+    printf("instance_ipc: ok\n");
+    return 0;
+}
@@ -0,0 +1,328 @@
+// Edit journal: replay against a model, torn tails, corrupt payload lengths,
+// divergence, resume, compaction and a control recreate mid-session
+
+#include "check.h"
+#include "crc32.h"
+#include "doc_store.h"
+#include "journal.h"
+
+#include <string.h>
+#include <sys/resource.h>
+
+static char g_path[512];
+static char g_copy[512];
+
+typedef struct {
+    char *text;
+    size_t len;
+    size_t cap;
+} Model;
+
+static void model_replace(Model *m, size_t offset, size_t del, const char *ins, size_t ins_len) {
+    if (m->len - del + ins_len > m->cap) {
+        m->cap = (m->len - del + ins_len) * 2u + 64u;
+        m->text = (char *)realloc(m->text, m->cap);
+        CHECK(m->text != NULL);
+    }
+    memmove(m->text + offset + ins_len, m->text + offset + del, m->len - offset - del);
+    memcpy(m->text + offset, ins, ins_len);
+    m->len = m->len - del + ins_len;
+}
+
+static uint64_t file_size(const char *path) {
+    FILE *f = fopen(path, "rb");
+    uint64_t size = 0;
+    char buf[4096];
+    size_t n;
+    CHECK(f != NULL);
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) size += n;
+    fclose(f);
+    return size;
+}
+
+// Writes the first `n` bytes of `src` to `dst`, as a crash mid-write would
+// leave them; `flip` >= 0 also corrupts that byte.
+static void copy_prefix(const char *src, const char *dst, uint64_t n, int64_t flip) {
+    FILE *in = fopen(src, "rb");
+    FILE *out = fopen(dst, "wb");
+    CHECK(in && out);
+    for (uint64_t i = 0; i < n; i++) {
+        int c = fgetc(in);
+        CHECK(c != EOF);
+        if ((int64_t)i == flip) c ^= 0x40;
+        fputc(c, out);
+    }
+    fclose(in);
+    fclose(out);
+}
+
+static void check_replay(const char *path, const char *base, const Model *m, uint64_t records) {
+    char *out = NULL;
+    size_t out_len = 0;
+    JournalInfo info;
+    CHECK(journal_replay(path, base, strlen(base), &out, &out_len, &info) == JOURNAL_OK);
+    CHECK(info.records == records);
+    CHECK(out_len == m->len && memcmp(out, m->text, m->len) == 0);
+    CHECK(out[out_len] == '\0');
+    free(out);
+}
+
+static void test_random_edits(void) {
+    const char *base = "hello world\r\nsecond line\r\n";
+    uint32_t crc = crc32_update(0, base, strlen(base));
+    Model m = {0};
+    JournalWriter *w = journal_create(g_path, strlen(base), crc, 5);
+    CHECK(w != NULL);
+    model_replace(&m, 0, 0, base, strlen(base));
+
+    srand(7);
+    for (int i = 0; i < 5000; i++) {
+        char ins[8];
+        size_t offset = (size_t)rand() % (m.len + 1u);
+        size_t del = (size_t)rand() % 4u;
+        size_t ins_len = (size_t)rand() % 5u;
+        if (del > m.len - offset) del = m.len - offset;
+        for (size_t k = 0; k < ins_len; k++) ins[k] = (char)('a' + rand() % 26);
+        model_replace(&m, offset, del, ins, ins_len);
+        CHECK(journal_append(w, offset, del, ins, ins_len, m.len));
+    }
+    CHECK(journal_flush(w));
+    CHECK(journal_pending_edits(w) == 5000);
+    journal_close(w, 0);
+    check_replay(g_path, base, &m, 5000);
+
+    // The wrong base is refused.
+    {
+        char *out = NULL;
+        size_t out_len = 0;
+        JournalInfo info;
+        CHECK(journal_replay(g_path, "hello", 5, &out, &out_len, &info) == JOURNAL_BASE_MISMATCH);
+        CHECK(out == NULL);
+    }
+    free(m.text);
+}
+
+// Every cut inside the last record drops just that record; a flipped byte in
+// it fails its checksum.
+static void test_torn_tail(void) {
+    const char *base = "abc";
+    JournalWriter *w = journal_create(g_path, 3, crc32_update(0, base, 3), 5);
+    JournalInfo info;
+    Model before = {0};
+    Model after = {0};
+    CHECK(w != NULL);
+    CHECK(journal_append(w, 3, 0, "def", 3, 6));
+    CHECK(journal_flush(w));
+    uint64_t first_end = file_size(g_path);
+    CHECK(journal_append(w, 1, 2, "XYZW", 4, 8));
+    journal_close(w, 0);
+    uint64_t full = file_size(g_path);
+    model_replace(&before, 0, 0, "abcdef", 6);
+    model_replace(&after, 0, 0, "aXYZWdef", 8);
+
+    check_replay(g_path, base, &after, 2);
+    for (uint64_t cut = first_end; cut < full; cut++) {
+        copy_prefix(g_path, g_copy, cut, -1);
+        check_replay(g_copy, base, &before, 1);
+        CHECK(journal_scan(g_copy, &info) == JOURNAL_OK);
+        CHECK(info.valid_bytes == first_end && info.torn_bytes == cut - first_end);
+    }
+    for (uint64_t at = first_end; at < full; at++) {
+        copy_prefix(g_path, g_copy, full, (int64_t)at);
+        check_replay(g_copy, base, &before, 1);
+    }
+
+    // Resuming drops the torn tail and continues the sequence.
+    copy_prefix(g_path, g_copy, full - 2u, -1);
+    CHECK(journal_scan(g_copy, &info) == JOURNAL_OK && info.records == 1);
+    w = journal_resume(g_copy, &info, 5);
+    CHECK(w != NULL);
+    CHECK(journal_append(w, 0, 1, "", 0, 5));
+    journal_close(w, 0);
+    model_replace(&before, 0, 1, "", 0);
+    check_replay(g_copy, base, &before, 2);
+
+    // A damaged header is not a journal.
+    copy_prefix(g_path, g_copy, full, 3);
+    {
+        char *out = NULL;
+        size_t out_len = 0;
+        CHECK(journal_replay(g_copy, base, 3, &out, &out_len, &info) == JOURNAL_BAD_HEADER);
+    }
+    free(before.text);
+    free(after.text);
+}
+
+// A header whose payload length runs past the end of the file is a torn
+// tail, not a request for that much memory. The address space is capped so
+// allocating the claimed 1 GiB would fail.
+static void test_corrupt_payload_length(void) {
+    const char *base = "abc";
+    JournalWriter *w = journal_create(g_path, 3, crc32_update(0, base, 3), 5);
+    JournalInfo info;
+    Model before = {0};
+    CHECK(w != NULL);
+    CHECK(journal_append(w, 3, 0, "def", 3, 6));
+    CHECK(journal_flush(w));
+    uint64_t first_end = file_size(g_path);
+    CHECK(journal_append(w, 1, 2, "XYZW", 4, 8));
+    journal_close(w, 0);
+    uint64_t full = file_size(g_path);
+    model_replace(&before, 0, 0, "abcdef", 6);
+
+    // insert_len follows the record magic.
+    copy_prefix(g_path, g_copy, full, -1);
+    FILE *f = fopen(g_copy, "r+b");
+    static const unsigned char huge[4] = {0xF0, 0xFF, 0xFF, 0x3F};
+    CHECK(f != NULL);
+    CHECK(fseek(f, (long)first_end + 4, SEEK_SET) == 0);
+    CHECK(fwrite(huge, 1, 4, f) == 4);
+    fclose(f);
+
+#ifndef __SANITIZE_ADDRESS__
+    struct rlimit old_limit;
+    struct rlimit limit;
+    CHECK(getrlimit(RLIMIT_AS, &old_limit) == 0);
+    limit = old_limit;
+    limit.rlim_cur = 512u << 20;
+    CHECK(setrlimit(RLIMIT_AS, &limit) == 0);
+#endif
+    check_replay(g_copy, base, &before, 1);
+    CHECK(journal_scan(g_copy, &info) == JOURNAL_OK);
+    CHECK(info.records == 1 && info.valid_bytes == first_end && info.torn_bytes == full - first_end);
+#ifndef __SANITIZE_ADDRESS__
+    CHECK(setrlimit(RLIMIT_AS, &old_limit) == 0);
+#endif
+    free(before.text);
+}
+
+// A record whose resulting length does not match means an edit was never
+// journaled; replay keeps what came before it.
+static void test_divergence(void) {
+    const char *base = "0123456789";
+    JournalWriter *w = journal_create(g_path, 10, crc32_update(0, base, 10), 5);
+    JournalInfo info;
+    Model m = {0};
+    char *out = NULL;
+    size_t out_len = 0;
+    CHECK(w != NULL);
+    CHECK(journal_append(w, 0, 2, "ab", 2, 10));
+    CHECK(journal_append(w, 5, 0, "x", 1, 12));    // really 11
+    CHECK(journal_append(w, 0, 0, "y", 1, 13));
+    journal_close(w, 0);
+    model_replace(&m, 0, 0, "ab23456789", 10);
+
+    CHECK(journal_replay(g_path, base, 10, &out, &out_len, &info) == JOURNAL_OK);
+    CHECK(info.diverged && info.records == 1);
+    CHECK(out_len == m.len && memcmp(out, m.text, m.len) == 0);
+    CHECK(info.torn_bytes > 0);
+    free(out);
+
+    // An edit past the end of the document is the same kind of mismatch.
+    w = journal_create(g_path, 10, crc32_update(0, base, 10), 5);
+    CHECK(journal_append(w, 11, 0, "z", 1, 11));
+    journal_close(w, 0);
+    CHECK(journal_replay(g_path, base, 10, &out, &out_len, &info) == JOURNAL_OK);
+    CHECK(info.diverged && info.records == 0 && out_len == 10);
+    free(out);
+    free(m.text);
+}
+
+static void test_whole_text_and_compaction(void) {
+    const char *base = "old text";
+    JournalWriter *w = journal_create(g_path, 8, crc32_update(0, base, 8), 5);
+    Model m = {0};
+    CHECK(w != NULL);
+    CHECK(journal_append(w, 0, 3, "new", 3, 8));
+    CHECK(journal_append(w, 0, JOURNAL_DELETE_ALL, "undone", 6, 6));
+    CHECK(journal_append(w, 6, 0, "!", 1, 7));
+    journal_close(w, 0);
+    model_replace(&m, 0, 0, "undone!", 7);
+    check_replay(g_path, base, &m, 3);
+
+    // After a save only later edits remain, against the new base.
+    JournalInfo info;
+    CHECK(journal_scan(g_path, &info) == JOURNAL_OK);
+    w = journal_resume(g_path, &info, 5);
+    CHECK(w != NULL);
+    CHECK(journal_compact(w, 7, crc32_update(0, "undone!", 7)));
+    CHECK(journal_pending_edits(w) == 0);
+    CHECK(journal_append(w, 0, 0, ">", 1, 8));
+    CHECK(journal_flush(w));
+    CHECK(file_size(g_path) < 24u + 64u);
+    journal_close(w, 0);
+    m.len = 0;
+    model_replace(&m, 0, 0, ">undone!", 8);
+    check_replay(g_path, "undone!", &m, 1);
+
+    // Closing with discard removes the file.
+    w = journal_create(g_path, 0, crc32_update(0, "", 0), 5);
+    CHECK(w != NULL);
+    journal_close(w, 1);
+    CHECK(fopen(g_path, "rb") == NULL);
+    free(m.text);
+}
+
+// Recreating the edit control stages the text in a DocStore and appends it
+// back in chunks with capture suppressed; the journal must not see those
+// appends, and replay must still give the document.
+static void test_recreate_restore(void) {
+    const char *base = "line one\r\nline two\r\n";
+    Model m = {0};
+    JournalWriter *w = journal_create(g_path, strlen(base), crc32_update(0, base, strlen(base)), 5);
+    CHECK(w != NULL);
+    model_replace(&m, 0, 0, base, strlen(base));
+
+    uint32_t x = 99;
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 20000; i++) {
+            char ins[16];
+            x ^= x << 13, x ^= x >> 17, x ^= x << 5;
+            size_t offset = x % (m.len + 1u);
+            size_t del = (x >> 8) % 3u;
+            size_t ins_len = (x >> 12) % 12u;
+            if (del > m.len - offset) del = m.len - offset;
+            for (size_t k = 0; k < ins_len; k++) ins[k] = (char)('a' + (x >> k) % 26u);
+            model_replace(&m, offset, del, ins, ins_len);
+            CHECK(journal_append(w, offset, del, ins, ins_len, m.len));
+        }
+
+        DocStore staged;
+        doc_store_init(&staged);
+        CHECK(doc_store_append(&staged, m.text, m.len));
+        uint64_t journaled = journal_pending_edits(w);
+        int capture_depth = 1;
+        char chunk[4096];
+        uint64_t at = 0, len = doc_store_length(&staged);
+        m.len = 0;
+        while (at < len) {
+            size_t n = doc_store_read(&staged, at, chunk, sizeof(chunk));
+            CHECK(n > 0);
+            model_replace(&m, m.len, 0, chunk, n);
+            if (capture_depth == 0) CHECK(journal_append(w, at, 0, chunk, n, m.len));
+            at += n;
+        }
+        doc_store_free(&staged);
+        CHECK(m.len == len);
+        CHECK(journal_pending_edits(w) == journaled);
+    }
+    CHECK(journal_flush(w));
+    journal_close(w, 0);
+    check_replay(g_path, base, &m, 60000);
+    free(m.text);
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    snprintf(g_path, sizeof(g_path), "%s.journal", argv[0]);
+    snprintf(g_copy, sizeof(g_copy), "%s.copy.journal", argv[0]);
+    test_random_edits();
+    test_torn_tail();
+    test_corrupt_payload_length();
+    test_divergence();
+    test_whole_text_and_compaction();
+    test_recreate_restore();
+    remove(g_copy);
+    printf("journal: ok\n");
+    return 0;
+}
@@ -0,0 +1,172 @@
+// Line operations: sort, unique and reverse against a qsort reference that
+// breaks ties by line number, on small random documents and on one large
+// enough to be split into runs for several threads
+
+#include "check.h"
+#include "line_ops.h"
+
+#include <string.h>
+
+typedef struct {
+    const unsigned char *p;
+    size_t len;
+    size_t index;
+    long double number;
+} RefLine;
+
+static LineSortMode g_mode;
+
+static int fold(int c) {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+static int compare_raw(const RefLine *a, const RefLine *b, int folded) {
+    size_t n = a->len < b->len ? a->len : b->len;
+    for (size_t i = 0; i < n; i++) {
+        int x = folded ? fold(a->p[i]) : a->p[i];
+        int y = folded ? fold(b->p[i]) : b->p[i];
+        if (x != y) return x < y ? -1 : 1;
+    }
+    return a->len < b->len ? -1 : a->len > b->len;
+}
+
+// Generated numbers are short and never followed by e, x, i or n, so
+// strtold reads the same leading decimal as the module, exactly.
+static long double leading_number(const RefLine *l) {
+    char buf[64];
+    size_t n = l->len < sizeof(buf) - 1u ? l->len : sizeof(buf) - 1u;
+    memcpy(buf, l->p, n);
+    buf[n] = '\0';
+    return strtold(buf, NULL);
+}
+
+static int compare_ref(const void *va, const void *vb) {
+    const RefLine *a = (const RefLine *)va;
+    const RefLine *b = (const RefLine *)vb;
+    int c = 0;
+    if (g_mode == LINE_SORT_NOCASE) c = compare_raw(a, b, 1);
+    if (g_mode == LINE_SORT_NUMERIC) c = a->number < b->number ? -1 : a->number > b->number;
+    if (c == 0 && g_mode != LINE_SORT_NONE) c = compare_raw(a, b, 0);
+    if (c == 0) c = a->index < b->index ? -1 : a->index > b->index;
+    return c;
+}
+
+static int compare_index(const void *va, const void *vb) {
+    const RefLine *a = (const RefLine *)va;
+    const RefLine *b = (const RefLine *)vb;
+    return a->index < b->index ? -1 : a->index > b->index;
+}
+
+static char *reference(const char *text, size_t len, const LineOps *ops, size_t *out_len) {
+    const unsigned char *p = (const unsigned char *)text;
+    RefLine *lines = (RefLine *)malloc((len + 1u) * sizeof(RefLine));
+    char *out = (char *)malloc(len * 2u + 1u);
+    size_t count = 0, at = 0;
+    CHECK(lines && out);
+    while (at < len) {
+        const unsigned char *nl = (const unsigned char *)memchr(p + at, '\n', len - at);
+        size_t end = nl ? (size_t)(nl - p) : len;
+        size_t content = nl && end > at && p[end - 1u] == '\r' ? end - 1u : end;
+        lines[count].p = p + at;
+        lines[count].len = content - at;
+        lines[count].index = count;
+        lines[count].number = leading_number(&lines[count]);
+        count++;
+        at = end + 1u;
+    }
+
+    g_mode = ops->unique && ops->sort == LINE_SORT_NONE ? LINE_SORT_LEXICAL : ops->sort;
+    qsort(lines, count, sizeof(RefLine), compare_ref);
+    if (ops->unique) {
+        size_t kept = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (kept > 0 && lines[kept - 1u].len == lines[i].len && memcmp(lines[kept - 1u].p, lines[i].p, lines[i].len) == 0) {
+                continue;
+            }
+            lines[kept++] = lines[i];
+        }
+        count = kept;
+        if (ops->sort == LINE_SORT_NONE) qsort(lines, count, sizeof(RefLine), compare_index);
+    }
+
+    size_t o = 0;
+    for (size_t k = 0; k < count; k++) {
+        const RefLine *l = &lines[ops->reverse ? count - 1u - k : k];
+        memcpy(out + o, l->p, l->len);
+        o += l->len;
+        if (k + 1u < count || (len > 0 && p[len - 1u] == '\n')) {
+            out[o++] = '\r';
+            out[o++] = '\n';
+        }
+    }
+    free(lines);
+    *out_len = o;
+    return out;
+}
+
+static void generate(char *t, size_t len) {
+    static const char *words[] = {"apple", "Apple", "APPLE", "b", "B", "", "zeta", "a b", "\t7", " -3.5", "-3.50", "10", "9", "+9", "007", "0.25", ".5", "-0", "-", "12.5kg", "9999999999999", "1q", "abc\r"};
+    size_t at = 0;
+    while (at < len) {
+        const char *w = words[rand() % (int)(sizeof(words) / sizeof(words[0]))];
+        size_t n = strlen(w);
+        if (n > len - at) n = len - at;
+        memcpy(t + at, w, n);
+        at += n;
+        if (at < len) t[at++] = rand() % 4 ? '\n' : '|';
+    }
+}
+
+// Runs `ops` once per thread count against one reference result.
+static void check_ops(const char *text, size_t len, LineOps ops, const unsigned *threads, size_t runs) {
+    size_t want_len = 0;
+    char *want = reference(text, len, &ops, &want_len);
+    for (size_t r = 0; r < runs; r++) {
+        size_t got_len = 0;
+        LineOpsResult result;
+        ops.threads = threads[r];
+        char *got = line_ops_apply(text, len, &ops, "\r\n", &got_len, &result);
+        CHECK(got != NULL && got[got_len] == '\0');
+        CHECK(got_len == want_len && memcmp(got, want, got_len) == 0);
+        CHECK(result.lines_out <= result.lines_in && result.threads >= 1 && result.threads <= threads[r]);
+        free(got);
+    }
+    free(want);
+}
+
+int main(void) {
+    static const unsigned threads[] = {1, 3, 8};
+    char text[600];
+    srand(9);
+
+    for (int it = 0; it < 3000; it++) {
+        size_t len = (size_t)rand() % sizeof(text);
+        generate(text, len);
+        LineOps ops;
+        ops.sort = (LineSortMode)(it % 4);
+        ops.unique = (it / 4) % 2;
+        ops.reverse = (it / 8) % 2;
+        ops.threads = 0;
+        check_ops(text, len, ops, threads + it % 3, 1);
+    }
+
+    // Enough lines for several LINE_OPS_MIN_RUN runs and a parallel merge.
+    size_t big_len = 2u * 1024u * 1024u;
+    char *big = (char *)malloc(big_len);
+    CHECK(big != NULL);
+    generate(big, big_len);
+    for (int mode = LINE_SORT_NONE; mode <= LINE_SORT_NUMERIC; mode++) {
+        LineOps ops = {(LineSortMode)mode, mode == LINE_SORT_NONE, mode == LINE_SORT_NOCASE, 0};
+        check_ops(big, big_len, ops, threads, 3);
+    }
+    free(big);
+
+    size_t out_len = 1;
+    LineOps plain = {LINE_SORT_LEXICAL, 0, 0, 1};
+    char *empty = line_ops_apply("", 0, &plain, NULL, &out_len, NULL);
+    CHECK(empty != NULL && out_len == 0 && empty[0] == '\0');
+    free(empty);
+
+    printf("line_ops: ok\n");
+    return 0;
+}
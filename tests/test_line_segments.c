@@ -0,0 +1,93 @@
+// Line segment index: widths, x positions, caret offsets and the segment
+// lookup checked against a linear walk of the same line, for lengths around
+// the segment size and random width tables
+
+#include "check.h"
+#include "line_segments.h"
+
+#include <string.h>
+
+static unsigned next_rand(unsigned *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+// Nearest boundary to x, as a click on the line would place the caret.
+static size_t reference_offset(const uint64_t *prefix, size_t len, uint64_t x) {
+    size_t lo = 0, hi = len;
+    if (x >= prefix[len]) return len;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2u;
+        if (prefix[mid + 1u] <= x) lo = mid + 1u;
+        else hi = mid;
+    }
+    return (x - prefix[lo]) * 2u >= prefix[lo + 1u] - prefix[lo] ? lo + 1u : lo;
+}
+
+static void check_line(const char *text, size_t len, const uint16_t width[256], unsigned *seed) {
+    uint64_t *prefix = (uint64_t *)malloc((len + 1u) * sizeof(uint64_t));
+    LineSegments ls;
+    CHECK(prefix != NULL);
+    prefix[0] = 0;
+    for (size_t i = 0; i < len; i++) prefix[i + 1u] = prefix[i] + width[(unsigned char)text[i]];
+
+    CHECK(line_segments_build(&ls, text, len, width));
+    CHECK(ls.count == (len + LINE_SEGMENT_BYTES - 1u) / LINE_SEGMENT_BYTES);
+    CHECK(line_segments_width(&ls) == prefix[len]);
+
+    for (int q = 0; q < 2000; q++) {
+        // Segment edges and their neighbours, then anywhere.
+        size_t offset = q % 2 ? next_rand(seed) % (len + 1u) : (next_rand(seed) % (ls.count + 1u)) * LINE_SEGMENT_BYTES;
+        if (q % 4 == 2 && offset > 0) offset--;
+        if (offset > len) offset = len;
+        CHECK(line_segments_x_of(&ls, text, offset) == prefix[offset]);
+        // A caret moved to the x of a boundary stays on it.
+        CHECK(line_segments_offset_at(&ls, text, prefix[offset]) == offset);
+
+        uint64_t x = next_rand(seed) % (prefix[len] + 40u);
+        uint64_t segment_x = 0;
+        size_t segment = line_segments_segment_at(&ls, x, &segment_x);
+        CHECK(line_segments_offset_at(&ls, text, x) == reference_offset(prefix, len, x));
+        if (len == 0) {
+            CHECK(segment == 0 && segment_x == 0);
+            continue;
+        }
+        CHECK(segment < ls.count && segment_x == prefix[segment * LINE_SEGMENT_BYTES]);
+        size_t end = (segment + 1u) * LINE_SEGMENT_BYTES < len ? (segment + 1u) * LINE_SEGMENT_BYTES : len;
+        CHECK(x >= segment_x && (x < prefix[end] || segment == ls.count - 1u));
+    }
+    line_segments_free(&ls);
+    CHECK(ls.widths == NULL && ls.tree == NULL && ls.count == 0);
+    free(prefix);
+}
+
+int main(void) {
+    static const size_t sizes[] = {0, 1, 7, LINE_SEGMENT_BYTES - 1u, LINE_SEGMENT_BYTES, LINE_SEGMENT_BYTES + 1u,
+        LINE_SEGMENT_BYTES * 3u, LINE_SEGMENT_BYTES * 64u + 17u, 3u << 20};
+    unsigned seed = 19;
+    uint16_t fixed[256], varied[256];
+    char *text = (char *)malloc(3u << 20);
+    CHECK(text != NULL);
+
+    // A fixed-pitch font, and a proportional one with wide CJK-like high bytes.
+    for (int c = 0; c < 256; c++) {
+        fixed[c] = 9;
+        varied[c] = (uint16_t)(c >= 0x80 ? 14u + next_rand(&seed) % 6u : 3u + next_rand(&seed) % 9u);
+    }
+    varied['\t'] = 36;
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (size_t k = 0; k < sizes[i]; k++) {
+            unsigned r = next_rand(&seed);
+            text[k] = (char)(r % 7u == 0 ? '\t' : r % 5u == 0 ? 0x80 + r % 0x80 : 'a' + r % 26u);
+        }
+        check_line(text, sizes[i], fixed, &seed);
+        check_line(text, sizes[i], varied, &seed);
+    }
+
+    printf("line_segments: ok\n");
+    free(text);
+    return 0;
+}
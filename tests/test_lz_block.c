@@ -0,0 +1,86 @@
+// LZ block codec: round trips over random, two-letter, self-similar and
+// constant blocks of every size up to LZ_BLOCK_MAX with roomy and tight
+// output caps, and decoding of corrupted, truncated and random input, which
+// must fail or succeed without writing past the output
+
+#include "check.h"
+#include "lz_block.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define GUARD 64u
+
+static uint64_t g_x = 0x9E3779B97F4A7C15ull;
+
+static unsigned next(void) {
+    g_x ^= g_x << 13;
+    g_x ^= g_x >> 7;
+    g_x ^= g_x << 17;
+    return (unsigned)g_x;
+}
+
+static void fill(unsigned char *p, size_t len, int kind) {
+    for (size_t i = 0; i < len; i++) {
+        switch (kind) {
+        case 0: p[i] = (unsigned char)next(); break;
+        case 1: p[i] = (unsigned char)"ab"[next() % 2u]; break;
+        case 2: p[i] = i > 100u && next() % 8u ? p[i - 1u - next() % 100u] : (unsigned char)('a' + next() % 26u); break;
+        default: p[i] = 'x'; break;
+        }
+    }
+}
+
+// Decodes into a buffer with guard bytes on both sides.
+static void decode_guarded(const unsigned char *src, size_t len, size_t out_len) {
+    static unsigned char out[GUARD + LZ_BLOCK_MAX + GUARD];
+    memset(out, 0xA5, sizeof(out));
+    lz_block_decompress(src, len, out + GUARD, out_len);
+    for (size_t i = 0; i < GUARD; i++) {
+        CHECK(out[i] == 0xA5);
+        CHECK(out[GUARD + out_len + i] == 0xA5);
+    }
+}
+
+int main(void) {
+    static unsigned char in[LZ_BLOCK_MAX], packed[LZ_BLOCK_MAX + LZ_BLOCK_MAX / 8u], back[LZ_BLOCK_MAX];
+
+    for (int it = 0; it < 5000; it++) {
+        size_t len = it < 4 ? (size_t)it : next() % (LZ_BLOCK_MAX + 1u);
+        int kind = (int)(next() % 4u);
+        size_t cap = next() % 3u ? sizeof(packed) : next() % (len + 1u);
+        fill(in, len, kind);
+
+        size_t n = lz_block_compress(in, len, packed, cap);
+        CHECK(n <= cap);
+        if (n == 0) {
+            // Only incompressible data or a tight cap may fail to fit.
+            CHECK(kind == 0 || cap < sizeof(packed) || len == 0);
+            continue;
+        }
+        CHECK(lz_block_decompress(packed, n, back, len));
+        CHECK(memcmp(in, back, len) == 0);
+        if (kind == 3 && len > 1024u) CHECK(n < len / 50u);
+
+        // Damage: a flipped bit, a cut tail, a wrong output size.
+        size_t at = next() % n;
+        unsigned char saved = packed[at];
+        packed[at] ^= (unsigned char)(1u << (next() % 8u));
+        decode_guarded(packed, n, len);
+        packed[at] = saved;
+        decode_guarded(packed, next() % n, len);
+        if (len > 0) CHECK(!lz_block_decompress(packed, n, back, len - 1u) || len == 1u);
+        if (len < LZ_BLOCK_MAX) decode_guarded(packed, n, len + 1u);
+    }
+
+    // Random bytes as input.
+    for (int it = 0; it < 20000; it++) {
+        size_t n = next() % 2048u;
+        fill(packed, n, 0);
+        decode_guarded(packed, n, next() % (LZ_BLOCK_MAX + 1u));
+    }
+
+    CHECK(lz_block_compress(in, LZ_BLOCK_MAX + 1u, packed, sizeof(packed)) == 0);
+    printf("lz_block: ok\n");
+    return 0;
+}
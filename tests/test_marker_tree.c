@@ -0,0 +1,143 @@
+// Marker tree: random adds, removes, edits and queries checked against a
+// naive model that keeps every marker in a flat array and moves each one on
+// every edit
+
+#include "check.h"
+#include "marker_tree.h"
+
+#include <string.h>
+
+#define CAP 2000
+#define STEPS 200000
+
+typedef struct {
+    int live;
+    uint64_t start;
+    uint64_t end;
+    uint32_t kind;
+    unsigned flags;
+} Model;
+
+static Model g_model[CAP + 2];   // indexed by id
+
+static unsigned next_rand(unsigned *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+// An offset inside or at the edges of the replaced bytes lands before or
+// after the new text; anything past them shifts by the length change.
+static uint64_t move_offset(uint64_t x, uint64_t offset, uint64_t del, uint64_t ins, int after) {
+    if (x < offset) return x;
+    if (x > offset + del) return x - del + ins;
+    return after ? offset + ins : offset;
+}
+
+typedef struct {
+    uint64_t from;
+    uint64_t to;
+    uint32_t kinds;
+    uint64_t last;
+    size_t seen;
+} Query;
+
+static int visit(void *ctx, const Marker *m) {
+    Query *q = (Query *)ctx;
+    const Model *r = &g_model[m->id];
+    CHECK(r->live && r->start == m->start && r->end == m->end && r->kind == m->kind);
+    CHECK(m->start >= q->last);
+    CHECK((m->kind & q->kinds) && m->start <= q->to && m->end >= q->from);
+    q->last = m->start;
+    q->seen++;
+    return 1;
+}
+
+static void check_query(MarkerTree *t, uint64_t from, uint64_t to, uint32_t kinds) {
+    Query q = {from, to, kinds, 0, 0};
+    size_t expect = 0;
+    marker_tree_query(t, from, to, kinds, visit, &q);
+    for (int id = 1; id <= CAP + 1; id++) {
+        const Model *r = &g_model[id];
+        if (r->live && (r->kind & kinds) && r->start <= to && r->end >= from) expect++;
+    }
+    CHECK(q.seen == expect);
+
+    MarkerId next = 0;
+    MarkerId prev = 0;
+    for (int id = 1; id <= CAP + 1; id++) {
+        const Model *r = &g_model[id];
+        if (!r->live || !(r->kind & kinds)) continue;
+        if (r->start >= from && (!next || r->start < g_model[next].start)) next = (MarkerId)id;
+        if (r->start < from && (!prev || r->start > g_model[prev].start)) prev = (MarkerId)id;
+    }
+    Marker m;
+    CHECK(marker_tree_next(t, from, kinds, &m) == (next != 0));
+    if (next) CHECK(m.start == g_model[next].start);
+    CHECK(marker_tree_prev(t, from, kinds, &m) == (prev != 0));
+    if (prev) CHECK(m.start == g_model[prev].start);
+}
+
+int main(void) {
+    MarkerTree t;
+    memset(&t, 0, sizeof(t));
+    unsigned seed = 88172645u;
+    uint64_t len = 100000;
+
+    for (int step = 0; step < STEPS; step++) {
+        unsigned op = next_rand(&seed) % 100u;
+        if (op < 30 && marker_tree_count(&t) < CAP) {
+            uint64_t start = next_rand(&seed) % (len + 1u);
+            uint64_t end = start + (next_rand(&seed) % 4u ? 0 : next_rand(&seed) % 300u);
+            if (end > len) end = len;
+            uint32_t kind = 1u << (next_rand(&seed) % 3u);
+            unsigned flags = next_rand(&seed) % 2u ? MARKER_GROWS : 0;
+            MarkerId id = marker_tree_add(&t, start, end, kind, flags);
+            CHECK(id != 0 && id <= CAP + 1 && !g_model[id].live);
+            g_model[id] = (Model){1, start, end, kind, flags};
+        } else if (op < 40) {
+            MarkerId id = 1u + next_rand(&seed) % (CAP + 1u);
+            CHECK(marker_tree_remove(&t, id) == g_model[id].live);
+            g_model[id].live = 0;
+        } else if (op < 90) {
+            uint64_t offset = next_rand(&seed) % (len + 1u);
+            uint64_t del = next_rand(&seed) % 3u ? next_rand(&seed) % 50u : 0;
+            uint64_t ins = next_rand(&seed) % 3u ? next_rand(&seed) % 50u : 0;
+            if (del > len - offset) del = len - offset;
+            CHECK(marker_tree_edit(&t, offset, del, ins));
+            for (int id = 1; id <= CAP + 1; id++) {
+                Model *r = &g_model[id];
+                if (!r->live) continue;
+                int grows = (r->flags & MARKER_GROWS) != 0;
+                r->start = move_offset(r->start, offset, del, ins, !grows);
+                r->end = move_offset(r->end, offset, del, ins, grows);
+                if (r->end < r->start) r->end = r->start;
+            }
+            len = len - del + ins;
+        } else {
+            uint64_t from = next_rand(&seed) % (len + 1u);
+            check_query(&t, from, from + next_rand(&seed) % 2000u, 1u + next_rand(&seed) % 7u);
+        }
+
+        if (step % 1000 == 0) {
+            uint32_t live = 0;
+            for (int id = 1; id <= CAP + 1; id++) {
+                Marker m;
+                int found = marker_tree_get(&t, (MarkerId)id, &m);
+                CHECK(found == g_model[id].live);
+                if (!found) continue;
+                CHECK(m.start == g_model[id].start && m.end == g_model[id].end);
+                live++;
+            }
+            CHECK(marker_tree_count(&t) == live);
+        }
+    }
+
+    printf("marker_tree: ok, %u markers over %llu bytes after %d steps\n",
+        marker_tree_count(&t), (unsigned long long)len, STEPS);
+    marker_tree_clear(&t);
+    CHECK(marker_tree_count(&t) == 0);
+    marker_tree_free(&t);
+    return 0;
+}
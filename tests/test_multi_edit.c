@@ -0,0 +1,220 @@
+// Multiple carets: random caret commands checked for sorted, disjoint carets
+// that never split a CRLF, and every typed, deleted or pasted patch compared
+// with applying the same edit at each caret one by one, the last first. The
+// spans a patch is handed out in must rebuild it from the old text and only
+// show current bytes from the start of their line on
+
+#include "check.h"
+#include "multi_edit.h"
+
+#include <string.h>
+
+#define STEPS 200000
+#define CAP (1u << 20)
+
+enum { EDIT_TYPE, EDIT_BACKSPACE, EDIT_DELETE, EDIT_PASTE };
+
+static unsigned next_rand(unsigned *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static void caret_span(const MultiCaret *c, uint64_t *lo, uint64_t *hi) {
+    *lo = c->anchor < c->caret ? c->anchor : c->caret;
+    *hi = c->anchor < c->caret ? c->caret : c->anchor;
+}
+
+static void check_carets(const MultiEdit *me, const char *text, size_t len) {
+    for (size_t i = 0; i < me->count; i++) {
+        const MultiCaret *c = &me->carets[i];
+        uint64_t lo, hi;
+        caret_span(c, &lo, &hi);
+        CHECK(hi <= len);
+        CHECK(!(c->caret > 0 && c->caret < len && text[c->caret - 1] == '\r' && text[c->caret] == '\n'));
+        CHECK(!(c->anchor > 0 && c->anchor < len && text[c->anchor - 1] == '\r' && text[c->anchor] == '\n'));
+        if (i > 0) {
+            uint64_t prev_lo, prev_hi;
+            caret_span(&me->carets[i - 1], &prev_lo, &prev_hi);
+            CHECK(lo > prev_hi || (lo == prev_hi && lo != hi && prev_lo != prev_hi));
+        }
+    }
+    CHECK(me->count == 0 || me->primary < me->count);
+}
+
+// The edit a caret makes on its own, as the naive model applies it.
+static size_t apply_one(char *text, size_t len, const MultiCaret *c, int kind, const char *insert, size_t insert_len) {
+    uint64_t lo, hi;
+    caret_span(c, &lo, &hi);
+    if ((kind == EDIT_BACKSPACE || kind == EDIT_DELETE) && lo == hi) {
+        if (kind == EDIT_DELETE) {
+            hi += hi + 1u < len && text[hi] == '\r' && text[hi + 1u] == '\n' ? 2u : hi < len;
+        } else {
+            lo -= lo >= 2u && text[lo - 1u] == '\n' && text[lo - 2u] == '\r' ? 2u : lo > 0;
+        }
+    }
+    memmove(text + lo + insert_len, text + hi, len - hi);
+    memcpy(text + lo, insert, insert_len);
+    return len - (size_t)(hi - lo) + insert_len;
+}
+
+typedef struct {
+    char *text;            // the old text, brought up to date span by span
+    size_t len;
+    uint64_t last_offset;  // spans come last first
+} Replay;
+
+static void replay_span(void *ctx, const char *text, size_t len, uint64_t offset, uint64_t delete_len, uint64_t insert_len) {
+    Replay *r = (Replay *)ctx;
+    CHECK(offset + delete_len <= r->last_offset);
+    CHECK(r->len - delete_len + insert_len == len);
+    memmove(r->text + offset + insert_len, r->text + offset + delete_len, r->len - offset - delete_len);
+    memcpy(r->text + offset, text + offset, insert_len);
+    r->len = len;
+    r->last_offset = offset;
+
+    uint64_t line = offset;
+    while (line > 0 && r->text[line - 1u] != '\n') line--;
+    CHECK(memcmp(r->text + line, text + line, len - line) == 0);
+}
+
+int main(void) {
+    static const char *const pieces[] = {"ab", "\r\n", "\t", "xyz", " ", "\r\n", "q"};
+    static const char *const typed[] = {"a", "\r\n", "\t", "hello", "", "xy\r\nz"};
+    unsigned seed = 2463534242u;
+    char *text = (char *)malloc(CAP);
+    char *model = (char *)malloc(CAP);
+    char *spans = (char *)malloc(CAP);
+    CHECK(text != NULL && model != NULL && spans != NULL);
+    size_t len = 0;
+    for (int i = 0; i < 300; i++) {
+        const char *p = pieces[next_rand(&seed) % 7u];
+        memcpy(text + len, p, strlen(p));
+        len += strlen(p);
+    }
+
+    MultiEdit me;
+    memset(&me, 0, sizeof(me));
+    long patches = 0;
+    for (int step = 0; step < STEPS; step++) {
+        // Many carets grow the text fast; cut it back now and then.
+        if (len > 65536u) {
+            len = 4096u;
+            multi_edit_clear(&me);
+        }
+        unsigned op = next_rand(&seed) % 13u;
+        if (me.count == 0 || op == 0) {
+            multi_edit_clear(&me);
+            unsigned n = 1u + next_rand(&seed) % 6u;
+            for (unsigned k = 0; k < n; k++) {
+                uint64_t a = next_rand(&seed) % (len + 1u);
+                uint64_t b = next_rand(&seed) % 3u ? a : next_rand(&seed) % (len + 1u);
+                CHECK(multi_edit_add(&me, text, len, a, b));
+            }
+            check_carets(&me, text, len);
+            continue;
+        }
+        if (op == 1) {
+            CHECK(multi_edit_column_select(&me, text, len, next_rand(&seed) % (len + 1u), next_rand(&seed) % (len + 1u)));
+        } else if (op == 2) {
+            CHECK(multi_edit_line_ends(&me, text, len, next_rand(&seed) % (len + 1u), next_rand(&seed) % (len + 1u)));
+        } else if (op == 3) {
+            multi_edit_add_vertical(&me, text, len, (int)(next_rand(&seed) % 2u));
+        } else if (op <= 5) {
+            multi_edit_move(&me, text, len, (MultiMove)(next_rand(&seed) % 6u), next_rand(&seed) % 3u == 0);
+        } else if (op == 6) {
+            size_t n;
+            char *copy = multi_edit_copy(&me, text, len, "\r\n", &n);
+            CHECK(copy != NULL && strlen(copy) == n);
+            free(copy);
+        }
+        if (op <= 6) {
+            check_carets(&me, text, len);
+            continue;
+        }
+
+        // Keep the carets as they were for the model.
+        size_t count = me.count;
+        MultiCaret *carets = (MultiCaret *)malloc(count * sizeof(MultiCaret));
+        CHECK(carets != NULL);
+        memcpy(carets, me.carets, count * sizeof(MultiCaret));
+
+        MultiPatch patch;
+        char clip[256];
+        size_t clip_len = 0;
+        const char *insert = "";
+        int kind;
+        if (op <= 8 || op == 12) {
+            kind = EDIT_TYPE;
+            insert = typed[next_rand(&seed) % 6u];
+            CHECK(multi_edit_type(&me, text, len, insert, strlen(insert), &patch));
+        } else if (op <= 10) {
+            kind = op == 10 ? EDIT_DELETE : EDIT_BACKSPACE;
+            CHECK(multi_edit_delete(&me, text, len, op == 10, &patch));
+        } else {
+            kind = EDIT_PASTE;
+            int lines = next_rand(&seed) % 2u && count < 20 ? (int)count : 1 + (int)(next_rand(&seed) % 3u);
+            for (int k = 0; k < lines; k++) {
+                clip_len += (size_t)sprintf(clip + clip_len, "L%d%s", k, k + 1 < lines || next_rand(&seed) % 2u ? "\r\n" : "");
+            }
+            CHECK(multi_edit_paste(&me, text, len, clip, clip_len, &patch));
+        }
+
+        // A clip with one line per caret is dealt out line by line.
+        size_t clip_lines = 0;
+        for (size_t i = 0; i < clip_len; i++) clip_lines += clip[i] == '\n';
+        if (clip_len && clip[clip_len - 1u] != '\n') clip_lines++;
+        int deal = kind == EDIT_PASTE && clip_lines == count && count >= 2;
+        const char *line_at[32];
+        size_t line_len[32];
+        const char *cp = clip;
+        for (size_t k = 0; deal && k < count; k++) {
+            const char *nl = (const char *)memchr(cp, '\n', (size_t)(clip + clip_len - cp));
+            size_t n = nl ? (size_t)(nl - cp) : (size_t)(clip + clip_len - cp);
+            line_at[k] = cp;
+            line_len[k] = n && cp[n - 1u] == '\r' ? n - 1u : n;
+            cp = nl ? nl + 1 : clip + clip_len;
+        }
+        memcpy(model, text, len);
+        size_t model_len = len;
+        for (size_t i = count; i-- > 0;) {
+            const char *ins = kind == EDIT_PASTE ? (deal ? line_at[i] : clip) : insert;
+            size_t ins_len = kind == EDIT_PASTE ? (deal ? line_len[i] : clip_len) : kind == EDIT_TYPE ? strlen(insert) : 0;
+            model_len = apply_one(model, model_len, &carets[i], kind, ins, ins_len);
+        }
+        free(carets);
+
+        if (patch.range_count == 0) {
+            CHECK(model_len == len && memcmp(model, text, len) == 0);
+            multi_patch_free(&patch);
+            check_carets(&me, text, len);
+            continue;
+        }
+        CHECK(patch.start <= patch.end && patch.end <= len);
+        size_t new_len = len - (size_t)(patch.end - patch.start) + patch.len;
+        if (new_len > CAP / 2u) {
+            multi_patch_free(&patch);
+            break;
+        }
+        memcpy(spans, text, len);
+        Replay replay = {spans, len, UINT64_MAX};
+        memmove(text + patch.start + patch.len, text + patch.end, len - patch.end);
+        memcpy(text + patch.start, patch.text, patch.len);
+        len = new_len;
+        CHECK(model_len == len && memcmp(model, text, len) == 0);
+
+        multi_patch_each_span(&patch, text, len, replay_span, &replay);
+        CHECK(replay.len == len && memcmp(spans, text, len) == 0);
+        multi_patch_free(&patch);
+        check_carets(&me, text, len);
+        patches++;
+    }
+
+    printf("multi_edit: ok, %ld patches, %zu carets over %zu bytes\n", patches, me.count, len);
+    multi_edit_free(&me);
+    free(spans);
+    free(model);
+    free(text);
+    return 0;
+}
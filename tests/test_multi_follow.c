@@ -0,0 +1,207 @@
+// Batched edits followed span by span: random multi-caret patches handed to
+// the journal, the document mirror, the word index and the structure index
+// the way the editor does, with the indexes compared against fresh builds
+// and the journal replayed into the final document
+
+#include "check.h"
+#include "crc32.h"
+#include "doc_snapshot.h"
+#include "journal.h"
+#include "multi_edit.h"
+#include "struct_index.h"
+#include "word_index.h"
+
+#include <string.h>
+
+#define STEPS 10000
+#define CHECK_EVERY 500
+#define CAP (1u << 20)
+
+typedef struct {
+    JournalWriter *journal;
+    DocMirror *mirror;
+    WordIndex words;
+    StructIndex blocks;
+    uint64_t spans;
+} Followers;
+
+static unsigned next_rand(unsigned *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+// Same order as the editor: the word index reads the removed text from the
+// mirror before the mirror follows the span.
+static void follow_span(void *ctx, const char *text, size_t len, uint64_t offset, uint64_t delete_len,
+                        uint64_t insert_len) {
+    Followers *f = (Followers *)ctx;
+    char *old = NULL;
+    f->spans++;
+    CHECK(journal_append(f->journal, offset, delete_len, text + offset, (size_t)insert_len, len));
+    if (delete_len > 0) {
+        DocSnapshot *snap = doc_mirror_snapshot(f->mirror);
+        old = (char *)malloc((size_t)delete_len);
+        CHECK(snap && old);
+        CHECK(doc_snapshot_read(snap, offset, old, (size_t)delete_len) == delete_len);
+        doc_snapshot_release(snap);
+    }
+    CHECK(word_index_edit(&f->words, text, len, (size_t)offset, old, (size_t)delete_len, (size_t)insert_len));
+    free(old);
+    CHECK(doc_mirror_replace(f->mirror, offset, delete_len, text + offset, (size_t)insert_len));
+    CHECK(struct_index_edit(&f->blocks, text, len, offset, delete_len, insert_len));
+}
+
+static void check_followers(Followers *f, const char *text, size_t len, unsigned *seed) {
+    StructIndex fresh = {0};
+    CHECK(struct_index_build(&fresh, text, len));
+    CHECK(fresh.lines == f->blocks.lines && fresh.bytes == f->blocks.bytes);
+    for (uint64_t line = 0; line < fresh.lines; line++) {
+        uint64_t a = 0, b = 0;
+        int x = struct_index_fold(&fresh, line, &a);
+        int y = struct_index_fold(&f->blocks, line, &b);
+        CHECK(x == y && (!x || a == b));
+        x = struct_index_line_start(&fresh, line, &a);
+        y = struct_index_line_start(&f->blocks, line, &b);
+        CHECK(x == y && a == b);
+    }
+    for (int q = 0; q < 200 && len > 0; q++) {
+        uint64_t offset = next_rand(seed) % len, a = 0, b = 0;
+        int x = struct_index_match(&fresh, text, len, offset, &a);
+        int y = struct_index_match(&f->blocks, text, len, offset, &b);
+        CHECK(x == y && (!x || a == b));
+    }
+    struct_index_free(&fresh);
+
+    WordIndex words = {0};
+    CHECK(word_index_feed(&words, text, len));
+    CHECK(word_index_finish(&words));
+    CHECK(words.words == f->words.words);
+    for (size_t a = 0; a < len;) {
+        size_t e = a;
+        if (!word_index_is_word_byte((unsigned char)text[a])) {
+            a++;
+            continue;
+        }
+        while (e < len && word_index_is_word_byte((unsigned char)text[e])) e++;
+        if (e - a <= 64) CHECK(word_index_count(&words, text + a, e - a) == word_index_count(&f->words, text + a, e - a));
+        a = e;
+    }
+    word_index_free(&words);
+
+    DocSnapshot *snap = doc_mirror_snapshot(f->mirror);
+    char *copy = (char *)malloc(len + 1u);
+    CHECK(snap && copy);
+    CHECK(doc_snapshot_length(snap) == len);
+    CHECK(doc_snapshot_read(snap, 0, copy, len) == len && memcmp(copy, text, len) == 0);
+    free(copy);
+    doc_snapshot_release(snap);
+}
+
+int main(int argc, char **argv) {
+    static const char *pieces[] = {"ab", "\r\n", "\n", "\t", "xyz", " ", "{", "}", "/*", "*/", "foo_bar", "(", "\"", "q"};
+    static const char *typed[] = {"a", "/*", "}", "x\ny", "foo", "\r\n", ""};
+    char path[512];
+    char *text = (char *)malloc(CAP);
+    char *base;
+    size_t len = 0, base_len;
+    unsigned seed = 7;
+    uint64_t ranges = 0;
+    MultiEdit me;
+    Followers f;
+
+    (void)argc;
+    CHECK(text != NULL);
+    snprintf(path, sizeof(path), "%s.journal", argv[0]);
+    for (int i = 0; i < 30000; i++) {
+        const char *p = pieces[next_rand(&seed) % 14u];
+        memcpy(text + len, p, strlen(p));
+        len += strlen(p);
+    }
+    base = (char *)malloc(len);
+    CHECK(base != NULL);
+    memcpy(base, text, len);
+    base_len = len;
+
+    memset(&me, 0, sizeof(me));
+    memset(&f, 0, sizeof(f));
+    f.journal = journal_create(path, len, crc32_update(0, text, len), 50);
+    f.mirror = doc_mirror_create(text, len);
+    CHECK(f.journal && f.mirror);
+    CHECK(word_index_feed(&f.words, text, len));
+    CHECK(word_index_finish(&f.words));
+    CHECK(struct_index_build(&f.blocks, text, len));
+
+    for (int step = 0; step < STEPS; step++) {
+        MultiPatch patch;
+        unsigned op;
+        if (me.count == 0 || next_rand(&seed) % 10u == 0) {
+            unsigned carets = 1u + next_rand(&seed) % 8u;
+            multi_edit_clear(&me);
+            for (unsigned k = 0; k < carets; k++) {
+                uint64_t anchor = next_rand(&seed) % (len + 1u);
+                uint64_t caret = next_rand(&seed) % 3u ? anchor : anchor + next_rand(&seed) % 256u;
+                if (caret > len) caret = len;
+                CHECK(multi_edit_add(&me, text, len, anchor, caret));
+            }
+            if (next_rand(&seed) % 3u == 0) {
+                // A few hundred lines at most, as a drag over one screen.
+                uint64_t from = next_rand(&seed) % (len + 1u);
+                uint64_t to = from + next_rand(&seed) % 4096u;
+                CHECK(multi_edit_column_select(&me, text, len, from, to < len ? to : len));
+            }
+            continue;
+        }
+        op = next_rand(&seed) % 6u;
+        if (op < 3) {
+            const char *s = typed[next_rand(&seed) % 7u];
+            CHECK(multi_edit_type(&me, text, len, s, strlen(s), &patch));
+        } else if (op == 3) {
+            CHECK(multi_edit_delete(&me, text, len, (int)(next_rand(&seed) % 2u), &patch));
+        } else {
+            CHECK(multi_edit_paste(&me, text, len, "z1\r\n{2\r\n*/3", 11, &patch));
+        }
+        if (patch.range_count == 0) {
+            multi_patch_free(&patch);
+            continue;
+        }
+        size_t n = len - (size_t)(patch.end - patch.start) + patch.len;
+        if (n > CAP - 65536u) {
+            multi_patch_free(&patch);
+            break;
+        }
+        memmove(text + patch.start + patch.len, text + patch.end, len - (size_t)patch.end);
+        memcpy(text + patch.start, patch.text, patch.len);
+        len = n;
+        multi_patch_each_span(&patch, text, len, follow_span, &f);
+        ranges += patch.range_count;
+        multi_patch_free(&patch);
+        if (step % CHECK_EVERY == 0) check_followers(&f, text, len, &seed);
+    }
+    check_followers(&f, text, len, &seed);
+
+    CHECK(journal_flush(f.journal));
+    CHECK(journal_pending_edits(f.journal) == f.spans);
+    journal_close(f.journal, 0);
+    {
+        char *out = NULL;
+        size_t out_len = 0;
+        JournalInfo info;
+        CHECK(journal_replay(path, base, base_len, &out, &out_len, &info) == JOURNAL_OK);
+        CHECK(info.records == f.spans);
+        CHECK(out_len == len && memcmp(out, text, len) == 0);
+        free(out);
+    }
+    remove(path);
+
+    printf("multi_follow: ok, %llu ranges in %llu spans, %zu bytes at the end\n", (unsigned long long)ranges,
+           (unsigned long long)f.spans, len);
+    multi_edit_free(&me);
+    word_index_free(&f.words);
+    struct_index_free(&f.blocks);
+    doc_mirror_free(f.mirror);
+    free(base);
+    free(text);
+    return 0;
+}
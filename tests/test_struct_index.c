@@ -0,0 +1,113 @@
+// Structure index: random edits built from bracket, quote, comment and line
+// break tokens, with the edited index compared line by line against a fresh
+// build of the same text, along with bracket matches, folds and line lookups
+
+#include "check.h"
+#include "struct_index.h"
+
+#include <string.h>
+
+#define EDITS 20000
+#define CAP (1u << 22)
+
+static const char *const TOKENS[] = {
+    "{", "}", "(", ")", "[", "]", "\"", "'", "/*", "*/", "//", "\r\n", "\n", "\r",
+    "  ", "\t", "x", "\\", "a b", "\"}\"", "'{'",
+};
+#define TOKEN_COUNT (sizeof(TOKENS) / sizeof(TOKENS[0]))
+
+static unsigned next_rand(unsigned *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+static size_t add_tokens(char *dst, unsigned count, unsigned *seed) {
+    size_t n = 0;
+    for (unsigned i = 0; i < count; i++) {
+        const char *tok = TOKENS[next_rand(seed) % TOKEN_COUNT];
+        size_t len = strlen(tok);
+        memcpy(dst + n, tok, len);
+        n += len;
+    }
+    return n;
+}
+
+static const StructLine *line_at(const StructIndex *si, size_t block, uint32_t i) {
+    return &si->blocks[block].lines[i];
+}
+
+// Block boundaries may differ after edits; the lines they hold may not.
+static void check_same_lines(const StructIndex *edited, const StructIndex *fresh) {
+    CHECK(edited->lines == fresh->lines && edited->bytes == fresh->bytes);
+    size_t eb = 0, fb = 0;
+    uint32_t ei = 0, fi = 0;
+    for (uint64_t line = 0; line < fresh->lines; line++) {
+        while (ei == edited->blocks[eb].count) eb++, ei = 0;
+        while (fi == fresh->blocks[fb].count) fb++, fi = 0;
+        const StructLine *a = line_at(edited, eb, ei++);
+        const StructLine *b = line_at(fresh, fb, fi++);
+        CHECK(a->len == b->len && a->delta == b->delta && a->low == b->low);
+        CHECK(a->indent == b->indent && a->state == b->state && a->brk == b->brk);
+    }
+}
+
+static void check_queries(const StructIndex *edited, const StructIndex *fresh, const char *text, size_t len, unsigned *seed) {
+    for (int q = 0; q < 300; q++) {
+        uint64_t offset = len ? next_rand(seed) % len : 0;
+        uint64_t m1 = 0, m2 = 0;
+        int r1 = struct_index_match(edited, text, len, offset, &m1);
+        CHECK(r1 == struct_index_match(fresh, text, len, offset, &m2));
+        if (r1) CHECK(m1 == m2);
+        CHECK(struct_index_line_of(edited, offset) == struct_index_line_of(fresh, offset));
+
+        uint64_t line = next_rand(seed) % fresh->lines;
+        uint64_t l1 = 0, l2 = 0;
+        r1 = struct_index_fold(edited, line, &l1);
+        CHECK(r1 == struct_index_fold(fresh, line, &l2));
+        if (r1) CHECK(l1 == l2);
+        CHECK(struct_index_line_start(edited, line, &l1) == struct_index_line_start(fresh, line, &l2));
+        CHECK(l1 == l2);
+    }
+}
+
+int main(void) {
+    unsigned seed = 2463534242u;
+    char *text = (char *)malloc(CAP);
+    char *insert = (char *)malloc(8192);
+    CHECK(text != NULL && insert != NULL);
+    size_t len = add_tokens(text, 60000, &seed);
+
+    StructIndex si;
+    memset(&si, 0, sizeof(si));
+    CHECK(struct_index_build(&si, text, len));
+    for (int e = 0; e < EDITS; e++) {
+        // Mostly a few bytes at a time, sometimes a pasted or cut block.
+        size_t offset = next_rand(&seed) % (len + 1u);
+        size_t del = next_rand(&seed) % 4u ? next_rand(&seed) % 6u : next_rand(&seed) % 300u;
+        unsigned tokens = next_rand(&seed) % 4u ? 1u + next_rand(&seed) % 3u : next_rand(&seed) % 300u;
+        if (del > len - offset) del = len - offset;
+        size_t n = add_tokens(insert, tokens, &seed);
+        if (len - del + n >= CAP) continue;
+        memmove(text + offset + n, text + offset + del, len - offset - del);
+        memcpy(text + offset, insert, n);
+        len = len - del + n;
+        CHECK(struct_index_edit(&si, text, len, offset, del, n));
+
+        if (e % 200 == 0) {
+            StructIndex fresh;
+            memset(&fresh, 0, sizeof(fresh));
+            CHECK(struct_index_build(&fresh, text, len));
+            check_same_lines(&si, &fresh);
+            check_queries(&si, &fresh, text, len, &seed);
+            struct_index_free(&fresh);
+        }
+    }
+
+    printf("struct_index: ok, %d edits, %llu lines in %zu blocks\n", EDITS, (unsigned long long)si.lines, si.count);
+    struct_index_free(&si);
+    free(insert);
+    free(text);
+    return 0;
+}
@@ -0,0 +1,111 @@
+// Deferred task queue: FIFO order across growth and wrap-around, tasks that
+// queue more work, draining, and pushes from other threads
+
+#include "check.h"
+#include "task_queue.h"
+
+#include <string.h>
+
+static TaskQueue g_queue;
+static int g_order[4096];
+static int g_ran;
+
+static void record(void *arg) {
+    CHECK(g_ran < 4096);
+    g_order[g_ran++] = (int)(intptr_t)arg;
+}
+
+// Tasks below 5 queue a follow-up, which runs after everything already queued.
+static void record_and_requeue(void *arg) {
+    int v = (int)(intptr_t)arg;
+    record(arg);
+    if (v < 5) CHECK(task_queue_push(&g_queue, "follow-up", record_and_requeue, (void *)(intptr_t)(v + 100)));
+}
+
+typedef struct {
+    int base;
+    SysThread thread;
+} Pusher;
+
+static int push_from_thread(void *arg) {
+    Pusher *p = (Pusher *)arg;
+    for (int i = 0; i < 500; i++) {
+        CHECK(task_queue_push(&g_queue, "threaded", record, (void *)(intptr_t)(p->base + i)));
+    }
+    return 0;
+}
+
+static int drain(void) {
+    const char *name = NULL;
+    uint64_t elapsed = 0;
+    int n = 0;
+    while (task_queue_run_next(&g_queue, &name, &elapsed)) {
+        CHECK(name != NULL);
+        n++;
+    }
+    return n;
+}
+
+int main(void) {
+    const char *name = "untouched";
+    uint64_t elapsed = 7;
+
+    CHECK(task_queue_init(&g_queue));
+    CHECK(!task_queue_run_next(&g_queue, &name, &elapsed));
+    CHECK(task_queue_pending(&g_queue) == 0);
+
+    // FIFO, with follow-ups going to the back.
+    for (int i = 0; i < 20; i++) CHECK(task_queue_push(&g_queue, "startup", record_and_requeue, (void *)(intptr_t)i));
+    CHECK(task_queue_pending(&g_queue) == 20);
+    CHECK(task_queue_run_next(&g_queue, &name, &elapsed));
+    CHECK(strcmp(name, "startup") == 0);
+    CHECK(drain() == 24);
+    CHECK(g_ran == 25);
+    for (int i = 0; i < 20; i++) CHECK(g_order[i] == i);
+    for (int i = 0; i < 5; i++) CHECK(g_order[20 + i] == 100 + i);
+    CHECK(g_queue.ran == 25);
+
+    // Interleaved pushes and runs move the head around the ring while it grows.
+    g_ran = 0;
+    int next_push = 0;
+    int expect = 0;
+    for (int round = 0; round < 200; round++) {
+        for (int k = 0; k < round % 7 + 1; k++) {
+            CHECK(task_queue_push(&g_queue, "ring", record, (void *)(intptr_t)next_push++));
+        }
+        for (int k = 0; k < round % 5; k++) {
+            if (!task_queue_run_next(&g_queue, &name, &elapsed)) break;
+            CHECK(g_order[g_ran - 1] == expect++);
+        }
+    }
+    drain();
+    CHECK(g_ran == next_push);
+    for (int i = 0; i < g_ran; i++) CHECK(g_order[i] == i);
+
+    // Pushes from several threads keep each thread's order.
+    g_ran = 0;
+    Pusher pushers[4];
+    for (int t = 0; t < 4; t++) {
+        pushers[t].base = t * 1000;
+        CHECK(sys_thread_start(&pushers[t].thread, push_from_thread, &pushers[t]));
+    }
+    for (int t = 0; t < 4; t++) sys_thread_join(&pushers[t].thread);
+    CHECK(task_queue_pending(&g_queue) == 2000);
+    CHECK(drain() == 2000);
+    int next[4] = {0, 0, 0, 0};
+    for (int i = 0; i < g_ran; i++) {
+        int t = g_order[i] / 1000;
+        CHECK(g_order[i] % 1000 == next[t]);
+        next[t]++;
+    }
+    for (int t = 0; t < 4; t++) CHECK(next[t] == 500);
+
+    // Freeing drops what is still queued without running it.
+    CHECK(task_queue_push(&g_queue, "dropped", record, (void *)(intptr_t)-1));
+    g_ran = 0;
+    task_queue_free(&g_queue);
+    CHECK(g_ran == 0);
+
+    printf("task_queue: ok\n");
+    return 0;
+}
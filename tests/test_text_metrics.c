@@ -0,0 +1,73 @@
+// Text extent cache: hits, misses, growth and font invalidation
+
+#include "check.h"
+#include "text_metrics.h"
+
+#include <string.h>
+
+static int lookup(TextMetricsCache *c, uintptr_t font, const char *text, int *cx, int *cy) {
+    return text_metrics_lookup(c, font, text, strlen(text), cx, cy);
+}
+
+int main(void) {
+    TextMetricsCache c;
+    char buf[32];
+    int cx = 0;
+    int cy = 0;
+
+    CHECK(text_metrics_init(&c, 4));
+    CHECK(text_metrics_hit_percent(&c) == 0);
+
+    // Miss, store, hit.
+    CHECK(!lookup(&c, 1, "File", &cx, &cy));
+    CHECK(c.misses == 1 && c.hits == 0);
+    CHECK(text_metrics_store(&c, 1, "File", 4, 30, 16));
+    CHECK(lookup(&c, 1, "File", &cx, &cy) && cx == 30 && cy == 16);
+    CHECK(c.hits == 1);
+    CHECK(text_metrics_hit_percent(&c) == 50);
+
+    // The font is part of the key, and so is the length.
+    CHECK(!lookup(&c, 2, "File", &cx, &cy));
+    CHECK(!text_metrics_lookup(&c, 1, "File", 3, &cx, &cy));
+
+    // Storing again updates in place.
+    CHECK(text_metrics_store(&c, 1, "File", 4, 31, 17));
+    CHECK(c.count == 1);
+    CHECK(lookup(&c, 1, "File", &cx, &cy) && cx == 31 && cy == 17);
+
+    // Growing well past the initial capacity keeps every entry.
+    for (int i = 0; i < 3000; i++) {
+        sprintf(buf, "item %d", i);
+        CHECK(text_metrics_store(&c, (uintptr_t)(10 + i % 3), buf, strlen(buf), i, i + 1));
+    }
+    CHECK(c.count == 3001);
+    for (int i = 0; i < 3000; i++) {
+        sprintf(buf, "item %d", i);
+        CHECK(lookup(&c, (uintptr_t)(10 + i % 3), buf, &cx, &cy) && cx == i && cy == i + 1);
+    }
+
+    // Invalidating one font drops exactly its entries; the probe chains of
+    // the others still lead to them.
+    unsigned long long invalidations = c.invalidations;
+    CHECK(text_metrics_invalidate_font(&c, 11) == 1000);
+    CHECK(c.invalidations == invalidations + 1000);
+    CHECK(c.count == 2001);
+    for (int i = 0; i < 3000; i++) {
+        sprintf(buf, "item %d", i);
+        CHECK(lookup(&c, (uintptr_t)(10 + i % 3), buf, &cx, &cy) == (i % 3 != 1));
+    }
+    CHECK(text_metrics_invalidate_font(&c, 11) == 0);
+    CHECK(lookup(&c, 1, "File", &cx, &cy));
+
+    // Clearing drops everything but keeps the counters.
+    unsigned long long hits = c.hits;
+    text_metrics_clear(&c);
+    CHECK(c.count == 0 && c.hits == hits);
+    CHECK(!lookup(&c, 1, "File", &cx, &cy));
+    CHECK(text_metrics_store(&c, 1, "File", 4, 1, 2));
+    CHECK(lookup(&c, 1, "File", &cx, &cy) && cx == 1 && cy == 2);
+
+    text_metrics_free(&c);
+    printf("text_metrics: ok\n");
+    return 0;
+}
@@ -0,0 +1,191 @@
+// Text writer round trips: every encoding with every line-ending style, fed
+// in random chunk sizes through a small output buffer
+
+#include "check.h"
+#include "text_writer.h"
+
+#include <string.h>
+
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} Buffer;
+
+static void append(Buffer *b, const void *data, size_t len) {
+    if (len == 0) return;
+    if (b->len + len > b->cap) {
+        b->cap = (b->len + len) * 2u + 64u;
+        b->data = (unsigned char *)realloc(b->data, b->cap);
+        CHECK(b->data != NULL);
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+static int sink(void *ctx, const void *data, size_t len) {
+    append((Buffer *)ctx, data, len);
+    return 1;
+}
+
+static int refuse(void *ctx, const void *data, size_t len) {
+    (void)ctx;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+static void put_utf8(Buffer *b, uint32_t cp) {
+    unsigned char u[4];
+    size_t n;
+    if (cp < 0x80) {
+        u[0] = (unsigned char)cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        u[0] = (unsigned char)(0xC0 | (cp >> 6));
+        u[1] = (unsigned char)(0x80 | (cp & 0x3F));
+        n = 2;
+    } else if (cp < 0x10000) {
+        u[0] = (unsigned char)(0xE0 | (cp >> 12));
+        u[1] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+        u[2] = (unsigned char)(0x80 | (cp & 0x3F));
+        n = 3;
+    } else {
+        u[0] = (unsigned char)(0xF0 | (cp >> 18));
+        u[1] = (unsigned char)(0x80 | ((cp >> 12) & 0x3F));
+        u[2] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+        u[3] = (unsigned char)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    append(b, u, n);
+}
+
+// Back to UTF-8 with CRLF line endings, as the editor loads a file.
+static Buffer decode(const Buffer *file, TextFormat format) {
+    TextEncoding found = TEXT_ENC_RAW;
+    size_t bom = text_detect_bom(file->data, file->len, &found);
+    Buffer utf8 = {0};
+    Buffer out = {0};
+    CHECK(found == format.encoding);
+    CHECK(bom == (format.encoding == TEXT_ENC_RAW ? 0u : format.encoding == TEXT_ENC_UTF8_BOM ? 3u : 2u));
+
+    if (format.encoding == TEXT_ENC_UTF16LE || format.encoding == TEXT_ENC_UTF16BE) {
+        int be = format.encoding == TEXT_ENC_UTF16BE;
+        CHECK((file->len - bom) % 2u == 0);
+        for (size_t i = bom; i < file->len; i += 2u) {
+            uint32_t unit = be ? (uint32_t)(file->data[i] << 8 | file->data[i + 1]) : (uint32_t)(file->data[i + 1] << 8 | file->data[i]);
+            if (unit >= 0xD800 && unit < 0xDC00) {
+                CHECK(i + 3u < file->len);
+                uint32_t low = be ? (uint32_t)(file->data[i + 2] << 8 | file->data[i + 3]) : (uint32_t)(file->data[i + 3] << 8 | file->data[i + 2]);
+                CHECK(low >= 0xDC00 && low < 0xE000);
+                unit = 0x10000u + ((unit - 0xD800u) << 10) + (low - 0xDC00u);
+                i += 2u;
+            }
+            put_utf8(&utf8, unit);
+        }
+    } else {
+        append(&utf8, file->data + bom, file->len - bom);
+    }
+
+    // The file must only hold the requested line ending.
+    for (size_t i = 0; i < utf8.len; i++) {
+        if (format.eol == TEXT_EOL_LF) CHECK(utf8.data[i] != '\r');
+        if (format.eol == TEXT_EOL_CR) CHECK(utf8.data[i] != '\n');
+        if (format.eol == TEXT_EOL_CRLF && utf8.data[i] == '\r') CHECK(i + 1u < utf8.len && utf8.data[i + 1] == '\n');
+    }
+
+    int after_cr = 0;
+    out.cap = utf8.len * 2u + 1u;
+    out.data = (unsigned char *)malloc(out.cap);
+    CHECK(out.data != NULL);
+    out.len = eol_to_crlf((const char *)utf8.data, utf8.len, (char *)out.data, &after_cr);
+    free(utf8.data);
+    return out;
+}
+
+static Buffer encode(const Buffer *text, TextFormat format, unsigned seed) {
+    unsigned char out_buf[17];
+    Buffer file = {0};
+    TextWriter w;
+    size_t at = 0;
+    srand(seed);
+    CHECK(text_writer_init(&w, format, out_buf, sizeof(out_buf), sink, &file));
+    while (at < text->len) {
+        size_t n = 1u + (size_t)rand() % 40u;
+        if (n > text->len - at) n = text->len - at;
+        CHECK(text_writer_write(&w, (const char *)text->data + at, n));
+        at += n;
+    }
+    CHECK(text_writer_finish(&w));
+    CHECK(w.bytes_in == text->len && w.bytes_out == file.len);
+    return file;
+}
+
+// Lines of ASCII, 2-, 3- and 4-byte characters and empty lines, CRLF
+// terminated as the EDIT control keeps them. It starts with ASCII, since a
+// leading U+FEFF in a file without a BOM reads back as one.
+static Buffer sample_text(unsigned seed, int final_newline) {
+    static const uint32_t points[] = {'a', 'Z', '0', ' ', '\t', 0xE9, 0x3B1, 0x20AC, 0x4E2D, 0xFEFF, 0x1F600, 0x10348};
+    Buffer b = {0};
+    srand(seed);
+    append(&b, "#", 1);
+    for (int line = 0; line < 200; line++) {
+        int n = rand() % 30;
+        for (int i = 0; i < n; i++) put_utf8(&b, points[(size_t)rand() % (sizeof(points) / sizeof(points[0]))]);
+        if (line < 199 || final_newline) append(&b, "\r\n", 2);
+    }
+    return b;
+}
+
+static void round_trip(const Buffer *text, TextFormat format, unsigned seed) {
+    Buffer file = encode(text, format, seed);
+    Buffer back = decode(&file, format);
+    CHECK(back.len == text->len && (text->len == 0 || memcmp(back.data, text->data, text->len) == 0));
+    free(file.data);
+    free(back.data);
+}
+
+int main(void) {
+    static const TextEncoding encodings[] = {TEXT_ENC_RAW, TEXT_ENC_UTF8_BOM, TEXT_ENC_UTF16LE, TEXT_ENC_UTF16BE};
+    static const TextEol eols[] = {TEXT_EOL_CRLF, TEXT_EOL_LF, TEXT_EOL_CR};
+    Buffer empty = {0};
+
+    for (size_t e = 0; e < 4; e++) {
+        for (size_t l = 0; l < 3; l++) {
+            TextFormat format = {encodings[e], eols[l]};
+            for (unsigned seed = 1; seed <= 20; seed++) {
+                Buffer text = sample_text(seed, (int)(seed & 1u));
+                round_trip(&text, format, seed * 31u);
+                free(text.data);
+            }
+            round_trip(&empty, format, 1);
+        }
+    }
+
+    // A CRLF split across writes still becomes one line ending.
+    {
+        TextFormat format = {TEXT_ENC_UTF16LE, TEXT_EOL_LF};
+        unsigned char out_buf[16];
+        Buffer file = {0};
+        TextWriter w;
+        static const unsigned char expected[] = {0xFF, 0xFE, 'a', 0, '\n', 0, 'b', 0};
+        CHECK(text_writer_init(&w, format, out_buf, sizeof(out_buf), sink, &file));
+        CHECK(text_writer_write(&w, "a\r", 2));
+        CHECK(text_writer_write(&w, "\nb", 2));
+        CHECK(text_writer_finish(&w));
+        CHECK(file.len == sizeof(expected) && memcmp(file.data, expected, sizeof(expected)) == 0);
+        free(file.data);
+    }
+
+    // A sink that refuses stops the writer.
+    {
+        TextFormat format = {TEXT_ENC_UTF8_BOM, TEXT_EOL_CRLF};
+        unsigned char out_buf[16];
+        TextWriter w;
+        CHECK(text_writer_init(&w, format, out_buf, sizeof(out_buf), refuse, NULL));
+        CHECK(!text_writer_write(&w, "more than sixteen bytes", 23) || !text_writer_finish(&w));
+    }
+
+    printf("text_writer: ok\n");
+    return 0;
+}
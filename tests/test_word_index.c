@@ -0,0 +1,136 @@
+// Word index: random edits of identifier-heavy text, applied directly or
+// collected in a pending index and merged the way a running build does,
+// with counts and completions compared against a fresh streamed build
+
+#include "check.h"
+#include "word_index.h"
+
+#include <string.h>
+
+#define STEPS 100000
+#define CHECK_EVERY 500
+#define CAP (1u << 22)
+
+static const char *const PIECES[] = {
+    "foo", "foobar", "fooBaz", "bar", "ba", "_x1", "x", "9abc", " ", " ", "\r\n", ".", "(",
+    "alpha", "alphabet", "al", "\xc3\xa9t\xc3\xa9", "zz",
+    "qqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqq", "rr",
+};
+#define PIECE_COUNT (sizeof(PIECES) / sizeof(PIECES[0]))
+
+static unsigned next_rand(unsigned *s) {
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+// Pieces, some cut short, mixed with short random words.
+static size_t make_insert(char *dst, unsigned pieces, unsigned *seed) {
+    size_t n = 0;
+    for (unsigned i = 0; i < pieces; i++) {
+        const char *p = PIECES[next_rand(seed) % PIECE_COUNT];
+        size_t len = strlen(p);
+        if (next_rand(seed) % 3u == 0) len = 1u + next_rand(seed) % len;
+        memcpy(dst + n, p, len);
+        n += len;
+        if (next_rand(seed) % 2u) {
+            unsigned letters = 3u + next_rand(seed) % 4u;
+            for (unsigned k = 0; k < letters; k++) dst[n++] = "abcdefgh"[next_rand(seed) % 8u];
+            dst[n++] = ' ';
+        }
+    }
+    return n;
+}
+
+// Both indexes agree on every run of word bytes in the text and hold the
+// same number of words, so neither has a word the other lacks.
+static void check_against_fresh(const WordIndex *wi, const char *text, size_t len, unsigned seed) {
+    WordIndex fresh;
+    memset(&fresh, 0, sizeof(fresh));
+    for (size_t at = 0; at < len;) {
+        size_t n = 1u + next_rand(&seed) % 37u;
+        if (n > len - at) n = len - at;
+        CHECK(word_index_feed(&fresh, text + at, n));
+        at += n;
+    }
+    CHECK(word_index_finish(&fresh));
+    CHECK(wi->ordered && wi->words == fresh.words);
+
+    for (size_t at = 0; at < len;) {
+        if (!word_index_is_word_byte((unsigned char)text[at])) {
+            at++;
+            continue;
+        }
+        size_t end = at;
+        while (end < len && word_index_is_word_byte((unsigned char)text[end])) end++;
+        if (end - at <= WORD_MAX_LEN) {
+            CHECK(word_index_count(wi, text + at, end - at) == word_index_count(&fresh, text + at, end - at));
+        }
+        at = end;
+    }
+
+    static const char *const prefixes[] = {"f", "fo", "foo", "a", "al", "alp", "b", "_", "q", "r", "\xc3", "z", ""};
+    for (size_t k = 0; k < sizeof(prefixes) / sizeof(prefixes[0]); k++) {
+        WordHit got[8];
+        WordHit want[8];
+        size_t plen = strlen(prefixes[k]);
+        size_t n = word_index_complete(wi, prefixes[k], plen, got, 8);
+        CHECK(n == word_index_complete(&fresh, prefixes[k], plen, want, 8));
+        for (size_t i = 0; i < n; i++) {
+            CHECK(got[i].len == want[i].len && got[i].count == want[i].count);
+            CHECK(memcmp(got[i].text, want[i].text, got[i].len) == 0);
+        }
+    }
+    word_index_free(&fresh);
+}
+
+int main(void) {
+    unsigned seed = 2463534242u;
+    char *text = (char *)malloc(CAP);
+    char *old = (char *)malloc(CAP);
+    char insert[4096];
+    CHECK(text != NULL && old != NULL);
+    size_t len = 0;
+    for (int i = 0; i < 3000; i++) {
+        const char *p = PIECES[next_rand(&seed) % PIECE_COUNT];
+        memcpy(text + len, p, strlen(p));
+        len += strlen(p);
+    }
+
+    WordIndex wi;
+    WordIndex pending;
+    memset(&wi, 0, sizeof(wi));
+    memset(&pending, 0, sizeof(pending));
+    CHECK(word_index_feed(&wi, text, len) && word_index_finish(&wi));
+
+    for (int step = 0; step < STEPS; step++) {
+        size_t offset = next_rand(&seed) % (len + 1u);
+        size_t del = next_rand(&seed) % 8u == 0 ? next_rand(&seed) % 300u : next_rand(&seed) % 3u;
+        unsigned pieces = next_rand(&seed) % 4u == 0 ? next_rand(&seed) % 20u : next_rand(&seed) % 2u;
+        if (len < 20000) pieces += 2;
+        if (del > len - offset) del = len - offset;
+        size_t n = make_insert(insert, pieces, &seed);
+        memcpy(old, text + offset, del);
+        memmove(text + offset + n, text + offset + del, len - offset - del);
+        memcpy(text + offset, insert, n);
+        len = len - del + n;
+
+        // Every other stretch of edits goes to a pending index first.
+        int collect = (step / CHECK_EVERY) % 2;
+        CHECK(word_index_edit(collect ? &pending : &wi, text, len, offset, old, del, n));
+        if (step % CHECK_EVERY == CHECK_EVERY - 1) {
+            if (collect) {
+                CHECK(word_index_merge(&wi, &pending));
+                word_index_free(&pending);
+            }
+            check_against_fresh(&wi, text, len, (unsigned)step + 1u);
+        }
+    }
+
+    printf("word_index: ok, %d edits, %zu words in %zu bytes\n", STEPS, wi.words, len);
+    word_index_free(&wi);
+    free(old);
+    free(text);
+    return 0;
+}
@@ -0,0 +1,168 @@
+// Text extent cache keyed by (font, string)
+// Open addressing with linear probing; keys own a copy of the measured string.
+
+#include "text_metrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t hash_key(uintptr_t font, const char *text, size_t len) {
+    uint32_t h = 2166136261u;
+    uint64_t f = (uint64_t)font;
+    for (int i = 0; i < 8; i++) {
+        h ^= (uint32_t)(f & 0xFFu);
+        h *= 16777619u;
+        f >>= 8;
+    }
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)text[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static size_t round_up_pow2(size_t n) {
+    size_t cap = 16;
+    while (cap < n) cap <<= 1;
+    return cap;
+}
+
+static TextMetricsEntry *find_slot(TextMetricsEntry *slots, size_t cap, uintptr_t font, uint32_t hash, const char *text, size_t len) {
+    size_t mask = cap - 1u;
+    size_t i = (size_t)hash & mask;
+    for (;;) {
+        TextMetricsEntry *e = &slots[i];
+        if (!e->text) {
+            return e;
+        }
+        if (e->hash == hash && e->font == font && e->len == len && memcmp(e->text, text, len) == 0) {
+            return e;
+        }
+        i = (i + 1u) & mask;
+    }
+}
+
+static int rehash(TextMetricsCache *cache, size_t new_cap) {
+    TextMetricsEntry *slots = (TextMetricsEntry *)calloc(new_cap, sizeof(*slots));
+    if (!slots) return 0;
+
+    for (size_t i = 0; i < cache->cap; i++) {
+        TextMetricsEntry *e = &cache->slots[i];
+        if (e->text) {
+            *find_slot(slots, new_cap, e->font, e->hash, e->text, e->len) = *e;
+        }
+    }
+    free(cache->slots);
+    cache->slots = slots;
+    cache->cap = new_cap;
+    return 1;
+}
+
+int text_metrics_init(TextMetricsCache *cache, size_t initial_cap) {
+    if (!cache) return 0;
+    memset(cache, 0, sizeof(*cache));
+    cache->cap = round_up_pow2(initial_cap * 2u);
+    cache->slots = (TextMetricsEntry *)calloc(cache->cap, sizeof(*cache->slots));
+    if (!cache->slots) {
+        cache->cap = 0;
+        return 0;
+    }
+    return 1;
+}
+
+void text_metrics_free(TextMetricsCache *cache) {
+    if (!cache) return;
+    text_metrics_clear(cache);
+    free(cache->slots);
+    cache->slots = NULL;
+    cache->cap = 0;
+}
+
+void text_metrics_clear(TextMetricsCache *cache) {
+    if (!cache || !cache->slots) return;
+    for (size_t i = 0; i < cache->cap; i++) {
+        free(cache->slots[i].text);
+    }
+    memset(cache->slots, 0, cache->cap * sizeof(*cache->slots));
+    cache->invalidations += cache->count;
+    cache->count = 0;
+}
+
+size_t text_metrics_invalidate_font(TextMetricsCache *cache, uintptr_t font) {
+    size_t dropped = 0;
+    if (!cache || !cache->slots) return 0;
+
+    for (size_t i = 0; i < cache->cap; i++) {
+        TextMetricsEntry *e = &cache->slots[i];
+        if (e->text && e->font == font) {
+            free(e->text);
+            e->text = NULL;
+            dropped++;
+        }
+    }
+    if (dropped == 0) return 0;
+
+    // Linear probing cannot leave holes in a probe chain, so re-seat the survivors.
+    cache->count -= dropped;
+    cache->invalidations += dropped;
+    if (!rehash(cache, cache->cap)) {
+        // Could not allocate a fresh table: fall back to forgetting everything.
+        for (size_t i = 0; i < cache->cap; i++) {
+            free(cache->slots[i].text);
+        }
+        memset(cache->slots, 0, cache->cap * sizeof(*cache->slots));
+        cache->invalidations += cache->count;
+        cache->count = 0;
+    }
+    return dropped;
+}
+
+int text_metrics_lookup(TextMetricsCache *cache, uintptr_t font, const char *text, size_t len, int *out_cx, int *out_cy) {
+    TextMetricsEntry *e;
+    if (!cache || !cache->slots || !text) return 0;
+
+    e = find_slot(cache->slots, cache->cap, font, hash_key(font, text, len), text, len);
+    if (!e->text) {
+        cache->misses++;
+        return 0;
+    }
+    cache->hits++;
+    if (out_cx) *out_cx = e->cx;
+    if (out_cy) *out_cy = e->cy;
+    return 1;
+}
+
+int text_metrics_store(TextMetricsCache *cache, uintptr_t font, const char *text, size_t len, int cx, int cy) {
+    uint32_t hash;
+    TextMetricsEntry *e;
+    if (!cache || !cache->slots || !text) return 0;
+
+    if ((cache->count + 1u) * 2u > cache->cap && !rehash(cache, cache->cap * 2u)) {
+        return 0;
+    }
+
+    hash = hash_key(font, text, len);
+    e = find_slot(cache->slots, cache->cap, font, hash, text, len);
+    if (!e->text) {
+        char *copy = (char *)malloc(len + 1u);
+        if (!copy) return 0;
+        memcpy(copy, text, len);
+        copy[len] = '\0';
+        e->text = copy;
+        e->len = len;
+        e->font = font;
+        e->hash = hash;
+        cache->count++;
+    }
+    e->cx = cx;
+    e->cy = cy;
+    return 1;
+}
+
+unsigned text_metrics_hit_percent(const TextMetricsCache *cache) {
+    unsigned long long total;
+    if (!cache) return 0;
+    total = cache->hits + cache->misses;
+    if (total == 0) return 0;
+    return (unsigned)((cache->hits * 100ull) / total);
+}
@@ -0,0 +1,45 @@
+// Text extent cache keyed by (font, string)
+// Portable: the caller supplies the measurements, this only stores and looks them up.
+// Not internally synchronized; the editor guards it with a critical section.
+
+#ifndef TEXT_METRICS_H
+#define TEXT_METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uintptr_t font;
+    uint32_t hash;
+    int cx;
+    int cy;
+    size_t len;
+    char *text;
+} TextMetricsEntry;
+
+typedef struct {
+    TextMetricsEntry *slots;
+    size_t cap;
+    size_t count;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long invalidations;
+} TextMetricsCache;
+
+int text_metrics_init(TextMetricsCache *cache, size_t initial_cap);
+void text_metrics_free(TextMetricsCache *cache);
+
+// Drops every entry (settings change). Counters are kept.
+void text_metrics_clear(TextMetricsCache *cache);
+
+// Drops entries measured with `font`; call before the font handle is deleted,
+// since GDI may hand the same handle value to a different font later.
+size_t text_metrics_invalidate_font(TextMetricsCache *cache, uintptr_t font);
+
+int text_metrics_lookup(TextMetricsCache *cache, uintptr_t font, const char *text, size_t len, int *out_cx, int *out_cy);
+int text_metrics_store(TextMetricsCache *cache, uintptr_t font, const char *text, size_t len, int cx, int cy);
+
+// Hit rate in percent, 0 when nothing was looked up yet.
+unsigned text_metrics_hit_percent(const TextMetricsCache *cache);
+
+#endif
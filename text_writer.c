@@ -0,0 +1,249 @@
+// Source text format (encoding, BOM, line endings) and a streaming writer
+
+#include "text_writer.h"
+
+#include <string.h>
+
+#define WRITER_SLICE 4096u
+#define WRITER_UNITS 1024u
+
+size_t text_detect_bom(const void *data, size_t len, TextEncoding *out_encoding) {
+    const unsigned char *p = (const unsigned char *)data;
+    TextEncoding enc = TEXT_ENC_RAW;
+    size_t bom = 0;
+
+    if (len >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF) {
+        enc = TEXT_ENC_UTF8_BOM;
+        bom = 3;
+    } else if (len >= 2 && p[0] == 0xFF && p[1] == 0xFE) {
+        enc = TEXT_ENC_UTF16LE;
+        bom = 2;
+    } else if (len >= 2 && p[0] == 0xFE && p[1] == 0xFF) {
+        enc = TEXT_ENC_UTF16BE;
+        bom = 2;
+    }
+    if (out_encoding) *out_encoding = enc;
+    return bom;
+}
+
+const char *text_encoding_name(TextEncoding encoding) {
+    switch (encoding) {
+        case TEXT_ENC_UTF8_BOM: return "UTF-8 with BOM";
+        case TEXT_ENC_UTF16LE: return "UTF-16 LE";
+        case TEXT_ENC_UTF16BE: return "UTF-16 BE";
+        default: return "ANSI/UTF-8";
+    }
+}
+
+static int flush_out(TextWriter *w) {
+    if (w->failed) return 0;
+    if (w->out_len > 0) {
+        if (!w->sink(w->sink_ctx, w->out, w->out_len)) {
+            w->failed = 1;
+            return 0;
+        }
+        w->bytes_out += w->out_len;
+        w->out_len = 0;
+    }
+    return 1;
+}
+
+static int emit_bytes(TextWriter *w, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    while (len > 0) {
+        size_t room = w->out_cap - w->out_len;
+        size_t n = len < room ? len : room;
+        memcpy(w->out + w->out_len, p, n);
+        w->out_len += n;
+        p += n;
+        len -= n;
+        if (w->out_len == w->out_cap && !flush_out(w)) return 0;
+    }
+    return !w->failed;
+}
+
+static int emit_units(TextWriter *w, const uint16_t *units, size_t count) {
+    int big_endian = (w->format.encoding == TEXT_ENC_UTF16BE);
+    for (size_t i = 0; i < count; i++) {
+        unsigned char *p;
+        if (w->out_cap - w->out_len < 2u && !flush_out(w)) return 0;
+        p = w->out + w->out_len;
+        p[big_endian ? 1 : 0] = (unsigned char)(units[i] & 0xFFu);
+        p[big_endian ? 0 : 1] = (unsigned char)(units[i] >> 8);
+        w->out_len += 2u;
+    }
+    return 1;
+}
+
+// Decodes as much complete UTF-8 as fits; malformed bytes become U+FFFD.
+static size_t utf8_widen(const char *src, size_t src_len, uint16_t *dst, size_t dst_cap, size_t *consumed) {
+    const unsigned char *s = (const unsigned char *)src;
+    size_t i = 0;
+    size_t n = 0;
+
+    while (i < src_len && n + 2u <= dst_cap) {
+        unsigned c = s[i];
+        unsigned cp;
+        size_t need;
+        unsigned min;
+
+        if (c < 0x80u) {
+            dst[n++] = (uint16_t)c;
+            i++;
+            continue;
+        }
+        if (c >= 0xC2u && c <= 0xDFu) { need = 1; cp = c & 0x1Fu; min = 0x80u; }
+        else if (c >= 0xE0u && c <= 0xEFu) { need = 2; cp = c & 0x0Fu; min = 0x800u; }
+        else if (c >= 0xF0u && c <= 0xF4u) { need = 3; cp = c & 0x07u; min = 0x10000u; }
+        else {
+            dst[n++] = 0xFFFDu;
+            i++;
+            continue;
+        }
+
+        if (src_len - i <= need) {
+            // Incomplete tail: leave it for the next chunk unless a byte already proves it bad.
+            size_t k;
+            for (k = 1; i + k < src_len; k++) {
+                if ((s[i + k] & 0xC0u) != 0x80u) break;
+            }
+            if (i + k == src_len) break;
+        }
+
+        {
+            size_t k;
+            for (k = 1; k <= need; k++) {
+                if ((s[i + k] & 0xC0u) != 0x80u) break;
+                cp = (cp << 6) | (s[i + k] & 0x3Fu);
+            }
+            if (k <= need || cp < min || cp > 0x10FFFFu || (cp >= 0xD800u && cp <= 0xDFFFu)) {
+                dst[n++] = 0xFFFDu;
+                i++;
+                continue;
+            }
+        }
+
+        if (cp >= 0x10000u) {
+            cp -= 0x10000u;
+            dst[n++] = (uint16_t)(0xD800u | (cp >> 10));
+            dst[n++] = (uint16_t)(0xDC00u | (cp & 0x3FFu));
+        } else {
+            dst[n++] = (uint16_t)cp;
+        }
+        i += need + 1u;
+    }
+    *consumed = i;
+    return n;
+}
+
+static int encode_slice(TextWriter *w, const char *text, size_t len, int final) {
+    char src[WRITER_SLICE + 16];
+    uint16_t units[WRITER_UNITS];
+    size_t src_len;
+    size_t pos = 0;
+
+    if (w->format.encoding == TEXT_ENC_RAW || w->format.encoding == TEXT_ENC_UTF8_BOM) {
+        return emit_bytes(w, text, len);
+    }
+
+    memcpy(src, w->carry, w->carry_len);
+    memcpy(src + w->carry_len, text, len);
+    src_len = w->carry_len + len;
+    w->carry_len = 0;
+
+    while (pos < src_len) {
+        size_t consumed = 0;
+        size_t count;
+        if (w->widen) {
+            count = w->widen(w->widen_ctx, src + pos, src_len - pos, units, WRITER_UNITS, &consumed);
+        } else {
+            count = utf8_widen(src + pos, src_len - pos, units, WRITER_UNITS, &consumed);
+        }
+        if (count > 0 && !emit_units(w, units, count)) return 0;
+        pos += consumed;
+
+        if (consumed == 0) {
+            size_t left = src_len - pos;
+            if (!final && left < sizeof(w->carry)) {
+                memcpy(w->carry, src + pos, left);
+                w->carry_len = left;
+                return 1;
+            }
+            // No progress on a long or final remainder: it can never decode.
+            units[0] = 0xFFFDu;
+            if (!emit_units(w, units, 1)) return 0;
+            pos++;
+        }
+    }
+    return 1;
+}
+
+static int write_bom(TextWriter *w) {
+    static const unsigned char UTF8_BOM[3] = {0xEF, 0xBB, 0xBF};
+    static const uint16_t UTF16_BOM = 0xFEFFu;
+
+    switch (w->format.encoding) {
+        case TEXT_ENC_UTF8_BOM: return emit_bytes(w, UTF8_BOM, sizeof(UTF8_BOM));
+        case TEXT_ENC_UTF16LE:
+        case TEXT_ENC_UTF16BE: return emit_units(w, &UTF16_BOM, 1);
+        default: return 1;
+    }
+}
+
+int text_writer_init(TextWriter *w, TextFormat format, unsigned char *out_buf, size_t out_cap, TextSinkFn sink, void *sink_ctx) {
+    if (!w || !out_buf || out_cap < 16u || !sink) return 0;
+    memset(w, 0, sizeof(*w));
+    w->format = format;
+    w->out = out_buf;
+    w->out_cap = out_cap;
+    w->sink = sink;
+    w->sink_ctx = sink_ctx;
+    return 1;
+}
+
+void text_writer_set_widen(TextWriter *w, TextWidenFn widen, void *ctx) {
+    if (!w) return;
+    w->widen = widen;
+    w->widen_ctx = ctx;
+}
+
+int text_writer_write(TextWriter *w, const char *text, size_t len) {
+    char eol_buf[WRITER_SLICE + 1];
+
+    if (!w || w->failed) return 0;
+    if (!w->started) {
+        w->started = 1;
+        if (!write_bom(w)) return 0;
+    }
+    w->bytes_in += len;
+
+    while (len > 0) {
+        size_t n = len < WRITER_SLICE ? len : WRITER_SLICE;
+
+        if (w->format.eol == TEXT_EOL_CRLF) {
+            if (!encode_slice(w, text, n, 0)) return 0;
+        } else {
+            size_t j = eol_from_crlf(text, n, eol_buf, w->format.eol, &w->pending_cr);
+            if (j > 0 && !encode_slice(w, eol_buf, j, 0)) return 0;
+        }
+        text += n;
+        len -= n;
+    }
+    return 1;
+}
+
+int text_writer_finish(TextWriter *w) {
+    if (!w || w->failed) return 0;
+    if (!w->started) {
+        w->started = 1;
+        if (!write_bom(w)) return 0;
+    }
+    if (w->pending_cr) {
+        char cr;
+        eol_from_crlf_finish(&cr, &w->pending_cr);
+        if (!encode_slice(w, &cr, 1, 1)) return 0;
+    } else if (w->carry_len > 0) {
+        if (!encode_slice(w, "", 0, 1)) return 0;
+    }
+    return flush_out(w);
+}
@@ -0,0 +1,62 @@
+// Source text format (encoding, BOM, line endings) and a streaming writer
+// that re-encodes editor text chunk by chunk into a caller-owned buffer.
+
+#ifndef TEXT_WRITER_H
+#define TEXT_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "eol.h"
+
+typedef enum {
+    TEXT_ENC_RAW = 0,     // bytes written as they are (ANSI or UTF-8 without BOM)
+    TEXT_ENC_UTF8_BOM,
+    TEXT_ENC_UTF16LE,
+    TEXT_ENC_UTF16BE
+} TextEncoding;
+
+typedef struct {
+    TextEncoding encoding;
+    TextEol eol;
+} TextFormat;
+
+// Returns the BOM length found at the start of `data` (0 when none) and the encoding it implies.
+size_t text_detect_bom(const void *data, size_t len, TextEncoding *out_encoding);
+const char *text_encoding_name(TextEncoding encoding);
+
+// Receives encoded output; returns 0 to abort the write.
+typedef int (*TextSinkFn)(void *ctx, const void *data, size_t len);
+
+// Converts source bytes to UTF-16 code units for the UTF-16 targets. Must
+// stop before an incomplete multi-byte sequence and report how many source
+// bytes it consumed; the rest is offered again with the next chunk.
+typedef size_t (*TextWidenFn)(void *ctx, const char *src, size_t src_len, uint16_t *dst, size_t dst_cap, size_t *consumed);
+
+typedef struct {
+    TextFormat format;
+    TextSinkFn sink;
+    void *sink_ctx;
+    TextWidenFn widen;
+    void *widen_ctx;
+    unsigned char *out;
+    size_t out_len;
+    size_t out_cap;
+    char carry[8];
+    size_t carry_len;
+    int pending_cr;
+    int started;
+    int failed;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+} TextWriter;
+
+// `out_buf` bounds the writer's memory; it is flushed to `sink` whenever it fills.
+// Input text uses CRLF line endings (as the EDIT control does); they are
+// rewritten to `format.eol`. Without a widen callback the input is UTF-8.
+int text_writer_init(TextWriter *w, TextFormat format, unsigned char *out_buf, size_t out_cap, TextSinkFn sink, void *sink_ctx);
+void text_writer_set_widen(TextWriter *w, TextWidenFn widen, void *ctx);
+int text_writer_write(TextWriter *w, const char *text, size_t len);
+int text_writer_finish(TextWriter *w);
+
+#endif
@@ -0,0 +1,602 @@
+// Incremental word index for completion
+
+#include "word_index.h"
+#include "mem_account.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SLOTS_MIN 1024u
+#define BUILD_FILL (WORD_BLOCK * 3u / 4u)   // words per block after a build
+
+struct WordEntry {
+    int64_t count;
+    size_t text;       // offset in the arena
+    uint32_t hash;
+    uint32_t len;      // 0 while the entry is free
+};
+
+// Bytes >= 0x80 count as letters, so UTF-8 words stay whole.
+static const unsigned char ASCII_WORD[128] = {
+    ['0'] = 1, ['1'] = 1, ['2'] = 1, ['3'] = 1, ['4'] = 1,
+    ['5'] = 1, ['6'] = 1, ['7'] = 1, ['8'] = 1, ['9'] = 1,
+    ['A'] = 1, ['B'] = 1, ['C'] = 1, ['D'] = 1, ['E'] = 1, ['F'] = 1, ['G'] = 1,
+    ['H'] = 1, ['I'] = 1, ['J'] = 1, ['K'] = 1, ['L'] = 1, ['M'] = 1, ['N'] = 1,
+    ['O'] = 1, ['P'] = 1, ['Q'] = 1, ['R'] = 1, ['S'] = 1, ['T'] = 1, ['U'] = 1,
+    ['V'] = 1, ['W'] = 1, ['X'] = 1, ['Y'] = 1, ['Z'] = 1, ['_'] = 1,
+    ['a'] = 1, ['b'] = 1, ['c'] = 1, ['d'] = 1, ['e'] = 1, ['f'] = 1, ['g'] = 1,
+    ['h'] = 1, ['i'] = 1, ['j'] = 1, ['k'] = 1, ['l'] = 1, ['m'] = 1, ['n'] = 1,
+    ['o'] = 1, ['p'] = 1, ['q'] = 1, ['r'] = 1, ['s'] = 1, ['t'] = 1, ['u'] = 1,
+    ['v'] = 1, ['w'] = 1, ['x'] = 1, ['y'] = 1, ['z'] = 1
+};
+
+static int word_byte(char c) {
+    unsigned char u = (unsigned char)c;
+    return u >= 0x80u || ASCII_WORD[u];
+}
+
+int word_index_is_word_byte(unsigned char c) {
+    return word_byte((char)c);
+}
+
+static int is_word(const char *p, size_t n) {
+    return n >= WORD_MIN_LEN && n <= WORD_MAX_LEN && !(p[0] >= '0' && p[0] <= '9');
+}
+
+static uint32_t hash_word(const char *p, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Moves the accounted size of one array from `before` to `after` bytes.
+static void account(size_t before, size_t after) {
+    if (after > before) mem_account_alloc(MEM_SEARCH, after - before);
+    if (before > after) mem_account_free(MEM_SEARCH, before - after);
+}
+
+static const char *entry_text(const WordIndex *wi, uint32_t id) {
+    return wi->arena + wi->entries[id].text;
+}
+
+static int compare_entry(const WordIndex *wi, uint32_t id, const char *w, size_t n) {
+    const WordEntry *e = &wi->entries[id];
+    size_t common = e->len < n ? e->len : n;
+    int r = memcmp(wi->arena + e->text, w, common);
+    if (r != 0) return r;
+    return (e->len > n) - (e->len < n);
+}
+
+static int compare_ids(const WordIndex *wi, uint32_t a, uint32_t b) {
+    return compare_entry(wi, a, entry_text(wi, b), wi->entries[b].len);
+}
+
+void word_index_free(WordIndex *wi) {
+    for (size_t b = 0; b < wi->block_count; b++) free(wi->blocks[b].ids);
+    account(wi->slot_cap * sizeof(WordSlot) + wi->entry_cap * sizeof(WordEntry) +
+            wi->free_cap * sizeof(uint32_t) + wi->arena_cap + wi->block_cap * sizeof(WordBlock) +
+            wi->block_count * WORD_BLOCK * sizeof(uint32_t), 0);
+    free(wi->slots);
+    free(wi->entries);
+    free(wi->free_ids);
+    free(wi->arena);
+    free(wi->blocks);
+    memset(wi, 0, sizeof(*wi));
+}
+
+static size_t find_slot(const WordIndex *wi, const char *w, size_t n, uint32_t h, int *found) {
+    size_t mask = wi->slot_cap - 1u;
+    size_t i = h & mask;
+    while (wi->slots[i].id) {
+        const WordEntry *e = &wi->entries[wi->slots[i].id - 1u];
+        if (wi->slots[i].hash == h && e->len == n && memcmp(wi->arena + e->text, w, n) == 0) {
+            *found = 1;
+            return i;
+        }
+        i = (i + 1u) & mask;
+    }
+    *found = 0;
+    return i;
+}
+
+static int grow_slots(WordIndex *wi) {
+    size_t cap = wi->slot_cap ? wi->slot_cap * 2u : SLOTS_MIN;
+    WordSlot *slots = (WordSlot *)calloc(cap, sizeof(WordSlot));
+    if (!slots) return 0;
+    for (size_t id = 0; id < wi->entry_count; id++) {
+        size_t i;
+        if (wi->entries[id].len == 0) continue;
+        i = wi->entries[id].hash & (cap - 1u);
+        while (slots[i].id) i = (i + 1u) & (cap - 1u);
+        slots[i].id = (uint32_t)id + 1u;
+        slots[i].hash = wi->entries[id].hash;
+    }
+    account(wi->slot_cap * sizeof(WordSlot), cap * sizeof(WordSlot));
+    free(wi->slots);
+    wi->slots = slots;
+    wi->slot_cap = cap;
+    return 1;
+}
+
+// Linear probing deletes by moving later entries of the same run back, so
+// lookups never need tombstones.
+static void delete_slot(WordIndex *wi, size_t i) {
+    size_t mask = wi->slot_cap - 1u;
+    size_t j = i;
+    for (;;) {
+        size_t home;
+        j = (j + 1u) & mask;
+        if (!wi->slots[j].id) break;
+        home = wi->slots[j].hash & mask;
+        if (i <= j ? (home <= i || home > j) : (home <= i && home > j)) {
+            wi->slots[i] = wi->slots[j];
+            i = j;
+        }
+    }
+    wi->slots[i].id = 0;
+}
+
+// Rewrites the arena without the bytes of removed words.
+static int compact_arena(WordIndex *wi) {
+    char *arena = (char *)malloc(wi->arena_cap);
+    size_t at = 0;
+    if (!arena) return 0;
+    for (size_t id = 0; id < wi->entry_count; id++) {
+        WordEntry *e = &wi->entries[id];
+        if (e->len == 0) continue;
+        memcpy(arena + at, wi->arena + e->text, e->len);
+        e->text = at;
+        at += e->len;
+    }
+    free(wi->arena);
+    wi->arena = arena;
+    wi->arena_len = at;
+    wi->arena_garbage = 0;
+    return 1;
+}
+
+static int store_text(WordIndex *wi, const char *w, size_t n, size_t *out) {
+    if (wi->arena_len + n > wi->arena_cap) {
+        size_t cap = wi->arena_cap ? wi->arena_cap * 2u : 64u * 1024u;
+        char *grown;
+        if (wi->arena_garbage >= wi->arena_len / 2u && wi->arena_garbage >= n && compact_arena(wi)) {
+            return store_text(wi, w, n, out);
+        }
+        while (cap < wi->arena_len + n) cap *= 2u;
+        grown = (char *)realloc(wi->arena, cap);
+        if (!grown) return 0;
+        account(wi->arena_cap, cap);
+        wi->arena = grown;
+        wi->arena_cap = cap;
+    }
+    memcpy(wi->arena + wi->arena_len, w, n);
+    *out = wi->arena_len;
+    wi->arena_len += n;
+    return 1;
+}
+
+static int new_entry(WordIndex *wi, uint32_t *out) {
+    if (wi->free_count > 0) {
+        *out = wi->free_ids[--wi->free_count];
+        return 1;
+    }
+    if (wi->entry_count == wi->entry_cap) {
+        size_t cap = wi->entry_cap ? wi->entry_cap * 2u : 1024u;
+        WordEntry *grown = (WordEntry *)realloc(wi->entries, cap * sizeof(WordEntry));
+        if (!grown) return 0;
+        account(wi->entry_cap * sizeof(WordEntry), cap * sizeof(WordEntry));
+        wi->entries = grown;
+        wi->entry_cap = cap;
+    }
+    *out = (uint32_t)wi->entry_count++;
+    return 1;
+}
+
+// An id that cannot be put on the free list is simply never reused.
+static void release_entry(WordIndex *wi, uint32_t id) {
+    wi->arena_garbage += wi->entries[id].len;
+    wi->entries[id].len = 0;
+    if (wi->free_count == wi->free_cap) {
+        size_t cap = wi->free_cap ? wi->free_cap * 2u : 256u;
+        uint32_t *grown = (uint32_t *)realloc(wi->free_ids, cap * sizeof(uint32_t));
+        if (!grown) return;
+        account(wi->free_cap * sizeof(uint32_t), cap * sizeof(uint32_t));
+        wi->free_ids = grown;
+        wi->free_cap = cap;
+    }
+    wi->free_ids[wi->free_count++] = id;
+}
+
+// Where `w` is or would go: the position may be one past the end of its
+// block. There has to be at least one block.
+static void lower_bound(const WordIndex *wi, const char *w, size_t n, size_t *b, uint32_t *pos) {
+    size_t lo = 0;
+    size_t hi = wi->block_count;
+    const WordBlock *blk;
+    uint32_t first;
+    uint32_t last;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2u;
+        if (compare_entry(wi, wi->blocks[mid].ids[0], w, n) < 0) {
+            lo = mid + 1u;
+        } else {
+            hi = mid;
+        }
+    }
+    *b = lo > 0 ? lo - 1u : 0;
+    blk = &wi->blocks[*b];
+    first = 0;
+    last = blk->count;
+    while (first < last) {
+        uint32_t mid = first + (last - first) / 2u;
+        if (compare_entry(wi, blk->ids[mid], w, n) < 0) {
+            first = mid + 1u;
+        } else {
+            last = mid;
+        }
+    }
+    *pos = first;
+}
+
+static int insert_block(WordIndex *wi, size_t at, uint32_t *ids, uint32_t count) {
+    if (wi->block_count == wi->block_cap) {
+        size_t cap = wi->block_cap ? wi->block_cap * 2u : 64u;
+        WordBlock *grown = (WordBlock *)realloc(wi->blocks, cap * sizeof(WordBlock));
+        if (!grown) return 0;
+        account(wi->block_cap * sizeof(WordBlock), cap * sizeof(WordBlock));
+        wi->blocks = grown;
+        wi->block_cap = cap;
+    }
+    memmove(wi->blocks + at + 1u, wi->blocks + at, (wi->block_count - at) * sizeof(WordBlock));
+    wi->blocks[at].ids = ids;
+    wi->blocks[at].count = count;
+    wi->block_count++;
+    return 1;
+}
+
+static uint32_t *alloc_ids(void) {
+    uint32_t *ids = (uint32_t *)malloc(WORD_BLOCK * sizeof(uint32_t));
+    if (ids) mem_account_alloc(MEM_SEARCH, WORD_BLOCK * sizeof(uint32_t));
+    return ids;
+}
+
+static void free_ids(uint32_t *ids) {
+    mem_account_free(MEM_SEARCH, WORD_BLOCK * sizeof(uint32_t));
+    free(ids);
+}
+
+static int sorted_insert(WordIndex *wi, uint32_t id) {
+    const WordEntry *e = &wi->entries[id];
+    size_t b;
+    uint32_t pos;
+    WordBlock *blk;
+
+    if (wi->block_count == 0) {
+        uint32_t *ids = alloc_ids();
+        if (!ids || !insert_block(wi, 0, ids, 0)) {
+            if (ids) free_ids(ids);
+            return 0;
+        }
+        ids[0] = id;
+        wi->blocks[0].count = 1;
+        return 1;
+    }
+    lower_bound(wi, wi->arena + e->text, e->len, &b, &pos);
+    blk = &wi->blocks[b];
+    if (blk->count == WORD_BLOCK) {
+        uint32_t half = WORD_BLOCK / 2u;
+        uint32_t *ids = alloc_ids();
+        if (!ids) return 0;
+        memcpy(ids, blk->ids + half, (WORD_BLOCK - half) * sizeof(uint32_t));
+        if (!insert_block(wi, b + 1u, ids, WORD_BLOCK - half)) {
+            free_ids(ids);
+            return 0;
+        }
+        blk = &wi->blocks[b];
+        blk->count = half;
+        if (pos > half) {
+            blk = &wi->blocks[b + 1u];
+            pos -= half;
+        }
+    }
+    memmove(blk->ids + pos + 1u, blk->ids + pos, (blk->count - pos) * sizeof(uint32_t));
+    blk->ids[pos] = id;
+    blk->count++;
+    return 1;
+}
+
+static void sorted_remove(WordIndex *wi, uint32_t id) {
+    const WordEntry *e = &wi->entries[id];
+    size_t b;
+    uint32_t pos;
+    WordBlock *blk;
+
+    lower_bound(wi, wi->arena + e->text, e->len, &b, &pos);
+    if (b < wi->block_count && pos == wi->blocks[b].count) {
+        b++;
+        pos = 0;
+    }
+    if (b >= wi->block_count || wi->blocks[b].ids[pos] != id) return;
+    blk = &wi->blocks[b];
+    memmove(blk->ids + pos, blk->ids + pos + 1u, (blk->count - pos - 1u) * sizeof(uint32_t));
+    if (--blk->count == 0) {
+        free_ids(blk->ids);
+        memmove(wi->blocks + b, wi->blocks + b + 1u, (wi->block_count - b - 1u) * sizeof(WordBlock));
+        wi->block_count--;
+    }
+}
+
+static int adjust(WordIndex *wi, const char *w, size_t n, uint32_t h, int64_t delta) {
+    size_t slot;
+    int found;
+    uint32_t id;
+    WordEntry *e;
+
+    if ((wi->words + 1u) * 2u > wi->slot_cap && !grow_slots(wi)) return 0;
+    slot = find_slot(wi, w, n, h, &found);
+    if (!found) {
+        size_t text;
+        if (delta == 0) return 1;
+        if (!store_text(wi, w, n, &text) || !new_entry(wi, &id)) return 0;
+        e = &wi->entries[id];
+        e->count = delta;
+        e->text = text;
+        e->hash = h;
+        e->len = (uint32_t)n;
+        wi->slots[slot].id = id + 1u;
+        wi->slots[slot].hash = h;
+        wi->words++;
+        if (wi->ordered && delta > 0 && !sorted_insert(wi, id)) return 0;
+        return 1;
+    }
+
+    id = wi->slots[slot].id - 1u;
+    e = &wi->entries[id];
+    if (wi->ordered && e->count > 0 && e->count + delta <= 0) sorted_remove(wi, id);
+    if (wi->ordered && e->count <= 0 && e->count + delta > 0 && !sorted_insert(wi, id)) return 0;
+    e->count += delta;
+    if (e->count == 0) {
+        delete_slot(wi, slot);
+        wi->words--;
+        release_entry(wi, id);
+    }
+    return 1;
+}
+
+// Skips the first or last run when it is cut off from the rest of its word.
+static int add_span(WordIndex *wi, const char *p, size_t n, int64_t sign, int skip_first, int skip_last) {
+    size_t i = 0;
+    while (i < n) {
+        size_t start;
+        uint32_t h = 2166136261u;
+        while (i < n && !word_byte(p[i])) i++;
+        start = i;
+        // Hash while scanning so the bytes are only read once.
+        while (i < n && word_byte(p[i])) {
+            h = (h ^ (unsigned char)p[i]) * 16777619u;
+            i++;
+        }
+        if (start == i) break;
+        if ((skip_first && start == 0) || (skip_last && i == n)) continue;
+        if (is_word(p + start, i - start) && !adjust(wi, p + start, i - start, h, sign)) return 0;
+    }
+    return 1;
+}
+
+int word_index_add_text(WordIndex *wi, const char *text, size_t len, int sign) {
+    return add_span(wi, text, len, sign, 0, 0);
+}
+
+int word_index_feed(WordIndex *wi, const char *data, size_t len) {
+    size_t i = 0;
+    size_t j = len;
+
+    // Finish the run cut off by the previous chunk.
+    if (wi->carry_len > 0 || wi->carry_long) {
+        while (i < len && word_byte(data[i])) {
+            if (wi->carry_len < WORD_MAX_LEN) {
+                wi->carry[wi->carry_len++] = data[i];
+            } else {
+                wi->carry_long = 1;
+            }
+            i++;
+        }
+        if (i == len) return 1;
+        if (!wi->carry_long && !add_span(wi, wi->carry, wi->carry_len, 1, 0, 0)) return 0;
+        wi->carry_len = 0;
+        wi->carry_long = 0;
+    }
+
+    while (j > i && word_byte(data[j - 1u])) j--;
+    if (!add_span(wi, data + i, j - i, 1, 0, 0)) return 0;
+    if (len - j > WORD_MAX_LEN) {
+        wi->carry_long = 1;
+    } else {
+        memcpy(wi->carry, data + j, len - j);
+        wi->carry_len = len - j;
+    }
+    return 1;
+}
+
+// The first eight bytes of a word, big-endian and zero-padded, order the
+// same way as the word, so most comparisons of a sort stay out of the arena.
+typedef struct {
+    uint64_t key;
+    uint32_t id;
+} SortItem;
+
+static uint64_t sort_key(const WordIndex *wi, uint32_t id) {
+    const char *p = entry_text(wi, id);
+    size_t n = wi->entries[id].len < 8u ? wi->entries[id].len : 8u;
+    uint64_t key = 0;
+    for (size_t i = 0; i < 8u; i++) key = (key << 8) | (i < n ? (unsigned char)p[i] : 0u);
+    return key;
+}
+
+static int item_before(const WordIndex *wi, const SortItem *a, const SortItem *b) {
+    if (a->key != b->key) return a->key < b->key;
+    return compare_ids(wi, a->id, b->id) <= 0;
+}
+
+// Bottom-up merge sort, so the order does not depend on the input.
+static int sort_items(const WordIndex *wi, SortItem *items, size_t n) {
+    SortItem *tmp = (SortItem *)malloc((n ? n : 1u) * sizeof(SortItem));
+    SortItem *src = items;
+    SortItem *dst = tmp;
+    if (!tmp) return 0;
+    for (size_t width = 1; width < n; width *= 2u) {
+        for (size_t lo = 0; lo < n; lo += 2u * width) {
+            size_t mid = lo + width < n ? lo + width : n;
+            size_t hi = lo + 2u * width < n ? lo + 2u * width : n;
+            size_t a = lo;
+            size_t b = mid;
+            size_t k = lo;
+            while (a < mid && b < hi) dst[k++] = item_before(wi, &src[a], &src[b]) ? src[a++] : src[b++];
+            while (a < mid) dst[k++] = src[a++];
+            while (b < hi) dst[k++] = src[b++];
+        }
+        SortItem *swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != items) memcpy(items, src, n * sizeof(SortItem));
+    free(tmp);
+    return 1;
+}
+
+int word_index_finish(WordIndex *wi) {
+    SortItem *items;
+    size_t n = 0;
+    size_t chunks;
+
+    if (wi->carry_len > 0 && !wi->carry_long && !add_span(wi, wi->carry, wi->carry_len, 1, 0, 0)) return 0;
+    wi->carry_len = 0;
+    wi->carry_long = 0;
+    if (wi->ordered) return 1;
+
+    items = (SortItem *)malloc((wi->words ? wi->words : 1u) * sizeof(SortItem));
+    if (!items) return 0;
+    for (size_t id = 0; id < wi->entry_count; id++) {
+        if (wi->entries[id].len == 0 || wi->entries[id].count <= 0) continue;
+        items[n].key = sort_key(wi, (uint32_t)id);
+        items[n].id = (uint32_t)id;
+        n++;
+    }
+    if (!sort_items(wi, items, n)) {
+        free(items);
+        return 0;
+    }
+    // Blocks start three quarters full so the first inserts do not split them.
+    chunks = (n + BUILD_FILL - 1u) / BUILD_FILL;
+    for (size_t k = 0; k < chunks; k++) {
+        size_t lo = n * k / chunks;
+        size_t hi = n * (k + 1u) / chunks;
+        uint32_t *block = alloc_ids();
+        if (!block || !insert_block(wi, wi->block_count, block, (uint32_t)(hi - lo))) {
+            if (block) free_ids(block);
+            free(items);
+            return 0;
+        }
+        for (size_t i = lo; i < hi; i++) block[i - lo] = items[i].id;
+    }
+    free(items);
+    wi->ordered = 1;
+    return 1;
+}
+
+int word_index_edit(WordIndex *wi, const char *text, size_t len, size_t offset,
+                    const char *deleted, size_t delete_len, size_t insert_len) {
+    size_t lo = offset;
+    size_t hi = offset + insert_len;
+    int cut_left = 0;
+    int cut_right = 0;
+    size_t head;
+    size_t tail;
+    char *old;
+    int ok;
+
+    if (hi > len) return 0;
+    // Widen to the words around the change. A run longer than any word on
+    // either side is cut off and left alone, before and after.
+    while (lo > 0 && word_byte(text[lo - 1u])) {
+        if (offset - lo == WORD_MAX_LEN) {
+            cut_left = 1;
+            break;
+        }
+        lo--;
+    }
+    while (hi < len && word_byte(text[hi])) {
+        if (hi - (offset + insert_len) == WORD_MAX_LEN) {
+            cut_right = 1;
+            break;
+        }
+        hi++;
+    }
+    head = offset - lo;
+    tail = hi - (offset + insert_len);
+
+    old = (char *)malloc(head + delete_len + tail + 1u);
+    if (!old) return 0;
+    memcpy(old, text + lo, head);
+    if (delete_len) memcpy(old + head, deleted, delete_len);   // `deleted` may be NULL then
+    memcpy(old + head + delete_len, text + offset + insert_len, tail);
+    ok = add_span(wi, old, head + delete_len + tail, -1, cut_left, cut_right) &&
+         add_span(wi, text + lo, hi - lo, 1, cut_left, cut_right);
+    free(old);
+    return ok;
+}
+
+int word_index_merge(WordIndex *dst, const WordIndex *src) {
+    for (size_t id = 0; id < src->entry_count; id++) {
+        const WordEntry *e = &src->entries[id];
+        if (e->len == 0) continue;
+        if (!adjust(dst, src->arena + e->text, e->len, e->hash, e->count)) return 0;
+    }
+    return 1;
+}
+
+int64_t word_index_count(const WordIndex *wi, const char *word, size_t len) {
+    size_t slot;
+    int found;
+    if (!wi->slot_cap) return 0;
+    slot = find_slot(wi, word, len, hash_word(word, len), &found);
+    return found ? wi->entries[wi->slots[slot].id - 1u].count : 0;
+}
+
+size_t word_index_complete(const WordIndex *wi, const char *prefix, size_t len, WordHit *out, size_t max) {
+    size_t b;
+    uint32_t pos;
+    size_t stored = 0;
+    size_t scanned = 0;
+
+    if (!wi->ordered || wi->block_count == 0 || max == 0) return 0;
+    lower_bound(wi, prefix, len, &b, &pos);
+    while (b < wi->block_count && scanned < WORD_SCAN_LIMIT) {
+        const WordBlock *blk = &wi->blocks[b];
+        const WordEntry *e;
+        if (pos == blk->count) {
+            b++;
+            pos = 0;
+            continue;
+        }
+        e = &wi->entries[blk->ids[pos++]];
+        if (e->len < len || memcmp(wi->arena + e->text, prefix, len) != 0) break;
+        scanned++;
+        if (e->len == len) continue;
+
+        // Ties keep their sorted order.
+        size_t at = stored;
+        while (at > 0 && out[at - 1u].count < e->count) at--;
+        if (at >= max) continue;
+        if (stored < max) stored++;
+        memmove(out + at + 1u, out + at, (stored - at - 1u) * sizeof(WordHit));
+        out[at].text = wi->arena + e->text;
+        out[at].len = e->len;
+        out[at].count = e->count;
+    }
+    return stored;
+}
@@ -0,0 +1,98 @@
+// Incremental word index for completion
+// Every distinct word of the document is kept once with the number of times
+// it occurs: a hash table finds a word in O(1) to change its count, and the
+// words with a positive count are also kept in sorted order in blocks of up
+// to WORD_BLOCK, so a prefix query is a binary search followed by a short
+// walk. A first build is streamed (a worker can feed it from a snapshot) and
+// only sorts once at the end; after that, an edit removes the words of the
+// replaced text and adds those of the new text, touching a few entries.
+// A word is a run of letters, digits, '_' and bytes >= 0x80, between
+// WORD_MIN_LEN and WORD_MAX_LEN bytes long, that does not start with a digit.
+// Matching is case-sensitive.
+
+#ifndef WORD_INDEX_H
+#define WORD_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WORD_MIN_LEN 3u
+#define WORD_MAX_LEN 64u
+#define WORD_BLOCK 512u
+#define WORD_SCAN_LIMIT 4096u   // words a query looks at before ranking them
+
+typedef struct WordEntry WordEntry;
+
+// The hash is kept next to the id so probing past other words does not
+// have to look at their entries.
+typedef struct {
+    uint32_t id;               // entry id + 1, 0 when free
+    uint32_t hash;
+} WordSlot;
+
+typedef struct {
+    uint32_t *ids;
+    uint32_t count;
+} WordBlock;
+
+typedef struct {
+    WordSlot *slots;           // open addressing
+    size_t slot_cap;           // power of two
+    WordEntry *entries;
+    size_t entry_count;        // handed out so far, free ones included
+    size_t entry_cap;
+    uint32_t *free_ids;
+    size_t free_count;
+    size_t free_cap;
+    char *arena;               // word bytes
+    size_t arena_len;
+    size_t arena_cap;
+    size_t arena_garbage;      // bytes of removed words
+    WordBlock *blocks;         // sorted words; NULL until finished
+    size_t block_count;
+    size_t block_cap;
+    size_t words;              // distinct words with a nonzero count
+    int ordered;
+    // Streaming state: the word cut off at the end of the last chunk.
+    char carry[WORD_MAX_LEN];
+    size_t carry_len;
+    int carry_long;            // the cut-off run is already too long
+} WordIndex;
+
+typedef struct {
+    const char *text;          // into the index; valid until it changes
+    size_t len;
+    int64_t count;
+} WordHit;
+
+// A zeroed WordIndex is empty and unordered. Feed the document in chunks,
+// then finish it to sort it and allow queries. Return 0 on allocation
+// failure, after which the index has to be freed.
+int word_index_feed(WordIndex *wi, const char *data, size_t len);
+int word_index_finish(WordIndex *wi);
+void word_index_free(WordIndex *wi);
+
+// Adds (sign 1) or removes (sign -1) the words of a piece of text whose
+// ends are word boundaries. An unordered index may go negative, so it can
+// collect the changes made while another one is being built.
+int word_index_add_text(WordIndex *wi, const char *text, size_t len, int sign);
+
+// Follows [offset, offset + delete_len) having been replaced by
+// `insert_len` bytes. `text` is the whole document after the change and
+// `deleted` the bytes that were removed.
+int word_index_edit(WordIndex *wi, const char *text, size_t len, size_t offset,
+                    const char *deleted, size_t delete_len, size_t insert_len);
+
+// Applies every count of `src` to `dst`.
+int word_index_merge(WordIndex *dst, const WordIndex *src);
+
+int64_t word_index_count(const WordIndex *wi, const char *word, size_t len);
+
+// Up to `max` words starting with `prefix` (but not equal to it), most
+// frequent first, from the first WORD_SCAN_LIMIT words in sorted order.
+// Returns how many were stored.
+size_t word_index_complete(const WordIndex *wi, const char *prefix, size_t len, WordHit *out, size_t max);
+
+int word_index_is_word_byte(unsigned char c);
+
+#endif